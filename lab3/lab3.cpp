@@ -7,6 +7,7 @@
 #include <memory>
 #include <string>
 #include <chrono>
+#include "../lab4/D3DShaderCache.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -372,9 +373,13 @@ bool CompileAndCreateShaders()
     compileFlags |= D3DCOMPILE_DEBUG;
 #endif
 
+    // Reuse bytecode from earlier runs while the shader text is unchanged
+    ShaderCache cache(CompileShaderWithD3D, D3D_SHADER_COMPILER_ID);
+    cache.Open(GetShaderCachePath(L"shader_cache.bin"));
+
     // Compile vertex shader
-    HRESULT hr = D3DCompile(g_shaderVertexCode, strlen(g_shaderVertexCode), nullptr,
-        nullptr, nullptr, "main", "vs_5_0", compileFlags, 0, &vertexCode, &errorMsg);
+    HRESULT hr = CompileShaderCached(cache, g_shaderVertexCode, strlen(g_shaderVertexCode),
+        nullptr, "main", "vs_5_0", compileFlags, &vertexCode, &errorMsg);
 
     if (FAILED(hr))
     {
@@ -386,8 +391,8 @@ bool CompileAndCreateShaders()
         return false;
     }
 
-    hr = D3DCompile(g_shaderPixelCode, strlen(g_shaderPixelCode), nullptr,
-        nullptr, nullptr, "main", "ps_5_0", compileFlags, 0, &pixelCode, &errorMsg);
+    hr = CompileShaderCached(cache, g_shaderPixelCode, strlen(g_shaderPixelCode),
+        nullptr, "main", "ps_5_0", compileFlags, &pixelCode, &errorMsg);
 
     if (FAILED(hr))
     {
@@ -420,6 +425,8 @@ bool CompileAndCreateShaders()
     SAFE_RELEASE(vertexCode);
     SAFE_RELEASE(pixelCode);
 
+    cache.Save();
+    ReportShaderCacheStats("lab3", cache.GetStats());
     return true;
 }
 
@@ -0,0 +1,181 @@
+#include "AssetArchive.h"
+#include <cstring>
+
+AssetArchive::AssetArchive()
+    : m_pEntries(nullptr), m_pSubresources(nullptr), m_entryCount(0)
+{
+}
+
+bool AssetArchive::Open(const wchar_t* filename)
+{
+    Close();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(filename))
+        return false;
+    m_file = std::move(file);
+    return Validate();
+}
+
+bool AssetArchive::Open(const char* filename)
+{
+    Close();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(filename))
+        return false;
+    m_file = std::move(file);
+    return Validate();
+}
+
+void AssetArchive::Close()
+{
+    m_file.reset();
+    m_pEntries = nullptr;
+    m_pSubresources = nullptr;
+    m_entryCount = 0;
+}
+
+// One pass over the table so OpenTexture() can trust it: every entry names
+// its own run of subresources and every subresource lies inside its entry's
+// payload, with room for its rows.
+bool AssetArchive::Validate()
+{
+    const uint8_t* pBase = m_file->GetData();
+    const uint64_t fileSize = m_file->GetSize();
+    if (fileSize < sizeof(AssetArchiveHeader))
+    {
+        Close();
+        return false;
+    }
+
+    AssetArchiveHeader header;
+    memcpy(&header, pBase, sizeof(header));
+    const uint64_t tableSize = sizeof(AssetArchiveHeader) +
+        (uint64_t)header.entryCount * sizeof(AssetArchiveEntry) +
+        (uint64_t)header.subresourceCount * sizeof(AssetArchiveSubresource);
+    if (header.magic != ASSET_ARCHIVE_MAGIC || header.version != ASSET_ARCHIVE_VERSION ||
+        header.fileSize != fileSize || tableSize > fileSize)
+    {
+        Close();
+        return false;
+    }
+
+    // The table starts 8-byte aligned in a page-aligned mapping, so it is
+    // used in place.
+    const AssetArchiveEntry* pEntries = (const AssetArchiveEntry*)(pBase + sizeof(AssetArchiveHeader));
+    const AssetArchiveSubresource* pSubresources = (const AssetArchiveSubresource*)(pEntries + header.entryCount);
+
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        const AssetArchiveEntry& entry = pEntries[i];
+        const uint64_t subresourceCount = (uint64_t)entry.arraySize * entry.mipCount;
+        // Uncompressed entries carry the R8G8B8A8 DdsView reports for them.
+        const bool knownFormat = entry.layout == DDS_PIXELS_BLOCK ?
+            DdsBytesPerBlock((DXGI_FORMAT)entry.format) != 0 : entry.format == DXGI_FORMAT_R8G8B8A8_UNORM;
+        if (memchr(entry.name, 0, sizeof(entry.name)) == nullptr ||
+            entry.layout == DDS_PIXELS_UNKNOWN || entry.layout > DDS_PIXELS_BGR24 || !knownFormat ||
+            entry.mipCount == 0 || entry.mipCount > 32 || entry.arraySize == 0 ||
+            entry.firstSubresource > header.subresourceCount ||
+            subresourceCount > header.subresourceCount - entry.firstSubresource ||
+            entry.dataOffset % ASSET_ARCHIVE_ALIGNMENT != 0 ||
+            entry.dataOffset < tableSize || entry.dataOffset > fileSize ||
+            entry.dataSize > fileSize - entry.dataOffset)
+        {
+            Close();
+            return false;
+        }
+
+        // D3D reads each level at the size the texture implies, so the table
+        // has to agree with it and hold every row.
+        const uint64_t dataEnd = entry.dataOffset + entry.dataSize;
+        const bool blocks = entry.layout == DDS_PIXELS_BLOCK;
+        const uint32_t unitBytes = blocks ? DdsBytesPerBlock((DXGI_FORMAT)entry.format) :
+            DdsBytesPerPixel((DdsPixelLayout)entry.layout);
+        for (uint64_t s = 0; s < subresourceCount; ++s)
+        {
+            const AssetArchiveSubresource& sub = pSubresources[entry.firstSubresource + s];
+            const uint32_t level = (uint32_t)(s % entry.mipCount);
+            const uint32_t width = entry.width >> level ? entry.width >> level : 1;
+            const uint32_t height = entry.height >> level ? entry.height >> level : 1;
+            const uint64_t units = blocks ? (width + 3) / 4 : width;
+            const uint64_t rows = blocks ? (height + 3) / 4 : height;
+            if (sub.offset < entry.dataOffset || sub.offset > dataEnd || sub.size > dataEnd - sub.offset ||
+                sub.width != width || sub.height != height ||
+                sub.rowPitch < units * unitBytes || (uint64_t)sub.rowPitch * rows > sub.size)
+            {
+                Close();
+                return false;
+            }
+        }
+    }
+
+    m_pEntries = pEntries;
+    m_pSubresources = pSubresources;
+    m_entryCount = header.entryCount;
+    return true;
+}
+
+int AssetArchive::FindEntry(const char* name) const
+{
+    for (uint32_t i = 0; i < m_entryCount; ++i)
+    {
+        if (strcmp(m_pEntries[i].name, name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+bool AssetArchive::HasEntries(const char* const* pNames, uint32_t nameCount) const
+{
+    for (uint32_t i = 0; i < nameCount; ++i)
+    {
+        if (FindEntry(pNames[i]) < 0)
+            return false;
+    }
+    return IsOpen();
+}
+
+bool AssetArchive::OpenTexture(uint32_t index, DdsView& view) const
+{
+    if (index >= m_entryCount)
+    {
+        view.Close();
+        return false;
+    }
+
+    const AssetArchiveEntry& entry = m_pEntries[index];
+    DdsTextureInfo info;
+    info.fmt = (DXGI_FORMAT)entry.format;
+    info.layout = (DdsPixelLayout)entry.layout;
+    info.width = entry.width;
+    info.height = entry.height;
+    info.mipCount = entry.mipCount;
+    info.arraySize = entry.arraySize;
+    info.cubemap = (entry.flags & ASSET_ARCHIVE_CUBEMAP) != 0;
+
+    const uint8_t* pBase = m_file->GetData();
+    std::vector<DdsMipSpan> mips((size_t)entry.arraySize * entry.mipCount);
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        const AssetArchiveSubresource& sub = m_pSubresources[entry.firstSubresource + i];
+        mips[i].pData = pBase + sub.offset;
+        mips[i].size = sub.size;
+        mips[i].rowPitch = sub.rowPitch;
+        mips[i].width = sub.width;
+        mips[i].height = sub.height;
+    }
+
+    return view.Adopt(m_file, info, pBase + entry.dataOffset, (size_t)entry.dataSize, std::move(mips));
+}
+
+bool AssetArchive::OpenTexture(const char* name, DdsView& view) const
+{
+    const int index = FindEntry(name);
+    if (index < 0)
+    {
+        view.Close();
+        return false;
+    }
+    return OpenTexture((uint32_t)index, view);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "DdsView.h"
+
+// Packed asset file written by AssetCooker. Everything the loader needs is
+// worked out at cook time, so opening it is one mapping plus a table walk:
+//
+//   AssetArchiveHeader
+//   AssetArchiveEntry[entryCount]
+//   AssetArchiveSubresource[subresourceCount]
+//   payloads, each starting on an ASSET_ARCHIVE_ALIGNMENT boundary
+//
+// A texture's subresources are slice-major, mipCount per slice, and point
+// at rows laid out exactly as D3D11_SUBRESOURCE_DATA wants them.
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4B41504C;     // "LPAK"
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint32_t ASSET_ARCHIVE_ALIGNMENT = 4096;
+const uint32_t ASSET_ARCHIVE_NAME_SIZE = 48;
+
+// AssetArchiveEntry::flags
+const uint32_t ASSET_ARCHIVE_CUBEMAP = 0x1;
+
+struct AssetArchiveHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t subresourceCount;
+    uint64_t fileSize;
+};
+
+struct AssetArchiveEntry
+{
+    char name[ASSET_ARCHIVE_NAME_SIZE];     // NUL-terminated
+    uint32_t format;                        // DXGI_FORMAT, as DdsView reports it
+    uint32_t layout;                        // DdsPixelLayout
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t arraySize;                     // 2D slices, six per cube
+    uint32_t flags;
+    uint32_t firstSubresource;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+struct AssetArchiveSubresource
+{
+    uint64_t offset;                        // from the start of the file
+    uint32_t size;
+    uint32_t rowPitch;
+    uint32_t width;
+    uint32_t height;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 24, "AssetArchiveHeader layout");
+static_assert(sizeof(AssetArchiveEntry) == 96, "AssetArchiveEntry layout");
+static_assert(sizeof(AssetArchiveSubresource) == 24, "AssetArchiveSubresource layout");
+
+// Read-only view of a packed archive. Open() maps the file and checks the
+// table against the file size once; textures then come out as DdsViews over
+// the shared mapping without any header parsing or mip size arithmetic.
+// Copies share the mapping, which stays alive while any view out of it does.
+class AssetArchive
+{
+public:
+    AssetArchive();
+
+    bool Open(const wchar_t* filename);
+    bool Open(const char* filename);
+    void Close();
+
+    bool IsOpen() const { return m_file != nullptr; }
+    uint32_t GetEntryCount() const { return m_entryCount; }
+    const AssetArchiveEntry& GetEntry(uint32_t index) const { return m_pEntries[index]; }
+    size_t GetMappedSize() const { return m_file ? m_file->GetSize() : 0; }
+
+    // Index of the entry called name, or -1.
+    int FindEntry(const char* name) const;
+    // True if every one of the nameCount names has an entry. A caller that
+    // needs a fixed set of textures checks once and uses loose files
+    // otherwise.
+    bool HasEntries(const char* const* pNames, uint32_t nameCount) const;
+
+    bool OpenTexture(uint32_t index, DdsView& view) const;
+    bool OpenTexture(const char* name, DdsView& view) const;
+
+private:
+    bool Validate();
+
+    std::shared_ptr<const MappedFile> m_file;
+    const AssetArchiveEntry* m_pEntries;
+    const AssetArchiveSubresource* m_pSubresources;
+    uint32_t m_entryCount;
+};
@@ -0,0 +1,177 @@
+#include "AssetArchiveBench.h"
+#include "AssetCooker.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // What the loader hands D3D: a pointer and pitch per subresource.
+    struct UploadSpan
+    {
+        const void* pData;
+        uint32_t rowPitch;
+    };
+
+    void GatherUploadSpans(const DdsView& view, std::vector<UploadSpan>& spans)
+    {
+        for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+        {
+            for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+            {
+                const DdsMipSpan& mip = view.GetMip(slice, level);
+                UploadSpan span = { mip.pData, mip.rowPitch };
+                spans.push_back(span);
+            }
+        }
+    }
+
+    bool SameTexture(const DdsView& a, const DdsView& b)
+    {
+        if (a.GetFormat() != b.GetFormat() || a.GetPixelLayout() != b.GetPixelLayout() ||
+            a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight() ||
+            a.GetMipCount() != b.GetMipCount() || a.GetArraySize() != b.GetArraySize() ||
+            a.IsCubemap() != b.IsCubemap())
+            return false;
+
+        for (uint32_t slice = 0; slice < a.GetArraySize(); ++slice)
+        {
+            for (uint32_t level = 0; level < a.GetMipCount(); ++level)
+            {
+                const DdsMipSpan& ma = a.GetMip(slice, level);
+                const DdsMipSpan& mb = b.GetMip(slice, level);
+                if (ma.size != mb.size || ma.rowPitch != mb.rowPitch || memcmp(ma.pData, mb.pData, ma.size) != 0)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Opens and reads everything iterations times; views end up open. open
+    // fills pViews and returns false on failure.
+    template<typename OpenFn>
+    bool TimeLoads(const std::vector<std::string>& files, uint32_t iterations, bool cold,
+        std::vector<DdsView>& views, OpenFn open, AssetArchiveBenchResult& result)
+    {
+        std::vector<UploadSpan> spans;
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            for (DdsView& view : views)
+                view.Close();
+            if (cold)
+            {
+                for (const std::string& file : files)
+                {
+                    if (!MappedFile::EvictFromPageCache(file.c_str()))
+                        return false;
+                }
+            }
+
+            spans.clear();
+            BenchClock::time_point start = BenchClock::now();
+            if (!open(views))
+                return false;
+            for (const DdsView& view : views)
+                GatherUploadSpans(view, spans);
+            BenchClock::time_point opened = BenchClock::now();
+            for (const DdsView& view : views)
+                view.Prefetch();
+            BenchClock::time_point read = BenchClock::now();
+
+            result.openMs += ElapsedMs(start, opened);
+            result.readMs += ElapsedMs(opened, read);
+        }
+
+        result.openMs /= iterations;
+        result.readMs /= iterations;
+        result.cold = cold;
+        result.files = (uint32_t)files.size();
+        result.textures = (uint32_t)views.size();
+        for (const DdsView& view : views)
+            result.bytes += view.GetMappedSize();
+        return true;
+    }
+}
+
+bool RunAssetArchiveBenchmark(const std::string* pLoosePaths, uint32_t fileCount, const char* archivePath,
+    uint32_t iterations, std::vector<AssetArchiveBenchResult>& results)
+{
+    std::vector<DdsView> loose(fileCount);
+    std::vector<std::string> names(fileCount);
+    std::vector<AssetCookSource> sources(fileCount);
+    for (uint32_t i = 0; i < fileCount; ++i)
+    {
+        if (!loose[i].Open(pLoosePaths[i].c_str()))
+            return false;
+        names[i] = "texture" + std::to_string(i);
+        sources[i].name = names[i].c_str();
+        sources[i].pViews = &loose[i];
+    }
+    if (!CookAssetArchive(archivePath, sources.data(), fileCount))
+        return false;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    const std::vector<std::string> looseFiles(pLoosePaths, pLoosePaths + fileCount);
+    const std::vector<std::string> archiveFiles(1, archivePath);
+    std::vector<DdsView> archived(fileCount);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const bool cold = pass == 0;
+#ifdef _WIN32
+        if (cold)
+            continue;
+#endif
+        AssetArchiveBenchResult separate;
+        separate.layout = "loose";
+        if (!TimeLoads(looseFiles, iterations, cold, loose, [&](std::vector<DdsView>& views) {
+                for (uint32_t i = 0; i < fileCount; ++i)
+                {
+                    if (!views[i].Open(pLoosePaths[i].c_str()))
+                        return false;
+                }
+                return true;
+            }, separate))
+            return false;
+        results.push_back(separate);
+
+        AssetArchiveBenchResult packed;
+        packed.layout = "archive";
+        if (!TimeLoads(archiveFiles, iterations, cold, archived, [&](std::vector<DdsView>& views) {
+                AssetArchive archive;
+                if (!archive.Open(archivePath))
+                    return false;
+                for (uint32_t i = 0; i < fileCount; ++i)
+                {
+                    if (!archive.OpenTexture(i, views[i]))
+                        return false;
+                }
+                return true;
+            }, packed))
+            return false;
+
+        for (uint32_t i = 0; i < fileCount; ++i)
+            packed.matchesLoose = packed.matchesLoose && SameTexture(archived[i], loose[i]);
+        results.push_back(packed);
+    }
+    return true;
+}
+
+bool WriteAssetArchiveBenchmarkCsv(const char* filename, const std::vector<AssetArchiveBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "layout,cache,files,textures,bytes,open_ms,read_ms,total_ms,matches_loose\n");
+    for (const AssetArchiveBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%s,%u,%u,%llu,%.4f,%.4f,%.4f,%d\n",
+            r.layout.c_str(), r.cold ? "cold" : "warm", r.files, r.textures, (unsigned long long)r.bytes,
+            r.openMs, r.readMs, r.openMs + r.readMs, r.matchesLoose ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "AssetArchive.h"
+#include <string>
+
+// Startup cost of getting a set of textures ready for upload: loose DDS
+// files, each mapped and its header parsed, against one cooked archive
+// whose entries come out of a prebuilt table. Opening (map, headers or
+// table, subresource spans) and reading (touching every page) are timed
+// separately. Warm runs read from the page cache; cold runs evict the files
+// first, which needs posix_fadvise, so they are left out on Windows.
+struct AssetArchiveBenchResult
+{
+    std::string layout;             // "loose" or "archive"
+    bool cold = false;
+    uint32_t files = 0;
+    uint32_t textures = 0;
+    uint64_t bytes = 0;
+    double openMs = 0.0;
+    double readMs = 0.0;
+    bool matchesLoose = true;       // the archive holds the loose files' bytes
+};
+
+// Cooks the loose files into archivePath, one entry per file, then times
+// both. Fails if a file cannot be opened or the archive cannot be written.
+bool RunAssetArchiveBenchmark(const std::string* pLoosePaths, uint32_t fileCount, const char* archivePath,
+    uint32_t iterations, std::vector<AssetArchiveBenchResult>& results);
+
+bool WriteAssetArchiveBenchmarkCsv(const char* filename, const std::vector<AssetArchiveBenchResult>& results);
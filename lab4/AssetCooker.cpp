@@ -0,0 +1,167 @@
+#include "AssetCooker.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    FILE* OpenFile(const char* path, const char* mode)
+    {
+        FILE* pFile = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&pFile, path, mode) != 0)
+            return nullptr;
+#else
+        pFile = fopen(path, mode);
+#endif
+        return pFile;
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Fills in everything about the entry but its offsets. Fails if the
+    // views don't make one texture.
+    bool DescribeEntry(const AssetCookSource& source, AssetArchiveEntry& entry)
+    {
+        if (!source.name || strlen(source.name) >= ASSET_ARCHIVE_NAME_SIZE || !source.pViews ||
+            source.viewCount == 0)
+            return false;
+
+        const DdsView& first = source.pViews[0];
+        uint64_t arraySize = 0;
+        for (uint32_t i = 0; i < source.viewCount; ++i)
+        {
+            const DdsView& view = source.pViews[i];
+            if (!view.IsOpen() || view.GetFormat() != first.GetFormat() ||
+                view.GetPixelLayout() != first.GetPixelLayout() ||
+                view.GetWidth() != first.GetWidth() || view.GetHeight() != first.GetHeight() ||
+                view.GetMipCount() != first.GetMipCount())
+                return false;
+            arraySize += view.GetArraySize();
+        }
+
+        const bool cubemap = source.viewCount == 1 ? first.IsCubemap() : source.cubemap;
+        if (arraySize > UINT32_MAX || (cubemap && arraySize % 6 != 0))
+            return false;
+
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, source.name, strlen(source.name));
+        entry.format = (uint32_t)first.GetFormat();
+        entry.layout = (uint32_t)first.GetPixelLayout();
+        entry.width = first.GetWidth();
+        entry.height = first.GetHeight();
+        entry.mipCount = first.GetMipCount();
+        entry.arraySize = (uint32_t)arraySize;
+        entry.flags = cubemap ? ASSET_ARCHIVE_CUBEMAP : 0;
+        return true;
+    }
+
+    bool WritePadding(FILE* pFile, uint64_t from, uint64_t to)
+    {
+        static const uint8_t zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+        while (from < to)
+        {
+            const size_t count = (size_t)(to - from < sizeof(zeros) ? to - from : sizeof(zeros));
+            if (fwrite(zeros, 1, count, pFile) != count)
+                return false;
+            from += count;
+        }
+        return true;
+    }
+}
+
+bool CookAssetArchive(const char* filename, const AssetCookSource* pSources, uint32_t sourceCount)
+{
+    // Lay the whole file out first; the table goes in front of the payloads.
+    std::vector<AssetArchiveEntry> entries(sourceCount);
+    std::vector<AssetArchiveSubresource> subresources;
+    for (uint32_t i = 0; i < sourceCount; ++i)
+    {
+        if (!DescribeEntry(pSources[i], entries[i]))
+            return false;
+        for (uint32_t j = 0; j < i; ++j)
+        {
+            if (strcmp(entries[i].name, entries[j].name) == 0)
+                return false;
+        }
+
+        entries[i].firstSubresource = (uint32_t)subresources.size();
+        for (uint32_t v = 0; v < pSources[i].viewCount; ++v)
+        {
+            const DdsView& view = pSources[i].pViews[v];
+            for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+            {
+                for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+                {
+                    const DdsMipSpan& mip = view.GetMip(slice, level);
+                    AssetArchiveSubresource sub = {};
+                    sub.size = mip.size;
+                    sub.rowPitch = mip.rowPitch;
+                    sub.width = mip.width;
+                    sub.height = mip.height;
+                    subresources.push_back(sub);
+                }
+            }
+        }
+    }
+
+    uint64_t offset = sizeof(AssetArchiveHeader) + entries.size() * sizeof(AssetArchiveEntry) +
+        subresources.size() * sizeof(AssetArchiveSubresource);
+    for (AssetArchiveEntry& entry : entries)
+    {
+        offset = AlignUp(offset, ASSET_ARCHIVE_ALIGNMENT);
+        entry.dataOffset = offset;
+        const uint32_t count = entry.arraySize * entry.mipCount;
+        for (uint32_t s = 0; s < count; ++s)
+        {
+            AssetArchiveSubresource& sub = subresources[entry.firstSubresource + s];
+            sub.offset = offset;
+            offset += sub.size;
+        }
+        entry.dataSize = offset - entry.dataOffset;
+    }
+
+    AssetArchiveHeader header = {};
+    header.magic = ASSET_ARCHIVE_MAGIC;
+    header.version = ASSET_ARCHIVE_VERSION;
+    header.entryCount = sourceCount;
+    header.subresourceCount = (uint32_t)subresources.size();
+    header.fileSize = offset;
+
+    FILE* pFile = OpenFile(filename, "wb");
+    if (!pFile)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+        (entries.empty() || fwrite(entries.data(), sizeof(AssetArchiveEntry), entries.size(), pFile) == entries.size()) &&
+        (subresources.empty() ||
+            fwrite(subresources.data(), sizeof(AssetArchiveSubresource), subresources.size(), pFile) == subresources.size());
+
+    uint64_t written = sizeof(AssetArchiveHeader) + entries.size() * sizeof(AssetArchiveEntry) +
+        subresources.size() * sizeof(AssetArchiveSubresource);
+    for (uint32_t i = 0; ok && i < sourceCount; ++i)
+    {
+        ok = WritePadding(pFile, written, entries[i].dataOffset);
+        written = entries[i].dataOffset;
+        for (uint32_t v = 0; ok && v < pSources[i].viewCount; ++v)
+        {
+            const DdsView& view = pSources[i].pViews[v];
+            for (uint32_t slice = 0; ok && slice < view.GetArraySize(); ++slice)
+            {
+                for (uint32_t level = 0; ok && level < view.GetMipCount(); ++level)
+                {
+                    const DdsMipSpan& mip = view.GetMip(slice, level);
+                    ok = fwrite(mip.pData, 1, mip.size, pFile) == mip.size;
+                    written += mip.size;
+                }
+            }
+        }
+    }
+
+    ok = fclose(pFile) == 0 && ok;
+    if (!ok)
+        remove(filename);
+    return ok;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "AssetArchive.h"
+
+// One archive entry: the slices of views, back to back, under name. Views
+// must agree on format, size and mip count. A single view keeps its own
+// array size and cube flag; six single-surface views with cubemap set make
+// a cube map, the way WriteDdsSlices() packs one.
+struct AssetCookSource
+{
+    const char* name = nullptr;
+    const DdsView* pViews = nullptr;
+    uint32_t viewCount = 1;
+    bool cubemap = false;
+};
+
+// Writes every source into one archive at filename. Each payload starts on
+// a page boundary and its subresource table is filled in here, so the
+// runtime never computes a mip size. Names must be unique and shorter than
+// ASSET_ARCHIVE_NAME_SIZE.
+bool CookAssetArchive(const char* filename, const AssetCookSource* pSources, uint32_t sourceCount);
@@ -0,0 +1,65 @@
+#pragma once
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Timing, stand-in handle and CSV helpers shared by the *Bench.cpp files.
+
+typedef std::chrono::steady_clock BenchClock;
+
+inline double ElapsedNs(BenchClock::time_point start, BenchClock::time_point end)
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+inline double ElapsedUs(BenchClock::time_point start, BenchClock::time_point end)
+{
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+inline double ElapsedMs(BenchClock::time_point start, BenchClock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+inline double ElapsedSeconds(BenchClock::time_point start, BenchClock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+const uint32_t FAKE_HANDLE_COUNT = 8192;
+
+// Distinct addresses standing in for D3D11 objects when commands go to a
+// recording context. They are compared, never dereferenced.
+inline const char* GetFakeHandleBase()
+{
+    static char s_handles[FAKE_HANDLE_COUNT];
+    return s_handles;
+}
+
+template<typename T>
+T* FakeHandle(uint32_t index)
+{
+    assert(index < FAKE_HANDLE_COUNT);
+    return (T*)(GetFakeHandleBase() + index);
+}
+
+// Index FakeHandle() was given for pHandle.
+inline uint32_t GetFakeHandleIndex(const void* pHandle)
+{
+    return (uint32_t)((const char*)pHandle - GetFakeHandleBase());
+}
+
+// Opens filename for writing a results table; nullptr on failure.
+inline FILE* OpenBenchCsv(const char* filename)
+{
+    FILE* pFile = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&pFile, filename, "w") != 0)
+        return nullptr;
+#else
+    pFile = fopen(filename, "w");
+#endif
+    return pFile;
+}
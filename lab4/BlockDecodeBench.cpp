@@ -0,0 +1,78 @@
+#include "BlockDecodeBench.h"
+#include "BenchUtil.h"
+#include "LoadScheduler.h"
+#include <cstdio>
+
+void RunBlockDecodeBenchmark(const DdsView* pViews, const char* const* pNames, uint32_t viewCount,
+    uint32_t iterations, std::vector<BlockDecodeBenchResult>& results)
+{
+    const BlockDecodeKernel kernels[] = { BLOCK_DECODE_SCALAR, BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    LoadScheduler scheduler(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> decoded;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    for (uint32_t v = 0; v < viewCount; ++v)
+    {
+        const DdsView& view = pViews[v];
+        if (!view.IsOpen() || !IsBlockDecodeFormat(view.GetFormat()))
+            continue;
+
+        const DdsMipSpan& mip = view.GetMip(0);
+        const double blockCount = (double)((mip.width + 3) / 4) * ((mip.height + 3) / 4);
+        DecodeDdsMip(view, 0, reference, BLOCK_DECODE_SCALAR);
+
+        for (BlockDecodeKernel kernel : kernels)
+        {
+            if (!IsBlockDecodeKernelSupported(kernel))
+                continue;
+
+            for (int threaded = 0; threaded < 2; ++threaded)
+            {
+                LoadScheduler* pScheduler = threaded ? &scheduler : nullptr;
+
+                decoded.assign(reference.size(), 0);
+                DecodeDdsMip(view, 0, decoded, kernel, pScheduler);
+
+                BenchClock::time_point start = BenchClock::now();
+                for (uint32_t it = 0; it < iterations; ++it)
+                    DecodeDdsMip(view, 0, decoded, kernel, pScheduler);
+                double seconds = ElapsedSeconds(start, BenchClock::now()) / iterations;
+
+                BlockDecodeBenchResult result;
+                result.name = pNames[v];
+                result.width = mip.width;
+                result.height = mip.height;
+                result.kernel = kernel;
+                result.threads = threaded ? scheduler.GetWorkerCount() + 1 : 1;
+                result.inMBps = mip.size / seconds / (1024.0 * 1024.0);
+                result.outMBps = reference.size() / seconds / (1024.0 * 1024.0);
+                result.blocksPerSecond = blockCount / seconds;
+                result.matchesScalar = decoded == reference;
+                results.push_back(result);
+            }
+        }
+    }
+}
+
+bool WriteBlockDecodeBenchmarkCsv(const char* filename, const std::vector<BlockDecodeBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "texture,width,height,kernel,threads,in_mb_s,out_mb_s,blocks_s,matches_scalar\n");
+    for (const BlockDecodeBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%u,%u,%s,%u,%.1f,%.1f,%.0f,%d\n",
+            r.name.c_str(), r.width, r.height, GetBlockDecodeKernelName(r.kernel), r.threads,
+            r.inMBps, r.outMBps, r.blocksPerSecond, r.matchesScalar ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "BlockDecoder.h"
+#include <string>
+
+// Decode throughput of mip 0 of one texture for one kernel and thread
+// count. outMBps counts decoded RGBA8 bytes, inMBps compressed bytes read.
+struct BlockDecodeBenchResult
+{
+    std::string name;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    BlockDecodeKernel kernel = BLOCK_DECODE_SCALAR;
+    unsigned threads = 1;
+    double inMBps = 0.0;
+    double outMBps = 0.0;
+    double blocksPerSecond = 0.0;
+    bool matchesScalar = true;
+};
+
+// Runs every supported kernel single-threaded and on all hardware threads
+// for each view. Views that are not BC1-BC3 are skipped.
+void RunBlockDecodeBenchmark(const DdsView* pViews, const char* const* pNames, uint32_t viewCount,
+    uint32_t iterations, std::vector<BlockDecodeBenchResult>& results);
+
+bool WriteBlockDecodeBenchmarkCsv(const char* filename, const std::vector<BlockDecodeBenchResult>& results);
@@ -0,0 +1,479 @@
+#include "BlockDecoder.h"
+#include "LoadScheduler.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BLOCK_DECODE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BLOCK_TARGET_SSE41
+#define BLOCK_TARGET_AVX2
+#elif defined(__GNUC__)
+#define BLOCK_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define BLOCK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// The palette builders are inlined into every kernel so the compiler encodes
+// them for that kernel's instruction set; an out-of-line SSE copy called from
+// the AVX2 loop pays a state transition on every block.
+#if defined(_MSC_VER)
+#define BLOCK_INLINE __forceinline
+#else
+#define BLOCK_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace
+{
+    enum BlockKind
+    {
+        KIND_BC1,
+        KIND_BC2,
+        KIND_BC3
+    };
+
+    inline uint32_t PackRGBA(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    inline uint32_t Load32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    inline uint64_t Load64(const uint8_t* p)
+    {
+        return (uint64_t)Load32(p) | ((uint64_t)Load32(p + 4) << 32);
+    }
+
+    // Color half of a block (8 bytes) to four RGBA8 entries. BC2/BC3 always
+    // use four-color mode; BC1 switches to three colors plus transparent
+    // black when c0 <= c1.
+    BLOCK_INLINE void BuildColorPalette(const uint8_t* pColor, bool fourColorOnly, uint32_t palette[4])
+    {
+        uint32_t c0 = pColor[0] | (pColor[1] << 8);
+        uint32_t c1 = pColor[2] | (pColor[3] << 8);
+
+        uint32_t r0 = (c0 >> 11) & 31, g0 = (c0 >> 5) & 63, b0 = c0 & 31;
+        uint32_t r1 = (c1 >> 11) & 31, g1 = (c1 >> 5) & 63, b1 = c1 & 31;
+        r0 = (r0 << 3) | (r0 >> 2); g0 = (g0 << 2) | (g0 >> 4); b0 = (b0 << 3) | (b0 >> 2);
+        r1 = (r1 << 3) | (r1 >> 2); g1 = (g1 << 2) | (g1 >> 4); b1 = (b1 << 3) | (b1 >> 2);
+
+        palette[0] = PackRGBA(r0, g0, b0, 255);
+        palette[1] = PackRGBA(r1, g1, b1, 255);
+        if (c0 > c1 || fourColorOnly)
+        {
+            palette[2] = PackRGBA((2 * r0 + r1 + 1) / 3, (2 * g0 + g1 + 1) / 3, (2 * b0 + b1 + 1) / 3, 255);
+            palette[3] = PackRGBA((r0 + 2 * r1 + 1) / 3, (g0 + 2 * g1 + 1) / 3, (b0 + 2 * b1 + 1) / 3, 255);
+        }
+        else
+        {
+            palette[2] = PackRGBA((r0 + r1 + 1) / 2, (g0 + g1 + 1) / 2, (b0 + b1 + 1) / 2, 255);
+            palette[3] = 0;
+        }
+    }
+
+    // BC3 alpha endpoints to the eight-entry alpha table.
+    BLOCK_INLINE void BuildAlphaPalette(const uint8_t* pAlpha, uint8_t palette[8])
+    {
+        uint32_t a0 = pAlpha[0];
+        uint32_t a1 = pAlpha[1];
+        palette[0] = (uint8_t)a0;
+        palette[1] = (uint8_t)a1;
+        if (a0 > a1)
+        {
+            for (uint32_t k = 1; k < 7; ++k)
+                palette[k + 1] = (uint8_t)(((7 - k) * a0 + k * a1 + 3) / 7);
+        }
+        else
+        {
+            for (uint32_t k = 1; k < 5; ++k)
+                palette[k + 1] = (uint8_t)(((5 - k) * a0 + k * a1 + 2) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // One block to 16 pixels, row-major.
+    void DecodeBlockScalar(BlockKind kind, const uint8_t* pBlock, uint32_t* pOut)
+    {
+        const uint8_t* pColor = kind == KIND_BC1 ? pBlock : pBlock + 8;
+        uint32_t palette[4];
+        BuildColorPalette(pColor, kind != KIND_BC1, palette);
+
+        uint32_t indices = Load32(pColor + 4);
+        for (uint32_t p = 0; p < 16; ++p)
+            pOut[p] = palette[(indices >> (2 * p)) & 3];
+
+        if (kind == KIND_BC2)
+        {
+            uint64_t alpha = Load64(pBlock);
+            for (uint32_t p = 0; p < 16; ++p)
+            {
+                uint32_t a = (uint32_t)(alpha >> (4 * p)) & 15;
+                pOut[p] = (pOut[p] & 0x00FFFFFF) | ((a * 17) << 24);
+            }
+        }
+        else if (kind == KIND_BC3)
+        {
+            uint8_t alphaPalette[8];
+            BuildAlphaPalette(pBlock, alphaPalette);
+            uint64_t alpha = Load64(pBlock) >> 16;
+            for (uint32_t p = 0; p < 16; ++p)
+            {
+                uint32_t a = alphaPalette[(alpha >> (3 * p)) & 7];
+                pOut[p] = (pOut[p] & 0x00FFFFFF) | (a << 24);
+            }
+        }
+    }
+
+    // Decodes blocks [firstBlock, blockCount) of one block row, clipped to
+    // the pixels that exist.
+    void DecodeRowScalar(BlockKind kind, const uint8_t* pRow, uint32_t blockBytes,
+        uint32_t firstBlock, uint32_t blockCount, uint32_t width, uint32_t rows,
+        uint8_t* pDst, uint32_t dstRowPitch)
+    {
+        uint32_t pixels[16];
+        for (uint32_t bx = firstBlock; bx < blockCount; ++bx)
+        {
+            DecodeBlockScalar(kind, pRow + bx * blockBytes, pixels);
+
+            uint32_t columns = width - bx * 4 < 4 ? width - bx * 4 : 4;
+            for (uint32_t y = 0; y < rows; ++y)
+                memcpy(pDst + y * dstRowPitch + bx * 16, pixels + y * 4, columns * 4);
+        }
+    }
+
+#ifdef BLOCK_DECODE_SIMD
+
+    bool CpuHasSse41()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1") != 0;
+#endif
+    }
+
+    bool CpuHasAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX state must be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2).
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+
+    // Per-lane variable shifts are done by multiplying the field up to the
+    // top of the lane and shifting it back down by a fixed amount.
+    BLOCK_TARGET_SSE41
+    inline __m128i ExtractFields(uint32_t bits, __m128i multipliers, int fieldShift)
+    {
+        return _mm_srli_epi32(_mm_mullo_epi32(_mm_set1_epi32((int)bits), multipliers), fieldShift);
+    }
+
+    template<int KIND>
+    BLOCK_TARGET_SSE41
+    uint32_t DecodeRowSse41(const uint8_t* pRow, uint32_t blockCount, uint8_t* pDst, uint32_t dstRowPitch)
+    {
+        const uint32_t blockBytes = KIND == KIND_BC1 ? 8 : 16;
+        // Lane j of row r holds the 2-bit index at bit 8r + 2j.
+        const __m128i colorMul = _mm_setr_epi32(1 << 30, 1 << 28, 1 << 26, 1 << 24);
+        const __m128i byteSpread = _mm_set1_epi32(0x04040404);
+        const __m128i byteOffsets = _mm_set1_epi32(0x03020100);
+        const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+        // Lane j holds the 4-bit (BC2) or 3-bit (BC3) alpha field of pixel j.
+        const __m128i nibbleMul = _mm_setr_epi32(1 << 28, 1 << 24, 1 << 20, 1 << 16);
+        const __m128i alphaMul = _mm_setr_epi32(1 << 29, 1 << 26, 1 << 23, 1 << 20);
+        const __m128i alphaSelect = _mm_set1_epi32((int)0x80808000);
+
+        for (uint32_t bx = 0; bx < blockCount; ++bx)
+        {
+            const uint8_t* pBlock = pRow + bx * blockBytes;
+            const uint8_t* pColor = KIND == KIND_BC1 ? pBlock : pBlock + 8;
+
+            uint32_t palette[4];
+            BuildColorPalette(pColor, KIND != KIND_BC1, palette);
+            __m128i colors = _mm_loadu_si128((const __m128i*)palette);
+
+            __m128i alphaTable = _mm_setzero_si128();
+            uint64_t alphaBits = 0;
+            if (KIND == KIND_BC3)
+            {
+                uint8_t alphaPalette[8];
+                BuildAlphaPalette(pBlock, alphaPalette);
+                alphaTable = _mm_loadl_epi64((const __m128i*)alphaPalette);
+                alphaBits = Load64(pBlock) >> 16;
+            }
+            else if (KIND == KIND_BC2)
+            {
+                alphaBits = Load64(pBlock);
+            }
+
+            uint32_t indices = Load32(pColor + 4);
+            uint8_t* pOut = pDst + bx * 16;
+            for (int r = 0; r < 4; ++r)
+            {
+                __m128i index = ExtractFields(indices >> (8 * r), colorMul, 30);
+                __m128i control = _mm_add_epi32(_mm_mullo_epi32(index, byteSpread), byteOffsets);
+                __m128i pixels = _mm_shuffle_epi8(colors, control);
+
+                if (KIND == KIND_BC2)
+                {
+                    __m128i a = ExtractFields((uint32_t)(alphaBits >> (16 * r)), nibbleMul, 28);
+                    a = _mm_or_si128(a, _mm_slli_epi32(a, 4));
+                    pixels = _mm_or_si128(_mm_and_si128(pixels, rgbMask), _mm_slli_epi32(a, 24));
+                }
+                else if (KIND == KIND_BC3)
+                {
+                    __m128i a = ExtractFields((uint32_t)(alphaBits >> (12 * r)), alphaMul, 29);
+                    a = _mm_shuffle_epi8(alphaTable, _mm_or_si128(a, alphaSelect));
+                    pixels = _mm_or_si128(_mm_and_si128(pixels, rgbMask), _mm_slli_epi32(a, 24));
+                }
+
+                _mm_storeu_si128((__m128i*)(pOut + r * dstRowPitch), pixels);
+            }
+        }
+        return blockCount;
+    }
+
+    BLOCK_TARGET_AVX2
+    inline __m256i Broadcast2(uint32_t a, uint32_t b)
+    {
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32((int)a)), _mm_set1_epi32((int)b), 1);
+    }
+
+    // Two neighbouring blocks per step: block A in the low 128-bit lane and
+    // block B in the high one, so every row of the pair is 8 contiguous
+    // pixels and one store.
+    template<int KIND>
+    BLOCK_TARGET_AVX2
+    uint32_t DecodeRowAvx2(const uint8_t* pRow, uint32_t blockCount, uint8_t* pDst, uint32_t dstRowPitch)
+    {
+        const uint32_t blockBytes = KIND == KIND_BC1 ? 8 : 16;
+        const __m256i colorShift = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        const __m256i nibbleShift = _mm256_setr_epi32(0, 4, 8, 12, 0, 4, 8, 12);
+        const __m256i alphaShift = _mm256_setr_epi32(0, 3, 6, 9, 0, 3, 6, 9);
+        const __m256i three = _mm256_set1_epi32(3);
+        const __m256i fifteen = _mm256_set1_epi32(15);
+        const __m256i seven = _mm256_set1_epi32(7);
+        const __m256i byteSpread = _mm256_set1_epi32(0x04040404);
+        const __m256i byteOffsets = _mm256_set1_epi32(0x03020100);
+        const __m256i rgbMask = _mm256_set1_epi32(0x00FFFFFF);
+        const __m256i alphaSelect = _mm256_set1_epi32((int)0x80808000);
+
+        uint32_t bx = 0;
+        for (; bx + 2 <= blockCount; bx += 2)
+        {
+            const uint8_t* pBlockA = pRow + bx * blockBytes;
+            const uint8_t* pBlockB = pBlockA + blockBytes;
+            const uint8_t* pColorA = KIND == KIND_BC1 ? pBlockA : pBlockA + 8;
+            const uint8_t* pColorB = KIND == KIND_BC1 ? pBlockB : pBlockB + 8;
+
+            uint32_t palette[8];
+            BuildColorPalette(pColorA, KIND != KIND_BC1, palette);
+            BuildColorPalette(pColorB, KIND != KIND_BC1, palette + 4);
+            __m256i colors = _mm256_loadu_si256((const __m256i*)palette);
+
+            __m256i alphaTable = _mm256_setzero_si256();
+            uint64_t alphaA = 0, alphaB = 0;
+            if (KIND == KIND_BC3)
+            {
+                uint8_t alphaPalette[32] = {};
+                BuildAlphaPalette(pBlockA, alphaPalette);
+                BuildAlphaPalette(pBlockB, alphaPalette + 16);
+                alphaTable = _mm256_loadu_si256((const __m256i*)alphaPalette);
+                alphaA = Load64(pBlockA) >> 16;
+                alphaB = Load64(pBlockB) >> 16;
+            }
+            else if (KIND == KIND_BC2)
+            {
+                alphaA = Load64(pBlockA);
+                alphaB = Load64(pBlockB);
+            }
+
+            uint32_t indicesA = Load32(pColorA + 4);
+            uint32_t indicesB = Load32(pColorB + 4);
+            uint8_t* pOut = pDst + bx * 16;
+            for (int r = 0; r < 4; ++r)
+            {
+                __m256i index = Broadcast2(indicesA >> (8 * r), indicesB >> (8 * r));
+                index = _mm256_and_si256(_mm256_srlv_epi32(index, colorShift), three);
+                __m256i control = _mm256_add_epi32(_mm256_mullo_epi32(index, byteSpread), byteOffsets);
+                __m256i pixels = _mm256_shuffle_epi8(colors, control);
+
+                if (KIND == KIND_BC2)
+                {
+                    __m256i a = Broadcast2((uint32_t)(alphaA >> (16 * r)), (uint32_t)(alphaB >> (16 * r)));
+                    a = _mm256_and_si256(_mm256_srlv_epi32(a, nibbleShift), fifteen);
+                    a = _mm256_or_si256(a, _mm256_slli_epi32(a, 4));
+                    pixels = _mm256_or_si256(_mm256_and_si256(pixels, rgbMask), _mm256_slli_epi32(a, 24));
+                }
+                else if (KIND == KIND_BC3)
+                {
+                    __m256i a = Broadcast2((uint32_t)(alphaA >> (12 * r)), (uint32_t)(alphaB >> (12 * r)));
+                    a = _mm256_and_si256(_mm256_srlv_epi32(a, alphaShift), seven);
+                    a = _mm256_shuffle_epi8(alphaTable, _mm256_or_si256(a, alphaSelect));
+                    pixels = _mm256_or_si256(_mm256_and_si256(pixels, rgbMask), _mm256_slli_epi32(a, 24));
+                }
+
+                _mm256_storeu_si256((__m256i*)(pOut + r * dstRowPitch), pixels);
+            }
+        }
+        return bx;
+    }
+
+    template<int KIND>
+    uint32_t DecodeRowSimd(BlockDecodeKernel kernel, const uint8_t* pRow, uint32_t blockCount,
+        uint8_t* pDst, uint32_t dstRowPitch)
+    {
+        if (kernel == BLOCK_DECODE_AVX2)
+            return DecodeRowAvx2<KIND>(pRow, blockCount, pDst, dstRowPitch);
+        if (kernel == BLOCK_DECODE_SSE41)
+            return DecodeRowSse41<KIND>(pRow, blockCount, pDst, dstRowPitch);
+        return 0;
+    }
+
+#endif
+
+    BlockKind GetBlockKind(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC2_UNORM: return KIND_BC2;
+        case DXGI_FORMAT_BC3_UNORM: return KIND_BC3;
+        default: return KIND_BC1;
+        }
+    }
+}
+
+bool IsBlockDecodeKernelSupported(BlockDecodeKernel kernel)
+{
+    switch (kernel)
+    {
+    case BLOCK_DECODE_SCALAR:
+    case BLOCK_DECODE_BEST:
+        return true;
+#ifdef BLOCK_DECODE_SIMD
+    case BLOCK_DECODE_SSE41:
+    {
+        static const bool s_hasSse41 = CpuHasSse41();
+        return s_hasSse41;
+    }
+    case BLOCK_DECODE_AVX2:
+    {
+        static const bool s_hasAvx2 = CpuHasAvx2();
+        return s_hasAvx2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+BlockDecodeKernel ResolveBlockDecodeKernel(BlockDecodeKernel kernel)
+{
+    if (kernel == BLOCK_DECODE_BEST)
+    {
+        if (IsBlockDecodeKernelSupported(BLOCK_DECODE_AVX2))
+            return BLOCK_DECODE_AVX2;
+        if (IsBlockDecodeKernelSupported(BLOCK_DECODE_SSE41))
+            return BLOCK_DECODE_SSE41;
+        return BLOCK_DECODE_SCALAR;
+    }
+    return IsBlockDecodeKernelSupported(kernel) ? kernel : BLOCK_DECODE_SCALAR;
+}
+
+const char* GetBlockDecodeKernelName(BlockDecodeKernel kernel)
+{
+    switch (kernel)
+    {
+    case BLOCK_DECODE_SCALAR: return "scalar";
+    case BLOCK_DECODE_SSE41: return "sse4.1";
+    case BLOCK_DECODE_AVX2: return "avx2";
+    case BLOCK_DECODE_BEST: return "best";
+    default: return "unknown";
+    }
+}
+
+bool IsBlockDecodeFormat(DXGI_FORMAT fmt)
+{
+    return fmt == DXGI_FORMAT_BC1_UNORM || fmt == DXGI_FORMAT_BC2_UNORM || fmt == DXGI_FORMAT_BC3_UNORM;
+}
+
+void DecodeBlockRows(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint32_t firstRow, uint32_t rowCount,
+    uint8_t* pDst, uint32_t dstRowPitch, BlockDecodeKernel kernel)
+{
+    const BlockKind kind = GetBlockKind(fmt);
+    const uint32_t blockBytes = DdsBytesPerBlock(fmt);
+    const uint32_t blocksWide = (width + 3) / 4;
+    kernel = ResolveBlockDecodeKernel(kernel);
+
+    for (uint32_t by = firstRow; by < firstRow + rowCount; ++by)
+    {
+        const uint8_t* pRow = pSrc + (size_t)by * srcRowPitch;
+        uint8_t* pOut = pDst + (size_t)by * 4 * dstRowPitch;
+        uint32_t rows = height - by * 4 < 4 ? height - by * 4 : 4;
+
+        // SIMD kernels write whole 4x4 blocks; partial blocks on the right
+        // and bottom edges go through the clipped scalar path.
+        uint32_t done = 0;
+#ifdef BLOCK_DECODE_SIMD
+        if (rows == 4 && kernel != BLOCK_DECODE_SCALAR)
+        {
+            uint32_t fullBlocks = width / 4;
+            switch (kind)
+            {
+            case KIND_BC1: done = DecodeRowSimd<KIND_BC1>(kernel, pRow, fullBlocks, pOut, dstRowPitch); break;
+            case KIND_BC2: done = DecodeRowSimd<KIND_BC2>(kernel, pRow, fullBlocks, pOut, dstRowPitch); break;
+            case KIND_BC3: done = DecodeRowSimd<KIND_BC3>(kernel, pRow, fullBlocks, pOut, dstRowPitch); break;
+            }
+        }
+#endif
+        DecodeRowScalar(kind, pRow, blockBytes, done, blocksWide, width, rows, pOut, dstRowPitch);
+    }
+}
+
+bool DecodeBlockSurface(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint8_t* pDst, uint32_t dstRowPitch,
+    BlockDecodeKernel kernel, LoadScheduler* pScheduler)
+{
+    if (!IsBlockDecodeFormat(fmt) || !pSrc || !pDst || width == 0 || height == 0)
+        return false;
+
+    const uint32_t blockRows = (height + 3) / 4;
+    ParallelForChunks(pScheduler, blockRows, [=](uint32_t first, uint32_t count) {
+        DecodeBlockRows(fmt, pSrc, srcRowPitch, width, height, first, count, pDst, dstRowPitch, kernel);
+    });
+    return true;
+}
+
+bool DecodeDdsMip(const DdsView& view, uint32_t level, std::vector<uint8_t>& rgba,
+    BlockDecodeKernel kernel, LoadScheduler* pScheduler)
+{
+    if (!view.IsOpen() || level >= view.GetMipCount() || !IsBlockDecodeFormat(view.GetFormat()))
+        return false;
+
+    const DdsMipSpan& mip = view.GetMip(level);
+    rgba.resize((size_t)mip.width * mip.height * 4);
+    return DecodeBlockSurface(view.GetFormat(), mip.pData, mip.rowPitch, mip.width, mip.height,
+        rgba.data(), mip.width * 4, kernel, pScheduler);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "DdsView.h"
+
+class LoadScheduler;
+
+// CPU decoder for the legacy block-compressed formats (BC1/DXT1, BC2/DXT3,
+// BC3/DXT5). Output is RGBA8, four bytes per pixel in R, G, B, A
+// order. Used for previews, image comparisons and for devices that can't
+// sample BC textures.
+enum BlockDecodeKernel
+{
+    BLOCK_DECODE_SCALAR,
+    BLOCK_DECODE_SSE41,     // one block per step, pshufb palette lookup
+    BLOCK_DECODE_AVX2,      // two neighbouring blocks per step
+    BLOCK_DECODE_BEST       // widest kernel the CPU supports
+};
+
+bool IsBlockDecodeKernelSupported(BlockDecodeKernel kernel);
+BlockDecodeKernel ResolveBlockDecodeKernel(BlockDecodeKernel kernel);
+const char* GetBlockDecodeKernelName(BlockDecodeKernel kernel);
+
+bool IsBlockDecodeFormat(DXGI_FORMAT fmt);
+
+// Decodes block rows [firstRow, firstRow + rowCount) of a width x height
+// surface. pSrc and pDst both point at the start of the surface; pixels
+// outside width/height are not written. All kernels give identical output.
+void DecodeBlockRows(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint32_t firstRow, uint32_t rowCount,
+    uint8_t* pDst, uint32_t dstRowPitch, BlockDecodeKernel kernel = BLOCK_DECODE_BEST);
+
+// Decodes a whole surface. With a scheduler the block rows are split into
+// chunks that its workers and the calling thread pull until none are left;
+// the call returns once every row is written.
+bool DecodeBlockSurface(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint8_t* pDst, uint32_t dstRowPitch,
+    BlockDecodeKernel kernel = BLOCK_DECODE_BEST, LoadScheduler* pScheduler = nullptr);
+
+// Decodes one mip of a mapped DDS file into a tightly packed RGBA8 image.
+bool DecodeDdsMip(const DdsView& view, uint32_t level, std::vector<uint8_t>& rgba,
+    BlockDecodeKernel kernel = BLOCK_DECODE_BEST, LoadScheduler* pScheduler = nullptr);
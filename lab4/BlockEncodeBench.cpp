@@ -0,0 +1,123 @@
+#include "BlockEncodeBench.h"
+#include "BenchUtil.h"
+#include "LoadScheduler.h"
+#include "PixelConverter.h"
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    double ComputePsnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, uint32_t channels)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < a.size(); i += 4)
+        {
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                double d = (double)a[i + c] - (double)b[i + c];
+                sum += d * d;
+            }
+        }
+        double mse = sum / ((double)(a.size() / 4) * channels);
+        return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+    }
+}
+
+void RunBlockEncodeBenchmark(const DdsView* pViews, const char* const* pNames, uint32_t viewCount,
+    uint32_t iterations, std::vector<BlockEncodeBenchResult>& results)
+{
+    const DXGI_FORMAT formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM };
+    const BlockEncodeQuality qualities[] = { BLOCK_ENCODE_FAST, BLOCK_ENCODE_HIGH };
+    const BlockDecodeKernel kernels[] = { BLOCK_DECODE_SCALAR, BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    LoadScheduler scheduler(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+    std::vector<uint8_t> source;
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> decoded;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    for (uint32_t v = 0; v < viewCount; ++v)
+    {
+        const DdsView& view = pViews[v];
+        if (!view.IsOpen())
+            continue;
+        const bool ok = view.GetPixelLayout() == DDS_PIXELS_BLOCK ?
+            DecodeDdsMip(view, 0, source) : ConvertDdsMip(view, 0, 0, source);
+        if (!ok)
+            continue;
+
+        const DdsMipSpan& mip = view.GetMip(0);
+        for (DXGI_FORMAT format : formats)
+        {
+            uint32_t rowPitch, rowCount;
+            DdsGetMipLayout(format, mip.width, mip.height, rowPitch, rowCount);
+            reference.resize((size_t)rowPitch * rowCount);
+            encoded.resize(reference.size());
+            decoded.resize(source.size());
+
+            for (BlockEncodeQuality quality : qualities)
+            {
+                EncodeBlockSurface(format, source.data(), mip.width * 4, mip.width, mip.height,
+                    reference.data(), rowPitch, quality, BLOCK_DECODE_SCALAR);
+                DecodeBlockSurface(format, reference.data(), rowPitch, mip.width, mip.height,
+                    decoded.data(), mip.width * 4);
+                const double psnr = ComputePsnr(source, decoded, format == DXGI_FORMAT_BC3_UNORM ? 4 : 3);
+
+                for (BlockDecodeKernel kernel : kernels)
+                {
+                    if (!IsBlockDecodeKernelSupported(kernel))
+                        continue;
+
+                    for (int threaded = 0; threaded < 2; ++threaded)
+                    {
+                        LoadScheduler* pScheduler = threaded ? &scheduler : nullptr;
+
+                        BenchClock::time_point start = BenchClock::now();
+                        for (uint32_t it = 0; it < iterations; ++it)
+                        {
+                            EncodeBlockSurface(format, source.data(), mip.width * 4, mip.width, mip.height,
+                                encoded.data(), rowPitch, quality, kernel, pScheduler);
+                        }
+                        double seconds = ElapsedSeconds(start, BenchClock::now()) / iterations;
+
+                        BlockEncodeBenchResult result;
+                        result.name = pNames[v];
+                        result.width = mip.width;
+                        result.height = mip.height;
+                        result.format = format;
+                        result.quality = quality;
+                        result.kernel = kernel;
+                        result.threads = threaded ? scheduler.GetWorkerCount() + 1 : 1;
+                        result.mpixelsPerSecond = (double)mip.width * mip.height / seconds / 1e6;
+                        result.psnr = psnr;
+                        result.matchesScalar = encoded == reference;
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool WriteBlockEncodeBenchmarkCsv(const char* filename, const std::vector<BlockEncodeBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "texture,width,height,format,quality,kernel,threads,mpixels_s,psnr_db,matches_scalar\n");
+    for (const BlockEncodeBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%u,%u,%s,%s,%s,%u,%.1f,%.2f,%d\n",
+            r.name.c_str(), r.width, r.height, r.format == DXGI_FORMAT_BC3_UNORM ? "bc3" : "bc1",
+            GetBlockEncodeQualityName(r.quality), GetBlockDecodeKernelName(r.kernel), r.threads,
+            r.mpixelsPerSecond, r.psnr, r.matchesScalar ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "BlockEncoder.h"
+#include <string>
+
+// Encode throughput and quality of mip 0 of one texture for one format,
+// quality, kernel and thread count. The source is the texture decoded to
+// RGBA8; psnr compares it with the encoded result decoded again, over RGB
+// for BC1 and RGBA for BC3.
+struct BlockEncodeBenchResult
+{
+    std::string name;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    BlockEncodeQuality quality = BLOCK_ENCODE_FAST;
+    BlockDecodeKernel kernel = BLOCK_DECODE_SCALAR;
+    unsigned threads = 1;
+    double mpixelsPerSecond = 0.0;
+    double psnr = 0.0;
+    bool matchesScalar = true;
+};
+
+// Runs BC1 and BC3 in both qualities with every supported kernel,
+// single-threaded and on all hardware threads, for each view. Views that
+// can be neither decoded nor converted are skipped.
+void RunBlockEncodeBenchmark(const DdsView* pViews, const char* const* pNames, uint32_t viewCount,
+    uint32_t iterations, std::vector<BlockEncodeBenchResult>& results);
+
+bool WriteBlockEncodeBenchmarkCsv(const char* filename, const std::vector<BlockEncodeBenchResult>& results);
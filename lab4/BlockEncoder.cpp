@@ -0,0 +1,789 @@
+#include "BlockEncoder.h"
+#include "DdsWriter.h"
+#include "LoadScheduler.h"
+#include "PixelConverter.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BLOCK_ENCODE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define BLOCK_TARGET_SSE41
+#define BLOCK_TARGET_AVX2
+#elif defined(__GNUC__)
+#define BLOCK_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define BLOCK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    // Endpoints and the palette they decode to, in the decoder's order: c0,
+    // c1, then the two points between them, or the midpoint and transparent
+    // black in three-color mode.
+    struct ColorPalette
+    {
+        uint32_t c0;
+        uint32_t c1;
+        int rgb[4][3];
+    };
+
+    // Dot products with the endpoint direction, doubled, below which a
+    // pixel takes c1, the point next to c1, and the point next to c0.
+    struct Projection
+    {
+        int dir[3];
+        int thresholds[3];
+    };
+
+    struct ColorCandidate
+    {
+        ColorPalette palette;
+        uint32_t indices;
+        uint32_t error;
+    };
+
+    inline int Clamp255(int v)
+    {
+        return v < 0 ? 0 : (v > 255 ? 255 : v);
+    }
+
+    inline uint32_t QuantizeTo565(int r, int g, int b)
+    {
+        return (uint32_t)((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+    }
+
+    void Expand565(uint32_t c, int rgb[3])
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // Orders the endpoints for the mode (c0 > c1 selects four colors in BC1)
+    // and builds the palette with the decoder's rounding.
+    void BuildPalette(uint32_t a, uint32_t b, bool fourColor, ColorPalette& palette)
+    {
+        if (fourColor ? a < b : a > b)
+        {
+            uint32_t t = a;
+            a = b;
+            b = t;
+        }
+        palette.c0 = a;
+        palette.c1 = b;
+        Expand565(a, palette.rgb[0]);
+        Expand565(b, palette.rgb[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            const int p0 = palette.rgb[0][c], p1 = palette.rgb[1][c];
+            palette.rgb[2][c] = fourColor ? (2 * p0 + p1 + 1) / 3 : (p0 + p1 + 1) / 2;
+            palette.rgb[3][c] = fourColor ? (p0 + 2 * p1 + 1) / 3 : 0;
+        }
+    }
+
+    void SetupProjection(const ColorPalette& palette, bool fourColor, Projection& projection)
+    {
+        int stops[4];
+        for (int c = 0; c < 3; ++c)
+            projection.dir[c] = palette.rgb[0][c] - palette.rgb[1][c];
+        for (int k = 0; k < 4; ++k)
+        {
+            stops[k] = palette.rgb[k][0] * projection.dir[0] + palette.rgb[k][1] * projection.dir[1] +
+                palette.rgb[k][2] * projection.dir[2];
+        }
+
+        // Along the direction the palette runs c1, 3, 2, c0 in four-color
+        // mode and c1, 2, c0 in three-color mode, which the first two
+        // thresholds then collapse into one.
+        if (fourColor)
+        {
+            projection.thresholds[0] = stops[1] + stops[3];
+            projection.thresholds[1] = stops[3] + stops[2];
+            projection.thresholds[2] = stops[2] + stops[0];
+        }
+        else
+        {
+            projection.thresholds[0] = stops[1] + stops[2];
+            projection.thresholds[1] = stops[1] + stops[2];
+            projection.thresholds[2] = stops[2] + stops[0];
+        }
+    }
+
+    inline uint32_t ProjectIndex(int dot2, const int thresholds[3])
+    {
+        if (dot2 < thresholds[1])
+            return dot2 < thresholds[0] ? 1 : 3;
+        return dot2 < thresholds[2] ? 2 : 0;
+    }
+
+    uint32_t SelectIndicesScalar(const uint8_t* pPixels, const Projection& projection)
+    {
+        uint32_t indices = 0;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            const uint8_t* px = pPixels + p * 4;
+            int dot2 = 2 * (px[0] * projection.dir[0] + px[1] * projection.dir[1] + px[2] * projection.dir[2]);
+            indices |= ProjectIndex(dot2, projection.thresholds) << (2 * p);
+        }
+        return indices;
+    }
+
+    void ComputeBoundsScalar(const uint8_t* pPixels, uint32_t skipMask, uint8_t lo[4], uint8_t hi[4])
+    {
+        bool any = false;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (skipMask & (1u << p))
+                continue;
+            for (int c = 0; c < 4; ++c)
+            {
+                const uint8_t v = pPixels[p * 4 + c];
+                lo[c] = any && lo[c] < v ? lo[c] : v;
+                hi[c] = any && hi[c] > v ? hi[c] : v;
+            }
+            any = true;
+        }
+        if (!any)
+        {
+            memset(lo, 0, 4);
+            memset(hi, 0, 4);
+        }
+    }
+
+#ifdef BLOCK_ENCODE_SIMD
+    BLOCK_TARGET_SSE41 void ComputeBoundsSse41(const uint8_t* pPixels, uint8_t lo[4], uint8_t hi[4])
+    {
+        __m128i mn = _mm_loadu_si128((const __m128i*)pPixels);
+        __m128i mx = mn;
+        for (int i = 1; i < 4; ++i)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(pPixels + 16 * i));
+            mn = _mm_min_epu8(mn, v);
+            mx = _mm_max_epu8(mx, v);
+        }
+        mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, 0x4E));
+        mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, 0xB1));
+        mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, 0x4E));
+        mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, 0xB1));
+        uint32_t l = (uint32_t)_mm_cvtsi128_si32(mn), h = (uint32_t)_mm_cvtsi128_si32(mx);
+        memcpy(lo, &l, 4);
+        memcpy(hi, &h, 4);
+    }
+
+    // Four pixels per step: split the channels into 32-bit lanes, dot them
+    // with the direction and turn the three threshold compares into an index.
+    BLOCK_TARGET_SSE41 uint32_t SelectIndicesSse41(const uint8_t* pPixels, const Projection& projection)
+    {
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        const __m128i dr = _mm_set1_epi32(2 * projection.dir[0]);
+        const __m128i dg = _mm_set1_epi32(2 * projection.dir[1]);
+        const __m128i db = _mm_set1_epi32(2 * projection.dir[2]);
+        const __m128i t0 = _mm_set1_epi32(projection.thresholds[0]);
+        const __m128i t1 = _mm_set1_epi32(projection.thresholds[1]);
+        const __m128i t2 = _mm_set1_epi32(projection.thresholds[2]);
+        const __m128i three = _mm_set1_epi32(3);
+        const __m128i shifts = _mm_setr_epi32(1, 4, 16, 64);
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(pPixels + 16 * i));
+            __m128i r = _mm_and_si128(v, byteMask);
+            __m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), byteMask);
+            __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), byteMask);
+            __m128i dot = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(r, dr), _mm_mullo_epi32(g, dg)),
+                _mm_mullo_epi32(b, db));
+
+            // Compares give -1, so 3 + 2 * below0 is 1 or 3 and -2 * below2 is 2 or 0.
+            __m128i below0 = _mm_cmplt_epi32(dot, t0);
+            __m128i below1 = _mm_cmplt_epi32(dot, t1);
+            __m128i below2 = _mm_cmplt_epi32(dot, t2);
+            __m128i low = _mm_add_epi32(three, _mm_add_epi32(below0, below0));
+            __m128i high = _mm_sub_epi32(_mm_setzero_si128(), _mm_add_epi32(below2, below2));
+            __m128i idx = _mm_or_si128(_mm_and_si128(below1, low), _mm_andnot_si128(below1, high));
+
+            idx = _mm_mullo_epi32(idx, shifts);
+            idx = _mm_or_si128(idx, _mm_shuffle_epi32(idx, 0x4E));
+            idx = _mm_or_si128(idx, _mm_shuffle_epi32(idx, 0xB1));
+            indices |= (uint32_t)_mm_cvtsi128_si32(idx) << (8 * i);
+        }
+        return indices;
+    }
+
+    BLOCK_TARGET_AVX2 void ComputeBoundsAvx2(const uint8_t* pPixels, uint8_t lo[4], uint8_t hi[4])
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)pPixels);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(pPixels + 32));
+        __m256i mn256 = _mm256_min_epu8(v0, v1);
+        __m256i mx256 = _mm256_max_epu8(v0, v1);
+        __m128i mn = _mm_min_epu8(_mm256_castsi256_si128(mn256), _mm256_extracti128_si256(mn256, 1));
+        __m128i mx = _mm_max_epu8(_mm256_castsi256_si128(mx256), _mm256_extracti128_si256(mx256, 1));
+        mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, 0x4E));
+        mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, 0xB1));
+        mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, 0x4E));
+        mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, 0xB1));
+        uint32_t l = (uint32_t)_mm_cvtsi128_si32(mn), h = (uint32_t)_mm_cvtsi128_si32(mx);
+        memcpy(lo, &l, 4);
+        memcpy(hi, &h, 4);
+    }
+
+    // Eight pixels per step; the lane shifts place each index directly.
+    BLOCK_TARGET_AVX2 uint32_t SelectIndicesAvx2(const uint8_t* pPixels, const Projection& projection)
+    {
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256i dr = _mm256_set1_epi32(2 * projection.dir[0]);
+        const __m256i dg = _mm256_set1_epi32(2 * projection.dir[1]);
+        const __m256i db = _mm256_set1_epi32(2 * projection.dir[2]);
+        const __m256i t0 = _mm256_set1_epi32(projection.thresholds[0]);
+        const __m256i t1 = _mm256_set1_epi32(projection.thresholds[1]);
+        const __m256i t2 = _mm256_set1_epi32(projection.thresholds[2]);
+        const __m256i three = _mm256_set1_epi32(3);
+        const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(pPixels + 32 * i));
+            __m256i r = _mm256_and_si256(v, byteMask);
+            __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 8), byteMask);
+            __m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 16), byteMask);
+            __m256i dot = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, dr), _mm256_mullo_epi32(g, dg)),
+                _mm256_mullo_epi32(b, db));
+
+            __m256i below0 = _mm256_cmpgt_epi32(t0, dot);
+            __m256i below1 = _mm256_cmpgt_epi32(t1, dot);
+            __m256i below2 = _mm256_cmpgt_epi32(t2, dot);
+            __m256i low = _mm256_add_epi32(three, _mm256_add_epi32(below0, below0));
+            __m256i high = _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_add_epi32(below2, below2));
+            __m256i idx = _mm256_or_si256(_mm256_and_si256(below1, low), _mm256_andnot_si256(below1, high));
+
+            idx = _mm256_sllv_epi32(idx, shifts);
+            __m128i packed = _mm_or_si128(_mm256_castsi256_si128(idx), _mm256_extracti128_si256(idx, 1));
+            packed = _mm_or_si128(packed, _mm_shuffle_epi32(packed, 0x4E));
+            packed = _mm_or_si128(packed, _mm_shuffle_epi32(packed, 0xB1));
+            indices |= (uint32_t)_mm_cvtsi128_si32(packed) << (16 * i);
+        }
+        return indices;
+    }
+#endif
+
+    void ComputeBounds(BlockDecodeKernel kernel, const uint8_t* pPixels, uint8_t lo[4], uint8_t hi[4])
+    {
+#ifdef BLOCK_ENCODE_SIMD
+        if (kernel == BLOCK_DECODE_AVX2)
+            return ComputeBoundsAvx2(pPixels, lo, hi);
+        if (kernel == BLOCK_DECODE_SSE41)
+            return ComputeBoundsSse41(pPixels, lo, hi);
+#endif
+        ComputeBoundsScalar(pPixels, 0, lo, hi);
+    }
+
+    uint32_t SelectIndices(BlockDecodeKernel kernel, const uint8_t* pPixels, const Projection& projection)
+    {
+#ifdef BLOCK_ENCODE_SIMD
+        if (kernel == BLOCK_DECODE_AVX2)
+            return SelectIndicesAvx2(pPixels, projection);
+        if (kernel == BLOCK_DECODE_SSE41)
+            return SelectIndicesSse41(pPixels, projection);
+#endif
+        return SelectIndicesScalar(pPixels, projection);
+    }
+
+    uint32_t ComputeColorError(const uint8_t* pPixels, const ColorPalette& palette, uint32_t indices,
+        uint32_t transparent)
+    {
+        uint32_t error = 0;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                continue;
+            const int* pColor = palette.rgb[(indices >> (2 * p)) & 3];
+            for (int c = 0; c < 3; ++c)
+            {
+                int d = pPixels[p * 4 + c] - pColor[c];
+                error += (uint32_t)(d * d);
+            }
+        }
+        return error;
+    }
+
+    void EvaluateColor(BlockDecodeKernel kernel, const uint8_t* pPixels, uint32_t a, uint32_t b,
+        uint32_t transparent, bool measure, ColorCandidate& candidate)
+    {
+        const bool fourColor = transparent == 0;
+        BuildPalette(a, b, fourColor, candidate.palette);
+        Projection projection;
+        SetupProjection(candidate.palette, fourColor, projection);
+        candidate.indices = SelectIndices(kernel, pPixels, projection);
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                candidate.indices |= 3u << (2 * p);
+        }
+        candidate.error = measure ? ComputeColorError(pPixels, candidate.palette, candidate.indices, transparent) : 0;
+    }
+
+    // Endpoints at the two extremes of the opaque pixels along their
+    // principal axis, found by power iteration from the bounding box
+    // diagonal.
+    void FindPrincipalEndpoints(const uint8_t* pPixels, uint32_t transparent, const uint8_t lo[4],
+        const uint8_t hi[4], uint32_t& a, uint32_t& b)
+    {
+        float mean[3] = {};
+        uint32_t count = 0;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                continue;
+            for (int c = 0; c < 3; ++c)
+                mean[c] += pPixels[p * 4 + c];
+            ++count;
+        }
+        for (int c = 0; c < 3; ++c)
+            mean[c] /= (float)count;
+
+        float cov[6] = {};
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                continue;
+            float r = pPixels[p * 4 + 0] - mean[0];
+            float g = pPixels[p * 4 + 1] - mean[1];
+            float bl = pPixels[p * 4 + 2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * bl;
+            cov[3] += g * g; cov[4] += g * bl; cov[5] += bl * bl;
+        }
+
+        float axis[3] = { (float)(hi[0] - lo[0]), (float)(hi[1] - lo[1]), (float)(hi[2] - lo[2]) };
+        for (int it = 0; it < 4; ++it)
+        {
+            float next[3] = {
+                cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+            };
+            float scale = std::fabs(next[0]) > std::fabs(next[1]) ? std::fabs(next[0]) : std::fabs(next[1]);
+            scale = scale > std::fabs(next[2]) ? scale : std::fabs(next[2]);
+            if (scale < 1e-6f)
+                break;
+            for (int c = 0; c < 3; ++c)
+                axis[c] = next[c] / scale;
+        }
+
+        float minDot = 0.0f, maxDot = 0.0f;
+        uint32_t minPixel = 0, maxPixel = 0;
+        bool any = false;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                continue;
+            const uint8_t* px = pPixels + p * 4;
+            float d = px[0] * axis[0] + px[1] * axis[1] + px[2] * axis[2];
+            if (!any || d < minDot) { minDot = d; minPixel = p; }
+            if (!any || d > maxDot) { maxDot = d; maxPixel = p; }
+            any = true;
+        }
+
+        const uint8_t* pMax = pPixels + maxPixel * 4;
+        const uint8_t* pMin = pPixels + minPixel * 4;
+        a = QuantizeTo565(pMax[0], pMax[1], pMax[2]);
+        b = QuantizeTo565(pMin[0], pMin[1], pMin[2]);
+    }
+
+    // Least-squares endpoints for fixed indices. False if the indices do not
+    // pin both endpoints down (all pixels on one palette entry).
+    bool RefineEndpoints(const uint8_t* pPixels, uint32_t indices, uint32_t transparent, uint32_t& a, uint32_t& b)
+    {
+        static const float s_fourColorWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        static const float s_threeColorWeights[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+        const float* pWeights = transparent == 0 ? s_fourColorWeights : s_threeColorWeights;
+
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                continue;
+            const float w = pWeights[(indices >> (2 * p)) & 3];
+            const float v = 1.0f - w;
+            aa += w * w;
+            bb += v * v;
+            ab += w * v;
+            for (int c = 0; c < 3; ++c)
+            {
+                ax[c] += w * pPixels[p * 4 + c];
+                bx[c] += v * pPixels[p * 4 + c];
+            }
+        }
+
+        const float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f)
+            return false;
+
+        int endA[3], endB[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            endA[c] = Clamp255((int)std::floor((ax[c] * bb - bx[c] * ab) / det + 0.5f));
+            endB[c] = Clamp255((int)std::floor((bx[c] * aa - ax[c] * ab) / det + 0.5f));
+        }
+        a = QuantizeTo565(endA[0], endA[1], endA[2]);
+        b = QuantizeTo565(endB[0], endB[1], endB[2]);
+        return true;
+    }
+
+    // The box spans lo..hi in every channel at once, which only fits colors
+    // that rise together. Red or blue falling as green rises takes the
+    // other diagonal.
+    void FlipDiagonal(const uint8_t* pPixels, uint32_t transparent, int lo[3], int hi[3])
+    {
+        int center[3];
+        for (int c = 0; c < 3; ++c)
+            center[c] = lo[c] + hi[c];
+
+        int covRG = 0, covBG = 0;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            if (transparent & (1u << p))
+                continue;
+            const uint8_t* px = pPixels + p * 4;
+            const int g = 2 * px[1] - center[1];
+            covRG += (2 * px[0] - center[0]) * g;
+            covBG += (2 * px[2] - center[2]) * g;
+        }
+        if (covRG < 0)
+        {
+            int t = lo[0];
+            lo[0] = hi[0];
+            hi[0] = t;
+        }
+        if (covBG < 0)
+        {
+            int t = lo[2];
+            lo[2] = hi[2];
+            hi[2] = t;
+        }
+    }
+
+    // The 8-byte color half of a block. BC3 always decodes four colors, so
+    // only BC1 (allowTransparent) uses the three-color mode.
+    void EncodeColorBlock(BlockDecodeKernel kernel, const uint8_t* pPixels, BlockEncodeQuality quality,
+        bool allowTransparent, uint8_t* pOut)
+    {
+        uint32_t transparent = 0;
+        if (allowTransparent)
+        {
+            for (uint32_t p = 0; p < 16; ++p)
+                transparent |= pPixels[p * 4 + 3] < 128 ? 1u << p : 0;
+        }
+
+        uint8_t lo[4], hi[4];
+        if (transparent == 0)
+            ComputeBounds(kernel, pPixels, lo, hi);
+        else
+            ComputeBoundsScalar(pPixels, transparent, lo, hi);
+
+        // Pulling the box in by 1/16 keeps outliers from stretching it.
+        int insetLo[3], insetHi[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            const int inset = (hi[c] - lo[c]) >> 4;
+            insetLo[c] = lo[c] + inset;
+            insetHi[c] = hi[c] - inset;
+        }
+        FlipDiagonal(pPixels, transparent, insetLo, insetHi);
+
+        const bool high = quality == BLOCK_ENCODE_HIGH;
+        ColorCandidate best;
+        EvaluateColor(kernel, pPixels, QuantizeTo565(insetHi[0], insetHi[1], insetHi[2]),
+            QuantizeTo565(insetLo[0], insetLo[1], insetLo[2]), transparent, high, best);
+
+        if (high && transparent != 0xFFFF)
+        {
+            ColorCandidate candidate;
+            uint32_t a, b;
+            FindPrincipalEndpoints(pPixels, transparent, lo, hi, a, b);
+            EvaluateColor(kernel, pPixels, a, b, transparent, true, candidate);
+            if (candidate.error < best.error)
+                best = candidate;
+
+            for (int it = 0; it < 2 && best.error > 0; ++it)
+            {
+                if (!RefineEndpoints(pPixels, best.indices, transparent, a, b))
+                    break;
+                EvaluateColor(kernel, pPixels, a, b, transparent, true, candidate);
+                if (candidate.error >= best.error)
+                    break;
+                best = candidate;
+            }
+        }
+
+        pOut[0] = (uint8_t)best.palette.c0;
+        pOut[1] = (uint8_t)(best.palette.c0 >> 8);
+        pOut[2] = (uint8_t)best.palette.c1;
+        pOut[3] = (uint8_t)(best.palette.c1 >> 8);
+        memcpy(pOut + 4, &best.indices, 4);
+    }
+
+    // Same table as the decoder builds.
+    void BuildAlphaPalette(uint32_t a0, uint32_t a1, int palette[8])
+    {
+        palette[0] = (int)a0;
+        palette[1] = (int)a1;
+        if (a0 > a1)
+        {
+            for (uint32_t k = 1; k < 7; ++k)
+                palette[k + 1] = (int)(((7 - k) * a0 + k * a1 + 3) / 7);
+        }
+        else
+        {
+            for (uint32_t k = 1; k < 5; ++k)
+                palette[k + 1] = (int)(((5 - k) * a0 + k * a1 + 2) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // Nearest palette entry for every pixel; returns the squared error.
+    uint32_t SelectAlphaIndices(const uint8_t* pPixels, uint32_t a0, uint32_t a1, uint64_t& indices)
+    {
+        int palette[8];
+        BuildAlphaPalette(a0, a1, palette);
+
+        uint32_t error = 0;
+        indices = 0;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            const int a = pPixels[p * 4 + 3];
+            uint32_t bestIndex = 0;
+            int bestError = 256 * 256;
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                const int d = (a - palette[i]) * (a - palette[i]);
+                if (d < bestError)
+                {
+                    bestError = d;
+                    bestIndex = i;
+                }
+            }
+            indices |= (uint64_t)bestIndex << (3 * p);
+            error += (uint32_t)bestError;
+        }
+        return error;
+    }
+
+    // The 8-byte alpha half of a BC3 block: the eight-value ramp over the
+    // block's range, and for cooking also the six-value ramp over the values
+    // between 0 and 255, which keeps exact 0 and 255 for the rest.
+    void EncodeAlphaBlock(const uint8_t* pPixels, BlockEncodeQuality quality, uint8_t* pOut)
+    {
+        uint32_t lo = 255, hi = 0, innerLo = 255, innerHi = 0;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            const uint32_t a = pPixels[p * 4 + 3];
+            lo = a < lo ? a : lo;
+            hi = a > hi ? a : hi;
+            if (a != 0 && a != 255)
+            {
+                innerLo = a < innerLo ? a : innerLo;
+                innerHi = a > innerHi ? a : innerHi;
+            }
+        }
+
+        uint32_t a0 = hi, a1 = lo;
+        uint64_t indices;
+        uint32_t error = SelectAlphaIndices(pPixels, a0, a1, indices);
+
+        if (quality == BLOCK_ENCODE_HIGH && error > 0)
+        {
+            if (innerLo > innerHi)
+                innerLo = innerHi = 0;
+            uint64_t sixIndices;
+            uint32_t sixError = SelectAlphaIndices(pPixels, innerLo, innerHi, sixIndices);
+            if (sixError < error)
+            {
+                a0 = innerLo;
+                a1 = innerHi;
+                indices = sixIndices;
+            }
+        }
+
+        pOut[0] = (uint8_t)a0;
+        pOut[1] = (uint8_t)a1;
+        for (int i = 0; i < 6; ++i)
+            pOut[2 + i] = (uint8_t)(indices >> (8 * i));
+    }
+
+    // 4x4 pixels from the image, repeating the last row and column past the
+    // edges.
+    void LoadBlock(const uint8_t* pSrc, uint32_t srcRowPitch, uint32_t width, uint32_t height,
+        uint32_t bx, uint32_t by, uint8_t* pPixels)
+    {
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            const uint32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+            const uint8_t* pRow = pSrc + (size_t)sy * srcRowPitch;
+            if (bx * 4 + 4 <= width)
+            {
+                memcpy(pPixels + y * 16, pRow + bx * 16, 16);
+                continue;
+            }
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                const uint32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                memcpy(pPixels + y * 16 + x * 4, pRow + sx * 4, 4);
+            }
+        }
+    }
+}
+
+bool IsBlockEncodeFormat(DXGI_FORMAT fmt)
+{
+    return fmt == DXGI_FORMAT_BC1_UNORM || fmt == DXGI_FORMAT_BC3_UNORM;
+}
+
+const char* GetBlockEncodeQualityName(BlockEncodeQuality quality)
+{
+    switch (quality)
+    {
+    case BLOCK_ENCODE_FAST: return "fast";
+    case BLOCK_ENCODE_HIGH: return "high";
+    default: return "unknown";
+    }
+}
+
+void EncodeBlockRows(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint32_t firstRow, uint32_t rowCount,
+    uint8_t* pDst, uint32_t dstRowPitch, BlockEncodeQuality quality, BlockDecodeKernel kernel)
+{
+    const bool bc3 = fmt == DXGI_FORMAT_BC3_UNORM;
+    const uint32_t blockBytes = DdsBytesPerBlock(fmt);
+    const uint32_t blocksWide = (width + 3) / 4;
+    kernel = ResolveBlockDecodeKernel(kernel);
+
+    uint8_t pixels[64];
+    for (uint32_t by = firstRow; by < firstRow + rowCount; ++by)
+    {
+        uint8_t* pRow = pDst + (size_t)by * dstRowPitch;
+        for (uint32_t bx = 0; bx < blocksWide; ++bx)
+        {
+            LoadBlock(pSrc, srcRowPitch, width, height, bx, by, pixels);
+            uint8_t* pBlock = pRow + bx * blockBytes;
+            if (bc3)
+            {
+                EncodeAlphaBlock(pixels, quality, pBlock);
+                EncodeColorBlock(kernel, pixels, quality, false, pBlock + 8);
+            }
+            else
+            {
+                EncodeColorBlock(kernel, pixels, quality, true, pBlock);
+            }
+        }
+    }
+}
+
+bool EncodeBlockSurface(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint8_t* pDst, uint32_t dstRowPitch,
+    BlockEncodeQuality quality, BlockDecodeKernel kernel, LoadScheduler* pScheduler)
+{
+    if (!IsBlockEncodeFormat(fmt) || !pSrc || !pDst || width == 0 || height == 0)
+        return false;
+
+    const uint32_t blockRows = (height + 3) / 4;
+    ParallelForChunks(pScheduler, blockRows, [=](uint32_t first, uint32_t count) {
+        EncodeBlockRows(fmt, pSrc, srcRowPitch, width, height, first, count, pDst, dstRowPitch, quality, kernel);
+    });
+    return true;
+}
+
+DXGI_FORMAT GetCompressOnLoadFormat(const DdsView& view, uint32_t firstMip)
+{
+    const DdsPixelLayout layout = view.GetPixelLayout();
+    if (!view.IsOpen() || !IsPixelConvertLayout(layout) || firstMip >= view.GetMipCount())
+        return DXGI_FORMAT_UNKNOWN;
+    const DdsMipSpan& top = view.GetMip(firstMip);
+    if (top.width % 4 != 0 || top.height % 4 != 0)
+        return DXGI_FORMAT_UNKNOWN;
+
+    const bool alpha = layout == DDS_PIXELS_RGBA32 || layout == DDS_PIXELS_BGRA32;
+    return alpha ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+}
+
+bool EncodeDdsMipChain(const DdsView& view, uint32_t slice, uint32_t firstMip, DXGI_FORMAT fmt, uint8_t* pDst,
+    uint8_t* pScratch, LoadScheduler* pScheduler)
+{
+    const DdsPixelLayout layout = view.GetPixelLayout();
+    if (!view.IsOpen() || !IsBlockEncodeFormat(fmt) || !IsPixelConvertLayout(layout) ||
+        (layout != DDS_PIXELS_RGBA32 && !pScratch))
+        return false;
+
+    for (uint32_t level = firstMip; level < view.GetMipCount(); ++level)
+    {
+        const DdsMipSpan& mip = view.GetMip(slice, level);
+        const uint8_t* pRgba = mip.pData;
+        uint32_t rgbaPitch = mip.rowPitch;
+        if (layout != DDS_PIXELS_RGBA32)
+        {
+            ConvertPixelSurface(layout, mip.pData, mip.rowPitch, mip.width, mip.height,
+                pScratch, mip.width * 4, BLOCK_DECODE_BEST, pScheduler);
+            pRgba = pScratch;
+            rgbaPitch = mip.width * 4;
+        }
+
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(fmt, mip.width, mip.height, rowPitch, rowCount);
+        EncodeBlockSurface(fmt, pRgba, rgbaPitch, mip.width, mip.height, pDst, rowPitch,
+            BLOCK_ENCODE_FAST, BLOCK_DECODE_BEST, pScheduler);
+        pDst += (size_t)rowPitch * rowCount;
+    }
+    return true;
+}
+
+bool CompressDdsFile(const DdsView& view, const char* filename, DXGI_FORMAT fmt, BlockEncodeQuality quality,
+    LoadScheduler* pScheduler)
+{
+    const DdsPixelLayout layout = view.GetPixelLayout();
+    if (!view.IsOpen() || !IsBlockEncodeFormat(fmt) ||
+        (layout == DDS_PIXELS_BLOCK ? !IsBlockDecodeFormat(view.GetFormat()) : !IsPixelConvertLayout(layout)))
+        return false;
+
+    DdsWriteDesc desc;
+    desc.format = fmt;
+    desc.width = view.GetWidth();
+    desc.height = view.GetHeight();
+    desc.mipCount = view.GetMipCount();
+    desc.cubemap = view.IsCubemap();
+    desc.arraySize = desc.cubemap ? view.GetArraySize() / 6 : view.GetArraySize();
+    desc.dx10Header = view.HasDx10Header();
+
+    std::vector<uint8_t> data(DdsGetDataSize(desc));
+    std::vector<uint8_t> rgba;
+    uint8_t* pOut = data.data();
+    for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+    {
+        for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+        {
+            const DdsMipSpan& mip = view.GetMip(slice, level);
+            rgba.resize((size_t)mip.width * mip.height * 4);
+            if (layout == DDS_PIXELS_BLOCK)
+            {
+                DecodeBlockSurface(view.GetFormat(), mip.pData, mip.rowPitch, mip.width, mip.height,
+                    rgba.data(), mip.width * 4, BLOCK_DECODE_BEST, pScheduler);
+            }
+            else
+            {
+                ConvertPixelSurface(layout, mip.pData, mip.rowPitch, mip.width, mip.height,
+                    rgba.data(), mip.width * 4, BLOCK_DECODE_BEST, pScheduler);
+            }
+
+            uint32_t rowPitch, rowCount;
+            DdsGetMipLayout(fmt, mip.width, mip.height, rowPitch, rowCount);
+            EncodeBlockSurface(fmt, rgba.data(), mip.width * 4, mip.width, mip.height, pOut, rowPitch,
+                quality, BLOCK_DECODE_BEST, pScheduler);
+            pOut += (size_t)rowPitch * rowCount;
+        }
+    }
+    return WriteDds(filename, desc, data.data(), data.size());
+}
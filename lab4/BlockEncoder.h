@@ -0,0 +1,48 @@
+#pragma once
+#include "BlockDecoder.h"
+
+// CPU encoder from RGBA8 to BC1/DXT1 and BC3/DXT5, the counterpart of
+// BlockDecoder. Uses the same kernels: the SIMD ones find the block bounds
+// and pick the palette indices by projecting all 16 pixels onto the
+// endpoint line at once. Everything else is integer or shared scalar code,
+// so all kernels give identical output.
+enum BlockEncodeQuality
+{
+    BLOCK_ENCODE_FAST,      // inset bounding box, for load time
+    BLOCK_ENCODE_HIGH       // principal axis refined by least squares, for cooking
+};
+
+bool IsBlockEncodeFormat(DXGI_FORMAT fmt);
+const char* GetBlockEncodeQualityName(BlockEncodeQuality quality);
+
+// Encodes block rows [firstRow, firstRow + rowCount) of a width x height
+// RGBA8 image. pSrc and pDst both point at the start of the surface. Blocks
+// on the right and bottom edges repeat the last column and row. BC1 blocks
+// with any alpha below 128 use the three-color mode with transparent black.
+void EncodeBlockRows(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint32_t firstRow, uint32_t rowCount,
+    uint8_t* pDst, uint32_t dstRowPitch, BlockEncodeQuality quality, BlockDecodeKernel kernel = BLOCK_DECODE_BEST);
+
+// Encodes a whole surface, in block row chunks on the scheduler's workers
+// and the calling thread when one is given.
+bool EncodeBlockSurface(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint8_t* pDst, uint32_t dstRowPitch,
+    BlockEncodeQuality quality, BlockDecodeKernel kernel = BLOCK_DECODE_BEST, LoadScheduler* pScheduler = nullptr);
+
+// Block format compress-on-load encodes an uncompressed view to when level
+// firstMip becomes the top: BC3 for layouts with alpha, BC1 otherwise.
+// UNKNOWN for block data, and for a top level that is not whole 4x4 blocks,
+// which D3D can't create.
+DXGI_FORMAT GetCompressOnLoadFormat(const DdsView& view, uint32_t firstMip);
+
+// Encodes mips firstMip.. of one slice of an uncompressed view as fmt at
+// load-time quality, tightly packed at pDst. Layouts other than RGBA8 are
+// converted into pScratch first, which must hold level firstMip as RGBA8.
+bool EncodeDdsMipChain(const DdsView& view, uint32_t slice, uint32_t firstMip, DXGI_FORMAT fmt, uint8_t* pDst,
+    uint8_t* pScratch, LoadScheduler* pScheduler = nullptr);
+
+// Re-encodes every mip of every slice of view, which may be BC1-BC3 or
+// uncompressed, as fmt and writes the result to filename. The file has the
+// same shape as view and loads like any other DDS file.
+bool CompressDdsFile(const DdsView& view, const char* filename, DXGI_FORMAT fmt, BlockEncodeQuality quality,
+    LoadScheduler* pScheduler = nullptr);
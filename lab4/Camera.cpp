@@ -14,32 +14,36 @@ void Camera::Update(float deltaTime, bool left, bool right, bool up, bool down)
     if (m_pitch < -maxPitch) m_pitch = -maxPitch;
 }
 
-XMMATRIX Camera::GetViewMatrix() const
+void Camera::SetOrbit(float yaw, float pitch, float distance)
 {
-    float camX = m_distance * sin(m_yaw) * cos(m_pitch);
-    float camY = m_distance * sin(m_pitch);
-    float camZ = m_distance * cos(m_yaw) * cos(m_pitch);
+    m_yaw = yaw;
+    m_pitch = pitch;
+    m_distance = distance;
+}
 
-    XMVECTOR eye = XMVectorSet(camX, camY, camZ, 0.0f);
-    XMVECTOR at = XMVectorZero();
-    XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+Float4x4 Camera::GetViewMatrix() const
+{
+    float eye[3];
+    GetEyePosition(eye);
+    const float at[3] = { 0.0f, 0.0f, 0.0f };
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
 
-    return XMMatrixLookAtLH(eye, at, up);
+    return MatrixLookAtLH(eye, at, up);
 }
 
-XMMATRIX Camera::GetViewNoTranslationMatrix() const
+Float4x4 Camera::GetViewNoTranslationMatrix() const
 {
-    XMMATRIX view = GetViewMatrix();
-    view.r[3] = XMVectorSet(0, 0, 0, 1);
+    Float4x4 view = GetViewMatrix();
+    view.m[3][0] = 0.0f;
+    view.m[3][1] = 0.0f;
+    view.m[3][2] = 0.0f;
+    view.m[3][3] = 1.0f;
     return view;
 }
 
-XMVECTOR Camera::GetEyePosition() const
+void Camera::GetEyePosition(float eye[3]) const
 {
-    return XMVectorSet(
-        m_distance * sin(m_yaw) * cos(m_pitch),
-        m_distance * sin(m_pitch),
-        m_distance * cos(m_yaw) * cos(m_pitch),
-        0.0f
-    );
-}
\ No newline at end of file
+    eye[0] = m_distance * sin(m_yaw) * cos(m_pitch);
+    eye[1] = m_distance * sin(m_pitch);
+    eye[2] = m_distance * cos(m_yaw) * cos(m_pitch);
+}
@@ -1,6 +1,8 @@
 #pragma once
-#include "Common.h"
+#include "SceneMath.h"
 
+// Orbit camera around the origin. Portable, so the windowed renderer and
+// the headless backends share it.
 class Camera
 {
 private:
@@ -12,7 +14,8 @@ private:
 public:
     Camera();
     void Update(float deltaTime, bool left, bool right, bool up, bool down);
-    XMMATRIX GetViewMatrix() const;
-    XMMATRIX GetViewNoTranslationMatrix() const;
-    XMVECTOR GetEyePosition() const;
-};
\ No newline at end of file
+    void SetOrbit(float yaw, float pitch, float distance);
+    Float4x4 GetViewMatrix() const;
+    Float4x4 GetViewNoTranslationMatrix() const;
+    void GetEyePosition(float eye[3]) const;
+};
@@ -0,0 +1,124 @@
+#include "CameraPath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+void CameraPath::AddKey(float time, float yaw, float pitch, float distance)
+{
+    CameraKey key = { time, yaw, pitch, distance };
+    auto it = std::upper_bound(m_keys.begin(), m_keys.end(), time,
+        [](float t, const CameraKey& k) { return t < k.time; });
+    m_keys.insert(it, key);
+}
+
+bool CameraPath::Load(const char* filename)
+{
+    FILE* pFile = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&pFile, filename, "rb") != 0)
+        return false;
+#else
+    pFile = fopen(filename, "rb");
+    if (!pFile)
+        return false;
+#endif
+
+    std::string text;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+        text.append(buffer, read);
+    fclose(pFile);
+
+    return Parse(text.c_str());
+}
+
+bool CameraPath::Parse(const char* text)
+{
+    m_keys.clear();
+
+    const char* p = text;
+    while (*p)
+    {
+        const char* lineEnd = p;
+        while (*lineEnd && *lineEnd != '\n')
+            ++lineEnd;
+
+        std::string line(p, lineEnd);
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+        float values[4];
+        int count = 0;
+        const char* q = line.c_str();
+        while (count < 4)
+        {
+            char* end = nullptr;
+            float v = strtof(q, &end);
+            if (end == q)
+                break;
+            values[count++] = v;
+            q = end;
+        }
+
+        if (count == 4)
+            AddKey(values[0], values[1], values[2], values[3]);
+        else if (line.find_first_not_of(" \t\r") != std::string::npos)
+            return false;
+
+        p = *lineEnd ? lineEnd + 1 : lineEnd;
+    }
+
+    return !m_keys.empty();
+}
+
+void CameraPath::Evaluate(float time, float& yaw, float& pitch, float& distance) const
+{
+    if (m_keys.empty())
+        return;
+
+    if (time <= m_keys.front().time || m_keys.size() == 1)
+    {
+        yaw = m_keys.front().yaw;
+        pitch = m_keys.front().pitch;
+        distance = m_keys.front().distance;
+        return;
+    }
+    if (time >= m_keys.back().time)
+    {
+        yaw = m_keys.back().yaw;
+        pitch = m_keys.back().pitch;
+        distance = m_keys.back().distance;
+        return;
+    }
+
+    auto it = std::upper_bound(m_keys.begin(), m_keys.end(), time,
+        [](float t, const CameraKey& k) { return t < k.time; });
+    const CameraKey& b = *it;
+    const CameraKey& a = *(it - 1);
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 0.0f;
+
+    yaw = a.yaw + (b.yaw - a.yaw) * t;
+    pitch = a.pitch + (b.pitch - a.pitch) * t;
+    distance = a.distance + (b.distance - a.distance) * t;
+}
+
+CameraPath CameraPath::MakeOrbit(float duration)
+{
+    const int steps = 16;
+    const float twoPi = 6.28318531f;
+
+    CameraPath path;
+    for (int i = 0; i <= steps; ++i)
+    {
+        float s = (float)i / (float)steps;
+        path.AddKey(s * duration, s * twoPi,
+            0.3f + 0.5f * sinf(s * twoPi),
+            3.0f + 3.0f * (0.5f - 0.5f * cosf(s * twoPi)));
+    }
+    return path;
+}
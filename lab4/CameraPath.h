@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+struct CameraKey
+{
+    float time;
+    float yaw;
+    float pitch;
+    float distance;
+};
+
+// Scripted orbit-camera motion for unattended runs. Keys are interpolated
+// linearly and the path holds its last key after the end. Files hold one
+// "time yaw pitch distance" key per line; '#' starts a comment.
+class CameraPath
+{
+public:
+    void AddKey(float time, float yaw, float pitch, float distance);
+    bool Load(const char* filename);
+    bool Parse(const char* text);
+
+    bool IsEmpty() const { return m_keys.empty(); }
+    float GetDuration() const { return m_keys.empty() ? 0.0f : m_keys.back().time; }
+    void Evaluate(float time, float& yaw, float& pitch, float& distance) const;
+
+    // One full turn around the cube over duration seconds while the camera
+    // bobs up and down and moves out to twice the default distance.
+    static CameraPath MakeOrbit(float duration);
+
+private:
+    std::vector<CameraKey> m_keys;
+};
@@ -0,0 +1,58 @@
+#include "ConstantRing.h"
+
+ConstantRing::ConstantRing(uint32_t capacity)
+{
+    Reset(capacity);
+}
+
+void ConstantRing::Reset(uint32_t capacity)
+{
+    m_capacity = capacity & ~(CONSTANT_RING_ALIGNMENT - 1);
+    m_frameStart = 0;
+    m_head = 0;
+    m_frameRequested = 0;
+    m_discarded = false;
+    m_stats = ConstantRingStats();
+}
+
+bool ConstantRing::BeginFrame()
+{
+    m_stats.allocations = 0;
+    m_stats.failures = 0;
+    m_stats.frameBytes = 0;
+    m_frameRequested = 0;
+
+    // The buffer's contents are undefined until it has been discarded once.
+    const bool wrap = !m_discarded || m_capacity - m_head < m_stats.largestFrame;
+    if (wrap)
+    {
+        m_head = 0;
+        m_discarded = true;
+        ++m_stats.discards;
+    }
+    m_frameStart = m_head;
+    return wrap;
+}
+
+bool ConstantRing::Allocate(uint32_t size, uint32_t& offset)
+{
+    const uint32_t aligned = AlignSize(size);
+    m_frameRequested += aligned;
+    if (size == 0 || aligned < size || aligned > m_capacity - m_head)
+    {
+        ++m_stats.failures;
+        return false;
+    }
+
+    offset = m_head;
+    m_head += aligned;
+    m_stats.frameBytes += aligned;
+    ++m_stats.allocations;
+    return true;
+}
+
+void ConstantRing::EndFrame()
+{
+    if (m_frameRequested > m_stats.largestFrame)
+        m_stats.largestFrame = m_frameRequested;
+}
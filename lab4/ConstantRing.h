@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+// D3D11.1 binds constant buffers by offset in steps of 16 constants of 16
+// bytes, so every allocation starts and ends on this boundary.
+const uint32_t CONSTANT_RING_ALIGNMENT = 256;
+
+struct ConstantRingStats
+{
+    uint32_t allocations = 0;       // this frame
+    uint32_t failures = 0;          // this frame; those objects took the fallback path
+    uint32_t frameBytes = 0;        // this frame, alignment included
+    uint32_t largestFrame = 0;      // bytes asked for by the busiest frame so far
+    uint32_t discards = 0;          // frames that started at offset 0, the first included
+};
+
+// Suballocates per-frame constants out of one buffer of capacity bytes.
+// A frame's allocations are consecutive, starting where the previous frame
+// stopped. A frame never wraps midway: BeginFrame() starts it over at
+// offset 0 when the space left could not hold the largest frame so far,
+// and says so, because the buffer then has to be mapped with
+// WRITE_DISCARD so the GPU keeps reading the old contents. Otherwise
+// WRITE_NO_OVERWRITE is safe, as nothing the GPU may still read is
+// written again. An allocation that does not fit fails instead of
+// wrapping; the largest frame includes it, so the next frame wraps early
+// or the owner knows to grow the buffer. Pure bookkeeping: the owner maps
+// the buffer and copies the data.
+class ConstantRing
+{
+public:
+    explicit ConstantRing(uint32_t capacity = 0);
+
+    // Forgets every frame. The next BeginFrame() discards.
+    void Reset(uint32_t capacity);
+
+    // Returns true when the frame starts over at offset 0 and the buffer
+    // must be discarded.
+    bool BeginFrame();
+
+    // Offset of size bytes, rounded up to CONSTANT_RING_ALIGNMENT. False if
+    // the rest of the buffer cannot hold them.
+    bool Allocate(uint32_t size, uint32_t& offset);
+
+    void EndFrame();
+
+    uint32_t GetCapacity() const { return m_capacity; }
+    uint32_t GetFrameStart() const { return m_frameStart; }
+    // End of the frame's allocations so far; the frame covers
+    // [GetFrameStart(), GetHead()).
+    uint32_t GetHead() const { return m_head; }
+    const ConstantRingStats& GetStats() const { return m_stats; }
+
+    static uint32_t AlignSize(uint32_t size)
+    {
+        return (size + CONSTANT_RING_ALIGNMENT - 1) & ~(CONSTANT_RING_ALIGNMENT - 1);
+    }
+
+private:
+    uint32_t m_capacity;
+    uint32_t m_frameStart;
+    uint32_t m_head;
+    uint32_t m_frameRequested;      // frameBytes plus what failed
+    bool m_discarded;               // false until the first frame
+    ConstantRingStats m_stats;
+};
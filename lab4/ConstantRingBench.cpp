@@ -0,0 +1,170 @@
+#include "ConstantRingBench.h"
+#include "BenchUtil.h"
+#include "ConstantRing.h"
+#include "RecordingRenderContext.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    ID3D11Buffer* const FAKE_MODEL_CB = FakeHandle<ID3D11Buffer>(0);
+    ID3D11Buffer* const FAKE_RING = FakeHandle<ID3D11Buffer>(1);
+    ID3D11Buffer* const FAKE_CUBE_VB = FakeHandle<ID3D11Buffer>(2);
+
+    const uint32_t MODEL_SIZE = 16 * sizeof(float);
+
+    // Folds the matrix the draw reads from b0 into checksum, in draw order.
+    void FoldConstants(const RecordingRenderContext& context, uint64_t& checksum)
+    {
+        uint32_t words[16] = {};
+        if (const uint8_t* pConstants = context.GetVSConstants(0))
+            memcpy(words, pConstants, sizeof(words));
+        for (uint32_t word : words)
+            checksum = checksum * 31 + word;
+    }
+
+    // A different translation per object and frame, so a stale slice shows
+    // up in the checksum.
+    void BuildModel(uint32_t object, uint32_t frame, float model[16])
+    {
+        memset(model, 0, MODEL_SIZE);
+        model[0] = model[5] = model[10] = model[15] = 1.0f;
+        model[3] = (float)object;
+        model[7] = (float)frame;
+        model[11] = (float)(object ^ frame);
+    }
+
+    void RecordPerObject(CommandRecorder& commands, uint32_t objects, uint32_t frame)
+    {
+        commands.SetVertexBuffer(0, FAKE_CUBE_VB, 20, 0);
+        for (uint32_t i = 0; i < objects; ++i)
+        {
+            float model[16];
+            BuildModel(i, frame, model);
+            commands.UpdateBuffer(FAKE_MODEL_CB, model, MODEL_SIZE, false);
+            commands.SetVSConstantBuffer(0, FAKE_MODEL_CB);
+            commands.DrawIndexed(36, 0, 0);
+        }
+    }
+
+    // What D3D11ConstantRing does, over pMapped; objects that do not fit
+    // fall back to the model buffer. Checks every slice against what the
+    // GPU may still be reading: since the last discard, written bytes only
+    // grow, and a frame starts where the last one stopped.
+    void RecordRing(CommandRecorder& commands, ConstantRing& ring, uint8_t* pMapped, uint32_t objects,
+        uint32_t frame, uint32_t& written, ConstantRingBenchResult& result)
+    {
+        if (ring.BeginFrame())
+            written = 0;
+        result.ringValid = result.ringValid && ring.GetFrameStart() == written;
+
+        commands.SetVertexBuffer(0, FAKE_CUBE_VB, 20, 0);
+        for (uint32_t i = 0; i < objects; ++i)
+        {
+            float model[16];
+            BuildModel(i, frame, model);
+
+            uint32_t offset;
+            if (!ring.Allocate(MODEL_SIZE, offset))
+            {
+                ++result.fallbacks;
+                commands.UpdateBuffer(FAKE_MODEL_CB, model, MODEL_SIZE, false);
+                commands.SetVSConstantBuffer(0, FAKE_MODEL_CB);
+                commands.DrawIndexed(36, 0, 0);
+                continue;
+            }
+
+            const uint32_t aligned = ConstantRing::AlignSize(MODEL_SIZE);
+            result.ringValid = result.ringValid && offset % CONSTANT_RING_ALIGNMENT == 0 &&
+                offset == written && offset + aligned <= ring.GetCapacity();
+            written = offset + aligned;
+
+            memcpy(pMapped + offset, model, MODEL_SIZE);
+            commands.SetVSConstantBufferRange(0, FAKE_RING, offset / 16, aligned / 16);
+            commands.DrawIndexed(36, 0, 0);
+        }
+        ring.EndFrame();
+    }
+}
+
+void RunConstantRingBenchmark(const uint32_t* pObjectCounts, uint32_t countCount, uint32_t ringCapacity,
+    uint32_t frames, std::vector<ConstantRingBenchResult>& results)
+{
+    if (frames == 0)
+        frames = 1;
+
+    std::vector<uint8_t> mapped(ringCapacity);
+    uint8_t modelContents[MODEL_SIZE] = {};
+    CommandRecorder commands;
+    uint64_t checksum = 0;
+    RecordingRenderContext context;
+    context.TrackBuffer(FAKE_MODEL_CB, modelContents, MODEL_SIZE);
+    context.TrackBuffer(FAKE_RING, mapped.data(), ringCapacity);
+    context.SetDrawFn([&checksum](const RecordingRenderContext& drawn, uint32_t, uint32_t) {
+        FoldConstants(drawn, checksum);
+    });
+
+    for (uint32_t c = 0; c < countCount; ++c)
+    {
+        const uint32_t objects = pObjectCounts[c];
+        ConstantRingBenchResult result;
+        result.objects = objects;
+        result.frames = frames;
+        result.ringCapacity = ringCapacity;
+        const double perObject = objects ? 1.0 / ((double)frames * objects) : 0.0;
+
+        std::vector<uint64_t> checksums(frames);
+        context.ResetCounts();
+        commands.Invalidate();
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            checksum = 0;
+            commands.BeginFrame();
+            RecordPerObject(commands, objects, frame);
+            commands.Submit(context);
+            checksums[frame] = checksum;
+        }
+        result.perObjectNs = ElapsedNs(start, BenchClock::now()) * perObject;
+        result.perObjectUpdates = context.GetCount(RCMD_UPDATE_BUFFER) / frames;
+
+        ConstantRing ring(ringCapacity);
+        uint32_t written = 0;
+        context.ResetCounts();
+        commands.Invalidate();
+        start = BenchClock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            checksum = 0;
+            commands.BeginFrame();
+            RecordRing(commands, ring, mapped.data(), objects, frame, written, result);
+            commands.Submit(context);
+            result.matchesPerObject = result.matchesPerObject && checksum == checksums[frame];
+            result.ringBytes = ring.GetStats().frameBytes;
+        }
+        result.ringNs = ElapsedNs(start, BenchClock::now()) * perObject;
+        result.ringMaps = 1;
+        result.discards = ring.GetStats().discards;
+
+        results.push_back(result);
+    }
+}
+
+bool WriteConstantRingBenchmarkCsv(const char* filename, const std::vector<ConstantRingBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,frames,ring_capacity,per_object_ns,ring_ns,per_object_updates,ring_maps,ring_bytes,"
+        "discards,fallbacks,ring_valid,matches_per_object\n");
+    for (const ConstantRingBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%u,%.3f,%.3f,%u,%u,%u,%u,%u,%d,%d\n",
+            r.objects, r.frames, r.ringCapacity, r.perObjectNs, r.ringNs, r.perObjectUpdates, r.ringMaps,
+            r.ringBytes, r.discards, r.fallbacks, r.ringValid ? 1 : 0, r.matchesPerObject ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Per-frame constant updates for a field of objects, each with its own
+// 64-byte model matrix: one UpdateBuffer of a small constant buffer per
+// object against one ConstantRing slice per object out of a buffer mapped
+// once per frame. Frames are replayed into a context that stands in for
+// the GPU: it reads every draw's bound constants back, so both paths have
+// to feed the draws the same matrices. The ring runs over a CPU buffer of
+// ringCapacity bytes; the driver's own copies and renames are not
+// modelled, so the times cover the CPU side only.
+struct ConstantRingBenchResult
+{
+    uint32_t objects = 0;
+    uint32_t frames = 0;
+    uint32_t ringCapacity = 0;
+    double perObjectNs = 0.0;           // per object, record + replay
+    double ringNs = 0.0;
+    uint32_t perObjectUpdates = 0;      // buffer updates per frame
+    uint32_t ringMaps = 0;              // per frame
+    uint32_t ringBytes = 0;             // per frame, alignment included
+    uint32_t discards = 0;              // over all frames
+    uint32_t fallbacks = 0;             // allocations that did not fit, over all frames
+    bool ringValid = true;              // aligned, in bounds, never overwrote a live frame
+    bool matchesPerObject = true;       // draws saw the same constants
+};
+
+void RunConstantRingBenchmark(const uint32_t* pObjectCounts, uint32_t countCount, uint32_t ringCapacity,
+    uint32_t frames, std::vector<ConstantRingBenchResult>& results);
+
+bool WriteConstantRingBenchmarkCsv(const char* filename, const std::vector<ConstantRingBenchResult>& results);
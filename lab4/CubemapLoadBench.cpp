@@ -0,0 +1,109 @@
+#include "CubemapLoadBench.h"
+#include "BenchUtil.h"
+#include "DdsWriter.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    bool SameBytes(const DdsMipSpan& a, const DdsMipSpan& b)
+    {
+        return a.size == b.size && memcmp(a.pData, b.pData, a.size) == 0;
+    }
+
+    // Every mip of every face, in the same order from both layouts.
+    bool MatchesFaces(const DdsView& cube, const DdsView* faces)
+    {
+        if (!cube.IsCubemap() || cube.GetArraySize() != 6 || cube.GetFormat() != faces[0].GetFormat() ||
+            cube.GetMipCount() != faces[0].GetMipCount())
+            return false;
+
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t level = 0; level < cube.GetMipCount(); ++level)
+            {
+                if (!SameBytes(cube.GetMip(face, level), faces[face].GetMip(level)))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Opens and reads fileCount files iterations times; views end up open.
+    template<typename OpenFn>
+    void TimeLoads(uint32_t fileCount, uint32_t iterations, DdsView* pViews, OpenFn open,
+        CubemapLoadBenchResult& result)
+    {
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            BenchClock::time_point start = BenchClock::now();
+            for (uint32_t i = 0; i < fileCount; ++i)
+                open(i, pViews[i]);
+            BenchClock::time_point opened = BenchClock::now();
+            for (uint32_t i = 0; i < fileCount; ++i)
+                pViews[i].Prefetch();
+            BenchClock::time_point read = BenchClock::now();
+
+            result.openMs += ElapsedMs(start, opened);
+            result.readMs += ElapsedMs(opened, read);
+        }
+
+        result.openMs /= iterations;
+        result.readMs /= iterations;
+        result.files = fileCount;
+        for (uint32_t i = 0; i < fileCount; ++i)
+            result.bytes += pViews[i].GetMappedSize();
+    }
+}
+
+bool RunCubemapLoadBenchmark(const std::wstring* pFacePaths, const char* cubePath, const char* dx10CubePath,
+    uint32_t iterations, std::vector<CubemapLoadBenchResult>& results)
+{
+    DdsView faces[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        if (!faces[i].Open(pFacePaths[i].c_str()))
+            return false;
+    }
+    if (!WriteDdsSlices(cubePath, faces, 6, true, false) || !WriteDdsSlices(dx10CubePath, faces, 6, true, true))
+        return false;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    CubemapLoadBenchResult separate;
+    separate.layout = "six_files";
+    TimeLoads(6, iterations, faces, [&](uint32_t i, DdsView& view) { view.Open(pFacePaths[i].c_str()); }, separate);
+    results.push_back(separate);
+
+    const char* paths[2] = { cubePath, dx10CubePath };
+    const char* layouts[2] = { "cube_file", "cube_file_dx10" };
+    for (int i = 0; i < 2; ++i)
+    {
+        DdsView cube;
+        CubemapLoadBenchResult combined;
+        combined.layout = layouts[i];
+        TimeLoads(1, iterations, &cube, [&](uint32_t, DdsView& view) { view.Open(paths[i]); }, combined);
+        combined.matchesFaces = MatchesFaces(cube, faces) && cube.HasDx10Header() == (i == 1);
+        results.push_back(combined);
+    }
+    return true;
+}
+
+bool WriteCubemapLoadBenchmarkCsv(const char* filename, const std::vector<CubemapLoadBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "layout,files,bytes,open_ms,read_ms,total_ms,matches_faces\n");
+    for (const CubemapLoadBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%u,%llu,%.4f,%.4f,%.4f,%d\n",
+            r.layout.c_str(), r.files, (unsigned long long)r.bytes, r.openMs, r.readMs,
+            r.openMs + r.readMs, r.matchesFaces ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "DdsView.h"
+#include <string>
+
+// Time to get a whole skybox into memory from one file layout: six face
+// files, or one cube map file with the legacy or the DX10 header. Opening
+// (map and header validation) and reading (touching every page) are timed
+// separately. The files stay in the page cache after the first pass, so
+// this is the per-file overhead the single file saves rather than disk time.
+struct CubemapLoadBenchResult
+{
+    std::string layout;
+    uint32_t files = 0;
+    uint64_t bytes = 0;
+    double openMs = 0.0;
+    double readMs = 0.0;
+    bool matchesFaces = true;       // the cube map file holds the faces' bytes
+};
+
+// Writes the two cube map files from the faces first. Fails if the faces
+// cannot be opened or the files cannot be written.
+bool RunCubemapLoadBenchmark(const std::wstring* pFacePaths, const char* cubePath, const char* dx10CubePath,
+    uint32_t iterations, std::vector<CubemapLoadBenchResult>& results);
+
+bool WriteCubemapLoadBenchmarkCsv(const char* filename, const std::vector<CubemapLoadBenchResult>& results);
@@ -0,0 +1,121 @@
+#include "D3D11ConstantRing.h"
+#include <cstring>
+
+namespace
+{
+    // Far beyond any frame's constants; stops the doubling short of
+    // overflowing.
+    const uint32_t MAX_CAPACITY = 1u << 30;
+}
+
+D3D11ConstantRing::D3D11ConstantRing()
+    : m_pDevice(nullptr), m_pBuffer(nullptr), m_pMapped(nullptr), m_growTo(0)
+{
+}
+
+D3D11ConstantRing::~D3D11ConstantRing()
+{
+    Cleanup();
+}
+
+bool D3D11ConstantRing::Initialize(ID3D11Device* device, uint32_t capacity)
+{
+    Cleanup();
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+        !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+        return false;
+
+    m_pDevice = device;
+    return CreateBuffer(capacity);
+}
+
+void D3D11ConstantRing::Cleanup()
+{
+    if (m_pBuffer)
+    {
+        m_pBuffer->Release();
+        m_pBuffer = nullptr;
+    }
+    m_pDevice = nullptr;
+    m_pMapped = nullptr;
+    m_growTo = 0;
+    m_ring.Reset(0);
+}
+
+bool D3D11ConstantRing::CreateBuffer(uint32_t capacity)
+{
+    if (m_pBuffer)
+    {
+        m_pBuffer->Release();
+        m_pBuffer = nullptr;
+    }
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = ConstantRing::AlignSize(capacity);
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    if (desc.ByteWidth == 0 || FAILED(m_pDevice->CreateBuffer(&desc, nullptr, &m_pBuffer)))
+    {
+        m_pBuffer = nullptr;
+        m_ring.Reset(0);
+        return false;
+    }
+
+    m_ring.Reset(desc.ByteWidth);
+    return true;
+}
+
+void D3D11ConstantRing::BeginFrame(ID3D11DeviceContext* context)
+{
+    m_pMapped = nullptr;
+    if (m_pBuffer && m_growTo != 0)
+    {
+        // The last frame's binds have been submitted, so the old buffer can
+        // go; the context keeps it alive for as long as it is bound.
+        CreateBuffer(m_growTo);
+        m_growTo = 0;
+    }
+    if (!m_pBuffer)
+        return;
+
+    const D3D11_MAP mapType = m_ring.BeginFrame() ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (SUCCEEDED(context->Map(m_pBuffer, 0, mapType, 0, &mapped)))
+        m_pMapped = (uint8_t*)mapped.pData;
+}
+
+bool D3D11ConstantRing::SetVSConstants(CommandRecorder& commands, uint32_t slot, const void* pData, uint32_t size)
+{
+    uint32_t offset;
+    if (!m_pMapped || !m_ring.Allocate(size, offset))
+        return false;
+
+    memcpy(m_pMapped + offset, pData, size);
+    commands.SetVSConstantBufferRange(slot, m_pBuffer, offset / 16, ConstantRing::AlignSize(size) / 16);
+    return true;
+}
+
+void D3D11ConstantRing::EndFrame(ID3D11DeviceContext* context)
+{
+    if (!m_pMapped)
+        return;
+
+    context->Unmap(m_pBuffer, 0);
+    m_pMapped = nullptr;
+    m_ring.EndFrame();
+
+    // Make room for the busiest frame so far, twice over so the ring can
+    // hold a frame in flight next to the one being written. The recorded
+    // binds still name this buffer, so it is replaced next frame.
+    const uint32_t largest = m_ring.GetStats().largestFrame;
+    if (largest > m_ring.GetCapacity())
+    {
+        uint32_t capacity = m_ring.GetCapacity();
+        while (capacity < 2 * largest && capacity < MAX_CAPACITY)
+            capacity *= 2;
+        m_growTo = capacity;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <d3d11_1.h>
+#include "ConstantRing.h"
+#include "RenderCommands.h"
+
+// A ConstantRing over one dynamic D3D11 buffer. The buffer is mapped once
+// per frame; every SetVSConstants() copies its data in at its own offset
+// and records a VSSetConstantBuffers1 bind of just that range, so a frame
+// of per-object constants costs one map instead of one update per object.
+// Offset binding and no-overwrite maps of constant buffers need the 11.1
+// runtime and driver support; without them IsAvailable() is false,
+// SetVSConstants() always fails and callers update their own buffers as
+// before.
+class D3D11ConstantRing
+{
+public:
+    D3D11ConstantRing();
+    ~D3D11ConstantRing();
+
+    D3D11ConstantRing(const D3D11ConstantRing&) = delete;
+    D3D11ConstantRing& operator=(const D3D11ConstantRing&) = delete;
+
+    // Returns false if the device cannot bind by offset; not an error.
+    bool Initialize(ID3D11Device* device, uint32_t capacity);
+    void Cleanup();
+
+    bool IsAvailable() const { return m_pBuffer != nullptr; }
+
+    // Maps the buffer. Call before recording the frame.
+    void BeginFrame(ID3D11DeviceContext* context);
+
+    // False when the ring is unavailable, not mapped or full; the caller
+    // then takes its fallback path for this bind.
+    bool SetVSConstants(CommandRecorder& commands, uint32_t slot, const void* pData, uint32_t size);
+
+    // Unmaps the buffer. Call before CommandRecorder::Submit(). A frame
+    // that did not fit grows the buffer for the next one.
+    void EndFrame(ID3D11DeviceContext* context);
+
+    const ConstantRingStats& GetStats() const { return m_ring.GetStats(); }
+
+private:
+    bool CreateBuffer(uint32_t capacity);
+
+    ID3D11Device* m_pDevice;
+    ID3D11Buffer* m_pBuffer;
+    uint8_t* m_pMapped;
+    uint32_t m_growTo;          // capacity for the next frame, 0 to keep it
+    ConstantRing m_ring;
+};
@@ -0,0 +1,108 @@
+#include "D3D11RenderContext.h"
+#include <cstring>
+
+void D3D11RenderContext::SetContext(ID3D11DeviceContext* pContext)
+{
+    m_pContext = pContext;
+    m_pContext1 = nullptr;
+    // The 11.1 interface is the same object, so it lives exactly as long
+    // as pContext and the reference can go right away.
+    if (pContext && SUCCEEDED(pContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&m_pContext1)))
+        m_pContext1->Release();
+}
+
+void D3D11RenderContext::SetVertexShader(ID3D11VertexShader* pShader)
+{
+    m_pContext->VSSetShader(pShader, nullptr, 0);
+}
+
+void D3D11RenderContext::SetPixelShader(ID3D11PixelShader* pShader)
+{
+    m_pContext->PSSetShader(pShader, nullptr, 0);
+}
+
+void D3D11RenderContext::SetInputLayout(ID3D11InputLayout* pLayout)
+{
+    m_pContext->IASetInputLayout(pLayout);
+}
+
+void D3D11RenderContext::SetPrimitiveTopology(uint32_t topology)
+{
+    m_pContext->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderContext::SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset)
+{
+    UINT strides[] = { stride };
+    UINT offsets[] = { offset };
+    m_pContext->IASetVertexBuffers(slot, 1, &pBuffer, strides, offsets);
+}
+
+void D3D11RenderContext::SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset)
+{
+    m_pContext->IASetIndexBuffer(pBuffer, (DXGI_FORMAT)format, offset);
+}
+
+void D3D11RenderContext::SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer)
+{
+    m_pContext->VSSetConstantBuffers(slot, 1, &pBuffer);
+}
+
+void D3D11RenderContext::SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer,
+    uint32_t firstConstant, uint32_t constantCount)
+{
+    if (m_pContext1)
+        m_pContext1->VSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &constantCount);
+}
+
+void D3D11RenderContext::SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView)
+{
+    m_pContext->PSSetShaderResources(slot, 1, &pView);
+}
+
+void D3D11RenderContext::SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler)
+{
+    m_pContext->PSSetSamplers(slot, 1, &pSampler);
+}
+
+void D3D11RenderContext::SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef)
+{
+    m_pContext->OMSetDepthStencilState(pState, stencilRef);
+}
+
+void D3D11RenderContext::SetRasterizerState(ID3D11RasterizerState* pState)
+{
+    m_pContext->RSSetState(pState);
+}
+
+void D3D11RenderContext::SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask)
+{
+    m_pContext->OMSetBlendState(pState, nullptr, sampleMask);
+}
+
+void D3D11RenderContext::UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard)
+{
+    if (!discard)
+    {
+        m_pContext->UpdateSubresource(pBuffer, 0, nullptr, pData, 0, 0);
+        return;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (SUCCEEDED(m_pContext->Map(pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    {
+        memcpy(mapped.pData, pData, size);
+        m_pContext->Unmap(pBuffer, 0);
+    }
+}
+
+void D3D11RenderContext::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    m_pContext->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderContext::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+    uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+    m_pContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <d3d11_1.h>
+#include "RenderCommands.h"
+
+// IRenderContext on top of an ID3D11DeviceContext. Each call maps to exactly
+// one context call.
+class D3D11RenderContext : public IRenderContext
+{
+public:
+    D3D11RenderContext() : m_pContext(nullptr), m_pContext1(nullptr) {}
+
+    // Not AddRef'd; the owner keeps pContext alive while it is set.
+    void SetContext(ID3D11DeviceContext* pContext);
+
+    void SetVertexShader(ID3D11VertexShader* pShader) override;
+    void SetPixelShader(ID3D11PixelShader* pShader) override;
+    void SetInputLayout(ID3D11InputLayout* pLayout) override;
+    void SetPrimitiveTopology(uint32_t topology) override;
+    void SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset) override;
+    void SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset) override;
+    void SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer) override;
+    void SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer,
+        uint32_t firstConstant, uint32_t constantCount) override;
+    void SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView) override;
+    void SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler) override;
+    void SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef) override;
+    void SetRasterizerState(ID3D11RasterizerState* pState) override;
+    void SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask) override;
+    void UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+        uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+
+private:
+    ID3D11DeviceContext* m_pContext;
+    ID3D11DeviceContext1* m_pContext1;      // null before the 11.1 runtime
+};
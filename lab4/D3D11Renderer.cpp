@@ -1,17 +1,23 @@
 #include "D3D11Renderer.h"
+#include "AssetArchive.h"
+
+static_assert(sizeof(SceneVertex) == sizeof(TexturedVertex), "SceneVertex must match the TexturedVertex input layout");
 
 D3D11Renderer::D3D11Renderer()
-    : m_hWnd(nullptr), m_width(1280), m_height(720), m_lastFrameTime(0),
+    : m_hWnd(nullptr), m_headless(false), m_width(1280), m_height(720), m_lastFrameTime(0),
     m_keyLeft(false), m_keyRight(false), m_keyUp(false), m_keyDown(false),
     m_pDevice(nullptr), m_pContext(nullptr), m_pSwapChain(nullptr),
     m_pBackBufferRTV(nullptr), m_pDepthStencilView(nullptr),
+    m_pOffscreenTarget(nullptr), m_pReadbackTexture(nullptr), m_pFinishQuery(nullptr),
     m_pVertexBuffer(nullptr), m_pIndexBuffer(nullptr),
     m_pVertexShader(nullptr), m_pPixelShader(nullptr),
-    m_pInputLayout(nullptr), m_pModelCB(nullptr),
+    m_pInputLayout(nullptr), m_pInstanceBuffer(nullptr), m_instanceCapacity(0),
     m_pSkyboxVertexBuffer(nullptr), m_pSkyboxIndexBuffer(nullptr),
     m_pSkyboxVS(nullptr), m_pSkyboxPS(nullptr), m_pSkyboxInputLayout(nullptr),
-    m_pViewProjCB(nullptr), m_pTextureView(nullptr),
-    m_pCubemapView(nullptr), m_pSampler(nullptr)
+    m_pViewProjCB(nullptr), m_pSampler(nullptr),
+    m_pSkyboxDepthState(nullptr), m_pSkyboxRasterizerState(nullptr),
+    m_pCubeDepthState(nullptr), m_pCubeRasterizerState(nullptr),
+    m_textureStreamer(m_loadScheduler)
 {
     m_lastFrameTime = (double)GetTickCount64() / 1000.0;
 }
@@ -27,12 +33,43 @@ bool D3D11Renderer::Initialize(HWND hWnd, UINT width, UINT height)
     m_width = width;
     m_height = height;
 
+    // Mapping the files runs on the load workers while the device, buffers
+    // and shaders are created; LoadTextures() only waits for what is left.
+    BeginTextureLoads();
+
     if (!CreateDeviceAndSwapChain()) return false;
     if (!CreateRenderTargetAndDepthStencil()) return false;
+
+    return CreateResources();
+}
+
+bool D3D11Renderer::InitializeHeadless(UINT width, UINT height)
+{
+    m_headless = true;
+    m_width = width;
+    m_height = height;
+
+    BeginTextureLoads();
+
+    if (!CreateDevice()) return false;
+    if (!CreateOffscreenTarget()) return false;
+
+    return CreateResources();
+}
+
+// Everything after the device and render target, shared by both modes.
+bool D3D11Renderer::CreateResources()
+{
+    m_renderContext.SetContext(m_pContext);
     if (!CreateBuffers()) return false;
+    if (!CreateRenderStates()) return false;
     if (!CompileShaders()) return false;
     if (!LoadTextures()) return false;
 
+    D3D11_QUERY_DESC queryDesc = {};
+    queryDesc.Query = D3D11_QUERY_EVENT;
+    if (FAILED(m_pDevice->CreateQuery(&queryDesc, &m_pFinishQuery))) return false;
+
     return true;
 }
 
@@ -40,9 +77,13 @@ void D3D11Renderer::Cleanup()
 {
     if (m_pContext)
         m_pContext->ClearState();
+    m_commands.Invalidate();
 
-    SAFE_RELEASE(m_pModelCB);
+    SAFE_RELEASE(m_pFinishQuery);
+    SAFE_RELEASE(m_pInstanceBuffer);
+    m_instanceCapacity = 0;
     SAFE_RELEASE(m_pViewProjCB);
+    m_constantRing.Cleanup();
     SAFE_RELEASE(m_pInputLayout);
     SAFE_RELEASE(m_pVertexShader);
     SAFE_RELEASE(m_pPixelShader);
@@ -55,10 +96,18 @@ void D3D11Renderer::Cleanup()
     SAFE_RELEASE(m_pSkyboxVertexBuffer);
     SAFE_RELEASE(m_pBackBufferRTV);
     SAFE_RELEASE(m_pDepthStencilView);
+    SAFE_RELEASE(m_pOffscreenTarget);
+    SAFE_RELEASE(m_pReadbackTexture);
     SAFE_RELEASE(m_pSwapChain);
-    SAFE_RELEASE(m_pTextureView);
-    SAFE_RELEASE(m_pCubemapView);
-    SAFE_RELEASE(m_pSampler);
+    m_textureStreamer.Cleanup();
+
+    // Cached state objects are owned by the cache.
+    m_stateCache.Cleanup();
+    m_pSampler = nullptr;
+    m_pSkyboxDepthState = nullptr;
+    m_pSkyboxRasterizerState = nullptr;
+    m_pCubeDepthState = nullptr;
+    m_pCubeRasterizerState = nullptr;
 
 #ifdef _DEBUG
     if (m_pDevice)
@@ -109,6 +158,25 @@ bool D3D11Renderer::CreateDeviceAndSwapChain()
     return SUCCEEDED(hr);
 }
 
+bool D3D11Renderer::CreateDevice()
+{
+    UINT flags = 0;
+#ifdef _DEBUG
+    flags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+    D3D_FEATURE_LEVEL levels[] = { D3D_FEATURE_LEVEL_11_0 };
+    D3D_FEATURE_LEVEL obtainedLevel;
+
+    HRESULT hr = D3D11CreateDevice(
+        nullptr, D3D_DRIVER_TYPE_WARP, nullptr,
+        flags, levels, 1, D3D11_SDK_VERSION,
+        &m_pDevice, &obtainedLevel, &m_pContext
+    );
+
+    return SUCCEEDED(hr);
+}
+
 bool D3D11Renderer::CreateRenderTargetAndDepthStencil()
 {
     ID3D11Texture2D* pBackBuffer = nullptr;
@@ -119,9 +187,41 @@ bool D3D11Renderer::CreateRenderTargetAndDepthStencil()
     pBackBuffer->Release();
     if (FAILED(hr)) return false;
 
+    return CreateDepthStencil(m_width, m_height);
+}
+
+bool D3D11Renderer::CreateOffscreenTarget()
+{
+    // Same format as the swap chain so both modes produce the same pixels.
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = m_width;
+    desc.Height = m_height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+    if (FAILED(m_pDevice->CreateTexture2D(&desc, nullptr, &m_pOffscreenTarget)))
+        return false;
+
+    if (FAILED(m_pDevice->CreateRenderTargetView(m_pOffscreenTarget, nullptr, &m_pBackBufferRTV)))
+        return false;
+
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    if (FAILED(m_pDevice->CreateTexture2D(&desc, nullptr, &m_pReadbackTexture)))
+        return false;
+
+    return CreateDepthStencil(m_width, m_height);
+}
+
+bool D3D11Renderer::CreateDepthStencil(UINT width, UINT height)
+{
     D3D11_TEXTURE2D_DESC depthDesc = {};
-    depthDesc.Width = m_width;
-    depthDesc.Height = m_height;
+    depthDesc.Width = width;
+    depthDesc.Height = height;
     depthDesc.MipLevels = 1;
     depthDesc.ArraySize = 1;
     depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
@@ -131,7 +231,7 @@ bool D3D11Renderer::CreateRenderTargetAndDepthStencil()
     depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
 
     ID3D11Texture2D* pDepthStencil = nullptr;
-    hr = m_pDevice->CreateTexture2D(&depthDesc, nullptr, &pDepthStencil);
+    HRESULT hr = m_pDevice->CreateTexture2D(&depthDesc, nullptr, &pDepthStencil);
     if (FAILED(hr)) return false;
 
     hr = m_pDevice->CreateDepthStencilView(pDepthStencil, nullptr, &m_pDepthStencilView);
@@ -142,117 +242,126 @@ bool D3D11Renderer::CreateRenderTargetAndDepthStencil()
 
 bool D3D11Renderer::CreateBuffers()
 {
-    const TexturedVertex cubeVertices[] = {
-        { XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT2(0.0f, 1.0f) },
-        { XMFLOAT3(0.5f, -0.5f, -0.5f), XMFLOAT2(1.0f, 1.0f) },
-        { XMFLOAT3(0.5f,  0.5f, -0.5f), XMFLOAT2(1.0f, 0.0f) },
-        { XMFLOAT3(-0.5f,  0.5f, -0.5f), XMFLOAT2(0.0f, 0.0f) },
-        { XMFLOAT3(-0.5f, -0.5f,  0.5f), XMFLOAT2(0.0f, 1.0f) },
-        { XMFLOAT3(0.5f, -0.5f,  0.5f), XMFLOAT2(1.0f, 1.0f) },
-        { XMFLOAT3(0.5f,  0.5f,  0.5f), XMFLOAT2(1.0f, 0.0f) },
-        { XMFLOAT3(-0.5f,  0.5f,  0.5f), XMFLOAT2(0.0f, 0.0f) },
-        { XMFLOAT3(-0.5f, -0.5f,  0.5f), XMFLOAT2(0.0f, 1.0f) },
-        { XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT2(1.0f, 1.0f) },
-        { XMFLOAT3(-0.5f,  0.5f, -0.5f), XMFLOAT2(1.0f, 0.0f) },
-        { XMFLOAT3(-0.5f,  0.5f,  0.5f), XMFLOAT2(0.0f, 0.0f) },
-        { XMFLOAT3(0.5f, -0.5f, -0.5f), XMFLOAT2(0.0f, 1.0f) },
-        { XMFLOAT3(0.5f, -0.5f,  0.5f), XMFLOAT2(1.0f, 1.0f) },
-        { XMFLOAT3(0.5f,  0.5f,  0.5f), XMFLOAT2(1.0f, 0.0f) },
-        { XMFLOAT3(0.5f,  0.5f, -0.5f), XMFLOAT2(0.0f, 0.0f) },
-        { XMFLOAT3(-0.5f,  0.5f, -0.5f), XMFLOAT2(0.0f, 1.0f) },
-        { XMFLOAT3(0.5f,  0.5f, -0.5f), XMFLOAT2(1.0f, 1.0f) },
-        { XMFLOAT3(0.5f,  0.5f,  0.5f), XMFLOAT2(1.0f, 0.0f) },
-        { XMFLOAT3(-0.5f,  0.5f,  0.5f), XMFLOAT2(0.0f, 0.0f) },
-        { XMFLOAT3(-0.5f, -0.5f,  0.5f), XMFLOAT2(0.0f, 1.0f) },
-        { XMFLOAT3(0.5f, -0.5f,  0.5f), XMFLOAT2(1.0f, 1.0f) },
-        { XMFLOAT3(0.5f, -0.5f, -0.5f), XMFLOAT2(1.0f, 0.0f) },
-        { XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT2(0.0f, 0.0f) }
-    };
-
-    const USHORT cubeIndices[] = {
-        0,2,1, 0,3,2, 4,5,6, 4,6,7, 8,10,9, 8,11,10,
-        12,14,13, 12,15,14, 16,18,17, 16,19,18, 20,22,21, 20,23,22
-    };
-
-    const TexturedVertex skyboxVertices[] = {
-        { XMFLOAT3(-10, -10, -10), XMFLOAT2(0,0) },
-        { XMFLOAT3(10, -10, -10), XMFLOAT2(0,0) },
-        { XMFLOAT3(10,  10, -10), XMFLOAT2(0,0) },
-        { XMFLOAT3(-10,  10, -10), XMFLOAT2(0,0) },
-        { XMFLOAT3(-10, -10,  10), XMFLOAT2(0,0) },
-        { XMFLOAT3(10, -10,  10), XMFLOAT2(0,0) },
-        { XMFLOAT3(10,  10,  10), XMFLOAT2(0,0) },
-        { XMFLOAT3(-10,  10,  10), XMFLOAT2(0,0) }
-    };
-
-    const USHORT skyboxIndices[] = {
-        0,2,1, 0,3,2, 4,5,6, 4,6,7, 0,7,3, 0,4,7,
-        1,2,6, 1,6,5, 3,7,6, 3,6,2, 0,1,5, 0,5,4
-    };
+    const SceneMesh& cube = GetCubeMesh();
+    const SceneMesh& skybox = GetSkyboxMesh();
 
     D3D11_BUFFER_DESC desc = {};
     D3D11_SUBRESOURCE_DATA data = {};
 
-    
-    desc.ByteWidth = sizeof(cubeVertices);
+    desc.ByteWidth = cube.vertexCount * sizeof(SceneVertex);
     desc.Usage = D3D11_USAGE_IMMUTABLE;
     desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    data.pSysMem = cubeVertices;
+    data.pSysMem = cube.pVertices;
     if (FAILED(m_pDevice->CreateBuffer(&desc, &data, &m_pVertexBuffer)))
         return false;
 
-    desc.ByteWidth = sizeof(cubeIndices);
+    desc.ByteWidth = cube.indexCount * sizeof(uint16_t);
     desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    data.pSysMem = cubeIndices;
+    data.pSysMem = cube.pIndices;
     if (FAILED(m_pDevice->CreateBuffer(&desc, &data, &m_pIndexBuffer)))
         return false;
 
-    desc.ByteWidth = sizeof(skyboxVertices);
+    desc.ByteWidth = skybox.vertexCount * sizeof(SceneVertex);
     desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    data.pSysMem = skyboxVertices;
+    data.pSysMem = skybox.pVertices;
     if (FAILED(m_pDevice->CreateBuffer(&desc, &data, &m_pSkyboxVertexBuffer)))
         return false;
 
-    desc.ByteWidth = sizeof(skyboxIndices);
+    desc.ByteWidth = skybox.indexCount * sizeof(uint16_t);
     desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    data.pSysMem = skyboxIndices;
+    data.pSysMem = skybox.pIndices;
     if (FAILED(m_pDevice->CreateBuffer(&desc, &data, &m_pSkyboxIndexBuffer)))
         return false;
 
-    desc = {};
-    desc.ByteWidth = sizeof(ModelConstantBuffer);
-    desc.Usage = D3D11_USAGE_DEFAULT;
-    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    if (FAILED(m_pDevice->CreateBuffer(&desc, nullptr, &m_pModelCB)))
+    if (!EnsureInstanceCapacity(m_scene.GetCubeCount()))
         return false;
 
+    desc = {};
     desc.ByteWidth = sizeof(ViewProjConstantBuffer);
     desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
     if (FAILED(m_pDevice->CreateBuffer(&desc, nullptr, &m_pViewProjCB)))
         return false;
 
+    // Without offset binding the constants go through m_pViewProjCB.
+    m_constantRing.Initialize(m_pDevice, 64 * 1024);
     return true;
 }
 
+// Grows the instance buffer when a scene brings more cubes than it holds.
+bool D3D11Renderer::EnsureInstanceCapacity(UINT count)
+{
+    if (count <= m_instanceCapacity)
+        return true;
+
+    SAFE_RELEASE(m_pInstanceBuffer);
+    m_instanceCapacity = 0;
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = (UINT)(count * sizeof(InstanceData));
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    if (FAILED(m_pDevice->CreateBuffer(&desc, nullptr, &m_pInstanceBuffer)))
+        return false;
+
+    m_instanceCapacity = count;
+    return true;
+}
+
+bool D3D11Renderer::CreateRenderStates()
+{
+    m_stateCache.Initialize(m_pDevice);
+
+    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
+    dsDesc.DepthEnable = TRUE;
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+    dsDesc.StencilEnable = FALSE;
+    m_pSkyboxDepthState = m_stateCache.GetDepthStencilState(dsDesc);
+
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
+    m_pCubeDepthState = m_stateCache.GetDepthStencilState(dsDesc);
+
+    D3D11_RASTERIZER_DESC rsDesc = {};
+    rsDesc.FillMode = D3D11_FILL_SOLID;
+    rsDesc.CullMode = D3D11_CULL_NONE;
+    m_pSkyboxRasterizerState = m_stateCache.GetRasterizerState(rsDesc);
+
+    rsDesc.CullMode = D3D11_CULL_BACK;
+    rsDesc.FrontCounterClockwise = FALSE;
+    m_pCubeRasterizerState = m_stateCache.GetRasterizerState(rsDesc);
+
+    return m_pSkyboxDepthState && m_pCubeDepthState &&
+        m_pSkyboxRasterizerState && m_pCubeRasterizerState;
+}
+
 bool D3D11Renderer::CompileShaders()
 {
     const char* cubeVS = R"(
-        cbuffer ModelCB : register(b0) { float4x4 model; }
         cbuffer ViewProjCB : register(b1) { float4x4 vp; }
         struct VSInput {
             float3 pos : POSITION;
             float2 uv : TEXCOORD;
+            float4 world0 : WORLD0;
+            float4 world1 : WORLD1;
+            float4 world2 : WORLD2;
+            float4 tint : TINT;
         };
         struct VSOutput {
             float4 pos : SV_Position;
             float2 uv : TEXCOORD;
+            float4 tint : COLOR;
         };
         VSOutput vs(VSInput v) {
             VSOutput o;
-            float4 worldPos = mul(float4(v.pos, 1.0), model);
+            float4 localPos = float4(v.pos, 1.0);
+            float4 worldPos = float4(dot(v.world0, localPos), dot(v.world1, localPos), dot(v.world2, localPos), 1.0);
             o.pos = mul(worldPos, vp);
             o.uv = v.uv;
+            o.tint = v.tint;
             return o;
         }
     )";
@@ -263,9 +372,10 @@ bool D3D11Renderer::CompileShaders()
         struct VSOutput {
             float4 pos : SV_Position;
             float2 uv : TEXCOORD;
+            float4 tint : COLOR;
         };
         float4 ps(VSOutput p) : SV_Target0 {
-            return colorTexture.Sample(colorSampler, p.uv);
+            return colorTexture.Sample(colorSampler, p.uv) * p.tint;
         }
     )";
 
@@ -306,56 +416,130 @@ bool D3D11Renderer::CompileShaders()
     flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
+    // Bytecode comes from shader_cache.bin next to the exe unless the
+    // source, flags or compiler changed since it was written.
+    ShaderCache cache(CompileShaderWithD3D, D3D_SHADER_COMPILER_ID);
+    cache.Open(GetShaderCachePath(L"shader_cache.bin"));
+
     ID3DBlob* pVsBlob = nullptr, * pPsBlob = nullptr, * pErrorBlob = nullptr;
 
-    // Cube shaders
-    if (FAILED(D3DCompile(cubeVS, strlen(cubeVS), nullptr, nullptr, nullptr, "vs", "vs_5_0", flags, 0, &pVsBlob, &pErrorBlob)))
+    // Reports why a shader did not compile and drops the blobs held so far.
+    // Without an error blob there is only a generic message to show.
+    auto compileFailed = [&]() {
+        ReportError(pErrorBlob ? (const char*)pErrorBlob->GetBufferPointer() : "Failed to compile shaders");
+        SAFE_RELEASE(pVsBlob);
+        SAFE_RELEASE(pPsBlob);
+        SAFE_RELEASE(pErrorBlob);
         return false;
+    };
+
+    // Cube shaders
+    if (FAILED(CompileShaderCached(cache, cubeVS, strlen(cubeVS), nullptr, "vs", "vs_5_0", flags, &pVsBlob, &pErrorBlob)))
+        return compileFailed();
     m_pDevice->CreateVertexShader(pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), nullptr, &m_pVertexShader);
 
-    D3DCompile(cubePS, strlen(cubePS), nullptr, nullptr, nullptr, "ps", "ps_5_0", flags, 0, &pPsBlob, &pErrorBlob);
+    if (FAILED(CompileShaderCached(cache, cubePS, strlen(cubePS), nullptr, "ps", "ps_5_0", flags, &pPsBlob, &pErrorBlob)))
+        return compileFailed();
     m_pDevice->CreatePixelShader(pPsBlob->GetBufferPointer(), pPsBlob->GetBufferSize(), nullptr, &m_pPixelShader);
 
-    D3D11_INPUT_ELEMENT_DESC layout[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
+    // Slot 0: cube vertices, slot 1: InstanceData
+    D3D11_INPUT_ELEMENT_DESC cubeLayout[] = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"WORLD",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"WORLD",    1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"WORLD",    2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"TINT",     0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1}
     };
-    m_pDevice->CreateInputLayout(layout, 2, pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), &m_pInputLayout);
+    m_pDevice->CreateInputLayout(cubeLayout, 6, pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), &m_pInputLayout);
     SAFE_RELEASE(pVsBlob);
     SAFE_RELEASE(pPsBlob);
 
     // Skybox shaders
-    D3DCompile(skyboxVS, strlen(skyboxVS), nullptr, nullptr, nullptr, "vs", "vs_5_0", flags, 0, &pVsBlob, &pErrorBlob);
+    if (FAILED(CompileShaderCached(cache, skyboxVS, strlen(skyboxVS), nullptr, "vs", "vs_5_0", flags, &pVsBlob, &pErrorBlob)))
+        return compileFailed();
     m_pDevice->CreateVertexShader(pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), nullptr, &m_pSkyboxVS);
 
-    D3DCompile(skyboxPS, strlen(skyboxPS), nullptr, nullptr, nullptr, "ps", "ps_5_0", flags, 0, &pPsBlob, &pErrorBlob);
+    if (FAILED(CompileShaderCached(cache, skyboxPS, strlen(skyboxPS), nullptr, "ps", "ps_5_0", flags, &pPsBlob, &pErrorBlob)))
+        return compileFailed();
     m_pDevice->CreatePixelShader(pPsBlob->GetBufferPointer(), pPsBlob->GetBufferSize(), nullptr, &m_pSkyboxPS);
 
+    D3D11_INPUT_ELEMENT_DESC layout[] = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
+    };
     m_pDevice->CreateInputLayout(layout, 2, pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), &m_pSkyboxInputLayout);
 
     SAFE_RELEASE(pVsBlob);
     SAFE_RELEASE(pPsBlob);
+    SAFE_RELEASE(pErrorBlob);
 
+    cache.Save();
+    m_shaderCacheStats = cache.GetStats();
+    ReportShaderCacheStats("lab4", m_shaderCacheStats);
     return true;
 }
 
+void D3D11Renderer::BeginTextureLoads()
+{
+    // A cooked lab.pak (see --cook-archive) is one mapping with every mip
+    // table already filled in; the views share it and need no parsing.
+    // Without it, or with one missing either texture, the loose files are
+    // loaded instead.
+    static const char* const ARCHIVE_ENTRIES[] = { "wood02", "skybox" };
+    AssetArchive archive;
+    if (archive.Open((GetPath() + L"..\\..\\texture\\lab.pak").c_str()) && archive.HasEntries(ARCHIVE_ENTRIES, 2))
+    {
+        m_textureLoad = m_loadScheduler.Submit([archive]() {
+            DdsView view;
+            archive.OpenTexture("wood02", view);
+            return view;
+        });
+        m_cubemapLoad = m_loadScheduler.Submit([archive]() {
+            DdsView view;
+            archive.OpenTexture("skybox", view);
+            return view;
+        });
+        return;
+    }
+
+    // Only the mips the streamer asks for are ever read, so the files are
+    // mapped without a prefetch.
+    m_textureLoad = TextureLoader::LoadDDSAsync(m_loadScheduler, GetPath() + L"..\\..\\texture\\wood02.dds", false);
+
+    // A cooked skybox.dds (see --make-cubemap) is one open and one read;
+    // without it the six face files are used.
+    std::wstring cubePath = GetPath() + L"..\\..\\texture\\skybox.dds";
+    if (GetFileAttributesW(cubePath.c_str()) != INVALID_FILE_ATTRIBUTES)
+    {
+        m_cubemapLoad = TextureLoader::LoadDDSAsync(m_loadScheduler, cubePath, false);
+        return;
+    }
+
+    std::wstring path = GetPath() + L"..\\..\\texture\\skybox\\";
+    const wchar_t* faceNames[6] = {
+        L"posx.dds", L"negx.dds",
+        L"posy.dds", L"negy.dds",
+        L"posz.dds", L"negz.dds"
+    };
+
+    for (int i = 0; i < 6; ++i)
+        m_cubemapFaceLoads[i] = TextureLoader::LoadDDSAsync(m_loadScheduler, path + faceNames[i], false);
+}
+
 bool D3D11Renderer::LoadTextures()
 {
-    
-    TextureDesc texDesc;
-    std::wstring fullPath = GetPath() + L"..\\..\\texture\\wood02.dds";
-    if (!TextureLoader::LoadDDS(fullPath.c_str(), texDesc))
+    DdsView texView = m_textureLoad.get();
+    if (!texView.IsOpen())
     {
-        MessageBoxA(NULL, "Failed to load wood02.dds", "Error", MB_OK);
+        ReportError("Failed to load wood02.dds");
         return false;
     }
 
-    m_pTextureView = TextureLoader::CreateTexture2D(m_pDevice, texDesc);
-    free(texDesc.pData);
-
-    if (!m_pTextureView)
+    const UINT mipCount = texView.GetMipCount();
+    if (!m_textureStreamer.AddTexture(m_pDevice, std::move(texView), "wood02", m_streamingTextures.cube))
     {
-        MessageBoxA(NULL, "Failed to create texture SRV", "Error", MB_OK);
+        ReportError("Failed to create texture SRV");
         return false;
     }
 
@@ -365,143 +549,118 @@ bool D3D11Renderer::LoadTextures()
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.MinLOD = 0;
-    sampDesc.MaxLOD = (FLOAT)texDesc.mipmapsCount;
+    sampDesc.MaxLOD = (FLOAT)mipCount;
     sampDesc.MipLODBias = 0.0f;
     sampDesc.MaxAnisotropy = 16;
     sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
 
-    if (FAILED(m_pDevice->CreateSamplerState(&sampDesc, &m_pSampler)))
+    m_pSampler = m_stateCache.GetSamplerState(sampDesc);
+    if (!m_pSampler)
     {
-        MessageBoxA(NULL, "Failed to create sampler", "Error", MB_OK);
+        ReportError("Failed to create sampler");
         return false;
     }
 
-    std::wstring path = GetPath() + L"..\\..\\texture\\skybox\\";
-    std::wstring faceNames[6] = {
-        path + L"posx.dds", path + L"negx.dds",
-        path + L"posy.dds", path + L"negy.dds",
-        path + L"posz.dds", path + L"negz.dds"
-    };
+    bool skyboxLoaded = false;
+    if (m_cubemapLoad.valid())
+    {
+        DdsView cubeView = m_cubemapLoad.get();
+        skyboxLoaded = cubeView.IsCubemap() && cubeView.GetArraySize() == 6 &&
+            m_textureStreamer.AddTexture(m_pDevice, std::move(cubeView), "skybox", m_streamingTextures.skybox);
+    }
+    else
+    {
+        DdsView faces[6];
+        for (int i = 0; i < 6; ++i)
+            faces[i] = m_cubemapFaceLoads[i].get();
+        skyboxLoaded = m_textureStreamer.AddCubemap(m_pDevice, faces, "skybox", m_streamingTextures.skybox);
+    }
 
-    m_pCubemapView = TextureLoader::CreateCubemap(m_pDevice, faceNames);
-    if (!m_pCubemapView)
+    if (!skyboxLoaded)
     {
-        MessageBoxA(NULL, "Failed to load cubemap", "Error", MB_OK);
+        ReportError("Failed to load cubemap");
         return false;
     }
 
-    MessageBoxA(NULL, "Textures loaded successfully!", "Success", MB_OK);
     return true;
 }
 
-void D3D11Renderer::UpdateCamera(float deltaTime)
+void D3D11Renderer::ReportError(const char* message) const
 {
-    m_camera.Update(deltaTime, m_keyLeft, m_keyRight, m_keyUp, m_keyDown);
+    if (m_headless)
+    {
+        fprintf(stderr, "%s\n", message);
+        OutputDebugStringA(message);
+        OutputDebugStringA("\n");
+    }
+    else
+    {
+        MessageBoxA(NULL, message, "Error", MB_OK);
+    }
 }
 
-void D3D11Renderer::RenderSkybox(const XMMATRIX& vpSky)
+// Binds vp to b1: a slice of the constant ring, or m_pViewProjCB updated
+// in place where the ring is unavailable or full.
+void D3D11Renderer::SetViewProj(const Float4x4& vp)
 {
-    
-    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
-    dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-    dsDesc.StencilEnable = FALSE;
-    ID3D11DepthStencilState* pDSSky = nullptr;
-    m_pDevice->CreateDepthStencilState(&dsDesc, &pDSSky);
-    m_pContext->OMSetDepthStencilState(pDSSky, 0);
+    ViewProjConstantBuffer vpData;
+    XMStoreFloat4x4((XMFLOAT4X4*)&vpData.vp, XMMatrixTranspose(XMLoadFloat4x4((const XMFLOAT4X4*)&vp)));
+    if (m_constantRing.SetVSConstants(m_commands, 1, &vpData, sizeof(vpData)))
+        return;
 
-    
-    D3D11_RASTERIZER_DESC rsDesc = {};
-    rsDesc.FillMode = D3D11_FILL_SOLID;
-    rsDesc.CullMode = D3D11_CULL_NONE;
-    ID3D11RasterizerState* pRSSky = nullptr;
-    m_pDevice->CreateRasterizerState(&rsDesc, &pRSSky);
-    m_pContext->RSSetState(pRSSky);
-
-    m_pContext->VSSetShader(m_pSkyboxVS, nullptr, 0);
-    m_pContext->PSSetShader(m_pSkyboxPS, nullptr, 0);
-    m_pContext->IASetInputLayout(m_pSkyboxInputLayout);
-
-    UINT stride = sizeof(TexturedVertex);
-    UINT offset = 0;
-    ID3D11Buffer* vbSky[] = { m_pSkyboxVertexBuffer };
-    m_pContext->IASetVertexBuffers(0, 1, vbSky, &stride, &offset);
-    m_pContext->IASetIndexBuffer(m_pSkyboxIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-    ID3D11Buffer* cbsSky[] = { nullptr, m_pViewProjCB };
-    m_pContext->VSSetConstantBuffers(0, 2, cbsSky);
-
-    ID3D11ShaderResourceView* skySRV[] = { m_pCubemapView };
-    m_pContext->PSSetShaderResources(1, 1, skySRV);
-    ID3D11SamplerState* samplers[] = { m_pSampler };
-    m_pContext->PSSetSamplers(1, 1, samplers);
-
-    
-    m_pContext->DrawIndexed(36, 0, 0);
-
-    SAFE_RELEASE(pRSSky);
-    SAFE_RELEASE(pDSSky);
+    m_commands.UpdateBuffer(m_pViewProjCB, &vpData, sizeof(vpData), true);
+    m_commands.SetVSConstantBuffer(1, m_pViewProjCB);
 }
 
-void D3D11Renderer::RenderCube(const XMMATRIX& view, const XMMATRIX& proj, float time)
+void D3D11Renderer::RenderSkybox(const Float4x4& vpSky)
 {
-    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
-    dsDesc.StencilEnable = FALSE;
-    ID3D11DepthStencilState* pDSCube = nullptr;
-    m_pDevice->CreateDepthStencilState(&dsDesc, &pDSCube);
-    m_pContext->OMSetDepthStencilState(pDSCube, 0);
+    m_commands.SetDepthStencilState(m_pSkyboxDepthState, 0);
+    m_commands.SetRasterizerState(m_pSkyboxRasterizerState);
 
-    D3D11_RASTERIZER_DESC rsDesc = {};
-    rsDesc.FillMode = D3D11_FILL_SOLID;
-    rsDesc.CullMode = D3D11_CULL_BACK;
-    rsDesc.FrontCounterClockwise = FALSE;
-    ID3D11RasterizerState* pRSCube = nullptr;
-    m_pDevice->CreateRasterizerState(&rsDesc, &pRSCube);
-    m_pContext->RSSetState(pRSCube);
+    m_commands.SetVertexShader(m_pSkyboxVS);
+    m_commands.SetPixelShader(m_pSkyboxPS);
+    m_commands.SetInputLayout(m_pSkyboxInputLayout);
 
-    float angle = time * 0.5f;
-    XMMATRIX model = XMMatrixRotationY(angle);
-    XMMATRIX vp = view * proj;
+    m_commands.SetVertexBuffer(0, m_pSkyboxVertexBuffer, sizeof(TexturedVertex), 0);
+    m_commands.SetIndexBuffer(m_pSkyboxIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+    m_commands.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    ModelConstantBuffer modelData;
-    XMStoreFloat4x4((XMFLOAT4X4*)&modelData.model, XMMatrixTranspose(model));
-    m_pContext->UpdateSubresource(m_pModelCB, 0, nullptr, &modelData, 0, 0);
+    m_commands.SetVSConstantBuffer(0, nullptr);
+    SetViewProj(vpSky);
 
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    if (SUCCEEDED(m_pContext->Map(m_pViewProjCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
-    {
-        ViewProjConstantBuffer* pData = (ViewProjConstantBuffer*)mapped.pData;
-        XMStoreFloat4x4((XMFLOAT4X4*)&pData->vp, XMMatrixTranspose(vp));
-        m_pContext->Unmap(m_pViewProjCB, 0);
-    }
+    m_commands.SetPSShaderResource(1, m_textureStreamer.GetView(m_streamingTextures.skybox));
+    m_commands.SetPSSampler(1, m_pSampler);
 
-    m_pContext->VSSetShader(m_pVertexShader, nullptr, 0);
-    m_pContext->PSSetShader(m_pPixelShader, nullptr, 0);
-    m_pContext->IASetInputLayout(m_pInputLayout);
+    m_commands.DrawIndexed(36, 0, 0);
+}
 
-    UINT stride = sizeof(TexturedVertex);
-    UINT offset = 0;
-    ID3D11Buffer* vbCube[] = { m_pVertexBuffer };
-    m_pContext->IASetVertexBuffers(0, 1, vbCube, &stride, &offset);
-    m_pContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+void D3D11Renderer::RenderCube(const InstanceBatcher& instances, const Float4x4& vp)
+{
+    if (instances.GetInstanceCount() == 0 || !EnsureInstanceCapacity(instances.GetInstanceCount()))
+        return;
+
+    m_commands.SetDepthStencilState(m_pCubeDepthState, 0);
+    m_commands.SetRasterizerState(m_pCubeRasterizerState);
+
+    m_commands.UpdateBufferRef(m_pInstanceBuffer, instances.GetData(), instances.GetDataSize(), true);
+
+    m_commands.SetVertexShader(m_pVertexShader);
+    m_commands.SetPixelShader(m_pPixelShader);
+    m_commands.SetInputLayout(m_pInputLayout);
 
-    ID3D11Buffer* cbsCube[] = { m_pModelCB, m_pViewProjCB };
-    m_pContext->VSSetConstantBuffers(0, 2, cbsCube);
+    m_commands.SetVertexBuffer(0, m_pVertexBuffer, sizeof(TexturedVertex), 0);
+    m_commands.SetVertexBuffer(1, m_pInstanceBuffer, sizeof(InstanceData), 0);
+    m_commands.SetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+    m_commands.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    ID3D11ShaderResourceView* cubeSRV[] = { m_pTextureView };
-    m_pContext->PSSetShaderResources(0, 1, cubeSRV);
-    ID3D11SamplerState* samplers[] = { m_pSampler };
-    m_pContext->PSSetSamplers(0, 1, samplers);
+    SetViewProj(vp);
 
-    m_pContext->DrawIndexed(36, 0, 0);
+    m_commands.SetPSShaderResource(0, m_textureStreamer.GetView(m_streamingTextures.cube));
+    m_commands.SetPSSampler(0, m_pSampler);
 
-    SAFE_RELEASE(pRSCube);
-    SAFE_RELEASE(pDSCube);
+    // One draw per material run
+    for (const InstanceBatch& batch : instances.GetBatches())
+        m_commands.DrawIndexedInstanced(36, batch.instanceCount, 0, 0, batch.firstInstance);
 }
 
 void D3D11Renderer::Render()
@@ -513,9 +672,29 @@ void D3D11Renderer::Render()
     float deltaTime = (float)(currentTime - m_lastFrameTime);
     m_lastFrameTime = currentTime;
 
-    UpdateCamera(deltaTime);
+    CameraInput input;
+    input.left = m_keyLeft;
+    input.right = m_keyRight;
+    input.up = m_keyUp;
+    input.down = m_keyDown;
+    m_scene.Update(currentTime, deltaTime, input, &m_jobs);
+
+    RenderFrame(m_scene);
+
+    m_pSwapChain->Present(1, 0);
+}
+
+void D3D11Renderer::RenderFrame(const LabScene& scene)
+{
+    if (!m_pContext || !m_pBackBufferRTV)
+        return;
+
+    // Pipeline state is left bound between frames; the command recorder
+    // tracks it and only forwards binds that actually change something.
+    // The frame's constants are written into the ring while it records.
+    m_commands.BeginFrame();
+    m_constantRing.BeginFrame(m_pContext);
 
-    m_pContext->ClearState();
     m_pContext->OMSetRenderTargets(1, &m_pBackBufferRTV, m_pDepthStencilView);
     const float clearColor[4] = { 0.25f, 0.25f, 0.25f, 1.0f };
     m_pContext->ClearRenderTargetView(m_pBackBufferRTV, clearColor);
@@ -524,25 +703,56 @@ void D3D11Renderer::Render()
     D3D11_VIEWPORT vpView = { 0, 0, (float)m_width, (float)m_height, 0.0f, 1.0f };
     m_pContext->RSSetViewports(1, &vpView);
 
-    XMMATRIX view = m_camera.GetViewMatrix();
-    XMMATRIX viewNoTrans = m_camera.GetViewNoTranslationMatrix();
-    float aspect = (float)m_width / (float)m_height;
-    XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, aspect, 0.1f, 100.0f);
-    XMMATRIX vpSky = viewNoTrans * proj;
+    SceneMatrices matrices;
+    scene.ComputeMatrices((float)m_width / (float)m_height, matrices);
 
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    if (SUCCEEDED(m_pContext->Map(m_pViewProjCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
-    {
-        ViewProjConstantBuffer* pData = (ViewProjConstantBuffer*)mapped.pData;
-        XMStoreFloat4x4((XMFLOAT4X4*)&pData->vp, XMMatrixTranspose(vpSky));
-        m_pContext->Unmap(m_pViewProjCB, 0);
-    }
+    // Offscreen runs wait for every load so their frames do not depend on
+    // how fast the disk happens to be.
+    SetLabRequiredMips(m_textureStreamer.GetPlanner(), m_streamingTextures, scene, m_height);
+    if (m_headless)
+        m_textureStreamer.Flush(m_pDevice);
+    else
+        m_textureStreamer.Update(m_pDevice);
 
-    RenderSkybox(vpSky);
+    RenderSkybox(matrices.skyViewProj);
 
-    RenderCube(view, proj, (float)currentTime);
+    scene.BuildVisibleInstances(matrices.viewProj, m_visible, m_instances,
+        TRANSFORM_KERNEL_BEST, &m_occlusion, &m_jobs);
+    RenderCube(m_instances, matrices.viewProj);
 
-    m_pSwapChain->Present(1, 0);
+    m_constantRing.EndFrame(m_pContext);
+    m_commands.Submit(m_renderContext);
+}
+
+void D3D11Renderer::Finish()
+{
+    if (!m_pContext || !m_pFinishQuery)
+        return;
+
+    m_pContext->End(m_pFinishQuery);
+    BOOL done = FALSE;
+    while (m_pContext->GetData(m_pFinishQuery, &done, sizeof(done), 0) == S_FALSE)
+        SwitchToThread();
+}
+
+bool D3D11Renderer::ReadPixels(std::vector<uint8_t>& rgba)
+{
+    if (!m_pContext || !m_pOffscreenTarget || !m_pReadbackTexture)
+        return false;
+
+    m_pContext->CopyResource(m_pReadbackTexture, m_pOffscreenTarget);
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(m_pContext->Map(m_pReadbackTexture, 0, D3D11_MAP_READ, 0, &mapped)))
+        return false;
+
+    const UINT rowSize = m_width * 4;
+    rgba.resize((size_t)rowSize * m_height);
+    for (UINT y = 0; y < m_height; ++y)
+        memcpy(&rgba[(size_t)y * rowSize], (const uint8_t*)mapped.pData + (size_t)y * mapped.RowPitch, rowSize);
+
+    m_pContext->Unmap(m_pReadbackTexture, 0);
+    return true;
 }
 
 void D3D11Renderer::Resize(UINT newWidth, UINT newHeight)
@@ -564,28 +774,27 @@ void D3D11Renderer::Resize(UINT newWidth, UINT newHeight)
         pBackBuffer->Release();
     }
 
-    D3D11_TEXTURE2D_DESC depthDesc = {};
-    depthDesc.Width = newWidth;
-    depthDesc.Height = newHeight;
-    depthDesc.MipLevels = 1;
-    depthDesc.ArraySize = 1;
-    depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-    depthDesc.SampleDesc.Count = 1;
-    depthDesc.SampleDesc.Quality = 0;
-    depthDesc.Usage = D3D11_USAGE_DEFAULT;
-    depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-
-    ID3D11Texture2D* pDepthStencil = nullptr;
-    if (SUCCEEDED(m_pDevice->CreateTexture2D(&depthDesc, nullptr, &pDepthStencil)))
-    {
-        m_pDevice->CreateDepthStencilView(pDepthStencil, nullptr, &m_pDepthStencilView);
-        pDepthStencil->Release();
-    }
+    CreateDepthStencil(newWidth, newHeight);
 
     m_width = newWidth;
     m_height = newHeight;
 }
 
+void D3D11Renderer::HandleClick(int x, int y)
+{
+    if (m_width == 0 || m_height == 0)
+        return;
+
+    // Clicking a cube selects it; clicking the selected one or empty space
+    // clears the selection.
+    const float ndcX = 2.0f * ((float)x + 0.5f) / (float)m_width - 1.0f;
+    const float ndcY = 1.0f - 2.0f * ((float)y + 0.5f) / (float)m_height;
+    uint32_t cube = m_scene.PickCube(ndcX, ndcY, (float)m_width / (float)m_height);
+    if (cube == m_scene.GetSelectedCube())
+        cube = LabScene::NO_CUBE;
+    m_scene.SelectCube(cube);
+}
+
 void D3D11Renderer::HandleKey(UINT key, bool isDown)
 {
     switch (key)
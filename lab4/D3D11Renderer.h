@@ -1,12 +1,21 @@
 #pragma once
 #include "Common.h"
-#include "Camera.h"
+#include "LabScene.h"
+#include "SceneBackend.h"
 #include "TextureLoader.h"
+#include "StateCache.h"
+#include "D3D11ConstantRing.h"
+#include "D3D11RenderContext.h"
+#include "D3DShaderCache.h"
+#include "D3D11TextureStreamer.h"
+#include "JobSystem.h"
+#include "LabStreaming.h"
 
-class D3D11Renderer
+class D3D11Renderer : public ISceneBackend
 {
 private:
     HWND m_hWnd;
+    bool m_headless;
     UINT m_width;
     UINT m_height;
 
@@ -16,12 +25,22 @@ private:
     ID3D11RenderTargetView* m_pBackBufferRTV;
     ID3D11DepthStencilView* m_pDepthStencilView;
 
+    // Headless mode renders into m_pOffscreenTarget instead of a swap chain
+    // and reads it back through m_pReadbackTexture.
+    ID3D11Texture2D* m_pOffscreenTarget;
+    ID3D11Texture2D* m_pReadbackTexture;
+    ID3D11Query* m_pFinishQuery;
+
     ID3D11Buffer* m_pVertexBuffer;
     ID3D11Buffer* m_pIndexBuffer;
     ID3D11VertexShader* m_pVertexShader;
     ID3D11PixelShader* m_pPixelShader;
     ID3D11InputLayout* m_pInputLayout;
-    ID3D11Buffer* m_pModelCB;
+
+    // Cubes are drawn instanced; the scene's instance data is streamed
+    // through m_pInstanceBuffer every frame.
+    ID3D11Buffer* m_pInstanceBuffer;
+    UINT m_instanceCapacity;
 
     ID3D11Buffer* m_pSkyboxVertexBuffer;
     ID3D11Buffer* m_pSkyboxIndexBuffer;
@@ -29,12 +48,39 @@ private:
     ID3D11PixelShader* m_pSkyboxPS;
     ID3D11InputLayout* m_pSkyboxInputLayout;
 
+    // Constants come out of m_constantRing, one slice per bind; with no
+    // offset binding they go through m_pViewProjCB instead.
     ID3D11Buffer* m_pViewProjCB;
-    ID3D11ShaderResourceView* m_pTextureView;
-    ID3D11ShaderResourceView* m_pCubemapView;
+    D3D11ConstantRing m_constantRing;
     ID3D11SamplerState* m_pSampler;
 
-    Camera m_camera;
+    StateCache m_stateCache;
+    ID3D11DepthStencilState* m_pSkyboxDepthState;
+    ID3D11RasterizerState* m_pSkyboxRasterizerState;
+    ID3D11DepthStencilState* m_pCubeDepthState;
+    ID3D11RasterizerState* m_pCubeRasterizerState;
+
+    D3D11RenderContext m_renderContext;
+    CommandRecorder m_commands;
+
+    LoadScheduler m_loadScheduler;
+    std::future<DdsView> m_textureLoad;
+    std::future<DdsView> m_cubemapLoad;         // skybox.dds, if it was cooked
+    std::future<DdsView> m_cubemapFaceLoads[6];
+
+    // wood02 and the skybox start as their mip tails and refine toward
+    // what the camera needs; see SetTextureBudget().
+    D3D11TextureStreamer m_textureStreamer;
+    LabStreamingTextures m_streamingTextures;
+
+    ShaderCacheStats m_shaderCacheStats;
+
+    // Scene update, culling and instance data run on every core
+    JobSystem m_jobs;
+    LabScene m_scene;
+    std::vector<uint32_t> m_visible;            // cubes that survive culling
+    InstanceBatcher m_instances;
+    OcclusionCuller m_occlusion;                // the lab cube hides floor cubes
     double m_lastFrameTime;
 
     bool m_keyLeft, m_keyRight, m_keyUp, m_keyDown;
@@ -44,18 +90,48 @@ public:
     ~D3D11Renderer();
 
     bool Initialize(HWND hWnd, UINT width, UINT height);
+    // No window or swap chain: frames go to an offscreen target that
+    // ReadPixels() copies back. Errors are printed instead of shown.
+    bool InitializeHeadless(UINT width, UINT height);
     void Cleanup();
     void Render();
     void Resize(UINT newWidth, UINT newHeight);
     void HandleKey(UINT key, bool isDown);
+    void HandleClick(int x, int y);     // client-area pixel
+
+    // Number of cubes in the scene; must be set before Initialize().
+    void SetCubeCount(UINT count) { m_scene.SetCubeCount(count); }
+    LabScene& GetScene() { return m_scene; }
+    // Video memory for streamed textures, 0 for no limit (the default);
+    // must be set before Initialize().
+    void SetTextureBudget(uint64_t bytes) { m_textureStreamer.GetPlanner().SetBudget(bytes); }
+
+    const char* GetName() const override { return "d3d11"; }
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+    void RenderFrame(const LabScene& scene) override;
+    void Finish() override;
+    bool ReadPixels(std::vector<uint8_t>& rgba) override;
+
+    const RenderCommandStats& GetCommandStats() const { return m_commands.GetLastFrameStats(); }
+    const ShaderCacheStats& GetShaderCacheStats() const { return m_shaderCacheStats; }
+    const StreamingStats& GetStreamingStats() const { return m_textureStreamer.GetPlanner().GetStats(); }
 
 private:
     bool CreateDeviceAndSwapChain();
+    bool CreateDevice();
     bool CreateRenderTargetAndDepthStencil();
+    bool CreateOffscreenTarget();
+    bool CreateDepthStencil(UINT width, UINT height);
+    bool CreateResources();
     bool CreateBuffers();
+    bool EnsureInstanceCapacity(UINT count);
     bool CompileShaders();
+    bool CreateRenderStates();
+    void BeginTextureLoads();
     bool LoadTextures();
-    void UpdateCamera(float deltaTime);
-    void RenderSkybox(const XMMATRIX& vpSky);
-    void RenderCube(const XMMATRIX& view, const XMMATRIX& proj, float time);
+    void ReportError(const char* message) const;
+    void SetViewProj(const Float4x4& vp);
+    void RenderSkybox(const Float4x4& vpSky);
+    void RenderCube(const InstanceBatcher& instances, const Float4x4& vp);
 };
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "D3D11TextureStreamer.h"
+#include <chrono>
+
+D3D11TextureStreamer::D3D11TextureStreamer(LoadScheduler& scheduler)
+    : m_scheduler(scheduler)
+{
+}
+
+D3D11TextureStreamer::~D3D11TextureStreamer()
+{
+    Cleanup();
+}
+
+bool D3D11TextureStreamer::AddTexture(ID3D11Device* device, DdsView&& view, const char* name, uint32_t& id)
+{
+    Texture texture;
+    texture.views.push_back(std::move(view));
+    return Register(device, texture, name, id);
+}
+
+bool D3D11TextureStreamer::AddCubemap(ID3D11Device* device, DdsView* faces, const char* name, uint32_t& id)
+{
+    Texture texture;
+    for (int i = 0; i < 6; ++i)
+        texture.views.push_back(std::move(faces[i]));
+    return Register(device, texture, name, id);
+}
+
+bool D3D11TextureStreamer::Register(ID3D11Device* device, Texture& texture, const char* name, uint32_t& id)
+{
+    for (const DdsView& view : texture.views)
+    {
+        if (!view.IsOpen())
+            return false;
+    }
+
+    StreamingTextureDesc desc = MakeStreamingDesc(name, texture.views.data(), (uint32_t)texture.views.size());
+    if (desc.mipBytes.empty())
+        return false;
+
+    id = m_planner.AddTexture(desc);
+    texture.createdMip = m_planner.GetResidentMip(id);
+    texture.pView = CreateView(device, texture, texture.createdMip);
+    m_textures.push_back(std::move(texture));
+    return m_textures.back().pView != nullptr;
+}
+
+ID3D11ShaderResourceView* D3D11TextureStreamer::CreateView(ID3D11Device* device, const Texture& texture,
+    uint32_t firstMip) const
+{
+    if (texture.views.size() == 6)
+        return TextureLoader::CreateCubemap(device, texture.views.data(), firstMip, &m_scheduler);
+    return TextureLoader::CreateTexture2D(device, texture.views[0], firstMip, &m_scheduler);
+}
+
+void D3D11TextureStreamer::CollectLoads(bool wait)
+{
+    for (uint32_t id = 0; id < (uint32_t)m_textures.size(); ++id)
+    {
+        Texture& texture = m_textures[id];
+        if (!texture.pending.valid())
+            continue;
+        if (!wait && texture.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+
+        texture.pending.get();
+        m_planner.CompleteLoad(id, texture.pendingMip);
+    }
+}
+
+void D3D11TextureStreamer::Update(ID3D11Device* device)
+{
+    CollectLoads(false);
+
+    // A request only pages the level in from the mapping; the texture is
+    // built from it below, on this thread, once the planner counts it.
+    m_requests.clear();
+    m_planner.Update(m_requests);
+    for (const StreamingRequest& request : m_requests)
+    {
+        Texture& texture = m_textures[request.texture];
+        const DdsView* pViews = texture.views.data();
+        const size_t viewCount = texture.views.size();
+        const uint32_t mip = request.mip;
+        texture.pendingMip = mip;
+        texture.pending = m_scheduler.Submit([pViews, viewCount, mip]() {
+            for (size_t i = 0; i < viewCount; ++i)
+                pViews[i].PrefetchMip(mip);
+        });
+    }
+
+    for (uint32_t id = 0; id < (uint32_t)m_textures.size(); ++id)
+    {
+        Texture& texture = m_textures[id];
+        const uint32_t resident = m_planner.GetResidentMip(id);
+        if (resident == texture.createdMip)
+            continue;
+
+        // Keep drawing with the old texture if the new one cannot be made.
+        ID3D11ShaderResourceView* pView = CreateView(device, texture, resident);
+        if (!pView)
+            continue;
+        SAFE_RELEASE(texture.pView);
+        texture.pView = pView;
+        texture.createdMip = resident;
+    }
+}
+
+void D3D11TextureStreamer::Flush(ID3D11Device* device)
+{
+    for (;;)
+    {
+        CollectLoads(true);
+        Update(device);
+
+        bool loading = false;
+        for (uint32_t id = 0; id < (uint32_t)m_textures.size(); ++id)
+            loading = loading || m_planner.IsLoading(id);
+        if (!loading)
+            break;
+    }
+}
+
+void D3D11TextureStreamer::Cleanup()
+{
+    // Jobs still read from the views; let them finish before unmapping.
+    for (Texture& texture : m_textures)
+    {
+        if (texture.pending.valid())
+            texture.pending.wait();
+        SAFE_RELEASE(texture.pView);
+    }
+    m_textures.clear();
+
+    const uint64_t budget = m_planner.GetBudget();
+    m_planner = TextureStreamingPlanner();
+    m_planner.SetBudget(budget);
+}
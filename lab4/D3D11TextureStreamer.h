@@ -0,0 +1,59 @@
+#pragma once
+#include "Common.h"
+#include "TextureLoader.h"
+#include "TextureStreaming.h"
+
+// Runs a TextureStreamingPlanner against real D3D11 textures. Each texture
+// starts as just its mip tail; requested levels are paged in from the
+// mapped DDS file on the load scheduler, and whenever the planner's
+// resident mip changes the SRV is rebuilt to start at that mip. D3D11 has
+// no partial residency, so refining or evicting means recreating the
+// texture, which is cheap next to the disk reads it replaces.
+class D3D11TextureStreamer
+{
+public:
+    explicit D3D11TextureStreamer(LoadScheduler& scheduler);
+    ~D3D11TextureStreamer();
+
+    D3D11TextureStreamer(const D3D11TextureStreamer&) = delete;
+    D3D11TextureStreamer& operator=(const D3D11TextureStreamer&) = delete;
+
+    // Takes the views over; they stay mapped for as long as the texture is
+    // streamed. Returns false if the tail texture cannot be created. A
+    // single view may hold a 2D texture, an array or a whole cube map.
+    bool AddTexture(ID3D11Device* device, DdsView&& view, const char* name, uint32_t& id);
+    bool AddCubemap(ID3D11Device* device, DdsView* faces, const char* name, uint32_t& id);
+
+    // Collects finished loads, issues new ones and rebuilds textures whose
+    // resident mip changed. Call once per frame after SetRequiredMip().
+    void Update(ID3D11Device* device);
+
+    // Update() until every texture has reached its target, blocking on the
+    // loads. Keeps offscreen runs independent of disk timing.
+    void Flush(ID3D11Device* device);
+
+    void Cleanup();
+
+    ID3D11ShaderResourceView* GetView(uint32_t id) const { return m_textures[id].pView; }
+    TextureStreamingPlanner& GetPlanner() { return m_planner; }
+    const TextureStreamingPlanner& GetPlanner() const { return m_planner; }
+
+private:
+    struct Texture
+    {
+        std::vector<DdsView> views;     // one file, or six cube face files
+        ID3D11ShaderResourceView* pView = nullptr;
+        uint32_t createdMip = 0;
+        std::future<void> pending;
+        uint32_t pendingMip = 0;
+    };
+
+    bool Register(ID3D11Device* device, Texture& texture, const char* name, uint32_t& id);
+    ID3D11ShaderResourceView* CreateView(ID3D11Device* device, const Texture& texture, uint32_t firstMip) const;
+    void CollectLoads(bool wait);
+
+    LoadScheduler& m_scheduler;
+    TextureStreamingPlanner m_planner;
+    std::vector<Texture> m_textures;
+    std::vector<StreamingRequest> m_requests;
+};
@@ -0,0 +1,90 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "D3DShaderCache.h"
+#include <cstdio>
+#include <cstring>
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+const char* const D3D_SHADER_COMPILER_ID = D3DCOMPILER_DLL_A;
+
+static_assert(sizeof(ShaderDefine) == sizeof(D3D_SHADER_MACRO), "ShaderDefine must match D3D_SHADER_MACRO");
+
+bool CompileShaderWithD3D(const ShaderSource& source, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+    ID3DBlob* pCode = nullptr;
+    ID3DBlob* pErrors = nullptr;
+    HRESULT hr = D3DCompile(source.pText, source.textSize, nullptr, (const D3D_SHADER_MACRO*)source.pDefines,
+        nullptr, source.entryPoint, source.target, source.flags, 0, &pCode, &pErrors);
+
+    if (pErrors)
+    {
+        errors.assign((const char*)pErrors->GetBufferPointer(), pErrors->GetBufferSize());
+        pErrors->Release();
+    }
+    if (FAILED(hr) || !pCode)
+    {
+        if (pCode)
+            pCode->Release();
+        return false;
+    }
+
+    const uint8_t* pBytes = (const uint8_t*)pCode->GetBufferPointer();
+    bytecode.assign(pBytes, pBytes + pCode->GetBufferSize());
+    pCode->Release();
+    return true;
+}
+
+HRESULT CompileShaderCached(ShaderCache& cache, const char* pSource, size_t sourceSize,
+    const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target, UINT flags,
+    ID3DBlob** ppCode, ID3DBlob** ppErrors)
+{
+    *ppCode = nullptr;
+
+    ShaderSource source;
+    source.pText = pSource;
+    source.textSize = sourceSize;
+    source.entryPoint = entryPoint;
+    source.target = target;
+    source.pDefines = (const ShaderDefine*)pDefines;
+    source.flags = flags;
+
+    std::vector<uint8_t> bytecode;
+    std::string errors;
+    if (!cache.Compile(source, bytecode, &errors))
+    {
+        if (ppErrors && SUCCEEDED(D3DCreateBlob(errors.size() + 1, ppErrors)))
+            memcpy((*ppErrors)->GetBufferPointer(), errors.c_str(), errors.size() + 1);
+        return E_FAIL;
+    }
+
+    HRESULT hr = D3DCreateBlob(bytecode.size(), ppCode);
+    if (FAILED(hr))
+        return hr;
+    memcpy((*ppCode)->GetBufferPointer(), bytecode.data(), bytecode.size());
+    return S_OK;
+}
+
+std::string GetShaderCachePath(const wchar_t* fileName)
+{
+    wchar_t exePath[MAX_PATH];
+    GetModuleFileNameW(NULL, exePath, MAX_PATH);
+    std::wstring path(exePath);
+    size_t pos = path.find_last_of(L"\\/");
+    if (pos != std::wstring::npos)
+        path = path.substr(0, pos + 1);
+    path += fileName;
+
+    char buffer[MAX_PATH] = {};
+    WideCharToMultiByte(CP_ACP, 0, path.c_str(), -1, buffer, MAX_PATH, nullptr, nullptr);
+    return buffer;
+}
+
+void ReportShaderCacheStats(const char* label, const ShaderCacheStats& stats)
+{
+    char message[256];
+    snprintf(message, sizeof(message),
+        "%s shader cache: %u hits, %u misses (%.0f%% hit rate), %.1f ms compiling, %.1f ms saved\n",
+        label, stats.hits, stats.misses, stats.GetHitRate() * 100.0, stats.compileMs, stats.savedMs);
+    OutputDebugStringA(message);
+}
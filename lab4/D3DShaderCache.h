@@ -0,0 +1,24 @@
+#pragma once
+#include "ShaderCache.h"
+#include <d3dcompiler.h>
+
+// The D3DCompile side of ShaderCache, shared by lab3, lab4 and lab5.
+
+// Goes into every cache key, so a different compiler DLL misses.
+extern const char* const D3D_SHADER_COMPILER_ID;
+
+// ShaderCompileFn that runs D3DCompile.
+bool CompileShaderWithD3D(const ShaderSource& source, std::vector<uint8_t>& bytecode, std::string& errors);
+
+// Drop-in for D3DCompile(pSource, size, nullptr, pDefines, nullptr, entry,
+// target, flags, 0, ppCode, ppErrors) that goes through cache. *ppErrors is
+// only set on failure.
+HRESULT CompileShaderCached(ShaderCache& cache, const char* pSource, size_t sourceSize,
+    const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target, UINT flags,
+    ID3DBlob** ppCode, ID3DBlob** ppErrors);
+
+// fileName next to the executable, as a path for ShaderCache::Open().
+std::string GetShaderCachePath(const wchar_t* fileName);
+
+// One line with hits, misses and time saved to the debugger output.
+void ReportShaderCacheStats(const char* label, const ShaderCacheStats& stats);
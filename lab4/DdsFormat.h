@@ -0,0 +1,273 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// DDS file layout shared by the Win32 loader and the portable DdsView parser.
+// Nothing in here depends on windows.h so the parsing code can be built on
+// any platform.
+
+#ifdef _WIN32
+#include <dxgiformat.h>
+#else
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN = 0,
+    DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+    DXGI_FORMAT_BC1_UNORM = 71,
+    DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+    DXGI_FORMAT_BC2_UNORM = 74,
+    DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+    DXGI_FORMAT_BC3_UNORM = 77,
+    DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+    DXGI_FORMAT_BC4_UNORM = 80,
+    DXGI_FORMAT_BC4_SNORM = 81,
+    DXGI_FORMAT_BC5_UNORM = 83,
+    DXGI_FORMAT_BC5_SNORM = 84,
+    DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+    DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+    DXGI_FORMAT_BC6H_UF16 = 95,
+    DXGI_FORMAT_BC6H_SF16 = 96,
+    DXGI_FORMAT_BC7_UNORM = 98,
+    DXGI_FORMAT_BC7_UNORM_SRGB = 99
+};
+#endif
+
+#ifndef MAKEFOURCC
+#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
+    ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | \
+     ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24))
+#endif
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t dwSize;
+    uint32_t dwFlags;
+    uint32_t dwFourCC;
+    uint32_t dwRGBBitCount;
+    uint32_t dwRBitMask;
+    uint32_t dwGBitMask;
+    uint32_t dwBBitMask;
+    uint32_t dwABitMask;
+};
+
+struct DDS_HEADER
+{
+    uint32_t dwSize;
+    uint32_t dwHeaderFlags;
+    uint32_t dwHeight;
+    uint32_t dwWidth;
+    uint32_t dwPitchOrLinearSize;
+    uint32_t dwDepth;
+    uint32_t dwMipMapCount;
+    uint32_t dwReserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t dwSurfaceFlags;
+    uint32_t dwCubemapFlags;
+    uint32_t dwReserved2[3];
+};
+
+// Follows DDS_HEADER when ddspf.dwFourCC is FOURCC_DX10.
+struct DDS_HEADER_DXT10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;         // cubes, not faces, for a cube map
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDS_PIXELFORMAT) == 32, "DDS_PIXELFORMAT must match the file layout");
+static_assert(sizeof(DDS_HEADER) == 124, "DDS_HEADER must match the file layout");
+static_assert(sizeof(DDS_HEADER_DXT10) == 20, "DDS_HEADER_DXT10 must match the file layout");
+
+#define DDS_MAGIC 0x20534444
+#define DDS_HEADER_FLAGS_TEXTURE 0x00001007
+#define DDS_HEADER_FLAGS_MIPMAP 0x00020000
+#define DDS_HEADER_FLAGS_LINEARSIZE 0x00080000
+#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000
+#define DDS_SURFACE_FLAGS_MIPMAP 0x00400000
+#define DDS_SURFACE_FLAGS_CUBEMAP 0x00000008
+#define DDS_CUBEMAP 0x00000200
+#define DDS_CUBEMAP_ALLFACES 0x0000FE00
+#define DDS_HEADER_FLAGS_PITCH 0x00000008
+#define DDS_ALPHAPIXELS 0x00000001
+#define DDS_FOURCC 0x00000004
+#define DDS_RGB 0x00000040
+
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+
+#define FOURCC_DXT1 MAKEFOURCC('D','X','T','1')
+#define FOURCC_DXT2 MAKEFOURCC('D','X','T','2')
+#define FOURCC_DXT3 MAKEFOURCC('D','X','T','3')
+#define FOURCC_DXT4 MAKEFOURCC('D','X','T','4')
+#define FOURCC_DXT5 MAKEFOURCC('D','X','T','5')
+#define FOURCC_ATI1 MAKEFOURCC('A','T','I','1')
+#define FOURCC_ATI2 MAKEFOURCC('A','T','I','2')
+#define FOURCC_BC4U MAKEFOURCC('B','C','4','U')
+#define FOURCC_BC4S MAKEFOURCC('B','C','4','S')
+#define FOURCC_BC5U MAKEFOURCC('B','C','5','U')
+#define FOURCC_BC5S MAKEFOURCC('B','C','5','S')
+#define FOURCC_DX10 MAKEFOURCC('D','X','1','0')
+
+// Memory order of the texels of a surface. Uncompressed files are
+// identified by their bit masks and converted to R8G8B8A8 on load (see
+// PixelConverter.h); only RGBA32 can be used as stored.
+enum DdsPixelLayout
+{
+    DDS_PIXELS_UNKNOWN,
+    DDS_PIXELS_BLOCK,       // block compressed, see DdsBytesPerBlock()
+    DDS_PIXELS_RGBA32,
+    DDS_PIXELS_RGBX32,      // the fourth byte is padding, not alpha
+    DDS_PIXELS_BGRA32,
+    DDS_PIXELS_BGRX32,
+    DDS_PIXELS_RGB24,
+    DDS_PIXELS_BGR24
+};
+
+inline uint32_t DdsBytesPerPixel(DdsPixelLayout layout)
+{
+    switch (layout)
+    {
+    case DDS_PIXELS_RGBA32:
+    case DDS_PIXELS_RGBX32:
+    case DDS_PIXELS_BGRA32:
+    case DDS_PIXELS_BGRX32:
+        return 4;
+    case DDS_PIXELS_RGB24:
+    case DDS_PIXELS_BGR24:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+// Layout of a legacy DDS_RGB pixel format, from its bit count and masks.
+inline DdsPixelLayout DdsGetUncompressedLayout(const DDS_PIXELFORMAT& ddspf)
+{
+    if (!(ddspf.dwFlags & DDS_RGB))
+        return DDS_PIXELS_UNKNOWN;
+
+    const bool rgbOrder = ddspf.dwRBitMask == 0x000000FF && ddspf.dwGBitMask == 0x0000FF00 &&
+        ddspf.dwBBitMask == 0x00FF0000;
+    const bool bgrOrder = ddspf.dwRBitMask == 0x00FF0000 && ddspf.dwGBitMask == 0x0000FF00 &&
+        ddspf.dwBBitMask == 0x000000FF;
+
+    if (ddspf.dwRGBBitCount == 32)
+    {
+        // Some writers leave DDS_ALPHAPIXELS out, so the mask decides.
+        const bool alpha = ddspf.dwABitMask == 0xFF000000;
+        if (rgbOrder)
+            return alpha ? DDS_PIXELS_RGBA32 : DDS_PIXELS_RGBX32;
+        if (bgrOrder)
+            return alpha ? DDS_PIXELS_BGRA32 : DDS_PIXELS_BGRX32;
+    }
+    else if (ddspf.dwRGBBitCount == 24)
+    {
+        if (rgbOrder)
+            return DDS_PIXELS_RGB24;
+        if (bgrOrder)
+            return DDS_PIXELS_BGR24;
+    }
+    return DDS_PIXELS_UNKNOWN;
+}
+
+inline uint32_t DdsBytesPerBlock(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 8;
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+inline DXGI_FORMAT DdsGetFormat(const DDS_PIXELFORMAT& ddspf)
+{
+    if (ddspf.dwFlags & DDS_FOURCC)
+    {
+        switch (ddspf.dwFourCC)
+        {
+        case FOURCC_DXT1: return DXGI_FORMAT_BC1_UNORM;
+        case FOURCC_DXT2:
+        case FOURCC_DXT3: return DXGI_FORMAT_BC2_UNORM;
+        case FOURCC_DXT4:
+        case FOURCC_DXT5: return DXGI_FORMAT_BC3_UNORM;
+        case FOURCC_ATI1:
+        case FOURCC_BC4U: return DXGI_FORMAT_BC4_UNORM;
+        case FOURCC_BC4S: return DXGI_FORMAT_BC4_SNORM;
+        case FOURCC_ATI2:
+        case FOURCC_BC5U: return DXGI_FORMAT_BC5_UNORM;
+        case FOURCC_BC5S: return DXGI_FORMAT_BC5_SNORM;
+        default: return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+    else if (DdsGetUncompressedLayout(ddspf) != DDS_PIXELS_UNKNOWN)
+    {
+        // The format the texels end up in, not the one they are stored in.
+        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+// Layout for a format named by the DX10 header.
+inline DdsPixelLayout DdsGetPixelLayout(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM: return DDS_PIXELS_RGBA32;
+    case DXGI_FORMAT_B8G8R8A8_UNORM: return DDS_PIXELS_BGRA32;
+    case DXGI_FORMAT_B8G8R8X8_UNORM: return DDS_PIXELS_BGRX32;
+    default: return DdsBytesPerBlock(fmt) != 0 ? DDS_PIXELS_BLOCK : DDS_PIXELS_UNKNOWN;
+    }
+}
+
+inline DdsPixelLayout DdsGetPixelLayout(const DDS_PIXELFORMAT& ddspf)
+{
+    if (ddspf.dwFlags & DDS_FOURCC)
+        return DdsBytesPerBlock(DdsGetFormat(ddspf)) != 0 ? DDS_PIXELS_BLOCK : DDS_PIXELS_UNKNOWN;
+    return DdsGetUncompressedLayout(ddspf);
+}
+
+inline uint32_t DdsGetMipCount(const DDS_HEADER& header)
+{
+    if (!(header.dwSurfaceFlags & DDS_SURFACE_FLAGS_MIPMAP) || header.dwMipMapCount == 0)
+        return 1;
+    return header.dwMipMapCount;
+}
+
+// Row pitch and row count of one mip level of a block-compressed surface.
+inline void DdsGetMipLayout(DXGI_FORMAT fmt, uint32_t width, uint32_t height,
+    uint32_t& rowPitch, uint32_t& rowCount)
+{
+    rowPitch = ((width + 3) / 4) * DdsBytesPerBlock(fmt);
+    rowCount = (height + 3) / 4;
+}
+
+// Same for any layout: rows of blocks when compressed, of texels otherwise.
+inline void DdsGetMipLayout(DdsPixelLayout layout, DXGI_FORMAT fmt, uint32_t width, uint32_t height,
+    uint32_t& rowPitch, uint32_t& rowCount)
+{
+    if (layout == DDS_PIXELS_BLOCK)
+    {
+        DdsGetMipLayout(fmt, width, height, rowPitch, rowCount);
+        return;
+    }
+    rowPitch = width * DdsBytesPerPixel(layout);
+    rowCount = height;
+}
@@ -0,0 +1,271 @@
+#include "DdsLoadBench.h"
+#include "BenchUtil.h"
+#include "DdsView.h"
+#include "Hash.h"
+#include "PixelConverter.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    bool GetPeakResidentBytes(uint64_t& bytes)
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters = {};
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return false;
+        bytes = counters.PeakWorkingSetSize;
+        return true;
+#else
+#ifdef __linux__
+        // ru_maxrss never drops below the peak of the image this process
+        // was exec'd from; VmHWM is this process's own and can be reset.
+        if (FILE* pFile = fopen("/proc/self/status", "r"))
+        {
+            char line[256];
+            unsigned long long kb = 0;
+            bool found = false;
+            while (!found && fgets(line, sizeof(line), pFile))
+                found = sscanf(line, "VmHWM: %llu kB", &kb) == 1;
+            fclose(pFile);
+            if (found)
+            {
+                bytes = kb * 1024;
+                return true;
+            }
+        }
+#endif
+        rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return false;
+#ifdef __APPLE__
+        bytes = (uint64_t)usage.ru_maxrss;
+#else
+        bytes = (uint64_t)usage.ru_maxrss * 1024;
+#endif
+        return true;
+#endif
+    }
+
+    // Sets the high-water mark back to what is resident now; Linux only.
+    void ResetPeakResidentBytes()
+    {
+#ifdef __linux__
+        if (FILE* pFile = fopen("/proc/self/clear_refs", "w"))
+        {
+            fputs("5", pFile);
+            fclose(pFile);
+        }
+#endif
+    }
+
+    // LoadDDS copies these layouts as they are; the rest it converts.
+    bool IsCopiedVerbatim(const DdsView& view)
+    {
+        return view.GetPixelLayout() == DDS_PIXELS_BLOCK || view.GetPixelLayout() == DDS_PIXELS_RGBA32;
+    }
+
+    struct CopiedTexture
+    {
+        uint8_t* pData = nullptr;
+        size_t size = 0;
+    };
+
+    // TextureLoader::LoadDDS() without the TextureDesc.
+    bool LoadCopy(const std::string& path, CopiedTexture& texture)
+    {
+        DdsView view;
+        if (!view.Open(path.c_str()))
+            return false;
+        texture.size = GetDdsMipChainsSize(view, 0);
+        texture.pData = (uint8_t*)malloc(texture.size);
+        return texture.pData && CopyDdsMipChains(view, 0, texture.pData);
+    }
+
+    // Every span of every view, slice-major, back to back in the copies.
+    bool CopiesMatchViews(const std::vector<DdsView>& views, const std::vector<CopiedTexture>& copies)
+    {
+        for (size_t i = 0; i < views.size(); ++i)
+        {
+            size_t offset = 0;
+            for (uint32_t slice = 0; slice < views[i].GetArraySize(); ++slice)
+            {
+                for (uint32_t level = 0; level < views[i].GetMipCount(); ++level)
+                {
+                    const DdsMipSpan& mip = views[i].GetMip(slice, level);
+                    if (offset + mip.size > copies[i].size || memcmp(copies[i].pData + offset, mip.pData, mip.size) != 0)
+                        return false;
+                    offset += mip.size;
+                }
+            }
+            if (offset != copies[i].size)
+                return false;
+        }
+        return true;
+    }
+
+    void FreeCopies(std::vector<CopiedTexture>& copies)
+    {
+        for (CopiedTexture& texture : copies)
+            free(texture.pData);
+        copies.clear();
+    }
+
+    void BeginRow(DdsLoadBenchResult& result, uint64_t& peakBefore)
+    {
+        ResetPeakResidentBytes();
+        result.measured = GetPeakResidentBytes(peakBefore);
+    }
+
+    void EndRow(DdsLoadBenchResult& result, uint64_t peakBefore, uint32_t iterations)
+    {
+        result.loadMs /= iterations;
+        result.readMs /= iterations;
+        result.measured = result.measured && GetPeakResidentBytes(result.peakRssBytes);
+        if (!result.measured)
+            result.peakRssBytes = 0;
+        result.peakRssGrowth = result.peakRssBytes > peakBefore ? result.peakRssBytes - peakBefore : 0;
+    }
+}
+
+bool RunDdsLoadBenchmark(const DdsLoadBenchSet* pSets, uint32_t setCount, uint32_t iterations,
+    std::vector<DdsLoadBenchResult>& results)
+{
+    if (iterations == 0)
+        iterations = 1;
+
+    // Keeps the reads from being optimized away.
+    volatile uint64_t sink = 0;
+    for (uint32_t s = 0; s < setCount; ++s)
+    {
+        const DdsLoadBenchSet& set = pSets[s];
+        const uint32_t fileCount = (uint32_t)set.paths.size();
+
+        DdsLoadBenchResult view;
+        view.set = set.name;
+        view.path = "view";
+        view.files = fileCount;
+        uint64_t peakBefore = 0;
+        BeginRow(view, peakBefore);
+
+        std::vector<DdsView> views(fileCount);
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            views.clear();
+            views.resize(fileCount);
+            BenchClock::time_point start = BenchClock::now();
+            for (uint32_t f = 0; f < fileCount; ++f)
+            {
+                if (!views[f].Open(set.paths[f].c_str()) || !IsCopiedVerbatim(views[f]))
+                    return false;
+            }
+            BenchClock::time_point loaded = BenchClock::now();
+
+            uint64_t hash = 0;
+            for (const DdsView& texture : views)
+            {
+                for (uint32_t slice = 0; slice < texture.GetArraySize(); ++slice)
+                {
+                    for (uint32_t level = 0; level < texture.GetMipCount(); ++level)
+                    {
+                        const DdsMipSpan& mip = texture.GetMip(slice, level);
+                        hash ^= HashContent(mip.pData, mip.size);
+                    }
+                }
+            }
+            sink = sink + hash;
+            view.loadMs += ElapsedMs(start, loaded);
+            view.readMs += ElapsedMs(loaded, BenchClock::now());
+        }
+        for (const DdsView& texture : views)
+            view.textureBytes += GetDdsMipChainsSize(texture, 0);
+        EndRow(view, peakBefore, iterations);
+        views.clear();
+
+        DdsLoadBenchResult copy;
+        copy.set = set.name;
+        copy.path = "copy";
+        copy.files = fileCount;
+        copy.textureBytes = view.textureBytes;
+        BeginRow(copy, peakBefore);
+
+        std::vector<CopiedTexture> copies;
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            BenchClock::time_point start = BenchClock::now();
+            copies.resize(fileCount);
+            for (uint32_t f = 0; f < fileCount; ++f)
+            {
+                if (!LoadCopy(set.paths[f], copies[f]))
+                {
+                    FreeCopies(copies);
+                    return false;
+                }
+            }
+            BenchClock::time_point loaded = BenchClock::now();
+
+            uint64_t hash = 0;
+            for (const CopiedTexture& texture : copies)
+                hash ^= HashContent(texture.pData, texture.size);
+            sink = sink + hash;
+            copy.loadMs += ElapsedMs(start, loaded);
+            copy.readMs += ElapsedMs(loaded, BenchClock::now());
+
+            copy.bytesCopied = 0;
+            for (const CopiedTexture& texture : copies)
+                copy.bytesCopied += texture.size;
+            if (it + 1 < iterations)
+                FreeCopies(copies);
+        }
+        EndRow(copy, peakBefore, iterations);
+
+        // Outside the timing: the last copies against fresh views.
+        views.resize(fileCount);
+        for (uint32_t f = 0; f < fileCount; ++f)
+            views[f].Open(set.paths[f].c_str());
+        copy.matches = CopiesMatchViews(views, copies);
+        FreeCopies(copies);
+
+        results.push_back(view);
+        results.push_back(copy);
+    }
+    return true;
+}
+
+bool WriteDdsLoadBenchmarkCsv(const char* filename, const std::vector<DdsLoadBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "set,path,files,texture_bytes,bytes_copied,load_ms,read_ms,peak_rss_bytes,peak_rss_growth,"
+        "matches\n");
+    for (const DdsLoadBenchResult& r : results)
+    {
+        // Peak RSS stays empty where it could not be measured.
+        char peak[32] = "";
+        char growth[32] = "";
+        if (r.measured)
+        {
+            snprintf(peak, sizeof(peak), "%llu", (unsigned long long)r.peakRssBytes);
+            snprintf(growth, sizeof(growth), "%llu", (unsigned long long)r.peakRssGrowth);
+        }
+        fprintf(pFile, "%s,%s,%u,%llu,%llu,%.4f,%.4f,%s,%s,%d\n",
+            r.set.c_str(), r.path, r.files, (unsigned long long)r.textureBytes,
+            (unsigned long long)r.bytesCopied, r.loadMs, r.readMs, peak, growth, r.matches ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Files loaded together, such as the six faces of a cube map.
+struct DdsLoadBenchSet
+{
+    std::string name;
+    std::vector<std::string> paths;
+};
+
+// One set loaded one way, then read as an upload would read it. "view"
+// keeps a DdsView per file and reads its mip spans in the mapping; "copy"
+// does what TextureLoader::LoadDDS() does, copying every level into a heap
+// buffer per file, and reads those. Both hold the whole set at once, as a
+// cube map's creation does.
+//
+// Peak RSS is the process high-water mark after the row, mapped file pages
+// included. On Linux it is reset before every row, so peakRssGrowth is the
+// row's own; elsewhere it cannot be reset and only growth past earlier rows
+// shows.
+struct DdsLoadBenchResult
+{
+    std::string set;
+    const char* path = "";
+    uint32_t files = 0;
+    uint64_t textureBytes = 0;      // texel data in the files
+    uint64_t bytesCopied = 0;       // per load
+    double loadMs = 0.0;            // open, and copy for "copy"
+    double readMs = 0.0;            // reading what was loaded
+    bool measured = false;          // peak RSS available
+    uint64_t peakRssBytes = 0;
+    uint64_t peakRssGrowth = 0;
+    bool matches = true;            // "copy" holds exactly the bytes "view" spans
+};
+
+bool RunDdsLoadBenchmark(const DdsLoadBenchSet* pSets, uint32_t setCount, uint32_t iterations,
+    std::vector<DdsLoadBenchResult>& results);
+
+bool WriteDdsLoadBenchmarkCsv(const char* filename, const std::vector<DdsLoadBenchResult>& results);
@@ -0,0 +1,318 @@
+#include "DdsView.h"
+#include <cstring>
+
+DdsView::DdsView()
+    : m_pBase(nullptr), m_size(0), m_fmt(DXGI_FORMAT_UNKNOWN), m_layout(DDS_PIXELS_UNKNOWN), m_width(0), m_height(0),
+    m_mipCount(0), m_arraySize(0), m_cubemap(false), m_dx10(false)
+{
+}
+
+DdsView::~DdsView()
+{
+    Close();
+}
+
+DdsView::DdsView(DdsView&& other) noexcept
+    : m_file(std::move(other.m_file)), m_pBase(other.m_pBase), m_size(other.m_size), m_fmt(other.m_fmt),
+    m_layout(other.m_layout), m_width(other.m_width), m_height(other.m_height), m_mipCount(other.m_mipCount),
+    m_arraySize(other.m_arraySize), m_cubemap(other.m_cubemap), m_dx10(other.m_dx10),
+    m_mips(std::move(other.m_mips))
+{
+    other.m_pBase = nullptr;
+    other.m_size = 0;
+}
+
+DdsView& DdsView::operator=(DdsView&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_file = std::move(other.m_file);
+        m_pBase = other.m_pBase;
+        m_size = other.m_size;
+        m_fmt = other.m_fmt;
+        m_layout = other.m_layout;
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_mipCount = other.m_mipCount;
+        m_arraySize = other.m_arraySize;
+        m_cubemap = other.m_cubemap;
+        m_dx10 = other.m_dx10;
+        m_mips = std::move(other.m_mips);
+        other.m_pBase = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+bool DdsView::Open(const wchar_t* filename, bool readAhead)
+{
+    Close();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(filename, readAhead))
+        return false;
+    m_file = std::move(file);
+    return Validate();
+}
+
+bool DdsView::Open(const char* filename, bool readAhead)
+{
+    Close();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(filename, readAhead))
+        return false;
+    m_file = std::move(file);
+    return Validate();
+}
+
+bool DdsView::Adopt(std::shared_ptr<const MappedFile> file, const DdsTextureInfo& info,
+    const uint8_t* pData, size_t size, std::vector<DdsMipSpan>&& mips)
+{
+    Close();
+
+    if (!file || !pData || info.mipCount == 0 || mips.size() != (size_t)info.arraySize * info.mipCount)
+        return false;
+
+    m_file = std::move(file);
+    m_pBase = pData;
+    m_size = size;
+    m_fmt = info.fmt;
+    m_layout = info.layout;
+    m_width = info.width;
+    m_height = info.height;
+    m_mipCount = info.mipCount;
+    m_arraySize = info.arraySize;
+    m_cubemap = info.cubemap;
+    m_mips = std::move(mips);
+    return true;
+}
+
+void DdsView::Close()
+{
+    m_file.reset();
+    m_pBase = nullptr;
+    m_size = 0;
+    m_fmt = DXGI_FORMAT_UNKNOWN;
+    m_layout = DDS_PIXELS_UNKNOWN;
+    m_width = 0;
+    m_height = 0;
+    m_mipCount = 0;
+    m_arraySize = 0;
+    m_cubemap = false;
+    m_dx10 = false;
+    m_mips.clear();
+}
+
+void DdsView::Prefetch() const
+{
+    const size_t pageSize = 4096;
+    volatile uint8_t sink = 0;
+    for (size_t offset = 0; offset < m_size; offset += pageSize)
+        sink = (uint8_t)(sink + m_pBase[offset]);
+    (void)sink;
+}
+
+void DdsView::PrefetchMip(uint32_t level) const
+{
+    if (level >= m_mipCount)
+        return;
+
+    const size_t pageSize = 4096;
+    volatile uint8_t sink = 0;
+    for (uint32_t slice = 0; slice < m_arraySize; ++slice)
+    {
+        const DdsMipSpan& mip = GetMip(slice, level);
+        for (size_t offset = 0; offset < mip.size; offset += pageSize)
+            sink = (uint8_t)(sink + mip.pData[offset]);
+    }
+    (void)sink;
+}
+
+void DdsView::ReadAheadMips(uint32_t firstMip) const
+{
+    for (uint32_t slice = 0; slice < m_arraySize; ++slice)
+    {
+        for (uint32_t level = firstMip; level < m_mipCount; ++level)
+            MappedFile::ReadAhead(GetMip(slice, level).pData, GetMip(slice, level).size);
+    }
+}
+
+bool DdsView::Validate()
+{
+    m_pBase = m_file->GetData();
+    m_size = m_file->GetSize();
+    if (m_size < sizeof(uint32_t) + sizeof(DDS_HEADER))
+    {
+        Close();
+        return false;
+    }
+
+    uint32_t magic;
+    memcpy(&magic, m_pBase, sizeof(magic));
+    DDS_HEADER header;
+    memcpy(&header, m_pBase + sizeof(uint32_t), sizeof(header));
+
+    // Far past D3D's 16384 limit is damage; it also keeps row pitches in 32 bits.
+    const uint32_t maxDimension = 1u << 20;
+    if (magic != DDS_MAGIC || header.dwSize != sizeof(DDS_HEADER) ||
+        header.ddspf.dwSize != sizeof(DDS_PIXELFORMAT) ||
+        header.dwWidth == 0 || header.dwHeight == 0 ||
+        header.dwWidth > maxDimension || header.dwHeight > maxDimension)
+    {
+        Close();
+        return false;
+    }
+
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    uint32_t arraySize = 1;
+    bool cubemap = false;
+
+    if ((header.ddspf.dwFlags & DDS_FOURCC) && header.ddspf.dwFourCC == FOURCC_DX10)
+    {
+        if (m_size - offset < sizeof(DDS_HEADER_DXT10))
+        {
+            Close();
+            return false;
+        }
+
+        DDS_HEADER_DXT10 dx10;
+        memcpy(&dx10, m_pBase + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+
+        // 1D and volume textures are not supported.
+        if (dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10.arraySize == 0)
+        {
+            Close();
+            return false;
+        }
+
+        m_layout = DdsGetPixelLayout((DXGI_FORMAT)dx10.dxgiFormat);
+        m_fmt = m_layout == DDS_PIXELS_BLOCK ? (DXGI_FORMAT)dx10.dxgiFormat : DXGI_FORMAT_R8G8B8A8_UNORM;
+        m_dx10 = true;
+        cubemap = (dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+        arraySize = dx10.arraySize;
+    }
+    else
+    {
+        m_layout = DdsGetPixelLayout(header.ddspf);
+        m_fmt = DdsGetFormat(header.ddspf);
+        if (header.dwCubemapFlags & DDS_CUBEMAP)
+        {
+            // Legacy cube maps may leave faces out; D3D cannot create those.
+            if ((header.dwCubemapFlags & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+            {
+                Close();
+                return false;
+            }
+            cubemap = true;
+        }
+    }
+
+    if (m_layout == DDS_PIXELS_UNKNOWN)
+    {
+        Close();
+        return false;
+    }
+
+    // Cube arrays count cubes in the header; a slice count that overflows
+    // is damage rather than a real file.
+    const uint32_t faces = cubemap ? 6 : 1;
+    if (arraySize > UINT32_MAX / faces)
+    {
+        Close();
+        return false;
+    }
+
+    m_width = header.dwWidth;
+    m_height = header.dwHeight;
+    m_mipCount = DdsGetMipCount(header);
+    m_arraySize = arraySize * faces;
+    m_cubemap = cubemap;
+
+    // Every mip halves down to 1x1, so more levels than bits is damage.
+    if (m_mipCount > 32)
+    {
+        Close();
+        return false;
+    }
+
+    // Every slice has the same chain, so the file size can be checked once
+    // before anything is allocated for a damaged slice count.
+    DdsMipSpan chain[32];
+    size_t sliceSize = 0;
+    uint32_t width = m_width;
+    uint32_t height = m_height;
+    for (uint32_t i = 0; i < m_mipCount; ++i)
+    {
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(m_layout, m_fmt, width, height, rowPitch, rowCount);
+        const size_t mipSize = (size_t)rowPitch * rowCount;
+        if (mipSize > UINT32_MAX)
+        {
+            Close();
+            return false;
+        }
+        chain[i].size = (uint32_t)mipSize;
+        chain[i].rowPitch = rowPitch;
+        chain[i].width = width;
+        chain[i].height = height;
+        sliceSize += chain[i].size;
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    if (sliceSize == 0 || (m_size - offset) / sliceSize < m_arraySize)
+    {
+        Close();
+        return false;
+    }
+
+    m_mips.resize((size_t)m_arraySize * m_mipCount);
+    for (uint32_t slice = 0; slice < m_arraySize; ++slice)
+    {
+        for (uint32_t i = 0; i < m_mipCount; ++i)
+        {
+            DdsMipSpan& mip = m_mips[(size_t)slice * m_mipCount + i];
+            mip = chain[i];
+            mip.pData = m_pBase + offset;
+            offset += mip.size;
+        }
+    }
+
+    return true;
+}
+
+uint32_t GetQualityFirstMip(const DdsView& view, const TextureQuality& quality)
+{
+    if (!view.IsOpen())
+        return 0;
+
+    const uint32_t lastMip = view.GetMipCount() - 1;
+    uint32_t firstMip = quality.dropMips < lastMip ? quality.dropMips : lastMip;
+    if (quality.maxDimension != 0)
+    {
+        while (firstMip < lastMip &&
+            (view.GetMip(firstMip).width > quality.maxDimension || view.GetMip(firstMip).height > quality.maxDimension))
+            ++firstMip;
+    }
+    return firstMip;
+}
+
+DdsView LoadDdsView(const wchar_t* filename, bool prefetch)
+{
+    DdsView view;
+    if (view.Open(filename) && prefetch)
+        view.Prefetch();
+    return view;
+}
+
+DdsView LoadDdsView(const char* filename, bool prefetch)
+{
+    DdsView view;
+    if (view.Open(filename) && prefetch)
+        view.Prefetch();
+    return view;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "DdsFormat.h"
+#include "MappedFile.h"
+#include <memory>
+#include <vector>
+
+// One mip level of a mapped DDS surface. pData points into the file mapping.
+struct DdsMipSpan
+{
+    const uint8_t* pData = nullptr;
+    uint32_t size = 0;
+    uint32_t rowPitch = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// Shape of a texture handed to DdsView::Adopt().
+struct DdsTextureInfo
+{
+    DXGI_FORMAT fmt = DXGI_FORMAT_UNKNOWN;
+    DdsPixelLayout layout = DDS_PIXELS_UNKNOWN;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+    uint32_t arraySize = 0;
+    bool cubemap = false;
+};
+
+// How much of a texture to load, for low-memory configurations and quick
+// previews: dropMips top levels are left out, then more until the top one
+// fits in maxDimension (0 for no limit). The last level is always kept.
+struct TextureQuality
+{
+    uint32_t dropMips = 0;
+    uint32_t maxDimension = 0;
+
+    bool IsFull() const { return dropMips == 0 && maxDimension == 0; }
+};
+
+// Read-only, zero-copy view of a DDS file. The file is mapped into memory,
+// the header is validated in place and every mip level is exposed as a span
+// into the mapping, so texture uploads read straight from the page cache.
+// Understands the legacy header and the DX10 extension; cube maps and
+// texture arrays are exposed as slices, six per cube in +X -X +Y -Y +Z -Z
+// order, which is how they follow each other in the file. Uncompressed
+// files report R8G8B8A8 as their format; GetPixelLayout() says how the
+// texels are actually stored.
+class DdsView
+{
+public:
+    DdsView();
+    ~DdsView();
+
+    DdsView(DdsView&& other) noexcept;
+    DdsView& operator=(DdsView&& other) noexcept;
+    DdsView(const DdsView&) = delete;
+    DdsView& operator=(const DdsView&) = delete;
+
+    // readAhead = false reads only the pages that are touched or passed to
+    // ReadAheadMips(), so levels that are never used are never read.
+    bool Open(const wchar_t* filename, bool readAhead = true);
+    bool Open(const char* filename, bool readAhead = true);
+    // Takes a texture already laid out inside a mapped file, such as an
+    // AssetArchive entry: pData..pData + size holds it and mips are its
+    // arraySize * mipCount spans, slice-major. Nothing is parsed; the caller
+    // has validated the spans. The view keeps file mapped.
+    bool Adopt(std::shared_ptr<const MappedFile> file, const DdsTextureInfo& info,
+        const uint8_t* pData, size_t size, std::vector<DdsMipSpan>&& mips);
+    void Close();
+
+    // Touches every page of the mapping so the file is read into memory on
+    // the calling thread instead of on first access during upload.
+    void Prefetch() const;
+
+    // Same for a single mip level of every slice.
+    void PrefetchMip(uint32_t level) const;
+
+    // Starts reading levels firstMip.. of every slice in the background and
+    // returns right away.
+    void ReadAheadMips(uint32_t firstMip) const;
+
+    bool IsOpen() const { return m_pBase != nullptr; }
+    DXGI_FORMAT GetFormat() const { return m_fmt; }
+    DdsPixelLayout GetPixelLayout() const { return m_layout; }
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetMipCount() const { return m_mipCount; }
+    // 2D slices in the file: faces times cubes for a cube map.
+    uint32_t GetArraySize() const { return m_arraySize; }
+    bool IsCubemap() const { return m_cubemap; }
+    bool HasDx10Header() const { return m_dx10; }
+    const DdsMipSpan& GetMip(uint32_t level) const { return m_mips[level]; }
+    const DdsMipSpan& GetMip(uint32_t slice, uint32_t level) const { return m_mips[slice * m_mipCount + level]; }
+    const uint8_t* GetMappedData() const { return m_pBase; }
+    size_t GetMappedSize() const { return m_size; }
+
+private:
+    bool Validate();
+
+    std::shared_ptr<const MappedFile> m_file;
+    const uint8_t* m_pBase;     // this texture's bytes within m_file
+    size_t m_size;
+    DXGI_FORMAT m_fmt;
+    DdsPixelLayout m_layout;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_mipCount;
+    uint32_t m_arraySize;
+    bool m_cubemap;
+    bool m_dx10;
+    std::vector<DdsMipSpan> m_mips;     // slice-major, m_mipCount per slice
+};
+
+// First mip a load at quality keeps.
+uint32_t GetQualityFirstMip(const DdsView& view, const TextureQuality& quality);
+
+// One texture load job: opens filename and, with prefetch, reads every page
+// in. The view is closed if the file cannot be opened as a DDS.
+DdsView LoadDdsView(const wchar_t* filename, bool prefetch = true);
+DdsView LoadDdsView(const char* filename, bool prefetch = true);
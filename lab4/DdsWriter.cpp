@@ -0,0 +1,211 @@
+#include "DdsWriter.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    FILE* OpenFile(const char* path, const char* mode)
+    {
+        FILE* pFile = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&pFile, path, mode) != 0)
+            return nullptr;
+#else
+        pFile = fopen(path, mode);
+#endif
+        return pFile;
+    }
+
+    // FourCC the legacy header uses for fmt, or 0 if only DX10 can name it.
+    uint32_t GetLegacyFourCC(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_UNORM: return FOURCC_DXT1;
+        case DXGI_FORMAT_BC2_UNORM: return FOURCC_DXT3;
+        case DXGI_FORMAT_BC3_UNORM: return FOURCC_DXT5;
+        case DXGI_FORMAT_BC4_UNORM: return FOURCC_ATI1;
+        case DXGI_FORMAT_BC4_SNORM: return FOURCC_BC4S;
+        case DXGI_FORMAT_BC5_UNORM: return FOURCC_ATI2;
+        case DXGI_FORMAT_BC5_SNORM: return FOURCC_BC5S;
+        default: return 0;
+        }
+    }
+
+    // DXGI format an uncompressed layout is stored as, if it has one.
+    DXGI_FORMAT GetStoredFormat(DdsPixelLayout layout)
+    {
+        switch (layout)
+        {
+        case DDS_PIXELS_RGBA32: return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case DDS_PIXELS_BGRA32: return DXGI_FORMAT_B8G8R8A8_UNORM;
+        case DDS_PIXELS_BGRX32: return DXGI_FORMAT_B8G8R8X8_UNORM;
+        default: return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+
+    void SetUncompressedFormat(DdsPixelLayout layout, DDS_PIXELFORMAT& ddspf)
+    {
+        const bool rgbOrder = layout == DDS_PIXELS_RGBA32 || layout == DDS_PIXELS_RGBX32 || layout == DDS_PIXELS_RGB24;
+        const bool alpha = layout == DDS_PIXELS_RGBA32 || layout == DDS_PIXELS_BGRA32;
+        ddspf.dwFlags = DDS_RGB | (alpha ? DDS_ALPHAPIXELS : 0);
+        ddspf.dwRGBBitCount = DdsBytesPerPixel(layout) * 8;
+        ddspf.dwRBitMask = rgbOrder ? 0x000000FF : 0x00FF0000;
+        ddspf.dwGBitMask = 0x0000FF00;
+        ddspf.dwBBitMask = rgbOrder ? 0x00FF0000 : 0x000000FF;
+        ddspf.dwABitMask = alpha ? 0xFF000000 : 0;
+    }
+
+    bool IsValid(const DdsWriteDesc& desc)
+    {
+        const bool block = desc.layout == DDS_PIXELS_BLOCK;
+        if (block ? DdsBytesPerBlock(desc.format) == 0 : DdsBytesPerPixel(desc.layout) == 0)
+            return false;
+        // Without a DXGI name there is no DX10 header, and so no arrays.
+        if (!block && GetStoredFormat(desc.layout) == DXGI_FORMAT_UNKNOWN && desc.arraySize > 1)
+            return false;
+        return desc.width != 0 && desc.height != 0 && desc.mipCount != 0 && desc.mipCount <= 32 &&
+            desc.arraySize != 0;
+    }
+
+    bool WriteHeaders(FILE* pFile, const DdsWriteDesc& desc)
+    {
+        const bool block = desc.layout == DDS_PIXELS_BLOCK;
+        const DXGI_FORMAT storedFormat = block ? desc.format : GetStoredFormat(desc.layout);
+        const uint32_t legacyFourCC = block ? GetLegacyFourCC(desc.format) : 0;
+        const bool hasLegacyHeader = block ? legacyFourCC != 0 : true;
+        const bool dx10 = storedFormat != DXGI_FORMAT_UNKNOWN &&
+            (desc.dx10Header || !hasLegacyHeader || desc.arraySize > 1);
+
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(desc.layout, desc.format, desc.width, desc.height, rowPitch, rowCount);
+
+        DDS_HEADER header;
+        memset(&header, 0, sizeof(header));
+        header.dwSize = sizeof(DDS_HEADER);
+        header.dwHeaderFlags = DDS_HEADER_FLAGS_TEXTURE | (block ? DDS_HEADER_FLAGS_LINEARSIZE : DDS_HEADER_FLAGS_PITCH);
+        header.dwHeight = desc.height;
+        header.dwWidth = desc.width;
+        header.dwPitchOrLinearSize = block ? rowPitch * rowCount : rowPitch;
+        header.dwMipMapCount = desc.mipCount;
+        header.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
+        if (dx10)
+        {
+            header.ddspf.dwFlags = DDS_FOURCC;
+            header.ddspf.dwFourCC = FOURCC_DX10;
+        }
+        else if (block)
+        {
+            header.ddspf.dwFlags = DDS_FOURCC;
+            header.ddspf.dwFourCC = legacyFourCC;
+        }
+        else
+        {
+            SetUncompressedFormat(desc.layout, header.ddspf);
+        }
+        header.dwSurfaceFlags = DDS_SURFACE_FLAGS_TEXTURE;
+        if (desc.mipCount > 1)
+        {
+            header.dwHeaderFlags |= DDS_HEADER_FLAGS_MIPMAP;
+            header.dwSurfaceFlags |= DDS_SURFACE_FLAGS_MIPMAP;
+        }
+        if (desc.cubemap)
+        {
+            header.dwSurfaceFlags |= DDS_SURFACE_FLAGS_CUBEMAP;
+            header.dwCubemapFlags = DDS_CUBEMAP_ALLFACES;
+        }
+
+        const uint32_t magic = DDS_MAGIC;
+        bool ok = fwrite(&magic, sizeof(magic), 1, pFile) == 1 && fwrite(&header, sizeof(header), 1, pFile) == 1;
+        if (dx10)
+        {
+            DDS_HEADER_DXT10 extension = {
+                (uint32_t)storedFormat, DDS_DIMENSION_TEXTURE2D,
+                desc.cubemap ? (uint32_t)DDS_RESOURCE_MISC_TEXTURECUBE : 0u, desc.arraySize, 0
+            };
+            ok = ok && fwrite(&extension, sizeof(extension), 1, pFile) == 1;
+        }
+        return ok;
+    }
+}
+
+size_t DdsGetDataSize(const DdsWriteDesc& desc)
+{
+    if (!IsValid(desc))
+        return 0;
+
+    size_t sliceSize = 0;
+    uint32_t width = desc.width;
+    uint32_t height = desc.height;
+    for (uint32_t i = 0; i < desc.mipCount; ++i)
+    {
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(desc.layout, desc.format, width, height, rowPitch, rowCount);
+        sliceSize += (size_t)rowPitch * rowCount;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return sliceSize * desc.arraySize * (desc.cubemap ? 6 : 1);
+}
+
+bool WriteDds(const char* filename, const DdsWriteDesc& desc, const void* pData, size_t size)
+{
+    if (!IsValid(desc) || !pData || size != DdsGetDataSize(desc))
+        return false;
+
+    FILE* pFile = OpenFile(filename, "wb");
+    if (!pFile)
+        return false;
+
+    bool ok = WriteHeaders(pFile, desc) && fwrite(pData, size, 1, pFile) == 1;
+    ok = fclose(pFile) == 0 && ok;
+    if (!ok)
+        remove(filename);
+    return ok;
+}
+
+bool WriteDdsSlices(const char* filename, const DdsView* pSlices, uint32_t sliceCount, bool cubemap, bool dx10Header)
+{
+    if (sliceCount == 0 || (cubemap && sliceCount % 6 != 0))
+        return false;
+
+    const DdsView& first = pSlices[0];
+    for (uint32_t i = 0; i < sliceCount; ++i)
+    {
+        const DdsView& slice = pSlices[i];
+        if (!slice.IsOpen() || slice.GetArraySize() != 1 || slice.GetFormat() != first.GetFormat() ||
+            slice.GetPixelLayout() != first.GetPixelLayout() ||
+            slice.GetWidth() != first.GetWidth() || slice.GetHeight() != first.GetHeight() ||
+            slice.GetMipCount() != first.GetMipCount())
+            return false;
+    }
+
+    DdsWriteDesc desc;
+    desc.layout = first.GetPixelLayout();
+    desc.format = first.GetFormat();
+    desc.width = first.GetWidth();
+    desc.height = first.GetHeight();
+    desc.mipCount = first.GetMipCount();
+    desc.arraySize = cubemap ? sliceCount / 6 : sliceCount;
+    desc.cubemap = cubemap;
+    desc.dx10Header = dx10Header;
+
+    FILE* pFile = OpenFile(filename, "wb");
+    if (!pFile)
+        return false;
+
+    // Straight from the mappings, one span at a time.
+    bool ok = WriteHeaders(pFile, desc);
+    for (uint32_t i = 0; ok && i < sliceCount; ++i)
+    {
+        for (uint32_t level = 0; ok && level < desc.mipCount; ++level)
+        {
+            const DdsMipSpan& mip = pSlices[i].GetMip(level);
+            ok = fwrite(mip.pData, mip.size, 1, pFile) == 1;
+        }
+    }
+    ok = fclose(pFile) == 0 && ok;
+    if (!ok)
+        remove(filename);
+    return ok;
+}
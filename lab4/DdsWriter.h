@@ -0,0 +1,30 @@
+#pragma once
+#include "DdsView.h"
+
+// Shape of a DDS file to write.
+struct DdsWriteDesc
+{
+    // Block-compressed files give format; uncompressed ones give a layout
+    // instead, which picks the bit masks.
+    DdsPixelLayout layout = DDS_PIXELS_BLOCK;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 1;
+    uint32_t arraySize = 1;     // cubes for a cube map, slices otherwise
+    bool cubemap = false;
+    // Arrays and formats without a legacy FourCC always get the DX10 header;
+    // 24-bit layouts, which DXGI cannot name, never do.
+    bool dx10Header = false;
+};
+
+// Bytes of pixel data the desc describes: every mip of every slice.
+size_t DdsGetDataSize(const DdsWriteDesc& desc);
+
+// Writes the header(s) and pData, which holds the slices back to back in
+// DdsView order. size must be DdsGetDataSize(desc).
+bool WriteDds(const char* filename, const DdsWriteDesc& desc, const void* pData, size_t size);
+
+// Packs sliceCount single-surface views of the same format, size and mip
+// count into one file; six of them with cubemap set make a cube map.
+bool WriteDdsSlices(const char* filename, const DdsView* pSlices, uint32_t sliceCount, bool cubemap, bool dx10Header);
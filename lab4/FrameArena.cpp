@@ -0,0 +1,115 @@
+#include "FrameArena.h"
+#include <cstdlib>
+
+namespace
+{
+    size_t AlignOffset(const uint8_t* pBase, size_t offset, size_t alignment)
+    {
+        const uintptr_t address = (uintptr_t)pBase + offset;
+        return offset + (size_t)((alignment - address % alignment) % alignment);
+    }
+}
+
+FrameArena::FrameArena(uint32_t frameCount, size_t initialCapacity)
+    : m_frameCount(frameCount == 0 ? 1 : (frameCount > MAX_FRAMES ? MAX_FRAMES : frameCount)),
+    m_current(0), m_initialCapacity(initialCapacity), m_largestFrame(0),
+    m_allocations(0), m_overflows(0), m_heapAllocations(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    for (Frame& frame : m_frames)
+    {
+        ReleaseOverflow(frame);
+        free(frame.pBlock);
+    }
+}
+
+void FrameArena::BeginFrame()
+{
+    Frame& finished = m_frames[m_current];
+    const size_t used = finished.head.load(std::memory_order_relaxed) + finished.overflowBytes;
+    if (used > m_largestFrame)
+        m_largestFrame = used;
+
+    m_current = (m_current + 1) % m_frameCount;
+    Frame& frame = m_frames[m_current];
+    ReleaseOverflow(frame);
+    frame.head.store(0, std::memory_order_relaxed);
+    m_allocations.store(0, std::memory_order_relaxed);
+    m_overflows.store(0, std::memory_order_relaxed);
+
+    // Room for the busiest frame so far, rounded up so a slowly growing
+    // load does not regrow every block every frame.
+    size_t wanted = frame.capacity != 0 ? frame.capacity : m_initialCapacity;
+    while (wanted < m_largestFrame && wanted <= std::numeric_limits<size_t>::max() / 2)
+        wanted *= 2;
+    if (wanted > frame.capacity)
+    {
+        free(frame.pBlock);
+        frame.pBlock = (uint8_t*)malloc(wanted);
+        frame.capacity = frame.pBlock ? wanted : 0;
+        if (frame.pBlock)
+            ++m_heapAllocations;
+    }
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return nullptr;
+
+    Frame& frame = m_frames[m_current];
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    size_t head = frame.head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        const size_t start = AlignOffset(frame.pBlock, head, alignment);
+        if (start > frame.capacity || size > frame.capacity - start)
+            return AllocateOverflow(frame, size, alignment);
+        if (frame.head.compare_exchange_weak(head, start + size, std::memory_order_relaxed))
+            return frame.pBlock + start;
+    }
+}
+
+void* FrameArena::AllocateOverflow(Frame& frame, size_t size, size_t alignment)
+{
+    if (size > std::numeric_limits<size_t>::max() - alignment)
+        return nullptr;
+
+    // Over-allocated so the result can be aligned; the raw pointer is what
+    // gets freed.
+    uint8_t* pRaw = (uint8_t*)malloc(size + alignment);
+    if (!pRaw)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_overflowMutex);
+    frame.overflow.push_back(pRaw);
+    frame.overflowBytes += size + alignment;
+    m_overflows.fetch_add(1, std::memory_order_relaxed);
+    m_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return pRaw + AlignOffset(pRaw, 0, alignment);
+}
+
+void FrameArena::ReleaseOverflow(Frame& frame)
+{
+    for (void* p : frame.overflow)
+        free(p);
+    frame.overflow.clear();
+    frame.overflowBytes = 0;
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+    const Frame& frame = m_frames[m_current];
+    FrameArenaStats stats;
+    stats.allocations = m_allocations.load(std::memory_order_relaxed);
+    stats.overflows = m_overflows.load(std::memory_order_relaxed);
+    stats.bytes = frame.head.load(std::memory_order_relaxed) + frame.overflowBytes;
+    stats.capacity = frame.capacity;
+    stats.largestFrame = m_largestFrame;
+    stats.heapAllocations = m_heapAllocations.load(std::memory_order_relaxed);
+    return stats;
+}
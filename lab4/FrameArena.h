@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+struct FrameArenaStats
+{
+    uint32_t allocations = 0;       // this frame
+    uint32_t overflows = 0;         // this frame; served by the heap
+    uint64_t bytes = 0;             // this frame, alignment and overflows included
+    uint64_t capacity = 0;          // of this frame's block
+    uint64_t largestFrame = 0;      // bytes of the busiest finished frame
+    uint64_t heapAllocations = 0;   // blocks and overflow chunks since construction
+};
+
+// Linear allocator for memory that lives for one frame. Every frame in
+// flight has its own block; Allocate() bumps a pointer through the current
+// one and nothing is freed individually. BeginFrame() moves on to the
+// block the oldest frame used, so what was allocated stays valid for
+// frameCount - 1 more frames: long enough for data the GPU or a worker
+// still reads. A frame that runs out of block is served from the heap,
+// and its block is regrown to the busiest frame's size when it comes round
+// again, so in steady state no frame touches the heap.
+//
+// Allocate() may be called from several threads at once; BeginFrame()
+// must not overlap it. Destructors are not run: objects that own anything
+// outside the arena have to be destroyed before their frame comes round.
+class FrameArena
+{
+public:
+    static const uint32_t MAX_FRAMES = 3;
+
+    explicit FrameArena(uint32_t frameCount = 2, size_t initialCapacity = 64 * 1024);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Recycles the oldest frame's memory for the frame that starts.
+    void BeginFrame();
+
+    // Null only if the heap is out of memory.
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T* AllocateArray(size_t count)
+    {
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+            return nullptr;
+        return (T*)Allocate(sizeof(T) * count, alignof(T));
+    }
+
+    uint32_t GetFrameCount() const { return m_frameCount; }
+    FrameArenaStats GetStats() const;
+
+private:
+    struct Frame
+    {
+        uint8_t* pBlock = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> head{0};
+        std::vector<void*> overflow;
+        size_t overflowBytes = 0;
+    };
+
+    void* AllocateOverflow(Frame& frame, size_t size, size_t alignment);
+    void ReleaseOverflow(Frame& frame);
+
+    Frame m_frames[MAX_FRAMES];
+    uint32_t m_frameCount;
+    uint32_t m_current;
+    size_t m_initialCapacity;
+    size_t m_largestFrame;
+    std::atomic<uint32_t> m_allocations;
+    std::atomic<uint32_t> m_overflows;
+    std::atomic<uint64_t> m_heapAllocations;
+    std::mutex m_overflowMutex;
+};
+
+// STL allocator over a FrameArena. Deallocation does nothing; the memory
+// goes when the frame is recycled, so a container must not outlive its
+// frame. Without an arena it falls back to std::allocator.
+template<typename T>
+class FrameAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    FrameAllocator() noexcept : m_pArena(nullptr) {}
+    explicit FrameAllocator(FrameArena* pArena) noexcept : m_pArena(pArena) {}
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) noexcept : m_pArena(other.GetArena()) {}
+
+    T* allocate(size_t count)
+    {
+        if (!m_pArena)
+            return std::allocator<T>().allocate(count);
+        T* p = m_pArena->AllocateArray<T>(count);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void deallocate(T* p, size_t count) noexcept
+    {
+        if (!m_pArena)
+            std::allocator<T>().deallocate(p, count);
+    }
+
+    FrameArena* GetArena() const noexcept { return m_pArena; }
+
+private:
+    FrameArena* m_pArena;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) noexcept
+{
+    return a.GetArena() == b.GetArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) noexcept
+{
+    return a.GetArena() != b.GetArena();
+}
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
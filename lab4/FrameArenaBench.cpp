@@ -0,0 +1,227 @@
+#include "FrameArenaBench.h"
+#include "BenchUtil.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const uint32_t WARMUP_FRAMES = 4;
+
+    // std::allocator that counts what it is asked for.
+    template<typename T>
+    class CountingAllocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit CountingAllocator(uint64_t* pCount) noexcept : m_pCount(pCount) {}
+
+        template<typename U>
+        CountingAllocator(const CountingAllocator<U>& other) noexcept : m_pCount(other.GetCounter()) {}
+
+        T* allocate(size_t count)
+        {
+            ++*m_pCount;
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T* p, size_t count) noexcept { std::allocator<T>().deallocate(p, count); }
+
+        uint64_t* GetCounter() const noexcept { return m_pCount; }
+
+    private:
+        uint64_t* m_pCount;
+    };
+
+    template<typename T, typename U>
+    bool operator==(const CountingAllocator<T>& a, const CountingAllocator<U>& b) noexcept
+    {
+        return a.GetCounter() == b.GetCounter();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const CountingAllocator<T>& a, const CountingAllocator<U>& b) noexcept
+    {
+        return a.GetCounter() != b.GetCounter();
+    }
+
+    struct Scene
+    {
+        std::vector<float> x, y, z;
+        std::vector<uint32_t> material;
+    };
+
+    struct RenderItem
+    {
+        uint32_t index;
+        float distanceSq;
+    };
+
+    struct DrawPacket
+    {
+        uint32_t object;
+        uint32_t material;
+        float distanceSq;
+    };
+
+    Scene MakeScene(uint32_t count)
+    {
+        Scene scene;
+        uint32_t state = 0x9e3779b9u;
+        auto next = [&state]() {
+            state = state * 1664525u + 1013904223u;
+            return (float)(state >> 8) / (float)(1u << 24);
+        };
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            scene.x.push_back(next() * 200.0f - 100.0f);
+            scene.y.push_back(next() * 20.0f - 10.0f);
+            scene.z.push_back(next() * 200.0f - 100.0f);
+            scene.material.push_back(i % 7);
+        }
+        return scene;
+    }
+
+    // Everything within range of the eye, sorted far to near; equal keys
+    // keep index order. Returns a checksum of the packets.
+    template<typename Alloc>
+    uint64_t BuildFrame(const Scene& scene, const float eye[3], const Alloc& alloc, uint32_t& visible)
+    {
+        typedef typename std::allocator_traits<Alloc>::template rebind_alloc<RenderItem> ItemAlloc;
+        typedef typename std::allocator_traits<Alloc>::template rebind_alloc<uint64_t> KeyAlloc;
+        typedef typename std::allocator_traits<Alloc>::template rebind_alloc<DrawPacket> PacketAlloc;
+        const float rangeSq = 80.0f * 80.0f;
+
+        std::vector<RenderItem, ItemAlloc> items((ItemAlloc(alloc)));
+        for (uint32_t i = 0; i < (uint32_t)scene.x.size(); ++i)
+        {
+            const float dx = scene.x[i] - eye[0], dy = scene.y[i] - eye[1], dz = scene.z[i] - eye[2];
+            const float d = dx * dx + dy * dy + dz * dz;
+            if (d < rangeSq)
+                items.push_back(RenderItem{ i, d });
+        }
+
+        // Non-negative floats order like their bits; inverted so the
+        // farthest sorts first.
+        std::vector<uint64_t, KeyAlloc> keys((KeyAlloc(alloc)));
+        keys.reserve(items.size());
+        for (uint32_t i = 0; i < (uint32_t)items.size(); ++i)
+        {
+            uint32_t bits;
+            memcpy(&bits, &items[i].distanceSq, sizeof(bits));
+            keys.push_back((uint64_t)~bits << 32 | i);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<DrawPacket, PacketAlloc> packets((PacketAlloc(alloc)));
+        for (uint64_t key : keys)
+        {
+            const RenderItem& item = items[(uint32_t)key];
+            packets.push_back(DrawPacket{ item.index, scene.material[item.index], item.distanceSq });
+        }
+
+        uint64_t checksum = 0;
+        for (const DrawPacket& packet : packets)
+            checksum = checksum * 1099511628211ull + packet.object;
+        visible = (uint32_t)packets.size();
+        return checksum;
+    }
+
+    void EyeAt(uint32_t frame, float eye[3])
+    {
+        const float angle = (float)frame * 0.01f;
+        eye[0] = 60.0f * std::cos(angle);
+        eye[1] = 2.0f;
+        eye[2] = 60.0f * std::sin(angle);
+    }
+}
+
+void RunFrameArenaBenchmark(const uint32_t* pObjectCounts, uint32_t countCount, uint32_t frames,
+    std::vector<FrameArenaBenchResult>& results)
+{
+    if (frames == 0)
+        frames = 1;
+
+    for (uint32_t c = 0; c < countCount; ++c)
+    {
+        const Scene scene = MakeScene(pObjectCounts[c]);
+        FrameArenaBenchResult result;
+        result.objects = pObjectCounts[c];
+        result.frames = frames;
+
+        std::vector<uint64_t> checksums(frames);
+        uint64_t heapCount = 0;
+        uint64_t visibleSum = 0;
+        const CountingAllocator<char> counting(&heapCount);
+        for (uint32_t frame = 0; frame < WARMUP_FRAMES + frames; ++frame)
+        {
+            if (frame == WARMUP_FRAMES)
+                heapCount = 0;
+            float eye[3];
+            EyeAt(frame, eye);
+            uint32_t visible;
+            const BenchClock::time_point start = BenchClock::now();
+            const uint64_t checksum = BuildFrame(scene, eye, counting, visible);
+            if (frame >= WARMUP_FRAMES)
+            {
+                result.heapFrameUs += ElapsedUs(start, BenchClock::now());
+                checksums[frame - WARMUP_FRAMES] = checksum;
+                visibleSum += visible;
+            }
+        }
+        result.heapAllocations = (double)heapCount / frames;
+        result.heapFrameUs /= frames;
+        result.visible = (uint32_t)(visibleSum / frames);
+
+        FrameArena arena(2);
+        const FrameAllocator<char> framed(&arena);
+        uint64_t heapBefore = 0;
+        uint64_t arenaAllocations = 0;
+        for (uint32_t frame = 0; frame < WARMUP_FRAMES + frames; ++frame)
+        {
+            if (frame == WARMUP_FRAMES)
+                heapBefore = arena.GetStats().heapAllocations;
+            float eye[3];
+            EyeAt(frame, eye);
+            uint32_t visible;
+            const BenchClock::time_point start = BenchClock::now();
+            arena.BeginFrame();
+            const uint64_t checksum = BuildFrame(scene, eye, framed, visible);
+            if (frame >= WARMUP_FRAMES)
+            {
+                result.arenaFrameUs += ElapsedUs(start, BenchClock::now());
+                result.matchesHeap = result.matchesHeap && checksum == checksums[frame - WARMUP_FRAMES];
+                arenaAllocations += arena.GetStats().allocations;
+            }
+        }
+        const FrameArenaStats stats = arena.GetStats();
+        result.arenaHeapAllocations = (double)(stats.heapAllocations - heapBefore) / frames;
+        result.arenaAllocations = (double)arenaAllocations / frames;
+        result.arenaFrameUs /= frames;
+        result.arenaCapacity = stats.capacity;
+
+        results.push_back(result);
+    }
+}
+
+bool WriteFrameArenaBenchmarkCsv(const char* filename, const std::vector<FrameArenaBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,frames,visible,heap_allocations,arena_heap_allocations,arena_allocations,"
+        "heap_frame_us,arena_frame_us,arena_capacity,matches_heap\n");
+    for (const FrameArenaBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%llu,%d\n",
+            r.objects, r.frames, r.visible, r.heapAllocations, r.arenaHeapAllocations, r.arenaAllocations,
+            r.heapFrameUs, r.arenaFrameUs, (unsigned long long)r.arenaCapacity, r.matchesHeap ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
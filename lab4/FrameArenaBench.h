@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Heap traffic and CPU time of building a frame's render list: visible
+// objects as {index, distance} items, 64-bit sort keys sorted far to near
+// and draw packets in that order. "heap" builds them in fresh std::vectors
+// every frame, as lab5 used to; "arena" builds the same vectors in a
+// double-buffered FrameArena. Allocation counts are per frame after a few
+// warm-up frames, so the arena's columns show its steady state.
+struct FrameArenaBenchResult
+{
+    uint32_t objects = 0;
+    uint32_t frames = 0;
+    uint32_t visible = 0;               // per frame, on average
+    double heapAllocations = 0.0;       // per frame
+    double arenaHeapAllocations = 0.0;  // per frame; blocks and overflows
+    double arenaAllocations = 0.0;      // per frame, served from the block
+    double heapFrameUs = 0.0;
+    double arenaFrameUs = 0.0;
+    uint64_t arenaCapacity = 0;         // per frame block
+    bool matchesHeap = true;            // same packets in the same order
+};
+
+void RunFrameArenaBenchmark(const uint32_t* pObjectCounts, uint32_t countCount, uint32_t frames,
+    std::vector<FrameArenaBenchResult>& results);
+
+bool WriteFrameArenaBenchmarkCsv(const char* filename, const std::vector<FrameArenaBenchResult>& results);
@@ -0,0 +1,214 @@
+#include "FrustumCull.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FRUSTUM_SSE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define FRUSTUM_AVX2 1
+#define FRUSTUM_TARGET_AVX2
+#elif defined(__GNUC__)
+#define FRUSTUM_AVX2 1
+#define FRUSTUM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+FrustumPlanes ExtractFrustumPlanes(const Float4x4& viewProj)
+{
+    // clip = (p, 1) * viewProj, so column j of the matrix is clip component
+    // j as a plane over p. Inside is w + x, w - x, w + y, w - y, z and
+    // w - z >= 0.
+    const Float4x4& m = viewProj;
+    const float wScale[6] = { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+    const float sign[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+    const int column[6] = { 0, 0, 1, 1, 2, 2 };
+
+    FrustumPlanes planes;
+    for (int p = 0; p < 6; ++p)
+    {
+        const int j = column[p];
+        const float a = wScale[p] * m.m[0][3] + sign[p] * m.m[0][j];
+        const float b = wScale[p] * m.m[1][3] + sign[p] * m.m[1][j];
+        const float c = wScale[p] * m.m[2][3] + sign[p] * m.m[2][j];
+        const float d = wScale[p] * m.m[3][3] + sign[p] * m.m[3][j];
+
+        const float length = std::sqrt(a * a + b * b + c * c);
+        const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        planes.a[p] = a * scale;
+        planes.b[p] = b * scale;
+        planes.c[p] = c * scale;
+        planes.d[p] = d * scale;
+    }
+    return planes;
+}
+
+void BoundingSpheres::Resize(size_t count)
+{
+    x.resize(count, 0.0f);
+    y.resize(count, 0.0f);
+    z.resize(count, 0.0f);
+    radius.resize(count, 0.0f);
+}
+
+void ComputeBoundingSpheres(const SceneTransforms& scene, float localRadius, BoundingSpheres& out)
+{
+    const size_t count = scene.Size();
+    out.Resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        out.x[i] = scene.posX[i];
+        out.y[i] = scene.posY[i];
+        out.z[i] = scene.posZ[i];
+        const float scale = std::max(std::fabs(scene.scaleX[i]), std::max(std::fabs(scene.scaleY[i]),
+            std::fabs(scene.scaleZ[i])));
+        out.radius[i] = localRadius * scale;
+    }
+}
+
+// Spheres [first, end). The products and sums are done in the same order
+// as the SIMD kernels so every kernel keeps the same spheres.
+static size_t CullScalar(const FrustumPlanes& planes, const BoundingSpheres& s, size_t first, size_t end,
+    uint32_t* pVisible)
+{
+    size_t visible = 0;
+    for (size_t i = first; i < end; ++i)
+    {
+        const float negRadius = -s.radius[i];
+        bool inside = true;
+        for (int p = 0; p < 6; ++p)
+        {
+            const float distance = ((planes.a[p] * s.x[i] + planes.b[p] * s.y[i]) + planes.c[p] * s.z[i]) + planes.d[p];
+            inside &= distance >= negRadius;
+        }
+
+        // Written either way; only kept ones advance the list.
+        pVisible[visible] = (uint32_t)i;
+        visible += inside ? 1 : 0;
+    }
+    return visible;
+}
+
+#ifdef FRUSTUM_SSE
+static size_t CullSse(const FrustumPlanes& planes, const BoundingSpheres& s, size_t first, size_t end,
+    uint32_t* pVisible, size_t& done)
+{
+    __m128 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        a[p] = _mm_set1_ps(planes.a[p]);
+        b[p] = _mm_set1_ps(planes.b[p]);
+        c[p] = _mm_set1_ps(planes.c[p]);
+        d[p] = _mm_set1_ps(planes.d[p]);
+    }
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    size_t visible = 0;
+    size_t i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(&s.x[i]);
+        const __m128 y = _mm_loadu_ps(&s.y[i]);
+        const __m128 z = _mm_loadu_ps(&s.z[i]);
+        const __m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&s.radius[i]), signMask);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)),
+                _mm_mul_ps(c[p], z)), d[p]);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+
+        // Branch-free compaction: every lane writes its index, only
+        // visible lanes move the end of the list.
+        const int mask = _mm_movemask_ps(inside);
+        if (mask == 0)
+            continue;
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            pVisible[visible] = (uint32_t)(i + lane);
+            visible += (mask >> lane) & 1;
+        }
+    }
+    done = i;
+    return visible;
+}
+#endif
+
+#ifdef FRUSTUM_AVX2
+FRUSTUM_TARGET_AVX2
+static size_t CullAvx2(const FrustumPlanes& planes, const BoundingSpheres& s, size_t first, size_t end,
+    uint32_t* pVisible, size_t& done)
+{
+    __m256 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        a[p] = _mm256_set1_ps(planes.a[p]);
+        b[p] = _mm256_set1_ps(planes.b[p]);
+        c[p] = _mm256_set1_ps(planes.c[p]);
+        d[p] = _mm256_set1_ps(planes.d[p]);
+    }
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    size_t visible = 0;
+    size_t i = first;
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(&s.x[i]);
+        const __m256 y = _mm256_loadu_ps(&s.y[i]);
+        const __m256 z = _mm256_loadu_ps(&s.z[i]);
+        const __m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&s.radius[i]), signMask);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], x),
+                _mm256_mul_ps(b[p], y)), _mm256_mul_ps(c[p], z)), d[p]);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+        }
+
+        const int mask = _mm256_movemask_ps(inside);
+        if (mask == 0)
+            continue;
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            pVisible[visible] = (uint32_t)(i + lane);
+            visible += (mask >> lane) & 1;
+        }
+    }
+    done = i;
+    return visible;
+}
+#endif
+
+size_t CullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint32_t* pVisible,
+    TransformKernel kernel)
+{
+    return CullSphereRange(planes, spheres, 0, spheres.Size(), pVisible, kernel);
+}
+
+size_t CullSphereRange(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t count,
+    uint32_t* pVisible, TransformKernel kernel)
+{
+    const size_t end = first + count;
+    size_t done = first;
+    size_t visible = 0;
+    switch (ResolveTransformKernel(kernel))
+    {
+#ifdef FRUSTUM_AVX2
+    case TRANSFORM_KERNEL_AVX2:
+        visible = CullAvx2(planes, spheres, first, end, pVisible, done);
+        break;
+#endif
+#ifdef FRUSTUM_SSE
+    case TRANSFORM_KERNEL_SSE:
+        visible = CullSse(planes, spheres, first, end, pVisible, done);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return visible + CullScalar(planes, spheres, done, end, pVisible + visible);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "SceneMath.h"
+#include "SceneTransforms.h"
+
+// The six planes of a view-projection frustum in structure-of-arrays form,
+// left, right, bottom, top, near, far. A point is inside a plane where
+// a * x + b * y + c * z + d >= 0; the planes are normalised, so that value
+// is a distance in world units.
+struct FrustumPlanes
+{
+    float a[6];
+    float b[6];
+    float c[6];
+    float d[6];
+};
+
+// Planes of viewProj in world space, for D3D clip space (0 <= z <= w) and
+// SceneMath's row-vector matrices.
+FrustumPlanes ExtractFrustumPlanes(const Float4x4& viewProj);
+
+inline bool IsSphereInFrustum(const FrustumPlanes& planes, float x, float y, float z, float radius)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        if (!(planes.a[p] * x + planes.b[p] * y + planes.c[p] * z + planes.d[p] >= -radius))
+            return false;
+    }
+    return true;
+}
+
+// One bounding sphere per object, structure-of-arrays like SceneTransforms.
+struct BoundingSpheres
+{
+    std::vector<float> x, y, z, radius;
+
+    size_t Size() const { return x.size(); }
+    void Resize(size_t count);
+};
+
+// Spheres around every object of scene, for a mesh that fits in a sphere
+// of localRadius about its origin: centred on the position and scaled by
+// the object's largest axis scale, so they hold under any rotation.
+void ComputeBoundingSpheres(const SceneTransforms& scene, float localRadius, BoundingSpheres& out);
+
+// Writes the indices of the spheres that touch the frustum to pVisible, in
+// ascending order, and returns how many there are. pVisible needs room
+// for every sphere. Each sphere is tested against the six planes on their
+// own, so one that misses the frustum only near a corner is still kept;
+// nothing visible is ever dropped. The SIMD kernels test 4 or 8 spheres
+// at a time and all kernels return the same list.
+size_t CullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint32_t* pVisible,
+    TransformKernel kernel = TRANSFORM_KERNEL_BEST);
+
+// Same for spheres [first, first + count); pVisible needs room for count.
+// Ranges can be culled on different threads and their lists joined.
+size_t CullSphereRange(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t count,
+    uint32_t* pVisible, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
@@ -0,0 +1,157 @@
+#include "FrustumCullBench.h"
+#include "BenchUtil.h"
+#include "CameraPath.h"
+#include "FrustumCull.h"
+#include "InstanceBatch.h"
+#include "LabScene.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Unit cubes of scale 0.25 to 1 anywhere within 100 units of the origin,
+    // in four material runs.
+    void BuildScene(SceneTransforms& scene, uint32_t count)
+    {
+        scene.Resize(count);
+        uint32_t state = 2024;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float x = Random(state) * 200.0f - 100.0f;
+            const float y = Random(state) * 200.0f - 100.0f;
+            const float z = Random(state) * 200.0f - 100.0f;
+            scene.SetPosition(i, x, y, z);
+            scene.SetScale(i, 0.25f + 0.75f * Random(state));
+            scene.SetRotationYaw(i, Random(state) * 6.2831853f);
+            scene.material[i] = (uint32_t)((uint64_t)i * 4 / count);
+        }
+    }
+
+    // One view-projection per frame along the orbit.
+    void BuildViews(uint32_t frames, std::vector<Float4x4>& views)
+    {
+        const CameraPath path = CameraPath::MakeOrbit(10.0f);
+        const Float4x4 proj = MatrixPerspectiveFovLH(LabScene::FOV_Y, 16.0f / 9.0f, LabScene::NEAR_Z,
+            LabScene::FAR_Z);
+        Camera camera;
+        views.resize(frames);
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            float yaw, pitch, distance;
+            path.Evaluate(path.GetDuration() * (float)f / (float)frames, yaw, pitch, distance);
+            camera.SetOrbit(yaw, pitch, distance);
+            views[f] = MatrixMultiply(camera.GetViewMatrix(), proj);
+        }
+    }
+
+    double TimeKernel(const std::vector<FrustumPlanes>& planes, const BoundingSpheres& spheres,
+        TransformKernel kernel, const std::vector<std::vector<uint32_t>>& expected, uint32_t* pVisible,
+        bool& matches)
+    {
+        if (!IsTransformKernelSupported(kernel))
+            return 0.0;
+
+        for (size_t f = 0; f < planes.size(); ++f)
+        {
+            const size_t count = CullSpheres(planes[f], spheres, pVisible, kernel);
+            if (count != expected[f].size() || !std::equal(pVisible, pVisible + count, expected[f].begin()))
+                matches = false;
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        for (size_t f = 0; f < planes.size(); ++f)
+            CullSpheres(planes[f], spheres, pVisible, kernel);
+        return ElapsedNs(start, BenchClock::now()) / ((double)planes.size() * spheres.Size());
+    }
+}
+
+void RunFrustumCullBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t frames,
+    std::vector<FrustumCullBenchResult>& results)
+{
+    if (frames == 0)
+        frames = 1;
+
+    std::vector<Float4x4> views;
+    BuildViews(frames, views);
+    std::vector<FrustumPlanes> planes(frames);
+    for (uint32_t f = 0; f < frames; ++f)
+        planes[f] = ExtractFrustumPlanes(views[f]);
+
+    SceneTransforms scene;
+    BoundingSpheres spheres;
+    std::vector<uint32_t> visible;
+    std::vector<std::vector<uint32_t>> expected(frames);
+    InstanceBatcher instances;
+
+    for (uint32_t s = 0; s < sizeCount; ++s)
+    {
+        const uint32_t count = pSizes[s];
+        if (count == 0)
+            continue;
+
+        BuildScene(scene, count);
+        ComputeBoundingSpheres(scene, 0.8660254f, spheres);
+        visible.resize(count);
+
+        FrustumCullBenchResult result;
+        result.objectCount = count;
+        result.frames = frames;
+
+        size_t visibleTotal = 0;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            expected[f].resize(count);
+            expected[f].resize(CullSpheres(planes[f], spheres, expected[f].data(), TRANSFORM_KERNEL_SCALAR));
+            visibleTotal += expected[f].size();
+        }
+        result.visibleFraction = (double)visibleTotal / ((double)frames * count);
+
+        result.scalarNs = TimeKernel(planes, spheres, TRANSFORM_KERNEL_SCALAR, expected, visible.data(),
+            result.matchesScalar);
+        result.sseNs = TimeKernel(planes, spheres, TRANSFORM_KERNEL_SSE, expected, visible.data(),
+            result.matchesScalar);
+        result.avx2Ns = TimeKernel(planes, spheres, TRANSFORM_KERNEL_AVX2, expected, visible.data(),
+            result.matchesScalar);
+
+        instances.Build(scene);
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t f = 0; f < frames; ++f)
+            instances.Build(scene);
+        result.allUs = ElapsedNs(start, BenchClock::now()) / (1000.0 * frames);
+
+        start = BenchClock::now();
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            visible.resize(count);
+            visible.resize(CullSpheres(planes[f], spheres, visible.data()));
+            instances.Build(scene, visible.data(), visible.size());
+        }
+        result.culledUs = ElapsedNs(start, BenchClock::now()) / (1000.0 * frames);
+
+        results.push_back(result);
+    }
+}
+
+bool WriteFrustumCullBenchmarkCsv(const char* filename, const std::vector<FrustumCullBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,frames,scalar_ns,sse_ns,avx2_ns,visible_fraction,all_us,culled_us,matches_scalar\n");
+    for (const FrustumCullBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%d\n",
+            r.objectCount, r.frames, r.scalarNs, r.sseNs, r.avx2Ns, r.visibleFraction,
+            r.allUs, r.culledUs, r.matchesScalar ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
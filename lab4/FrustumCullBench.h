@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Frustum culling of N bounding spheres spread through a 200-unit cube
+// around the lab4 camera, which follows the scripted orbit. The kernel
+// columns are nanoseconds per sphere and report 0 where the CPU lacks the
+// kernel. "all" builds instance data for every object each frame, as lab4
+// did before culling; "culled" culls with the best kernel and builds only
+// the visible ones; both are microseconds per frame.
+struct FrustumCullBenchResult
+{
+    uint32_t objectCount = 0;
+    uint32_t frames = 0;
+    double scalarNs = 0.0;
+    double sseNs = 0.0;
+    double avx2Ns = 0.0;
+    double visibleFraction = 0.0;   // averaged over the frames
+    double allUs = 0.0;
+    double culledUs = 0.0;
+    bool matchesScalar = true;      // every kernel kept the same spheres every frame
+};
+
+void RunFrustumCullBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t frames,
+    std::vector<FrustumCullBenchResult>& results);
+
+bool WriteFrustumCullBenchmarkCsv(const char* filename, const std::vector<FrustumCullBenchResult>& results);
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// 64-bit FNV-1a. Used for cache keys, not for anything security related.
+const uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+inline uint64_t HashBytes(const void* pData, size_t size, uint64_t hash = HASH_SEED)
+{
+    const uint8_t* p = (const uint8_t*)pData;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+namespace HashDetail
+{
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+    const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+    inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t Read64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t Round(uint64_t acc, uint64_t input)
+    {
+        return Rotl(acc + input * PRIME2, 31) * PRIME1;
+    }
+
+    inline uint64_t Merge(uint64_t acc, uint64_t lane)
+    {
+        return (acc ^ Round(0, lane)) * PRIME1 + PRIME4;
+    }
+}
+
+// 64-bit XXH64 for whole texture payloads, where HashBytes would take longer
+// than the load it saves: four independent lanes over 32-byte stripes run
+// at memory speed. Also not for anything security related.
+inline uint64_t HashContent(const void* pData, size_t size, uint64_t seed = 0)
+{
+    using namespace HashDetail;
+    const uint8_t* p = (const uint8_t*)pData;
+    const uint8_t* pEnd = p + size;
+
+    uint64_t hash;
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2, v3 = seed, v4 = seed - PRIME1;
+        for (; pEnd - p >= 32; p += 32)
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+        }
+        hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        hash = Merge(hash, v1);
+        hash = Merge(hash, v2);
+        hash = Merge(hash, v3);
+        hash = Merge(hash, v4);
+    }
+    else
+    {
+        hash = seed + PRIME5;
+    }
+
+    hash += (uint64_t)size;
+    for (; pEnd - p >= 8; p += 8)
+        hash = Rotl(hash ^ Round(0, Read64(p)), 27) * PRIME1 + PRIME4;
+    if (pEnd - p >= 4)
+    {
+        hash = Rotl(hash ^ (Read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < pEnd; ++p)
+        hash = Rotl(hash ^ (*p * PRIME5), 11) * PRIME1;
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,88 @@
+#include "HeadlessRunner.h"
+#include "ImageFile.h"
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double ElapsedMs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+}
+
+bool RunHeadless(LabScene& scene, ISceneBackend& backend, const CameraPath& path,
+    const HeadlessOptions& options, std::vector<FrameTiming>& timings)
+{
+    std::vector<uint8_t> pixels;
+    const CameraInput noInput;
+
+    timings.clear();
+    timings.reserve(options.frameCount);
+
+    for (uint32_t frame = 0; frame < options.frameCount; ++frame)
+    {
+        FrameTiming timing;
+        timing.frame = frame;
+        timing.sceneTime = (double)frame * options.frameTime;
+
+        Clock::time_point start = Clock::now();
+        if (!path.IsEmpty())
+        {
+            float yaw = 0.0f, pitch = 0.0f, distance = 0.0f;
+            path.Evaluate((float)timing.sceneTime, yaw, pitch, distance);
+            scene.GetCamera().SetOrbit(yaw, pitch, distance);
+        }
+        scene.Update(timing.sceneTime, options.frameTime, noInput);
+
+        Clock::time_point updated = Clock::now();
+        backend.RenderFrame(scene);
+
+        Clock::time_point rendered = Clock::now();
+        backend.Finish();
+
+        Clock::time_point finished = Clock::now();
+        timing.updateMs = ElapsedMs(start, updated);
+        timing.renderMs = ElapsedMs(updated, rendered);
+        timing.finishMs = ElapsedMs(rendered, finished);
+
+        if (options.dumpInterval > 0 && frame % options.dumpInterval == 0)
+        {
+            char filename[512];
+            snprintf(filename, sizeof(filename), "%s_frame%04u.bmp", options.outputPrefix.c_str(), frame);
+            if (!backend.ReadPixels(pixels) ||
+                !WriteBmp(filename, pixels.data(), backend.GetWidth(), backend.GetHeight()))
+                return false;
+            timing.dumpMs = ElapsedMs(finished, Clock::now());
+        }
+
+        timings.push_back(timing);
+    }
+
+    return true;
+}
+
+bool WriteFrameTimingsCsv(const char* filename, const char* backendName, const std::vector<FrameTiming>& timings)
+{
+    FILE* pFile = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&pFile, filename, "w") != 0)
+        return false;
+#else
+    pFile = fopen(filename, "w");
+    if (!pFile)
+        return false;
+#endif
+
+    fprintf(pFile, "backend,frame,scene_time,update_ms,render_ms,finish_ms,dump_ms\n");
+    for (const FrameTiming& t : timings)
+    {
+        fprintf(pFile, "%s,%u,%.4f,%.3f,%.3f,%.3f,%.3f\n",
+            backendName, t.frame, t.sceneTime, t.updateMs, t.renderMs, t.finishMs, t.dumpMs);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "CameraPath.h"
+#include "LabScene.h"
+#include "SceneBackend.h"
+#include <string>
+
+struct HeadlessOptions
+{
+    uint32_t frameCount = 300;
+    float frameTime = 1.0f / 60.0f;     // simulated seconds per frame
+    uint32_t dumpInterval = 0;          // write every Nth frame as a BMP; 0 disables
+    std::string outputPrefix = "headless";
+};
+
+struct FrameTiming
+{
+    uint32_t frame = 0;
+    double sceneTime = 0.0;
+    double updateMs = 0.0;      // LabScene::Update
+    double renderMs = 0.0;      // ISceneBackend::RenderFrame
+    double finishMs = 0.0;      // waiting for the frame to complete
+    double dumpMs = 0.0;        // readback and BMP write, dumped frames only
+};
+
+// Renders frameCount frames without a window. Time advances by a fixed
+// step and the camera follows path, so two runs draw the same frames.
+// Dumped frames go to <outputPrefix>_frameNNNN.bmp.
+bool RunHeadless(LabScene& scene, ISceneBackend& backend, const CameraPath& path,
+    const HeadlessOptions& options, std::vector<FrameTiming>& timings);
+
+bool WriteFrameTimingsCsv(const char* filename, const char* backendName, const std::vector<FrameTiming>& timings);
@@ -0,0 +1,62 @@
+#include "ImageFile.h"
+#include <cstdio>
+#include <vector>
+
+static void Put16(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void Put32(uint8_t* p, uint32_t v)
+{
+    Put16(p, v);
+    Put16(p + 2, v >> 16);
+}
+
+bool WriteBmp(const char* filename, const uint8_t* pRgba, uint32_t width, uint32_t height)
+{
+    const uint32_t headerSize = 14 + 40;
+    const uint32_t imageSize = width * height * 4;
+
+    uint8_t header[headerSize] = {};
+    header[0] = 'B';
+    header[1] = 'M';
+    Put32(header + 2, headerSize + imageSize);
+    Put32(header + 10, headerSize);
+    Put32(header + 14, 40);
+    Put32(header + 18, width);
+    Put32(header + 22, (uint32_t)-(int32_t)height);     // negative height: top-down rows
+    Put16(header + 26, 1);
+    Put16(header + 28, 32);
+    Put32(header + 34, imageSize);
+
+    FILE* pFile = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&pFile, filename, "wb") != 0)
+        return false;
+#else
+    pFile = fopen(filename, "wb");
+    if (!pFile)
+        return false;
+#endif
+
+    // BMP stores BGRA.
+    std::vector<uint8_t> row(width * 4);
+    bool ok = fwrite(header, 1, headerSize, pFile) == headerSize;
+    for (uint32_t y = 0; y < height && ok; ++y)
+    {
+        const uint8_t* pSrc = pRgba + (size_t)y * width * 4;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            row[x * 4 + 0] = pSrc[x * 4 + 2];
+            row[x * 4 + 1] = pSrc[x * 4 + 1];
+            row[x * 4 + 2] = pSrc[x * 4 + 0];
+            row[x * 4 + 3] = pSrc[x * 4 + 3];
+        }
+        ok = fwrite(row.data(), 1, row.size(), pFile) == row.size();
+    }
+
+    fclose(pFile);
+    return ok;
+}
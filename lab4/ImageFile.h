@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+// Writes tightly packed RGBA8 pixels as an uncompressed 32-bit BMP.
+bool WriteBmp(const char* filename, const uint8_t* pRgba, uint32_t width, uint32_t height);
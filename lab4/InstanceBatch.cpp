@@ -0,0 +1,41 @@
+#include "InstanceBatch.h"
+#include "JobSystem.h"
+
+// Instance jobs build at least this many records each.
+static const uint32_t INSTANCE_GRAIN = 4096;
+
+void InstanceBatcher::Build(const SceneTransforms& scene, TransformKernel kernel)
+{
+    size_t count = scene.Size();
+    m_batches.clear();
+    m_data.resize(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_batches.empty() || m_batches.back().material != scene.material[i])
+            m_batches.push_back({ scene.material[i], (uint32_t)i, 0 });
+        ++m_batches.back().instanceCount;
+    }
+
+    ComputeInstanceData(scene, 0, count, m_data.data(), kernel);
+}
+
+void InstanceBatcher::Build(const SceneTransforms& scene, const uint32_t* pIndices, size_t count,
+    TransformKernel kernel, JobSystem* pJobs)
+{
+    m_batches.clear();
+    m_data.resize(count);
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        const uint32_t material = scene.material[pIndices[n]];
+        if (m_batches.empty() || m_batches.back().material != material)
+            m_batches.push_back({ material, (uint32_t)n, 0 });
+        ++m_batches.back().instanceCount;
+    }
+
+    InstanceData* pData = m_data.data();
+    ParallelFor(pJobs, (uint32_t)count, INSTANCE_GRAIN, [=, &scene](uint32_t first, uint32_t n) {
+        ComputeInstanceDataOrdered(scene, pIndices + first, n, pData + first, kernel);
+    });
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "SceneTransforms.h"
+
+class JobSystem;
+
+struct InstanceBatch
+{
+    uint32_t material;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// Packs a whole SceneTransforms set into one contiguous instance array and
+// splits it into per-material batches, ready for one DrawIndexedInstanced
+// per batch with StartInstanceLocation = firstInstance.
+class InstanceBatcher
+{
+public:
+    void Build(const SceneTransforms& scene, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
+
+    // Only the objects pIndices names, in that order; a culled scene's
+    // visible list keeps material runs together. With pJobs the instance
+    // data is computed in parallel.
+    void Build(const SceneTransforms& scene, const uint32_t* pIndices, size_t count,
+        TransformKernel kernel = TRANSFORM_KERNEL_BEST, JobSystem* pJobs = nullptr);
+
+    const std::vector<InstanceBatch>& GetBatches() const { return m_batches; }
+    const InstanceData* GetData() const { return m_data.data(); }
+    uint32_t GetInstanceCount() const { return (uint32_t)m_data.size(); }
+    uint32_t GetDataSize() const { return (uint32_t)(m_data.size() * sizeof(InstanceData)); }
+
+private:
+    std::vector<InstanceBatch> m_batches;
+    std::vector<InstanceData> m_data;
+};
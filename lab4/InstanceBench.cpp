@@ -0,0 +1,165 @@
+#include "InstanceBench.h"
+#include "BenchUtil.h"
+#include "InstanceBatch.h"
+#include "RecordingRenderContext.h"
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    ID3D11Buffer* const FAKE_MODEL_CB = FakeHandle<ID3D11Buffer>(0);
+    ID3D11Buffer* const FAKE_INSTANCE_VB = FakeHandle<ID3D11Buffer>(1);
+    ID3D11Buffer* const FAKE_CUBE_VB = FakeHandle<ID3D11Buffer>(2);
+
+    const uint32_t CUBE_INDEX_COUNT = 36;
+
+    // Grid of cubes, materials assigned in contiguous blocks.
+    void BuildScene(SceneTransforms& scene, uint32_t count, uint32_t materialCount)
+    {
+        scene.Resize(count);
+        uint32_t side = (uint32_t)std::ceil(std::cbrt((double)count));
+        uint32_t perMaterial = (count + materialCount - 1) / materialCount;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float x = (float)(i % side) * 1.5f;
+            float y = (float)((i / side) % side) * 1.5f;
+            float z = (float)(i / (side * side)) * 1.5f;
+            scene.SetPosition(i, x, y, z);
+            scene.SetRotationYaw(i, (float)i * 0.1f);
+            scene.SetScale(i, 0.5f);
+            scene.SetTint(i, 1.0f, 1.0f, 1.0f, 1.0f);
+            scene.material[i] = i / perMaterial;
+        }
+    }
+
+    void RecordPerObject(CommandRecorder& commands, const SceneTransforms& scene)
+    {
+        commands.SetVertexBuffer(0, FAKE_CUBE_VB, 20, 0);
+        for (size_t i = 0; i < scene.Size(); ++i)
+        {
+            // Same matrix the shader would get from ModelConstantBuffer,
+            // built one object at a time.
+            InstanceData record;
+            ComputeInstanceData(scene, i, 1, &record, TRANSFORM_KERNEL_SCALAR);
+            float model[16] = {
+                record.world[0][0], record.world[0][1], record.world[0][2], record.world[0][3],
+                record.world[1][0], record.world[1][1], record.world[1][2], record.world[1][3],
+                record.world[2][0], record.world[2][1], record.world[2][2], record.world[2][3],
+                0.0f, 0.0f, 0.0f, 1.0f
+            };
+            commands.UpdateBuffer(FAKE_MODEL_CB, model, sizeof(model), false);
+            commands.SetVSConstantBuffer(0, FAKE_MODEL_CB);
+            commands.DrawIndexed(CUBE_INDEX_COUNT, 0, 0);
+        }
+    }
+
+    void RecordInstanced(CommandRecorder& commands, InstanceBatcher& batcher, const SceneTransforms& scene)
+    {
+        batcher.Build(scene);
+        commands.UpdateBufferRef(FAKE_INSTANCE_VB, batcher.GetData(), batcher.GetDataSize(), true);
+        commands.SetVertexBuffer(0, FAKE_CUBE_VB, 20, 0);
+        commands.SetVertexBuffer(1, FAKE_INSTANCE_VB, sizeof(InstanceData), 0);
+        for (const InstanceBatch& batch : batcher.GetBatches())
+            commands.DrawIndexedInstanced(CUBE_INDEX_COUNT, batch.instanceCount, 0, 0, batch.firstInstance);
+    }
+}
+
+void RunInstanceBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t materialCount,
+    uint32_t iterations, std::vector<InstanceBenchResult>& results)
+{
+    // Only counts what reaches it, so the recorder and packing cost is what
+    // is measured.
+    RecordingRenderContext context;
+    CommandRecorder commands;
+    InstanceBatcher batcher;
+    SceneTransforms scene;
+    std::vector<InstanceData> packed;
+
+    if (materialCount == 0)
+        materialCount = 1;
+    if (iterations == 0)
+        iterations = 1;
+
+    for (uint32_t s = 0; s < sizeCount; ++s)
+    {
+        uint32_t count = pSizes[s];
+        if (count == 0)
+            continue;
+
+        BuildScene(scene, count, materialCount);
+        packed.resize(count);
+
+        InstanceBenchResult result;
+        result.instanceCount = count;
+        result.materialCount = materialCount;
+        double perInstance = 1.0 / ((double)iterations * count);
+
+        // Per-object path
+        commands.Invalidate();
+        commands.BeginFrame();
+        RecordPerObject(commands, scene);
+        commands.Submit(context);
+        result.perObjectCommands = commands.GetLastFrameStats().submitted;
+
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            commands.Invalidate();
+            commands.BeginFrame();
+            RecordPerObject(commands, scene);
+            commands.Submit(context);
+        }
+        result.perObjectNs = ElapsedNs(start, BenchClock::now()) * perInstance;
+
+        // Packing only
+        ComputeInstanceData(scene, 0, count, packed.data(), TRANSFORM_KERNEL_SCALAR);
+        start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+            ComputeInstanceData(scene, 0, count, packed.data(), TRANSFORM_KERNEL_SCALAR);
+        result.packScalarNs = ElapsedNs(start, BenchClock::now()) * perInstance;
+
+        ComputeInstanceData(scene, 0, count, packed.data());
+        start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+            ComputeInstanceData(scene, 0, count, packed.data());
+        result.packSimdNs = ElapsedNs(start, BenchClock::now()) * perInstance;
+
+        // Instanced path
+        commands.Invalidate();
+        commands.BeginFrame();
+        RecordInstanced(commands, batcher, scene);
+        commands.Submit(context);
+        result.instancedCommands = commands.GetLastFrameStats().submitted;
+
+        start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            commands.Invalidate();
+            commands.BeginFrame();
+            RecordInstanced(commands, batcher, scene);
+            commands.Submit(context);
+        }
+        result.instancedNs = ElapsedNs(start, BenchClock::now()) * perInstance;
+
+        results.push_back(result);
+    }
+}
+
+bool WriteInstanceBenchmarkCsv(const char* filename, const std::vector<InstanceBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "instances,materials,per_object_ns,pack_scalar_ns,pack_simd_ns,instanced_ns,per_object_commands,instanced_commands\n");
+    for (const InstanceBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%.3f,%.3f,%.3f,%.3f,%u,%u\n",
+            r.instanceCount, r.materialCount, r.perObjectNs, r.packScalarNs,
+            r.packSimdNs, r.instancedNs, r.perObjectCommands, r.instancedCommands);
+    }
+
+    fclose(pFile);
+    return true;
+}
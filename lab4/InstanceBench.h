@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// CPU-side cost of submitting a cube field, in nanoseconds per instance.
+// Commands are replayed into a context that drops them, so no device is
+// needed and the numbers only cover recording, packing and replay.
+struct InstanceBenchResult
+{
+    uint32_t instanceCount = 0;
+    uint32_t materialCount = 0;
+    double perObjectNs = 0.0;       // UpdateBuffer + DrawIndexed per cube
+    double packScalarNs = 0.0;      // ComputeInstanceData, scalar kernel
+    double packSimdNs = 0.0;        // ComputeInstanceData, best kernel
+    double instancedNs = 0.0;       // batch build + one DrawIndexedInstanced per material
+    uint32_t perObjectCommands = 0;
+    uint32_t instancedCommands = 0;
+};
+
+// Runs the sweep for each scene size, timing every path over iterations
+// frames after one warm-up frame.
+void RunInstanceBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t materialCount,
+    uint32_t iterations, std::vector<InstanceBenchResult>& results);
+
+bool WriteInstanceBenchmarkCsv(const char* filename, const std::vector<InstanceBenchResult>& results);
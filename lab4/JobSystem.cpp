@@ -0,0 +1,366 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+    // Rounds an idle worker looks for work before it goes to sleep.
+    const uint32_t SPIN_ROUNDS = 64;
+    const size_t CACHE_LINE = 64;
+
+    // Counters are only written by their own thread, so a plain load and
+    // store is enough; other threads just read them.
+    void Bump(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void FinishJob(Job* pJob)
+    {
+        while (pJob)
+        {
+            Job* pParent = pJob->pParent;
+            if (pJob->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            pJob = pParent;
+        }
+    }
+}
+
+// One thread's jobs. The deque is Chase and Lev's: the owner pushes and
+// pops at bottom without locking, thieves take from top and race each
+// other, and the owner for the last job, with a compare-exchange. top and
+// bottom sit on cache lines of their own, as thieves hammer one and the
+// owner the other.
+struct JobSystem::ThreadState
+{
+    std::atomic<int64_t> top;
+    char padding0[CACHE_LINE];
+    std::atomic<int64_t> bottom;
+    char padding1[CACHE_LINE];
+    std::atomic<Job*> slots[MAX_JOBS];
+
+    JobSystem* pSystem;
+    std::unique_ptr<Job[]> pJobs;
+    uint32_t nextJob;
+    uint32_t random;                    // picks the first victim to steal from
+
+    std::atomic<uint64_t> jobs;
+    std::atomic<uint64_t> steals;
+    std::atomic<uint64_t> stealAttempts;
+    std::atomic<uint64_t> contendedSteals;
+    std::atomic<uint64_t> contendedPops;
+    std::atomic<uint64_t> overflows;
+    std::atomic<uint64_t> sleeps;
+    char padding2[CACHE_LINE];
+
+    bool Push(Job* pJob)
+    {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        const int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= (int64_t)MAX_JOBS)
+            return false;
+        slots[b & (MAX_JOBS - 1)].store(pJob, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job* Pop()
+    {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* pJob = slots[b & (MAX_JOBS - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                Bump(contendedPops);
+                pJob = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return pJob;
+    }
+
+    Job* Steal(bool& contended)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+
+        Job* pJob = slots[t & (MAX_JOBS - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            contended = true;
+            return nullptr;
+        }
+        return pJob;
+    }
+
+    bool HasJobs() const
+    {
+        return bottom.load(std::memory_order_seq_cst) > top.load(std::memory_order_seq_cst);
+    }
+
+    JobThreadStats GetStats() const
+    {
+        JobThreadStats stats;
+        stats.jobs = jobs.load(std::memory_order_relaxed);
+        stats.steals = steals.load(std::memory_order_relaxed);
+        stats.stealAttempts = stealAttempts.load(std::memory_order_relaxed);
+        stats.contendedSteals = contendedSteals.load(std::memory_order_relaxed);
+        stats.contendedPops = contendedPops.load(std::memory_order_relaxed);
+        stats.overflows = overflows.load(std::memory_order_relaxed);
+        stats.sleeps = sleeps.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        jobs.store(0, std::memory_order_relaxed);
+        steals.store(0, std::memory_order_relaxed);
+        stealAttempts.store(0, std::memory_order_relaxed);
+        contendedSteals.store(0, std::memory_order_relaxed);
+        contendedPops.store(0, std::memory_order_relaxed);
+        overflows.store(0, std::memory_order_relaxed);
+        sleeps.store(0, std::memory_order_relaxed);
+    }
+};
+
+thread_local JobSystem::ThreadState* JobSystem::s_pCurrent = nullptr;
+
+JobThreadStats& JobThreadStats::operator+=(const JobThreadStats& other)
+{
+    jobs += other.jobs;
+    steals += other.steals;
+    stealAttempts += other.stealAttempts;
+    contendedSteals += other.contendedSteals;
+    contendedPops += other.contendedPops;
+    overflows += other.overflows;
+    sleeps += other.sleeps;
+    return *this;
+}
+
+JobSystem::JobSystem(unsigned threadCount)
+    : m_sleeping(0), m_wakeCount(0), m_stop(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    m_threadCount = threadCount;
+
+    m_threads.reset(new ThreadState[threadCount]);
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        ThreadState& thread = m_threads[i];
+        thread.top.store(0, std::memory_order_relaxed);
+        thread.bottom.store(0, std::memory_order_relaxed);
+        thread.pSystem = this;
+        thread.pJobs.reset(new Job[MAX_JOBS]);
+        for (uint32_t j = 0; j < MAX_JOBS; ++j)
+            thread.pJobs[j].unfinished.store(0, std::memory_order_relaxed);
+        thread.nextJob = 0;
+        thread.random = 0x9e3779b9u * (i + 1);
+        thread.ResetStats();
+    }
+
+    m_workers.reserve(threadCount - 1);
+    for (uint32_t i = 1; i < threadCount; ++i)
+        m_workers.emplace_back(&JobSystem::WorkerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+JobSystem::ThreadState* JobSystem::GetCurrentThread()
+{
+    if (s_pCurrent && s_pCurrent->pSystem == this)
+        return s_pCurrent;
+    return &m_threads[0];
+}
+
+Job* JobSystem::AllocateJob(Job* pParent)
+{
+    // Parents outlive many of their children, so slots still in use are
+    // skipped; if all of them are, this thread runs jobs until one frees.
+    ThreadState& thread = *GetCurrentThread();
+    Job* pJob = nullptr;
+    for (;;)
+    {
+        for (uint32_t n = 0; n < MAX_JOBS && !pJob; ++n)
+        {
+            Job* pSlot = &thread.pJobs[thread.nextJob++ & (MAX_JOBS - 1)];
+            if (pSlot->unfinished.load(std::memory_order_acquire) == 0)
+                pJob = pSlot;
+        }
+        if (pJob)
+            break;
+
+        Job* pOther = FindJob(thread);
+        if (pOther)
+            Execute(thread, pOther);
+        else
+            std::this_thread::yield();
+    }
+
+    pJob->pParent = pParent;
+    pJob->unfinished.store(1, std::memory_order_relaxed);
+    if (pParent)
+        pParent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return pJob;
+}
+
+void JobSystem::Run(Job* pJob)
+{
+    ThreadState& thread = *GetCurrentThread();
+    if (!thread.Push(pJob))
+    {
+        Bump(thread.overflows);
+        Execute(thread, pJob);
+        return;
+    }
+
+    // A sleeper either shows up here or sees the job when it checks the
+    // deques after announcing itself.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            ++m_wakeCount;
+        }
+        m_wake.notify_one();
+    }
+}
+
+void JobSystem::Wait(const Job* pJob)
+{
+    ThreadState& thread = *GetCurrentThread();
+    while (!IsFinished(pJob))
+    {
+        Job* pNext = FindJob(thread);
+        if (pNext)
+            Execute(thread, pNext);
+        else
+            std::this_thread::yield();
+    }
+}
+
+Job* JobSystem::FindJob(ThreadState& thread)
+{
+    Job* pJob = thread.Pop();
+    if (pJob || m_threadCount < 2)
+        return pJob;
+
+    thread.random ^= thread.random << 13;
+    thread.random ^= thread.random >> 17;
+    thread.random ^= thread.random << 5;
+    const uint32_t start = thread.random % m_threadCount;
+    for (uint32_t n = 0; n < m_threadCount; ++n)
+    {
+        ThreadState& victim = m_threads[(start + n) % m_threadCount];
+        if (&victim == &thread)
+            continue;
+
+        Bump(thread.stealAttempts);
+        bool contended = false;
+        pJob = victim.Steal(contended);
+        if (pJob)
+        {
+            Bump(thread.steals);
+            return pJob;
+        }
+        if (contended)
+            Bump(thread.contendedSteals);
+    }
+    return nullptr;
+}
+
+void JobSystem::Execute(ThreadState& thread, Job* pJob)
+{
+    pJob->pFunction(pJob);
+    FinishJob(pJob);
+    Bump(thread.jobs);
+}
+
+bool JobSystem::HasQueuedJobs() const
+{
+    for (uint32_t i = 0; i < m_threadCount; ++i)
+    {
+        if (m_threads[i].HasJobs())
+            return true;
+    }
+    return false;
+}
+
+void JobSystem::WorkerMain(uint32_t index)
+{
+    ThreadState& thread = m_threads[index];
+    s_pCurrent = &thread;
+
+    uint32_t idleRounds = 0;
+    for (;;)
+    {
+        Job* pJob = FindJob(thread);
+        if (pJob)
+        {
+            Execute(thread, pJob);
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < SPIN_ROUNDS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        idleRounds = 0;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if (!m_stop && !HasQueuedJobs())
+        {
+            Bump(thread.sleeps);
+            const uint64_t wakeCount = m_wakeCount;
+            m_wake.wait(lock, [&]() { return m_stop || m_wakeCount != wakeCount; });
+        }
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        if (m_stop)
+            return;
+    }
+}
+
+JobThreadStats JobSystem::GetThreadStats(uint32_t thread) const
+{
+    return m_threads[thread].GetStats();
+}
+
+JobThreadStats JobSystem::GetStats() const
+{
+    JobThreadStats stats;
+    for (uint32_t i = 0; i < m_threadCount; ++i)
+        stats += m_threads[i].GetStats();
+    return stats;
+}
+
+void JobSystem::ResetStats()
+{
+    for (uint32_t i = 0; i < m_threadCount; ++i)
+        m_threads[i].ResetStats();
+}
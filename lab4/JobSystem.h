@@ -0,0 +1,207 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A unit of work for JobSystem; only the system looks inside. The functor
+// is stored in place, so creating a job never touches the heap.
+struct Job
+{
+    static const size_t DATA_SIZE = 40;
+
+    void (*pFunction)(Job* pJob);
+    Job* pParent;
+    std::atomic<int32_t> unfinished;    // itself plus its unfinished children
+    alignas(8) unsigned char data[DATA_SIZE];
+};
+
+static_assert(sizeof(Job) <= 64, "Job should fit a cache line");
+
+// Counters of one thread since the last ResetStats(). A steal attempt
+// looks at one other thread's deque; it fails when the deque is empty
+// and is contended when another thread took the job first.
+struct JobThreadStats
+{
+    uint64_t jobs = 0;                  // run on this thread
+    uint64_t steals = 0;
+    uint64_t stealAttempts = 0;
+    uint64_t contendedSteals = 0;
+    uint64_t contendedPops = 0;         // a thief took this thread's last job
+    uint64_t overflows = 0;             // deque full, run at once instead
+    uint64_t sleeps = 0;                // found no work and waited to be woken
+
+    JobThreadStats& operator+=(const JobThreadStats& other);
+};
+
+// Work-stealing job system for per-frame work. Every thread, the one that
+// created the system included, owns a deque: it pushes and pops jobs at
+// one end while idle threads steal from the other, so threads mostly touch
+// their own deque and a busy thread's oldest, usually largest, jobs are
+// the ones that move. A job can be the child of another; the parent only
+// counts as finished once its children are, so waiting on it waits on the
+// whole tree:
+//
+//     Job* pRoot = jobs.CreateJob([]() {});
+//     jobs.Run(jobs.CreateChildJob(pRoot, [&]() { UpdateCamera(); }));
+//     jobs.Run(jobs.CreateChildJob(pRoot, [&]() { Animate(); }));
+//     jobs.Run(pRoot);
+//     jobs.Wait(pRoot);               // runs jobs itself until done
+//
+// Jobs come from a ring of MAX_JOBS per thread and their slots are
+// recycled once they finish, so a finished job must not be waited on
+// again. Only the creating thread and jobs themselves may create, run and
+// wait for jobs.
+class JobSystem
+{
+public:
+    static const uint32_t MAX_JOBS = 4096;     // unfinished per thread; a power of two
+
+    // threadCount counts the creating thread; 0 means one thread per
+    // hardware thread. With a single thread jobs run on the caller.
+    explicit JobSystem(unsigned threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // fn is called once, without arguments, by whichever thread runs the
+    // job; it has to fit Job::DATA_SIZE, so large state goes by pointer.
+    template<typename F>
+    Job* CreateJob(F&& fn)
+    {
+        return CreateChildJob(nullptr, std::forward<F>(fn));
+    }
+
+    // pParent may already be running, but must not have finished.
+    template<typename F>
+    Job* CreateChildJob(Job* pParent, F&& fn)
+    {
+        typedef typename std::decay<F>::type Fn;
+        static_assert(sizeof(Fn) <= Job::DATA_SIZE, "job functor too large; capture its data by pointer");
+        static_assert(alignof(Fn) <= 8, "job functor alignment too large");
+
+        Job* pJob = AllocateJob(pParent);
+        new (pJob->data) Fn(std::forward<F>(fn));
+        pJob->pFunction = &CallJob<Fn>;
+        return pJob;
+    }
+
+    // Queues a job on the calling thread's deque.
+    void Run(Job* pJob);
+
+    // Runs queued jobs, its own or stolen, until pJob and its children
+    // have finished.
+    void Wait(const Job* pJob);
+
+    bool IsFinished(const Job* pJob) const { return pJob->unfinished.load(std::memory_order_acquire) == 0; }
+
+    // Workers plus the creating thread.
+    uint32_t GetThreadCount() const { return m_threadCount; }
+
+    JobThreadStats GetThreadStats(uint32_t thread) const;
+    JobThreadStats GetStats() const;
+    void ResetStats();
+
+private:
+    struct ThreadState;
+
+    template<typename Fn>
+    static void CallJob(Job* pJob)
+    {
+        Fn* pFn = reinterpret_cast<Fn*>(pJob->data);
+        (*pFn)();
+        pFn->~Fn();
+    }
+
+    static thread_local ThreadState* s_pCurrent;
+
+    ThreadState* GetCurrentThread();
+    Job* AllocateJob(Job* pParent);
+    Job* FindJob(ThreadState& thread);
+    void Execute(ThreadState& thread, Job* pJob);
+    bool HasQueuedJobs() const;
+    void WorkerMain(uint32_t index);
+
+    uint32_t m_threadCount;
+    std::unique_ptr<ThreadState[]> m_threads;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint32_t> m_sleeping;
+    uint64_t m_wakeCount;               // guarded by m_sleepMutex
+    bool m_stop;
+};
+
+namespace JobDetail
+{
+    template<typename F>
+    struct ParallelForContext
+    {
+        JobSystem* pJobs;
+        Job* pRoot;
+        const F* pFn;
+        uint32_t total;
+        uint32_t grain;
+    };
+
+    // Chunks [firstChunk, firstChunk + chunkCount). Hands the upper half
+    // off as a new job until one chunk is left, so thieves take the
+    // biggest pieces there are.
+    template<typename F>
+    struct ParallelForJob
+    {
+        const ParallelForContext<F>* pContext;
+        uint32_t firstChunk;
+        uint32_t chunkCount;
+
+        void operator()() const
+        {
+            const ParallelForContext<F>& context = *pContext;
+            uint32_t count = chunkCount;
+            while (count > 1)
+            {
+                const uint32_t half = count / 2;
+                const ParallelForJob upper = { pContext, firstChunk + count - half, half };
+                context.pJobs->Run(context.pJobs->CreateChildJob(context.pRoot, upper));
+                count -= half;
+            }
+
+            const uint32_t first = firstChunk * context.grain;
+            const uint32_t remaining = context.total - first;
+            (*context.pFn)(first, remaining < context.grain ? remaining : context.grain);
+        }
+    };
+}
+
+// Calls fn(first, count) over [0, total) in chunks of grain items, the last
+// one shorter, so first / grain numbers the chunk; chunks run in parallel
+// and the call returns once all of them are done. Without a job system, or
+// with a single chunk, they run in order on the calling thread.
+template<typename F>
+void ParallelFor(JobSystem* pJobs, uint32_t total, uint32_t grain, const F& fn)
+{
+    if (grain == 0)
+        grain = 1;
+    const uint32_t chunkCount = total / grain + (total % grain != 0 ? 1 : 0);
+    if (!pJobs || pJobs->GetThreadCount() < 2 || chunkCount < 2)
+    {
+        for (uint32_t first = 0; first < total; first += grain)
+            fn(first, total - first < grain ? total - first : grain);
+        return;
+    }
+
+    JobDetail::ParallelForContext<F> context = { pJobs, nullptr, &fn, total, grain };
+    const JobDetail::ParallelForJob<F> whole = { &context, 0, chunkCount };
+    context.pRoot = pJobs->CreateJob(whole);
+    pJobs->Run(context.pRoot);
+    pJobs->Wait(context.pRoot);
+}
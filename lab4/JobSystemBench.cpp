@@ -0,0 +1,151 @@
+#include "JobSystemBench.h"
+#include "BenchUtil.h"
+#include "JobSystem.h"
+#include "LabScene.h"
+#include "TransparencySort.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const float FRAME_TIME = 1.0f / 60.0f;
+    const float ASPECT = 16.0f / 9.0f;
+
+    struct FrameOutput
+    {
+        std::vector<uint32_t> visible;
+        InstanceBatcher instances;
+        TransparencySorter sorter;
+    };
+
+    // A fresh sorter each time, so both sides start cold and break ties
+    // the same way.
+    bool SameFrame(LabScene& scene, JobSystem& jobs, double time, OcclusionCuller& occlusion)
+    {
+        const CameraInput noInput;
+        FrameOutput threaded;
+        FrameOutput serial;
+        SceneMatrices matrices;
+
+        scene.Update(time, 0.0f, noInput, &jobs);
+        scene.ComputeMatrices(ASPECT, matrices);
+        scene.BuildVisibleInstances(matrices.viewProj, threaded.visible, threaded.instances, TRANSFORM_KERNEL_BEST,
+            &occlusion, &jobs);
+        threaded.sorter.Sort(scene.GetTransforms(), matrices.eye[0], matrices.eye[1], matrices.eye[2], &jobs);
+
+        scene.Update(time, 0.0f, noInput);
+        scene.BuildVisibleInstances(matrices.viewProj, serial.visible, serial.instances, TRANSFORM_KERNEL_BEST,
+            &occlusion);
+        serial.sorter.Sort(scene.GetTransforms(), matrices.eye[0], matrices.eye[1], matrices.eye[2]);
+
+        return threaded.visible == serial.visible && threaded.instances.GetDataSize() == serial.instances.GetDataSize() &&
+            memcmp(threaded.instances.GetData(), serial.instances.GetData(), serial.instances.GetDataSize()) == 0 &&
+            threaded.sorter.GetOrder() == serial.sorter.GetOrder();
+    }
+
+    double MeasureEmptyJobs(JobSystem& jobs)
+    {
+        const uint32_t total = 1u << 20;
+        const uint32_t grain = 64;
+        std::vector<uint32_t> values(total, 0);
+        uint32_t* pValues = values.data();
+
+        const BenchClock::time_point start = BenchClock::now();
+        for (int pass = 0; pass < 8; ++pass)
+        {
+            ParallelFor(&jobs, total, grain, [=](uint32_t first, uint32_t count) {
+                pValues[first] += count;
+            });
+        }
+        return ElapsedNs(start, BenchClock::now()) / (8.0 * (total / grain));
+    }
+}
+
+void RunJobSystemBenchmark(const uint32_t* pThreadCounts, uint32_t rowCount, uint32_t cubeCount, uint32_t frames,
+    std::vector<JobSystemBenchResult>& results)
+{
+    results.clear();
+    const CameraInput noInput;
+
+    for (uint32_t row = 0; row < rowCount; ++row)
+    {
+        JobSystem jobs(pThreadCounts[row]);
+        LabScene scene;
+        scene.SetCubeCount(cubeCount);
+        OcclusionCuller occlusion;
+        FrameOutput output;
+
+        JobSystemBenchResult r;
+        r.threads = jobs.GetThreadCount();
+        r.cubes = cubeCount;
+        r.frames = frames;
+
+        // One frame to warm up buffers and the sorter's order.
+        double time = 0.0;
+        scene.Update(time, FRAME_TIME, noInput, &jobs);
+        jobs.ResetStats();
+
+        double updateNs = 0.0;
+        double cullNs = 0.0;
+        double sortKeyNs = 0.0;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            time += FRAME_TIME;
+            const BenchClock::time_point start = BenchClock::now();
+            scene.Update(time, FRAME_TIME, noInput, &jobs);
+            const BenchClock::time_point updated = BenchClock::now();
+
+            SceneMatrices matrices;
+            scene.ComputeMatrices(ASPECT, matrices);
+            scene.BuildVisibleInstances(matrices.viewProj, output.visible, output.instances, TRANSFORM_KERNEL_BEST,
+                &occlusion, &jobs);
+            const BenchClock::time_point culled = BenchClock::now();
+
+            output.sorter.Sort(scene.GetTransforms(), matrices.eye[0], matrices.eye[1], matrices.eye[2], &jobs);
+            const BenchClock::time_point sorted = BenchClock::now();
+
+            updateNs += ElapsedNs(start, updated);
+            cullNs += ElapsedNs(updated, culled);
+            sortKeyNs += ElapsedNs(culled, sorted);
+        }
+
+        const JobThreadStats stats = jobs.GetStats();
+        const double perFrame = frames > 0 ? 1.0 / frames : 0.0;
+        r.updateUs = updateNs * perFrame / 1000.0;
+        r.cullUs = cullNs * perFrame / 1000.0;
+        r.sortKeyUs = sortKeyNs * perFrame / 1000.0;
+        r.frameUs = r.updateUs + r.cullUs + r.sortKeyUs;
+        r.speedup = results.empty() ? 1.0 : (r.frameUs > 0.0 ? results[0].frameUs / r.frameUs : 0.0);
+        r.jobsPerFrame = stats.jobs * perFrame;
+        r.stealsPerFrame = stats.steals * perFrame;
+        r.stealSuccessRate = stats.stealAttempts > 0 ? (double)stats.steals / stats.stealAttempts : 0.0;
+        r.stealContentionRate = stats.stealAttempts > 0 ? (double)stats.contendedSteals / stats.stealAttempts : 0.0;
+        r.contendedPopsPerFrame = stats.contendedPops * perFrame;
+        r.sleepsPerFrame = stats.sleeps * perFrame;
+
+        r.emptyJobNs = MeasureEmptyJobs(jobs);
+        r.matchesSerial = SameFrame(scene, jobs, time, occlusion);
+        results.push_back(r);
+    }
+}
+
+bool WriteJobSystemBenchmarkCsv(const char* filename, const std::vector<JobSystemBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "threads,cubes,frames,update_us,cull_us,sort_key_us,frame_us,speedup,jobs_per_frame,"
+        "steals_per_frame,steal_success_rate,steal_contention_rate,contended_pops_per_frame,sleeps_per_frame,"
+        "empty_job_ns,matches_serial\n");
+    for (const JobSystemBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%u,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%.3f,%.3f,%.2f,%.2f,%.1f,%d\n",
+            r.threads, r.cubes, r.frames, r.updateUs, r.cullUs, r.sortKeyUs, r.frameUs, r.speedup, r.jobsPerFrame,
+            r.stealsPerFrame, r.stealSuccessRate, r.stealContentionRate, r.contendedPopsPerFrame, r.sleepsPerFrame,
+            r.emptyJobNs, r.matchesSerial ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// The lab scene's per-frame CPU work on a job system of 1 to N threads: the
+// scene update (camera and cube animation), frustum and occlusion culling
+// with instance data for what is left, and transparency sort keys for
+// every cube. Times are microseconds per frame; speedup is against the
+// first row. The job counters come from the system's profiler, per frame,
+// and the rates are of steal attempts. emptyJobNs is the cost per job of a
+// parallel loop over many tiny chunks, the system's overhead alone.
+struct JobSystemBenchResult
+{
+    uint32_t threads = 0;
+    uint32_t cubes = 0;
+    uint32_t frames = 0;
+    double updateUs = 0.0;
+    double cullUs = 0.0;                // culling and instance data
+    double sortKeyUs = 0.0;
+    double frameUs = 0.0;
+    double speedup = 0.0;
+    double jobsPerFrame = 0.0;
+    double stealsPerFrame = 0.0;
+    double stealSuccessRate = 0.0;
+    double stealContentionRate = 0.0;   // attempts that lost the job to another thread
+    double contendedPopsPerFrame = 0.0;
+    double sleepsPerFrame = 0.0;
+    double emptyJobNs = 0.0;
+    bool matchesSerial = true;          // visible list, instance data and sort order
+};
+
+void RunJobSystemBenchmark(const uint32_t* pThreadCounts, uint32_t rowCount, uint32_t cubeCount, uint32_t frames,
+    std::vector<JobSystemBenchResult>& results);
+
+bool WriteJobSystemBenchmarkCsv(const char* filename, const std::vector<JobSystemBenchResult>& results);
@@ -0,0 +1,616 @@
+#include "LabCommands.h"
+#include "AssetArchiveBench.h"
+#include "AssetCooker.h"
+#include "BlockDecodeBench.h"
+#include "BlockEncodeBench.h"
+#include "BlockEncoder.h"
+#include "ConstantRingBench.h"
+#include "CubemapLoadBench.h"
+#include "DdsLoadBench.h"
+#include "DdsView.h"
+#include "DdsWriter.h"
+#include "FrameArenaBench.h"
+#include "FrustumCullBench.h"
+#include "HeadlessRunner.h"
+#include "InstanceBench.h"
+#include "JobSystemBench.h"
+#include "LabStreaming.h"
+#include "LoadScheduler.h"
+#include "OcclusionCullBench.h"
+#include "PixelConvertBench.h"
+#include "QualityTierBench.h"
+#include "ReferenceRenderer.h"
+#include "RenderQueueBench.h"
+#include "SceneBvhBench.h"
+#include "SoftwareRasterBench.h"
+#include "SoftwareRenderer.h"
+#include "TextureCacheBench.h"
+#include "TextureLoadBench.h"
+#include "TransformBench.h"
+#include "TransparencyBench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    const char* const SKYBOX_FACE_NAMES[6] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+
+    // Names of the textures OpenLabTextures() opens, in order.
+    const char* const LAB_TEXTURE_NAMES[7] = { "wood02", "posx", "negx", "posy", "negy", "posz", "negz" };
+
+    template<typename T, size_t N>
+    uint32_t CountOf(const T (&)[N])
+    {
+        return (uint32_t)N;
+    }
+
+    void GetSkyboxFacePaths(const std::string& root, std::string paths[6])
+    {
+        for (int i = 0; i < 6; ++i)
+            paths[i] = root + "skybox/" + SKYBOX_FACE_NAMES[i] + ".dds";
+    }
+
+    // wood02 and the six skybox faces, in LAB_TEXTURE_NAMES order.
+    void GetLabTexturePaths(const std::string& root, std::string paths[7])
+    {
+        paths[0] = root + "wood02.dds";
+        GetSkyboxFacePaths(root, paths + 1);
+    }
+
+    // wood02 and the six skybox faces, for the CPU backends.
+    void OpenLabTextures(const LabCommandLine& commandLine, DdsView& texture, DdsView faces[6])
+    {
+        std::string paths[7];
+        GetLabTexturePaths(commandLine.textureDir, paths);
+        texture.Open(paths[0].c_str());
+        for (int i = 0; i < 6; ++i)
+            faces[i].Open(paths[i + 1].c_str());
+    }
+
+    // --bench-instancing runs the CPU submission sweep and writes
+    // instancing_bench.csv.
+    int RunInstancingBenchmark(const LabCommandLine&)
+    {
+        const uint32_t sizes[] = { 1000, 10000, 25000, 50000, 100000 };
+        std::vector<InstanceBenchResult> results;
+        RunInstanceBenchmark(sizes, CountOf(sizes), 4, 20, results);
+        return WriteInstanceBenchmarkCsv("instancing_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-transforms compares the AoS matrix path with the SoA transform
+    // kernels and writes transform_bench.csv.
+    int RunTransformsBenchmark(const LabCommandLine&)
+    {
+        const uint32_t sizes[] = { 1000, 100000, 1000000 };
+        std::vector<TransformBenchResult> results;
+        RunTransformBenchmark(sizes, CountOf(sizes), 10, results);
+        return WriteTransformBenchmarkCsv("transform_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-transparency times the back-to-front sort against std::sort
+    // and writes transparency_bench.csv.
+    int RunTransparencySortBenchmark(const LabCommandLine&)
+    {
+        const uint32_t sizes[] = { 10000, 100000, 1000000 };
+        std::vector<TransparencyBenchResult> results;
+        RunTransparencyBenchmark(sizes, CountOf(sizes), 10, results);
+        return WriteTransparencyBenchmarkCsv("transparency_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-constants compares per-object constant buffer updates with
+    // ring-buffer slices over an 8 MB ring and writes
+    // constant_ring_bench.csv. 40000 objects do not fit the ring, so part
+    // of each frame falls back.
+    int RunConstantsBenchmark(const LabCommandLine&)
+    {
+        const uint32_t counts[] = { 100, 1000, 10000, 40000 };
+        std::vector<ConstantRingBenchResult> results;
+        RunConstantRingBenchmark(counts, CountOf(counts), 8 * 1024 * 1024, 120, results);
+        return WriteConstantRingBenchmarkCsv("constant_ring_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-arena builds a frame's render list in fresh vectors and in a
+    // frame arena and writes frame_arena_bench.csv.
+    int RunArenaBenchmark(const LabCommandLine&)
+    {
+        const uint32_t counts[] = { 1000, 10000, 100000 };
+        std::vector<FrameArenaBenchResult> results;
+        RunFrameArenaBenchmark(counts, CountOf(counts), 200, results);
+        return WriteFrameArenaBenchmarkCsv("frame_arena_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-cull culls random scenes along the scripted orbit with every
+    // kernel and writes frustum_cull_bench.csv.
+    int RunCullBenchmark(const LabCommandLine&)
+    {
+        const uint32_t sizes[] = { 100000, 1000000 };
+        std::vector<FrustumCullBenchResult> results;
+        RunFrustumCullBenchmark(sizes, CountOf(sizes), 120, results);
+        return WriteFrustumCullBenchmarkCsv("frustum_cull_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-bvh times building, refitting and querying the bounding
+    // volume hierarchy and writes scene_bvh_bench.csv.
+    int RunBvhBenchmark(const LabCommandLine&)
+    {
+        const uint32_t sizes[] = { 10000, 100000, 1000000 };
+        std::vector<SceneBvhBenchResult> results;
+        RunSceneBvhBenchmark(sizes, CountOf(sizes), 60, 100000, results);
+        return WriteSceneBvhBenchmarkCsv("scene_bvh_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-occlusion culls 100k cubes behind a rising number of walls
+    // with every raster kernel and writes occlusion_cull_bench.csv.
+    int RunOcclusionBenchmark(const LabCommandLine&)
+    {
+        const uint32_t occluders[] = { 0, 8, 32, 128 };
+        std::vector<OcclusionCullBenchResult> results;
+        RunOcclusionCullBenchmark(occluders, CountOf(occluders), 100000, 60, results);
+        return WriteOcclusionCullBenchmarkCsv("occlusion_cull_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-queue submits synthetic frames of mixed materials unsorted
+    // and through the render queue and writes render_queue_bench.csv.
+    int RunQueueBenchmark(const LabCommandLine&)
+    {
+        const uint32_t draws[] = { 1000, 10000, 10000, 100000 };
+        const uint32_t shaders[] = { 4, 8, 32, 32 };
+        const uint32_t textures[] = { 16, 64, 256, 1024 };
+        std::vector<RenderQueueBenchResult> results;
+        RunRenderQueueBenchmark(draws, shaders, textures, CountOf(draws), 20, results);
+        return WriteRenderQueueBenchmarkCsv("render_queue_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-jobs runs the scene's per-frame CPU work for 100k cubes on 1
+    // to N threads, N the hardware's, and writes job_system_bench.csv.
+    int RunJobsBenchmark(const LabCommandLine&)
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        std::vector<uint32_t> threads;
+        for (uint32_t count = 1; count == 1 || count <= hardwareThreads; ++count)
+            threads.push_back(count);
+
+        std::vector<JobSystemBenchResult> results;
+        RunJobSystemBenchmark(threads.data(), (uint32_t)threads.size(), 100000, 60, results);
+        return WriteJobSystemBenchmarkCsv("job_system_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-decode decodes wood02 and the skybox faces on the CPU with
+    // every kernel and writes decode_bench.csv.
+    int RunDecodeBenchmark(const LabCommandLine& commandLine)
+    {
+        DdsView views[7];
+        OpenLabTextures(commandLine, views[0], views + 1);
+
+        std::vector<BlockDecodeBenchResult> results;
+        RunBlockDecodeBenchmark(views, LAB_TEXTURE_NAMES, 7, 10, results);
+        return WriteBlockDecodeBenchmarkCsv("decode_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-pixels converts synthetic uncompressed DDS files of every
+    // layout, 256x256 to 8192x8192, to RGBA8 with every kernel and writes
+    // pixel_convert_bench.csv.
+    int RunPixelBenchmark(const LabCommandLine&)
+    {
+        std::vector<PixelConvertBenchResult> results;
+        if (!RunPixelConvertBenchmark("pixel_bench.dds", 256, 8192, results))
+            return -1;
+        return WritePixelConvertBenchmarkCsv("pixel_convert_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-quality loads wood02 and the six skybox faces at full quality,
+    // one to three top mips dropped and a 512 texel cap, each from a cold
+    // page cache, and writes the bytes each tier read to
+    // quality_tier_bench.csv.
+    int RunQualityBenchmark(const LabCommandLine& commandLine)
+    {
+        std::string paths[7];
+        GetLabTexturePaths(commandLine.textureDir, paths);
+
+        TextureQuality tiers[5];
+        tiers[1].dropMips = 1;
+        tiers[2].dropMips = 2;
+        tiers[3].dropMips = 3;
+        tiers[4].maxDimension = 512;
+
+        std::vector<QualityTierBenchResult> results;
+        if (!RunQualityTierBenchmark(paths, 7, tiers, CountOf(tiers), 10, results))
+            return -1;
+        return WriteQualityTierBenchmarkCsv("quality_tier_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-texture-cache references wood02, wood and the skybox faces
+    // from both lab4 and lab5, whose copies are byte-identical, 1 to 256
+    // times with and without the decoded texture cache and writes
+    // texture_cache_bench.csv.
+    int RunTextureCacheBenchmark(const LabCommandLine& commandLine)
+    {
+        const std::string roots[2] = { commandLine.textureDir, commandLine.textureDir + "../../lab5/texture/" };
+        std::string files[2][8];
+        for (int r = 0; r < 2; ++r)
+        {
+            files[r][0] = roots[r] + "wood02.dds";
+            files[r][1] = roots[r] + "wood.dds";
+            GetSkyboxFacePaths(roots[r], files[r] + 2);
+        }
+
+        std::vector<std::wstring> paths;
+        for (int i = 0; i < 8; ++i)
+        {
+            for (int r = 0; r < 2; ++r)
+                paths.push_back(std::wstring(files[r][i].begin(), files[r][i].end()));
+        }
+
+        const uint32_t references[] = { 1, 16, 64, 256 };
+        std::vector<TextureCacheBenchResult> results;
+        if (!::RunTextureCacheBenchmark(paths.data(), (uint32_t)paths.size(), references, CountOf(references),
+            results))
+        {
+            return -1;
+        }
+        return WriteTextureCacheBenchmarkCsv("texture_cache_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-encode encodes wood02 and the skybox faces to BC1 and BC3 at
+    // both qualities with every kernel and thread count and writes
+    // encode_bench.csv.
+    int RunEncodeBenchmark(const LabCommandLine& commandLine)
+    {
+        DdsView views[7];
+        OpenLabTextures(commandLine, views[0], views + 1);
+
+        std::vector<BlockEncodeBenchResult> results;
+        RunBlockEncodeBenchmark(views, LAB_TEXTURE_NAMES, 7, 3, results);
+        return WriteBlockEncodeBenchmarkCsv("encode_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-cubemap writes the skybox as one cube map file, with the
+    // legacy and with the DX10 header, and compares loading either with
+    // loading the six face files. Results go to cubemap_bench.csv.
+    int RunCubemapBenchmark(const LabCommandLine& commandLine)
+    {
+        std::string paths[6];
+        GetSkyboxFacePaths(commandLine.textureDir, paths);
+        std::wstring facePaths[6];
+        for (int i = 0; i < 6; ++i)
+            facePaths[i].assign(paths[i].begin(), paths[i].end());
+
+        std::vector<CubemapLoadBenchResult> results;
+        if (!RunCubemapLoadBenchmark(facePaths, "skybox_cube.dds", "skybox_cube_dx10.dds", 200, results))
+            return -1;
+        return WriteCubemapLoadBenchmarkCsv("cubemap_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-dds loads wood02 and the six skybox faces through DdsView and
+    // through LoadDDS's copies and writes the bytes copied and peak RSS of
+    // each to dds_load_bench.csv.
+    int RunDdsBenchmark(const LabCommandLine& commandLine)
+    {
+        DdsLoadBenchSet sets[2];
+        sets[0].name = "wood02";
+        sets[0].paths.push_back(commandLine.textureDir + "wood02.dds");
+        sets[1].name = "skybox";
+        sets[1].paths.resize(6);
+        GetSkyboxFacePaths(commandLine.textureDir, sets[1].paths.data());
+
+        std::vector<DdsLoadBenchResult> results;
+        if (!RunDdsLoadBenchmark(sets, 2, 20, results))
+            return -1;
+        return WriteDdsLoadBenchmarkCsv("dds_load_bench.csv", results) ? 0 : -1;
+    }
+
+    // --bench-load loads the six skybox faces one after another and on load
+    // schedulers of 1 to 6 workers, warm and (off Windows) cold, and writes
+    // load_bench.csv.
+    int RunLoadBenchmark(const LabCommandLine& commandLine)
+    {
+        std::string paths[6];
+        GetSkyboxFacePaths(commandLine.textureDir, paths);
+
+        const unsigned workerCounts[] = { 1, 2, 3, 6 };
+        std::vector<TextureLoadBenchResult> results;
+        if (!RunTextureLoadBenchmark(paths, 6, workerCounts, CountOf(workerCounts), 20, results))
+            return -1;
+        return WriteTextureLoadBenchmarkCsv("load_bench.csv", results) ? 0 : -1;
+    }
+
+    // --make-cubemap packs the six skybox faces into texture/skybox.dds,
+    // which the D3D11 renderer then loads instead of the faces.
+    int MakeCubemap(const LabCommandLine& commandLine)
+    {
+        DdsView texture;
+        DdsView faces[6];
+        OpenLabTextures(commandLine, texture, faces);
+        return WriteDdsSlices((commandLine.textureDir + "skybox.dds").c_str(), faces, 6, true, false) ? 0 : -1;
+    }
+
+    // --cook-archive packs wood02 and the skybox (texture/skybox.dds if
+    // there is one, the six faces otherwise) into texture/lab.pak, which the
+    // D3D11 renderer then loads instead of the loose files.
+    int CookArchive(const LabCommandLine& commandLine)
+    {
+        DdsView texture;
+        DdsView faces[6];
+        OpenLabTextures(commandLine, texture, faces);
+
+        DdsView cube;
+        AssetCookSource sources[2];
+        sources[0].name = "wood02";
+        sources[0].pViews = &texture;
+        sources[1].name = "skybox";
+        if (cube.Open((commandLine.textureDir + "skybox.dds").c_str()) && cube.IsCubemap())
+        {
+            sources[1].pViews = &cube;
+        }
+        else
+        {
+            sources[1].pViews = faces;
+            sources[1].viewCount = 6;
+            sources[1].cubemap = true;
+        }
+        return CookAssetArchive((commandLine.textureDir + "lab.pak").c_str(), sources, 2) ? 0 : -1;
+    }
+
+    // --bench-archive cooks wood02 and the six skybox faces into
+    // archive_bench.pak and compares starting up from it with starting up
+    // from the loose files, warm and (off Windows) cold. Results go to
+    // archive_bench.csv.
+    int RunArchiveBenchmark(const LabCommandLine& commandLine)
+    {
+        std::string paths[7];
+        GetLabTexturePaths(commandLine.textureDir, paths);
+
+        std::vector<AssetArchiveBenchResult> results;
+        if (!RunAssetArchiveBenchmark(paths, 7, "archive_bench.pak", 50, results))
+            return -1;
+        return WriteAssetArchiveBenchmarkCsv("archive_bench.csv", results) ? 0 : -1;
+    }
+
+    // --compress-texture <in.dds> <out.dds> re-encodes every mip and slice
+    // of a DDS file as BC1, or BC3 with --bc3. --hq uses the slow high
+    // quality mode meant for cooking.
+    int CompressTexture(const LabCommandLine& commandLine)
+    {
+        const char* pInput = commandLine.GetValue("--compress-texture");
+        const char* pOutput = commandLine.GetValue("--compress-texture", 2);
+        if (!pInput || !pOutput)
+            return -1;
+
+        DdsView view;
+        if (!view.Open(pInput))
+            return -1;
+
+        const DXGI_FORMAT fmt = commandLine.Has("--bc3") ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+        const BlockEncodeQuality quality = commandLine.Has("--hq") ? BLOCK_ENCODE_HIGH : BLOCK_ENCODE_FAST;
+        LoadScheduler scheduler;
+        return CompressDdsFile(view, pOutput, fmt, quality, &scheduler) ? 0 : -1;
+    }
+
+    // --bench-software renders labs 3-5 with the software rasterizer on a
+    // range of thread counts at 1280x720 and writes software_bench.csv.
+    int RunSoftwareBenchmark(const LabCommandLine& commandLine)
+    {
+        DdsView texture;
+        DdsView faces[6];
+        OpenLabTextures(commandLine, texture, faces);
+
+        std::vector<SoftwareRasterBenchResult> results;
+        RunSoftwareRasterBenchmark(texture, faces, 1280, 720, GetCubeCount(commandLine), 120, results);
+        return WriteSoftwareRasterBenchmarkCsv("software_bench.csv", results) ? 0 : -1;
+    }
+
+    // --stream-report runs the texture streaming planner along the camera
+    // path without a device and writes streaming_report.csv. Takes --frames
+    // N, --camera-path FILE and --texture-budget MB like --headless.
+    int RunStreamingReportMode(const LabCommandLine& commandLine)
+    {
+        StreamingReportOptions options;
+        if (const char* p = commandLine.GetValue("--frames"))
+            options.frameCount = (uint32_t)strtoul(p, nullptr, 10);
+
+        CameraPath path;
+        if (const char* p = commandLine.GetValue("--camera-path"))
+        {
+            if (!path.Load(p))
+            {
+                fprintf(stderr, "Failed to load the camera path %s\n", p);
+                return -1;
+            }
+        }
+        else
+        {
+            path = CameraPath::MakeOrbit((float)options.frameCount * options.frameTime);
+        }
+
+        DdsView texture;
+        DdsView faces[6];
+        OpenLabTextures(commandLine, texture, faces);
+
+        TextureStreamingPlanner planner;
+        planner.SetBudget(GetTextureBudget(commandLine));
+        LabStreamingTextures textures;
+        textures.cube = planner.AddTexture(MakeStreamingDesc("wood02", &texture, 1));
+        textures.skybox = planner.AddTexture(MakeStreamingDesc("skybox", faces, 6));
+
+        LabScene scene;
+        scene.SetCubeCount(GetCubeCount(commandLine));
+        std::vector<StreamingReportRow> rows;
+        RunStreamingReport(scene, path, planner, textures, options, rows);
+        return WriteStreamingReportCsv("streaming_report.csv", planner, rows) ? 0 : -1;
+    }
+
+    // --headless --backend cpu|software renders frames offscreen on the CPU;
+    // see ParseHeadlessOptions() for the options. Per-frame timings go to
+    // headless_timings.csv. Other backends are left to lab4.exe.
+    int RunHeadlessMode(const LabCommandLine& commandLine)
+    {
+        const char* pBackend = commandLine.GetValue("--backend");
+        const bool useCpu = pBackend && strcmp(pBackend, "cpu") == 0;
+        const bool useSoftware = pBackend && strcmp(pBackend, "software") == 0;
+        if (!useCpu && !useSoftware)
+            return LAB_COMMAND_NONE;
+
+        HeadlessOptions options;
+        uint32_t width = 0, height = 0;
+        CameraPath path;
+        if (!ParseHeadlessOptions(commandLine, options, width, height, path))
+            return -1;
+
+        DdsView texture;
+        DdsView faces[6];
+        OpenLabTextures(commandLine, texture, faces);
+
+        std::vector<FrameTiming> timings;
+        const char* backendName = nullptr;
+        bool ok = false;
+        LabScene scene;
+        if (useCpu)
+        {
+            scene.SetCubeCount(GetCubeCount(commandLine));
+            ReferenceRenderer renderer;
+            backendName = renderer.GetName();
+            ok = renderer.Initialize(width, height) && renderer.LoadTextures(texture, faces) &&
+                RunHeadless(scene, renderer, path, options, timings);
+        }
+        else
+        {
+            uint32_t threads = 0;
+            if (const char* p = commandLine.GetValue("--threads"))
+                threads = (uint32_t)strtoul(p, nullptr, 10);
+            SoftwareLab lab = SOFTWARE_LAB4;
+            if (const char* p = commandLine.GetValue("--lab"))
+            {
+                const uint32_t number = (uint32_t)strtoul(p, nullptr, 10);
+                lab = number == 3 ? SOFTWARE_LAB3 : (number == 5 ? SOFTWARE_LAB5 : SOFTWARE_LAB4);
+            }
+
+            scene.SetCubeCount(lab == SOFTWARE_LAB4 ? GetCubeCount(commandLine) : 1);
+            SoftwareRenderer renderer;
+            renderer.SetLab(lab);
+            backendName = renderer.GetName();
+            ok = renderer.Initialize(width, height, threads) && renderer.LoadTextures(texture, faces) &&
+                RunHeadless(scene, renderer, path, options, timings);
+        }
+
+        if (!WriteFrameTimingsCsv("headless_timings.csv", backendName, timings))
+            return -1;
+        return ok ? 0 : -1;
+    }
+
+    struct LabCommand
+    {
+        const char* name;
+        int (*pRun)(const LabCommandLine& commandLine);
+    };
+
+    const LabCommand COMMANDS[] = {
+        { "--bench-instancing", RunInstancingBenchmark },
+        { "--bench-transforms", RunTransformsBenchmark },
+        { "--bench-transparency", RunTransparencySortBenchmark },
+        { "--bench-constants", RunConstantsBenchmark },
+        { "--bench-arena", RunArenaBenchmark },
+        { "--bench-cull", RunCullBenchmark },
+        { "--bench-bvh", RunBvhBenchmark },
+        { "--bench-occlusion", RunOcclusionBenchmark },
+        { "--bench-queue", RunQueueBenchmark },
+        { "--bench-jobs", RunJobsBenchmark },
+        { "--bench-cubemap", RunCubemapBenchmark },
+        { "--bench-dds", RunDdsBenchmark },
+        { "--bench-load", RunLoadBenchmark },
+        { "--make-cubemap", MakeCubemap },
+        { "--cook-archive", CookArchive },
+        { "--bench-archive", RunArchiveBenchmark },
+        { "--bench-encode", RunEncodeBenchmark },
+        { "--bench-decode", RunDecodeBenchmark },
+        { "--bench-pixels", RunPixelBenchmark },
+        { "--bench-quality", RunQualityBenchmark },
+        { "--bench-texture-cache", RunTextureCacheBenchmark },
+        { "--compress-texture", CompressTexture },
+        { "--bench-software", RunSoftwareBenchmark },
+        { "--stream-report", RunStreamingReportMode },
+        { "--headless", RunHeadlessMode },
+    };
+}
+
+bool LabCommandLine::Has(const char* pName) const
+{
+    for (const std::string& arg : args)
+    {
+        if (arg == pName)
+            return true;
+    }
+    return false;
+}
+
+const char* LabCommandLine::GetValue(const char* pName, size_t offset) const
+{
+    for (size_t i = 0; i + offset < args.size(); ++i)
+    {
+        if (args[i] == pName)
+            return args[i + offset].c_str();
+    }
+    return nullptr;
+}
+
+uint32_t GetCubeCount(const LabCommandLine& commandLine)
+{
+    const char* p = commandLine.GetValue("--cubes");
+    return p ? (uint32_t)strtoul(p, nullptr, 10) : 1;
+}
+
+uint64_t GetTextureBudget(const LabCommandLine& commandLine)
+{
+    const char* p = commandLine.GetValue("--texture-budget");
+    return p ? (uint64_t)strtoul(p, nullptr, 10) << 20 : 0;
+}
+
+bool ParseHeadlessOptions(const LabCommandLine& commandLine, HeadlessOptions& options, uint32_t& width,
+    uint32_t& height, CameraPath& path)
+{
+    width = 1280;
+    height = 720;
+    if (const char* p = commandLine.GetValue("--frames"))
+        options.frameCount = (uint32_t)strtoul(p, nullptr, 10);
+    if (const char* p = commandLine.GetValue("--dump-every"))
+        options.dumpInterval = (uint32_t)strtoul(p, nullptr, 10);
+    if (const char* p = commandLine.GetValue("--size"))
+    {
+        char* pEnd = nullptr;
+        width = (uint32_t)strtoul(p, &pEnd, 10);
+        height = *pEnd == 'x' ? (uint32_t)strtoul(pEnd + 1, nullptr, 10) : 0;
+    }
+    if (width == 0 || height == 0)
+        return false;
+
+    if (const char* p = commandLine.GetValue("--camera-path"))
+    {
+        if (!path.Load(p))
+        {
+            fprintf(stderr, "Failed to load the camera path %s\n", p);
+            return false;
+        }
+    }
+    else
+    {
+        path = CameraPath::MakeOrbit((float)options.frameCount * options.frameTime);
+    }
+    return true;
+}
+
+int RunLabCommand(const LabCommandLine& commandLine)
+{
+    for (const LabCommand& command : COMMANDS)
+    {
+        if (commandLine.Has(command.name))
+            return command.pRun(commandLine);
+    }
+    return LAB_COMMAND_NONE;
+}
+
+void PrintLabCommands()
+{
+    for (const LabCommand& command : COMMANDS)
+        printf("  %s\n", command.name);
+}
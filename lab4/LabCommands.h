@@ -0,0 +1,46 @@
+#pragma once
+#include "CameraPath.h"
+#include "HeadlessRunner.h"
+#include <string>
+#include <vector>
+
+// The command-line modes that need neither a window nor D3D11: benches,
+// reports and texture tools. lab4.exe hands its command line here before
+// it creates a window; lab4_bench (tests/CMakeLists.txt) runs the same
+// modes on any platform. Results are written to the working directory.
+struct LabCommandLine
+{
+    std::vector<std::string> args;      // space-separated, as lab4.exe splits them
+    std::string textureDir;             // the lab4 textures, with a trailing separator
+
+    bool Has(const char* pName) const;
+    // The argument offset places after pName, or nullptr if there is none.
+    const char* GetValue(const char* pName, size_t offset = 1) const;
+};
+
+// --cubes N: the lab cube plus a floor of N-1 instanced cubes (1).
+uint32_t GetCubeCount(const LabCommandLine& commandLine);
+
+// --texture-budget MB: the memory streamed textures may use, in bytes (0,
+// no cap).
+uint64_t GetTextureBudget(const LabCommandLine& commandLine);
+
+// The options every --headless backend takes:
+//   --frames N            frames to render at a fixed 60 Hz step (300)
+//   --size WxH            target size (1280x720)
+//   --dump-every K        write every Kth frame as headless_frameNNNN.bmp
+//   --camera-path FILE    camera keys to follow instead of the built-in orbit
+// False if the size is malformed or the path does not load.
+bool ParseHeadlessOptions(const LabCommandLine& commandLine, HeadlessOptions& options, uint32_t& width,
+    uint32_t& height, CameraPath& path);
+
+// Returned by RunLabCommand() when the command line names no mode.
+const int LAB_COMMAND_NONE = 1;
+
+// Runs the mode the command line names and returns its exit code: 0 on
+// success, -1 on failure. "--headless" is only run here for the CPU
+// backends (--backend cpu|software); for D3D11 it returns LAB_COMMAND_NONE.
+int RunLabCommand(const LabCommandLine& commandLine);
+
+// Prints the modes RunLabCommand() knows.
+void PrintLabCommands();
@@ -0,0 +1,319 @@
+#include "LabScene.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const float LabScene::FOV_Y = 3.14159265f / 3.0f;
+const float LabScene::NEAR_Z = 0.1f;
+const float LabScene::FAR_Z = 100.0f;
+
+// Per-frame jobs work on at least SCENE_GRAIN cubes each, and culling
+// splits the scene into at most MAX_CULL_CHUNKS of them.
+static const uint32_t SCENE_GRAIN = 4096;
+static const uint32_t MAX_CULL_CHUNKS = 256;
+
+static uint32_t GetCullGrain(size_t count)
+{
+    const uint32_t grain = (uint32_t)((count + MAX_CULL_CHUNKS - 1) / MAX_CULL_CHUNKS);
+    return grain > SCENE_GRAIN ? grain : SCENE_GRAIN;
+}
+
+// Each chunk of grain entries kept counts[c] of them at its start; moves
+// them together and returns how many there are.
+static size_t JoinChunks(uint32_t* pList, size_t count, uint32_t grain, const uint32_t* pCounts)
+{
+    size_t kept = 0;
+    for (size_t c = 0; c * grain < count; ++c)
+    {
+        if (kept != c * grain)
+            memmove(pList + kept, pList + c * grain, pCounts[c] * sizeof(uint32_t));
+        kept += pCounts[c];
+    }
+    return kept;
+}
+
+static const SceneVertex s_cubeVertices[] = {
+    { { -0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f } },
+    { { 0.5f, -0.5f, -0.5f }, { 1.0f, 1.0f } },
+    { { 0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f } },
+    { { -0.5f,  0.5f, -0.5f }, { 0.0f, 0.0f } },
+    { { -0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f } },
+    { { 0.5f, -0.5f,  0.5f }, { 1.0f, 1.0f } },
+    { { 0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
+    { { -0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f } },
+    { { -0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f } },
+    { { -0.5f, -0.5f, -0.5f }, { 1.0f, 1.0f } },
+    { { -0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f } },
+    { { -0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f } },
+    { { 0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f } },
+    { { 0.5f, -0.5f,  0.5f }, { 1.0f, 1.0f } },
+    { { 0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
+    { { 0.5f,  0.5f, -0.5f }, { 0.0f, 0.0f } },
+    { { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f } },
+    { { 0.5f,  0.5f, -0.5f }, { 1.0f, 1.0f } },
+    { { 0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
+    { { -0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f } },
+    { { -0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f } },
+    { { 0.5f, -0.5f,  0.5f }, { 1.0f, 1.0f } },
+    { { 0.5f, -0.5f, -0.5f }, { 1.0f, 0.0f } },
+    { { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f } }
+};
+
+static const uint16_t s_cubeIndices[] = {
+    0,2,1, 0,3,2, 4,5,6, 4,6,7, 8,10,9, 8,11,10,
+    12,14,13, 12,15,14, 16,18,17, 16,19,18, 20,22,21, 20,23,22
+};
+
+static const SceneVertex s_skyboxVertices[] = {
+    { { -10, -10, -10 }, { 0,0 } },
+    { { 10, -10, -10 }, { 0,0 } },
+    { { 10,  10, -10 }, { 0,0 } },
+    { { -10,  10, -10 }, { 0,0 } },
+    { { -10, -10,  10 }, { 0,0 } },
+    { { 10, -10,  10 }, { 0,0 } },
+    { { 10,  10,  10 }, { 0,0 } },
+    { { -10,  10,  10 }, { 0,0 } }
+};
+
+static const uint16_t s_skyboxIndices[] = {
+    0,2,1, 0,3,2, 4,5,6, 4,6,7, 0,7,3, 0,4,7,
+    1,2,6, 1,6,5, 3,7,6, 3,6,2, 0,1,5, 0,5,4
+};
+
+const SceneMesh& GetCubeMesh()
+{
+    static const SceneMesh s_mesh = {
+        s_cubeVertices, (uint32_t)(sizeof(s_cubeVertices) / sizeof(s_cubeVertices[0])),
+        s_cubeIndices, (uint32_t)(sizeof(s_cubeIndices) / sizeof(s_cubeIndices[0]))
+    };
+    return s_mesh;
+}
+
+const SceneMesh& GetSkyboxMesh()
+{
+    static const SceneMesh s_mesh = {
+        s_skyboxVertices, (uint32_t)(sizeof(s_skyboxVertices) / sizeof(s_skyboxVertices[0])),
+        s_skyboxIndices, (uint32_t)(sizeof(s_skyboxIndices) / sizeof(s_skyboxIndices[0]))
+    };
+    return s_mesh;
+}
+
+static const float s_lab3Positions[8][3] = {
+    { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f },
+    { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f }
+};
+
+static const uint8_t s_lab3Colors[8][3] = {
+    { 255, 0, 0 }, { 0, 0, 255 }, { 0, 255, 0 }, { 255, 255, 0 },
+    { 255, 0, 255 }, { 0, 255, 255 }, { 255, 128, 0 }, { 128, 128, 128 }
+};
+
+static const uint16_t s_lab3Indices[] = {
+    0, 1, 2, 0, 2, 3,
+    4, 6, 5, 4, 7, 6,
+    0, 4, 5, 0, 5, 1,
+    3, 2, 6, 3, 6, 7,
+    0, 3, 7, 0, 7, 4,
+    1, 5, 6, 1, 6, 2
+};
+
+const SceneColorMesh& GetLab3CubeMesh()
+{
+    static const SceneColorMesh s_mesh = {
+        s_lab3Positions, s_lab3Colors, 8,
+        s_lab3Indices, (uint32_t)(sizeof(s_lab3Indices) / sizeof(s_lab3Indices[0]))
+    };
+    return s_mesh;
+}
+
+void GetLabClearColor(SoftwareLab lab, float rgba[4])
+{
+    static const float s_clearColors[3][4] = {
+        { 0.25f, 0.25f, 0.3f, 1.0f },
+        { 0.25f, 0.25f, 0.25f, 1.0f },
+        { 0.1f, 0.1f, 0.2f, 1.0f }
+    };
+    memcpy(rgba, s_clearColors[lab], sizeof(s_clearColors[lab]));
+}
+
+float GetLabCubeYaw(double time)
+{
+    return (float)time * 0.8f;
+}
+
+// Same as lab5's SetOrbitTransform: Translation(t) * RotationY(yaw) as a
+// scale/rotation/translation transform.
+static void SetOrbitTransform(SceneTransforms& scene, size_t index, float x, float y, float z, float yaw)
+{
+    float c = std::cos(yaw);
+    float s = std::sin(yaw);
+    scene.SetPosition(index, x * c + z * s, y, z * c - x * s);
+    scene.SetRotationYaw(index, yaw);
+}
+
+void SetLab5TransparentCubes(SceneTransforms& transparent, double time)
+{
+    // The two cubes orbit the centre one at this radius.
+    const float radius = 2.5f;
+    const float pi = 3.14159265f;
+    const float angle1 = (float)time * 0.5f;
+    const float angle2 = (float)time * 0.3f;
+    SetOrbitTransform(transparent, 0, radius * std::cos(angle1), 0.0f, radius * std::sin(angle1), angle1 * 0.5f);
+    SetOrbitTransform(transparent, 1, radius * std::cos(angle2 + pi), 0.5f, radius * std::sin(angle2 + pi), angle2 * 0.7f);
+    transparent.SetTint(0, 1.0f, 0.2f, 0.2f, 0.55f);
+    transparent.SetTint(1, 0.0f, 0.5f, 1.0f, 0.6f);
+}
+
+LabScene::LabScene()
+    : m_selected(NO_CUBE), m_time(0.0)
+{
+    SetCubeCount(1);
+}
+
+void LabScene::SetCubeCount(uint32_t count)
+{
+    if (count == 0)
+        count = 1;
+    SelectCube(NO_CUBE);
+    m_instances.Resize(count);
+
+    uint32_t extra = count - 1;
+    uint32_t side = (uint32_t)ceil(sqrt((double)extra));
+    const float spacing = 0.6f;
+    float origin = -0.5f * spacing * (float)(side > 0 ? side - 1 : 0);
+
+    for (uint32_t i = 0; i < extra; ++i)
+    {
+        float x = origin + spacing * (float)(i % side);
+        float z = origin + spacing * (float)(i / side);
+        m_instances.SetPosition(i + 1, x, -2.0f, z);
+        m_instances.SetScale(i + 1, 0.25f);
+    }
+
+    // The cube mesh's corners are the farthest points from its centre.
+    const SceneMesh& cube = GetCubeMesh();
+    float radiusSq = 0.0f;
+    for (uint32_t v = 0; v < cube.vertexCount; ++v)
+    {
+        const float* p = cube.pVertices[v].pos;
+        radiusSq = std::max(radiusSq, p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    }
+    ComputeBoundingSpheres(m_instances, std::sqrt(radiusSq), m_bounds);
+    m_bvh.Build(m_bounds);
+}
+
+void LabScene::Update(double time, float deltaTime, const CameraInput& input, JobSystem* pJobs)
+{
+    m_time = time;
+
+    // The camera does not depend on the cubes, so it moves while they spin.
+    Job* pCameraJob = nullptr;
+    if (pJobs)
+    {
+        pCameraJob = pJobs->CreateJob([this, deltaTime, &input]() {
+            m_camera.Update(deltaTime, input.left, input.right, input.up, input.down);
+        });
+        pJobs->Run(pCameraJob);
+    }
+    else
+    {
+        m_camera.Update(deltaTime, input.left, input.right, input.up, input.down);
+    }
+
+    const float angle = (float)time * 0.5f;
+    ParallelFor(pJobs, (uint32_t)m_instances.Size(), SCENE_GRAIN, [this, angle](uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; ++i)
+            m_instances.SetRotationYaw(i, angle + (float)i * 0.1f);
+    });
+
+    if (pCameraJob)
+        pJobs->Wait(pCameraJob);
+}
+
+void LabScene::BuildVisibleInstances(const Float4x4& viewProj, std::vector<uint32_t>& visible, InstanceBatcher& out,
+    TransformKernel kernel, OcclusionCuller* pOcclusion, JobSystem* pJobs) const
+{
+    // Chunks are culled in place and joined afterwards; the list comes out
+    // in scene order however it was split.
+    const FrustumPlanes planes = ExtractFrustumPlanes(viewProj);
+    const size_t count = m_bounds.Size();
+    uint32_t chunkCounts[MAX_CULL_CHUNKS];
+    uint32_t grain = GetCullGrain(count);
+    visible.resize(count);
+    uint32_t* pVisible = visible.data();
+    ParallelFor(pJobs, (uint32_t)count, grain, [&](uint32_t first, uint32_t n) {
+        chunkCounts[first / grain] = (uint32_t)CullSphereRange(planes, m_bounds, first, n, pVisible + first, kernel);
+    });
+    visible.resize(JoinChunks(pVisible, count, grain, chunkCounts));
+
+    // Instance 0 is the unit cube itself, so its world matrix places the
+    // occluder box exactly. Only worth it when it has something to hide.
+    if (pOcclusion && visible.size() > 1)
+    {
+        InstanceData occluder;
+        ComputeInstanceData(m_instances, 0, 1, &occluder, kernel);
+        pOcclusion->BeginFrame(viewProj, kernel);
+        pOcclusion->AddOccluderBox(occluder.world);
+        pOcclusion->BuildHierarchy();
+
+        const size_t inFrustum = visible.size();
+        grain = GetCullGrain(inFrustum);
+        ParallelFor(pJobs, (uint32_t)inFrustum, grain, [&](uint32_t first, uint32_t n) {
+            chunkCounts[first / grain] = (uint32_t)pOcclusion->CullSpheres(m_bounds, pVisible + first, n);
+        });
+        visible.resize(JoinChunks(pVisible, inFrustum, grain, chunkCounts));
+    }
+    out.Build(m_instances, visible.data(), visible.size(), kernel, pJobs);
+}
+
+uint32_t LabScene::PickCube(float ndcX, float ndcY, float aspect) const
+{
+    // The ray through the point in view space has z = 1, so its length
+    // along the ray is view depth. The view matrix's columns are the
+    // camera axes in world space.
+    const Float4x4 view = m_camera.GetViewMatrix();
+    const float tanHalfFov = std::tan(0.5f * FOV_Y);
+    const float viewDirection[3] = { ndcX * tanHalfFov * aspect, ndcY * tanHalfFov, 1.0f };
+    float direction[3];
+    for (int r = 0; r < 3; ++r)
+    {
+        direction[r] = view.m[r][0] * viewDirection[0] + view.m[r][1] * viewDirection[1] +
+            view.m[r][2] * viewDirection[2];
+    }
+
+    float eye[3];
+    m_camera.GetEyePosition(eye);
+    BvhRayHit hit;
+    if (!m_bvh.Raycast(eye, direction, FAR_Z, m_bounds, hit))
+        return NO_CUBE;
+    return hit.index;
+}
+
+void LabScene::SelectCube(uint32_t index)
+{
+    if (m_selected < m_instances.Size())
+        m_instances.SetTint(m_selected, 1.0f, 1.0f, 1.0f, 1.0f);
+
+    m_selected = NO_CUBE;
+    if (index < m_instances.Size())
+    {
+        m_selected = index;
+        m_instances.SetTint(index, 1.0f, 0.6f, 0.2f, 1.0f);
+    }
+}
+
+void LabScene::ComputeMatrices(float aspect, SceneMatrices& out) const
+{
+    out.view = m_camera.GetViewMatrix();
+    out.proj = MatrixPerspectiveFovLH(FOV_Y, aspect, NEAR_Z, FAR_Z);
+    out.viewProj = MatrixMultiply(out.view, out.proj);
+    out.skyViewProj = MatrixMultiply(m_camera.GetViewNoTranslationMatrix(), out.proj);
+    m_camera.GetEyePosition(out.eye);
+}
+
+Float4x4 ComputeLab3ViewProj(const LabScene& scene, float aspect)
+{
+    return MatrixMultiply(scene.GetCamera().GetViewMatrix(),
+        MatrixPerspectiveFovLH(3.14159265f / 4.0f, aspect, 0.1f, 100.0f));
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "Camera.h"
+#include "FrustumCull.h"
+#include "InstanceBatch.h"
+#include "OcclusionCull.h"
+#include "SceneBvh.h"
+
+class JobSystem;
+
+// Vertex layout shared by every backend; matches TexturedVertex.
+struct SceneVertex
+{
+    float pos[3];
+    float uv[2];
+};
+
+struct SceneMesh
+{
+    const SceneVertex* pVertices;
+    uint32_t vertexCount;
+    const uint16_t* pIndices;
+    uint32_t indexCount;
+};
+
+const SceneMesh& GetCubeMesh();
+const SceneMesh& GetSkyboxMesh();
+
+// lab3's cube: eight shared corners, one RGB colour each.
+struct SceneColorMesh
+{
+    const float (*pPositions)[3];
+    const uint8_t (*pColors)[3];
+    uint32_t vertexCount;
+    const uint16_t* pIndices;
+    uint32_t indexCount;
+};
+
+const SceneColorMesh& GetLab3CubeMesh();
+
+// Which lab's frame the CPU renderers draw. All three use the LabScene's
+// camera and clock; the lab3 and lab5 objects are rebuilt from the time.
+enum SoftwareLab
+{
+    SOFTWARE_LAB3,      // one vertex-coloured cube, no depth buffer
+    SOFTWARE_LAB4,      // skybox plus the scene's textured cube instances
+    SOFTWARE_LAB5       // skybox, textured centre cube, two sorted transparent cubes
+};
+
+// The clear colour each lab's renderer uses.
+void GetLabClearColor(SoftwareLab lab, float rgba[4]);
+
+// Yaw of the lab3 cube and of the lab5 centre cube at time (seconds).
+float GetLabCubeYaw(double time);
+
+// Places lab5's two transparent cubes on their orbits at time and gives
+// them their tints. transparent must hold two objects.
+void SetLab5TransparentCubes(SceneTransforms& transparent, double time);
+
+// Everything a backend needs to draw one frame from the current camera.
+struct SceneMatrices
+{
+    Float4x4 view;
+    Float4x4 proj;
+    Float4x4 viewProj;
+    Float4x4 skyViewProj;   // view without translation, for the skybox
+    float eye[3];
+};
+
+struct CameraInput
+{
+    bool left = false;
+    bool right = false;
+    bool up = false;
+    bool down = false;
+};
+
+// The lab4 scene without any window or device: an orbit camera, the
+// rotating cube and the optional floor of instanced cubes. The windowed
+// renderer drives it from the clock and the arrow keys, the headless runner
+// from a fixed time step and a scripted camera path; any ISceneBackend can
+// then draw it.
+class LabScene
+{
+public:
+    static const float FOV_Y;
+    static const float NEAR_Z;
+    static const float FAR_Z;
+    static const uint32_t NO_CUBE = 0xffffffffu;
+
+    LabScene();
+
+    // Instance 0 is the lab's rotating cube, the rest form a floor grid.
+    void SetCubeCount(uint32_t count);
+    uint32_t GetCubeCount() const { return (uint32_t)m_instances.Size(); }
+
+    // Advances the animation to time (seconds); input moves the camera by
+    // deltaTime. With pJobs the camera and the cubes update as jobs.
+    void Update(double time, float deltaTime, const CameraInput& input, JobSystem* pJobs = nullptr);
+
+    Camera& GetCamera() { return m_camera; }
+    const Camera& GetCamera() const { return m_camera; }
+    double GetTime() const { return m_time; }
+
+    void ComputeMatrices(float aspect, SceneMatrices& out) const;
+    const SceneTransforms& GetTransforms() const { return m_instances; }
+    const BoundingSpheres& GetBounds() const { return m_bounds; }
+
+    // Culls the cubes against viewProj and builds instance data for the
+    // ones left, so nothing outside the view is transformed or drawn.
+    // visible receives their indices in scene order. With pOcclusion the
+    // floor cubes hidden behind the lab's cube are culled as well; it is
+    // used as scratch, one frame at a time. pJobs splits culling and the
+    // instance data into jobs; the results do not change.
+    void BuildVisibleInstances(const Float4x4& viewProj, std::vector<uint32_t>& visible, InstanceBatcher& out,
+        TransformKernel kernel = TRANSFORM_KERNEL_BEST, OcclusionCuller* pOcclusion = nullptr,
+        JobSystem* pJobs = nullptr) const;
+
+    // The cube under a point of the view, ndcX and ndcY from -1 to 1 with
+    // +y up, or NO_CUBE. Cubes are picked by their bounding spheres.
+    uint32_t PickCube(float ndcX, float ndcY, float aspect) const;
+
+    // Tints one cube to mark it, NO_CUBE for none.
+    void SelectCube(uint32_t index);
+    uint32_t GetSelectedCube() const { return m_selected; }
+
+private:
+    Camera m_camera;
+    SceneTransforms m_instances;
+    BoundingSpheres m_bounds;       // the cubes only spin, so these stay put
+    SceneBvh m_bvh;                 // over m_bounds, for picking
+    uint32_t m_selected;
+    double m_time;
+};
+
+// lab3 has its own 45 degree projection around the scene's camera.
+Float4x4 ComputeLab3ViewProj(const LabScene& scene, float aspect);
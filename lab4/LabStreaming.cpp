@@ -0,0 +1,111 @@
+#include "LabStreaming.h"
+#include <cstdio>
+#include <deque>
+
+namespace
+{
+    // Half the diagonal of the unit cube.
+    const float CUBE_BOUNDING_RADIUS = 0.8660254f;
+
+    struct PendingLoad
+    {
+        StreamingRequest request;
+        uint32_t readyFrame;
+    };
+}
+
+void SetLabRequiredMips(TextureStreamingPlanner& planner, const LabStreamingTextures& textures,
+    const LabScene& scene, uint32_t viewportHeight)
+{
+    float eye[3];
+    scene.GetCamera().GetEyePosition(eye);
+
+    // Every cube face maps the whole texture onto one unit.
+    const StreamingTextureDesc& cube = planner.GetDesc(textures.cube);
+    planner.SetRequiredMip(textures.cube, ComputeRequiredMip(scene.GetTransforms(), eye, (float)cube.width,
+        CUBE_BOUNDING_RADIUS, LabScene::FOV_Y, viewportHeight));
+
+    const StreamingTextureDesc& sky = planner.GetDesc(textures.skybox);
+    planner.SetRequiredMip(textures.skybox,
+        ComputeRequiredMip((float)sky.width * 0.5f, 1.0f, LabScene::FOV_Y, viewportHeight));
+}
+
+void RunStreamingReport(LabScene& scene, const CameraPath& path, TextureStreamingPlanner& planner,
+    const LabStreamingTextures& textures, const StreamingReportOptions& options, std::vector<StreamingReportRow>& rows)
+{
+    const CameraInput noInput;
+    std::vector<StreamingRequest> requests;
+    std::deque<PendingLoad> pending;
+
+    rows.clear();
+    rows.reserve(options.frameCount);
+
+    for (uint32_t frame = 0; frame < options.frameCount; ++frame)
+    {
+        StreamingReportRow row;
+        row.frame = frame;
+        row.sceneTime = (double)frame * options.frameTime;
+
+        if (!path.IsEmpty())
+        {
+            float yaw = 0.0f, pitch = 0.0f, distance = 0.0f;
+            path.Evaluate((float)row.sceneTime, yaw, pitch, distance);
+            scene.GetCamera().SetOrbit(yaw, pitch, distance);
+        }
+        scene.Update(row.sceneTime, options.frameTime, noInput);
+
+        while (!pending.empty() && pending.front().readyFrame <= frame)
+        {
+            planner.CompleteLoad(pending.front().request.texture, pending.front().request.mip);
+            pending.pop_front();
+        }
+
+        SetLabRequiredMips(planner, textures, scene, options.viewportHeight);
+        requests.clear();
+        planner.Update(requests);
+        for (const StreamingRequest& request : requests)
+        {
+            PendingLoad load = { request, frame + options.loadLatencyFrames };
+            pending.push_back(load);
+        }
+
+        const uint32_t ids[2] = { textures.cube, textures.skybox };
+        for (int t = 0; t < 2; ++t)
+        {
+            row.requiredMip[t] = planner.GetRequiredMip(ids[t]);
+            row.targetMip[t] = planner.GetTargetMip(ids[t]);
+            row.residentMip[t] = planner.GetResidentMip(ids[t]);
+        }
+        row.stats = planner.GetStats();
+        rows.push_back(row);
+    }
+}
+
+bool WriteStreamingReportCsv(const char* filename, const TextureStreamingPlanner& planner,
+    const std::vector<StreamingReportRow>& rows)
+{
+    FILE* pFile = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&pFile, filename, "w") != 0)
+        return false;
+#else
+    pFile = fopen(filename, "w");
+    if (!pFile)
+        return false;
+#endif
+
+    fprintf(pFile, "frame,scene_time,cube_required,cube_target,cube_resident,"
+        "sky_required,sky_target,sky_resident,resident_bytes,pending_bytes,budget_bytes,loads,evictions\n");
+    for (const StreamingReportRow& r : rows)
+    {
+        fprintf(pFile, "%u,%.4f,%.2f,%u,%u,%.2f,%u,%u,%llu,%llu,%llu,%u,%u\n",
+            r.frame, r.sceneTime,
+            r.requiredMip[0], r.targetMip[0], r.residentMip[0],
+            r.requiredMip[1], r.targetMip[1], r.residentMip[1],
+            (unsigned long long)r.stats.residentBytes, (unsigned long long)r.stats.pendingBytes,
+            (unsigned long long)planner.GetBudget(), r.stats.loads, r.stats.evictions);
+    }
+
+    fclose(pFile);
+    return true;
+}
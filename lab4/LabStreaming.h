@@ -0,0 +1,43 @@
+#pragma once
+#include "CameraPath.h"
+#include "LabScene.h"
+#include "TextureStreaming.h"
+
+// The two streamed textures of the lab scene.
+struct LabStreamingTextures
+{
+    uint32_t cube = 0;      // wood02 on every cube instance
+    uint32_t skybox = 0;    // the six faces as one texture
+};
+
+// Feeds the planner the mips the current camera needs: the cube texture
+// for the nearest instance, the skybox for the field of view.
+void SetLabRequiredMips(TextureStreamingPlanner& planner, const LabStreamingTextures& textures,
+    const LabScene& scene, uint32_t viewportHeight);
+
+struct StreamingReportOptions
+{
+    uint32_t frameCount = 600;
+    float frameTime = 1.0f / 60.0f;
+    uint32_t viewportHeight = 720;
+    uint32_t loadLatencyFrames = 2;     // a request completes this many frames after it is issued
+};
+
+struct StreamingReportRow
+{
+    uint32_t frame = 0;
+    double sceneTime = 0.0;
+    float requiredMip[2] = {};          // cube, skybox
+    uint32_t targetMip[2] = {};
+    uint32_t residentMip[2] = {};
+    StreamingStats stats;
+};
+
+// Drives scene along path without any device and records, per frame,
+// which mips the planner keeps resident. Loads are simulated with a fixed
+// latency, so the report shows refinement and eviction over time.
+void RunStreamingReport(LabScene& scene, const CameraPath& path, TextureStreamingPlanner& planner,
+    const LabStreamingTextures& textures, const StreamingReportOptions& options, std::vector<StreamingReportRow>& rows);
+
+bool WriteStreamingReportCsv(const char* filename, const TextureStreamingPlanner& planner,
+    const std::vector<StreamingReportRow>& rows);
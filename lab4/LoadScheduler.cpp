@@ -0,0 +1,67 @@
+#include "LoadScheduler.h"
+#include <algorithm>
+
+LoadScheduler::LoadScheduler(unsigned workerCount)
+    : m_busy(0), m_stop(false)
+{
+    if (workerCount == 0)
+        workerCount = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+
+    m_workers.reserve(workerCount);
+    for (unsigned i = 0; i < workerCount; ++i)
+        m_workers.emplace_back(&LoadScheduler::WorkerMain, this);
+}
+
+LoadScheduler::~LoadScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+void LoadScheduler::Enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobAvailable.notify_one();
+}
+
+void LoadScheduler::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_jobs.empty() && m_busy == 0; });
+}
+
+void LoadScheduler::WorkerMain()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty())
+                return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            ++m_busy;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busy;
+            if (m_jobs.empty() && m_busy == 0)
+                m_idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool for asset I/O. Jobs run in submission order
+// on whichever worker is free; results come back through std::future so the
+// caller can keep initialising other resources and only block when it
+// actually needs the data.
+class LoadScheduler
+{
+public:
+    explicit LoadScheduler(unsigned workerCount = 0);
+    ~LoadScheduler();
+
+    LoadScheduler(const LoadScheduler&) = delete;
+    LoadScheduler& operator=(const LoadScheduler&) = delete;
+
+    template<typename F>
+    auto Submit(F&& fn) -> std::future<decltype(fn())>
+    {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> result = task->get_future();
+        Enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    void WaitIdle();
+    unsigned GetWorkerCount() const { return (unsigned)m_workers.size(); }
+
+private:
+    void Enqueue(std::function<void()> job);
+    void WorkerMain();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_idle;
+    unsigned m_busy;
+    bool m_stop;
+};
+
+// Calls fn(first, count) over chunks covering [0, total). The scheduler's
+// workers and the calling thread pull chunks off a shared counter until none
+// are left; the call returns once every chunk is done, without waiting for
+// helpers that were still queued behind other jobs, so it is safe from
+// inside a job and never stalls behind I/O. Without workers fn sees the
+// whole range at once.
+template<typename F>
+void ParallelForChunks(LoadScheduler* pScheduler, uint32_t total, F fn)
+{
+    const unsigned workerCount = pScheduler ? pScheduler->GetWorkerCount() : 0;
+    if (workerCount == 0 || total < 2)
+    {
+        if (total != 0)
+            fn(0u, total);
+        return;
+    }
+
+    struct State
+    {
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto pState = std::make_shared<State>();
+    auto pFn = std::make_shared<F>(std::move(fn));
+
+    // A few chunks per thread keeps everyone busy until the end.
+    const uint32_t threadCount = workerCount + 1;
+    const uint32_t chunk = total / (threadCount * 4) > 0 ? total / (threadCount * 4) : 1;
+    auto run = [pState, pFn, total, chunk]()
+    {
+        for (;;)
+        {
+            uint32_t first = pState->next.fetch_add(chunk);
+            if (first >= total)
+                break;
+            uint32_t count = total - first < chunk ? total - first : chunk;
+            (*pFn)(first, count);
+            if (pState->done.fetch_add(count) + count == total)
+            {
+                std::lock_guard<std::mutex> lock(pState->mutex);
+                pState->finished.notify_all();
+            }
+        }
+    };
+
+    for (unsigned i = 0; i < workerCount; ++i)
+        pScheduler->Submit(run);
+
+    run();
+    std::unique_lock<std::mutex> lock(pState->mutex);
+    pState->finished.wait(lock, [&]() { return pState->done.load() == total; });
+}
@@ -0,0 +1,203 @@
+#include "MappedFile.h"
+#include <cwchar>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_pData(nullptr), m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+static const uint8_t* MapFile(HANDLE hFile, size_t& size)
+{
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+        return nullptr;
+
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping)
+        return nullptr;
+
+    // The view keeps the mapping object alive, so the handle can go right away.
+    void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (!pView)
+        return nullptr;
+
+    size = (size_t)fileSize.QuadPart;
+    return (const uint8_t*)pView;
+}
+
+bool MappedFile::Open(const wchar_t* filename, bool readAhead)
+{
+    Close();
+
+    HANDLE hFile = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | (readAhead ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS), NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    m_pData = MapFile(hFile, m_size);
+    CloseHandle(hFile);
+    return m_pData != nullptr;
+}
+
+bool MappedFile::Open(const char* filename, bool readAhead)
+{
+    Close();
+
+    HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | (readAhead ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS), NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    m_pData = MapFile(hFile, m_size);
+    CloseHandle(hFile);
+    return m_pData != nullptr;
+}
+
+void MappedFile::Close()
+{
+    if (m_pData)
+        UnmapViewOfFile(m_pData);
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+void MappedFile::ReadAhead(const uint8_t* pData, size_t size)
+{
+    (void)pData;
+    (void)size;
+}
+
+bool MappedFile::EvictFromPageCache(const char* filename)
+{
+    (void)filename;
+    return false;
+}
+
+bool MappedFile::GetResidentBytes(const uint8_t* pData, size_t size, size_t& resident)
+{
+    (void)pData;
+    (void)size;
+    resident = 0;
+    return false;
+}
+
+#else
+
+bool MappedFile::Open(const wchar_t* filename, bool readAhead)
+{
+    std::mbstate_t state = {};
+    const wchar_t* src = filename;
+    size_t len = std::wcsrtombs(nullptr, &src, 0, &state);
+    if (len == (size_t)-1)
+        return false;
+
+    std::string narrow(len, '\0');
+    src = filename;
+    std::wcsrtombs(&narrow[0], &src, len, &state);
+    return Open(narrow.c_str(), readAhead);
+}
+
+bool MappedFile::Open(const char* filename, bool readAhead)
+{
+    Close();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* pView = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pView == MAP_FAILED)
+        return false;
+    if (!readAhead)
+        madvise(pView, (size_t)st.st_size, MADV_RANDOM);
+
+    m_pData = (const uint8_t*)pView;
+    m_size = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_pData)
+        munmap((void*)m_pData, m_size);
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+void MappedFile::ReadAhead(const uint8_t* pData, size_t size)
+{
+    if (size == 0)
+        return;
+
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (uintptr_t)pData & ~(uintptr_t)(pageSize - 1);
+    madvise((void*)begin, (uintptr_t)pData + size - begin, MADV_WILLNEED);
+}
+
+bool MappedFile::EvictFromPageCache(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    // Dirty pages, such as a freshly written file's, are not dropped.
+    fdatasync(fd);
+    const bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+}
+
+bool MappedFile::GetResidentBytes(const uint8_t* pData, size_t size, size_t& resident)
+{
+    resident = 0;
+    if (size == 0)
+        return true;
+
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (uintptr_t)pData & ~(uintptr_t)(pageSize - 1);
+    const uintptr_t end = (uintptr_t)pData + size;
+    std::vector<unsigned char> pages((end - begin + pageSize - 1) / pageSize);
+    if (mincore((void*)begin, end - begin, pages.data()) != 0)
+        return false;
+
+    // Partial pages at either end count only the bytes inside the range.
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        if (!(pages[i] & 1))
+            continue;
+        const uintptr_t pageBegin = begin + i * pageSize;
+        const uintptr_t from = pageBegin > (uintptr_t)pData ? pageBegin : (uintptr_t)pData;
+        const uintptr_t to = pageBegin + pageSize < end ? pageBegin + pageSize : end;
+        resident += to - from;
+    }
+    return true;
+}
+
+#endif
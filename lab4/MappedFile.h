@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Read-only mapping of a whole file. DdsView and AssetArchive hold one
+// through a shared_ptr so every texture taken out of an archive keeps the
+// single mapping alive.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Empty files fail: there is nothing to map. With readAhead off, a page
+    // fault reads just that page instead of the pages around it too, for
+    // files only parts of which will be used; ReadAhead() then asks for
+    // those parts.
+    bool Open(const wchar_t* filename, bool readAhead = true);
+    bool Open(const char* filename, bool readAhead = true);
+    void Close();
+
+    // Starts reading pData..pData + size, which must point into a mapping,
+    // in the background. Does nothing on Windows.
+    static void ReadAhead(const uint8_t* pData, size_t size);
+
+    // Drops filename's pages from the page cache so the next read goes to
+    // disk. Needs posix_fadvise; always false on Windows.
+    static bool EvictFromPageCache(const char* filename);
+
+    // Bytes of the pages in pData..pData + size that are in memory, which
+    // after EvictFromPageCache() is what has been read since. pData must
+    // point into a mapping. Needs mincore; always false on Windows.
+    static bool GetResidentBytes(const uint8_t* pData, size_t size, size_t& resident);
+
+    bool IsOpen() const { return m_pData != nullptr; }
+    const uint8_t* GetData() const { return m_pData; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    const uint8_t* m_pData;
+    size_t m_size;
+};
@@ -0,0 +1,626 @@
+#include "OcclusionCull.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define OCCLUSION_SSE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define OCCLUSION_AVX2 1
+#define OCCLUSION_TARGET_AVX2
+#elif defined(__GNUC__)
+#define OCCLUSION_AVX2 1
+#define OCCLUSION_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    // Corner i of the unit box is at -0.5 or +0.5 on x, y and z by bits 0,
+    // 1 and 2; two clockwise triangles per face.
+    const uint16_t s_boxIndices[36] = {
+        0, 3, 1, 0, 2, 3,   // -z
+        4, 5, 7, 4, 7, 6,   // +z
+        4, 2, 0, 4, 6, 2,   // -x
+        1, 7, 5, 1, 3, 7,   // +x
+        2, 7, 3, 2, 6, 7,   // +y
+        4, 1, 5, 4, 0, 1,   // -y
+    };
+
+    struct BoxVertices
+    {
+        float pos[8][3];
+
+        BoxVertices()
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                pos[i][0] = (i & 1) ? 0.5f : -0.5f;
+                pos[i][1] = (i & 2) ? 0.5f : -0.5f;
+                pos[i][2] = (i & 4) ? 0.5f : -0.5f;
+            }
+        }
+    };
+    const BoxVertices s_box;
+
+    // Edge i is A * x + B * y + C, positive inside; depth is the plane
+    // zA * x + zB * y + zC, already pushed to its farthest point within a
+    // pixel. The pixel rectangle is inclusive.
+    struct TriangleSetup
+    {
+        float a[3], b[3], c[3];
+        float zA, zB, zC;
+        int x0, x1, y0, y1;
+    };
+
+    // Every kernel evaluates A * px + (B * py + C) at pixel centres, so they
+    // all cover the same pixels with the same depths.
+    void FillScalar(const TriangleSetup& t, float* pDepth, uint32_t width)
+    {
+        for (int y = t.y0; y <= t.y1; ++y)
+        {
+            const float py = (float)y + 0.5f;
+            const float row0 = t.b[0] * py + t.c[0];
+            const float row1 = t.b[1] * py + t.c[1];
+            const float row2 = t.b[2] * py + t.c[2];
+            const float rowZ = t.zB * py + t.zC;
+            float* pRow = pDepth + (size_t)y * width;
+            for (int x = t.x0; x <= t.x1; ++x)
+            {
+                const float px = (float)x + 0.5f;
+                const bool covered = t.a[0] * px + row0 >= 0.0f && t.a[1] * px + row1 >= 0.0f &&
+                    t.a[2] * px + row2 >= 0.0f;
+                const float z = t.zA * px + rowZ;
+                if (covered && z < pRow[x])
+                    pRow[x] = z;
+            }
+        }
+    }
+
+#ifdef OCCLUSION_SSE
+    void FillSse(const TriangleSetup& t, float* pDepth, uint32_t width)
+    {
+        const __m128 a0 = _mm_set1_ps(t.a[0]), a1 = _mm_set1_ps(t.a[1]), a2 = _mm_set1_ps(t.a[2]);
+        const __m128 zA = _mm_set1_ps(t.zA);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 laneCentres = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 first = _mm_set1_ps((float)t.x0 + 0.5f);
+        const __m128 last = _mm_set1_ps((float)t.x1 + 0.5f);
+        const int start = t.x0 & ~3;
+
+        for (int y = t.y0; y <= t.y1; ++y)
+        {
+            const float py = (float)y + 0.5f;
+            const __m128 row0 = _mm_set1_ps(t.b[0] * py + t.c[0]);
+            const __m128 row1 = _mm_set1_ps(t.b[1] * py + t.c[1]);
+            const __m128 row2 = _mm_set1_ps(t.b[2] * py + t.c[2]);
+            const __m128 rowZ = _mm_set1_ps(t.zB * py + t.zC);
+            float* pRow = pDepth + (size_t)y * width;
+            for (int x = start; x <= t.x1; x += 4)
+            {
+                const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneCentres);
+                __m128 covered = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+                covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero));
+                covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero));
+                covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero));
+                if (_mm_movemask_ps(covered) == 0)
+                    continue;
+
+                const __m128 z = _mm_add_ps(_mm_mul_ps(zA, px), rowZ);
+                const __m128 depth = _mm_loadu_ps(pRow + x);
+                const __m128 nearer = _mm_min_ps(depth, z);
+                _mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(covered, nearer), _mm_andnot_ps(covered, depth)));
+            }
+        }
+    }
+#endif
+
+#ifdef OCCLUSION_AVX2
+    OCCLUSION_TARGET_AVX2
+    void FillAvx2(const TriangleSetup& t, float* pDepth, uint32_t width)
+    {
+        const __m256 a0 = _mm256_set1_ps(t.a[0]), a1 = _mm256_set1_ps(t.a[1]), a2 = _mm256_set1_ps(t.a[2]);
+        const __m256 zA = _mm256_set1_ps(t.zA);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 laneCentres = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 first = _mm256_set1_ps((float)t.x0 + 0.5f);
+        const __m256 last = _mm256_set1_ps((float)t.x1 + 0.5f);
+        const int start = t.x0 & ~7;
+
+        for (int y = t.y0; y <= t.y1; ++y)
+        {
+            const float py = (float)y + 0.5f;
+            const __m256 row0 = _mm256_set1_ps(t.b[0] * py + t.c[0]);
+            const __m256 row1 = _mm256_set1_ps(t.b[1] * py + t.c[1]);
+            const __m256 row2 = _mm256_set1_ps(t.b[2] * py + t.c[2]);
+            const __m256 rowZ = _mm256_set1_ps(t.zB * py + t.zC);
+            float* pRow = pDepth + (size_t)y * width;
+            for (int x = start; x <= t.x1; x += 8)
+            {
+                const __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), laneCentres);
+                __m256 covered = _mm256_and_ps(_mm256_cmp_ps(px, first, _CMP_GE_OQ), _mm256_cmp_ps(px, last, _CMP_LE_OQ));
+                covered = _mm256_and_ps(covered,
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a0, px), row0), zero, _CMP_GE_OQ));
+                covered = _mm256_and_ps(covered,
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a1, px), row1), zero, _CMP_GE_OQ));
+                covered = _mm256_and_ps(covered,
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a2, px), row2), zero, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(covered) == 0)
+                    continue;
+
+                const __m256 z = _mm256_add_ps(_mm256_mul_ps(zA, px), rowZ);
+                const __m256 depth = _mm256_loadu_ps(pRow + x);
+                _mm256_storeu_ps(pRow + x, _mm256_blendv_ps(depth, _mm256_min_ps(depth, z), covered));
+            }
+        }
+    }
+#endif
+
+    // The point where the edge a-b crosses z = 0.
+    void ClipEdge(const float* a, const float* b, float* out)
+    {
+        const float t = a[2] / (a[2] - b[2]);
+        for (int k = 0; k < 4; ++k)
+            out[k] = a[k] + t * (b[k] - a[k]);
+    }
+
+    // Clips a triangle to the near plane; what is left is a triangle or a
+    // quad in the same winding, or nothing. Bit k of outline marks the edge
+    // from corner k to the next as on the occluder's outline, and bit k of
+    // polygonOutline the same for the polygon, where the edge the near
+    // plane cut is on the outline too.
+    int ClipTriangle(const float* const v[3], uint32_t outline, float polygon[4][4], uint32_t& polygonOutline)
+    {
+        int count = 0;
+        polygonOutline = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const float* a = v[k];
+            const float* b = v[(k + 1) % 3];
+            const uint32_t edge = (outline >> k) & 1;
+            if (a[2] >= 0.0f)
+            {
+                std::copy(a, a + 4, polygon[count]);
+                polygonOutline |= edge << count;
+                ++count;
+            }
+            if ((a[2] >= 0.0f) != (b[2] >= 0.0f))
+            {
+                ClipEdge(a, b, polygon[count]);
+                polygonOutline |= (a[2] >= 0.0f ? 1u : edge) << count;
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // DrawTriangle's winding test, for corners in front of the near plane.
+    bool IsClockwise(const float* v0, const float* v1, const float* v2)
+    {
+        const float x0 = v0[0] / v0[3], y0 = -v0[1] / v0[3];
+        const float x1 = v1[0] / v1[3], y1 = -v1[1] / v1[3];
+        const float x2 = v2[0] / v2[3], y2 = -v2[1] / v2[3];
+        return (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0) > 0.0f;
+    }
+
+    // floor() for v >= -1, without the library call.
+    int FloorFromMinusOne(float v)
+    {
+        return (int)(v + 1.0f) - 1;
+    }
+
+    // Narrows [t0, t1] to where start + t * delta is within [low, high];
+    // false if nothing is left.
+    bool ClipToRange(float start, float delta, float low, float high, float& t0, float& t1)
+    {
+        if (delta == 0.0f)
+            return start >= low && start <= high;
+        float enter = (low - start) / delta;
+        float exit = (high - start) / delta;
+        if (enter > exit)
+            std::swap(enter, exit);
+        t0 = std::max(t0, enter);
+        t1 = std::min(t1, exit);
+        return t0 <= t1;
+    }
+
+    // Appends a run of pixels per row for every pixel whose square the
+    // segment a-b touches, corners in clip space in front of the near
+    // plane. Generous by a hair at pixel borders, which only ever keeps an
+    // object.
+    template<typename Span>
+    void AddSegmentSpans(const float* a, const float* b, uint32_t width, uint32_t height, std::vector<Span>& spans)
+    {
+        float ax = (a[0] / a[3] * 0.5f + 0.5f) * (float)width;
+        float ay = (0.5f - a[1] / a[3] * 0.5f) * (float)height;
+        float bx = (b[0] / b[3] * 0.5f + 0.5f) * (float)width;
+        float by = (0.5f - b[1] / b[3] * 0.5f) * (float)height;
+        const float slack = 1e-3f;
+
+        // Only the part within a pixel of the screen matters; an edge near
+        // the eye can reach far past it.
+        float tStart = 0.0f, tEnd = 1.0f;
+        if (!ClipToRange(ax, bx - ax, -1.0f, (float)width + 1.0f, tStart, tEnd) ||
+            !ClipToRange(ay, by - ay, -1.0f, (float)height + 1.0f, tStart, tEnd))
+            return;
+        const float dx = bx - ax, dy = by - ay;
+        bx = ax + tEnd * dx;
+        by = ay + tEnd * dy;
+        ax += tStart * dx;
+        ay += tStart * dy;
+
+        const float minY = std::min(ay, by), maxY = std::max(ay, by);
+        const float dxdy = maxY > minY ? (bx - ax) / (by - ay) : 0.0f;
+        const int y0 = std::max(0, FloorFromMinusOne(std::max(minY - slack, -1.0f)));
+        const int y1 = std::min((int)height - 1, FloorFromMinusOne(std::max(std::min(maxY + slack, (float)height), -1.0f)));
+        for (int y = y0; y <= y1; ++y)
+        {
+            // The part of the segment within this row of pixels.
+            float x0 = ax, x1 = bx;
+            if (maxY > minY)
+            {
+                x0 = ax + (std::max((float)y, minY) - ay) * dxdy;
+                x1 = ax + (std::min((float)y + 1.0f, maxY) - ay) * dxdy;
+            }
+            const int first = std::max(0, FloorFromMinusOne(std::max(std::min(x0, x1) - slack, -1.0f)));
+            const int last = std::min((int)width - 1,
+                FloorFromMinusOne(std::max(std::min(std::max(x0, x1) + slack, (float)width), -1.0f)));
+            if (first <= last)
+                spans.push_back(Span{ (uint32_t)y * width + (uint32_t)first, (uint32_t)(last - first + 1) });
+        }
+    }
+
+    uint32_t GetEdgeKey(uint16_t a, uint16_t b)
+    {
+        return a < b ? ((uint32_t)a << 16) | b : ((uint32_t)b << 16) | a;
+    }
+
+    struct ScreenBounds
+    {
+        float minX, minY, maxX, maxY;
+        float minZ;
+    };
+
+    // Pixel rectangle and nearest depth of the box around a sphere, or
+    // false if the box reaches round the eye and no rectangle bounds it.
+    bool ProjectSphereBox(const Float4x4& m, float x, float y, float z, float radius, float width, float height,
+        ScreenBounds& out)
+    {
+#ifdef OCCLUSION_SSE
+        // Corners 0-3 at -radius on z and 4-7 at +radius, x and y signs
+        // alternating as in the box indices.
+        const __m128 signX = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+        const __m128 signY = _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+        __m128 back[4], front[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            const float centre = x * m.m[0][c] + y * m.m[1][c] + z * m.m[2][c] + m.m[3][c];
+            const __m128 side = _mm_add_ps(_mm_add_ps(_mm_set1_ps(centre),
+                _mm_mul_ps(signX, _mm_set1_ps(radius * m.m[0][c]))), _mm_mul_ps(signY, _mm_set1_ps(radius * m.m[1][c])));
+            const __m128 dz = _mm_set1_ps(radius * m.m[2][c]);
+            back[c] = _mm_sub_ps(side, dz);
+            front[c] = _mm_add_ps(side, dz);
+        }
+
+        const __m128 minW = _mm_set1_ps(1e-6f);
+        if (_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(back[3], minW), _mm_cmpgt_ps(front[3], minW))) != 0xf)
+            return false;
+
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 w = _mm_set1_ps(width);
+        const __m128 h = _mm_set1_ps(height);
+        const __m128 invBack = _mm_div_ps(one, back[3]);
+        const __m128 invFront = _mm_div_ps(one, front[3]);
+        const __m128 xBack = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(back[0], invBack), half), half), w);
+        const __m128 xFront = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(front[0], invFront), half), half), w);
+        const __m128 yBack = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(_mm_mul_ps(back[1], invBack), half)), h);
+        const __m128 yFront = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(_mm_mul_ps(front[1], invFront), half)), h);
+        const __m128 zNear = _mm_min_ps(_mm_mul_ps(back[2], invBack), _mm_mul_ps(front[2], invFront));
+
+        // Horizontal min and max of four lanes.
+        struct Lanes
+        {
+            static float Min(__m128 v)
+            {
+                v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+                return _mm_cvtss_f32(_mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+            }
+            static float Max(__m128 v)
+            {
+                v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+                return _mm_cvtss_f32(_mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+            }
+        };
+        out.minX = Lanes::Min(_mm_min_ps(xBack, xFront));
+        out.maxX = Lanes::Max(_mm_max_ps(xBack, xFront));
+        out.minY = Lanes::Min(_mm_min_ps(yBack, yFront));
+        out.maxY = Lanes::Max(_mm_max_ps(yBack, yFront));
+        out.minZ = Lanes::Min(zNear);
+        return true;
+#else
+        out.minX = out.minY = out.minZ = std::numeric_limits<float>::max();
+        out.maxX = out.maxY = -out.minX;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const float p[3] = {
+                x + ((corner & 1) ? radius : -radius),
+                y + ((corner & 2) ? radius : -radius),
+                z + ((corner & 4) ? radius : -radius)
+            };
+            float clip[4];
+            for (int c = 0; c < 4; ++c)
+                clip[c] = p[0] * m.m[0][c] + p[1] * m.m[1][c] + p[2] * m.m[2][c] + m.m[3][c];
+            if (!(clip[3] > 1e-6f))
+                return false;
+
+            const float invW = 1.0f / clip[3];
+            const float sx = (clip[0] * invW * 0.5f + 0.5f) * width;
+            const float sy = (0.5f - clip[1] * invW * 0.5f) * height;
+            out.minX = std::min(out.minX, sx);
+            out.maxX = std::max(out.maxX, sx);
+            out.minY = std::min(out.minY, sy);
+            out.maxY = std::max(out.maxY, sy);
+            out.minZ = std::min(out.minZ, clip[2] * invW);
+        }
+        return true;
+#endif
+    }
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+    : m_width(std::max(8u, (width + 7) & ~7u)), m_height(std::max(1u, height)), m_levelCount(0),
+    m_viewProj(MatrixIdentity()), m_kernel(TRANSFORM_KERNEL_SCALAR), m_triangles(0)
+{
+    size_t offset = 0;
+    uint32_t w = m_width, h = m_height;
+    for (;;)
+    {
+        m_levels[m_levelCount].offset = offset;
+        m_levels[m_levelCount].width = w;
+        m_levels[m_levelCount].height = h;
+        ++m_levelCount;
+        offset += (size_t)w * h;
+        if ((w == 1 && h == 1) || m_levelCount == MAX_LEVELS)
+            break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    m_depth.assign(offset, 1.0f);
+}
+
+void OcclusionCuller::BeginFrame(const Float4x4& viewProj, TransformKernel kernel)
+{
+    m_viewProj = viewProj;
+    m_kernel = ResolveTransformKernel(kernel);
+    m_triangles = 0;
+    std::fill(m_depth.begin(), m_depth.begin() + (size_t)m_width * m_height, 1.0f);
+}
+
+void OcclusionCuller::AddOccluder(const float* pPositions, uint32_t stride, uint32_t vertexCount,
+    const uint16_t* pIndices, uint32_t indexCount, const float world[3][4])
+{
+    const Float4x4& m = m_viewProj;
+    m_clip.resize(4 * (size_t)vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        const float* p = (const float*)((const uint8_t*)pPositions + (size_t)v * stride);
+        float w[3];
+        for (int r = 0; r < 3; ++r)
+            w[r] = world[r][0] * p[0] + world[r][1] * p[1] + world[r][2] * p[2] + world[r][3];
+        for (int c = 0; c < 4; ++c)
+            m_clip[4 * v + c] = w[0] * m.m[0][c] + w[1] * m.m[1][c] + w[2] * m.m[2][c] + m.m[3][c];
+    }
+
+    // The triangles that face the eye and every edge they have. An edge
+    // only one of them has is on the occluder's outline.
+    const uint32_t triangleCount = indexCount / 3;
+    float polygon[4][4];
+    uint32_t polygonOutline;
+    m_facing.assign(triangleCount, 0);
+    m_edges.clear();
+    for (uint32_t n = 0; n < triangleCount; ++n)
+    {
+        const uint16_t* pTriangle = pIndices + 3 * n;
+        if (pTriangle[0] >= vertexCount || pTriangle[1] >= vertexCount || pTriangle[2] >= vertexCount)
+            continue;
+        const float* v[3] = { &m_clip[4 * pTriangle[0]], &m_clip[4 * pTriangle[1]], &m_clip[4 * pTriangle[2]] };
+        if (ClipTriangle(v, 0, polygon, polygonOutline) < 3 || !IsClockwise(polygon[0], polygon[1], polygon[2]))
+            continue;
+
+        m_facing[n] = 1;
+        for (int k = 0; k < 3; ++k)
+            m_edges.push_back(GetEdgeKey(pTriangle[k], pTriangle[(k + 1) % 3]));
+    }
+    std::sort(m_edges.begin(), m_edges.end());
+
+    // Pixels the outline passes through are only partly covered, yet the
+    // triangle beside it may cover their centres. Their depths are put back
+    // once the occluder is drawn; two occluders with a gap narrower than a
+    // pixel between them would otherwise close it.
+    m_outlineSpans.clear();
+    for (uint32_t n = 0; n < triangleCount; ++n)
+    {
+        if (!m_facing[n])
+            continue;
+        const uint16_t* pTriangle = pIndices + 3 * n;
+        const float* v[3] = { &m_clip[4 * pTriangle[0]], &m_clip[4 * pTriangle[1]], &m_clip[4 * pTriangle[2]] };
+        uint32_t outline = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t key = GetEdgeKey(pTriangle[k], pTriangle[(k + 1) % 3]);
+            const auto range = std::equal_range(m_edges.begin(), m_edges.end(), key);
+            outline |= (range.second - range.first == 1 ? 1u : 0u) << k;
+        }
+
+        const int count = ClipTriangle(v, outline, polygon, polygonOutline);
+        for (int k = 0; k < count; ++k)
+        {
+            if ((polygonOutline >> k) & 1)
+                AddSegmentSpans(polygon[k], polygon[(k + 1) % count], m_width, m_height, m_outlineSpans);
+        }
+    }
+    m_outlineDepths.clear();
+    for (const OutlineSpan& span : m_outlineSpans)
+        m_outlineDepths.insert(m_outlineDepths.end(), &m_depth[span.first], &m_depth[span.first] + span.count);
+
+    for (uint32_t n = 0; n < triangleCount; ++n)
+    {
+        if (!m_facing[n])
+            continue;
+        const uint16_t* pTriangle = pIndices + 3 * n;
+        const float* v[3] = { &m_clip[4 * pTriangle[0]], &m_clip[4 * pTriangle[1]], &m_clip[4 * pTriangle[2]] };
+        const int count = ClipTriangle(v, 0, polygon, polygonOutline);
+        for (int k = 1; k + 1 < count; ++k)
+            DrawTriangle(polygon[0], polygon[k], polygon[k + 1]);
+    }
+
+    const float* pSaved = m_outlineDepths.data();
+    for (const OutlineSpan& span : m_outlineSpans)
+    {
+        std::copy(pSaved, pSaved + span.count, &m_depth[span.first]);
+        pSaved += span.count;
+    }
+}
+
+void OcclusionCuller::AddOccluderBox(const float world[3][4])
+{
+    AddOccluder(s_box.pos[0], sizeof(s_box.pos[0]), 8, s_boxIndices, 36, world);
+}
+
+void OcclusionCuller::DrawTriangle(const float* v0, const float* v1, const float* v2)
+{
+    // To pixels, y down, depth z / w.
+    const float* v[3] = { v0, v1, v2 };
+    float sx[3], sy[3], sz[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        const float invW = 1.0f / v[k][3];
+        sx[k] = (v[k][0] * invW * 0.5f + 0.5f) * (float)m_width;
+        sy[k] = (0.5f - v[k][1] * invW * 0.5f) * (float)m_height;
+        sz[k] = v[k][2] * invW;
+    }
+
+    // y points down, so clockwise on screen has a positive area.
+    const float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+    if (!(area > 0.0f))
+        return;
+
+    const float minX = std::min(sx[0], std::min(sx[1], sx[2]));
+    const float maxX = std::max(sx[0], std::max(sx[1], sx[2]));
+    const float minY = std::min(sy[0], std::min(sy[1], sy[2]));
+    const float maxY = std::max(sy[0], std::max(sy[1], sy[2]));
+    if (maxX < 0.0f || maxY < 0.0f || minX > (float)m_width || minY > (float)m_height)
+        return;
+
+    TriangleSetup t;
+    t.x0 = std::max(0, (int)std::floor(minX));
+    t.x1 = std::min((int)m_width - 1, (int)std::ceil(maxX));
+    t.y0 = std::max(0, (int)std::floor(minY));
+    t.y1 = std::min((int)m_height - 1, (int)std::ceil(maxY));
+
+    t.zA = t.zB = t.zC = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        const int e0 = (i + 1) % 3;
+        const int e1 = (i + 2) % 3;
+        t.a[i] = -(sy[e1] - sy[e0]);
+        t.b[i] = sx[e1] - sx[e0];
+        t.c[i] = (sy[e1] - sy[e0]) * sx[e0] - (sx[e1] - sx[e0]) * sy[e0];
+        t.zA += t.a[i] * sz[i] / area;
+        t.zB += t.b[i] * sz[i] / area;
+        t.zC += t.c[i] * sz[i] / area;
+    }
+    // The farthest the plane gets within half a pixel of the centre.
+    t.zC += 0.5f * (std::fabs(t.zA) + std::fabs(t.zB));
+
+    ++m_triangles;
+    float* pDepth = m_depth.data();
+    switch (m_kernel)
+    {
+#ifdef OCCLUSION_AVX2
+    case TRANSFORM_KERNEL_AVX2:
+        FillAvx2(t, pDepth, m_width);
+        break;
+#endif
+#ifdef OCCLUSION_SSE
+    case TRANSFORM_KERNEL_SSE:
+        FillSse(t, pDepth, m_width);
+        break;
+#endif
+    default:
+        FillScalar(t, pDepth, m_width);
+        break;
+    }
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+    for (uint32_t l = 1; l < m_levelCount; ++l)
+    {
+        const Level& below = m_levels[l - 1];
+        const Level& level = m_levels[l];
+        const float* pBelow = m_depth.data() + below.offset;
+        float* pLevel = m_depth.data() + level.offset;
+        for (uint32_t y = 0; y < level.height; ++y)
+        {
+            const float* pRow0 = pBelow + (size_t)std::min(2 * y, below.height - 1) * below.width;
+            const float* pRow1 = pBelow + (size_t)std::min(2 * y + 1, below.height - 1) * below.width;
+            for (uint32_t x = 0; x < level.width; ++x)
+            {
+                const uint32_t x0 = std::min(2 * x, below.width - 1);
+                const uint32_t x1 = std::min(2 * x + 1, below.width - 1);
+                pLevel[(size_t)y * level.width + x] =
+                    std::max(std::max(pRow0[x0], pRow0[x1]), std::max(pRow1[x0], pRow1[x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsSphereVisible(float x, float y, float z, float radius) const
+{
+    ScreenBounds bounds;
+    if (!ProjectSphereBox(m_viewProj, x, y, z, radius, (float)m_width, (float)m_height, bounds))
+        return true;
+    const float minX = bounds.minX, maxX = bounds.maxX;
+    const float minY = bounds.minY, maxY = bounds.maxY;
+    const float minZ = bounds.minZ;
+
+    // Off screen is for the frustum test to decide.
+    if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width || minY >= (float)m_height)
+        return true;
+
+    // A pixel of slack on every side, for coverage sampled at pixel centres.
+    const int x0 = std::max(0, (int)std::floor(std::max(minX, -1.0f)) - 1);
+    const int y0 = std::max(0, (int)std::floor(std::max(minY, -1.0f)) - 1);
+    const int x1 = std::min((int)m_width - 1, (int)std::floor(std::min(maxX, (float)m_width)) + 1);
+    const int y1 = std::min((int)m_height - 1, (int)std::floor(std::min(maxY, (float)m_height)) + 1);
+
+    // The finest level where the rectangle spans at most 2x2 texels.
+    uint32_t level = 0;
+    while (level + 1 < m_levelCount && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        ++level;
+
+    const Level& l = m_levels[level];
+    const float* pDepth = m_depth.data() + l.offset;
+    float farthest = 0.0f;
+    for (int ty = y0 >> level; ty <= (y1 >> level); ++ty)
+    {
+        for (int tx = x0 >> level; tx <= (x1 >> level); ++tx)
+            farthest = std::max(farthest, pDepth[(size_t)ty * l.width + tx]);
+    }
+    return minZ <= farthest;
+}
+
+size_t OcclusionCuller::CullSpheres(const BoundingSpheres& spheres, uint32_t* pIndices, size_t count) const
+{
+    size_t kept = 0;
+    for (size_t n = 0; n < count; ++n)
+    {
+        const uint32_t i = pIndices[n];
+        pIndices[kept] = i;
+        kept += IsSphereVisible(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]) ? 1 : 0;
+    }
+    return kept;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "FrustumCull.h"
+
+// Software occlusion culling against a small CPU depth buffer. A frame
+// rasterizes a few designated occluders, builds a max-depth pyramid over
+// the result and then tests bounding spheres against it, so objects hidden
+// behind the occluders are never submitted:
+//
+//     culler.BeginFrame(viewProj);
+//     culler.AddOccluderBox(world);       // once per occluder
+//     culler.BuildHierarchy();
+//     count = culler.CullSpheres(spheres, pIndices, count);
+//
+// Occluders are closed meshes, drawn with back faces culled (clockwise is
+// front, as in D3D) and clipped to the near plane. Each pixel keeps the
+// farthest depth its occluder plane reaches inside the pixel, pixels an
+// occluder's outline passes through are left as they were, and tests
+// widen an object's screen rectangle by a pixel, so the low resolution
+// only ever makes an object visible, never hidden.
+// Rows are filled 4 or 8 pixels at a time by the SSE and AVX2 kernels;
+// every kernel writes the same depths.
+class OcclusionCuller
+{
+public:
+    static const uint32_t DEFAULT_WIDTH = 256;
+    static const uint32_t DEFAULT_HEIGHT = 128;
+
+    // width is rounded up to a multiple of 8.
+    explicit OcclusionCuller(uint32_t width = DEFAULT_WIDTH, uint32_t height = DEFAULT_HEIGHT);
+
+    // Clears the depth buffer for a view through viewProj.
+    void BeginFrame(const Float4x4& viewProj, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
+
+    // world is an InstanceData-style transposed 3x4 matrix. pPositions
+    // points at the first vertex's x, y, z floats; stride is in bytes.
+    void AddOccluder(const float* pPositions, uint32_t stride, uint32_t vertexCount,
+        const uint16_t* pIndices, uint32_t indexCount, const float world[3][4]);
+
+    // The -0.5..0.5 cube through world; most designated occluders are
+    // boxes, or are stood in for by one that fits inside them.
+    void AddOccluderBox(const float world[3][4]);
+
+    // Call after the last occluder and before any test.
+    void BuildHierarchy();
+
+    bool IsSphereVisible(float x, float y, float z, float radius) const;
+
+    // Keeps the entries of pIndices whose spheres are not hidden, in
+    // order, and returns how many there are.
+    size_t CullSpheres(const BoundingSpheres& spheres, uint32_t* pIndices, size_t count) const;
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetLevelCount() const { return m_levelCount; }
+    uint32_t GetOccluderTriangleCount() const { return m_triangles; }
+
+    // Level 0 is the depth buffer; level n is (width >> n) x (height >> n),
+    // rounded up, each texel the farthest of the 2x2 below it.
+    const float* GetDepth(uint32_t level) const { return m_depth.data() + m_levels[level].offset; }
+
+private:
+    static const uint32_t MAX_LEVELS = 16;
+
+    struct OutlineSpan
+    {
+        uint32_t first;     // pixel index
+        uint32_t count;
+    };
+
+    struct Level
+    {
+        size_t offset;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    void DrawTriangle(const float* v0, const float* v1, const float* v2);
+
+    uint32_t m_width;
+    uint32_t m_height;
+    Level m_levels[MAX_LEVELS];
+    uint32_t m_levelCount;
+    std::vector<float> m_depth;         // every level, level 0 first
+    std::vector<float> m_clip;          // an occluder's vertices in clip space
+    std::vector<uint8_t> m_facing;      // an occluder's triangles that face the eye
+    std::vector<uint32_t> m_edges;      // their edges, sorted
+    std::vector<OutlineSpan> m_outlineSpans;
+    std::vector<float> m_outlineDepths; // under m_outlineSpans before the occluder
+    Float4x4 m_viewProj;
+    TransformKernel m_kernel;
+    uint32_t m_triangles;               // drawn this frame, after clipping and culling
+};
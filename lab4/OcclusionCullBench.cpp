@@ -0,0 +1,205 @@
+#include "OcclusionCullBench.h"
+#include "BenchUtil.h"
+#include "LabScene.h"
+#include "OcclusionCull.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Cubes of scale 0.25 to 1 resting on the ground within 25 units of the
+    // origin.
+    void BuildObjects(SceneTransforms& scene, uint32_t count)
+    {
+        scene.Resize(count);
+        uint32_t state = 1999;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float angle = Random(state) * 6.2831853f;
+            const float radius = 25.0f * std::sqrt(Random(state));
+            const float scale = 0.25f + 0.75f * Random(state);
+            scene.SetPosition(i, radius * std::cos(angle), 0.5f * scale, radius * std::sin(angle));
+            scene.SetScale(i, scale);
+            scene.SetRotationYaw(i, Random(state) * 6.2831853f);
+        }
+    }
+
+    // Walls 4 to 12 units long, 3 to 6 high and half a unit thick, facing
+    // any way, over the same disc.
+    void BuildWalls(uint32_t count, std::vector<InstanceData>& walls)
+    {
+        SceneTransforms scene;
+        scene.Resize(count);
+        uint32_t state = 77;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float angle = Random(state) * 6.2831853f;
+            const float radius = 25.0f * std::sqrt(Random(state));
+            const float height = 3.0f + 3.0f * Random(state);
+            scene.SetPosition(i, radius * std::cos(angle), 0.5f * height, radius * std::sin(angle));
+            scene.SetScale(i, 4.0f + 8.0f * Random(state), height, 0.5f);
+            scene.SetRotationYaw(i, Random(state) * 6.2831853f);
+        }
+        walls.resize(count);
+        if (count > 0)
+            ComputeInstanceData(scene, 0, count, walls.data());
+    }
+
+    // A circle at eye height 15 units out, looking across the town.
+    void BuildViews(uint32_t frames, std::vector<Float4x4>& views)
+    {
+        const Float4x4 proj = MatrixPerspectiveFovLH(LabScene::FOV_Y, 16.0f / 9.0f, LabScene::NEAR_Z,
+            LabScene::FAR_Z);
+        const float at[3] = { 0.0f, 1.0f, 0.0f };
+        const float up[3] = { 0.0f, 1.0f, 0.0f };
+        views.resize(frames);
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            const float angle = 6.2831853f * (float)f / (float)frames;
+            const float eye[3] = { 15.0f * std::cos(angle), 1.7f, 15.0f * std::sin(angle) };
+            views[f] = MatrixMultiply(MatrixLookAtLH(eye, at, up), proj);
+        }
+    }
+
+    void DrawWalls(OcclusionCuller& culler, const Float4x4& viewProj, const std::vector<InstanceData>& walls,
+        TransformKernel kernel)
+    {
+        culler.BeginFrame(viewProj, kernel);
+        for (const InstanceData& wall : walls)
+            culler.AddOccluderBox(wall.world);
+    }
+
+    double TimeRaster(OcclusionCuller& culler, const std::vector<Float4x4>& views,
+        const std::vector<InstanceData>& walls, TransformKernel kernel, const std::vector<float>& expected,
+        bool& matches)
+    {
+        if (!IsTransformKernelSupported(kernel))
+            return 0.0;
+
+        const size_t pixels = (size_t)culler.GetWidth() * culler.GetHeight();
+        for (size_t f = 0; f < views.size(); ++f)
+        {
+            DrawWalls(culler, views[f], walls, kernel);
+            if (memcmp(culler.GetDepth(0), expected.data() + f * pixels, pixels * sizeof(float)) != 0)
+                matches = false;
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        for (size_t f = 0; f < views.size(); ++f)
+            DrawWalls(culler, views[f], walls, kernel);
+        return ElapsedNs(start, BenchClock::now()) / (1000.0 * views.size());
+    }
+}
+
+void RunOcclusionCullBenchmark(const uint32_t* pOccluderCounts, uint32_t rowCount, uint32_t objectCount,
+    uint32_t frames, std::vector<OcclusionCullBenchResult>& results)
+{
+    if (frames == 0)
+        frames = 1;
+
+    std::vector<Float4x4> views;
+    BuildViews(frames, views);
+
+    SceneTransforms scene;
+    BoundingSpheres spheres;
+    BuildObjects(scene, objectCount);
+    ComputeBoundingSpheres(scene, 0.8660254f, spheres);
+
+    // Frustum culling is the same for every row.
+    std::vector<std::vector<uint32_t>> inFrustum(frames);
+    size_t frustumTotal = 0;
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        inFrustum[f].resize(objectCount);
+        inFrustum[f].resize(CullSpheres(ExtractFrustumPlanes(views[f]), spheres, inFrustum[f].data()));
+        frustumTotal += inFrustum[f].size();
+    }
+
+    OcclusionCuller culler;
+    const size_t pixels = (size_t)culler.GetWidth() * culler.GetHeight();
+    std::vector<InstanceData> walls;
+    std::vector<float> expected(pixels * frames);
+    std::vector<uint32_t> visible;
+
+    for (uint32_t r = 0; r < rowCount; ++r)
+    {
+        BuildWalls(pOccluderCounts[r], walls);
+
+        OcclusionCullBenchResult result;
+        result.objectCount = objectCount;
+        result.occluderCount = pOccluderCounts[r];
+        result.frames = frames;
+        result.frustumVisible = (double)frustumTotal / frames;
+
+        size_t triangles = 0;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            DrawWalls(culler, views[f], walls, TRANSFORM_KERNEL_SCALAR);
+            triangles += culler.GetOccluderTriangleCount();
+            std::copy(culler.GetDepth(0), culler.GetDepth(0) + pixels, expected.begin() + f * pixels);
+        }
+        result.trianglesPerFrame = (double)triangles / frames;
+
+        result.scalarRasterUs = TimeRaster(culler, views, walls, TRANSFORM_KERNEL_SCALAR, expected,
+            result.matchesScalar);
+        result.sseRasterUs = TimeRaster(culler, views, walls, TRANSFORM_KERNEL_SSE, expected,
+            result.matchesScalar);
+        result.avx2RasterUs = TimeRaster(culler, views, walls, TRANSFORM_KERNEL_AVX2, expected,
+            result.matchesScalar);
+
+        // The hierarchy and the tests, one frame at a time on its own walls.
+        double hierarchyNs = 0.0, testNs = 0.0;
+        size_t rejected = 0;
+        BenchClock::time_point frameStart = BenchClock::now();
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            DrawWalls(culler, views[f], walls, TRANSFORM_KERNEL_BEST);
+
+            BenchClock::time_point start = BenchClock::now();
+            culler.BuildHierarchy();
+            BenchClock::time_point built = BenchClock::now();
+            visible = inFrustum[f];
+            const size_t kept = culler.CullSpheres(spheres, visible.data(), visible.size());
+            BenchClock::time_point tested = BenchClock::now();
+
+            hierarchyNs += ElapsedNs(start, built);
+            testNs += ElapsedNs(built, tested);
+            rejected += inFrustum[f].size() - kept;
+        }
+        const double totalNs = ElapsedNs(frameStart, BenchClock::now());
+
+        result.hierarchyUs = hierarchyNs / (1000.0 * frames);
+        result.testNs = frustumTotal > 0 ? testNs / (double)frustumTotal : 0.0;
+        result.totalUs = totalNs / (1000.0 * frames);
+        result.rejected = (double)rejected / frames;
+        results.push_back(result);
+    }
+}
+
+bool WriteOcclusionCullBenchmarkCsv(const char* filename, const std::vector<OcclusionCullBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,occluders,frames,triangles,scalar_raster_us,sse_raster_us,avx2_raster_us,"
+        "hierarchy_us,test_ns,total_us,frustum_visible,rejected,matches_scalar\n");
+    for (const OcclusionCullBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%.1f,%d\n",
+            r.objectCount, r.occluderCount, r.frames, r.trianglesPerFrame, r.scalarRasterUs, r.sseRasterUs,
+            r.avx2RasterUs, r.hierarchyUs, r.testNs, r.totalUs, r.frustumVisible, r.rejected,
+            r.matchesScalar ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Occlusion culling on a synthetic walled town: N small cubes scattered
+// over a 50-unit disc among a given number of wall boxes, seen from eye
+// height as the camera circles the town. Each row is one wall count;
+// objects are frustum culled first and the rest tested against the walls.
+// The raster columns are microseconds per frame to draw the walls with
+// each kernel, 0 where the CPU lacks it; hierarchy is the max-depth
+// pyramid build and test is nanoseconds per frustum-visible object.
+// rejected is the average number of draws the walls hid per frame.
+struct OcclusionCullBenchResult
+{
+    uint32_t objectCount = 0;
+    uint32_t occluderCount = 0;
+    uint32_t frames = 0;
+    double trianglesPerFrame = 0.0;     // walls' triangles drawn, after back faces and clipping
+    double scalarRasterUs = 0.0;
+    double sseRasterUs = 0.0;
+    double avx2RasterUs = 0.0;
+    double hierarchyUs = 0.0;
+    double testNs = 0.0;
+    double totalUs = 0.0;               // raster with the best kernel, hierarchy and tests
+    double frustumVisible = 0.0;
+    double rejected = 0.0;
+    bool matchesScalar = true;          // every kernel wrote the same depths every frame
+};
+
+void RunOcclusionCullBenchmark(const uint32_t* pOccluderCounts, uint32_t rowCount, uint32_t objectCount,
+    uint32_t frames, std::vector<OcclusionCullBenchResult>& results);
+
+bool WriteOcclusionCullBenchmarkCsv(const char* filename, const std::vector<OcclusionCullBenchResult>& results);
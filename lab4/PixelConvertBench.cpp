@@ -0,0 +1,129 @@
+#include "PixelConvertBench.h"
+#include "BenchUtil.h"
+#include "DdsWriter.h"
+#include "LoadScheduler.h"
+#include <cstdio>
+
+namespace
+{
+    const char* GetLayoutName(DdsPixelLayout layout)
+    {
+        switch (layout)
+        {
+        case DDS_PIXELS_RGBA32: return "rgba32";
+        case DDS_PIXELS_RGBX32: return "rgbx32";
+        case DDS_PIXELS_BGRA32: return "bgra32";
+        case DDS_PIXELS_BGRX32: return "bgrx32";
+        case DDS_PIXELS_RGB24: return "rgb24";
+        case DDS_PIXELS_BGR24: return "bgr24";
+        default: return "unknown";
+        }
+    }
+
+    // Noise, so no kernel gets a lucky branch pattern.
+    void FillNoise(std::vector<uint8_t>& data, uint32_t seed)
+    {
+        uint32_t state = seed * 2654435761u + 1;
+        for (uint8_t& byte : data)
+        {
+            state = state * 1664525u + 1013904223u;
+            byte = (uint8_t)(state >> 24);
+        }
+    }
+}
+
+bool RunPixelConvertBenchmark(const char* scratchPath, uint32_t minSize, uint32_t maxSize,
+    std::vector<PixelConvertBenchResult>& results)
+{
+    const DdsPixelLayout layouts[] = {
+        DDS_PIXELS_BGR24, DDS_PIXELS_RGB24, DDS_PIXELS_BGRA32, DDS_PIXELS_BGRX32, DDS_PIXELS_RGBX32, DDS_PIXELS_RGBA32
+    };
+    const BlockDecodeKernel kernels[] = { BLOCK_DECODE_SCALAR, BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+    const double targetBytes = 64.0 * 1024 * 1024;
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    LoadScheduler scheduler(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> converted;
+
+    for (DdsPixelLayout layout : layouts)
+    {
+        for (uint32_t size = minSize; size != 0 && size <= maxSize; size *= 2)
+        {
+            DdsWriteDesc desc;
+            desc.layout = layout;
+            desc.width = size;
+            desc.height = size;
+            pixels.resize(DdsGetDataSize(desc));
+            FillNoise(pixels, size + (uint32_t)layout);
+            if (!WriteDds(scratchPath, desc, pixels.data(), pixels.size()))
+                return false;
+
+            DdsView view;
+            if (!view.Open(scratchPath) || view.GetPixelLayout() != layout)
+            {
+                view.Close();
+                remove(scratchPath);
+                return false;
+            }
+
+            const double inBytes = (double)view.GetMip(0).size;
+            const double outBytes = (double)size * size * 4;
+            const uint32_t iterations = outBytes >= targetBytes ? 1 : (uint32_t)(targetBytes / outBytes);
+            ConvertDdsMip(view, 0, 0, reference, BLOCK_DECODE_SCALAR);
+
+            for (BlockDecodeKernel kernel : kernels)
+            {
+                if (!IsBlockDecodeKernelSupported(kernel))
+                    continue;
+
+                for (int threaded = 0; threaded < 2; ++threaded)
+                {
+                    LoadScheduler* pScheduler = threaded ? &scheduler : nullptr;
+
+                    converted.assign(reference.size(), 0);
+                    ConvertDdsMip(view, 0, 0, converted, kernel, pScheduler);
+
+                    BenchClock::time_point start = BenchClock::now();
+                    for (uint32_t it = 0; it < iterations; ++it)
+                        ConvertDdsMip(view, 0, 0, converted, kernel, pScheduler);
+                    double seconds = ElapsedSeconds(start, BenchClock::now()) / iterations;
+
+                    PixelConvertBenchResult result;
+                    result.layout = GetLayoutName(layout);
+                    result.size = size;
+                    result.kernel = kernel;
+                    result.threads = threaded ? scheduler.GetWorkerCount() + 1 : 1;
+                    result.inMBps = inBytes / seconds / (1024.0 * 1024.0);
+                    result.outMBps = outBytes / seconds / (1024.0 * 1024.0);
+                    result.pixelsPerSecond = (double)size * size / seconds;
+                    result.matchesScalar = converted == reference;
+                    results.push_back(result);
+                }
+            }
+
+            view.Close();
+            remove(scratchPath);
+        }
+    }
+    return true;
+}
+
+bool WritePixelConvertBenchmarkCsv(const char* filename, const std::vector<PixelConvertBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "layout,size,kernel,threads,in_mb_s,out_mb_s,pixels_s,matches_scalar\n");
+    for (const PixelConvertBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%u,%s,%u,%.1f,%.1f,%.0f,%d\n",
+            r.layout.c_str(), r.size, GetBlockDecodeKernelName(r.kernel), r.threads,
+            r.inMBps, r.outMBps, r.pixelsPerSecond, r.matchesScalar ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
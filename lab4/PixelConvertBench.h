@@ -0,0 +1,28 @@
+#pragma once
+#include "PixelConverter.h"
+#include <string>
+
+// Conversion throughput of one synthetic uncompressed texture for one
+// kernel and thread count. inMBps counts stored bytes read, outMBps RGBA8
+// bytes written.
+struct PixelConvertBenchResult
+{
+    std::string layout;
+    uint32_t size = 0;
+    BlockDecodeKernel kernel = BLOCK_DECODE_SCALAR;
+    unsigned threads = 1;
+    double inMBps = 0.0;
+    double outMBps = 0.0;
+    double pixelsPerSecond = 0.0;
+    bool matchesScalar = true;
+};
+
+// For every uncompressed layout and every power-of-two size from minSize to
+// maxSize, writes a single-mip DDS file of noise to scratchPath, maps it and
+// converts it with every supported kernel, single-threaded and on all
+// hardware threads. The file is deleted afterwards. Iterations scale so each
+// measurement converts about 64 MB.
+bool RunPixelConvertBenchmark(const char* scratchPath, uint32_t minSize, uint32_t maxSize,
+    std::vector<PixelConvertBenchResult>& results);
+
+bool WritePixelConvertBenchmarkCsv(const char* filename, const std::vector<PixelConvertBenchResult>& results);
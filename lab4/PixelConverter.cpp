@@ -0,0 +1,240 @@
+#include "PixelConverter.h"
+#include "LoadScheduler.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PIXEL_CONVERT_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define PIXEL_TARGET_SSE41
+#define PIXEL_TARGET_AVX2
+#elif defined(__GNUC__)
+#define PIXEL_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define PIXEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    // Where each output channel (R, G, B, A) comes from within a source
+    // pixel; -1 means the channel is filled with 255.
+    struct PixelSwizzle
+    {
+        uint32_t bytesPerPixel;
+        int offsets[4];
+    };
+
+    PixelSwizzle GetSwizzle(DdsPixelLayout layout)
+    {
+        switch (layout)
+        {
+        case DDS_PIXELS_RGBX32: return { 4, { 0, 1, 2, -1 } };
+        case DDS_PIXELS_BGRA32: return { 4, { 2, 1, 0, 3 } };
+        case DDS_PIXELS_BGRX32: return { 4, { 2, 1, 0, -1 } };
+        case DDS_PIXELS_RGB24: return { 3, { 0, 1, 2, -1 } };
+        case DDS_PIXELS_BGR24: return { 3, { 2, 1, 0, -1 } };
+        default: return { 4, { 0, 1, 2, 3 } };
+        }
+    }
+
+    // pshufb control for four pixels; 0x80 zeroes the byte, and missing
+    // alpha is ORed in afterwards.
+    void BuildShuffleMask(const PixelSwizzle& swizzle, int8_t mask[16])
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const int offset = swizzle.offsets[c];
+                mask[i * 4 + c] = offset < 0 ? (int8_t)0x80 : (int8_t)(i * swizzle.bytesPerPixel + offset);
+            }
+        }
+    }
+
+    // Pixels [first, width) of one row. Each pixel is read whole before it
+    // is written, so 32-bit layouts can convert in place.
+    void ConvertRowScalar(const PixelSwizzle& swizzle, const uint8_t* pIn, uint32_t first, uint32_t width,
+        uint8_t* pOut)
+    {
+        for (uint32_t x = first; x < width; ++x)
+        {
+            uint8_t pixel[4];
+            memcpy(pixel, pIn + (size_t)x * swizzle.bytesPerPixel, swizzle.bytesPerPixel);
+            for (uint32_t c = 0; c < 4; ++c)
+                pOut[x * 4 + c] = swizzle.offsets[c] < 0 ? 255 : pixel[swizzle.offsets[c]];
+        }
+    }
+
+#ifdef PIXEL_CONVERT_SIMD
+    // A 24-bit step reads 16 bytes per 12 it converts, so those kernels stop
+    // two pixels early to keep the overrun inside the row; the scalar path
+    // finishes it.
+    inline uint32_t GetOverrunPixels(const PixelSwizzle& swizzle)
+    {
+        return swizzle.bytesPerPixel == 3 ? 2 : 0;
+    }
+
+    // Four pixels per step. pshufb is SSSE3, which every SSE4.1 CPU has.
+    PIXEL_TARGET_SSE41 uint32_t ConvertRowSse41(const PixelSwizzle& swizzle, const int8_t mask[16],
+        const uint8_t* pIn, uint32_t width, uint8_t* pOut)
+    {
+        const __m128i shuffle = _mm_loadu_si128((const __m128i*)mask);
+        const __m128i alpha = _mm_set1_epi32(swizzle.offsets[3] < 0 ? (int)0xFF000000 : 0);
+        const uint32_t overrun = GetOverrunPixels(swizzle);
+
+        uint32_t x = 0;
+        for (; x + 4 + overrun <= width; x += 4)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(pIn + (size_t)x * swizzle.bytesPerPixel));
+            pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha);
+            _mm_storeu_si128((__m128i*)(pOut + (size_t)x * 4), pixels);
+        }
+        return x;
+    }
+
+    // Eight pixels per step. vpshufb shuffles within each 128-bit lane, so
+    // 24-bit rows load the second four pixels into the upper lane from 12
+    // bytes in and both lanes use the four-pixel mask.
+    PIXEL_TARGET_AVX2 uint32_t ConvertRowAvx2(const PixelSwizzle& swizzle, const int8_t mask[16],
+        const uint8_t* pIn, uint32_t width, uint8_t* pOut)
+    {
+        const __m128i laneShuffle = _mm_loadu_si128((const __m128i*)mask);
+        const __m256i shuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(laneShuffle), laneShuffle, 1);
+        const __m256i alpha = _mm256_set1_epi32(swizzle.offsets[3] < 0 ? (int)0xFF000000 : 0);
+        const uint32_t laneBytes = swizzle.bytesPerPixel * 4;
+        const uint32_t overrun = GetOverrunPixels(swizzle);
+
+        uint32_t x = 0;
+        for (; x + 8 + overrun <= width; x += 8)
+        {
+            const uint8_t* p = pIn + (size_t)x * swizzle.bytesPerPixel;
+            __m256i pixels;
+            if (swizzle.bytesPerPixel == 4)
+            {
+                pixels = _mm256_loadu_si256((const __m256i*)p);
+            }
+            else
+            {
+                pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                    _mm_loadu_si128((const __m128i*)(p + laneBytes)), 1);
+            }
+            pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha);
+            _mm256_storeu_si256((__m256i*)(pOut + (size_t)x * 4), pixels);
+        }
+        return x;
+    }
+#endif
+}
+
+bool IsPixelConvertLayout(DdsPixelLayout layout)
+{
+    return DdsBytesPerPixel(layout) != 0;
+}
+
+void ConvertPixelRows(DdsPixelLayout layout, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t firstRow, uint32_t rowCount,
+    uint8_t* pDst, uint32_t dstRowPitch, BlockDecodeKernel kernel)
+{
+    const PixelSwizzle swizzle = GetSwizzle(layout);
+    int8_t mask[16];
+    BuildShuffleMask(swizzle, mask);
+    kernel = ResolveBlockDecodeKernel(kernel);
+
+    for (uint32_t y = firstRow; y < firstRow + rowCount; ++y)
+    {
+        const uint8_t* pIn = pSrc + (size_t)y * srcRowPitch;
+        uint8_t* pOut = pDst + (size_t)y * dstRowPitch;
+        if (layout == DDS_PIXELS_RGBA32)
+        {
+            if (pIn != pOut)
+                memcpy(pOut, pIn, (size_t)width * 4);
+            continue;
+        }
+
+        uint32_t done = 0;
+#ifdef PIXEL_CONVERT_SIMD
+        if (kernel == BLOCK_DECODE_AVX2)
+            done = ConvertRowAvx2(swizzle, mask, pIn, width, pOut);
+        else if (kernel == BLOCK_DECODE_SSE41)
+            done = ConvertRowSse41(swizzle, mask, pIn, width, pOut);
+#endif
+        ConvertRowScalar(swizzle, pIn, done, width, pOut);
+    }
+}
+
+bool ConvertPixelSurface(DdsPixelLayout layout, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint8_t* pDst, uint32_t dstRowPitch,
+    BlockDecodeKernel kernel, LoadScheduler* pScheduler)
+{
+    const uint32_t bytesPerPixel = DdsBytesPerPixel(layout);
+    if (bytesPerPixel == 0 || !pSrc || !pDst || width == 0 || height == 0 ||
+        srcRowPitch < width * bytesPerPixel || dstRowPitch < width * 4)
+        return false;
+    // In place only works while every row is converted over itself.
+    if (pSrc == pDst && (bytesPerPixel != 4 || srcRowPitch != dstRowPitch))
+        return false;
+
+    ParallelForChunks(pScheduler, height, [=](uint32_t first, uint32_t count) {
+        ConvertPixelRows(layout, pSrc, srcRowPitch, width, first, count, pDst, dstRowPitch, kernel);
+    });
+    return true;
+}
+
+bool ConvertDdsMip(const DdsView& view, uint32_t slice, uint32_t level, std::vector<uint8_t>& rgba,
+    BlockDecodeKernel kernel, LoadScheduler* pScheduler)
+{
+    if (!view.IsOpen() || slice >= view.GetArraySize() || level >= view.GetMipCount() ||
+        !IsPixelConvertLayout(view.GetPixelLayout()))
+        return false;
+
+    const DdsMipSpan& mip = view.GetMip(slice, level);
+    rgba.resize((size_t)mip.width * mip.height * 4);
+    return ConvertPixelSurface(view.GetPixelLayout(), mip.pData, mip.rowPitch, mip.width, mip.height,
+        rgba.data(), mip.width * 4, kernel, pScheduler);
+}
+
+size_t GetDdsMipChainsSize(const DdsView& view, uint32_t firstMip)
+{
+    if (!view.IsOpen() || firstMip >= view.GetMipCount())
+        return 0;
+
+    const DdsPixelLayout layout = view.GetPixelLayout();
+    const bool copied = layout == DDS_PIXELS_BLOCK || layout == DDS_PIXELS_RGBA32;
+    size_t size = 0;
+    for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+    {
+        for (uint32_t level = firstMip; level < view.GetMipCount(); ++level)
+        {
+            const DdsMipSpan& mip = view.GetMip(slice, level);
+            size += copied ? mip.size : (size_t)mip.width * mip.height * 4;
+        }
+    }
+    return size;
+}
+
+bool CopyDdsMipChains(const DdsView& view, uint32_t firstMip, uint8_t* pDst)
+{
+    if (!view.IsOpen() || firstMip >= view.GetMipCount())
+        return false;
+
+    const DdsPixelLayout layout = view.GetPixelLayout();
+    const bool copied = layout == DDS_PIXELS_BLOCK || layout == DDS_PIXELS_RGBA32;
+    for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+    {
+        for (uint32_t level = firstMip; level < view.GetMipCount(); ++level)
+        {
+            const DdsMipSpan& mip = view.GetMip(slice, level);
+            if (copied)
+            {
+                memcpy(pDst, mip.pData, mip.size);
+                pDst += mip.size;
+                continue;
+            }
+
+            if (!ConvertPixelSurface(layout, mip.pData, mip.rowPitch, mip.width, mip.height, pDst, mip.width * 4))
+                return false;
+            pDst += (size_t)mip.width * mip.height * 4;
+        }
+    }
+    return true;
+}
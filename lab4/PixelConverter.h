@@ -0,0 +1,36 @@
+#pragma once
+#include "BlockDecoder.h"
+
+// Converts uncompressed DDS pixels (24- and 32-bit, RGB or BGR order, with
+// or without alpha) to RGBA8, the one uncompressed format the labs upload.
+// Kernels are the block decoder's: the SSE4.1 one converts four pixels per
+// pshufb, the AVX2 one eight.
+bool IsPixelConvertLayout(DdsPixelLayout layout);
+
+// Converts rows [firstRow, firstRow + rowCount) of a surface width pixels
+// wide. pSrc and pDst both point at the start of the surface. A 32-bit
+// layout may convert in place (pSrc == pDst with equal pitches). All
+// kernels give identical output.
+void ConvertPixelRows(DdsPixelLayout layout, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t firstRow, uint32_t rowCount,
+    uint8_t* pDst, uint32_t dstRowPitch, BlockDecodeKernel kernel = BLOCK_DECODE_BEST);
+
+// Converts a whole surface, in row chunks on the scheduler's workers and the
+// calling thread when one is given.
+bool ConvertPixelSurface(DdsPixelLayout layout, const uint8_t* pSrc, uint32_t srcRowPitch,
+    uint32_t width, uint32_t height, uint8_t* pDst, uint32_t dstRowPitch,
+    BlockDecodeKernel kernel = BLOCK_DECODE_BEST, LoadScheduler* pScheduler = nullptr);
+
+// Converts one mip of one slice of a mapped DDS file into a tightly packed
+// RGBA8 image.
+bool ConvertDdsMip(const DdsView& view, uint32_t slice, uint32_t level, std::vector<uint8_t>& rgba,
+    BlockDecodeKernel kernel = BLOCK_DECODE_BEST, LoadScheduler* pScheduler = nullptr);
+
+// Bytes CopyDdsMipChains() writes for mips firstMip.. of every slice.
+size_t GetDdsMipChainsSize(const DdsView& view, uint32_t firstMip);
+
+// Copies mips firstMip.. of every slice, slice-major and tightly packed the
+// way a file holding only those levels would be. Block and RGBA8 data is
+// copied as is, other layouts are converted to RGBA8. Levels above firstMip
+// are never touched, so their pages are never read from the file.
+bool CopyDdsMipChains(const DdsView& view, uint32_t firstMip, uint8_t* pDst);
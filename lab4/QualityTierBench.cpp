@@ -0,0 +1,135 @@
+#include "QualityTierBench.h"
+#include "BenchUtil.h"
+#include "PixelConverter.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // Size of one level as CopyDdsMipChains() packs it, worked out from the
+    // header alone rather than from the view's spans.
+    size_t GetPackedMipSize(const DdsView& view, uint32_t level)
+    {
+        uint32_t width = view.GetWidth() >> level;
+        uint32_t height = view.GetHeight() >> level;
+        width = width ? width : 1;
+        height = height ? height : 1;
+
+        const DdsPixelLayout layout = view.GetPixelLayout();
+        if (layout != DDS_PIXELS_BLOCK && layout != DDS_PIXELS_RGBA32)
+            return (size_t)width * height * 4;
+
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(layout, view.GetFormat(), width, height, rowPitch, rowCount);
+        return (size_t)rowPitch * rowCount;
+    }
+
+    // Each slice of a reduced load has to equal the tail of the same slice
+    // in the full one.
+    bool MatchesFull(const DdsView& view, uint32_t firstMip, const std::vector<uint8_t>& full,
+        const std::vector<uint8_t>& reduced)
+    {
+        size_t fullOffset = 0;
+        size_t reducedOffset = 0;
+        for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+        {
+            for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+            {
+                const size_t size = GetPackedMipSize(view, level);
+                if (level >= firstMip)
+                {
+                    if (fullOffset + size > full.size() || reducedOffset + size > reduced.size() ||
+                        memcmp(&full[fullOffset], &reduced[reducedOffset], size) != 0)
+                        return false;
+                    reducedOffset += size;
+                }
+                fullOffset += size;
+            }
+        }
+        return fullOffset == full.size() && reducedOffset == reduced.size();
+    }
+}
+
+bool RunQualityTierBenchmark(const std::string* pPaths, uint32_t fileCount, const TextureQuality* pTiers,
+    uint32_t tierCount, uint32_t iterations, std::vector<QualityTierBenchResult>& results)
+{
+    if (iterations == 0)
+        iterations = 1;
+
+    std::vector<uint8_t> full;
+    std::vector<uint8_t> reduced;
+    for (uint32_t f = 0; f < fileCount; ++f)
+    {
+        DdsView view;
+        if (!view.Open(pPaths[f].c_str()))
+            return false;
+        full.resize(GetDdsMipChainsSize(view, 0));
+        if (!CopyDdsMipChains(view, 0, full.data()))
+            return false;
+        view.Close();
+
+        for (uint32_t t = 0; t < tierCount; ++t)
+        {
+            QualityTierBenchResult result;
+            result.file = pPaths[f];
+            result.quality = pTiers[t];
+            result.measured = true;
+
+            for (uint32_t it = 0; it < iterations; ++it)
+            {
+                view.Close();
+                result.measured = result.measured && MappedFile::EvictFromPageCache(pPaths[f].c_str());
+
+                BenchClock::time_point start = BenchClock::now();
+                if (!view.Open(pPaths[f].c_str(), pTiers[t].IsFull()))
+                    return false;
+                result.firstMip = GetQualityFirstMip(view, pTiers[t]);
+                if (!pTiers[t].IsFull())
+                    view.ReadAheadMips(result.firstMip);
+                reduced.resize(GetDdsMipChainsSize(view, result.firstMip));
+                if (!CopyDdsMipChains(view, result.firstMip, reduced.data()))
+                    return false;
+                result.loadMs += ElapsedMs(start, BenchClock::now());
+
+                size_t resident = 0;
+                result.measured = result.measured &&
+                    MappedFile::GetResidentBytes(view.GetMappedData(), view.GetMappedSize(), resident);
+                result.bytesRead += resident;
+            }
+
+            result.loadMs /= iterations;
+            result.bytesRead = result.measured ? result.bytesRead / iterations : 0;
+            result.width = view.GetMip(result.firstMip).width;
+            result.height = view.GetMip(result.firstMip).height;
+            result.fileBytes = view.GetMappedSize();
+            result.keptBytes = reduced.size();
+            result.matchesFull = MatchesFull(view, result.firstMip, full, reduced);
+            results.push_back(result);
+        }
+    }
+    return true;
+}
+
+bool WriteQualityTierBenchmarkCsv(const char* filename, const std::vector<QualityTierBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "file,drop_mips,max_dimension,first_mip,width,height,file_bytes,kept_bytes,bytes_read,"
+        "load_ms,matches_full\n");
+    for (const QualityTierBenchResult& r : results)
+    {
+        // bytes_read stays empty where it could not be measured.
+        char bytesRead[32] = "";
+        if (r.measured)
+            snprintf(bytesRead, sizeof(bytesRead), "%llu", (unsigned long long)r.bytesRead);
+        fprintf(pFile, "%s,%u,%u,%u,%u,%u,%llu,%llu,%s,%.4f,%d\n",
+            r.file.c_str(), r.quality.dropMips, r.quality.maxDimension, r.firstMip, r.width, r.height,
+            (unsigned long long)r.fileBytes, (unsigned long long)r.keptBytes, bytesRead, r.loadMs,
+            r.matchesFull ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
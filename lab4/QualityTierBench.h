@@ -0,0 +1,29 @@
+#pragma once
+#include "DdsView.h"
+#include <string>
+
+// One file loaded at one TextureQuality the way TextureLoader::LoadDDS()
+// does: open, read ahead and copy the kept levels out of the mapping. Every
+// load starts from a cold page cache, and what the mapping holds afterwards
+// is what was read, header page included. That needs
+// posix_fadvise and mincore: on Windows the loads are warm and bytesRead
+// is not measured.
+struct QualityTierBenchResult
+{
+    std::string file;
+    TextureQuality quality;
+    uint32_t firstMip = 0;
+    uint32_t width = 0;             // of the loaded top level
+    uint32_t height = 0;
+    uint64_t fileBytes = 0;
+    uint64_t keptBytes = 0;         // texel data of the kept levels
+    bool measured = false;
+    uint64_t bytesRead = 0;
+    double loadMs = 0.0;
+    bool matchesFull = true;        // the kept levels sit where a full load puts them
+};
+
+bool RunQualityTierBenchmark(const std::string* pPaths, uint32_t fileCount, const TextureQuality* pTiers,
+    uint32_t tierCount, uint32_t iterations, std::vector<QualityTierBenchResult>& results);
+
+bool WriteQualityTierBenchmarkCsv(const char* filename, const std::vector<QualityTierBenchResult>& results);
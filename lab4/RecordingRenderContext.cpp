@@ -0,0 +1,204 @@
+#include "RecordingRenderContext.h"
+#include <algorithm>
+#include <cstring>
+
+RecordingRenderContext::RecordingRenderContext(bool keepCalls)
+    : m_keepCalls(keepCalls)
+{
+    memset(&m_state, 0, sizeof(m_state));
+    ResetCounts();
+}
+
+void RecordingRenderContext::ResetCounts()
+{
+    memset(m_counts, 0, sizeof(m_counts));
+    m_instances = 0;
+    m_calls.clear();
+    m_payload.clear();
+}
+
+void RecordingRenderContext::TrackBuffer(ID3D11Buffer* pBuffer, void* pMemory, uint32_t size)
+{
+    const TrackedBuffer tracked = { pBuffer, (uint8_t*)pMemory, size };
+    for (TrackedBuffer& existing : m_tracked)
+    {
+        if (existing.pBuffer == pBuffer)
+        {
+            existing = tracked;
+            return;
+        }
+    }
+    m_tracked.push_back(tracked);
+}
+
+const RecordingRenderContext::TrackedBuffer* RecordingRenderContext::FindTracked(const ID3D11Buffer* pBuffer) const
+{
+    for (const TrackedBuffer& tracked : m_tracked)
+    {
+        if (tracked.pBuffer == pBuffer)
+            return &tracked;
+    }
+    return nullptr;
+}
+
+void RecordingRenderContext::Keep(RenderCommandType type, uint32_t slot, const void* pObject,
+    uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4)
+{
+    ++m_counts[type];
+    if (!m_keepCalls)
+        return;
+
+    RenderCommand cmd;
+    cmd.type = type;
+    cmd.slot = (uint8_t)slot;
+    cmd.reserved = 0;
+    cmd.arg0 = arg0;
+    cmd.arg1 = arg1;
+    cmd.arg2 = arg2;
+    cmd.arg3 = arg3;
+    cmd.arg4 = arg4;
+    cmd.pObject = pObject;
+    m_calls.push_back(cmd);
+}
+
+uint32_t RecordingRenderContext::GetBindCount() const
+{
+    uint32_t binds = 0;
+    for (uint32_t type = RCMD_VERTEX_SHADER; type <= RCMD_BLEND_STATE; ++type)
+        binds += m_counts[type];
+    return binds;
+}
+
+const uint8_t* RecordingRenderContext::GetVSConstants(uint32_t slot) const
+{
+    if (slot >= RENDER_MAX_CONSTANT_BUFFERS)
+        return nullptr;
+    const TrackedBuffer* pTracked = FindTracked(m_state.vsConstantBuffers[slot]);
+    const uint32_t offset = m_state.vsConstantFirst[slot] * 16;
+    if (!pTracked || offset >= pTracked->size)
+        return nullptr;
+    return pTracked->pMemory + offset;
+}
+
+void RecordingRenderContext::SetVertexShader(ID3D11VertexShader* pShader)
+{
+    m_state.pVertexShader = pShader;
+    Keep(RCMD_VERTEX_SHADER, 0, pShader);
+}
+
+void RecordingRenderContext::SetPixelShader(ID3D11PixelShader* pShader)
+{
+    m_state.pPixelShader = pShader;
+    Keep(RCMD_PIXEL_SHADER, 0, pShader);
+}
+
+void RecordingRenderContext::SetInputLayout(ID3D11InputLayout* pLayout)
+{
+    m_state.pInputLayout = pLayout;
+    Keep(RCMD_INPUT_LAYOUT, 0, pLayout);
+}
+
+void RecordingRenderContext::SetPrimitiveTopology(uint32_t topology)
+{
+    m_state.topology = topology;
+    Keep(RCMD_TOPOLOGY, 0, nullptr, topology);
+}
+
+void RecordingRenderContext::SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset)
+{
+    if (slot < RENDER_MAX_VERTEX_BUFFERS)
+        m_state.vertexBuffers[slot] = pBuffer;
+    Keep(RCMD_VERTEX_BUFFER, slot, pBuffer, stride, offset);
+}
+
+void RecordingRenderContext::SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset)
+{
+    m_state.pIndexBuffer = pBuffer;
+    Keep(RCMD_INDEX_BUFFER, 0, pBuffer, format, offset);
+}
+
+void RecordingRenderContext::SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer)
+{
+    if (slot < RENDER_MAX_CONSTANT_BUFFERS)
+    {
+        m_state.vsConstantBuffers[slot] = pBuffer;
+        m_state.vsConstantFirst[slot] = 0;
+    }
+    Keep(RCMD_VS_CONSTANT_BUFFER, slot, pBuffer);
+}
+
+void RecordingRenderContext::SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    if (slot < RENDER_MAX_CONSTANT_BUFFERS)
+    {
+        m_state.vsConstantBuffers[slot] = pBuffer;
+        m_state.vsConstantFirst[slot] = firstConstant;
+    }
+    Keep(RCMD_VS_CONSTANT_BUFFER_RANGE, slot, pBuffer, firstConstant, constantCount);
+}
+
+void RecordingRenderContext::SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView)
+{
+    if (slot < RENDER_MAX_SHADER_RESOURCES)
+        m_state.psShaderResources[slot] = pView;
+    Keep(RCMD_PS_SHADER_RESOURCE, slot, pView);
+}
+
+void RecordingRenderContext::SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler)
+{
+    if (slot < RENDER_MAX_SAMPLERS)
+        m_state.psSamplers[slot] = pSampler;
+    Keep(RCMD_PS_SAMPLER, slot, pSampler);
+}
+
+void RecordingRenderContext::SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef)
+{
+    m_state.pDepthStencilState = pState;
+    Keep(RCMD_DEPTH_STENCIL_STATE, 0, pState, stencilRef);
+}
+
+void RecordingRenderContext::SetRasterizerState(ID3D11RasterizerState* pState)
+{
+    m_state.pRasterizerState = pState;
+    Keep(RCMD_RASTERIZER_STATE, 0, pState);
+}
+
+void RecordingRenderContext::SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask)
+{
+    m_state.pBlendState = pState;
+    Keep(RCMD_BLEND_STATE, 0, pState, sampleMask);
+}
+
+void RecordingRenderContext::UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard)
+{
+    const TrackedBuffer* pTracked = FindTracked(pBuffer);
+    if (pTracked)
+        memcpy(pTracked->pMemory, pData, std::min(size, pTracked->size));
+
+    const uint32_t offset = (uint32_t)m_payload.size();
+    if (m_keepCalls)
+    {
+        m_payload.resize(offset + size);
+        memcpy(m_payload.data() + offset, pData, size);
+    }
+    Keep(RCMD_UPDATE_BUFFER, 0, pBuffer, offset, size, discard ? 1 : 0);
+}
+
+void RecordingRenderContext::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    ++m_instances;
+    Keep(RCMD_DRAW_INDEXED, 0, nullptr, indexCount, startIndex, (uint32_t)baseVertex);
+    if (m_onDraw)
+        m_onDraw(*this, indexCount, 1);
+}
+
+void RecordingRenderContext::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+    uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+    m_instances += instanceCount;
+    Keep(RCMD_DRAW_INDEXED_INSTANCED, 0, nullptr, indexCount, instanceCount,
+        startIndex, (uint32_t)baseVertex, startInstance);
+    if (m_onDraw)
+        m_onDraw(*this, indexCount, instanceCount);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "RenderCommands.h"
+#include <functional>
+
+// An IRenderContext that draws nothing and keeps what reached it: a count
+// per command type, the bound pipeline state, the contents of the buffers it
+// was told to track and, if asked, every call in order. Benches submit to it
+// in place of D3D11RenderContext, and tests check a CommandRecorder's output
+// against it.
+class RecordingRenderContext : public IRenderContext
+{
+public:
+    struct BoundState
+    {
+        ID3D11VertexShader* pVertexShader;
+        ID3D11PixelShader* pPixelShader;
+        ID3D11InputLayout* pInputLayout;
+        uint32_t topology;
+        ID3D11Buffer* vertexBuffers[RENDER_MAX_VERTEX_BUFFERS];
+        ID3D11Buffer* pIndexBuffer;
+        ID3D11Buffer* vsConstantBuffers[RENDER_MAX_CONSTANT_BUFFERS];
+        uint32_t vsConstantFirst[RENDER_MAX_CONSTANT_BUFFERS];      // 0 for the whole buffer
+        ID3D11ShaderResourceView* psShaderResources[RENDER_MAX_SHADER_RESOURCES];
+        ID3D11SamplerState* psSamplers[RENDER_MAX_SAMPLERS];
+        ID3D11DepthStencilState* pDepthStencilState;
+        ID3D11RasterizerState* pRasterizerState;
+        ID3D11BlendState* pBlendState;
+    };
+
+    // Called on every draw, after it is counted, with the state it would
+    // read. DrawIndexed passes an instanceCount of 1.
+    typedef std::function<void(const RecordingRenderContext& context, uint32_t indexCount, uint32_t instanceCount)>
+        DrawFn;
+
+    // keepCalls keeps every call as a RenderCommand, with UpdateBuffer data
+    // copied to GetPayload(); off, nothing is allocated per call.
+    explicit RecordingRenderContext(bool keepCalls = false);
+
+    // Clears the counts and the kept calls. The bound state and buffer
+    // contents carry over, as on a real context.
+    void ResetCounts();
+    void SetDrawFn(const DrawFn& onDraw) { m_onDraw = onDraw; }
+
+    // size bytes at pMemory stand in for pBuffer's contents: UpdateBuffer()
+    // copies into them and GetVSConstants() reads them. A mapping written
+    // directly, as D3D11ConstantRing writes its buffer, can be passed as is.
+    void TrackBuffer(ID3D11Buffer* pBuffer, void* pMemory, uint32_t size);
+
+    void SetVertexShader(ID3D11VertexShader* pShader) override;
+    void SetPixelShader(ID3D11PixelShader* pShader) override;
+    void SetInputLayout(ID3D11InputLayout* pLayout) override;
+    void SetPrimitiveTopology(uint32_t topology) override;
+    void SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset) override;
+    void SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset) override;
+    void SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer) override;
+    void SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t firstConstant,
+        uint32_t constantCount) override;
+    void SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView) override;
+    void SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler) override;
+    void SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef) override;
+    void SetRasterizerState(ID3D11RasterizerState* pState) override;
+    void SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask) override;
+    void UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+        uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+
+    uint32_t GetCount(RenderCommandType type) const { return m_counts[type]; }
+    uint32_t GetBindCount() const;      // every Set* call
+    uint32_t GetDrawCount() const { return m_counts[RCMD_DRAW_INDEXED] + m_counts[RCMD_DRAW_INDEXED_INSTANCED]; }
+    uint32_t GetInstanceCount() const { return m_instances; }
+
+    const BoundState& GetState() const { return m_state; }
+
+    // What the vertex shader reads from VS slot: the tracked contents of the
+    // bound buffer from its first constant on, or nullptr if nothing tracked
+    // is bound there.
+    const uint8_t* GetVSConstants(uint32_t slot) const;
+
+    // Kept calls, with the arguments in the slots CommandRecorder records
+    // them in. An UpdateBuffer's arg0 is its offset into GetPayload().
+    const std::vector<RenderCommand>& GetCalls() const { return m_calls; }
+    const std::vector<uint8_t>& GetPayload() const { return m_payload; }
+
+private:
+    struct TrackedBuffer
+    {
+        ID3D11Buffer* pBuffer;
+        uint8_t* pMemory;
+        uint32_t size;
+    };
+
+    void Keep(RenderCommandType type, uint32_t slot, const void* pObject,
+        uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0,
+        uint32_t arg3 = 0, uint32_t arg4 = 0);
+    const TrackedBuffer* FindTracked(const ID3D11Buffer* pBuffer) const;
+
+    bool m_keepCalls;
+    uint32_t m_counts[RCMD_DRAW_INDEXED_INSTANCED + 1];
+    uint32_t m_instances;
+    BoundState m_state;
+    std::vector<TrackedBuffer> m_tracked;
+    std::vector<RenderCommand> m_calls;
+    std::vector<uint8_t> m_payload;
+    DrawFn m_onDraw;
+};
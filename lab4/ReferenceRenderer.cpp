@@ -0,0 +1,470 @@
+#include "ReferenceRenderer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const uint32_t MAX_ATTRIBUTES = 3;
+
+    struct ClipVertex
+    {
+        float pos[4];
+        float attr[MAX_ATTRIBUTES];
+    };
+
+    // Viewport position plus 1/w; attributes are stored divided by w so
+    // they interpolate linearly in screen space.
+    struct ScreenVertex
+    {
+        float x, y, z;
+        float invW;
+        float attr[MAX_ATTRIBUTES];
+    };
+
+    struct RasterState
+    {
+        bool cullBack;
+        bool depthTest;
+        bool depthLessEqual;    // LESS_EQUAL instead of LESS
+        bool depthWrite;
+        bool alphaBlend;        // SRC_ALPHA / INV_SRC_ALPHA on colour, source alpha kept
+    };
+
+    struct Target
+    {
+        uint8_t* pColor;
+        float* pDepth;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct SkyboxShader
+    {
+        static const bool USES_DERIVATIVES = false;
+
+        const SoftwareTexture* pFaces;
+        float lod;
+
+        void operator()(const float* dir, const float*, const float*, float out[4]) const
+        {
+            SampleCube(pFaces, dir, lod, out);
+        }
+    };
+
+    struct CubeShader
+    {
+        static const bool USES_DERIVATIVES = true;
+
+        const SoftwareTexture* pTexture;
+        const float* pTint;
+
+        void operator()(const float* uv, const float* ddx, const float* ddy, float out[4]) const
+        {
+            float lod = ComputeTextureLod(*pTexture, ddx[0], ddx[1], ddy[0], ddy[1]);
+            SampleTrilinear(*pTexture, uv[0], uv[1], lod, true, out);
+            for (int c = 0; c < 4; ++c)
+                out[c] *= pTint[c];
+        }
+    };
+
+    // Vertex colour times the instance tint; alpha is the tint's.
+    struct ColorShader
+    {
+        static const bool USES_DERIVATIVES = false;
+
+        const float* pTint;
+
+        void operator()(const float* color, const float*, const float*, float out[4]) const
+        {
+            for (int c = 0; c < 3; ++c)
+                out[c] = color[c] * pTint[c];
+            out[3] = pTint[3];
+        }
+    };
+
+    uint8_t ToUnorm8(float value)
+    {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return (uint8_t)(value * 255.0f + 0.5f);
+    }
+
+    template <class Shader>
+    void RasterizeTriangle(const Target& target, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+        const RasterState& state, const Shader& shader)
+    {
+        // y points down, so a positive area is clockwise on screen: front
+        // facing with D3D's default FrontCounterClockwise = FALSE.
+        const ScreenVertex* p[3] = { &v0, &v1, &v2 };
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (area == 0.0f)
+            return;
+        if (area < 0.0f)
+        {
+            if (state.cullBack)
+                return;
+            std::swap(p[1], p[2]);
+            area = -area;
+        }
+
+        // Barycentric i = a[i] * x + b[i] * y + c[i], from the edge opposite
+        // vertex i. Pixel centres on an edge belong to the triangle if it is
+        // a top or left edge, as in D3D, so shared edges are drawn once.
+        float a[3], b[3], c[3];
+        bool topLeft[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            const ScreenVertex& e0 = *p[(i + 1) % 3];
+            const ScreenVertex& e1 = *p[(i + 2) % 3];
+            a[i] = -(e1.y - e0.y) / area;
+            b[i] = (e1.x - e0.x) / area;
+            c[i] = ((e1.y - e0.y) * e0.x - (e1.x - e0.x) * e0.y) / area;
+            topLeft[i] = a[i] > 0.0f || (a[i] == 0.0f && b[i] > 0.0f);
+        }
+
+        float minX = std::min(v0.x, std::min(v1.x, v2.x));
+        float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+        float minY = std::min(v0.y, std::min(v1.y, v2.y));
+        float maxY = std::max(v0.y, std::max(v1.y, v2.y));
+        int x0 = std::max(0, (int)std::floor(minX));
+        int x1 = std::min((int)target.width - 1, (int)std::ceil(maxX));
+        int y0 = std::max(0, (int)std::floor(minY));
+        int y1 = std::min((int)target.height - 1, (int)std::ceil(maxY));
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                float px = (float)x + 0.5f;
+                float py = (float)y + 0.5f;
+                float l[3];
+                bool covered = true;
+                for (int i = 0; i < 3; ++i)
+                {
+                    l[i] = a[i] * px + b[i] * py + c[i];
+                    covered = covered && (l[i] > 0.0f || (l[i] == 0.0f && topLeft[i]));
+                }
+                if (!covered)
+                    continue;
+
+                size_t pixel = (size_t)y * target.width + x;
+                float z = l[0] * p[0]->z + l[1] * p[1]->z + l[2] * p[2]->z;
+                float& depth = target.pDepth[pixel];
+                if (state.depthTest && (state.depthLessEqual ? z > depth : z >= depth))
+                    continue;
+
+                float attr[MAX_ATTRIBUTES], ddx[MAX_ATTRIBUTES], ddy[MAX_ATTRIBUTES];
+                float invW = l[0] * p[0]->invW + l[1] * p[1]->invW + l[2] * p[2]->invW;
+                for (uint32_t k = 0; k < MAX_ATTRIBUTES; ++k)
+                    attr[k] = (l[0] * p[0]->attr[k] + l[1] * p[1]->attr[k] + l[2] * p[2]->attr[k]) / invW;
+
+                // Derivatives from the neighbouring pixel centres, evaluated
+                // on the same plane equations.
+                if (Shader::USES_DERIVATIVES)
+                {
+                    float invWx = invW + a[0] * p[0]->invW + a[1] * p[1]->invW + a[2] * p[2]->invW;
+                    float invWy = invW + b[0] * p[0]->invW + b[1] * p[1]->invW + b[2] * p[2]->invW;
+                    for (uint32_t k = 0; k < MAX_ATTRIBUTES; ++k)
+                    {
+                        float sum = l[0] * p[0]->attr[k] + l[1] * p[1]->attr[k] + l[2] * p[2]->attr[k];
+                        float sx = sum + a[0] * p[0]->attr[k] + a[1] * p[1]->attr[k] + a[2] * p[2]->attr[k];
+                        float sy = sum + b[0] * p[0]->attr[k] + b[1] * p[1]->attr[k] + b[2] * p[2]->attr[k];
+                        ddx[k] = sx / invWx - attr[k];
+                        ddy[k] = sy / invWy - attr[k];
+                    }
+                }
+
+                float rgba[4];
+                shader(attr, ddx, ddy, rgba);
+
+                if (state.depthTest && state.depthWrite)
+                    depth = z;
+                uint8_t* pOut = target.pColor + pixel * 4;
+                if (state.alphaBlend)
+                {
+                    const float alpha = rgba[3] < 0.0f ? 0.0f : (rgba[3] > 1.0f ? 1.0f : rgba[3]);
+                    for (int ch = 0; ch < 3; ++ch)
+                        pOut[ch] = ToUnorm8(rgba[ch] * alpha + (float)pOut[ch] / 255.0f * (1.0f - alpha));
+                    pOut[3] = ToUnorm8(rgba[3]);
+                }
+                else
+                {
+                    for (int ch = 0; ch < 4; ++ch)
+                        pOut[ch] = ToUnorm8(rgba[ch]);
+                }
+            }
+        }
+    }
+
+    // Clips against the near plane (z >= 0 in D3D clip space), which turns
+    // the triangle into at most a quad, then projects and rasterizes the fan.
+    template <class Shader>
+    void DrawTriangle(const Target& target, const ClipVertex (&v)[3], const RasterState& state, const Shader& shader)
+    {
+        ClipVertex poly[4];
+        uint32_t count = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            const ClipVertex& cur = v[i];
+            const ClipVertex& next = v[(i + 1) % 3];
+            bool curInside = cur.pos[2] >= 0.0f;
+            bool nextInside = next.pos[2] >= 0.0f;
+            if (curInside)
+                poly[count++] = cur;
+            if (curInside != nextInside)
+            {
+                float t = cur.pos[2] / (cur.pos[2] - next.pos[2]);
+                ClipVertex& out = poly[count++];
+                for (int k = 0; k < 4; ++k)
+                    out.pos[k] = cur.pos[k] + (next.pos[k] - cur.pos[k]) * t;
+                for (uint32_t k = 0; k < MAX_ATTRIBUTES; ++k)
+                    out.attr[k] = cur.attr[k] + (next.attr[k] - cur.attr[k]) * t;
+            }
+        }
+        if (count < 3)
+            return;
+
+        ScreenVertex screen[4];
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float invW = 1.0f / poly[i].pos[3];
+            screen[i].x = (poly[i].pos[0] * invW + 1.0f) * 0.5f * (float)target.width;
+            screen[i].y = (1.0f - poly[i].pos[1] * invW) * 0.5f * (float)target.height;
+            screen[i].z = poly[i].pos[2] * invW;
+            screen[i].invW = invW;
+            for (uint32_t k = 0; k < MAX_ATTRIBUTES; ++k)
+                screen[i].attr[k] = poly[i].attr[k] * invW;
+        }
+
+        for (uint32_t i = 1; i + 1 < count; ++i)
+            RasterizeTriangle(target, screen[0], screen[i], screen[i + 1], state, shader);
+    }
+
+    // Object space to clip space through an instance's world rows.
+    void TransformInstancePoint(const InstanceData& instance, const Float4x4& viewProj, const float pos[3],
+        float out[4])
+    {
+        float world[3];
+        for (int r = 0; r < 3; ++r)
+        {
+            world[r] = instance.world[r][0] * pos[0] + instance.world[r][1] * pos[1] +
+                instance.world[r][2] * pos[2] + instance.world[r][3];
+        }
+        TransformPoint(viewProj, world, out);
+    }
+
+    // Draws the lab cube mesh with its uvs, or with white vertices when
+    // colour is true, for the tinted transparent cubes.
+    template <class Shader>
+    void DrawCube(const Target& target, const InstanceData& instance, const Float4x4& viewProj, bool color,
+        const RasterState& state, const Shader& shader)
+    {
+        const SceneMesh& mesh = GetCubeMesh();
+        for (uint32_t i = 0; i + 2 < mesh.indexCount; i += 3)
+        {
+            ClipVertex v[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                const SceneVertex& vertex = mesh.pVertices[mesh.pIndices[i + k]];
+                TransformInstancePoint(instance, viewProj, vertex.pos, v[k].pos);
+                v[k].attr[0] = color ? 1.0f : vertex.uv[0];
+                v[k].attr[1] = color ? 1.0f : vertex.uv[1];
+                v[k].attr[2] = color ? 1.0f : 0.0f;
+            }
+            DrawTriangle(target, v, state, shader);
+        }
+    }
+}
+
+ReferenceRenderer::ReferenceRenderer()
+    : m_lab(SOFTWARE_LAB4), m_width(0), m_height(0)
+{
+}
+
+bool ReferenceRenderer::Initialize(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_color.assign((size_t)width * height * 4, 0);
+    m_depth.assign((size_t)width * height, 1.0f);
+    return true;
+}
+
+bool ReferenceRenderer::LoadTextures(const DdsView& texture, const DdsView faces[6])
+{
+    m_texture = AcquireSoftwareTextures(&texture, 1);
+    m_faces = AcquireSoftwareTextures(faces, 6);
+    return m_texture && m_faces;
+}
+
+void ReferenceRenderer::RenderFrame(const LabScene& scene)
+{
+    // Same clears as the lab renderers, depth 1.
+    float clearColor[4];
+    GetLabClearColor(m_lab, clearColor);
+    uint8_t clear[4];
+    for (int c = 0; c < 4; ++c)
+        clear[c] = ToUnorm8(clearColor[c]);
+    for (size_t i = 0; i < m_color.size(); i += 4)
+    {
+        for (int c = 0; c < 4; ++c)
+            m_color[i + c] = clear[c];
+    }
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+
+    SceneMatrices matrices;
+    scene.ComputeMatrices((float)m_width / (float)m_height, matrices);
+
+    switch (m_lab)
+    {
+    case SOFTWARE_LAB3:
+        RenderLab3(scene);
+        break;
+
+    case SOFTWARE_LAB4:
+        RenderSkybox(matrices);
+        RenderCubes(scene, matrices);
+        break;
+
+    default:
+        RenderSkybox(matrices);
+        RenderLab5(scene, matrices);
+        break;
+    }
+}
+
+void ReferenceRenderer::RenderSkybox(const SceneMatrices& matrices)
+{
+    if (!m_faces)
+        return;
+
+    const Target target = { m_color.data(), m_depth.data(), m_width, m_height };
+    const RasterState state = { false, true, true, false, false };
+
+    // One LOD for the whole sky: texels per pixel at the centre of the view.
+    SkyboxShader shader;
+    shader.pFaces = m_faces->data();
+    shader.lod = std::log2((float)(*m_faces)[0].levels[0].width / (matrices.proj.m[1][1] * (float)m_height));
+
+    const SceneMesh& mesh = GetSkyboxMesh();
+    for (uint32_t i = 0; i + 2 < mesh.indexCount; i += 3)
+    {
+        ClipVertex v[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            const SceneVertex& vertex = mesh.pVertices[mesh.pIndices[i + k]];
+            TransformPoint(matrices.skyViewProj, vertex.pos, v[k].pos);
+            for (int c = 0; c < 3; ++c)
+                v[k].attr[c] = vertex.pos[c];
+        }
+        DrawTriangle(target, v, state, shader);
+    }
+}
+
+void ReferenceRenderer::RenderCubes(const LabScene& scene, const SceneMatrices& matrices)
+{
+    if (!m_texture)
+        return;
+
+    const Target target = { m_color.data(), m_depth.data(), m_width, m_height };
+    const RasterState state = { true, true, false, true, false };
+    // Every cube, culled or not: this is what the culled backends are
+    // compared against.
+    m_instances.Build(scene.GetTransforms());
+    const InstanceData* pData = m_instances.GetData();
+
+    for (uint32_t n = 0; n < m_instances.GetInstanceCount(); ++n)
+    {
+        CubeShader shader;
+        shader.pTexture = m_texture->data();
+        shader.pTint = pData[n].tint;
+        DrawCube(target, pData[n], matrices.viewProj, false, state, shader);
+    }
+}
+
+void ReferenceRenderer::RenderLab3(const LabScene& scene)
+{
+    // No depth buffer; culling the back faces is enough for one cube.
+    const Target target = { m_color.data(), m_depth.data(), m_width, m_height };
+    const RasterState state = { true, false, false, false, false };
+    const Float4x4 viewProj = ComputeLab3ViewProj(scene, (float)m_width / (float)m_height);
+
+    SceneTransforms object;
+    object.Resize(1);
+    object.SetRotationYaw(0, GetLabCubeYaw(scene.GetTime()));
+    InstanceData instance;
+    ComputeInstanceData(object, 0, 1, &instance, TRANSFORM_KERNEL_SCALAR);
+
+    ColorShader shader;
+    shader.pTint = instance.tint;
+    const SceneColorMesh& mesh = GetLab3CubeMesh();
+    for (uint32_t i = 0; i + 2 < mesh.indexCount; i += 3)
+    {
+        ClipVertex v[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint16_t index = mesh.pIndices[i + k];
+            TransformInstancePoint(instance, viewProj, mesh.pPositions[index], v[k].pos);
+            for (int c = 0; c < 3; ++c)
+                v[k].attr[c] = (float)mesh.pColors[index][c] / 255.0f;
+        }
+        DrawTriangle(target, v, state, shader);
+    }
+}
+
+void ReferenceRenderer::RenderLab5(const LabScene& scene, const SceneMatrices& matrices)
+{
+    const Target target = { m_color.data(), m_depth.data(), m_width, m_height };
+
+    SceneTransforms objects;
+    objects.Resize(1);
+    objects.SetRotationYaw(0, GetLabCubeYaw(scene.GetTime()));
+    InstanceData centre;
+    ComputeInstanceData(objects, 0, 1, &centre, TRANSFORM_KERNEL_SCALAR);
+    if (m_texture)
+    {
+        const RasterState state = { true, true, false, true, false };
+        CubeShader shader;
+        shader.pTexture = m_texture->data();
+        shader.pTint = centre.tint;
+        DrawCube(target, centre, matrices.viewProj, false, state, shader);
+    }
+
+    // The transparent cubes, farthest first, blended over what is there.
+    SceneTransforms transparent;
+    transparent.Resize(2);
+    SetLab5TransparentCubes(transparent, scene.GetTime());
+    InstanceData cubes[2];
+    ComputeInstanceData(transparent, 0, 2, cubes, TRANSFORM_KERNEL_SCALAR);
+
+    float distanceSq[2];
+    for (int n = 0; n < 2; ++n)
+    {
+        distanceSq[n] = 0.0f;
+        for (int c = 0; c < 3; ++c)
+        {
+            const float d = cubes[n].world[c][3] - matrices.eye[c];
+            distanceSq[n] += d * d;
+        }
+    }
+    const int first = distanceSq[1] > distanceSq[0] ? 1 : 0;
+
+    const RasterState state = { true, true, false, false, true };
+    for (int n = 0; n < 2; ++n)
+    {
+        const InstanceData& cube = cubes[n == 0 ? first : 1 - first];
+        ColorShader shader;
+        shader.pTint = cube.tint;
+        DrawCube(target, cube, matrices.viewProj, true, state, shader);
+    }
+}
+
+bool ReferenceRenderer::ReadPixels(std::vector<uint8_t>& rgba)
+{
+    if (m_color.empty())
+        return false;
+    rgba = m_color;
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "SceneBackend.h"
+#include "LabScene.h"
+#include "SoftwareTexture.h"
+
+// Straightforward CPU implementation of the lab pipelines: one thread,
+// scalar code, near-plane clipping, perspective-correct attributes and a
+// float depth buffer. It exists to produce frames on machines without a
+// GPU and to have something simple to compare other backends against, not
+// to be fast.
+class ReferenceRenderer : public ISceneBackend
+{
+public:
+    ReferenceRenderer();
+
+    bool Initialize(uint32_t width, uint32_t height);
+
+    // Decodes the cube texture and the six skybox faces (+X, -X, +Y, -Y,
+    // +Z, -Z) with their whole mip chains, or shares the copies another CPU
+    // renderer already decoded (see AcquireSoftwareTextures()).
+    bool LoadTextures(const DdsView& texture, const DdsView faces[6]);
+
+    // The same three lab frames as SoftwareRenderer.
+    void SetLab(SoftwareLab lab) { m_lab = lab; }
+    SoftwareLab GetLab() const { return m_lab; }
+
+    const char* GetName() const override { return "cpu"; }
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+
+    void RenderFrame(const LabScene& scene) override;
+    bool ReadPixels(std::vector<uint8_t>& rgba) override;
+
+private:
+    void RenderSkybox(const SceneMatrices& matrices);
+    void RenderCubes(const LabScene& scene, const SceneMatrices& matrices);
+    void RenderLab3(const LabScene& scene);
+    void RenderLab5(const LabScene& scene, const SceneMatrices& matrices);
+
+    SoftwareLab m_lab;
+    uint32_t m_width;
+    uint32_t m_height;
+    std::vector<uint8_t> m_color;
+    std::vector<float> m_depth;
+
+    std::shared_ptr<const SoftwareTextureSet> m_texture;
+    std::shared_ptr<const SoftwareTextureSet> m_faces;     // +X -X +Y -Y +Z -Z
+    InstanceBatcher m_instances;
+};
@@ -0,0 +1,262 @@
+#include "RenderCommands.h"
+#include <cstring>
+
+CommandRecorder::CommandRecorder()
+{
+    Invalidate();
+}
+
+void CommandRecorder::BeginFrame()
+{
+    m_commands.clear();
+    m_payload.clear();
+    m_frameStats = RenderCommandStats();
+}
+
+void CommandRecorder::Invalidate()
+{
+    // All-ones never matches a real binding, so the next bind of every slot
+    // goes through.
+    memset(&m_shadow, 0xff, sizeof(m_shadow));
+}
+
+void CommandRecorder::Record(RenderCommandType type, uint32_t slot, const void* pObject,
+    uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4)
+{
+    RenderCommand cmd;
+    cmd.type = type;
+    cmd.slot = (uint8_t)slot;
+    cmd.reserved = 0;
+    cmd.arg0 = arg0;
+    cmd.arg1 = arg1;
+    cmd.arg2 = arg2;
+    cmd.arg3 = arg3;
+    cmd.arg4 = arg4;
+    cmd.pObject = pObject;
+    m_commands.push_back(cmd);
+}
+
+void CommandRecorder::SetVertexShader(ID3D11VertexShader* pShader)
+{
+    if (m_shadow.pVertexShader == pShader) { Eliminate(); return; }
+    m_shadow.pVertexShader = pShader;
+    Record(RCMD_VERTEX_SHADER, 0, pShader);
+}
+
+void CommandRecorder::SetPixelShader(ID3D11PixelShader* pShader)
+{
+    if (m_shadow.pPixelShader == pShader) { Eliminate(); return; }
+    m_shadow.pPixelShader = pShader;
+    Record(RCMD_PIXEL_SHADER, 0, pShader);
+}
+
+void CommandRecorder::SetInputLayout(ID3D11InputLayout* pLayout)
+{
+    if (m_shadow.pInputLayout == pLayout) { Eliminate(); return; }
+    m_shadow.pInputLayout = pLayout;
+    Record(RCMD_INPUT_LAYOUT, 0, pLayout);
+}
+
+void CommandRecorder::SetPrimitiveTopology(uint32_t topology)
+{
+    if (m_shadow.topology == topology) { Eliminate(); return; }
+    m_shadow.topology = topology;
+    Record(RCMD_TOPOLOGY, 0, nullptr, topology);
+}
+
+void CommandRecorder::SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset)
+{
+    if (slot < RENDER_MAX_VERTEX_BUFFERS)
+    {
+        VertexBufferBinding& binding = m_shadow.vertexBuffers[slot];
+        if (binding.pBuffer == pBuffer && binding.stride == stride && binding.offset == offset) { Eliminate(); return; }
+        binding.pBuffer = pBuffer;
+        binding.stride = stride;
+        binding.offset = offset;
+    }
+    Record(RCMD_VERTEX_BUFFER, slot, pBuffer, stride, offset);
+}
+
+void CommandRecorder::SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset)
+{
+    if (m_shadow.pIndexBuffer == pBuffer && m_shadow.indexFormat == format && m_shadow.indexOffset == offset)
+    {
+        Eliminate();
+        return;
+    }
+    m_shadow.pIndexBuffer = pBuffer;
+    m_shadow.indexFormat = format;
+    m_shadow.indexOffset = offset;
+    Record(RCMD_INDEX_BUFFER, 0, pBuffer, format, offset);
+}
+
+void CommandRecorder::SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer)
+{
+    if (slot < RENDER_MAX_CONSTANT_BUFFERS)
+    {
+        if (m_shadow.vsConstantBuffers[slot] == pBuffer &&
+            m_shadow.vsConstantFirst[slot] == 0 && m_shadow.vsConstantCount[slot] == 0) { Eliminate(); return; }
+        m_shadow.vsConstantBuffers[slot] = pBuffer;
+        m_shadow.vsConstantFirst[slot] = 0;
+        m_shadow.vsConstantCount[slot] = 0;
+    }
+    Record(RCMD_VS_CONSTANT_BUFFER, slot, pBuffer);
+}
+
+void CommandRecorder::SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    if (slot < RENDER_MAX_CONSTANT_BUFFERS)
+    {
+        if (m_shadow.vsConstantBuffers[slot] == pBuffer && m_shadow.vsConstantFirst[slot] == firstConstant &&
+            m_shadow.vsConstantCount[slot] == constantCount) { Eliminate(); return; }
+        m_shadow.vsConstantBuffers[slot] = pBuffer;
+        m_shadow.vsConstantFirst[slot] = firstConstant;
+        m_shadow.vsConstantCount[slot] = constantCount;
+    }
+    Record(RCMD_VS_CONSTANT_BUFFER_RANGE, slot, pBuffer, firstConstant, constantCount);
+}
+
+void CommandRecorder::SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView)
+{
+    if (slot < RENDER_MAX_SHADER_RESOURCES)
+    {
+        if (m_shadow.psShaderResources[slot] == pView) { Eliminate(); return; }
+        m_shadow.psShaderResources[slot] = pView;
+    }
+    Record(RCMD_PS_SHADER_RESOURCE, slot, pView);
+}
+
+void CommandRecorder::SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler)
+{
+    if (slot < RENDER_MAX_SAMPLERS)
+    {
+        if (m_shadow.psSamplers[slot] == pSampler) { Eliminate(); return; }
+        m_shadow.psSamplers[slot] = pSampler;
+    }
+    Record(RCMD_PS_SAMPLER, slot, pSampler);
+}
+
+void CommandRecorder::SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef)
+{
+    if (m_shadow.pDepthStencilState == pState && m_shadow.stencilRef == stencilRef) { Eliminate(); return; }
+    m_shadow.pDepthStencilState = pState;
+    m_shadow.stencilRef = stencilRef;
+    Record(RCMD_DEPTH_STENCIL_STATE, 0, pState, stencilRef);
+}
+
+void CommandRecorder::SetRasterizerState(ID3D11RasterizerState* pState)
+{
+    if (m_shadow.pRasterizerState == pState) { Eliminate(); return; }
+    m_shadow.pRasterizerState = pState;
+    Record(RCMD_RASTERIZER_STATE, 0, pState);
+}
+
+void CommandRecorder::SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask)
+{
+    if (m_shadow.pBlendState == pState && m_shadow.sampleMask == sampleMask) { Eliminate(); return; }
+    m_shadow.pBlendState = pState;
+    m_shadow.sampleMask = sampleMask;
+    Record(RCMD_BLEND_STATE, 0, pState, sampleMask);
+}
+
+void CommandRecorder::UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard)
+{
+    uint32_t offset = (uint32_t)m_payload.size();
+    m_payload.resize(offset + size);
+    memcpy(m_payload.data() + offset, pData, size);
+    Record(RCMD_UPDATE_BUFFER, 0, pBuffer, offset, size, discard ? 1 : 0);
+}
+
+void CommandRecorder::UpdateBufferRef(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard)
+{
+    // The payload holds the caller's pointer instead of a copy; slot 1 marks it.
+    uint32_t offset = (uint32_t)m_payload.size();
+    m_payload.resize(offset + sizeof(pData));
+    memcpy(m_payload.data() + offset, &pData, sizeof(pData));
+    Record(RCMD_UPDATE_BUFFER, 1, pBuffer, offset, size, discard ? 1 : 0);
+}
+
+void CommandRecorder::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    ++m_frameStats.draws;
+    ++m_frameStats.instances;
+    Record(RCMD_DRAW_INDEXED, 0, nullptr, indexCount, startIndex, (uint32_t)baseVertex);
+}
+
+void CommandRecorder::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+    uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+    ++m_frameStats.draws;
+    m_frameStats.instances += instanceCount;
+    Record(RCMD_DRAW_INDEXED_INSTANCED, 0, nullptr, indexCount, instanceCount,
+        startIndex, (uint32_t)baseVertex, startInstance);
+}
+
+void CommandRecorder::Submit(IRenderContext& context)
+{
+    for (const RenderCommand& cmd : m_commands)
+    {
+        switch (cmd.type)
+        {
+        case RCMD_VERTEX_SHADER:
+            context.SetVertexShader((ID3D11VertexShader*)cmd.pObject);
+            break;
+        case RCMD_PIXEL_SHADER:
+            context.SetPixelShader((ID3D11PixelShader*)cmd.pObject);
+            break;
+        case RCMD_INPUT_LAYOUT:
+            context.SetInputLayout((ID3D11InputLayout*)cmd.pObject);
+            break;
+        case RCMD_TOPOLOGY:
+            context.SetPrimitiveTopology(cmd.arg0);
+            break;
+        case RCMD_VERTEX_BUFFER:
+            context.SetVertexBuffer(cmd.slot, (ID3D11Buffer*)cmd.pObject, cmd.arg0, cmd.arg1);
+            break;
+        case RCMD_INDEX_BUFFER:
+            context.SetIndexBuffer((ID3D11Buffer*)cmd.pObject, cmd.arg0, cmd.arg1);
+            break;
+        case RCMD_VS_CONSTANT_BUFFER:
+            context.SetVSConstantBuffer(cmd.slot, (ID3D11Buffer*)cmd.pObject);
+            break;
+        case RCMD_VS_CONSTANT_BUFFER_RANGE:
+            context.SetVSConstantBufferRange(cmd.slot, (ID3D11Buffer*)cmd.pObject, cmd.arg0, cmd.arg1);
+            break;
+        case RCMD_PS_SHADER_RESOURCE:
+            context.SetPSShaderResource(cmd.slot, (ID3D11ShaderResourceView*)cmd.pObject);
+            break;
+        case RCMD_PS_SAMPLER:
+            context.SetPSSampler(cmd.slot, (ID3D11SamplerState*)cmd.pObject);
+            break;
+        case RCMD_DEPTH_STENCIL_STATE:
+            context.SetDepthStencilState((ID3D11DepthStencilState*)cmd.pObject, cmd.arg0);
+            break;
+        case RCMD_RASTERIZER_STATE:
+            context.SetRasterizerState((ID3D11RasterizerState*)cmd.pObject);
+            break;
+        case RCMD_BLEND_STATE:
+            context.SetBlendState((ID3D11BlendState*)cmd.pObject, cmd.arg0);
+            break;
+        case RCMD_UPDATE_BUFFER:
+        {
+            const void* pData = m_payload.data() + cmd.arg0;
+            if (cmd.slot == 1)
+                memcpy(&pData, pData, sizeof(pData));
+            context.UpdateBuffer((ID3D11Buffer*)cmd.pObject, pData, cmd.arg1, cmd.arg2 != 0);
+            break;
+        }
+        case RCMD_DRAW_INDEXED:
+            context.DrawIndexed(cmd.arg0, cmd.arg1, (int32_t)cmd.arg2);
+            break;
+        case RCMD_DRAW_INDEXED_INSTANCED:
+            context.DrawIndexedInstanced(cmd.arg0, cmd.arg1, cmd.arg2, (int32_t)cmd.arg3, cmd.arg4);
+            break;
+        }
+    }
+
+    m_frameStats.submitted += (uint32_t)m_commands.size();
+    m_lastFrameStats = m_frameStats;
+    m_commands.clear();
+    m_payload.clear();
+}
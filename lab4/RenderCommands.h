@@ -0,0 +1,179 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Only pointers to these are stored, so the recorder builds without d3d11.h.
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11InputLayout;
+struct ID3D11Buffer;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11DepthStencilState;
+struct ID3D11RasterizerState;
+struct ID3D11BlendState;
+
+// The subset of ID3D11DeviceContext the labs bind through. D3D11RenderContext
+// forwards to a real context; anything else (a recording stub, a software
+// backend) can implement it as well.
+class IRenderContext
+{
+public:
+    virtual ~IRenderContext() {}
+
+    virtual void SetVertexShader(ID3D11VertexShader* pShader) = 0;
+    virtual void SetPixelShader(ID3D11PixelShader* pShader) = 0;
+    virtual void SetInputLayout(ID3D11InputLayout* pLayout) = 0;
+    virtual void SetPrimitiveTopology(uint32_t topology) = 0;
+    virtual void SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset) = 0;
+    virtual void SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset) = 0;
+    virtual void SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer) = 0;
+    // constantCount 16-byte constants of pBuffer from firstConstant, both
+    // multiples of 16 (VSSetConstantBuffers1). Only called where
+    // D3D11ConstantRing is available.
+    virtual void SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer,
+        uint32_t firstConstant, uint32_t constantCount) = 0;
+    virtual void SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView) = 0;
+    virtual void SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler) = 0;
+    virtual void SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef) = 0;
+    virtual void SetRasterizerState(ID3D11RasterizerState* pState) = 0;
+    virtual void SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask) = 0;
+
+    // discard == true maps the buffer with WRITE_DISCARD, otherwise the data
+    // goes through UpdateSubresource.
+    virtual void UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard) = 0;
+    virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+    virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+        uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) = 0;
+};
+
+enum RenderCommandType : uint8_t
+{
+    RCMD_VERTEX_SHADER,
+    RCMD_PIXEL_SHADER,
+    RCMD_INPUT_LAYOUT,
+    RCMD_TOPOLOGY,
+    RCMD_VERTEX_BUFFER,
+    RCMD_INDEX_BUFFER,
+    RCMD_VS_CONSTANT_BUFFER,
+    RCMD_VS_CONSTANT_BUFFER_RANGE,
+    RCMD_PS_SHADER_RESOURCE,
+    RCMD_PS_SAMPLER,
+    RCMD_DEPTH_STENCIL_STATE,
+    RCMD_RASTERIZER_STATE,
+    RCMD_BLEND_STATE,
+    RCMD_UPDATE_BUFFER,
+    RCMD_DRAW_INDEXED,
+    RCMD_DRAW_INDEXED_INSTANCED
+};
+
+struct RenderCommand
+{
+    RenderCommandType type;
+    uint8_t slot;
+    uint16_t reserved;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint32_t arg2;
+    uint32_t arg3;
+    uint32_t arg4;
+    const void* pObject;
+};
+
+struct RenderCommandStats
+{
+    uint32_t submitted = 0;   // commands that reached the context
+    uint32_t eliminated = 0;  // binds dropped because the state was already set
+    uint32_t draws = 0;
+    uint32_t instances = 0;   // DrawIndexed counts as one instance
+};
+
+const uint32_t RENDER_MAX_VERTEX_BUFFERS = 4;
+const uint32_t RENDER_MAX_CONSTANT_BUFFERS = 8;
+const uint32_t RENDER_MAX_SHADER_RESOURCES = 8;
+const uint32_t RENDER_MAX_SAMPLERS = 8;
+
+// Records bind and draw calls into a compact command stream and drops every
+// bind that matches the shadow copy of the pipeline state. Buffer updates are
+// copied into the stream as well so the frame can be replayed in order with a
+// single Submit(). Anything that changes context state behind the recorder's
+// back (ClearState, a second recorder) must be followed by Invalidate().
+class CommandRecorder
+{
+public:
+    CommandRecorder();
+
+    void BeginFrame();
+    void Submit(IRenderContext& context);
+    void Invalidate();
+
+    void SetVertexShader(ID3D11VertexShader* pShader);
+    void SetPixelShader(ID3D11PixelShader* pShader);
+    void SetInputLayout(ID3D11InputLayout* pLayout);
+    void SetPrimitiveTopology(uint32_t topology);
+    void SetVertexBuffer(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t stride, uint32_t offset);
+    void SetIndexBuffer(ID3D11Buffer* pBuffer, uint32_t format, uint32_t offset);
+    void SetVSConstantBuffer(uint32_t slot, ID3D11Buffer* pBuffer);
+    void SetVSConstantBufferRange(uint32_t slot, ID3D11Buffer* pBuffer, uint32_t firstConstant,
+        uint32_t constantCount);
+    void SetPSShaderResource(uint32_t slot, ID3D11ShaderResourceView* pView);
+    void SetPSSampler(uint32_t slot, ID3D11SamplerState* pSampler);
+    void SetDepthStencilState(ID3D11DepthStencilState* pState, uint32_t stencilRef);
+    void SetRasterizerState(ID3D11RasterizerState* pState);
+    void SetBlendState(ID3D11BlendState* pState, uint32_t sampleMask);
+    void UpdateBuffer(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard);
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+        uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+    // Like UpdateBuffer, but only the pointer is recorded. For large uploads
+    // such as instance data; pData must stay valid until Submit().
+    void UpdateBufferRef(ID3D11Buffer* pBuffer, const void* pData, uint32_t size, bool discard);
+
+    // Counts for the frame in progress and for the last submitted frame.
+    const RenderCommandStats& GetFrameStats() const { return m_frameStats; }
+    const RenderCommandStats& GetLastFrameStats() const { return m_lastFrameStats; }
+    size_t GetRecordedCount() const { return m_commands.size(); }
+
+private:
+    struct VertexBufferBinding
+    {
+        ID3D11Buffer* pBuffer;
+        uint32_t stride;
+        uint32_t offset;
+    };
+
+    struct ShadowState
+    {
+        ID3D11VertexShader* pVertexShader;
+        ID3D11PixelShader* pPixelShader;
+        ID3D11InputLayout* pInputLayout;
+        uint32_t topology;
+        VertexBufferBinding vertexBuffers[RENDER_MAX_VERTEX_BUFFERS];
+        ID3D11Buffer* pIndexBuffer;
+        uint32_t indexFormat;
+        uint32_t indexOffset;
+        ID3D11Buffer* vsConstantBuffers[RENDER_MAX_CONSTANT_BUFFERS];
+        uint32_t vsConstantFirst[RENDER_MAX_CONSTANT_BUFFERS];     // 0 and 0 for the whole buffer
+        uint32_t vsConstantCount[RENDER_MAX_CONSTANT_BUFFERS];
+        ID3D11ShaderResourceView* psShaderResources[RENDER_MAX_SHADER_RESOURCES];
+        ID3D11SamplerState* psSamplers[RENDER_MAX_SAMPLERS];
+        ID3D11DepthStencilState* pDepthStencilState;
+        uint32_t stencilRef;
+        ID3D11RasterizerState* pRasterizerState;
+        ID3D11BlendState* pBlendState;
+        uint32_t sampleMask;
+    };
+
+    void Record(RenderCommandType type, uint32_t slot, const void* pObject,
+        uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0,
+        uint32_t arg3 = 0, uint32_t arg4 = 0);
+    void Eliminate() { ++m_frameStats.eliminated; }
+
+    ShadowState m_shadow;
+    std::vector<RenderCommand> m_commands;
+    std::vector<uint8_t> m_payload;
+    RenderCommandStats m_frameStats;
+    RenderCommandStats m_lastFrameStats;
+};
@@ -0,0 +1,283 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uint32_t DEPTH_BITS = 20;
+    const uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+    const uint32_t TOPOLOGY_TRIANGLE_LIST = 4;      // D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+
+    bool SameProgram(const RenderMaterial& a, const RenderMaterial& b)
+    {
+        return a.pVertexShader == b.pVertexShader && a.pPixelShader == b.pPixelShader &&
+            a.pInputLayout == b.pInputLayout;
+    }
+
+    bool SameState(const RenderMaterial& a, const RenderMaterial& b)
+    {
+        return a.textureSlot == b.textureSlot && a.pSampler == b.pSampler &&
+            a.pDepthStencilState == b.pDepthStencilState && a.pRasterizerState == b.pRasterizerState &&
+            a.pBlendState == b.pBlendState;
+    }
+}
+
+RenderQueue::RenderQueue()
+    : m_shaderCount(0), m_stateCount(0), m_textureCount(0), m_bucketBits(2), m_nearDepth(0.0f), m_depthScale(0.0f),
+    m_sorted(true)
+{
+}
+
+uint32_t RenderQueue::AddMaterial(const RenderMaterial& material)
+{
+    MaterialEntry entry;
+    entry.material = material;
+    entry.shader = m_shaderCount;
+    entry.state = m_stateCount;
+    entry.texture = m_textureCount;
+    for (size_t i = 0; i < m_materials.size(); ++i)
+    {
+        const MaterialEntry& other = m_materials[i];
+        const bool sameProgram = SameProgram(other.material, material);
+        const bool sameState = SameState(other.material, material);
+        const bool sameTexture = other.material.pTexture == material.pTexture;
+        if (sameProgram && sameState && sameTexture)
+            return (uint32_t)i;
+        if (sameProgram)
+            entry.shader = other.shader;
+        if (sameState)
+            entry.state = other.state;
+        if (sameTexture)
+            entry.texture = other.texture;
+    }
+
+    if (entry.shader >= MAX_SHADERS || entry.state >= MAX_STATES || entry.texture >= MAX_TEXTURES)
+        return INVALID_ID;
+    if (entry.shader == m_shaderCount)
+        ++m_shaderCount;
+    if (entry.state == m_stateCount)
+        ++m_stateCount;
+    if (entry.texture == m_textureCount)
+        ++m_textureCount;
+    m_materials.push_back(entry);
+    return (uint32_t)m_materials.size() - 1;
+}
+
+uint32_t RenderQueue::AddGeometry(const RenderGeometry& geometry)
+{
+    if (m_geometry.size() >= MAX_GEOMETRY)
+        return INVALID_ID;
+    m_geometry.push_back(geometry);
+    return (uint32_t)m_geometry.size() - 1;
+}
+
+void RenderQueue::Clear()
+{
+    m_materials.clear();
+    m_geometry.clear();
+    m_shaderCount = 0;
+    m_stateCount = 0;
+    m_textureCount = 0;
+    BeginFrame(0.0f, 0.0f);
+}
+
+void RenderQueue::SetDepthBucketBits(uint32_t bits)
+{
+    m_bucketBits = bits < MAX_DEPTH_BUCKET_BITS ? bits : MAX_DEPTH_BUCKET_BITS;
+}
+
+void RenderQueue::BeginFrame(float nearDepth, float farDepth)
+{
+    m_nearDepth = nearDepth;
+    m_depthScale = farDepth > nearDepth ? 1.0f / (farDepth - nearDepth) : 0.0f;
+    m_packets.clear();
+    m_constants.clear();
+    m_payload.clear();
+    m_order.clear();
+    m_sorted = true;
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, const MaterialEntry& material, uint32_t geometry,
+    float depth) const
+{
+    const float depth01 = std::min(std::max((depth - m_nearDepth) * m_depthScale, 0.0f), 1.0f);
+    uint64_t quantized = (uint64_t)(depth01 * (float)DEPTH_MAX);
+    if (pass == RENDER_PASS_TRANSPARENT)
+        quantized = DEPTH_MAX - quantized;
+    const uint64_t bucket = m_bucketBits ? quantized >> (DEPTH_BITS - m_bucketBits) : 0;
+
+    const uint64_t state = ((uint64_t)material.shader << 28) | ((uint64_t)material.state << 22) |
+        ((uint64_t)material.texture << 10) | geometry;
+    uint64_t key = ((uint64_t)pass << 62) | (bucket << 58);
+    if (pass == RENDER_PASS_TRANSPARENT)
+        key |= (quantized << 38) | state;
+    else
+        key |= (state << DEPTH_BITS) | quantized;
+    return key;
+}
+
+void RenderQueue::AddDraw(RenderPass pass, uint32_t material, uint32_t geometry, float depth,
+    uint32_t instanceCount, uint32_t startInstance)
+{
+    if (pass >= RENDER_PASS_COUNT || material >= m_materials.size() || geometry >= m_geometry.size())
+        return;
+
+    Packet packet;
+    packet.key = MakeKey(pass, m_materials[material], geometry, depth);
+    packet.material = material;
+    packet.geometry = geometry;
+    packet.instanceCount = instanceCount;
+    packet.startInstance = startInstance;
+    packet.firstConstants = (uint32_t)m_constants.size();
+    packet.constantsCount = 0;
+    m_packets.push_back(packet);
+    m_sorted = false;
+}
+
+void RenderQueue::AddConstants(uint32_t slot, const void* pData, uint32_t size)
+{
+    if (m_packets.empty())
+        return;
+
+    ConstantBlock block;
+    block.slot = slot;
+    block.size = size;
+    block.offset = (uint32_t)m_payload.size();
+    m_payload.resize(m_payload.size() + size);
+    memcpy(m_payload.data() + block.offset, pData, size);
+    m_constants.push_back(block);
+    ++m_packets.back().constantsCount;
+}
+
+void RenderQueue::Sort()
+{
+    if (m_sorted)
+        return;
+
+    const size_t count = m_packets.size();
+    m_sort.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_sort[i].key = m_packets[i].key;
+        m_sort[i].packet = (uint32_t)i;
+    }
+    RadixSort();
+
+    m_order.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        m_order[i] = m_sort[i].packet;
+    m_sorted = true;
+}
+
+void RenderQueue::RadixSort()
+{
+    // Eight 8-bit passes, least significant first; a frame seldom uses
+    // more than a few shaders, textures or buckets, so most passes find
+    // every key with the same digit and are skipped.
+    const uint32_t passCount = 8;
+    const uint32_t digitCount = 256;
+    const size_t count = m_sort.size();
+    if (count < 2)
+        return;
+    m_scratch.resize(count);
+
+    m_histogram.assign(digitCount * passCount, 0);
+    uint32_t* pHistogram = m_histogram.data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t key = m_sort[i].key;
+        for (uint32_t pass = 0; pass < passCount; ++pass)
+            ++pHistogram[pass * digitCount + ((key >> (pass * 8)) & 0xff)];
+    }
+
+    SortEntry* pSrc = m_sort.data();
+    SortEntry* pDst = m_scratch.data();
+    for (uint32_t pass = 0; pass < passCount; ++pass)
+    {
+        uint32_t* pCounts = pHistogram + pass * digitCount;
+        const uint32_t shift = pass * 8;
+        if (pCounts[(pSrc[0].key >> shift) & 0xff] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < digitCount; ++d)
+        {
+            const uint32_t n = pCounts[d];
+            pCounts[d] = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            pDst[pCounts[(pSrc[i].key >> shift) & 0xff]++] = pSrc[i];
+        std::swap(pSrc, pDst);
+    }
+
+    if (pSrc != m_sort.data())
+        std::copy(pSrc, pSrc + count, m_sort.data());
+}
+
+void RenderQueue::Submit(CommandRecorder& commands, const ConstantsFn& setConstants)
+{
+    Sort();
+    m_stats = RenderQueueStats();
+
+    uint32_t lastShader = INVALID_ID;
+    uint32_t lastState = INVALID_ID;
+    uint32_t lastTexture = INVALID_ID;
+    uint32_t lastGeometry = INVALID_ID;
+    for (uint32_t index : m_order)
+    {
+        const Packet& packet = m_packets[index];
+        const MaterialEntry& entry = m_materials[packet.material];
+        const RenderMaterial& material = entry.material;
+
+        if (entry.shader != lastShader)
+        {
+            ++m_stats.shaderChanges;
+            commands.SetVertexShader(material.pVertexShader);
+            commands.SetPixelShader(material.pPixelShader);
+            commands.SetInputLayout(material.pInputLayout);
+            lastShader = entry.shader;
+        }
+        // The texture slot is part of the state.
+        if (entry.texture != lastTexture || entry.state != lastState)
+        {
+            ++m_stats.textureChanges;
+            commands.SetPSShaderResource(material.textureSlot, material.pTexture);
+            lastTexture = entry.texture;
+        }
+        if (entry.state != lastState)
+        {
+            ++m_stats.stateChanges;
+            commands.SetPSSampler(material.textureSlot, material.pSampler);
+            commands.SetDepthStencilState(material.pDepthStencilState, 0);
+            commands.SetRasterizerState(material.pRasterizerState);
+            commands.SetBlendState(material.pBlendState, 0xffffffff);
+            lastState = entry.state;
+        }
+
+        const RenderGeometry& geometry = m_geometry[packet.geometry];
+        if (packet.geometry != lastGeometry)
+        {
+            ++m_stats.geometryChanges;
+            commands.SetVertexBuffer(0, geometry.pVertexBuffer, geometry.vertexStride, 0);
+            if (geometry.pInstanceBuffer)
+                commands.SetVertexBuffer(1, geometry.pInstanceBuffer, geometry.instanceStride, 0);
+            commands.SetIndexBuffer(geometry.pIndexBuffer, geometry.indexFormat, 0);
+            commands.SetPrimitiveTopology(TOPOLOGY_TRIANGLE_LIST);
+            lastGeometry = packet.geometry;
+        }
+
+        for (uint32_t c = 0; c < packet.constantsCount; ++c)
+        {
+            const ConstantBlock& block = m_constants[packet.firstConstants + c];
+            setConstants(commands, block.slot, m_payload.data() + block.offset, block.size);
+        }
+
+        if (packet.instanceCount > 0)
+            commands.DrawIndexedInstanced(geometry.indexCount, packet.instanceCount, 0, 0, packet.startInstance);
+        else
+            commands.DrawIndexed(geometry.indexCount, 0, 0);
+        ++m_stats.draws;
+    }
+}
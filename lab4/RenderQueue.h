@@ -0,0 +1,184 @@
+#pragma once
+#include "RenderCommands.h"
+#include <functional>
+
+// Passes draw in this order. Background and opaque draws go front to back,
+// so early depth rejection has the most to throw away; transparent ones go
+// back to front, as blending needs.
+enum RenderPass : uint32_t
+{
+    RENDER_PASS_BACKGROUND,
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_TRANSPARENT,
+    RENDER_PASS_COUNT
+};
+
+// Everything a draw binds besides geometry and constants.
+struct RenderMaterial
+{
+    ID3D11VertexShader* pVertexShader = nullptr;
+    ID3D11PixelShader* pPixelShader = nullptr;
+    ID3D11InputLayout* pInputLayout = nullptr;
+    ID3D11ShaderResourceView* pTexture = nullptr;
+    uint32_t textureSlot = 0;
+    ID3D11SamplerState* pSampler = nullptr;     // bound to textureSlot as well
+    ID3D11DepthStencilState* pDepthStencilState = nullptr;
+    ID3D11RasterizerState* pRasterizerState = nullptr;
+    ID3D11BlendState* pBlendState = nullptr;
+};
+
+// Indexed triangle lists; an instance buffer goes in slot 1.
+struct RenderGeometry
+{
+    ID3D11Buffer* pVertexBuffer = nullptr;
+    uint32_t vertexStride = 0;
+    ID3D11Buffer* pInstanceBuffer = nullptr;
+    uint32_t instanceStride = 0;
+    ID3D11Buffer* pIndexBuffer = nullptr;
+    uint32_t indexFormat = 57;                  // DXGI_FORMAT_R16_UINT
+    uint32_t indexCount = 0;
+};
+
+// What changed between consecutive draws of the last submitted frame; the
+// first draw counts as a change of everything.
+struct RenderQueueStats
+{
+    uint32_t draws = 0;
+    uint32_t shaderChanges = 0;
+    uint32_t textureChanges = 0;
+    uint32_t stateChanges = 0;      // sampler, depth-stencil, rasterizer or blend state
+    uint32_t geometryChanges = 0;
+
+    uint32_t GetTotalChanges() const { return shaderChanges + textureChanges + stateChanges + geometryChanges; }
+};
+
+// Collects a frame's draws as packets, sorts them by a 64-bit key and
+// records them into a CommandRecorder, binding only what differs from the
+// previous packet. From the top bit down, opaque keys are
+//
+//     pass:2  bucket:4  shader:10  state:6  texture:12  geometry:10  depth:20
+//
+// and transparent keys put depth first, farthest first:
+//
+//     pass:2  bucket:4  depth:20  shader:10  state:6  texture:12  geometry:10
+//
+// shader, state and texture number the distinct programs, sampler and
+// render state sets and textures of the queue's materials. depth is the
+// draw's view depth quantized over the frame's depth range and bucket its
+// top bits, SetDepthBucketBits() of them. Buckets keep
+// opaque draws roughly front to back while draws sharing a shader and
+// texture within one bucket still go together; with no bucket bits the
+// order is by state alone, front to back only among equal state. Packets
+// are radix sorted, and equal keys keep the order they were added in.
+class RenderQueue
+{
+public:
+    static const uint32_t INVALID_ID = 0xffffffffu;
+    static const uint32_t MAX_SHADERS = 1u << 10;
+    static const uint32_t MAX_STATES = 1u << 6;
+    static const uint32_t MAX_TEXTURES = 1u << 12;
+    static const uint32_t MAX_GEOMETRY = 1u << 10;
+    static const uint32_t MAX_DEPTH_BUCKET_BITS = 4;
+
+    // Writes a draw's constants; lab5 routes them through its constant ring.
+    typedef std::function<void(CommandRecorder& commands, uint32_t slot, const void* pData, uint32_t size)>
+        ConstantsFn;
+
+    RenderQueue();
+
+    // Returns the material's id, INVALID_ID once the key has no room left
+    // for its shader, state or texture. Adding an equal material again
+    // returns the first one's id.
+    uint32_t AddMaterial(const RenderMaterial& material);
+
+    // INVALID_ID past MAX_GEOMETRY.
+    uint32_t AddGeometry(const RenderGeometry& geometry);
+
+    // Forgets materials and geometry, and the frame in progress.
+    void Clear();
+
+    // 0 to MAX_DEPTH_BUCKET_BITS; 2 by default.
+    void SetDepthBucketBits(uint32_t bits);
+
+    // Starts a frame whose draws have view depths from nearDepth to farDepth;
+    // depths outside are clamped.
+    void BeginFrame(float nearDepth, float farDepth);
+
+    // Queues a draw. instanceCount 0 draws without instancing. Ids that
+    // were not handed out are ignored.
+    void AddDraw(RenderPass pass, uint32_t material, uint32_t geometry, float depth, uint32_t instanceCount = 0,
+        uint32_t startInstance = 0);
+
+    // Constants for the draw added last, copied into the queue.
+    void AddConstants(uint32_t slot, const void* pData, uint32_t size);
+
+    // Sorts the frame's packets and records them.
+    void Submit(CommandRecorder& commands, const ConstantsFn& setConstants);
+
+    // Sorts without recording; Submit() does this itself.
+    void Sort();
+
+    // Packet indices in submission order, once sorted.
+    const uint32_t* GetOrder() const { return m_order.data(); }
+    uint32_t GetPacketCount() const { return (uint32_t)m_packets.size(); }
+    uint64_t GetKey(uint32_t packet) const { return m_packets[packet].key; }
+
+    const RenderQueueStats& GetStats() const { return m_stats; }
+
+    static uint32_t GetKeyPass(uint64_t key) { return (uint32_t)(key >> 62); }
+
+private:
+    struct MaterialEntry
+    {
+        RenderMaterial material;
+        uint32_t shader;
+        uint32_t state;
+        uint32_t texture;
+    };
+
+    struct Packet
+    {
+        uint64_t key;
+        uint32_t material;
+        uint32_t geometry;
+        uint32_t instanceCount;
+        uint32_t startInstance;
+        uint32_t firstConstants;        // into m_constants
+        uint32_t constantsCount;
+    };
+
+    struct ConstantBlock
+    {
+        uint32_t slot;
+        uint32_t size;
+        uint32_t offset;                // into m_payload
+    };
+
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    uint64_t MakeKey(RenderPass pass, const MaterialEntry& material, uint32_t geometry, float depth) const;
+    void RadixSort();
+
+    std::vector<MaterialEntry> m_materials;
+    std::vector<RenderGeometry> m_geometry;
+    uint32_t m_shaderCount;
+    uint32_t m_stateCount;
+    uint32_t m_textureCount;
+    uint32_t m_bucketBits;
+
+    float m_nearDepth;
+    float m_depthScale;                 // to [0, 1]
+    std::vector<Packet> m_packets;
+    std::vector<ConstantBlock> m_constants;
+    std::vector<uint8_t> m_payload;
+    std::vector<SortEntry> m_sort;
+    std::vector<SortEntry> m_scratch;
+    std::vector<uint32_t> m_histogram;
+    std::vector<uint32_t> m_order;
+    bool m_sorted;
+    RenderQueueStats m_stats;
+};
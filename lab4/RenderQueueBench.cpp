@@ -0,0 +1,332 @@
+#include "RenderQueueBench.h"
+#include "BenchUtil.h"
+#include "RecordingRenderContext.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const uint32_t MESH_COUNT = 16;
+    const uint32_t MAX_SHADERS = 256;
+    const uint32_t MAX_TEXTURES = 4096;
+    const float NEAR_DEPTH = 0.1f;
+    const float FAR_DEPTH = 100.0f;
+
+    // FakeHandle() indices: six fixed states, then the meshes' vertex and
+    // index buffers, three objects per shader and one view per texture.
+    const uint32_t FAKE_MESHES = 6;
+    const uint32_t FAKE_SHADERS = FAKE_MESHES + 2 * MESH_COUNT;
+    const uint32_t FAKE_TEXTURES = FAKE_SHADERS + 3 * MAX_SHADERS;
+    ID3D11Buffer* const FAKE_MODEL_CB = FakeHandle<ID3D11Buffer>(0);
+    ID3D11SamplerState* const FAKE_SAMPLER = FakeHandle<ID3D11SamplerState>(1);
+    ID3D11DepthStencilState* const FAKE_OPAQUE_DEPTH = FakeHandle<ID3D11DepthStencilState>(2);
+    ID3D11DepthStencilState* const FAKE_TRANSPARENT_DEPTH = FakeHandle<ID3D11DepthStencilState>(3);
+    ID3D11RasterizerState* const FAKE_RASTERIZER = FakeHandle<ID3D11RasterizerState>(4);
+    ID3D11BlendState* const FAKE_BLEND = FakeHandle<ID3D11BlendState>(5);
+
+    const uint32_t MODEL_SIZE = 16 * sizeof(float);
+
+    // One draw with what it would read. Summed, so the total does not
+    // depend on draw order.
+    uint64_t HashDraw(const RecordingRenderContext& context, uint32_t indexCount)
+    {
+        const RecordingRenderContext::BoundState& state = context.GetState();
+        uint32_t model[16] = {};
+        if (const uint8_t* pModel = context.GetVSConstants(0))
+            memcpy(model, pModel, MODEL_SIZE);
+
+        uint64_t hash = indexCount;
+        for (uint32_t word : model)
+            hash = hash * 31 + word;
+        hash = hash * 31 + GetFakeHandleIndex(state.pVertexShader);
+        hash = hash * 31 + GetFakeHandleIndex(state.psShaderResources[0]);
+        hash = hash * 31 + GetFakeHandleIndex(state.vertexBuffers[0]);
+        return hash * 0x9e3779b97f4a7c15ull;
+    }
+
+    // Binds that reached the context. Both paths bind the model buffer for
+    // every draw, so those are left out.
+    uint32_t GetBinds(const RecordingRenderContext& context)
+    {
+        return context.GetBindCount() - context.GetCount(RCMD_VS_CONSTANT_BUFFER) -
+            context.GetCount(RCMD_VS_CONSTANT_BUFFER_RANGE);
+    }
+
+    uint32_t Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+
+    struct BenchDraw
+    {
+        uint32_t material;
+        uint32_t mesh;
+        float depth;
+    };
+
+    // One material per texture, on shader texture % shaders; every fifth
+    // is transparent.
+    void BuildMaterials(uint32_t shaders, uint32_t textures, std::vector<RenderMaterial>& materials)
+    {
+        materials.resize(textures);
+        for (uint32_t t = 0; t < textures; ++t)
+        {
+            const uint32_t s = t % shaders;
+            RenderMaterial& m = materials[t];
+            m.pVertexShader = FakeHandle<ID3D11VertexShader>(FAKE_SHADERS + 3 * s);
+            m.pPixelShader = FakeHandle<ID3D11PixelShader>(FAKE_SHADERS + 3 * s + 1);
+            m.pInputLayout = FakeHandle<ID3D11InputLayout>(FAKE_SHADERS + 3 * s + 2);
+            m.pTexture = FakeHandle<ID3D11ShaderResourceView>(FAKE_TEXTURES + t);
+            m.pSampler = FAKE_SAMPLER;
+            m.pRasterizerState = FAKE_RASTERIZER;
+            const bool transparent = t % 5 == 0;
+            m.pDepthStencilState = transparent ? FAKE_TRANSPARENT_DEPTH : FAKE_OPAQUE_DEPTH;
+            m.pBlendState = transparent ? FAKE_BLEND : nullptr;
+        }
+    }
+
+    void BuildModel(uint32_t draw, uint32_t frame, float model[16])
+    {
+        memset(model, 0, MODEL_SIZE);
+        model[0] = model[5] = model[10] = model[15] = 1.0f;
+        model[3] = (float)draw;
+        model[7] = (float)frame;
+    }
+
+    RenderPass GetPass(const RenderMaterial& material)
+    {
+        return material.pBlendState ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+    }
+
+    // What lab5's Render*() functions do: every draw sets all of its state.
+    void RecordUnsorted(CommandRecorder& commands, const std::vector<RenderMaterial>& materials,
+        const std::vector<BenchDraw>& draws, uint32_t frame)
+    {
+        for (uint32_t i = 0; i < (uint32_t)draws.size(); ++i)
+        {
+            const BenchDraw& draw = draws[i];
+            const RenderMaterial& m = materials[draw.material];
+            commands.SetDepthStencilState(m.pDepthStencilState, 0);
+            commands.SetRasterizerState(m.pRasterizerState);
+            commands.SetBlendState(m.pBlendState, 0xffffffff);
+            commands.SetVertexShader(m.pVertexShader);
+            commands.SetPixelShader(m.pPixelShader);
+            commands.SetInputLayout(m.pInputLayout);
+            commands.SetVertexBuffer(0, FakeHandle<ID3D11Buffer>(FAKE_MESHES + 2 * draw.mesh), 20, 0);
+            commands.SetIndexBuffer(FakeHandle<ID3D11Buffer>(FAKE_MESHES + 2 * draw.mesh + 1), 57, 0);
+            commands.SetPrimitiveTopology(4);
+            commands.SetPSShaderResource(0, m.pTexture);
+            commands.SetPSSampler(0, m.pSampler);
+
+            float model[16];
+            BuildModel(i, frame, model);
+            commands.UpdateBuffer(FAKE_MODEL_CB, model, MODEL_SIZE, false);
+            commands.SetVSConstantBuffer(0, FAKE_MODEL_CB);
+            commands.DrawIndexed(36, 0, 0);
+        }
+    }
+
+    void QueueDraws(RenderQueue& queue, const std::vector<RenderMaterial>& materials,
+        const std::vector<uint32_t>& materialIds, const std::vector<BenchDraw>& draws, uint32_t frame)
+    {
+        queue.BeginFrame(NEAR_DEPTH, FAR_DEPTH);
+        for (uint32_t i = 0; i < (uint32_t)draws.size(); ++i)
+        {
+            const BenchDraw& draw = draws[i];
+            queue.AddDraw(GetPass(materials[draw.material]), materialIds[draw.material], draw.mesh, draw.depth);
+            float model[16];
+            BuildModel(i, frame, model);
+            queue.AddConstants(0, model, MODEL_SIZE);
+        }
+    }
+
+    void SetModelConstants(CommandRecorder& commands, uint32_t slot, const void* pData, uint32_t size)
+    {
+        commands.UpdateBuffer(FAKE_MODEL_CB, pData, size, false);
+        commands.SetVSConstantBuffer(slot, FAKE_MODEL_CB);
+    }
+
+    // Passes never go back, transparent depths never grow by more than one
+    // key step and opaque draws never go back a depth bucket of 2 bits.
+    bool CheckOrder(const RenderQueue& queue, const std::vector<RenderMaterial>& materials,
+        const std::vector<BenchDraw>& draws)
+    {
+        const uint32_t* pOrder = queue.GetOrder();
+        const float step = (FAR_DEPTH - NEAR_DEPTH) / (float)(1u << 24);
+        for (uint32_t n = 1; n < queue.GetPacketCount(); ++n)
+        {
+            const BenchDraw& a = draws[pOrder[n - 1]];
+            const BenchDraw& b = draws[pOrder[n]];
+            const RenderPass passA = GetPass(materials[a.material]);
+            const RenderPass passB = GetPass(materials[b.material]);
+            if (passA != passB)
+            {
+                if (passA > passB)
+                    return false;
+                continue;
+            }
+            if (passA == RENDER_PASS_TRANSPARENT && b.depth > a.depth + step)
+                return false;
+            if (passA == RENDER_PASS_OPAQUE && (int)(b.depth / (FAR_DEPTH - NEAR_DEPTH) * 4.0f) <
+                (int)(a.depth / (FAR_DEPTH - NEAR_DEPTH) * 4.0f) - 1)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void RunRenderQueueBenchmark(const uint32_t* pDraws, const uint32_t* pShaders, const uint32_t* pTextures,
+    uint32_t rowCount, uint32_t frames, std::vector<RenderQueueBenchResult>& results)
+{
+    if (frames == 0)
+        frames = 1;
+
+    CommandRecorder commands;
+    uint8_t modelContents[MODEL_SIZE] = {};
+    uint64_t drawSum = 0;
+    RecordingRenderContext context;
+    context.TrackBuffer(FAKE_MODEL_CB, modelContents, MODEL_SIZE);
+    context.SetDrawFn([&drawSum](const RecordingRenderContext& drawn, uint32_t indexCount, uint32_t) {
+        drawSum += HashDraw(drawn, indexCount);
+    });
+    const RenderQueue::ConstantsFn setConstants = SetModelConstants;
+
+    for (uint32_t r = 0; r < rowCount; ++r)
+    {
+        const uint32_t drawCount = pDraws[r];
+        const uint32_t shaders = std::max(1u, std::min(pShaders[r], MAX_SHADERS));
+        const uint32_t textures = std::max(1u, std::min(pTextures[r], MAX_TEXTURES));
+
+        std::vector<RenderMaterial> materials;
+        BuildMaterials(shaders, textures, materials);
+        RenderQueue queue;
+        std::vector<uint32_t> materialIds(materials.size());
+        for (size_t m = 0; m < materials.size(); ++m)
+            materialIds[m] = queue.AddMaterial(materials[m]);
+        for (uint32_t mesh = 0; mesh < MESH_COUNT; ++mesh)
+        {
+            RenderGeometry geometry;
+            geometry.pVertexBuffer = FakeHandle<ID3D11Buffer>(FAKE_MESHES + 2 * mesh);
+            geometry.vertexStride = 20;
+            geometry.pIndexBuffer = FakeHandle<ID3D11Buffer>(FAKE_MESHES + 2 * mesh + 1);
+            geometry.indexCount = 36;
+            queue.AddGeometry(geometry);
+        }
+
+        std::vector<BenchDraw> draws(drawCount);
+        uint32_t state = 4242;
+        for (BenchDraw& draw : draws)
+        {
+            draw.material = Random(state) % textures;
+            draw.mesh = Random(state) % MESH_COUNT;
+            draw.depth = NEAR_DEPTH + (FAR_DEPTH - NEAR_DEPTH) * (float)(Random(state) & 0xffff) / 65536.0f;
+        }
+
+        RenderQueueBenchResult result;
+        result.draws = drawCount;
+        result.shaders = shaders;
+        result.textures = textures;
+        result.frames = frames;
+
+        // Scene order, every draw binding everything.
+        std::vector<uint64_t> drawSums(frames);
+        commands.Invalidate();
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            context.ResetCounts();
+            drawSum = 0;
+            commands.BeginFrame();
+            RecordUnsorted(commands, materials, draws, frame);
+            commands.Submit(context);
+            drawSums[frame] = drawSum;
+        }
+        result.unsortedFrameNs = ElapsedNs(start, BenchClock::now()) / ((double)frames * drawCount);
+        result.unsortedBinds = GetBinds(context);
+
+        // Through the queue with the default buckets.
+        start = BenchClock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            context.ResetCounts();
+            drawSum = 0;
+            commands.BeginFrame();
+            QueueDraws(queue, materials, materialIds, draws, frame);
+            queue.Submit(commands, setConstants);
+            commands.Submit(context);
+            result.sameDraws = result.sameDraws && drawSum == drawSums[frame] &&
+                context.GetDrawCount() == drawCount;
+        }
+        result.sortedFrameNs = ElapsedNs(start, BenchClock::now()) / ((double)frames * drawCount);
+        result.sortedBinds = GetBinds(context);
+        result.queueChanges = queue.GetStats().GetTotalChanges();
+        result.orderValid = CheckOrder(queue, materials, draws);
+
+        // Keys alone: the radix sort against std::stable_sort, which has to
+        // give the same order since both keep equal keys in queue order.
+        std::vector<std::pair<uint64_t, uint32_t>> entries(drawCount);
+        double radixNs = 0.0, stdNs = 0.0;
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            start = BenchClock::now();
+            QueueDraws(queue, materials, materialIds, draws, frame);
+            queue.Sort();
+            radixNs += ElapsedNs(start, BenchClock::now());
+
+            start = BenchClock::now();
+            QueueDraws(queue, materials, materialIds, draws, frame);
+            for (uint32_t i = 0; i < drawCount; ++i)
+                entries[i] = std::make_pair(queue.GetKey(i), i);
+            std::stable_sort(entries.begin(), entries.end(),
+                [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b)
+                {
+                    return a.first < b.first;
+                });
+            stdNs += ElapsedNs(start, BenchClock::now());
+
+            queue.Sort();
+            for (uint32_t i = 0; i < drawCount; ++i)
+                result.matchesStdSort = result.matchesStdSort && queue.GetOrder()[i] == entries[i].second;
+        }
+        result.radixSortNs = radixNs / ((double)frames * drawCount);
+        result.stdSortNs = stdNs / ((double)frames * drawCount);
+
+        // By state alone.
+        queue.SetDepthBucketBits(0);
+        context.ResetCounts();
+        drawSum = 0;
+        commands.BeginFrame();
+        QueueDraws(queue, materials, materialIds, draws, 0);
+        queue.Submit(commands, setConstants);
+        commands.Submit(context);
+        result.stateOnlyBinds = GetBinds(context);
+        result.sameDraws = result.sameDraws && drawSum == drawSums[0];
+
+        results.push_back(result);
+    }
+}
+
+bool WriteRenderQueueBenchmarkCsv(const char* filename, const std::vector<RenderQueueBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "draws,shaders,textures,frames,unsorted_binds,sorted_binds,state_only_binds,queue_changes,"
+        "radix_sort_ns,std_sort_ns,unsorted_frame_ns,sorted_frame_ns,order_valid,matches_std_sort,same_draws\n");
+    for (const RenderQueueBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%u,%u,%u,%u,%u,%u,%.2f,%.2f,%.2f,%.2f,%d,%d,%d\n",
+            r.draws, r.shaders, r.textures, r.frames, r.unsortedBinds, r.sortedBinds, r.stateOnlyBinds,
+            r.queueChanges, r.radixSortNs, r.stdSortNs, r.unsortedFrameNs, r.sortedFrameNs,
+            r.orderValid ? 1 : 0, r.matchesStdSort ? 1 : 0, r.sameDraws ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
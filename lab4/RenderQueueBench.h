@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// A synthetic frame of N draws, each with a random mesh out of 16, a random
+// shader and texture out of the row's counts and a random depth; one in
+// five is transparent. "unsorted" records the draws in scene order the way
+// the labs do, every draw setting all of its state through the
+// CommandRecorder; "sorted" goes through RenderQueue, once with its default
+// depth buckets and once sorting by state alone. The bind columns count the
+// shader, texture, sampler, render state and geometry binds that reach the
+// context per frame, after the recorder's redundant-bind elimination. Times
+// are nanoseconds per draw: building and sorting keys with the radix sort
+// and with std::stable_sort, and the whole frame, recording and replay
+// included.
+struct RenderQueueBenchResult
+{
+    uint32_t draws = 0;
+    uint32_t shaders = 0;
+    uint32_t textures = 0;
+    uint32_t frames = 0;
+    uint32_t unsortedBinds = 0;
+    uint32_t sortedBinds = 0;
+    uint32_t stateOnlyBinds = 0;        // no depth buckets
+    uint32_t queueChanges = 0;          // RenderQueueStats::GetTotalChanges(), default buckets
+    double radixSortNs = 0.0;
+    double stdSortNs = 0.0;
+    double unsortedFrameNs = 0.0;
+    double sortedFrameNs = 0.0;
+    bool orderValid = true;             // passes in order, transparent back to front, opaque buckets front to back
+    bool matchesStdSort = true;
+    bool sameDraws = true;              // both paths drew the same set with the same constants
+};
+
+void RunRenderQueueBenchmark(const uint32_t* pDraws, const uint32_t* pShaders, const uint32_t* pTextures,
+    uint32_t rowCount, uint32_t frames, std::vector<RenderQueueBenchResult>& results);
+
+bool WriteRenderQueueBenchmarkCsv(const char* filename, const std::vector<RenderQueueBenchResult>& results);
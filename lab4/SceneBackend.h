@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class LabScene;
+
+// Something that can draw a LabScene into its own colour target and hand
+// the pixels back. The D3D11 renderer is one; the CPU reference renderer
+// lets the same frame loop run on machines without a GPU.
+class ISceneBackend
+{
+public:
+    virtual ~ISceneBackend() {}
+
+    virtual const char* GetName() const = 0;
+    virtual uint32_t GetWidth() const = 0;
+    virtual uint32_t GetHeight() const = 0;
+
+    virtual void RenderFrame(const LabScene& scene) = 0;
+
+    // Blocks until the last frame has finished rendering, so timings cover
+    // the work and not just its submission.
+    virtual void Finish() {}
+
+    // Copies the colour target out as tightly packed RGBA8.
+    virtual bool ReadPixels(std::vector<uint8_t>& rgba) = 0;
+};
@@ -0,0 +1,512 @@
+#include "SceneBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const uint32_t BIN_COUNT = 12;
+
+    // Past this depth splits go by the median, so no leaf is deeper than
+    // 32 more levels whatever the input and the traversal stacks can be
+    // fixed arrays.
+    const uint32_t MAX_SAH_DEPTH = 32;
+    const int STACK_SIZE = 80;
+
+    // Cost of visiting a node relative to testing one sphere.
+    const float TRAVERSAL_COST = 1.0f;
+
+    void Union(const BvhNode& a, const BvhNode& b, BvhNode& out)
+    {
+        out.minX = std::min(a.minX, b.minX);
+        out.minY = std::min(a.minY, b.minY);
+        out.minZ = std::min(a.minZ, b.minZ);
+        out.maxX = std::max(a.maxX, b.maxX);
+        out.maxY = std::max(a.maxY, b.maxY);
+        out.maxZ = std::max(a.maxZ, b.maxZ);
+    }
+
+    // Entry and exit of the ray against the node's slabs, clipped to
+    // [0, maxDistance]; false if it misses.
+    bool IntersectNode(const BvhNode& node, const float origin[3], const float invDirection[3], float maxDistance,
+        float& entry)
+    {
+        float t0 = (node.minX - origin[0]) * invDirection[0];
+        float t1 = (node.maxX - origin[0]) * invDirection[0];
+        float tEntry = std::min(t0, t1), tExit = std::max(t0, t1);
+
+        t0 = (node.minY - origin[1]) * invDirection[1];
+        t1 = (node.maxY - origin[1]) * invDirection[1];
+        tEntry = std::max(tEntry, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+
+        t0 = (node.minZ - origin[2]) * invDirection[2];
+        t1 = (node.maxZ - origin[2]) * invDirection[2];
+        tEntry = std::max(tEntry, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+
+        entry = std::max(tEntry, 0.0f);
+        return entry <= std::min(tExit, maxDistance);
+    }
+}
+
+struct SceneBvh::BuildBox
+{
+    float min[3];
+    float max[3];
+
+    void Clear()
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            min[k] = std::numeric_limits<float>::max();
+            max[k] = -std::numeric_limits<float>::max();
+        }
+    }
+
+    void Grow(const float lo[3], const float hi[3])
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            min[k] = std::min(min[k], lo[k]);
+            max[k] = std::max(max[k], hi[k]);
+        }
+    }
+
+    void Grow(const BuildBox& other) { Grow(other.min, other.max); }
+
+    // Half the surface area, which is all the heuristic needs.
+    float HalfArea() const
+    {
+        const float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        if (dx < 0.0f)
+            return 0.0f;
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+void SceneBvh::Build(const BoundingSpheres& spheres)
+{
+    const uint32_t count = (uint32_t)spheres.Size();
+    m_nodes.clear();
+    m_items.resize(count);
+    if (count == 0)
+        return;
+
+    BuildBox bounds, centres;
+    bounds.Clear();
+    centres.Clear();
+    m_build.resize(count);
+    m_buildScratch.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        BuildItem& item = m_build[i];
+        const float centre[3] = { spheres.x[i], spheres.y[i], spheres.z[i] };
+        for (int k = 0; k < 3; ++k)
+        {
+            item.min[k] = centre[k] - spheres.radius[i];
+            item.max[k] = centre[k] + spheres.radius[i];
+            item.centre[k] = centre[k];
+        }
+        item.index = i;
+        bounds.Grow(item.min, item.max);
+        centres.Grow(item.centre, item.centre);
+    }
+
+    // A binary tree with single-object leaves at worst, so this never
+    // reallocates and node references stay valid while it recurses.
+    m_nodes.reserve(2 * (size_t)count - 1);
+    BuildNode(0, count, 0, bounds, centres);
+
+    for (uint32_t n = 0; n < count; ++n)
+        m_items[n] = m_build[n].index;
+}
+
+uint32_t SceneBvh::BuildNode(uint32_t first, uint32_t count, uint32_t depth, const BuildBox& bounds,
+    const BuildBox& centres)
+{
+    const uint32_t index = (uint32_t)m_nodes.size();
+    m_nodes.push_back(BvhNode());
+    {
+        BvhNode& node = m_nodes[index];
+        node.minX = bounds.min[0]; node.minY = bounds.min[1]; node.minZ = bounds.min[2];
+        node.maxX = bounds.max[0]; node.maxY = bounds.max[1]; node.maxZ = bounds.max[2];
+        node.offset = first;
+        node.count = count;
+    }
+    if (count <= MAX_LEAF_SIZE)
+        return index;
+
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (centres.max[k] - centres.min[k] > centres.max[axis] - centres.min[axis])
+            axis = k;
+    }
+
+    // Binned SAH along the axis the centres spread furthest on: the cost
+    // of a split is a visit plus each side's sphere count weighted by the
+    // chance a ray through this node also passes through that side's box.
+    // Binning one axis instead of three costs little tree quality and a
+    // third of the build time.
+    struct Bin
+    {
+        BuildBox bounds;
+        uint32_t count;
+    };
+
+    BuildItem* pItems = m_build.data() + first;
+    const float extent = centres.max[axis] - centres.min[axis];
+    const float nodeArea = bounds.HalfArea();
+    uint32_t bestSplit = 0;
+    BuildBox leftBounds, leftCentres, rightBounds, rightCentres;
+    if (depth < MAX_SAH_DEPTH && extent > 0.0f && nodeArea > 0.0f)
+    {
+        Bin bins[BIN_COUNT];
+        for (Bin& bin : bins)
+        {
+            bin.bounds.Clear();
+            bin.count = 0;
+        }
+
+        const float scale = (float)BIN_COUNT / extent;
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            const BuildItem& item = pItems[n];
+            Bin& bin = bins[std::min(BIN_COUNT - 1, (uint32_t)((item.centre[axis] - centres.min[axis]) * scale))];
+            bin.bounds.Grow(item.min, item.max);
+            ++bin.count;
+        }
+
+        // Right-hand sides first, then sweep the split plane left to right.
+        float rightArea[BIN_COUNT];
+        uint32_t rightCount[BIN_COUNT];
+        BuildBox side;
+        side.Clear();
+        uint32_t sideCount = 0;
+        for (uint32_t split = BIN_COUNT - 1; split > 0; --split)
+        {
+            side.Grow(bins[split].bounds);
+            sideCount += bins[split].count;
+            rightArea[split] = side.HalfArea();
+            rightCount[split] = sideCount;
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        side.Clear();
+        sideCount = 0;
+        for (uint32_t split = 1; split < BIN_COUNT; ++split)
+        {
+            side.Grow(bins[split - 1].bounds);
+            sideCount += bins[split - 1].count;
+            if (sideCount == 0 || rightCount[split] == 0)
+                continue;
+
+            const float cost = TRAVERSAL_COST +
+                (side.HalfArea() * (float)sideCount + rightArea[split] * (float)rightCount[split]) / nodeArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = split;
+            }
+        }
+
+        if (bestSplit > 0)
+        {
+            leftBounds.Clear();
+            rightBounds.Clear();
+            for (uint32_t b = 0; b < BIN_COUNT; ++b)
+                (b < bestSplit ? leftBounds : rightBounds).Grow(bins[b].bounds);
+        }
+    }
+
+    uint32_t leftCount = 0;
+    if (bestSplit > 0)
+    {
+        const float minCentre = centres.min[axis];
+        const float scale = (float)BIN_COUNT / extent;
+        // Out of place and branch-free: which side an item lands on is
+        // close to random, so a swapping partition mispredicts half the
+        // time. Left items fill the scratch from the front, right ones
+        // from the back.
+        BuildItem* pScratch = m_buildScratch.data();
+        uint32_t left = 0, right = count;
+        leftCentres.Clear();
+        rightCentres.Clear();
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            const BuildItem& item = pItems[n];
+            const bool isLeft = std::min(BIN_COUNT - 1, (uint32_t)((item.centre[axis] - minCentre) * scale)) < bestSplit;
+            (isLeft ? leftCentres : rightCentres).Grow(item.centre, item.centre);
+            right -= isLeft ? 0 : 1;
+            pScratch[isLeft ? left : right] = item;
+            left += isLeft ? 1 : 0;
+        }
+        std::copy(pScratch, pScratch + count, pItems);
+        leftCount = left;
+    }
+
+    if (leftCount == 0 || leftCount == count)
+    {
+        // Too deep for the heuristic, or every centre in one spot: halve
+        // the range at the median centre and measure both halves.
+        leftCount = count / 2;
+        std::nth_element(pItems, pItems + leftCount, pItems + count, [&](const BuildItem& a, const BuildItem& b) {
+            return a.centre[axis] < b.centre[axis];
+        });
+
+        leftBounds.Clear(); leftCentres.Clear();
+        rightBounds.Clear(); rightCentres.Clear();
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            (n < leftCount ? leftBounds : rightBounds).Grow(pItems[n].min, pItems[n].max);
+            (n < leftCount ? leftCentres : rightCentres).Grow(pItems[n].centre, pItems[n].centre);
+        }
+    }
+
+    BuildNode(first, leftCount, depth + 1, leftBounds, leftCentres);
+    const uint32_t right = BuildNode(first + leftCount, count - leftCount, depth + 1, rightBounds, rightCentres);
+
+    BvhNode& node = m_nodes[index];
+    node.offset = right;
+    node.count = count | BvhNode::INTERIOR;
+    return index;
+}
+
+void SceneBvh::SetLeafBounds(BvhNode& node, const BoundingSpheres& spheres) const
+{
+    float minX = std::numeric_limits<float>::max(), minY = minX, minZ = minX;
+    float maxX = -minX, maxY = -minX, maxZ = -minX;
+    for (uint32_t n = node.offset; n < node.offset + node.count; ++n)
+    {
+        const uint32_t i = m_items[n];
+        const float r = spheres.radius[i];
+        minX = std::min(minX, spheres.x[i] - r); maxX = std::max(maxX, spheres.x[i] + r);
+        minY = std::min(minY, spheres.y[i] - r); maxY = std::max(maxY, spheres.y[i] + r);
+        minZ = std::min(minZ, spheres.z[i] - r); maxZ = std::max(maxZ, spheres.z[i] + r);
+    }
+    node.minX = minX; node.minY = minY; node.minZ = minZ;
+    node.maxX = maxX; node.maxY = maxY; node.maxZ = maxZ;
+}
+
+void SceneBvh::Refit(const BoundingSpheres& spheres)
+{
+    if (spheres.Size() != m_items.size())
+    {
+        Build(spheres);
+        return;
+    }
+
+    // Children always come after their parent, so walking backwards sees
+    // both before it reaches the node that joins them.
+    for (size_t n = m_nodes.size(); n-- > 0;)
+    {
+        BvhNode& node = m_nodes[n];
+        if (node.IsLeaf())
+            SetLeafBounds(node, spheres);
+        else
+            Union(m_nodes[n + 1], m_nodes[node.offset], node);
+    }
+}
+
+size_t SceneBvh::CullFrustum(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint32_t* pVisible) const
+{
+    if (m_nodes.empty())
+        return 0;
+
+    // Each entry carries the planes its box still straddles; a plane the
+    // box is wholly inside of is not tested again further down. first is
+    // where the node's objects start in m_items.
+    struct Entry
+    {
+        uint32_t node;
+        uint32_t first;
+        uint32_t planeMask;
+    };
+    const uint32_t ALL_PLANES = 0x3f;
+
+    Entry stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = { 0, 0, ALL_PLANES };
+
+    size_t visible = 0;
+    while (top > 0)
+    {
+        const Entry entry = stack[--top];
+        const BvhNode& node = m_nodes[entry.node];
+
+        const float cx = 0.5f * (node.minX + node.maxX), ex = 0.5f * (node.maxX - node.minX);
+        const float cy = 0.5f * (node.minY + node.maxY), ey = 0.5f * (node.maxY - node.minY);
+        const float cz = 0.5f * (node.minZ + node.maxZ), ez = 0.5f * (node.maxZ - node.minZ);
+
+        uint32_t mask = entry.planeMask;
+        bool outside = false;
+        for (int p = 0; p < 6; ++p)
+        {
+            if ((mask & (1u << p)) == 0)
+                continue;
+            const float centre = planes.a[p] * cx + planes.b[p] * cy + planes.c[p] * cz + planes.d[p];
+            const float extent = std::fabs(planes.a[p]) * ex + std::fabs(planes.b[p]) * ey + std::fabs(planes.c[p]) * ez;
+            if (centre + extent < 0.0f)
+            {
+                outside = true;
+                break;
+            }
+            if (centre - extent >= 0.0f)
+                mask &= ~(1u << p);
+        }
+        if (outside)
+            continue;
+
+        // Wholly inside: every sphere below is too.
+        if (mask == 0)
+        {
+            const uint32_t* pItems = m_items.data() + entry.first;
+            std::copy(pItems, pItems + node.GetObjectCount(), pVisible + visible);
+            visible += node.GetObjectCount();
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            // Only the planes the leaf straddles; the sums are done in
+            // CullSpheres' order so both keep the same spheres.
+            for (uint32_t n = node.offset; n < node.offset + node.count; ++n)
+            {
+                const uint32_t i = m_items[n];
+                const float negRadius = -spheres.radius[i];
+                bool inside = true;
+                for (int p = 0; p < 6; ++p)
+                {
+                    if ((mask & (1u << p)) == 0)
+                        continue;
+                    const float distance = ((planes.a[p] * spheres.x[i] + planes.b[p] * spheres.y[i]) +
+                        planes.c[p] * spheres.z[i]) + planes.d[p];
+                    inside &= distance >= negRadius;
+                }
+                pVisible[visible] = i;
+                visible += inside ? 1 : 0;
+            }
+            continue;
+        }
+
+        const uint32_t left = entry.node + 1;
+        stack[top++] = { node.offset, entry.first + m_nodes[left].GetObjectCount(), mask };
+        stack[top++] = { left, entry.first, mask };
+    }
+    return visible;
+}
+
+bool SceneBvh::Raycast(const float origin[3], const float direction[3], float maxDistance,
+    const BoundingSpheres& spheres, BvhRayHit& hit) const
+{
+    const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+    if (m_nodes.empty() || !(a > 0.0f))
+        return false;
+
+    const float invDirection[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+    float nearest = maxDistance;
+    bool found = false;
+
+    float entry;
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BvhNode& node = m_nodes[stack[--top]];
+        if (!IntersectNode(node, origin, invDirection, nearest, entry))
+            continue;
+
+        if (node.IsLeaf())
+        {
+            for (uint32_t n = node.offset; n < node.offset + node.count; ++n)
+            {
+                const uint32_t i = m_items[n];
+                const float ox = origin[0] - spheres.x[i];
+                const float oy = origin[1] - spheres.y[i];
+                const float oz = origin[2] - spheres.z[i];
+                const float b = ox * direction[0] + oy * direction[1] + oz * direction[2];
+                const float c = ox * ox + oy * oy + oz * oz - spheres.radius[i] * spheres.radius[i];
+                const float discriminant = b * b - a * c;
+                if (discriminant < 0.0f)
+                    continue;
+
+                const float root = std::sqrt(discriminant);
+                const float exit = (-b + root) / a;
+                if (exit < 0.0f)
+                    continue;
+                const float t = std::max((-b - root) / a, 0.0f);
+                if (t <= nearest)
+                {
+                    nearest = t;
+                    hit.index = i;
+                    hit.distance = t;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Nearer child on top so it is searched first and shortens the ray
+        // for the other one.
+        const uint32_t left = (uint32_t)(&node - m_nodes.data()) + 1;
+        const uint32_t right = node.offset;
+        float leftEntry, rightEntry;
+        const bool hitLeft = IntersectNode(m_nodes[left], origin, invDirection, nearest, leftEntry);
+        const bool hitRight = IntersectNode(m_nodes[right], origin, invDirection, nearest, rightEntry);
+        if (hitLeft && hitRight)
+        {
+            const bool leftFirst = leftEntry <= rightEntry;
+            stack[top++] = leftFirst ? right : left;
+            stack[top++] = leftFirst ? left : right;
+        }
+        else if (hitLeft)
+            stack[top++] = left;
+        else if (hitRight)
+            stack[top++] = right;
+    }
+    return found;
+}
+
+size_t SceneBvh::QuerySphere(float x, float y, float z, float radius, const BoundingSpheres& spheres,
+    uint32_t* pOut) const
+{
+    if (m_nodes.empty())
+        return 0;
+
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    size_t found = 0;
+    while (top > 0)
+    {
+        const uint32_t index = stack[--top];
+        const BvhNode& node = m_nodes[index];
+
+        // Squared distance from the query centre to the box.
+        const float dx = std::max(std::max(node.minX - x, x - node.maxX), 0.0f);
+        const float dy = std::max(std::max(node.minY - y, y - node.maxY), 0.0f);
+        const float dz = std::max(std::max(node.minZ - z, z - node.maxZ), 0.0f);
+        if (dx * dx + dy * dy + dz * dz > radius * radius)
+            continue;
+
+        if (node.IsLeaf())
+        {
+            for (uint32_t n = node.offset; n < node.offset + node.count; ++n)
+            {
+                const uint32_t i = m_items[n];
+                const float sx = spheres.x[i] - x, sy = spheres.y[i] - y, sz = spheres.z[i] - z;
+                const float reach = radius + spheres.radius[i];
+                pOut[found] = i;
+                found += sx * sx + sy * sy + sz * sz <= reach * reach ? 1 : 0;
+            }
+            continue;
+        }
+
+        stack[top++] = node.offset;
+        stack[top++] = index + 1;
+    }
+    return found;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "FrustumCull.h"
+
+// One node of the flattened hierarchy, 32 bytes. Nodes are stored depth
+// first: an interior node's left child is the next node and offset holds
+// its right child. A leaf's objects are m_items[offset, offset + count).
+// Interior nodes keep their subtree's object count with INTERIOR set, so a
+// query that finds a whole subtree inside can copy its objects straight
+// out of m_items; they are contiguous.
+struct BvhNode
+{
+    float minX, minY, minZ;
+    uint32_t offset;
+    float maxX, maxY, maxZ;
+    uint32_t count;
+
+    static const uint32_t INTERIOR = 0x80000000u;
+
+    bool IsLeaf() const { return (count & INTERIOR) == 0; }
+    uint32_t GetObjectCount() const { return count & ~INTERIOR; }
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode should stay two to a cache line");
+
+struct BvhRayHit
+{
+    uint32_t index;     // object
+    float distance;     // along the ray, in units of its direction's length
+};
+
+// Bounding volume hierarchy over a set of bounding spheres. Build() splits
+// with a binned surface area heuristic and suits objects that stay put;
+// Refit() keeps the tree and only recomputes the node bounds, for objects
+// that move a little every frame. The tree degrades as they drift away
+// from where it was built, so a scene that rearranges itself should build
+// again now and then.
+class SceneBvh
+{
+public:
+    static const uint32_t MAX_LEAF_SIZE = 4;
+
+    void Build(const BoundingSpheres& spheres);
+
+    // Builds instead if the number of objects changed.
+    void Refit(const BoundingSpheres& spheres);
+
+    // The same spheres CullSpheres() keeps, written to pVisible in tree
+    // order rather than ascending; pVisible needs room for every object.
+    size_t CullFrustum(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint32_t* pVisible) const;
+
+    // Nearest sphere the ray origin + t * direction enters for 0 <= t <=
+    // maxDistance; a sphere around the origin is hit at 0.
+    bool Raycast(const float origin[3], const float direction[3], float maxDistance,
+        const BoundingSpheres& spheres, BvhRayHit& hit) const;
+
+    // Spheres that overlap the query sphere, in tree order; pOut needs room
+    // for every object.
+    size_t QuerySphere(float x, float y, float z, float radius, const BoundingSpheres& spheres,
+        uint32_t* pOut) const;
+
+    uint32_t GetObjectCount() const { return (uint32_t)m_items.size(); }
+    uint32_t GetNodeCount() const { return (uint32_t)m_nodes.size(); }
+    const BvhNode* GetNodes() const { return m_nodes.data(); }
+
+private:
+    // Build scratch, one per object. The build partitions these rather
+    // than indices, so every pass over a range reads memory in order.
+    struct BuildItem
+    {
+        float min[3];
+        float max[3];
+        float centre[3];
+        uint32_t index;
+    };
+
+    struct BuildBox;
+
+    // bounds and centres are those of the range; the parent already has
+    // them from its bins, so the range is not read an extra time.
+    uint32_t BuildNode(uint32_t first, uint32_t count, uint32_t depth, const BuildBox& bounds,
+        const BuildBox& centres);
+    void SetLeafBounds(BvhNode& node, const BoundingSpheres& spheres) const;
+
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_items;
+    std::vector<BuildItem> m_build;
+    std::vector<BuildItem> m_buildScratch;
+};
@@ -0,0 +1,222 @@
+#include "SceneBvhBench.h"
+#include "BenchUtil.h"
+#include "CameraPath.h"
+#include "LabScene.h"
+#include "SceneBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Unit cubes of scale 0.25 to 1 anywhere within 100 units of the origin.
+    void BuildSpheres(BoundingSpheres& spheres, uint32_t count)
+    {
+        spheres.Resize(count);
+        uint32_t state = 4242;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            spheres.x[i] = Random(state) * 200.0f - 100.0f;
+            spheres.y[i] = Random(state) * 200.0f - 100.0f;
+            spheres.z[i] = Random(state) * 200.0f - 100.0f;
+            spheres.radius[i] = 0.8660254f * (0.25f + 0.75f * Random(state));
+        }
+    }
+
+    void Drift(BoundingSpheres& spheres)
+    {
+        uint32_t state = 777;
+        for (size_t i = 0; i < spheres.Size(); ++i)
+        {
+            spheres.x[i] += Random(state) - 0.5f;
+            spheres.y[i] += Random(state) - 0.5f;
+            spheres.z[i] += Random(state) - 0.5f;
+        }
+    }
+
+    struct View
+    {
+        FrustumPlanes planes;
+        float eye[3];
+    };
+
+    void BuildViews(uint32_t count, std::vector<View>& views)
+    {
+        const CameraPath path = CameraPath::MakeOrbit(10.0f);
+        const Float4x4 proj = MatrixPerspectiveFovLH(LabScene::FOV_Y, 16.0f / 9.0f, LabScene::NEAR_Z,
+            LabScene::FAR_Z);
+        Camera camera;
+        views.resize(count);
+        for (uint32_t v = 0; v < count; ++v)
+        {
+            float yaw, pitch, distance;
+            path.Evaluate(path.GetDuration() * (float)v / (float)count, yaw, pitch, distance);
+            camera.SetOrbit(yaw, pitch, distance);
+            views[v].planes = ExtractFrustumPlanes(MatrixMultiply(camera.GetViewMatrix(), proj));
+            camera.GetEyePosition(views[v].eye);
+        }
+    }
+
+    // Times the hierarchy over every view and checks it against the linear
+    // cull; returns microseconds per view.
+    double TimeBvhCull(const SceneBvh& bvh, const BoundingSpheres& spheres, const std::vector<View>& views,
+        std::vector<uint32_t>& visible, std::vector<uint32_t>& expected, bool& matches)
+    {
+        for (const View& view : views)
+        {
+            expected.resize(spheres.Size());
+            expected.resize(CullSpheres(view.planes, spheres, expected.data()));
+            visible.resize(spheres.Size());
+            visible.resize(bvh.CullFrustum(view.planes, spheres, visible.data()));
+            std::sort(visible.begin(), visible.end());
+            if (visible != expected)
+                matches = false;
+        }
+
+        visible.resize(spheres.Size());
+        BenchClock::time_point start = BenchClock::now();
+        for (const View& view : views)
+            bvh.CullFrustum(view.planes, spheres, visible.data());
+        return ElapsedNs(start, BenchClock::now()) / (1000.0 * views.size());
+    }
+
+    bool RaycastAll(const BoundingSpheres& s, const float origin[3], const float direction[3], float maxDistance,
+        BvhRayHit& hit)
+    {
+        const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+        bool found = false;
+        for (uint32_t i = 0; i < (uint32_t)s.Size(); ++i)
+        {
+            const float ox = origin[0] - s.x[i], oy = origin[1] - s.y[i], oz = origin[2] - s.z[i];
+            const float b = ox * direction[0] + oy * direction[1] + oz * direction[2];
+            const float c = ox * ox + oy * oy + oz * oz - s.radius[i] * s.radius[i];
+            const float discriminant = b * b - a * c;
+            if (discriminant < 0.0f)
+                continue;
+            const float root = std::sqrt(discriminant);
+            if ((-b + root) / a < 0.0f)
+                continue;
+            const float t = std::max((-b - root) / a, 0.0f);
+            if (t <= maxDistance && (!found || t < hit.distance))
+            {
+                hit.index = i;
+                hit.distance = t;
+                found = true;
+            }
+        }
+        return found;
+    }
+}
+
+void RunSceneBvhBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t views, uint32_t rays,
+    std::vector<SceneBvhBenchResult>& results)
+{
+    if (views == 0)
+        views = 1;
+
+    std::vector<View> viewList;
+    BuildViews(views, viewList);
+
+    // Rays from the eyes of the orbit through random points of the cube.
+    std::vector<float> rayData(6 * (size_t)rays);
+    uint32_t state = 99;
+    for (uint32_t r = 0; r < rays; ++r)
+    {
+        const View& view = viewList[r % views];
+        float* pRay = &rayData[6 * (size_t)r];
+        for (int k = 0; k < 3; ++k)
+        {
+            pRay[k] = view.eye[k];
+            pRay[3 + k] = Random(state) * 200.0f - 100.0f - view.eye[k];
+        }
+    }
+    const uint32_t CHECKED_RAYS = 64;
+    const float MAX_DISTANCE = 2.0f;    // rays reach twice as far as their target point
+
+    BoundingSpheres spheres;
+    SceneBvh bvh;
+    std::vector<uint32_t> visible, expected;
+
+    for (uint32_t s = 0; s < sizeCount; ++s)
+    {
+        const uint32_t count = pSizes[s];
+        if (count == 0)
+            continue;
+
+        SceneBvhBenchResult result;
+        result.objectCount = count;
+        BuildSpheres(spheres, count);
+
+        BenchClock::time_point start = BenchClock::now();
+        bvh.Build(spheres);
+        result.buildMs = ElapsedNs(start, BenchClock::now()) / 1e6;
+        result.nodeCount = bvh.GetNodeCount();
+
+        size_t visibleTotal = 0;
+        visible.resize(count);
+        for (const View& view : viewList)
+            visibleTotal += CullSpheres(view.planes, spheres, visible.data());
+        result.visibleFraction = (double)visibleTotal / ((double)views * count);
+
+        start = BenchClock::now();
+        for (const View& view : viewList)
+            CullSpheres(view.planes, spheres, visible.data());
+        result.linearCullUs = ElapsedNs(start, BenchClock::now()) / (1000.0 * views);
+
+        result.bvhCullUs = TimeBvhCull(bvh, spheres, viewList, visible, expected, result.cullMatches);
+
+        uint32_t hits = 0;
+        for (uint32_t r = 0; r < std::min(rays, CHECKED_RAYS); ++r)
+        {
+            const float* pRay = &rayData[6 * (size_t)r];
+            BvhRayHit hit = {}, reference = {};
+            const bool found = bvh.Raycast(pRay, pRay + 3, MAX_DISTANCE, spheres, hit);
+            const bool foundReference = RaycastAll(spheres, pRay, pRay + 3, MAX_DISTANCE, reference);
+            if (found != foundReference || (found && hit.distance != reference.distance))
+                result.raysMatch = false;
+        }
+
+        start = BenchClock::now();
+        for (uint32_t r = 0; r < rays; ++r)
+        {
+            const float* pRay = &rayData[6 * (size_t)r];
+            BvhRayHit hit;
+            hits += bvh.Raycast(pRay, pRay + 3, MAX_DISTANCE, spheres, hit) ? 1 : 0;
+        }
+        result.raysPerMs = rays > 0 ? (double)rays * 1e6 / ElapsedNs(start, BenchClock::now()) : 0.0;
+        (void)hits;
+
+        Drift(spheres);
+        start = BenchClock::now();
+        bvh.Refit(spheres);
+        result.refitMs = ElapsedNs(start, BenchClock::now()) / 1e6;
+        result.refitCullUs = TimeBvhCull(bvh, spheres, viewList, visible, expected, result.cullMatches);
+
+        results.push_back(result);
+    }
+}
+
+bool WriteSceneBvhBenchmarkCsv(const char* filename, const std::vector<SceneBvhBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,nodes,build_ms,refit_ms,linear_cull_us,bvh_cull_us,refit_cull_us,visible_fraction,"
+        "rays_per_ms,cull_matches,rays_match\n");
+    for (const SceneBvhBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%.3f,%.3f,%.1f,%.1f,%.1f,%.3f,%.1f,%d,%d\n",
+            r.objectCount, r.nodeCount, r.buildMs, r.refitMs, r.linearCullUs, r.bvhCullUs, r.refitCullUs,
+            r.visibleFraction, r.raysPerMs, r.cullMatches ? 1 : 0, r.raysMatch ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
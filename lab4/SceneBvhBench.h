@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// SceneBvh over N spheres spread through a 200-unit cube. Build and refit
+// are milliseconds; the refit follows every object drifting by up to half
+// a unit. The frustum columns are microseconds per view along the scripted
+// orbit, the hierarchy against the widest CullSpheres kernel, and are timed
+// once on the fresh tree and once after the refit. Rays go from the orbit
+// eye through random points of the cube.
+struct SceneBvhBenchResult
+{
+    uint32_t objectCount = 0;
+    uint32_t nodeCount = 0;
+    double buildMs = 0.0;
+    double refitMs = 0.0;
+    double linearCullUs = 0.0;
+    double bvhCullUs = 0.0;
+    double refitCullUs = 0.0;
+    double visibleFraction = 0.0;
+    double raysPerMs = 0.0;
+    bool cullMatches = true;    // same spheres as CullSpheres, before and after the refit
+    bool raysMatch = true;      // same nearest hit as testing every sphere, on a sample of rays
+};
+
+void RunSceneBvhBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t views, uint32_t rays,
+    std::vector<SceneBvhBenchResult>& results);
+
+bool WriteSceneBvhBenchmarkCsv(const char* filename, const std::vector<SceneBvhBenchResult>& results);
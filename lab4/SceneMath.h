@@ -0,0 +1,79 @@
+#pragma once
+#include <cmath>
+
+// Minimal matrix helpers for code that must build without DirectXMath.
+// Same conventions as DirectXMath: row vectors (p' = p * M), row-major
+// storage and left-handed view/projection, so a Float4x4 can be loaded
+// straight into an XMMATRIX with XMLoadFloat4x4.
+struct Float4x4
+{
+    float m[4][4];
+};
+
+inline Float4x4 MatrixIdentity()
+{
+    Float4x4 r = { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+    return r;
+}
+
+inline Float4x4 MatrixMultiply(const Float4x4& a, const Float4x4& b)
+{
+    Float4x4 r;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] +
+                a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+    return r;
+}
+
+inline Float4x4 MatrixTranspose(const Float4x4& a)
+{
+    Float4x4 r;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            r.m[i][j] = a.m[j][i];
+    return r;
+}
+
+inline Float4x4 MatrixLookAtLH(const float eye[3], const float at[3], const float up[3])
+{
+    float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+    float zl = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    z[0] /= zl; z[1] /= zl; z[2] /= zl;
+
+    float x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+    float xl = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+    x[0] /= xl; x[1] /= xl; x[2] /= xl;
+
+    float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+    Float4x4 r = { {
+        { x[0], y[0], z[0], 0.0f },
+        { x[1], y[1], z[1], 0.0f },
+        { x[2], y[2], z[2], 0.0f },
+        { -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]),
+          -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+          -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f } } };
+    return r;
+}
+
+inline Float4x4 MatrixPerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ)
+{
+    float h = std::cos(0.5f * fovY) / std::sin(0.5f * fovY);
+    float w = h / aspect;
+    float range = farZ / (farZ - nearZ);
+
+    Float4x4 r = { {
+        { w, 0.0f, 0.0f, 0.0f },
+        { 0.0f, h, 0.0f, 0.0f },
+        { 0.0f, 0.0f, range, 1.0f },
+        { 0.0f, 0.0f, -range * nearZ, 0.0f } } };
+    return r;
+}
+
+// (p, 1) * m
+inline void TransformPoint(const Float4x4& m, const float p[3], float out[4])
+{
+    for (int j = 0; j < 4; ++j)
+        out[j] = p[0] * m.m[0][j] + p[1] * m.m[1][j] + p[2] * m.m[2][j] + m.m[3][j];
+}
@@ -0,0 +1,418 @@
+#include "SceneTransforms.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRANSFORM_SSE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_AVX2 1
+#define TRANSFORM_TARGET_AVX2
+#elif defined(__GNUC__)
+#define TRANSFORM_AVX2 1
+#define TRANSFORM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+void SceneTransforms::Resize(size_t count)
+{
+    posX.resize(count, 0.0f);
+    posY.resize(count, 0.0f);
+    posZ.resize(count, 0.0f);
+    rotX.resize(count, 0.0f);
+    rotY.resize(count, 0.0f);
+    rotZ.resize(count, 0.0f);
+    rotW.resize(count, 1.0f);
+    scaleX.resize(count, 1.0f);
+    scaleY.resize(count, 1.0f);
+    scaleZ.resize(count, 1.0f);
+    tintR.resize(count, 1.0f);
+    tintG.resize(count, 1.0f);
+    tintB.resize(count, 1.0f);
+    tintA.resize(count, 1.0f);
+    material.resize(count, 0);
+}
+
+void SceneTransforms::SetPosition(size_t i, float x, float y, float z)
+{
+    posX[i] = x;
+    posY[i] = y;
+    posZ[i] = z;
+}
+
+void SceneTransforms::SetRotation(size_t i, float x, float y, float z, float w)
+{
+    rotX[i] = x;
+    rotY[i] = y;
+    rotZ[i] = z;
+    rotW[i] = w;
+}
+
+void SceneTransforms::SetRotationYaw(size_t i, float yaw)
+{
+    SetRotation(i, 0.0f, std::sin(yaw * 0.5f), 0.0f, std::cos(yaw * 0.5f));
+}
+
+void SceneTransforms::SetScale(size_t i, float x, float y, float z)
+{
+    scaleX[i] = x;
+    scaleY[i] = y;
+    scaleZ[i] = z;
+}
+
+void SceneTransforms::SetTint(size_t i, float r, float g, float b, float a)
+{
+    tintR[i] = r;
+    tintG[i] = g;
+    tintB[i] = b;
+    tintA[i] = a;
+}
+
+// Rotation rows as XMMatrixRotationQuaternion builds them:
+//   r0 = ( 1-2(yy+zz), 2(xy+zw),   2(xz-yw)   )
+//   r1 = ( 2(xy-zw),   1-2(xx+zz), 2(yz+xw)   )
+//   r2 = ( 2(xz+yw),   2(yz-xw),   1-2(xx+yy) )
+// World rows are r0*sx, r1*sy, r2*sz, t; InstanceData stores its columns.
+// The SIMD kernels evaluate the exact same expressions lane-wise, without
+// FMA, so every kernel gives identical bits.
+static void ComputeRecordScalar(const SceneTransforms& s, size_t i, InstanceData& out)
+{
+    float qx = s.rotX[i], qy = s.rotY[i], qz = s.rotZ[i], qw = s.rotW[i];
+    float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    float xw = qx * qw, yw = qy * qw, zw = qz * qw;
+    float sx = s.scaleX[i], sy = s.scaleY[i], sz = s.scaleZ[i];
+
+    out.world[0][0] = sx * (1.0f - 2.0f * (yy + zz));
+    out.world[0][1] = sy * (2.0f * (xy - zw));
+    out.world[0][2] = sz * (2.0f * (xz + yw));
+    out.world[0][3] = s.posX[i];
+
+    out.world[1][0] = sx * (2.0f * (xy + zw));
+    out.world[1][1] = sy * (1.0f - 2.0f * (xx + zz));
+    out.world[1][2] = sz * (2.0f * (yz - xw));
+    out.world[1][3] = s.posY[i];
+
+    out.world[2][0] = sx * (2.0f * (xz - yw));
+    out.world[2][1] = sy * (2.0f * (yz + xw));
+    out.world[2][2] = sz * (1.0f - 2.0f * (xx + yy));
+    out.world[2][3] = s.posZ[i];
+
+    out.tint[0] = s.tintR[i];
+    out.tint[1] = s.tintG[i];
+    out.tint[2] = s.tintB[i];
+    out.tint[3] = s.tintA[i];
+}
+
+#ifdef TRANSFORM_SSE
+
+// Input lanes, in this order: posX..Z, rotX..W, scaleX..Z, tintR..A.
+enum { IN_PX, IN_PY, IN_PZ, IN_QX, IN_QY, IN_QZ, IN_QW, IN_SX, IN_SY, IN_SZ, IN_TR, IN_TG, IN_TB, IN_TA, IN_COUNT };
+
+// v[0..15] hold the 16 record floats for four objects in SoA form; transpose
+// each group of four and write the records front to back.
+#define STORE_RECORDS4(pDst, v)                                   \
+    do {                                                          \
+        _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);                \
+        _MM_TRANSPOSE4_PS(v[4], v[5], v[6], v[7]);                \
+        _MM_TRANSPOSE4_PS(v[8], v[9], v[10], v[11]);              \
+        _MM_TRANSPOSE4_PS(v[12], v[13], v[14], v[15]);            \
+        for (int r = 0; r < 4; ++r)                               \
+        {                                                         \
+            _mm_storeu_ps((pDst)[r].world[0], v[r]);              \
+            _mm_storeu_ps((pDst)[r].world[1], v[4 + r]);          \
+            _mm_storeu_ps((pDst)[r].world[2], v[8 + r]);          \
+            _mm_storeu_ps((pDst)[r].tint, v[12 + r]);             \
+        }                                                         \
+    } while (0)
+
+static inline void ComputeRecords4Sse(const __m128* in, InstanceData* pDst)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    __m128 xx = _mm_mul_ps(in[IN_QX], in[IN_QX]);
+    __m128 yy = _mm_mul_ps(in[IN_QY], in[IN_QY]);
+    __m128 zz = _mm_mul_ps(in[IN_QZ], in[IN_QZ]);
+    __m128 xy = _mm_mul_ps(in[IN_QX], in[IN_QY]);
+    __m128 xz = _mm_mul_ps(in[IN_QX], in[IN_QZ]);
+    __m128 yz = _mm_mul_ps(in[IN_QY], in[IN_QZ]);
+    __m128 xw = _mm_mul_ps(in[IN_QX], in[IN_QW]);
+    __m128 yw = _mm_mul_ps(in[IN_QY], in[IN_QW]);
+    __m128 zw = _mm_mul_ps(in[IN_QZ], in[IN_QW]);
+    __m128 sx = in[IN_SX], sy = in[IN_SY], sz = in[IN_SZ];
+
+    __m128 v[16];
+    v[0] = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+    v[1] = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, zw)));
+    v[2] = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, yw)));
+    v[3] = in[IN_PX];
+
+    v[4] = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, zw)));
+    v[5] = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+    v[6] = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, xw)));
+    v[7] = in[IN_PY];
+
+    v[8] = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, yw)));
+    v[9] = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, xw)));
+    v[10] = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+    v[11] = in[IN_PZ];
+
+    v[12] = in[IN_TR];
+    v[13] = in[IN_TG];
+    v[14] = in[IN_TB];
+    v[15] = in[IN_TA];
+
+    STORE_RECORDS4(pDst, v);
+}
+
+static void GetInputArrays(const SceneTransforms& s, const float* (&arrays)[IN_COUNT])
+{
+    arrays[IN_PX] = s.posX.data();   arrays[IN_PY] = s.posY.data();   arrays[IN_PZ] = s.posZ.data();
+    arrays[IN_QX] = s.rotX.data();   arrays[IN_QY] = s.rotY.data();
+    arrays[IN_QZ] = s.rotZ.data();   arrays[IN_QW] = s.rotW.data();
+    arrays[IN_SX] = s.scaleX.data(); arrays[IN_SY] = s.scaleY.data(); arrays[IN_SZ] = s.scaleZ.data();
+    arrays[IN_TR] = s.tintR.data();  arrays[IN_TG] = s.tintG.data();
+    arrays[IN_TB] = s.tintB.data();  arrays[IN_TA] = s.tintA.data();
+}
+
+static size_t ComputeSse(const SceneTransforms& scene, size_t first, size_t count, InstanceData* pOut)
+{
+    const float* arrays[IN_COUNT];
+    GetInputArrays(scene, arrays);
+
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 in[IN_COUNT];
+        for (int k = 0; k < IN_COUNT; ++k)
+            in[k] = _mm_loadu_ps(arrays[k] + first + n);
+        ComputeRecords4Sse(in, pOut + n);
+    }
+    return n;
+}
+
+static size_t ComputeOrderedSse(const SceneTransforms& scene, const uint32_t* pOrder, size_t count, InstanceData* pOut)
+{
+    const float* arrays[IN_COUNT];
+    GetInputArrays(scene, arrays);
+
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4)
+    {
+        const uint32_t* o = pOrder + n;
+        __m128 in[IN_COUNT];
+        for (int k = 0; k < IN_COUNT; ++k)
+            in[k] = _mm_setr_ps(arrays[k][o[0]], arrays[k][o[1]], arrays[k][o[2]], arrays[k][o[3]]);
+        ComputeRecords4Sse(in, pOut + n);
+    }
+    return n;
+}
+
+#endif
+
+#ifdef TRANSFORM_AVX2
+
+static bool CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX state must be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2).
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+TRANSFORM_TARGET_AVX2
+static inline void ComputeRecords8Avx2(const __m256* in, InstanceData* pDst)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    __m256 xx = _mm256_mul_ps(in[IN_QX], in[IN_QX]);
+    __m256 yy = _mm256_mul_ps(in[IN_QY], in[IN_QY]);
+    __m256 zz = _mm256_mul_ps(in[IN_QZ], in[IN_QZ]);
+    __m256 xy = _mm256_mul_ps(in[IN_QX], in[IN_QY]);
+    __m256 xz = _mm256_mul_ps(in[IN_QX], in[IN_QZ]);
+    __m256 yz = _mm256_mul_ps(in[IN_QY], in[IN_QZ]);
+    __m256 xw = _mm256_mul_ps(in[IN_QX], in[IN_QW]);
+    __m256 yw = _mm256_mul_ps(in[IN_QY], in[IN_QW]);
+    __m256 zw = _mm256_mul_ps(in[IN_QZ], in[IN_QW]);
+    __m256 sx = in[IN_SX], sy = in[IN_SY], sz = in[IN_SZ];
+
+    __m256 w[16];
+    w[0] = _mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))));
+    w[1] = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, zw)));
+    w[2] = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, yw)));
+    w[3] = in[IN_PX];
+
+    w[4] = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, zw)));
+    w[5] = _mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))));
+    w[6] = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, xw)));
+    w[7] = in[IN_PY];
+
+    w[8] = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, yw)));
+    w[9] = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, xw)));
+    w[10] = _mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))));
+    w[11] = in[IN_PZ];
+
+    w[12] = in[IN_TR];
+    w[13] = in[IN_TG];
+    w[14] = in[IN_TB];
+    w[15] = in[IN_TA];
+
+    // Low lanes are objects 0-3, high lanes objects 4-7.
+    __m128 v[16];
+    for (int k = 0; k < 16; ++k)
+        v[k] = _mm256_castps256_ps128(w[k]);
+    STORE_RECORDS4(pDst, v);
+
+    for (int k = 0; k < 16; ++k)
+        v[k] = _mm256_extractf128_ps(w[k], 1);
+    STORE_RECORDS4(pDst + 4, v);
+}
+
+TRANSFORM_TARGET_AVX2
+static size_t ComputeAvx2(const SceneTransforms& scene, size_t first, size_t count, InstanceData* pOut)
+{
+    const float* arrays[IN_COUNT];
+    GetInputArrays(scene, arrays);
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        __m256 in[IN_COUNT];
+        for (int k = 0; k < IN_COUNT; ++k)
+            in[k] = _mm256_loadu_ps(arrays[k] + first + n);
+        ComputeRecords8Avx2(in, pOut + n);
+    }
+    _mm256_zeroupper();
+    return n;
+}
+
+TRANSFORM_TARGET_AVX2
+static size_t ComputeOrderedAvx2(const SceneTransforms& scene, const uint32_t* pOrder, size_t count, InstanceData* pOut)
+{
+    const float* arrays[IN_COUNT];
+    GetInputArrays(scene, arrays);
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        __m256i index = _mm256_loadu_si256((const __m256i*)(pOrder + n));
+        __m256 in[IN_COUNT];
+        for (int k = 0; k < IN_COUNT; ++k)
+            in[k] = _mm256_i32gather_ps(arrays[k], index, 4);
+        ComputeRecords8Avx2(in, pOut + n);
+    }
+    _mm256_zeroupper();
+    return n;
+}
+
+#endif
+
+bool IsTransformKernelSupported(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TRANSFORM_KERNEL_SCALAR:
+    case TRANSFORM_KERNEL_BEST:
+        return true;
+#ifdef TRANSFORM_SSE
+    case TRANSFORM_KERNEL_SSE:
+        return true;
+#endif
+#ifdef TRANSFORM_AVX2
+    case TRANSFORM_KERNEL_AVX2:
+    {
+        static const bool s_hasAvx2 = CpuHasAvx2();
+        return s_hasAvx2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+TransformKernel ResolveTransformKernel(TransformKernel kernel)
+{
+    if (kernel == TRANSFORM_KERNEL_BEST)
+    {
+        if (IsTransformKernelSupported(TRANSFORM_KERNEL_AVX2))
+            return TRANSFORM_KERNEL_AVX2;
+        if (IsTransformKernelSupported(TRANSFORM_KERNEL_SSE))
+            return TRANSFORM_KERNEL_SSE;
+        return TRANSFORM_KERNEL_SCALAR;
+    }
+    return IsTransformKernelSupported(kernel) ? kernel : TRANSFORM_KERNEL_SCALAR;
+}
+
+const char* GetTransformKernelName(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TRANSFORM_KERNEL_SCALAR: return "scalar";
+    case TRANSFORM_KERNEL_SSE: return "sse";
+    case TRANSFORM_KERNEL_AVX2: return "avx2";
+    default: return "best";
+    }
+}
+
+void ComputeInstanceData(const SceneTransforms& scene, size_t first, size_t count,
+    InstanceData* pOut, TransformKernel kernel)
+{
+    size_t done = 0;
+    switch (ResolveTransformKernel(kernel))
+    {
+#ifdef TRANSFORM_AVX2
+    case TRANSFORM_KERNEL_AVX2:
+        done = ComputeAvx2(scene, first, count, pOut);
+        break;
+#endif
+#ifdef TRANSFORM_SSE
+    case TRANSFORM_KERNEL_SSE:
+        done = ComputeSse(scene, first, count, pOut);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for (size_t n = done; n < count; ++n)
+        ComputeRecordScalar(scene, first + n, pOut[n]);
+}
+
+void ComputeInstanceDataOrdered(const SceneTransforms& scene, const uint32_t* pOrder, size_t count,
+    InstanceData* pOut, TransformKernel kernel)
+{
+    size_t done = 0;
+    switch (ResolveTransformKernel(kernel))
+    {
+#ifdef TRANSFORM_AVX2
+    case TRANSFORM_KERNEL_AVX2:
+        done = ComputeOrderedAvx2(scene, pOrder, count, pOut);
+        break;
+#endif
+#ifdef TRANSFORM_SSE
+    case TRANSFORM_KERNEL_SSE:
+        done = ComputeOrderedSse(scene, pOrder, count, pOut);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for (size_t n = done; n < count; ++n)
+        ComputeRecordScalar(scene, pOrder[n], pOut[n]);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One record of the per-instance vertex stream (input slot 1). world holds
+// the transposed 3x4 world matrix, one float4 per output component, so the
+// vertex shader computes dot(world[i], float4(pos, 1)). tint.a is the alpha.
+struct alignas(16) InstanceData
+{
+    float world[3][4];
+    float tint[4];
+};
+
+static_assert(sizeof(InstanceData) == 64, "InstanceData must match the instance input layout");
+
+// Scene objects in structure-of-arrays form. World = Scale * Rotation *
+// Translation in DirectXMath's row-vector convention, with the rotation kept
+// as a unit quaternion. Objects that share a material must be stored next to
+// each other; InstanceBatcher turns every run into one instanced draw.
+struct SceneTransforms
+{
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> rotX, rotY, rotZ, rotW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<float> tintR, tintG, tintB, tintA;
+    std::vector<uint32_t> material;
+
+    size_t Size() const { return posX.size(); }
+    void Resize(size_t count);
+
+    void SetPosition(size_t i, float x, float y, float z);
+    void SetRotation(size_t i, float x, float y, float z, float w);
+    void SetRotationYaw(size_t i, float yaw);
+    void SetScale(size_t i, float s) { SetScale(i, s, s, s); }
+    void SetScale(size_t i, float x, float y, float z);
+    void SetTint(size_t i, float r, float g, float b, float a);
+};
+
+enum TransformKernel
+{
+    TRANSFORM_KERNEL_SCALAR,
+    TRANSFORM_KERNEL_SSE,   // 4 objects per step
+    TRANSFORM_KERNEL_AVX2,  // 8 objects per step, hardware gather for ordered output
+    TRANSFORM_KERNEL_BEST   // widest kernel the CPU supports
+};
+
+bool IsTransformKernelSupported(TransformKernel kernel);
+TransformKernel ResolveTransformKernel(TransformKernel kernel);
+const char* GetTransformKernelName(TransformKernel kernel);
+
+// Computes InstanceData for objects [first, first + count). Every record is
+// written whole and in order, so pOut can point straight into a buffer mapped
+// with WRITE_DISCARD. All kernels produce bit-identical results.
+void ComputeInstanceData(const SceneTransforms& scene, size_t first, size_t count,
+    InstanceData* pOut, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
+
+// Same, but record n is built from object pOrder[n]; used to emit sorted
+// transparent objects without reordering the SoA arrays.
+void ComputeInstanceDataOrdered(const SceneTransforms& scene, const uint32_t* pOrder, size_t count,
+    InstanceData* pOut, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
@@ -0,0 +1,229 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const uint32_t ARCHIVE_MAGIC = 0x31434853;     // "SHC1"
+    const uint32_t ARCHIVE_VERSION = 1;
+    const uint32_t MAX_BYTECODE_SIZE = 16u << 20;   // sanity limit for damaged archives
+
+    struct ArchiveHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+    };
+
+    struct EntryHeader
+    {
+        uint64_t key;
+        uint32_t size;
+        uint32_t checksum;      // low half of the bytecode hash
+        float compileMs;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(ArchiveHeader) == 16, "archive header layout");
+    static_assert(sizeof(EntryHeader) == 24, "entry header layout");
+
+    double ElapsedMs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Length-prefixed, so ("ab", "c") and ("a", "bc") hash differently.
+    uint64_t HashField(const void* pData, size_t size, uint64_t hash)
+    {
+        uint64_t length = size;
+        hash = HashBytes(&length, sizeof(length), hash);
+        return HashBytes(pData, size, hash);
+    }
+
+    uint64_t HashString(const char* p, uint64_t hash)
+    {
+        return HashField(p ? p : "", p ? strlen(p) : 0, hash);
+    }
+
+    FILE* OpenFile(const char* path, const char* mode)
+    {
+        FILE* pFile = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&pFile, path, mode) != 0)
+            return nullptr;
+#else
+        pFile = fopen(path, mode);
+#endif
+        return pFile;
+    }
+}
+
+ShaderCache::ShaderCache(ShaderCompileFn compile, const char* compilerId)
+    : m_compile(compile), m_compilerId(compilerId ? compilerId : ""), m_dirty(false)
+{
+}
+
+uint64_t ShaderCache::ComputeKey(const ShaderSource& source) const
+{
+    uint64_t hash = HashString(m_compilerId.c_str(), HASH_SEED);
+    hash = HashField(source.pText, source.pText ? source.textSize : 0, hash);
+    hash = HashString(source.entryPoint, hash);
+    hash = HashString(source.target, hash);
+    for (const ShaderDefine* pDefine = source.pDefines; pDefine && pDefine->name; ++pDefine)
+    {
+        hash = HashString(pDefine->name, hash);
+        hash = HashString(pDefine->value, hash);
+    }
+    return HashBytes(&source.flags, sizeof(source.flags), hash);
+}
+
+bool ShaderCache::Open(const std::string& archivePath)
+{
+    Clock::time_point start = Clock::now();
+    m_path = archivePath;
+    m_entries.clear();
+    m_dirty = false;
+
+    FILE* pFile = OpenFile(archivePath.c_str(), "rb");
+    if (!pFile)
+        return true;
+
+    ArchiveHeader header;
+    bool valid = fread(&header, sizeof(header), 1, pFile) == 1 &&
+        header.magic == ARCHIVE_MAGIC && header.version == ARCHIVE_VERSION;
+
+    for (uint32_t i = 0; valid && i < header.entryCount; ++i)
+    {
+        EntryHeader entryHeader;
+        if (fread(&entryHeader, sizeof(entryHeader), 1, pFile) != 1 || entryHeader.size > MAX_BYTECODE_SIZE)
+        {
+            valid = false;
+            break;
+        }
+
+        Entry entry;
+        entry.bytecode.resize(entryHeader.size);
+        entry.compileMs = entryHeader.compileMs;
+        entry.used = false;
+        if (entryHeader.size && fread(entry.bytecode.data(), entryHeader.size, 1, pFile) != 1)
+        {
+            valid = false;
+            break;
+        }
+        if ((uint32_t)HashBytes(entry.bytecode.data(), entry.bytecode.size()) != entryHeader.checksum)
+        {
+            valid = false;
+            break;
+        }
+        m_entries[entryHeader.key] = std::move(entry);
+    }
+    fclose(pFile);
+
+    // Anything unexpected throws away the whole archive; it is rebuilt on Save().
+    if (!valid)
+    {
+        m_entries.clear();
+        m_dirty = true;
+    }
+
+    double openMs = ElapsedMs(start, Clock::now());
+    m_stats.openMs += openMs;
+    m_stats.savedMs -= openMs;
+    return true;
+}
+
+bool ShaderCache::Compile(const ShaderSource& source, std::vector<uint8_t>& bytecode, std::string* pErrors)
+{
+    const uint64_t key = ComputeKey(source);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+    {
+        it->second.used = true;
+        bytecode = it->second.bytecode;
+        ++m_stats.hits;
+        m_stats.savedMs += it->second.compileMs;
+        return true;
+    }
+
+    ++m_stats.misses;
+    std::string errors;
+    Clock::time_point start = Clock::now();
+    bool ok = m_compile && m_compile(source, bytecode, errors);
+    double compileMs = ElapsedMs(start, Clock::now());
+    m_stats.compileMs += compileMs;
+
+    if (pErrors)
+        *pErrors = errors;
+    if (!ok)
+    {
+        ++m_stats.failures;
+        return false;
+    }
+
+    Entry& entry = m_entries[key];
+    entry.bytecode = bytecode;
+    entry.compileMs = (float)compileMs;
+    entry.used = true;
+    m_dirty = true;
+    return true;
+}
+
+bool ShaderCache::Save()
+{
+    bool pruned = false;
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (!it->second.used)
+        {
+            it = m_entries.erase(it);
+            pruned = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (m_path.empty() || !(m_dirty || pruned))
+        return true;
+
+    const std::string tempPath = m_path + ".tmp";
+    FILE* pFile = OpenFile(tempPath.c_str(), "wb");
+    if (!pFile)
+        return false;
+
+    ArchiveHeader header = { ARCHIVE_MAGIC, ARCHIVE_VERSION, (uint32_t)m_entries.size(), 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, pFile) == 1;
+    for (const auto& item : m_entries)
+    {
+        const Entry& entry = item.second;
+        EntryHeader entryHeader = {
+            item.first, (uint32_t)entry.bytecode.size(),
+            (uint32_t)HashBytes(entry.bytecode.data(), entry.bytecode.size()), entry.compileMs, 0
+        };
+        ok = ok && fwrite(&entryHeader, sizeof(entryHeader), 1, pFile) == 1;
+        ok = ok && (entry.bytecode.empty() || fwrite(entry.bytecode.data(), entry.bytecode.size(), 1, pFile) == 1);
+    }
+    ok = fclose(pFile) == 0 && ok;
+
+    // rename() does not replace an existing file on Windows.
+    if (ok)
+    {
+        remove(m_path.c_str());
+        ok = rename(tempPath.c_str(), m_path.c_str()) == 0;
+    }
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
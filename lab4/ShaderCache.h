@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Same layout as D3D_SHADER_MACRO, so a D3D define list can be passed as is.
+struct ShaderDefine
+{
+    const char* name;
+    const char* value;
+};
+
+// Everything that decides the compiled bytecode. pDefines may be null or
+// end with a { nullptr, nullptr } entry, as for D3DCompile.
+struct ShaderSource
+{
+    const char* pText = nullptr;
+    size_t textSize = 0;
+    const char* entryPoint = "";
+    const char* target = "";
+    const ShaderDefine* pDefines = nullptr;
+    uint32_t flags = 0;
+};
+
+struct ShaderCacheStats
+{
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t failures = 0;      // misses the compiler rejected; never stored
+    double openMs = 0.0;        // reading and validating the archive
+    double compileMs = 0.0;     // spent compiling misses
+    double savedMs = 0.0;       // recorded compile time of every hit, minus openMs
+
+    double GetHitRate() const
+    {
+        uint32_t lookups = hits + misses;
+        return lookups ? (double)hits / lookups : 0.0;
+    }
+};
+
+// Returns false and fills errors when the source does not compile.
+typedef std::function<bool(const ShaderSource& source, std::vector<uint8_t>& bytecode, std::string& errors)>
+    ShaderCompileFn;
+
+// Persistent compiled-shader cache in one archive file. Entries are keyed by
+// a 64-bit hash of the source text, entry point, target, defines, flags and
+// the compiler id, so editing any of them (or updating the compiler) simply
+// misses and recompiles. Open() reads the whole archive; Save() rewrites it
+// with only the entries requested since Open(), which drops stale shaders.
+// An archive with the wrong version or a damaged entry is ignored rather
+// than trusted. Not thread-safe.
+class ShaderCache
+{
+public:
+    // compilerId goes into every key; use something that changes with the
+    // compiler's version.
+    ShaderCache(ShaderCompileFn compile, const char* compilerId);
+
+    // A missing archive is not an error: the cache just starts empty.
+    bool Open(const std::string& archivePath);
+
+    // Writes the archive if anything changed. Goes through a temporary file
+    // so a crash never leaves a half-written archive behind.
+    bool Save();
+
+    // Bytecode for source, from the archive or freshly compiled.
+    bool Compile(const ShaderSource& source, std::vector<uint8_t>& bytecode, std::string* pErrors = nullptr);
+
+    uint64_t ComputeKey(const ShaderSource& source) const;
+
+    size_t GetEntryCount() const { return m_entries.size(); }
+    const ShaderCacheStats& GetStats() const { return m_stats; }
+
+private:
+    struct Entry
+    {
+        std::vector<uint8_t> bytecode;
+        float compileMs;
+        bool used;
+    };
+
+    ShaderCompileFn m_compile;
+    std::string m_compilerId;
+    std::string m_path;
+    std::unordered_map<uint64_t, Entry> m_entries;
+    bool m_dirty;
+    ShaderCacheStats m_stats;
+};
@@ -0,0 +1,74 @@
+#include "SoftwareRasterBench.h"
+#include "BenchUtil.h"
+#include "HeadlessRunner.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+void RunSoftwareRasterBenchmark(const DdsView& texture, const DdsView faces[6], uint32_t width, uint32_t height,
+    uint32_t cubeCount, uint32_t frameCount, std::vector<SoftwareRasterBenchResult>& results)
+{
+    const SoftwareLab labs[] = { SOFTWARE_LAB3, SOFTWARE_LAB4, SOFTWARE_LAB5 };
+    const char* labNames[] = { "lab3", "lab4", "lab5" };
+
+    const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads : { 1u, 2u, 4u, 8u, hardwareThreads })
+    {
+        if (threads <= hardwareThreads &&
+            std::find(threadCounts.begin(), threadCounts.end(), threads) == threadCounts.end())
+            threadCounts.push_back(threads);
+    }
+
+    HeadlessOptions options;
+    options.frameCount = std::max(1u, frameCount);
+    const CameraPath path = CameraPath::MakeOrbit((float)options.frameCount * options.frameTime);
+
+    std::vector<FrameTiming> timings;
+    for (uint32_t threads : threadCounts)
+    {
+        SoftwareRenderer renderer;
+        if (!renderer.Initialize(width, height, threads) || !renderer.LoadTextures(texture, faces))
+            return;
+
+        for (int l = 0; l < 3; ++l)
+        {
+            LabScene scene;
+            scene.SetCubeCount(labs[l] == SOFTWARE_LAB4 ? cubeCount : 1);
+            renderer.SetLab(labs[l]);
+            if (!RunHeadless(scene, renderer, path, options, timings))
+                continue;
+
+            double totalMs = 0.0;
+            for (const FrameTiming& timing : timings)
+                totalMs += timing.renderMs;
+
+            SoftwareRasterBenchResult result;
+            result.lab = labNames[l];
+            result.width = width;
+            result.height = height;
+            result.threads = renderer.GetThreadCount();
+            result.frames = (uint32_t)timings.size();
+            result.msPerFrame = totalMs / timings.size();
+            result.fps = result.msPerFrame > 0.0 ? 1000.0 / result.msPerFrame : 0.0;
+            results.push_back(result);
+        }
+    }
+}
+
+bool WriteSoftwareRasterBenchmarkCsv(const char* filename, const std::vector<SoftwareRasterBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "lab,width,height,threads,frames,ms_per_frame,fps\n");
+    for (const SoftwareRasterBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%u,%u,%u,%u,%.3f,%.1f\n",
+            r.lab.c_str(), r.width, r.height, r.threads, r.frames, r.msPerFrame, r.fps);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "SoftwareRenderer.h"
+#include <string>
+
+// Frame rate of SoftwareRenderer for one lab scene and thread count, over
+// a headless run along the built-in camera orbit. msPerFrame covers
+// RenderFrame only (scene update excluded).
+struct SoftwareRasterBenchResult
+{
+    std::string lab;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t threads = 1;
+    uint32_t frames = 0;
+    double msPerFrame = 0.0;
+    double fps = 0.0;
+};
+
+// Renders labs 3, 4 and 5 on 1, 2, 4, 8 and all hardware threads (counts
+// above the hardware thread count are skipped). cubeCount sizes the lab4
+// instance floor.
+void RunSoftwareRasterBenchmark(const DdsView& texture, const DdsView faces[6], uint32_t width, uint32_t height,
+    uint32_t cubeCount, uint32_t frameCount, std::vector<SoftwareRasterBenchResult>& results);
+
+bool WriteSoftwareRasterBenchmarkCsv(const char* filename, const std::vector<SoftwareRasterBenchResult>& results);
@@ -0,0 +1,609 @@
+#include "SoftwareRasterizer.h"
+#include "LoadScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SOFTWARE_RASTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Front-end job size; small enough to spread a single mesh of many
+    // instances over every thread.
+    const uint32_t TRIANGLES_PER_JOB = 2048;
+
+    uint32_t GetAttributeCount(RasterShader shader)
+    {
+        switch (shader)
+        {
+        case RASTER_SHADER_VERTEX_COLOR: return 4;
+        case RASTER_SHADER_TEXTURE: return 2;
+        default: return 3;
+        }
+    }
+
+    inline float EvalPlane(const float plane[3], float x, float y)
+    {
+        return plane[0] * x + plane[1] * y + plane[2];
+    }
+
+    inline uint8_t ToUnorm8(float value)
+    {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return (uint8_t)(value * 255.0f + 0.5f);
+    }
+
+    // Clip-space vertex: position in [0..3], attributes in [4..7].
+    typedef float ClipVertex[8];
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+    : m_width(0), m_height(0), m_tilesX(0), m_tilesY(0), m_blocksX(0), m_threadCount(1),
+    m_kernel(TRANSFORM_KERNEL_BEST), m_pOutputs(nullptr),
+    m_frameArena(1)
+{
+    m_clearColor[0] = m_clearColor[1] = m_clearColor[2] = 0.0f;
+    m_clearColor[3] = 1.0f;
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+}
+
+bool SoftwareRasterizer::Initialize(uint32_t width, uint32_t height, uint32_t threadCount)
+{
+    if (width == 0 || height == 0)
+        return false;
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_width = width;
+    m_height = height;
+    m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_blocksX = m_tilesX * (TILE_SIZE / BLOCK_SIZE);
+    m_threadCount = threadCount;
+
+    m_color.assign((size_t)width * height * 4, 0);
+    m_depth.assign((size_t)width * height, 1.0f);
+    m_blockMaxZ.assign((size_t)m_blocksX * m_tilesY * (TILE_SIZE / BLOCK_SIZE), 1.0f);
+
+    m_pWorkers.reset();
+    if (threadCount > 1)
+        m_pWorkers.reset(new LoadScheduler(threadCount - 1));
+    return true;
+}
+
+void SoftwareRasterizer::BeginFrame(const float clearColor[4])
+{
+    memcpy(m_clearColor, clearColor, sizeof(m_clearColor));
+    m_draws.clear();
+
+    // The last frame was finished by the end of its EndFrame(), so one
+    // block is enough.
+    m_frameArena.BeginFrame();
+}
+
+void SoftwareRasterizer::DrawInstanced(const RasterMesh& mesh, const InstanceData* pInstances, uint32_t instanceCount,
+    const Float4x4& viewProj, const RasterState& state)
+{
+    if (instanceCount == 0 || mesh.indexCount < 3)
+        return;
+
+    Draw draw;
+    draw.mesh = mesh;
+    draw.pInstances = pInstances;
+    draw.instanceCount = instanceCount;
+    draw.viewProj = viewProj;
+    draw.state = state;
+    m_draws.push_back(draw);
+}
+
+// Same pattern as DecodeBlockSurface: the workers and the calling thread
+// pull items off a shared counter until none are left.
+void SoftwareRasterizer::RunParallel(uint32_t count, const std::function<void(uint32_t)>& fn)
+{
+    std::atomic<uint32_t> next(0);
+    auto worker = [&]()
+    {
+        for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            fn(i);
+    };
+
+    const unsigned helperCount = m_pWorkers ? std::min(m_pWorkers->GetWorkerCount(), count) : 0;
+    FrameVector<std::future<void>> helpers((FrameAllocator<std::future<void>>(&m_frameArena)));
+    helpers.reserve(helperCount);
+    for (unsigned i = 0; i < helperCount; ++i)
+        helpers.push_back(m_pWorkers->Submit(worker));
+
+    worker();
+    for (std::future<void>& helper : helpers)
+        helper.wait();
+}
+
+void SoftwareRasterizer::EndFrame()
+{
+    m_jobs.clear();
+    for (uint32_t d = 0; d < (uint32_t)m_draws.size(); ++d)
+    {
+        const Draw& draw = m_draws[d];
+        uint32_t trianglesPerInstance = draw.mesh.indexCount / 3;
+        uint32_t instancesPerJob = std::max(1u, TRIANGLES_PER_JOB / trianglesPerInstance);
+        for (uint32_t first = 0; first < draw.instanceCount; first += instancesPerJob)
+        {
+            Job job;
+            job.draw = d;
+            job.firstInstance = first;
+            job.instanceCount = std::min(instancesPerJob, draw.instanceCount - first);
+            m_jobs.push_back(job);
+        }
+    }
+
+    // Bins start empty every frame and grow in the arena, so how the
+    // triangles spread over the tiles never reaches the heap.
+    const uint32_t tileCount = m_tilesX * m_tilesY;
+    FrameVector<JobOutput> outputs((FrameAllocator<JobOutput>(&m_frameArena)));
+    outputs.reserve(m_jobs.size());
+    for (size_t i = 0; i < m_jobs.size(); ++i)
+        outputs.emplace_back(&m_frameArena, tileCount);
+    m_pOutputs = outputs.data();
+
+    RunParallel((uint32_t)m_jobs.size(), [this](uint32_t job) { ProcessJob(job); });
+    RunParallel(tileCount, [this](uint32_t tile) { RasterizeTile(tile); });
+    m_pOutputs = nullptr;
+}
+
+void SoftwareRasterizer::ProcessJob(uint32_t jobIndex)
+{
+    const Job& job = m_jobs[jobIndex];
+    const Draw& draw = m_draws[job.draw];
+    const RasterMesh& mesh = draw.mesh;
+    const uint32_t attrCount = GetAttributeCount(draw.state.shader);
+
+    // Near-plane clipping can split a triangle, so this is only the usual
+    // case; the rest grows in the arena too.
+    JobOutput& out = m_pOutputs[jobIndex];
+    out.triangles.reserve((size_t)job.instanceCount * (mesh.indexCount / 3));
+
+    ClipVertex* pClip = m_frameArena.AllocateArray<ClipVertex>(mesh.vertexCount);
+    if (!pClip)
+        return;
+
+    for (uint32_t n = job.firstInstance; n < job.firstInstance + job.instanceCount; ++n)
+    {
+        const InstanceData& instance = draw.pInstances[n];
+
+        // world (rows are dotted with (p, 1)) times viewProj, as one matrix
+        Float4x4 world = MatrixIdentity();
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 4; ++c)
+                world.m[c][r] = instance.world[r][c];
+        Float4x4 worldViewProj = MatrixMultiply(world, draw.viewProj);
+
+        for (uint32_t v = 0; v < mesh.vertexCount; ++v)
+        {
+            TransformPoint(worldViewProj, mesh.pVertices[v].pos, pClip[v]);
+            memcpy(&pClip[v][4], mesh.pVertices[v].attr, sizeof(float) * 4);
+        }
+
+        for (uint32_t i = 0; i + 2 < mesh.indexCount; i += 3)
+        {
+            const float* v[3] = { pClip[mesh.pIndices[i]], pClip[mesh.pIndices[i + 1]], pClip[mesh.pIndices[i + 2]] };
+
+            // Trivially reject triangles entirely outside one frustum side.
+            bool outside = false;
+            for (int axis = 0; axis < 2 && !outside; ++axis)
+            {
+                outside = (v[0][axis] > v[0][3] && v[1][axis] > v[1][3] && v[2][axis] > v[2][3]) ||
+                    (v[0][axis] < -v[0][3] && v[1][axis] < -v[1][3] && v[2][axis] < -v[2][3]);
+            }
+            if (outside || (v[0][2] < 0.0f && v[1][2] < 0.0f && v[2][2] < 0.0f))
+                continue;
+
+            if (v[0][2] >= 0.0f && v[1][2] >= 0.0f && v[2][2] >= 0.0f)
+            {
+                const float tri[3][8] = {
+                    { v[0][0], v[0][1], v[0][2], v[0][3], v[0][4], v[0][5], v[0][6], v[0][7] },
+                    { v[1][0], v[1][1], v[1][2], v[1][3], v[1][4], v[1][5], v[1][6], v[1][7] },
+                    { v[2][0], v[2][1], v[2][2], v[2][3], v[2][4], v[2][5], v[2][6], v[2][7] }
+                };
+                SetupTriangle(tri, attrCount, job.draw, instance.tint, draw.state.cull, out);
+                continue;
+            }
+
+            // Near plane (z >= 0) clip gives at most a quad, drawn as a fan.
+            float poly[4][8];
+            uint32_t count = 0;
+            for (int e = 0; e < 3; ++e)
+            {
+                const float* cur = v[e];
+                const float* next = v[(e + 1) % 3];
+                bool curInside = cur[2] >= 0.0f;
+                if (curInside)
+                    memcpy(poly[count++], cur, sizeof(float) * 8);
+                if (curInside != (next[2] >= 0.0f))
+                {
+                    float t = cur[2] / (cur[2] - next[2]);
+                    for (int k = 0; k < 8; ++k)
+                        poly[count][k] = cur[k] + (next[k] - cur[k]) * t;
+                    ++count;
+                }
+            }
+            for (uint32_t k = 1; k + 1 < count; ++k)
+            {
+                float tri[3][8];
+                memcpy(tri[0], poly[0], sizeof(tri[0]));
+                memcpy(tri[1], poly[k], sizeof(tri[1]));
+                memcpy(tri[2], poly[k + 1], sizeof(tri[2]));
+                SetupTriangle(tri, attrCount, job.draw, instance.tint, draw.state.cull, out);
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::SetupTriangle(const float (*pClip)[8], uint32_t attrCount, uint32_t drawIndex,
+    const float* pTint, RasterCullMode cull, JobOutput& out)
+{
+    // Viewport transform; attributes are divided by w so they interpolate
+    // linearly in screen space.
+    float sx[3], sy[3], sz[3], invW[3], attr[3][4];
+    for (int i = 0; i < 3; ++i)
+    {
+        invW[i] = 1.0f / pClip[i][3];
+        sx[i] = (pClip[i][0] * invW[i] + 1.0f) * 0.5f * (float)m_width;
+        sy[i] = (1.0f - pClip[i][1] * invW[i]) * 0.5f * (float)m_height;
+        sz[i] = pClip[i][2] * invW[i];
+        for (uint32_t k = 0; k < attrCount; ++k)
+            attr[i][k] = pClip[i][4 + k] * invW[i];
+    }
+
+    // y points down, so a positive area is clockwise on screen.
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+    if (!(area > 0.0f || area < 0.0f))
+        return;
+
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.0f)
+    {
+        if (cull == RASTER_CULL_BACK)
+            return;
+        std::swap(order[1], order[2]);
+        area = -area;
+    }
+
+    float minX = std::min(sx[0], std::min(sx[1], sx[2]));
+    float maxX = std::max(sx[0], std::max(sx[1], sx[2]));
+    float minY = std::min(sy[0], std::min(sy[1], sy[2]));
+    float maxY = std::max(sy[0], std::max(sy[1], sy[2]));
+
+    Triangle tri;
+    tri.minX = std::max(0, (int)std::floor(minX));
+    tri.maxX = std::min((int)m_width - 1, (int)std::ceil(maxX));
+    tri.minY = std::max(0, (int)std::floor(minY));
+    tri.maxY = std::min((int)m_height - 1, (int)std::ceil(maxY));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+        return;
+
+    // Edge i runs between the two vertices other than i. A shared edge seen
+    // from the neighbouring triangle has exactly negated coefficients, so
+    // with the top-left rule every pixel centre is covered exactly once.
+    float invArea = 1.0f / area;
+    float bary[3][3];
+    tri.topLeft = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        int e0 = order[(i + 1) % 3];
+        int e1 = order[(i + 2) % 3];
+        float a = sy[e0] - sy[e1];
+        float b = sx[e1] - sx[e0];
+        float c = sx[e0] * sy[e1] - sx[e1] * sy[e0];
+        tri.edge[i][0] = a;
+        tri.edge[i][1] = b;
+        tri.edge[i][2] = c;
+        if (a > 0.0f || (a == 0.0f && b > 0.0f))
+            tri.topLeft |= 1u << i;
+
+        bary[i][0] = a * invArea;
+        bary[i][1] = b * invArea;
+        bary[i][2] = c * invArea;
+    }
+
+    for (int p = 0; p < 3; ++p)
+    {
+        tri.z[p] = 0.0f;
+        tri.invW[p] = 0.0f;
+        for (uint32_t k = 0; k < attrCount; ++k)
+            tri.attr[k][p] = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            int v = order[i];
+            tri.z[p] += bary[i][p] * sz[v];
+            tri.invW[p] += bary[i][p] * invW[v];
+            for (uint32_t k = 0; k < attrCount; ++k)
+                tri.attr[k][p] += bary[i][p] * attr[v][k];
+        }
+    }
+
+    tri.minZ = std::min(sz[0], std::min(sz[1], sz[2]));
+    tri.draw = drawIndex;
+    tri.pTint = pTint;
+
+    out.triangles.push_back(tri);
+    BinTriangle((uint32_t)out.triangles.size() - 1, out);
+}
+
+void SoftwareRasterizer::BinTriangle(uint32_t index, JobOutput& out)
+{
+    const Triangle& tri = out.triangles[index];
+    uint32_t tx0 = (uint32_t)tri.minX / TILE_SIZE, tx1 = (uint32_t)tri.maxX / TILE_SIZE;
+    uint32_t ty0 = (uint32_t)tri.minY / TILE_SIZE, ty1 = (uint32_t)tri.maxY / TILE_SIZE;
+
+    for (uint32_t ty = ty0; ty <= ty1; ++ty)
+    {
+        for (uint32_t tx = tx0; tx <= tx1; ++tx)
+        {
+            // Skip tiles the bounding box touches but an edge fully excludes.
+            if (tx0 != tx1 || ty0 != ty1)
+            {
+                float x0 = (float)(tx * TILE_SIZE) + 0.5f, x1 = x0 + (float)(TILE_SIZE - 1);
+                float y0 = (float)(ty * TILE_SIZE) + 0.5f, y1 = y0 + (float)(TILE_SIZE - 1);
+                bool excluded = false;
+                for (int i = 0; i < 3 && !excluded; ++i)
+                {
+                    const float* e = tri.edge[i];
+                    float best = e[0] * (e[0] > 0.0f ? x1 : x0) + e[1] * (e[1] > 0.0f ? y1 : y0) + e[2];
+                    excluded = best < 0.0f;
+                }
+                if (excluded)
+                    continue;
+            }
+            out.tiles[ty * m_tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tile)
+{
+    const int tileX0 = (int)((tile % m_tilesX) * TILE_SIZE);
+    const int tileY0 = (int)((tile / m_tilesX) * TILE_SIZE);
+    const int tileX1 = std::min(tileX0 + (int)TILE_SIZE, (int)m_width);
+    const int tileY1 = std::min(tileY0 + (int)TILE_SIZE, (int)m_height);
+
+    uint8_t clear[4];
+    for (int c = 0; c < 4; ++c)
+        clear[c] = ToUnorm8(m_clearColor[c]);
+    for (int y = tileY0; y < tileY1; ++y)
+    {
+        uint8_t* pColor = &m_color[((size_t)y * m_width + tileX0) * 4];
+        for (int x = tileX0; x < tileX1; ++x, pColor += 4)
+            memcpy(pColor, clear, 4);
+        std::fill_n(&m_depth[(size_t)y * m_width + tileX0], tileX1 - tileX0, 1.0f);
+    }
+    for (int by = tileY0; by < tileY1; by += BLOCK_SIZE)
+        for (int bx = tileX0; bx < tileX1; bx += BLOCK_SIZE)
+            m_blockMaxZ[(by / BLOCK_SIZE) * m_blocksX + bx / BLOCK_SIZE] = 1.0f;
+
+    for (size_t j = 0; j < m_jobs.size(); ++j)
+    {
+        const JobOutput& out = m_pOutputs[j];
+        for (uint32_t index : out.tiles[tile])
+            RasterizeTriangle(out.triangles[index], tileX0, tileY0, tileX1, tileY1);
+    }
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const Triangle& tri, int tileX0, int tileY0, int tileX1, int tileY1)
+{
+    const RasterState& state = m_draws[tri.draw].state;
+    const int x0 = std::max(tri.minX, tileX0), x1 = std::min(tri.maxX + 1, tileX1);
+    const int y0 = std::max(tri.minY, tileY0), y1 = std::min(tri.maxY + 1, tileY1);
+    const bool depthTest = state.depthFunc != RASTER_DEPTH_OFF;
+    const bool lessEqual = state.depthFunc == RASTER_DEPTH_LESS_EQUAL;
+    const bool depthWrite = depthTest && state.depthWrite;
+
+#ifdef SOFTWARE_RASTER_SSE
+    const bool useSse = m_kernel != TRANSFORM_KERNEL_SCALAR;
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 edgeA[3], topLeftMask[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        edgeA[i] = _mm_set1_ps(tri.edge[i][0]);
+        topLeftMask[i] = _mm_castsi128_ps(_mm_set1_epi32((tri.topLeft >> i) & 1 ? -1 : 0));
+    }
+    const __m128 zA = _mm_set1_ps(tri.z[0]);
+#endif
+
+    for (int by = y0 & ~(int)(BLOCK_SIZE - 1); by < y1; by += BLOCK_SIZE)
+    {
+        for (int bx = x0 & ~(int)(BLOCK_SIZE - 1); bx < x1; bx += BLOCK_SIZE)
+        {
+            // Hierarchical depth: nothing in the block can pass when the
+            // nearest point of the triangle is behind everything in it.
+            float& blockMaxZ = m_blockMaxZ[(by / BLOCK_SIZE) * m_blocksX + bx / BLOCK_SIZE];
+            if (depthTest && (lessEqual ? tri.minZ > blockMaxZ : tri.minZ >= blockMaxZ))
+                continue;
+
+            // Block entirely outside one edge.
+            float bx0 = (float)bx + 0.5f, bx1 = bx0 + (float)(BLOCK_SIZE - 1);
+            float by0 = (float)by + 0.5f, by1 = by0 + (float)(BLOCK_SIZE - 1);
+            bool excluded = false;
+            for (int i = 0; i < 3 && !excluded; ++i)
+            {
+                const float* e = tri.edge[i];
+                excluded = e[0] * (e[0] > 0.0f ? bx1 : bx0) + e[1] * (e[1] > 0.0f ? by1 : by0) + e[2] < 0.0f;
+            }
+            if (excluded)
+                continue;
+
+            const int rowStart = std::max(by, y0), rowEnd = std::min(by + (int)BLOCK_SIZE, y1);
+            const int colStart = std::max(bx, x0), colEnd = std::min(bx + (int)BLOCK_SIZE, x1);
+            bool wroteDepth = false;
+
+            for (int y = rowStart; y < rowEnd; ++y)
+            {
+                const float py = (float)y + 0.5f;
+                float* pDepthRow = &m_depth[(size_t)y * m_width];
+
+                for (int x = colStart; x < colEnd; x += 4)
+                {
+                    unsigned mask = 0;
+#ifdef SOFTWARE_RASTER_SSE
+                    if (useSse)
+                    {
+                        const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+                        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            const __m128 row = _mm_set1_ps(tri.edge[i][1] * py + tri.edge[i][2]);
+                            const __m128 e = _mm_add_ps(_mm_mul_ps(edgeA[i], px), row);
+                            const __m128 onEdge = _mm_and_ps(_mm_cmpeq_ps(e, zero), topLeftMask[i]);
+                            inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(e, zero), onEdge));
+                        }
+                        mask = (unsigned)_mm_movemask_ps(inside);
+                        if (colEnd - x < 4)
+                            mask &= (1u << (colEnd - x)) - 1;
+                        if (!mask)
+                            continue;
+
+                        if (depthTest)
+                        {
+                            const __m128 z = _mm_add_ps(_mm_mul_ps(zA, px), _mm_set1_ps(tri.z[1] * py + tri.z[2]));
+                            float lanes[4];
+                            const int valid = std::min(4, colEnd - x);
+                            if (valid == 4)
+                                _mm_storeu_ps(lanes, _mm_loadu_ps(pDepthRow + x));
+                            else
+                                for (int l = 0; l < 4; ++l) lanes[l] = l < valid ? pDepthRow[x + l] : 0.0f;
+
+                            const __m128 depth = _mm_loadu_ps(lanes);
+                            const __m128 pass = lessEqual ? _mm_cmple_ps(z, depth) : _mm_cmplt_ps(z, depth);
+                            mask &= (unsigned)_mm_movemask_ps(pass);
+                            if (!mask)
+                                continue;
+
+                            if (depthWrite)
+                            {
+                                float zs[4];
+                                _mm_storeu_ps(zs, z);
+                                for (int l = 0; l < 4; ++l)
+                                    if (mask & (1u << l)) pDepthRow[x + l] = zs[l];
+                                wroteDepth = true;
+                            }
+                        }
+                    }
+                    else
+#endif
+                    {
+                        for (int l = 0; l < 4 && x + l < colEnd; ++l)
+                        {
+                            const float px = (float)(x + l) + 0.5f;
+                            bool covered = true;
+                            for (int i = 0; i < 3 && covered; ++i)
+                            {
+                                const float e = tri.edge[i][0] * px + (tri.edge[i][1] * py + tri.edge[i][2]);
+                                covered = e > 0.0f || (e == 0.0f && ((tri.topLeft >> i) & 1));
+                            }
+                            if (!covered)
+                                continue;
+
+                            if (depthTest)
+                            {
+                                const float z = tri.z[0] * px + (tri.z[1] * py + tri.z[2]);
+                                float& depth = pDepthRow[x + l];
+                                if (lessEqual ? z > depth : z >= depth)
+                                    continue;
+                                if (depthWrite)
+                                {
+                                    depth = z;
+                                    wroteDepth = true;
+                                }
+                            }
+                            mask |= 1u << l;
+                        }
+                    }
+                    for (int l = 0; l < 4; ++l)
+                    {
+                        if (mask & (1u << l))
+                            ShadePixel(tri, state, x + l, y);
+                    }
+                }
+            }
+
+            if (wroteDepth)
+            {
+                const int blockEndX = std::min(bx + (int)BLOCK_SIZE, (int)m_width);
+                const int blockEndY = std::min(by + (int)BLOCK_SIZE, (int)m_height);
+                float maxZ = 0.0f;
+                for (int y = by; y < blockEndY; ++y)
+                {
+                    const float* pRow = &m_depth[(size_t)y * m_width];
+                    for (int x = bx; x < blockEndX; ++x)
+                        maxZ = std::max(maxZ, pRow[x]);
+                }
+                blockMaxZ = maxZ;
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::ShadePixel(const Triangle& tri, const RasterState& state, int x, int y)
+{
+    const float px = (float)x + 0.5f;
+    const float py = (float)y + 0.5f;
+    const float invW = EvalPlane(tri.invW, px, py);
+    const float w = 1.0f / invW;
+
+    float rgba[4];
+    switch (state.shader)
+    {
+    case RASTER_SHADER_VERTEX_COLOR:
+        for (int c = 0; c < 4; ++c)
+            rgba[c] = EvalPlane(tri.attr[c], px, py) * w * tri.pTint[c];
+        break;
+
+    case RASTER_SHADER_TEXTURE:
+    {
+        // Derivatives from the neighbouring pixel centres on the same planes.
+        const float u = EvalPlane(tri.attr[0], px, py);
+        const float v = EvalPlane(tri.attr[1], px, py);
+        const float wx = 1.0f / (invW + tri.invW[0]);
+        const float wy = 1.0f / (invW + tri.invW[1]);
+        const float uc = u * w, vc = v * w;
+        const float lod = ComputeTextureLod(*state.pTexture,
+            (u + tri.attr[0][0]) * wx - uc, (v + tri.attr[1][0]) * wx - vc,
+            (u + tri.attr[0][1]) * wy - uc, (v + tri.attr[1][1]) * wy - vc);
+        SampleTrilinear(*state.pTexture, uc, vc, lod, true, rgba);
+        for (int c = 0; c < 4; ++c)
+            rgba[c] *= tri.pTint[c];
+        break;
+    }
+
+    default:
+    {
+        float dir[3];
+        for (int c = 0; c < 3; ++c)
+            dir[c] = EvalPlane(tri.attr[c], px, py) * w;
+        SampleCube(state.pTexture, dir, state.lod, rgba);
+        break;
+    }
+    }
+
+    uint8_t* pOut = &m_color[((size_t)y * m_width + x) * 4];
+    if (state.alphaBlend)
+    {
+        const float a = rgba[3] < 0.0f ? 0.0f : (rgba[3] > 1.0f ? 1.0f : rgba[3]);
+        for (int c = 0; c < 3; ++c)
+            pOut[c] = ToUnorm8(rgba[c] * a + (float)pOut[c] * (1.0f / 255.0f) * (1.0f - a));
+        pOut[3] = ToUnorm8(rgba[3]);
+    }
+    else
+    {
+        for (int c = 0; c < 4; ++c)
+            pOut[c] = ToUnorm8(rgba[c]);
+    }
+}
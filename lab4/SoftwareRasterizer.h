@@ -0,0 +1,175 @@
+#pragma once
+#include "FrameArena.h"
+#include "SceneMath.h"
+#include "SceneTransforms.h"
+#include "SoftwareTexture.h"
+#include <functional>
+#include <memory>
+
+class LoadScheduler;
+
+enum RasterCullMode
+{
+    RASTER_CULL_NONE,
+    RASTER_CULL_BACK            // clockwise on screen is front facing, as in D3D
+};
+
+enum RasterDepthFunc
+{
+    RASTER_DEPTH_OFF,           // no depth test, no depth write
+    RASTER_DEPTH_LESS,
+    RASTER_DEPTH_LESS_EQUAL
+};
+
+enum RasterShader
+{
+    RASTER_SHADER_VERTEX_COLOR, // attr = RGBA, times the instance tint
+    RASTER_SHADER_TEXTURE,      // attr = UV, trilinear wrap sample times the instance tint
+    RASTER_SHADER_CUBE          // attr = direction into six cube faces, fixed LOD
+};
+
+struct RasterState
+{
+    RasterCullMode cull = RASTER_CULL_BACK;
+    RasterDepthFunc depthFunc = RASTER_DEPTH_LESS;
+    bool depthWrite = true;
+    bool alphaBlend = false;    // SRC_ALPHA / INV_SRC_ALPHA on colour, source alpha kept
+    RasterShader shader = RASTER_SHADER_VERTEX_COLOR;
+    const SoftwareTexture* pTexture = nullptr;  // the texture, or the first of six cube faces
+    float lod = 0.0f;           // RASTER_SHADER_CUBE only
+};
+
+struct RasterVertex
+{
+    float pos[3];
+    float attr[4];
+};
+
+struct RasterMesh
+{
+    const RasterVertex* pVertices;
+    uint32_t vertexCount;
+    const uint16_t* pIndices;
+    uint32_t indexCount;
+};
+
+// Multithreaded tile-based software rasterizer for the lab scenes. Draws
+// are only recorded until EndFrame(), which runs in two parallel passes:
+//
+//   1. Front end: instances are split into jobs of about 2K triangles that
+//      are transformed, clipped against the near plane, culled, set up as
+//      edge/attribute plane equations and binned into 64x64 tiles.
+//   2. Back end: every tile is owned by one thread, which walks the bins of
+//      all jobs in submission order (so blending stays ordered), tests 8x8
+//      blocks against a per-block max depth, then evaluates edge functions
+//      and the depth test four pixels at a time with SSE.
+//
+// Colour is RGBA8 and depth is a float buffer; the result matches the D3D11
+// renderer's conventions (pixel centres, top-left fill rule, LESS depth).
+class SoftwareRasterizer
+{
+public:
+    static const uint32_t TILE_SIZE = 64;
+    static const uint32_t BLOCK_SIZE = 8;
+
+    SoftwareRasterizer();
+    ~SoftwareRasterizer();
+
+    // threadCount 0 uses every hardware thread; the calling thread counts.
+    bool Initialize(uint32_t width, uint32_t height, uint32_t threadCount);
+
+    // The edge and depth tests run four pixels at a time with SSE unless
+    // TRANSFORM_KERNEL_SCALAR is asked for; the frames are identical.
+    void SetKernel(TransformKernel kernel) { m_kernel = kernel; }
+    TransformKernel GetKernel() const { return m_kernel; }
+
+    void BeginFrame(const float clearColor[4]);
+
+    // Queues instanceCount copies of mesh, placed by each instance's world
+    // rows and tinted by its tint. mesh, pInstances and the textures in
+    // state must stay valid until EndFrame().
+    void DrawInstanced(const RasterMesh& mesh, const InstanceData* pInstances, uint32_t instanceCount,
+        const Float4x4& viewProj, const RasterState& state);
+
+    void EndFrame();
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetThreadCount() const { return m_threadCount; }
+    const std::vector<uint8_t>& GetColor() const { return m_color; }
+
+private:
+    struct Draw
+    {
+        RasterMesh mesh;
+        const InstanceData* pInstances;
+        uint32_t instanceCount;
+        Float4x4 viewProj;
+        RasterState state;
+    };
+
+    struct Job
+    {
+        uint32_t draw;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    // A triangle ready for scan conversion. Everything is a plane
+    // a * x + b * y + c over pixel coordinates.
+    struct Triangle
+    {
+        float edge[3][3];       // inside where > 0, or == 0 on a top-left edge
+        float z[3];
+        float invW[3];
+        float attr[4][3];       // attribute / w
+        float minZ;
+        int minX, minY, maxX, maxY;
+        uint32_t topLeft;       // bit i set: edge i is a top or left edge
+        uint32_t draw;
+        const float* pTint;
+    };
+
+    // One job's triangles and their tile bins. Lives in m_frameArena for
+    // the duration of EndFrame().
+    struct JobOutput
+    {
+        JobOutput(FrameArena* pArena, uint32_t tileCount)
+            : triangles(FrameAllocator<Triangle>(pArena)),
+            tiles(tileCount, FrameVector<uint32_t>(FrameAllocator<uint32_t>(pArena)),
+                FrameAllocator<FrameVector<uint32_t>>(pArena))
+        {
+        }
+
+        FrameVector<Triangle> triangles;
+        FrameVector<FrameVector<uint32_t>> tiles;
+    };
+
+    void RunParallel(uint32_t count, const std::function<void(uint32_t)>& fn);
+    void ProcessJob(uint32_t jobIndex);
+    void SetupTriangle(const float (*pClip)[8], uint32_t attrCount, uint32_t drawIndex,
+        const float* pTint, RasterCullMode cull, JobOutput& out);
+    void BinTriangle(uint32_t index, JobOutput& out);
+    void RasterizeTile(uint32_t tile);
+    void RasterizeTriangle(const Triangle& tri, int tileX0, int tileY0, int tileX1, int tileY1);
+    void ShadePixel(const Triangle& tri, const RasterState& state, int x, int y);
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tilesX;
+    uint32_t m_tilesY;
+    uint32_t m_blocksX;
+    uint32_t m_threadCount;
+    TransformKernel m_kernel;
+    std::unique_ptr<LoadScheduler> m_pWorkers;
+
+    float m_clearColor[4];
+    std::vector<uint8_t> m_color;
+    std::vector<float> m_depth;
+    std::vector<float> m_blockMaxZ;
+
+    std::vector<Draw> m_draws;
+    std::vector<Job> m_jobs;
+    JobOutput* m_pOutputs;      // one per job while EndFrame() runs
+    FrameArena m_frameArena;    // everything EndFrame() needs for one frame
+};
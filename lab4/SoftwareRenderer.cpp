@@ -0,0 +1,189 @@
+#include "SoftwareRenderer.h"
+#include <cmath>
+
+namespace
+{
+    RasterMesh MakeMesh(const std::vector<RasterVertex>& vertices, const uint16_t* pIndices, uint32_t indexCount)
+    {
+        RasterMesh mesh = { vertices.data(), (uint32_t)vertices.size(), pIndices, indexCount };
+        return mesh;
+    }
+}
+
+SoftwareRenderer::SoftwareRenderer()
+    : m_lab(SOFTWARE_LAB4)
+{
+    const SceneMesh& cube = GetCubeMesh();
+    m_cubeVertices.resize(cube.vertexCount);
+    m_tintCubeVertices.resize(cube.vertexCount);
+    for (uint32_t i = 0; i < cube.vertexCount; ++i)
+    {
+        const SceneVertex& v = cube.pVertices[i];
+        RasterVertex textured = { { v.pos[0], v.pos[1], v.pos[2] }, { v.uv[0], v.uv[1], 0.0f, 0.0f } };
+        RasterVertex tinted = { { v.pos[0], v.pos[1], v.pos[2] }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+        m_cubeVertices[i] = textured;
+        m_tintCubeVertices[i] = tinted;
+    }
+
+    const SceneColorMesh& lab3 = GetLab3CubeMesh();
+    m_colorCubeVertices.resize(lab3.vertexCount);
+    for (uint32_t i = 0; i < lab3.vertexCount; ++i)
+    {
+        RasterVertex& v = m_colorCubeVertices[i];
+        for (int c = 0; c < 3; ++c)
+        {
+            v.pos[c] = lab3.pPositions[i][c];
+            v.attr[c] = (float)lab3.pColors[i][c] / 255.0f;
+        }
+        v.attr[3] = 1.0f;
+    }
+
+    const SceneMesh& sky = GetSkyboxMesh();
+    m_skyboxVertices.resize(sky.vertexCount);
+    for (uint32_t i = 0; i < sky.vertexCount; ++i)
+    {
+        const SceneVertex& v = sky.pVertices[i];
+        RasterVertex vertex = { { v.pos[0], v.pos[1], v.pos[2] }, { v.pos[0], v.pos[1], v.pos[2], 0.0f } };
+        m_skyboxVertices[i] = vertex;
+    }
+
+    // 0 stays the identity (skybox), 1 is the lab3 cube or lab5 centre cube.
+    m_objects.Resize(2);
+    m_objectData.resize(2);
+
+    m_transparent.Resize(2);
+    m_transparentData.resize(2);
+}
+
+bool SoftwareRenderer::Initialize(uint32_t width, uint32_t height, uint32_t threadCount)
+{
+    return m_rasterizer.Initialize(width, height, threadCount);
+}
+
+bool SoftwareRenderer::LoadTextures(const DdsView& texture, const DdsView faces[6])
+{
+    // Other renderers in the process share the decoded copies.
+    m_texture = AcquireSoftwareTextures(&texture, 1);
+    m_faces = AcquireSoftwareTextures(faces, 6);
+    return m_texture && m_faces;
+}
+
+void SoftwareRenderer::RenderFrame(const LabScene& scene)
+{
+    SceneMatrices matrices;
+    scene.ComputeMatrices((float)GetWidth() / (float)GetHeight(), matrices);
+
+    float clearColor[4];
+    GetLabClearColor(m_lab, clearColor);
+    m_rasterizer.BeginFrame(clearColor);
+
+    switch (m_lab)
+    {
+    case SOFTWARE_LAB3:
+        DrawLab3(scene);
+        break;
+
+    case SOFTWARE_LAB4:
+    {
+        DrawSkybox(matrices);
+
+        scene.BuildVisibleInstances(matrices.viewProj, m_visible, m_instances,
+            TRANSFORM_KERNEL_BEST, &m_occlusion);
+        const InstanceBatcher& instances = m_instances;
+        if (m_texture && instances.GetInstanceCount() > 0)
+        {
+            RasterState state;
+            state.shader = RASTER_SHADER_TEXTURE;
+            state.pTexture = m_texture->data();
+            m_rasterizer.DrawInstanced(MakeMesh(m_cubeVertices, GetCubeMesh().pIndices, GetCubeMesh().indexCount),
+                instances.GetData(), instances.GetInstanceCount(), matrices.viewProj, state);
+        }
+        break;
+    }
+
+    default:
+        DrawSkybox(matrices);
+        DrawLab5(scene, matrices);
+        break;
+    }
+
+    m_rasterizer.EndFrame();
+}
+
+void SoftwareRenderer::DrawSkybox(const SceneMatrices& matrices)
+{
+    if (!m_faces)
+        return;
+
+    ComputeInstanceData(m_objects, 0, 1, &m_objectData[0]);
+
+    // One LOD for the whole sky, as in ReferenceRenderer.
+    RasterState state;
+    state.cull = RASTER_CULL_NONE;
+    state.depthFunc = RASTER_DEPTH_LESS_EQUAL;
+    state.depthWrite = false;
+    state.shader = RASTER_SHADER_CUBE;
+    state.pTexture = m_faces->data();
+    state.lod = std::log2((float)(*m_faces)[0].levels[0].width / (matrices.proj.m[1][1] * (float)GetHeight()));
+
+    const SceneMesh& sky = GetSkyboxMesh();
+    m_rasterizer.DrawInstanced(MakeMesh(m_skyboxVertices, sky.pIndices, sky.indexCount),
+        &m_objectData[0], 1, matrices.skyViewProj, state);
+}
+
+void SoftwareRenderer::DrawLab3(const LabScene& scene)
+{
+    // lab3 has its own 45 degree projection and no depth buffer; the back
+    // faces are culled, which is all a convex cube needs.
+    const Float4x4 viewProj = ComputeLab3ViewProj(scene, (float)GetWidth() / (float)GetHeight());
+
+    m_objects.SetRotationYaw(1, GetLabCubeYaw(scene.GetTime()));
+    ComputeInstanceData(m_objects, 1, 1, &m_objectData[1]);
+
+    RasterState state;
+    state.depthFunc = RASTER_DEPTH_OFF;
+    state.depthWrite = false;
+    state.shader = RASTER_SHADER_VERTEX_COLOR;
+    const SceneColorMesh& lab3 = GetLab3CubeMesh();
+    m_rasterizer.DrawInstanced(MakeMesh(m_colorCubeVertices, lab3.pIndices, lab3.indexCount),
+        &m_objectData[1], 1, viewProj, state);
+}
+
+void SoftwareRenderer::DrawLab5(const LabScene& scene, const SceneMatrices& matrices)
+{
+    const SceneMesh& cube = GetCubeMesh();
+
+    if (m_texture)
+    {
+        m_objects.SetRotationYaw(1, GetLabCubeYaw(scene.GetTime()));
+        ComputeInstanceData(m_objects, 1, 1, &m_objectData[1]);
+
+        RasterState state;
+        state.shader = RASTER_SHADER_TEXTURE;
+        state.pTexture = m_texture->data();
+        m_rasterizer.DrawInstanced(MakeMesh(m_cubeVertices, cube.pIndices, cube.indexCount),
+            &m_objectData[1], 1, matrices.viewProj, state);
+    }
+
+    SetLab5TransparentCubes(m_transparent, scene.GetTime());
+
+    // The rasterizer keeps submission order per tile, so one back-to-front
+    // draw blends correctly just like the instanced D3D draw.
+    const std::vector<uint32_t>& order = m_sorter.Sort(m_transparent, matrices.eye[0], matrices.eye[1], matrices.eye[2]);
+    ComputeInstanceDataOrdered(m_transparent, order.data(), order.size(), m_transparentData.data());
+
+    RasterState state;
+    state.depthWrite = false;
+    state.alphaBlend = true;
+    state.shader = RASTER_SHADER_VERTEX_COLOR;
+    m_rasterizer.DrawInstanced(MakeMesh(m_tintCubeVertices, cube.pIndices, cube.indexCount),
+        m_transparentData.data(), (uint32_t)order.size(), matrices.viewProj, state);
+}
+
+bool SoftwareRenderer::ReadPixels(std::vector<uint8_t>& rgba)
+{
+    if (m_rasterizer.GetColor().empty())
+        return false;
+    rgba = m_rasterizer.GetColor();
+    return true;
+}
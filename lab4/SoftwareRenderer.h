@@ -0,0 +1,58 @@
+#pragma once
+#include "SceneBackend.h"
+#include "LabScene.h"
+#include "SoftwareRasterizer.h"
+#include "TransparencySort.h"
+
+// ISceneBackend on top of SoftwareRasterizer, so the headless runner can
+// draw the lab scenes on any number of CPU threads.
+class SoftwareRenderer : public ISceneBackend
+{
+public:
+    SoftwareRenderer();
+
+    // threadCount 0 uses every hardware thread.
+    bool Initialize(uint32_t width, uint32_t height, uint32_t threadCount);
+
+    // Same textures as ReferenceRenderer::LoadTextures(); lab3 needs none.
+    bool LoadTextures(const DdsView& texture, const DdsView faces[6]);
+
+    void SetLab(SoftwareLab lab) { m_lab = lab; }
+    SoftwareLab GetLab() const { return m_lab; }
+    uint32_t GetThreadCount() const { return m_rasterizer.GetThreadCount(); }
+    void SetRasterKernel(TransformKernel kernel) { m_rasterizer.SetKernel(kernel); }
+
+    const char* GetName() const override { return "software"; }
+    uint32_t GetWidth() const override { return m_rasterizer.GetWidth(); }
+    uint32_t GetHeight() const override { return m_rasterizer.GetHeight(); }
+
+    void RenderFrame(const LabScene& scene) override;
+    bool ReadPixels(std::vector<uint8_t>& rgba) override;
+
+private:
+    void DrawSkybox(const SceneMatrices& matrices);
+    void DrawLab3(const LabScene& scene);
+    void DrawLab5(const LabScene& scene, const SceneMatrices& matrices);
+
+    SoftwareRasterizer m_rasterizer;
+    SoftwareLab m_lab;
+
+    std::shared_ptr<const SoftwareTextureSet> m_texture;
+    std::shared_ptr<const SoftwareTextureSet> m_faces;     // +X -X +Y -Y +Z -Z
+
+    std::vector<RasterVertex> m_cubeVertices;       // attr = uv
+    std::vector<RasterVertex> m_colorCubeVertices;  // attr = lab3 vertex colour
+    std::vector<RasterVertex> m_tintCubeVertices;   // attr = white, colour comes from the tint
+    std::vector<RasterVertex> m_skyboxVertices;     // attr = position, the cube map direction
+
+    // Single objects go through the same SoA path as the instanced cubes.
+    SceneTransforms m_objects;
+    SceneTransforms m_transparent;
+    TransparencySorter m_sorter;
+    std::vector<InstanceData> m_objectData;
+    std::vector<InstanceData> m_transparentData;
+
+    std::vector<uint32_t> m_visible;                // lab4 cubes that survive culling
+    InstanceBatcher m_instances;
+    OcclusionCuller m_occlusion;                    // the lab cube hides floor cubes
+};
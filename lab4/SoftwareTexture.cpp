@@ -0,0 +1,166 @@
+#include "SoftwareTexture.h"
+#include "BlockDecoder.h"
+#include "PixelConverter.h"
+#include <algorithm>
+#include <cmath>
+
+bool SoftwareTexture::Decode(const DdsView& view, LoadScheduler* pScheduler)
+{
+    levels.clear();
+    const bool uncompressed = IsPixelConvertLayout(view.GetPixelLayout());
+    if (!view.IsOpen() || (!uncompressed && !IsBlockDecodeFormat(view.GetFormat())))
+        return false;
+
+    levels.resize(view.GetMipCount());
+    for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+    {
+        Level& out = levels[level];
+        out.width = view.GetMip(level).width;
+        out.height = view.GetMip(level).height;
+        bool ok = uncompressed ?
+            ConvertDdsMip(view, 0, level, out.rgba, BLOCK_DECODE_BEST, pScheduler) :
+            DecodeDdsMip(view, level, out.rgba, BLOCK_DECODE_BEST, pScheduler);
+        if (!ok)
+        {
+            levels.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const SoftwareTextureSet> DecodeSoftwareTextures(const DdsView* pViews, uint32_t viewCount,
+    uint64_t& bytes, LoadScheduler* pScheduler)
+{
+    std::shared_ptr<SoftwareTextureSet> set = std::make_shared<SoftwareTextureSet>(viewCount);
+    bytes = 0;
+    for (uint32_t i = 0; i < viewCount; ++i)
+    {
+        if (!(*set)[i].Decode(pViews[i], pScheduler))
+            return nullptr;
+        for (const SoftwareTexture::Level& level : (*set)[i].levels)
+            bytes += level.rgba.size();
+    }
+    return set;
+}
+
+TextureCache<const SoftwareTextureSet>& GetSoftwareTextureCache()
+{
+    static TextureCache<const SoftwareTextureSet> s_cache;
+    return s_cache;
+}
+
+std::shared_ptr<const SoftwareTextureSet> AcquireSoftwareTextures(const DdsView* pViews, uint32_t viewCount,
+    LoadScheduler* pScheduler)
+{
+    return GetSoftwareTextureCache().Acquire(pViews, viewCount, 0,
+        [pScheduler](const DdsView* pLoadViews, uint32_t loadCount, uint64_t& bytes) {
+            return DecodeSoftwareTextures(pLoadViews, loadCount, bytes, pScheduler);
+        });
+}
+
+static int WrapCoord(int i, int n)
+{
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+static int ClampCoord(int i, int n)
+{
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+// Texel centres sit at half-integer coordinates, as in D3D.
+void SampleBilinear(const SoftwareTexture::Level& level, float u, float v, bool wrap, float out[4])
+{
+    float x = u * (float)level.width - 0.5f;
+    float y = v * (float)level.height - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float ax = x - fx;
+    float ay = y - fy;
+
+    int w = (int)level.width;
+    int h = (int)level.height;
+    int xs[2] = { (int)fx, (int)fx + 1 };
+    int ys[2] = { (int)fy, (int)fy + 1 };
+    for (int i = 0; i < 2; ++i)
+    {
+        xs[i] = wrap ? WrapCoord(xs[i], w) : ClampCoord(xs[i], w);
+        ys[i] = wrap ? WrapCoord(ys[i], h) : ClampCoord(ys[i], h);
+    }
+
+    const float weights[4] = { (1 - ax) * (1 - ay), ax * (1 - ay), (1 - ax) * ay, ax * ay };
+    const uint8_t* pTexels[4] = {
+        &level.rgba[((size_t)ys[0] * w + xs[0]) * 4], &level.rgba[((size_t)ys[0] * w + xs[1]) * 4],
+        &level.rgba[((size_t)ys[1] * w + xs[0]) * 4], &level.rgba[((size_t)ys[1] * w + xs[1]) * 4]
+    };
+
+    for (int c = 0; c < 4; ++c)
+    {
+        float sum = 0.0f;
+        for (int t = 0; t < 4; ++t)
+            sum += weights[t] * (float)pTexels[t][c];
+        out[c] = sum * (1.0f / 255.0f);
+    }
+}
+
+void SampleTrilinear(const SoftwareTexture& texture, float u, float v, float lod, bool wrap, float out[4])
+{
+    float maxLod = (float)(texture.levels.size() - 1);
+    lod = lod < 0.0f ? 0.0f : (lod > maxLod ? maxLod : lod);
+
+    uint32_t level = (uint32_t)lod;
+    float blend = lod - (float)level;
+    SampleBilinear(texture.levels[level], u, v, wrap, out);
+    if (blend > 0.0f)
+    {
+        float next[4];
+        SampleBilinear(texture.levels[level + 1], u, v, wrap, next);
+        for (int c = 0; c < 4; ++c)
+            out[c] += (next[c] - out[c]) * blend;
+    }
+}
+
+float ComputeTextureLod(const SoftwareTexture& texture, float dudx, float dvdx, float dudy, float dvdy)
+{
+    const SoftwareTexture::Level& top = texture.levels[0];
+    dudx *= (float)top.width;
+    dudy *= (float)top.width;
+    dvdx *= (float)top.height;
+    dvdy *= (float)top.height;
+    float rho = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+    return rho > 0.0f ? 0.5f * std::log2(rho) : 0.0f;
+}
+
+void SampleCube(const SoftwareTexture faces[6], const float dir[3], float lod, float out[4])
+{
+    float ax = std::fabs(dir[0]), ay = std::fabs(dir[1]), az = std::fabs(dir[2]);
+    uint32_t face;
+    float ma, sc, tc;
+    if (ax >= ay && ax >= az)
+    {
+        face = dir[0] >= 0.0f ? 0 : 1;
+        ma = ax;
+        sc = dir[0] >= 0.0f ? -dir[2] : dir[2];
+        tc = -dir[1];
+    }
+    else if (ay >= az)
+    {
+        face = dir[1] >= 0.0f ? 2 : 3;
+        ma = ay;
+        sc = dir[0];
+        tc = dir[1] >= 0.0f ? dir[2] : -dir[2];
+    }
+    else
+    {
+        face = dir[2] >= 0.0f ? 4 : 5;
+        ma = az;
+        sc = dir[2] >= 0.0f ? dir[0] : -dir[0];
+        tc = -dir[1];
+    }
+
+    float u = 0.5f * (sc / ma + 1.0f);
+    float v = 0.5f * (tc / ma + 1.0f);
+    SampleTrilinear(faces[face], u, v, lod, false, out);
+}
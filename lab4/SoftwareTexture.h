@@ -0,0 +1,47 @@
+#pragma once
+#include "DdsView.h"
+#include "TextureCache.h"
+
+class LoadScheduler;
+
+// RGBA8 mip chain decoded from a block-compressed or uncompressed DDS file,
+// for the CPU renderers. Sampling matches the lab samplers: wrap or clamp
+// addressing, bilinear within a level and a linear blend between levels.
+struct SoftwareTexture
+{
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> rgba;
+    };
+    std::vector<Level> levels;
+
+    bool Decode(const DdsView& view, LoadScheduler* pScheduler = nullptr);
+    bool IsEmpty() const { return levels.empty(); }
+};
+
+// One decoded texture per view, such as the six faces of a skybox.
+typedef std::vector<SoftwareTexture> SoftwareTextureSet;
+
+// Decodes views, or returns the set decoded earlier from the same bytes by
+// any renderer in the process. Null if a view can't be decoded.
+std::shared_ptr<const SoftwareTextureSet> AcquireSoftwareTextures(const DdsView* pViews, uint32_t viewCount,
+    LoadScheduler* pScheduler = nullptr);
+
+// The process-wide cache behind AcquireSoftwareTextures().
+TextureCache<const SoftwareTextureSet>& GetSoftwareTextureCache();
+
+// Decodes pViews into a new set; the load function for a cache of sets.
+std::shared_ptr<const SoftwareTextureSet> DecodeSoftwareTextures(const DdsView* pViews, uint32_t viewCount,
+    uint64_t& bytes, LoadScheduler* pScheduler = nullptr);
+
+void SampleBilinear(const SoftwareTexture::Level& level, float u, float v, bool wrap, float out[4]);
+void SampleTrilinear(const SoftwareTexture& texture, float u, float v, float lod, bool wrap, float out[4]);
+
+// LOD from the screen-space derivatives of (u, v), as for a 2D texture.
+float ComputeTextureLod(const SoftwareTexture& texture, float dudx, float dvdx, float dudy, float dvdy);
+
+// Samples six faces (+X, -X, +Y, -Y, +Z, -Z) as a cube map in direction dir,
+// with D3D's face selection and orientation.
+void SampleCube(const SoftwareTexture faces[6], const float dir[3], float lod, float out[4]);
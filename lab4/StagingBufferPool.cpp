@@ -0,0 +1,79 @@
+#include "StagingBufferPool.h"
+
+StagingBufferPool::Buffer& StagingBufferPool::Buffer::operator=(Buffer&& other)
+{
+    if (this != &other)
+    {
+        Release();
+        m_pPool = other.m_pPool;
+        m_pData = std::move(other.m_pData);
+        m_capacity = other.m_capacity;
+        other.m_capacity = 0;
+    }
+    return *this;
+}
+
+void StagingBufferPool::Buffer::Release()
+{
+    if (m_pPool && m_pData)
+        m_pPool->Return(std::move(m_pData), m_capacity);
+    m_pData.reset();
+    m_capacity = 0;
+}
+
+StagingBufferPool::StagingBufferPool(size_t maxBuffers, size_t maxPooledBytes)
+    : m_maxBuffers(maxBuffers)
+    , m_maxPooledBytes(maxPooledBytes)
+    , m_pooledBytes(0)
+{
+}
+
+StagingBufferPool::Buffer StagingBufferPool::Acquire(size_t size)
+{
+    Buffer buffer;
+    buffer.m_pPool = this;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t best = m_free.size();
+        for (size_t i = 0; i < m_free.size(); ++i)
+        {
+            if (m_free[i].capacity >= size && (best == m_free.size() || m_free[i].capacity < m_free[best].capacity))
+                best = i;
+        }
+        if (best != m_free.size())
+        {
+            buffer.m_pData = std::move(m_free[best].pData);
+            buffer.m_capacity = m_free[best].capacity;
+            m_pooledBytes -= buffer.m_capacity;
+            m_free.erase(m_free.begin() + best);
+            return buffer;
+        }
+    }
+
+    // new[] without () leaves the bytes uninitialised.
+    buffer.m_pData.reset(new uint8_t[size > 0 ? size : 1]);
+    buffer.m_capacity = size;
+    return buffer;
+}
+
+void StagingBufferPool::Return(std::unique_ptr<uint8_t[]> pData, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.size() >= m_maxBuffers || m_pooledBytes + capacity > m_maxPooledBytes)
+        return;
+    m_pooledBytes += capacity;
+    m_free.push_back({ std::move(pData), capacity });
+}
+
+size_t StagingBufferPool::GetPooledBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pooledBytes;
+}
+
+void StagingBufferPool::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.clear();
+    m_pooledBytes = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Recycles the CPU memory texture uploads are staged in (decoded BC blocks,
+// converted uncompressed pixels), so loading a run of textures reuses a few
+// large allocations instead of making and zeroing one per texture. Buffers
+// are left uninitialised. Thread-safe; anything that would push the pool
+// past its limits is simply freed on release.
+class StagingBufferPool
+{
+public:
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&&) = default;
+        Buffer& operator=(Buffer&& other);
+        ~Buffer() { Release(); }
+
+        uint8_t* GetData() const { return m_pData.get(); }
+        size_t GetCapacity() const { return m_capacity; }
+        // Hands the memory back to the pool early.
+        void Release();
+
+    private:
+        friend class StagingBufferPool;
+        StagingBufferPool* m_pPool = nullptr;
+        std::unique_ptr<uint8_t[]> m_pData;
+        size_t m_capacity = 0;
+    };
+
+    explicit StagingBufferPool(size_t maxBuffers = 4, size_t maxPooledBytes = 64 << 20);
+
+    StagingBufferPool(const StagingBufferPool&) = delete;
+    StagingBufferPool& operator=(const StagingBufferPool&) = delete;
+
+    // At least size bytes: the smallest pooled buffer that fits, or a new
+    // allocation.
+    Buffer Acquire(size_t size);
+
+    size_t GetPooledBytes() const;
+    void Clear();
+
+private:
+    void Return(std::unique_ptr<uint8_t[]> pData, size_t capacity);
+
+    struct Entry
+    {
+        std::unique_ptr<uint8_t[]> pData;
+        size_t capacity;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Entry> m_free;
+    size_t m_maxBuffers;
+    size_t m_maxPooledBytes;
+    size_t m_pooledBytes;
+};
@@ -0,0 +1,86 @@
+#include "StateCache.h"
+
+StateCache::StateCache()
+    : m_pDevice(nullptr)
+{
+}
+
+StateCache::~StateCache()
+{
+    Cleanup();
+}
+
+void StateCache::Initialize(ID3D11Device* device)
+{
+    Cleanup();
+    m_pDevice = device;
+}
+
+void StateCache::Cleanup()
+{
+    m_depthStencilStates.Clear();
+    m_rasterizerStates.Clear();
+    m_blendStates.Clear();
+    m_samplerStates.Clear();
+    m_pDevice = nullptr;
+}
+
+ID3D11DepthStencilState* StateCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    return m_depthStencilStates.Acquire(desc, [this](const D3D11_DEPTH_STENCIL_DESC& d) {
+        ID3D11DepthStencilState* pState = nullptr;
+        if (!m_pDevice || FAILED(m_pDevice->CreateDepthStencilState(&d, &pState)))
+            return (ID3D11DepthStencilState*)nullptr;
+        return pState;
+    });
+}
+
+ID3D11RasterizerState* StateCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+    return m_rasterizerStates.Acquire(desc, [this](const D3D11_RASTERIZER_DESC& d) {
+        ID3D11RasterizerState* pState = nullptr;
+        if (!m_pDevice || FAILED(m_pDevice->CreateRasterizerState(&d, &pState)))
+            return (ID3D11RasterizerState*)nullptr;
+        return pState;
+    });
+}
+
+ID3D11BlendState* StateCache::GetBlendState(const D3D11_BLEND_DESC& desc)
+{
+    return m_blendStates.Acquire(desc, [this](const D3D11_BLEND_DESC& d) {
+        ID3D11BlendState* pState = nullptr;
+        if (!m_pDevice || FAILED(m_pDevice->CreateBlendState(&d, &pState)))
+            return (ID3D11BlendState*)nullptr;
+        return pState;
+    });
+}
+
+ID3D11SamplerState* StateCache::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+    return m_samplerStates.Acquire(desc, [this](const D3D11_SAMPLER_DESC& d) {
+        ID3D11SamplerState* pState = nullptr;
+        if (!m_pDevice || FAILED(m_pDevice->CreateSamplerState(&d, &pState)))
+            return (ID3D11SamplerState*)nullptr;
+        return pState;
+    });
+}
+
+StateCacheStats StateCache::GetStats() const
+{
+    StateCacheStats stats;
+    stats.hits = m_depthStencilStates.GetHits() + m_rasterizerStates.GetHits() +
+        m_blendStates.GetHits() + m_samplerStates.GetHits();
+    stats.misses = m_depthStencilStates.GetMisses() + m_rasterizerStates.GetMisses() +
+        m_blendStates.GetMisses() + m_samplerStates.GetMisses();
+    stats.objects = m_depthStencilStates.GetSize() + m_rasterizerStates.GetSize() +
+        m_blendStates.GetSize() + m_samplerStates.GetSize();
+    return stats;
+}
+
+void StateCache::ResetCounters()
+{
+    m_depthStencilStates.ResetCounters();
+    m_rasterizerStates.ResetCounters();
+    m_blendStates.ResetCounters();
+    m_samplerStates.ResetCounters();
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <d3d11.h>
+#include "StateObjectCache.h"
+
+struct StateCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t objects = 0;
+};
+
+// Creates each depth-stencil, rasterizer, blend and sampler state once and
+// returns the same pointer for every later request with an identical
+// descriptor. Pointers stay valid until Cleanup(); callers must not Release
+// them.
+class StateCache
+{
+public:
+    StateCache();
+    ~StateCache();
+
+    void Initialize(ID3D11Device* device);
+    void Cleanup();
+
+    ID3D11DepthStencilState* GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+    ID3D11RasterizerState* GetRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+    ID3D11BlendState* GetBlendState(const D3D11_BLEND_DESC& desc);
+    ID3D11SamplerState* GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+
+    StateCacheStats GetStats() const;
+    void ResetCounters();
+
+private:
+    ID3D11Device* m_pDevice;
+    StateObjectCache<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState> m_depthStencilStates;
+    StateObjectCache<D3D11_RASTERIZER_DESC, ID3D11RasterizerState> m_rasterizerStates;
+    StateObjectCache<D3D11_BLEND_DESC, ID3D11BlendState> m_blendStates;
+    StateObjectCache<D3D11_SAMPLER_DESC, ID3D11SamplerState> m_samplerStates;
+};
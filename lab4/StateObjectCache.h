@@ -0,0 +1,66 @@
+#pragma once
+#include "Hash.h"
+#include <cstring>
+#include <unordered_map>
+
+// Deduplicating cache for immutable pipeline state objects. Descriptors are
+// hashed and compared bytewise, so callers must zero-initialise them
+// (`Desc desc = {};`) before filling in fields. The create callback is only
+// invoked on a miss; after that the same pointer is handed out for the
+// lifetime of the cache, which owns one reference to every object.
+template<typename Desc, typename Object>
+class StateObjectCache
+{
+public:
+    StateObjectCache() : m_hits(0), m_misses(0) {}
+    ~StateObjectCache() { Clear(); }
+
+    StateObjectCache(const StateObjectCache&) = delete;
+    StateObjectCache& operator=(const StateObjectCache&) = delete;
+
+    template<typename CreateFn>
+    Object* Acquire(const Desc& desc, CreateFn&& create)
+    {
+        uint64_t key = HashBytes(&desc, sizeof(Desc));
+        auto range = m_entries.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (memcmp(&it->second.desc, &desc, sizeof(Desc)) == 0)
+            {
+                ++m_hits;
+                return it->second.pObject;
+            }
+        }
+
+        ++m_misses;
+        Object* pObject = create(desc);
+        if (!pObject)
+            return nullptr;
+
+        m_entries.emplace(key, Entry{ desc, pObject });
+        return pObject;
+    }
+
+    void Clear()
+    {
+        for (auto& entry : m_entries)
+            entry.second.pObject->Release();
+        m_entries.clear();
+    }
+
+    size_t GetSize() const { return m_entries.size(); }
+    uint64_t GetHits() const { return m_hits; }
+    uint64_t GetMisses() const { return m_misses; }
+    void ResetCounters() { m_hits = m_misses = 0; }
+
+private:
+    struct Entry
+    {
+        Desc desc;
+        Object* pObject;
+    };
+
+    std::unordered_multimap<uint64_t, Entry> m_entries;
+    uint64_t m_hits;
+    uint64_t m_misses;
+};
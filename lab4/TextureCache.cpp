@@ -0,0 +1,69 @@
+#include "TextureCache.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cwchar>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+bool GetTextureFileStamp(const std::wstring& path, uint64_t& stamp)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+        return false;
+
+    // 100 ns write time and the size: a same-size rewrite still changes it.
+    uint64_t fields[2] = {
+        ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime,
+        ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow
+    };
+    stamp = HashContent(fields, sizeof(fields));
+    return true;
+}
+
+#else
+
+bool GetTextureFileStamp(const std::wstring& path, uint64_t& stamp)
+{
+    std::mbstate_t state = {};
+    const wchar_t* src = path.c_str();
+    size_t len = std::wcsrtombs(nullptr, &src, 0, &state);
+    if (len == (size_t)-1)
+        return false;
+
+    std::string narrow(len, '\0');
+    src = path.c_str();
+    std::wcsrtombs(&narrow[0], &src, len, &state);
+
+    struct stat st;
+    if (stat(narrow.c_str(), &st) != 0)
+        return false;
+
+    uint64_t fields[3] = { (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec, (uint64_t)st.st_size };
+    stamp = HashContent(fields, sizeof(fields));
+    return true;
+}
+
+#endif
+
+uint64_t HashDdsContent(const DdsView& view, uint64_t hash, uint32_t firstMip)
+{
+    const uint32_t shape[8] = {
+        (uint32_t)view.GetFormat(), (uint32_t)view.GetPixelLayout(), view.GetWidth(), view.GetHeight(),
+        view.GetMipCount(), view.GetArraySize(), view.IsCubemap() ? 1u : 0u, firstMip
+    };
+    hash = HashContent(shape, sizeof(shape), hash);
+    for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+    {
+        for (uint32_t level = firstMip; level < view.GetMipCount(); ++level)
+        {
+            const DdsMipSpan& mip = view.GetMip(slice, level);
+            hash = HashContent(mip.pData, mip.size, hash);
+        }
+    }
+    return hash;
+}
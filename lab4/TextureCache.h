@@ -0,0 +1,307 @@
+#pragma once
+#include "DdsView.h"
+#include "Hash.h"
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TextureCacheStats
+{
+    uint32_t lookups = 0;
+    uint32_t pathHits = 0;          // path, mtime and size unchanged; nothing opened
+    uint32_t contentHits = 0;       // opened and hashed, same bytes as an entry
+    uint32_t loads = 0;
+    uint32_t failures = 0;
+    uint64_t bytesLoaded = 0;       // what the loads produced
+    uint64_t bytesShared = 0;       // what the hits would have loaded again
+};
+
+struct TextureCacheEntryInfo
+{
+    std::wstring name;              // first path it was loaded from, if any
+    uint64_t contentKey = 0;
+    uint64_t bytes = 0;
+    uint32_t hits = 0;
+    long users = 0;                 // handles held outside the cache
+};
+
+// mtime and size of path folded into one value, or false if it can't be
+// read.
+bool GetTextureFileStamp(const std::wstring& path, uint64_t& stamp);
+
+// Hash of a texture's shape and mips firstMip.. of every slice, so the same
+// pixels key the same whether they come from a loose file or an archive.
+// Levels above firstMip are not read.
+uint64_t HashDdsContent(const DdsView& view, uint64_t hash = 0, uint32_t firstMip = 0);
+
+// Deduplicating cache of whatever a backend makes from DDS files: decoded
+// textures for the CPU renderers, SRVs for D3D11. Entries are keyed by
+// content, so identical files under different paths load once; a path
+// whose mtime and size haven't changed since it was last seen is a hit
+// without opening the file. Loads at a reduced TextureQuality key on the
+// levels they keep and hash only those. scope separates what can't be shared, such as
+// resources of different devices. Handles are shared: the cache keeps one
+// and Trim() drops entries nobody else holds. Thread-safe; a thread missing
+// on content another thread is already loading waits for that load instead
+// of starting its own.
+template<typename T>
+class TextureCache
+{
+public:
+    typedef std::shared_ptr<T> Handle;
+    // Builds the resource from the open files and sets bytes to its size.
+    // Returns null on failure. Load functions apply the quality they were
+    // acquired with themselves.
+    typedef std::function<Handle(const DdsView* pViews, uint32_t viewCount, uint64_t& bytes)> LoadFn;
+
+    Handle Acquire(const std::wstring* pPaths, uint32_t pathCount, uint64_t scope, const LoadFn& load,
+        const TextureQuality& quality = TextureQuality());
+
+    Handle Acquire(const std::wstring& path, uint64_t scope, const LoadFn& load,
+        const TextureQuality& quality = TextureQuality())
+    {
+        return Acquire(&path, 1, scope, load, quality);
+    }
+
+    // Files the caller already has open, keyed by content alone.
+    Handle Acquire(const DdsView* pViews, uint32_t viewCount, uint64_t scope, const LoadFn& load,
+        const TextureQuality& quality = TextureQuality())
+    {
+        return AcquireContent(pViews, viewCount, ComputeContentKey(pViews, viewCount, scope, quality), load,
+            std::wstring(), nullptr, 0);
+    }
+
+    // Drops entries only the cache holds; returns how many went.
+    size_t Trim();
+    void Clear();
+
+    TextureCacheStats GetStats() const;
+    std::vector<TextureCacheEntryInfo> GetEntries() const;
+
+private:
+    struct Entry
+    {
+        Handle handle;
+        std::wstring name;
+        uint64_t bytes;
+        uint32_t hits;
+    };
+
+    struct PathRecord
+    {
+        uint64_t stamp;
+        uint64_t contentKey;
+    };
+
+    static uint64_t ComputeContentKey(const DdsView* pViews, uint32_t viewCount, uint64_t scope,
+        const TextureQuality& quality);
+
+    Handle AcquireContent(const DdsView* pViews, uint32_t viewCount, uint64_t contentKey, const LoadFn& load,
+        const std::wstring& name, const std::wstring* pPathKey, uint64_t stamp);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::unordered_map<uint64_t, std::shared_future<Handle>> m_loading;
+    std::unordered_map<std::wstring, PathRecord> m_paths;
+    TextureCacheStats m_stats;
+};
+
+template<typename T>
+uint64_t TextureCache<T>::ComputeContentKey(const DdsView* pViews, uint32_t viewCount, uint64_t scope,
+    const TextureQuality& quality)
+{
+    uint64_t key = HashContent(&scope, sizeof(scope));
+    for (uint32_t i = 0; i < viewCount; ++i)
+        key = HashDdsContent(pViews[i], key, GetQualityFirstMip(pViews[i], quality));
+    return key;
+}
+
+template<typename T>
+typename TextureCache<T>::Handle TextureCache<T>::Acquire(const std::wstring* pPaths, uint32_t pathCount,
+    uint64_t scope, const LoadFn& load, const TextureQuality& quality)
+{
+    // The same path at another quality is a different texture.
+    std::wstring pathKey = std::to_wstring(scope) + L'/' + std::to_wstring(quality.dropMips) + L'/' +
+        std::to_wstring(quality.maxDimension);
+    uint64_t stamp = HashContent(&pathCount, sizeof(pathCount));
+    bool stamped = true;
+    for (uint32_t i = 0; i < pathCount; ++i)
+    {
+        uint64_t fileStamp = 0;
+        stamped = stamped && GetTextureFileStamp(pPaths[i], fileStamp);
+        stamp = HashContent(&fileStamp, sizeof(fileStamp), stamp);
+        pathKey += L'|';
+        pathKey += pPaths[i];
+    }
+
+    if (stamped)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto record = m_paths.find(pathKey);
+        if (record != m_paths.end() && record->second.stamp == stamp)
+        {
+            auto entry = m_entries.find(record->second.contentKey);
+            if (entry != m_entries.end())
+            {
+                ++m_stats.lookups;
+                ++m_stats.pathHits;
+                ++entry->second.hits;
+                m_stats.bytesShared += entry->second.bytes;
+                return entry->second.handle;
+            }
+        }
+    }
+
+    // Below full quality only the kept levels are read, for the hash and
+    // the load alike.
+    std::vector<DdsView> views(pathCount);
+    for (uint32_t i = 0; i < pathCount; ++i)
+    {
+        if (!views[i].Open(pPaths[i].c_str(), quality.IsFull()))
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.lookups;
+            ++m_stats.failures;
+            return nullptr;
+        }
+        if (!quality.IsFull())
+            views[i].ReadAheadMips(GetQualityFirstMip(views[i], quality));
+    }
+
+    const uint64_t contentKey = ComputeContentKey(views.data(), pathCount, scope, quality);
+    return AcquireContent(views.data(), pathCount, contentKey, load, pathCount ? pPaths[0] : std::wstring(),
+        stamped ? &pathKey : nullptr, stamp);
+}
+
+template<typename T>
+typename TextureCache<T>::Handle TextureCache<T>::AcquireContent(const DdsView* pViews, uint32_t viewCount,
+    uint64_t contentKey, const LoadFn& load, const std::wstring& name, const std::wstring* pPathKey, uint64_t stamp)
+{
+    std::promise<Handle> loaded;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_stats.lookups;
+        auto entry = m_entries.find(contentKey);
+        if (entry != m_entries.end())
+        {
+            ++m_stats.contentHits;
+            ++entry->second.hits;
+            m_stats.bytesShared += entry->second.bytes;
+            if (pPathKey)
+                m_paths[*pPathKey] = PathRecord{ stamp, contentKey };
+            return entry->second.handle;
+        }
+
+        auto loading = m_loading.find(contentKey);
+        if (loading != m_loading.end())
+        {
+            std::shared_future<Handle> pending = loading->second;
+            lock.unlock();
+            Handle handle = pending.get();
+
+            lock.lock();
+            if (!handle)
+            {
+                ++m_stats.failures;
+                return nullptr;
+            }
+            ++m_stats.contentHits;
+            auto done = m_entries.find(contentKey);
+            if (done != m_entries.end())
+            {
+                ++done->second.hits;
+                m_stats.bytesShared += done->second.bytes;
+                if (pPathKey)
+                    m_paths[*pPathKey] = PathRecord{ stamp, contentKey };
+            }
+            return handle;
+        }
+        m_loading.emplace(contentKey, loaded.get_future().share());
+    }
+
+    // Loads run unlocked so different textures load in parallel.
+    uint64_t bytes = 0;
+    Handle handle = load(pViews, viewCount, bytes);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loading.erase(contentKey);
+    if (!handle)
+    {
+        ++m_stats.failures;
+        loaded.set_value(nullptr);
+        return nullptr;
+    }
+
+    ++m_stats.loads;
+    m_stats.bytesLoaded += bytes;
+    if (pPathKey)
+        m_paths[*pPathKey] = PathRecord{ stamp, contentKey };
+    m_entries.emplace(contentKey, Entry{ handle, name, bytes, 0 });
+    loaded.set_value(handle);
+    return handle;
+}
+
+template<typename T>
+size_t TextureCache<T>::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t removed = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->second.handle.use_count() == 1)
+        {
+            it = m_entries.erase(it);
+            ++removed;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (auto it = m_paths.begin(); it != m_paths.end();)
+    {
+        if (m_entries.find(it->second.contentKey) == m_entries.end())
+            it = m_paths.erase(it);
+        else
+            ++it;
+    }
+    return removed;
+}
+
+template<typename T>
+void TextureCache<T>::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_paths.clear();
+}
+
+template<typename T>
+TextureCacheStats TextureCache<T>::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+template<typename T>
+std::vector<TextureCacheEntryInfo> TextureCache<T>::GetEntries() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<TextureCacheEntryInfo> entries;
+    entries.reserve(m_entries.size());
+    for (const auto& it : m_entries)
+    {
+        TextureCacheEntryInfo info;
+        info.name = it.second.name;
+        info.contentKey = it.first;
+        info.bytes = it.second.bytes;
+        info.hits = it.second.hits;
+        info.users = it.second.handle.use_count() - 1;
+        entries.push_back(info);
+    }
+    return entries;
+}
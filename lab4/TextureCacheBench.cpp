@@ -0,0 +1,132 @@
+#include "TextureCacheBench.h"
+#include "BenchUtil.h"
+#include <cstdio>
+
+namespace
+{
+    bool SameTextures(const SoftwareTextureSet& a, const SoftwareTextureSet& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].levels.size() != b[i].levels.size())
+                return false;
+            for (size_t level = 0; level < a[i].levels.size(); ++level)
+            {
+                if (a[i].levels[level].rgba != b[i].levels[level].rgba)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    double MeasureHashGBps(const std::wstring* pPaths, uint32_t pathCount)
+    {
+        uint64_t bytes = 0;
+        volatile uint64_t sink = 0;
+        std::vector<DdsView> views(pathCount);
+        for (uint32_t i = 0; i < pathCount; ++i)
+        {
+            views[i].Open(pPaths[i].c_str());
+            views[i].Prefetch();
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        for (const DdsView& view : views)
+        {
+            if (!view.IsOpen())
+                continue;
+            sink = sink + HashDdsContent(view);
+            bytes += view.GetMappedSize();
+        }
+        const double ms = ElapsedMs(start, BenchClock::now());
+        (void)sink;
+        return ms > 0.0 ? (double)bytes / (ms * 1e6) : 0.0;
+    }
+}
+
+bool RunTextureCacheBenchmark(const std::wstring* pPaths, uint32_t pathCount, const uint32_t* pReferenceCounts,
+    uint32_t countCount, std::vector<TextureCacheBenchResult>& results)
+{
+    if (pathCount == 0)
+        return false;
+
+    // Plain decodes to check the cached handles against.
+    std::vector<std::shared_ptr<const SoftwareTextureSet>> expected(pathCount);
+    for (uint32_t i = 0; i < pathCount; ++i)
+    {
+        DdsView view;
+        uint64_t bytes = 0;
+        if (!view.Open(pPaths[i].c_str()) || !(expected[i] = DecodeSoftwareTextures(&view, 1, bytes)))
+            return false;
+    }
+
+    const double hashGBps = MeasureHashGBps(pPaths, pathCount);
+    const TextureCache<const SoftwareTextureSet>::LoadFn load =
+        [](const DdsView* pViews, uint32_t viewCount, uint64_t& bytes) {
+            return DecodeSoftwareTextures(pViews, viewCount, bytes);
+        };
+
+    for (uint32_t c = 0; c < countCount; ++c)
+    {
+        TextureCacheBenchResult result;
+        result.references = pReferenceCounts[c];
+        result.paths = pathCount;
+        result.hashGBps = hashGBps;
+
+        // Without the cache every reference is its own copy; they are
+        // dropped straight away only to keep the run within memory.
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t r = 0; r < result.references; ++r)
+        {
+            DdsView view;
+            uint64_t bytes = 0;
+            if (!view.Open(pPaths[r % pathCount].c_str()) || !DecodeSoftwareTextures(&view, 1, bytes))
+                return false;
+        }
+        result.uncachedMs = ElapsedMs(start, BenchClock::now());
+
+        TextureCache<const SoftwareTextureSet> cache;
+        std::vector<std::shared_ptr<const SoftwareTextureSet>> handles(result.references);
+        start = BenchClock::now();
+        for (uint32_t r = 0; r < result.references; ++r)
+            handles[r] = cache.Acquire(pPaths[r % pathCount], 0, load);
+        result.cachedMs = ElapsedMs(start, BenchClock::now());
+
+        for (uint32_t r = 0; r < result.references; ++r)
+        {
+            result.matchesUncached = result.matchesUncached && handles[r] &&
+                SameTextures(*handles[r], *expected[r % pathCount]);
+        }
+
+        const TextureCacheStats stats = cache.GetStats();
+        result.loads = stats.loads;
+        result.pathHits = stats.pathHits;
+        result.contentHits = stats.contentHits;
+        result.bytesLoaded = stats.bytesLoaded;
+        result.bytesShared = stats.bytesShared;
+        results.push_back(result);
+    }
+    return true;
+}
+
+bool WriteTextureCacheBenchmarkCsv(const char* filename, const std::vector<TextureCacheBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "references,paths,loads,path_hits,content_hits,bytes_loaded,bytes_shared,"
+        "uncached_ms,cached_ms,hash_gb_s,matches_uncached\n");
+    for (const TextureCacheBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%u,%u,%u,%u,%llu,%llu,%.3f,%.3f,%.2f,%d\n",
+            r.references, r.paths, r.loads, r.pathHits, r.contentHits,
+            (unsigned long long)r.bytesLoaded, (unsigned long long)r.bytesShared,
+            r.uncachedMs, r.cachedMs, r.hashGBps, r.matchesUncached ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "SoftwareTexture.h"
+#include <string>
+
+// A scene referencing references textures, cycling through a list of paths
+// that may include byte-identical copies, loaded once without a cache
+// (open and decode every reference) and once through a TextureCache of
+// decoded textures. The counters are the cache's own.
+struct TextureCacheBenchResult
+{
+    uint32_t references = 0;
+    uint32_t paths = 0;
+    uint32_t loads = 0;
+    uint32_t pathHits = 0;
+    uint32_t contentHits = 0;
+    uint64_t bytesLoaded = 0;
+    uint64_t bytesShared = 0;
+    double uncachedMs = 0.0;
+    double cachedMs = 0.0;
+    double hashGBps = 0.0;          // HashContent over the files' texel data
+    bool matchesUncached = true;    // every handle holds what a plain decode gives
+};
+
+bool RunTextureCacheBenchmark(const std::wstring* pPaths, uint32_t pathCount, const uint32_t* pReferenceCounts,
+    uint32_t countCount, std::vector<TextureCacheBenchResult>& results);
+
+bool WriteTextureCacheBenchmarkCsv(const char* filename, const std::vector<TextureCacheBenchResult>& results);
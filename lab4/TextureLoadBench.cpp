@@ -0,0 +1,120 @@
+#include "TextureLoadBench.h"
+#include "BenchUtil.h"
+#include "DdsView.h"
+#include "LoadScheduler.h"
+#include <cstring>
+
+namespace
+{
+    // The serial load's bytes, kept off the mapping so the files can be
+    // dropped from the page cache again.
+    bool SameBytes(const DdsView& view, const std::vector<uint8_t>& bytes)
+    {
+        return view.IsOpen() && view.GetMappedSize() == bytes.size() &&
+            memcmp(view.GetMappedData(), bytes.data(), bytes.size()) == 0;
+    }
+
+    bool EvictAll(const std::string* pPaths, uint32_t fileCount)
+    {
+        bool evicted = true;
+        for (uint32_t f = 0; f < fileCount; ++f)
+            evicted = MappedFile::EvictFromPageCache(pPaths[f].c_str()) && evicted;
+        return evicted;
+    }
+}
+
+bool RunTextureLoadBenchmark(const std::string* pPaths, uint32_t fileCount, const unsigned* pWorkerCounts,
+    uint32_t workerRowCount, uint32_t iterations, std::vector<TextureLoadBenchResult>& results)
+{
+    if (iterations == 0)
+        iterations = 1;
+
+    std::vector<DdsView> serial(fileCount);
+    std::vector<std::vector<uint8_t>> reference(fileCount);
+    std::vector<DdsView> parallel(fileCount);
+    std::vector<std::future<DdsView>> loads(fileCount);
+    for (int cold = 0; cold < 2; ++cold)
+    {
+        if (cold && !EvictAll(pPaths, fileCount))
+            break;
+
+        TextureLoadBenchResult base;
+        base.mode = "serial";
+        base.cold = cold != 0;
+        base.files = fileCount;
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            serial.clear();
+            serial.resize(fileCount);
+            if (cold)
+                EvictAll(pPaths, fileCount);
+
+            const BenchClock::time_point start = BenchClock::now();
+            for (uint32_t f = 0; f < fileCount; ++f)
+                serial[f] = LoadDdsView(pPaths[f].c_str());
+            base.loadMs += ElapsedMs(start, BenchClock::now());
+        }
+        base.loadMs /= iterations;
+        for (uint32_t f = 0; f < fileCount; ++f)
+        {
+            if (!serial[f].IsOpen())
+                return false;
+            reference[f].assign(serial[f].GetMappedData(), serial[f].GetMappedData() + serial[f].GetMappedSize());
+            base.bytes += reference[f].size();
+        }
+        serial.clear();
+        results.push_back(base);
+
+        for (uint32_t row = 0; row < workerRowCount; ++row)
+        {
+            LoadScheduler scheduler(pWorkerCounts[row]);
+            TextureLoadBenchResult result = base;
+            result.mode = "parallel";
+            result.workers = scheduler.GetWorkerCount();
+            result.loadMs = 0.0;
+            for (uint32_t it = 0; it < iterations; ++it)
+            {
+                parallel.clear();
+                parallel.resize(fileCount);
+                if (cold)
+                    EvictAll(pPaths, fileCount);
+
+                const BenchClock::time_point start = BenchClock::now();
+                for (uint32_t f = 0; f < fileCount; ++f)
+                {
+                    const std::string path = pPaths[f];
+                    loads[f] = scheduler.Submit([path]() { return LoadDdsView(path.c_str()); });
+                }
+                for (uint32_t f = 0; f < fileCount; ++f)
+                    parallel[f] = loads[f].get();
+                result.loadMs += ElapsedMs(start, BenchClock::now());
+
+                for (uint32_t f = 0; f < fileCount; ++f)
+                    result.matchesSerial = result.matchesSerial && SameBytes(parallel[f], reference[f]);
+            }
+            parallel.clear();
+            result.loadMs /= iterations;
+            result.speedup = result.loadMs > 0.0 ? base.loadMs / result.loadMs : 0.0;
+            results.push_back(result);
+        }
+    }
+    return true;
+}
+
+bool WriteTextureLoadBenchmarkCsv(const char* filename, const std::vector<TextureLoadBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "mode,workers,cold,files,bytes,load_ms,speedup,matches_serial\n");
+    for (const TextureLoadBenchResult& r : results)
+    {
+        fprintf(pFile, "%s,%u,%d,%u,%llu,%.4f,%.2f,%d\n",
+            r.mode, r.workers, r.cold ? 1 : 0, r.files, (unsigned long long)r.bytes, r.loadMs, r.speedup,
+            r.matchesSerial ? 1 : 0);
+    }
+
+    fclose(pFile);
+    return true;
+}
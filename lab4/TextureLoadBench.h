@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Time to load a set of files, such as the six skybox faces, with the
+// load job LoadDDSAsync() runs (LoadDdsView with prefetch): one after
+// another on the calling thread, as startup used to, or all submitted to a
+// LoadScheduler at once. The scheduler is created before timing starts, as
+// the renderer creates it before loading. Cold rows drop the files from
+// the page cache before every load; that needs posix_fadvise, so on
+// Windows only warm rows are written.
+struct TextureLoadBenchResult
+{
+    const char* mode = "";          // "serial" or "parallel"
+    uint32_t workers = 0;           // 0 for serial
+    bool cold = false;
+    uint32_t files = 0;
+    uint64_t bytes = 0;
+    double loadMs = 0.0;
+    double speedup = 1.0;           // over the serial row at the same temperature
+    bool matchesSerial = true;      // every view holds the serial load's bytes
+};
+
+bool RunTextureLoadBenchmark(const std::string* pPaths, uint32_t fileCount, const unsigned* pWorkerCounts,
+    uint32_t workerRowCount, uint32_t iterations, std::vector<TextureLoadBenchResult>& results);
+
+bool WriteTextureLoadBenchmarkCsv(const char* filename, const std::vector<TextureLoadBenchResult>& results);
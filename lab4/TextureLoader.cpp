@@ -1,209 +1,402 @@
 ﻿#include "TextureLoader.h"
+#include "BlockDecoder.h"
+#include "BlockEncoder.h"
+#include "PixelConverter.h"
+#include "StagingBufferPool.h"
+#include <cstring>
 
 UINT TextureLoader::GetBytesPerBlock(DXGI_FORMAT fmt)
 {
-    switch (fmt)
-    {
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC4_UNORM:
-        return 8;
-    case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC5_UNORM:
-        return 16;
-    default:
-        return 0;
-    }
+    return DdsBytesPerBlock(fmt);
 }
 
-bool TextureLoader::LoadDDS(const wchar_t* filename, TextureDesc& desc)
+bool TextureLoader::LoadDDS(const wchar_t* filename, TextureDesc& desc, const TextureQuality& quality)
 {
-    HANDLE hFile = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
-        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE)
+    // Below full quality the file is mapped without read-ahead and only the
+    // kept levels are read in, so the dropped ones never come off disk.
+    DdsView view;
+    if (!view.Open(filename, quality.IsFull()))
         return false;
 
-    DWORD dwMagic;
-    DWORD dwBytesRead;
-    ReadFile(hFile, &dwMagic, sizeof(DWORD), &dwBytesRead, NULL);
-    if (dwMagic != DDS_MAGIC)
+    const UINT firstMip = GetQualityFirstMip(view, quality);
+    if (!quality.IsFull())
+        view.ReadAheadMips(firstMip);
+    desc.pData = malloc(GetDdsMipChainsSize(view, firstMip));
+    if (!desc.pData)
+        return false;
+    if (!CopyDdsMipChains(view, firstMip, (uint8_t*)desc.pData))
     {
-        CloseHandle(hFile);
+        free(desc.pData);
+        desc.pData = nullptr;
         return false;
     }
 
-    DDS_HEADER header;
-    ReadFile(hFile, &header, sizeof(DDS_HEADER), &dwBytesRead, NULL);
+    desc.width = view.GetMip(firstMip).width;
+    desc.height = view.GetMip(firstMip).height;
+    desc.mipmapsCount = view.GetMipCount() - firstMip;
+    desc.arraySize = view.GetArraySize();
+    desc.cubemap = view.IsCubemap();
+    desc.fmt = view.GetFormat();
+    return true;
+}
 
-    desc.width = header.dwWidth;
-    desc.height = header.dwHeight;
-    desc.mipmapsCount = (header.dwSurfaceFlags & DDS_SURFACE_FLAGS_MIPMAP) ?
-        max(1, header.dwMipMapCount) : 1;
+std::future<DdsView> TextureLoader::LoadDDSAsync(LoadScheduler& scheduler, const std::wstring& filename, bool prefetch)
+{
+    return scheduler.Submit([filename, prefetch]() { return LoadDdsView(filename.c_str(), prefetch); });
+}
 
-    if (header.ddspf.dwFlags & DDS_FOURCC)
+// View over every mip and slice of pTexture, shaped after the file: a cube,
+// cube array, 2D array or plain 2D texture. Releases pTexture.
+static ID3D11ShaderResourceView* CreateShaderResourceView(ID3D11Device* device, ID3D11Texture2D* pTexture,
+    DXGI_FORMAT format, UINT mipCount, UINT arraySize, bool cubemap)
+{
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = format;
+    if (cubemap && arraySize > 6)
     {
-        switch (header.ddspf.dwFourCC)
-        {
-        case FOURCC_DXT1: desc.fmt = DXGI_FORMAT_BC1_UNORM; break;
-        case FOURCC_DXT3: desc.fmt = DXGI_FORMAT_BC2_UNORM; break;
-        case FOURCC_DXT5: desc.fmt = DXGI_FORMAT_BC3_UNORM; break;
-        default: desc.fmt = DXGI_FORMAT_UNKNOWN; break;
-        }
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+        srvDesc.TextureCubeArray.MipLevels = mipCount;
+        srvDesc.TextureCubeArray.NumCubes = arraySize / 6;
     }
-    else if (header.ddspf.dwFlags & DDS_RGB)
+    else if (cubemap)
     {
-        if (header.ddspf.dwRGBBitCount == 32)
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+        srvDesc.TextureCube.MipLevels = mipCount;
+    }
+    else if (arraySize > 1)
+    {
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MipLevels = mipCount;
+        srvDesc.Texture2DArray.ArraySize = arraySize;
+    }
+    else
+    {
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = mipCount;
+    }
+
+    ID3D11ShaderResourceView* pSRV = nullptr;
+    device->CreateShaderResourceView(pTexture, &srvDesc, &pSRV);
+    pTexture->Release();
+    return pSRV;
+}
+
+ID3D11ShaderResourceView* TextureLoader::CreateTexture2D(ID3D11Device* device, const TextureDesc& desc)
+{
+    D3D11_TEXTURE2D_DESC tex2DDesc = {};
+    tex2DDesc.Width = desc.width;
+    tex2DDesc.Height = desc.height;
+    tex2DDesc.MipLevels = desc.mipmapsCount;
+    tex2DDesc.ArraySize = desc.arraySize;
+    tex2DDesc.Format = desc.fmt;
+    tex2DDesc.SampleDesc.Count = 1;
+    tex2DDesc.SampleDesc.Quality = 0;
+    tex2DDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    tex2DDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    tex2DDesc.MiscFlags = desc.cubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+    std::vector<D3D11_SUBRESOURCE_DATA> initData(desc.arraySize * desc.mipmapsCount);
+    BYTE* pDataPtr = (BYTE*)desc.pData;
+
+    for (UINT slice = 0; slice < desc.arraySize; ++slice)
+    {
+        UINT width = desc.width;
+        UINT height = desc.height;
+
+        for (UINT i = 0; i < desc.mipmapsCount; ++i)
         {
-            if (header.ddspf.dwABitMask != 0)
-                desc.fmt = DXGI_FORMAT_R8G8B8A8_UNORM;
-            else
-                desc.fmt = DXGI_FORMAT_B8G8R8X8_UNORM;
+            // Block rows for BC formats, pixel rows for RGBA8.
+            uint32_t pitch, rowCount;
+            DdsGetMipLayout(DdsGetPixelLayout(desc.fmt), desc.fmt, width, height, pitch, rowCount);
+
+            D3D11_SUBRESOURCE_DATA& data = initData[slice * desc.mipmapsCount + i];
+            data.pSysMem = pDataPtr;
+            data.SysMemPitch = pitch;
+            data.SysMemSlicePitch = 0;
+
+            pDataPtr += (size_t)pitch * rowCount;
+            width = max(1, width / 2);
+            height = max(1, height / 2);
         }
-        else if (header.ddspf.dwRGBBitCount == 24)
-            desc.fmt = DXGI_FORMAT_R8G8B8A8_UNORM;
-        else
-            desc.fmt = DXGI_FORMAT_UNKNOWN;
     }
 
-    if (desc.fmt == DXGI_FORMAT_UNKNOWN)
-    {
-        CloseHandle(hFile);
+    ID3D11Texture2D* pTexture = nullptr;
+    if (FAILED(device->CreateTexture2D(&tex2DDesc, initData.data(), &pTexture)))
+        return nullptr;
+
+    return CreateShaderResourceView(device, pTexture, desc.fmt, desc.mipmapsCount, desc.arraySize, desc.cubemap);
+}
+
+// BC textures the device can't sample are decoded to RGBA8 on the CPU.
+static bool NeedsCpuDecode(ID3D11Device* device, DXGI_FORMAT fmt, UINT requiredSupport)
+{
+    if (!IsBlockDecodeFormat(fmt))
         return false;
-    }
 
-    UINT totalSize = 0;
-    UINT width = desc.width;
-    UINT height = desc.height;
+    UINT support = 0;
+    if (FAILED(device->CheckFormatSupport(fmt, &support)))
+        return true;
+    return (support & requiredSupport) != requiredSupport;
+}
+
+static bool s_compressOnLoad = false;
+
+void TextureLoader::SetCompressOnLoad(bool enable)
+{
+    s_compressOnLoad = enable;
+}
+
+// Block format an uncompressed view is encoded to under compress-on-load,
+// or UNKNOWN when it stays as it is or the device can't use the format.
+static DXGI_FORMAT GetCompressOnLoadFormat(ID3D11Device* device, const DdsView& view, UINT firstMip,
+    UINT requiredSupport)
+{
+    if (!s_compressOnLoad)
+        return DXGI_FORMAT_UNKNOWN;
+    const DXGI_FORMAT fmt = GetCompressOnLoadFormat(view, firstMip);
+    UINT support = 0;
+    if (fmt == DXGI_FORMAT_UNKNOWN || FAILED(device->CheckFormatSupport(fmt, &support)) ||
+        (support & requiredSupport) != requiredSupport)
+        return DXGI_FORMAT_UNKNOWN;
+    return fmt;
+}
 
-    for (UINT i = 0; i < desc.mipmapsCount; ++i)
+// Format of the staging copy view goes through, or UNKNOWN when it is
+// uploaded straight from the mapping: RGBA8 for BC textures the device
+// can't sample and every uncompressed layout but RGBA8 itself, BC1/BC3 for
+// uncompressed files under compress-on-load.
+static DXGI_FORMAT GetStagedFormat(ID3D11Device* device, const DdsView& view, UINT firstMip, UINT requiredSupport)
+{
+    if (view.GetPixelLayout() == DDS_PIXELS_BLOCK)
     {
-        UINT blockWidth = DivUp(width, 4u);
-        UINT blockHeight = DivUp(height, 4u);
-        UINT mipSize = blockWidth * blockHeight * GetBytesPerBlock(desc.fmt);
-        totalSize += mipSize;
-        width = max(1, width / 2);
-        height = max(1, height / 2);
+        return NeedsCpuDecode(device, view.GetFormat(), requiredSupport) ?
+            DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_UNKNOWN;
     }
 
-    desc.pData = malloc(totalSize);
-    if (!desc.pData)
+    const DXGI_FORMAT compressed = GetCompressOnLoadFormat(device, view, firstMip, requiredSupport);
+    if (compressed != DXGI_FORMAT_UNKNOWN)
+        return compressed;
+    return view.GetPixelLayout() != DDS_PIXELS_RGBA32 ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_UNKNOWN;
+}
+
+// Staging bytes for mips firstMip.. of one slice in fmt.
+static size_t GetStagedMipChainSize(const DdsView& view, UINT firstMip, DXGI_FORMAT fmt)
+{
+    size_t totalSize = 0;
+    for (UINT i = firstMip; i < view.GetMipCount(); ++i)
     {
-        CloseHandle(hFile);
-        return false;
+        const DdsMipSpan& mip = view.GetMip(i);
+        if (fmt == DXGI_FORMAT_R8G8B8A8_UNORM)
+            totalSize += (size_t)mip.width * mip.height * 4;
+        else
+            totalSize += (size_t)DivUp(mip.width, 4) * DivUp(mip.height, 4) * TextureLoader::GetBytesPerBlock(fmt);
     }
+    return totalSize;
+}
 
-    BYTE* pDataPtr = (BYTE*)desc.pData;
-    width = desc.width;
-    height = desc.height;
+// Staging memory is recycled across loads; see StagingBufferPool.
+static StagingBufferPool& GetStagingPool()
+{
+    static StagingBufferPool s_pool;
+    return s_pool;
+}
 
-    for (UINT i = 0; i < desc.mipmapsCount; ++i)
-    {
-        UINT blockWidth = DivUp(width, 4u);
-        UINT blockHeight = DivUp(height, 4u);
-        UINT mipSize = blockWidth * blockHeight * GetBytesPerBlock(desc.fmt);
+// Encodes mips firstMip.. of one slice of an uncompressed view as fmt at
+// pDst. Layouts other than RGBA8 go through one scratch surface first.
+static void StageCompressedMipChain(const DdsView& view, UINT slice, UINT firstMip, DXGI_FORMAT fmt, uint8_t* pDst,
+    D3D11_SUBRESOURCE_DATA* pInitData, LoadScheduler* pScheduler)
+{
+    StagingBufferPool::Buffer scratch;
+    if (view.GetPixelLayout() != DDS_PIXELS_RGBA32)
+        scratch = GetStagingPool().Acquire((size_t)view.GetMip(firstMip).width * view.GetMip(firstMip).height * 4);
+    EncodeDdsMipChain(view, slice, firstMip, fmt, pDst, scratch.GetData(), pScheduler);
 
-        ReadFile(hFile, pDataPtr, mipSize, &dwBytesRead, NULL);
-        pDataPtr += mipSize;
+    const UINT blockBytes = TextureLoader::GetBytesPerBlock(fmt);
+    for (UINT i = firstMip; i < view.GetMipCount(); ++i)
+    {
+        const DdsMipSpan& mip = view.GetMip(slice, i);
+        const UINT rowPitch = DivUp(mip.width, 4) * blockBytes;
+        pInitData[i - firstMip].pSysMem = pDst;
+        pInitData[i - firstMip].SysMemPitch = rowPitch;
+        pInitData[i - firstMip].SysMemSlicePitch = 0;
+        pDst += (size_t)rowPitch * DivUp(mip.height, 4);
+    }
+}
 
-        width = max(1, width / 2);
-        height = max(1, height / 2);
+// Decodes, converts or encodes mips firstMip.. of one slice of view to fmt
+// at pDst and points the subresources at it.
+static void StageMipChain(const DdsView& view, UINT slice, UINT firstMip, DXGI_FORMAT fmt, uint8_t* pDst,
+    D3D11_SUBRESOURCE_DATA* pInitData, LoadScheduler* pScheduler)
+{
+    if (fmt != DXGI_FORMAT_R8G8B8A8_UNORM)
+    {
+        StageCompressedMipChain(view, slice, firstMip, fmt, pDst, pInitData, pScheduler);
+        return;
     }
 
-    CloseHandle(hFile);
-    return true;
+    const DdsPixelLayout layout = view.GetPixelLayout();
+    for (UINT i = firstMip; i < view.GetMipCount(); ++i)
+    {
+        const DdsMipSpan& mip = view.GetMip(slice, i);
+        if (layout == DDS_PIXELS_BLOCK)
+        {
+            DecodeBlockSurface(view.GetFormat(), mip.pData, mip.rowPitch, mip.width, mip.height,
+                pDst, mip.width * 4, BLOCK_DECODE_BEST, pScheduler);
+        }
+        else
+        {
+            ConvertPixelSurface(layout, mip.pData, mip.rowPitch, mip.width, mip.height,
+                pDst, mip.width * 4, BLOCK_DECODE_BEST, pScheduler);
+        }
+
+        pInitData[i - firstMip].pSysMem = pDst;
+        pInitData[i - firstMip].SysMemPitch = mip.width * 4;
+        pInitData[i - firstMip].SysMemSlicePitch = 0;
+        pDst += (size_t)mip.width * mip.height * 4;
+    }
 }
 
-ID3D11ShaderResourceView* TextureLoader::CreateTexture2D(ID3D11Device* device, const TextureDesc& desc)
+ID3D11ShaderResourceView* TextureLoader::CreateTexture2D(ID3D11Device* device, const DdsView& view, UINT firstMip,
+    LoadScheduler* pScheduler)
 {
+    if (!view.IsOpen() || firstMip >= view.GetMipCount())
+        return nullptr;
+
+    const UINT mipCount = view.GetMipCount() - firstMip;
+    const UINT arraySize = view.GetArraySize();
+    const bool cubemap = view.IsCubemap();
+
     D3D11_TEXTURE2D_DESC tex2DDesc = {};
-    tex2DDesc.Width = desc.width;
-    tex2DDesc.Height = desc.height;
-    tex2DDesc.MipLevels = desc.mipmapsCount;
-    tex2DDesc.ArraySize = 1;
-    tex2DDesc.Format = desc.fmt;
+    tex2DDesc.Width = view.GetMip(firstMip).width;
+    tex2DDesc.Height = view.GetMip(firstMip).height;
+    tex2DDesc.MipLevels = mipCount;
+    tex2DDesc.ArraySize = arraySize;
+    tex2DDesc.Format = view.GetFormat();
     tex2DDesc.SampleDesc.Count = 1;
     tex2DDesc.SampleDesc.Quality = 0;
     tex2DDesc.Usage = D3D11_USAGE_IMMUTABLE;
     tex2DDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    tex2DDesc.MiscFlags = cubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
 
-    std::vector<D3D11_SUBRESOURCE_DATA> initData(desc.mipmapsCount);
-    BYTE* pDataPtr = (BYTE*)desc.pData;
-    UINT width = desc.width;
-    UINT height = desc.height;
-
-    for (UINT i = 0; i < desc.mipmapsCount; ++i)
+    std::vector<D3D11_SUBRESOURCE_DATA> initData(arraySize * mipCount);
+    StagingBufferPool::Buffer staging;
+    const UINT requiredSupport = cubemap ? D3D11_FORMAT_SUPPORT_TEXTURECUBE : D3D11_FORMAT_SUPPORT_TEXTURE2D;
+    const DXGI_FORMAT stagedFormat = GetStagedFormat(device, view, firstMip, requiredSupport);
+    if (stagedFormat != DXGI_FORMAT_UNKNOWN)
     {
-        UINT blockWidth = DivUp(width, 4u);
-        UINT blockHeight = DivUp(height, 4u);
-        UINT pitch = blockWidth * GetBytesPerBlock(desc.fmt);
-
-        initData[i].pSysMem = pDataPtr;
-        initData[i].SysMemPitch = pitch;
-        initData[i].SysMemSlicePitch = 0;
-
-        pDataPtr += pitch * blockHeight;
-        width = max(1, width / 2);
-        height = max(1, height / 2);
+        tex2DDesc.Format = stagedFormat;
+        const size_t sliceSize = GetStagedMipChainSize(view, firstMip, stagedFormat);
+        staging = GetStagingPool().Acquire(sliceSize * arraySize);
+        for (UINT slice = 0; slice < arraySize; ++slice)
+        {
+            StageMipChain(view, slice, firstMip, stagedFormat, staging.GetData() + slice * sliceSize,
+                &initData[slice * mipCount], pScheduler);
+        }
+    }
+    else
+    {
+        // Subresources point straight into the file mapping, no staging copy.
+        for (UINT slice = 0; slice < arraySize; ++slice)
+        {
+            for (UINT i = 0; i < mipCount; ++i)
+            {
+                const DdsMipSpan& mip = view.GetMip(slice, firstMip + i);
+                initData[slice * mipCount + i].pSysMem = mip.pData;
+                initData[slice * mipCount + i].SysMemPitch = mip.rowPitch;
+                initData[slice * mipCount + i].SysMemSlicePitch = 0;
+            }
+        }
     }
 
     ID3D11Texture2D* pTexture = nullptr;
-    ID3D11ShaderResourceView* pSRV = nullptr;
-
     if (FAILED(device->CreateTexture2D(&tex2DDesc, initData.data(), &pTexture)))
         return nullptr;
 
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = desc.fmt;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = desc.mipmapsCount;
-    srvDesc.Texture2D.MostDetailedMip = 0;
+    return CreateShaderResourceView(device, pTexture, tex2DDesc.Format, mipCount, arraySize, cubemap);
+}
 
-    device->CreateShaderResourceView(pTexture, &srvDesc, &pSRV);
-    pTexture->Release();
-    return pSRV;
+ID3D11ShaderResourceView* TextureLoader::CreateCubemap(ID3D11Device* device, const std::wstring* facePaths,
+    const TextureQuality& quality)
+{
+    std::shared_ptr<ID3D11ShaderResourceView> pView = LoadCubemapShared(device, facePaths, quality);
+    if (!pView)
+        return nullptr;
+    pView->AddRef();
+    return pView.get();
 }
 
-ID3D11ShaderResourceView* TextureLoader::CreateCubemap(ID3D11Device* device, const std::wstring* facePaths)
+TextureCache<ID3D11ShaderResourceView>& TextureLoader::GetTextureCache()
 {
-    TextureDesc faceDescs[6];
-    bool allOk = true;
-    UINT mipCount = 0;
+    static TextureCache<ID3D11ShaderResourceView> s_cache;
+    return s_cache;
+}
 
-    for (int i = 0; i < 6; ++i)
+// Cache load function: one view as a 2D texture, six as a cube. bytes is
+// the texel data read from the files.
+static std::shared_ptr<ID3D11ShaderResourceView> CreateSharedView(ID3D11Device* device, const DdsView* pViews,
+    uint32_t viewCount, uint64_t& bytes, const TextureQuality& quality, LoadScheduler* pScheduler)
+{
+    const UINT firstMip = GetQualityFirstMip(pViews[0], quality);
+    ID3D11ShaderResourceView* pView = viewCount == 6 ?
+        TextureLoader::CreateCubemap(device, pViews, firstMip, pScheduler) :
+        TextureLoader::CreateTexture2D(device, pViews[0], firstMip, pScheduler);
+    if (!pView)
+        return nullptr;
+
+    bytes = 0;
+    for (uint32_t i = 0; i < viewCount; ++i)
     {
-        if (!LoadDDS(facePaths[i].c_str(), faceDescs[i]))
+        for (uint32_t slice = 0; slice < pViews[i].GetArraySize(); ++slice)
         {
-            allOk = false;
-            break;
+            for (uint32_t level = firstMip; level < pViews[i].GetMipCount(); ++level)
+                bytes += pViews[i].GetMip(slice, level).size;
         }
-        if (i == 0) mipCount = faceDescs[i].mipmapsCount;
     }
+    return std::shared_ptr<ID3D11ShaderResourceView>(pView, [](ID3D11ShaderResourceView* p) { p->Release(); });
+}
 
-    if (!allOk)
-    {
-        for (int i = 0; i < 6; ++i)
-            if (faceDescs[i].pData) free(faceDescs[i].pData);
-        return nullptr;
-    }
+std::shared_ptr<ID3D11ShaderResourceView> TextureLoader::LoadTextureShared(ID3D11Device* device,
+    const std::wstring& path, const TextureQuality& quality, LoadScheduler* pScheduler)
+{
+    return GetTextureCache().Acquire(path, (uint64_t)(uintptr_t)device,
+        [device, quality, pScheduler](const DdsView* pViews, uint32_t viewCount, uint64_t& bytes) {
+            return CreateSharedView(device, pViews, viewCount, bytes, quality, pScheduler);
+        }, quality);
+}
 
-    for (int i = 1; i < 6; ++i)
+std::shared_ptr<ID3D11ShaderResourceView> TextureLoader::LoadCubemapShared(ID3D11Device* device,
+    const std::wstring* facePaths, const TextureQuality& quality, LoadScheduler* pScheduler)
+{
+    return GetTextureCache().Acquire(facePaths, 6, (uint64_t)(uintptr_t)device,
+        [device, quality, pScheduler](const DdsView* pViews, uint32_t viewCount, uint64_t& bytes) {
+            return CreateSharedView(device, pViews, viewCount, bytes, quality, pScheduler);
+        }, quality);
+}
+
+ID3D11ShaderResourceView* TextureLoader::CreateCubemap(ID3D11Device* device, const DdsView* faces, UINT firstMip,
+    LoadScheduler* pScheduler)
+{
+    for (int i = 0; i < 6; ++i)
     {
-        if (faceDescs[i].fmt != faceDescs[0].fmt ||
-            faceDescs[i].width != faceDescs[0].width ||
-            faceDescs[i].height != faceDescs[0].height ||
-            faceDescs[i].mipmapsCount != mipCount)
-        {
-            for (int j = 0; j < 6; ++j) free(faceDescs[j].pData);
+        if (!faces[i].IsOpen() ||
+            faces[i].GetFormat() != faces[0].GetFormat() ||
+            faces[i].GetPixelLayout() != faces[0].GetPixelLayout() ||
+            faces[i].GetWidth() != faces[0].GetWidth() ||
+            faces[i].GetHeight() != faces[0].GetHeight() ||
+            faces[i].GetMipCount() != faces[0].GetMipCount())
             return nullptr;
-        }
     }
+    if (firstMip >= faces[0].GetMipCount())
+        return nullptr;
+
+    UINT mipCount = faces[0].GetMipCount() - firstMip;
 
     D3D11_TEXTURE2D_DESC cubeDesc = {};
-    cubeDesc.Width = faceDescs[0].width;
-    cubeDesc.Height = faceDescs[0].height;
+    cubeDesc.Width = faces[0].GetMip(firstMip).width;
+    cubeDesc.Height = faces[0].GetMip(firstMip).height;
     cubeDesc.MipLevels = mipCount;
     cubeDesc.ArraySize = 6;
-    cubeDesc.Format = faceDescs[0].fmt;
+    cubeDesc.Format = faces[0].GetFormat();
     cubeDesc.SampleDesc.Count = 1;
     cubeDesc.SampleDesc.Quality = 0;
     cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -211,47 +404,37 @@ ID3D11ShaderResourceView* TextureLoader::CreateCubemap(ID3D11Device* device, con
     cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
 
     std::vector<D3D11_SUBRESOURCE_DATA> cubeInitData(6 * mipCount);
+    StagingBufferPool::Buffer staging;
+    const DXGI_FORMAT stagedFormat = GetStagedFormat(device, faces[0], firstMip, D3D11_FORMAT_SUPPORT_TEXTURECUBE);
+    const bool staged = stagedFormat != DXGI_FORMAT_UNKNOWN;
+    const size_t faceSize = staged ? GetStagedMipChainSize(faces[0], firstMip, stagedFormat) : 0;
+    if (staged)
+    {
+        cubeDesc.Format = stagedFormat;
+        staging = GetStagingPool().Acquire(faceSize * 6);
+    }
 
     for (int face = 0; face < 6; ++face)
     {
-        BYTE* pFaceData = (BYTE*)faceDescs[face].pData;
-        UINT faceWidth = faceDescs[face].width;
-        UINT faceHeight = faceDescs[face].height;
+        if (staged)
+        {
+            StageMipChain(faces[face], 0, firstMip, stagedFormat, staging.GetData() + face * faceSize,
+                &cubeInitData[face * mipCount], pScheduler);
+            continue;
+        }
 
         for (UINT mip = 0; mip < mipCount; ++mip)
         {
-            UINT blockWidth = DivUp(faceWidth, 4u);
-            UINT blockHeight = DivUp(faceHeight, 4u);
-            UINT pitch = blockWidth * GetBytesPerBlock(cubeDesc.Format);
-
-            cubeInitData[face * mipCount + mip].pSysMem = pFaceData;
-            cubeInitData[face * mipCount + mip].SysMemPitch = pitch;
+            const DdsMipSpan& span = faces[face].GetMip(firstMip + mip);
+            cubeInitData[face * mipCount + mip].pSysMem = span.pData;
+            cubeInitData[face * mipCount + mip].SysMemPitch = span.rowPitch;
             cubeInitData[face * mipCount + mip].SysMemSlicePitch = 0;
-
-            pFaceData += pitch * blockHeight;
-            faceWidth = max(1, faceWidth / 2);
-            faceHeight = max(1, faceHeight / 2);
         }
     }
 
     ID3D11Texture2D* pCubemapTex = nullptr;
-    ID3D11ShaderResourceView* pSRV = nullptr;
-
     if (FAILED(device->CreateTexture2D(&cubeDesc, cubeInitData.data(), &pCubemapTex)))
-    {
-        for (int i = 0; i < 6; ++i) free(faceDescs[i].pData);
         return nullptr;
-    }
 
-    D3D11_SHADER_RESOURCE_VIEW_DESC cubeSRVDesc = {};
-    cubeSRVDesc.Format = cubeDesc.Format;
-    cubeSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-    cubeSRVDesc.TextureCube.MipLevels = mipCount;
-    cubeSRVDesc.TextureCube.MostDetailedMip = 0;
-
-    device->CreateShaderResourceView(pCubemapTex, &cubeSRVDesc, &pSRV);
-    pCubemapTex->Release();
-
-    for (int i = 0; i < 6; ++i) free(faceDescs[i].pData);
-    return pSRV;
-}
\ No newline at end of file
+    return CreateShaderResourceView(device, pCubemapTex, cubeDesc.Format, mipCount, 6, true);
+}
@@ -1,49 +1,9 @@
 #pragma once
 #include "Common.h"
-
-#ifndef MAKEFOURCC
-#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
-    ((DWORD)(BYTE)(ch0) | ((DWORD)(BYTE)(ch1) << 8) | \
-     ((DWORD)(BYTE)(ch2) << 16) | ((DWORD)(BYTE)(ch3) << 24))
-#endif
-
-struct DDS_PIXELFORMAT
-{
-    DWORD dwSize;
-    DWORD dwFlags;
-    DWORD dwFourCC;
-    DWORD dwRGBBitCount;
-    DWORD dwRBitMask;
-    DWORD dwGBitMask;
-    DWORD dwBBitMask;
-    DWORD dwABitMask;
-};
-
-struct DDS_HEADER
-{
-    DWORD dwSize;
-    DWORD dwHeaderFlags;
-    DWORD dwHeight;
-    DWORD dwWidth;
-    DWORD dwPitchOrLinearSize;
-    DWORD dwDepth;
-    DWORD dwMipMapCount;
-    DWORD dwReserved1[11];
-    DDS_PIXELFORMAT ddspf;
-    DWORD dwSurfaceFlags;
-    DWORD dwCubemapFlags;
-    DWORD dwReserved2[3];
-};
-
-#define DDS_MAGIC 0x20534444
-#define DDS_HEADER_FLAGS_TEXTURE 0x00001007
-#define DDS_SURFACE_FLAGS_MIPMAP 0x00400000
-#define DDS_FOURCC 0x00000004
-#define DDS_RGB 0x00000040
-
-#define FOURCC_DXT1 MAKEFOURCC('D','X','T','1')
-#define FOURCC_DXT3 MAKEFOURCC('D','X','T','3')
-#define FOURCC_DXT5 MAKEFOURCC('D','X','T','5')
+#include "DdsFormat.h"
+#include "DdsView.h"
+#include "LoadScheduler.h"
+#include "TextureCache.h"
 
 struct TextureDesc
 {
@@ -52,6 +12,8 @@ struct TextureDesc
     DXGI_FORMAT fmt = DXGI_FORMAT_UNKNOWN;
     UINT32 width = 0;
     UINT32 height = 0;
+    UINT32 arraySize = 1;       // slices, six per cube
+    bool cubemap = false;
     void* pData = nullptr;
 };
 
@@ -59,7 +21,44 @@ class TextureLoader
 {
 public:
     static UINT GetBytesPerBlock(DXGI_FORMAT fmt);
-    static bool LoadDDS(const wchar_t* filename, TextureDesc& desc);
+    // Copies every slice of a 2D, array or cube map file into desc.pData,
+    // which the caller frees. Below full quality the dropped top levels are
+    // skipped without being read and desc describes the smaller texture.
+    static bool LoadDDS(const wchar_t* filename, TextureDesc& desc,
+        const TextureQuality& quality = TextureQuality());
+    // prefetch = false only maps the file; pages are read on first access.
+    static std::future<DdsView> LoadDDSAsync(LoadScheduler& scheduler, const std::wstring& filename,
+        bool prefetch = true);
     static ID3D11ShaderResourceView* CreateTexture2D(ID3D11Device* device, const TextureDesc& desc);
-    static ID3D11ShaderResourceView* CreateCubemap(ID3D11Device* device, const std::wstring* facePaths);
+    // Arrays and cube maps in one file come out as a 2D array or cube view.
+    // firstMip > 0 leaves out the largest levels: the texture starts at
+    // that mip's size and holds the rest of the chain.
+    // BC textures the device can't sample and uncompressed files other than
+    // RGBA8 are staged as RGBA8 on the CPU, on pScheduler's workers if given,
+    // as are encodes under SetCompressOnLoad().
+    static ID3D11ShaderResourceView* CreateTexture2D(ID3D11Device* device, const DdsView& view, UINT firstMip = 0,
+        LoadScheduler* pScheduler = nullptr);
+    // Goes through LoadCubemapShared(); the caller releases its reference.
+    static ID3D11ShaderResourceView* CreateCubemap(ID3D11Device* device, const std::wstring* facePaths,
+        const TextureQuality& quality = TextureQuality());
+    // A file, or six face files as one cube, loaded once per device and
+    // quality: later calls with an unchanged path or the same bytes under
+    // another path get the same view. Dropped levels are neither read nor
+    // uploaded. Release every handle before the device.
+    static std::shared_ptr<ID3D11ShaderResourceView> LoadTextureShared(ID3D11Device* device,
+        const std::wstring& path, const TextureQuality& quality = TextureQuality(),
+        LoadScheduler* pScheduler = nullptr);
+    static std::shared_ptr<ID3D11ShaderResourceView> LoadCubemapShared(ID3D11Device* device,
+        const std::wstring* facePaths, const TextureQuality& quality = TextureQuality(),
+        LoadScheduler* pScheduler = nullptr);
+    // The process-wide cache behind the shared loads, for stats and Trim().
+    static TextureCache<ID3D11ShaderResourceView>& GetTextureCache();
+    // When on, uncompressed files whose top level is whole 4x4 blocks are
+    // encoded to BC3 (with alpha) or BC1 on the CPU before upload. Off by
+    // default; set it before any loads start.
+    static void SetCompressOnLoad(bool enable);
+    // Six single-surface face files; see CreateTexture2D() for a cube map
+    // stored in one file.
+    static ID3D11ShaderResourceView* CreateCubemap(ID3D11Device* device, const DdsView* faces, UINT firstMip = 0,
+        LoadScheduler* pScheduler = nullptr);
 };
\ No newline at end of file
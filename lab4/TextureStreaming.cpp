@@ -0,0 +1,229 @@
+#include "TextureStreaming.h"
+#include <algorithm>
+#include <cmath>
+
+StreamingTextureDesc MakeStreamingDesc(const char* name, const DdsView* pViews, uint32_t viewCount)
+{
+    StreamingTextureDesc desc;
+    desc.name = name;
+    if (viewCount == 0 || !pViews[0].IsOpen())
+        return desc;
+
+    desc.width = pViews[0].GetWidth();
+    desc.height = pViews[0].GetHeight();
+    desc.mipBytes.assign(pViews[0].GetMipCount(), 0);
+    for (uint32_t v = 0; v < viewCount; ++v)
+    {
+        for (uint32_t slice = 0; slice < pViews[v].GetArraySize(); ++slice)
+        {
+            for (uint32_t mip = 0; mip < desc.mipBytes.size() && mip < pViews[v].GetMipCount(); ++mip)
+                desc.mipBytes[mip] += pViews[v].GetMip(slice, mip).size;
+        }
+    }
+    return desc;
+}
+
+float ComputeRequiredMip(float texelsPerUnit, float distance, float fovY, uint32_t viewportHeight)
+{
+    // One world unit at distance covers this many pixels vertically.
+    float pixelsPerUnit = (float)viewportHeight / (2.0f * distance * std::tan(fovY * 0.5f));
+    if (!(pixelsPerUnit > 0.0f))
+        return 0.0f;
+    return std::max(0.0f, std::log2(texelsPerUnit / pixelsPerUnit));
+}
+
+float ComputeRequiredMip(const SceneTransforms& objects, const float eye[3], float texelsPerUnit,
+    float boundingRadius, float fovY, uint32_t viewportHeight)
+{
+    // The object that needs the finest mip has the smallest distance per
+    // unit of scale; only that ratio has to be found.
+    const float minDistance = 0.01f;
+    float bestRatio = -1.0f;
+    for (size_t i = 0; i < objects.Size(); ++i)
+    {
+        float dx = objects.posX[i] - eye[0];
+        float dy = objects.posY[i] - eye[1];
+        float dz = objects.posZ[i] - eye[2];
+        float scale = std::max(objects.scaleX[i], std::max(objects.scaleY[i], objects.scaleZ[i]));
+        if (!(scale > 0.0f))
+            continue;
+
+        float distance = std::max(minDistance, std::sqrt(dx * dx + dy * dy + dz * dz) - boundingRadius * scale);
+        float ratio = distance * scale;
+        if (bestRatio < 0.0f || ratio < bestRatio)
+            bestRatio = ratio;
+    }
+
+    if (bestRatio < 0.0f)
+        return 0.0f;
+    return ComputeRequiredMip(texelsPerUnit, bestRatio, fovY, viewportHeight);
+}
+
+TextureStreamingPlanner::TextureStreamingPlanner()
+    : m_budget(0)
+{
+}
+
+uint32_t TextureStreamingPlanner::AddTexture(const StreamingTextureDesc& desc)
+{
+    Texture texture;
+    texture.desc = desc;
+    texture.required = 0.0f;
+    texture.loading = false;
+
+    // Tail: the first level that fits in TAIL_SIZE, or the last level.
+    uint32_t mipCount = (uint32_t)desc.mipBytes.size();
+    texture.tail = mipCount ? mipCount - 1 : 0;
+    for (uint32_t mip = 0; mip < mipCount; ++mip)
+    {
+        if (std::max(desc.width >> mip, desc.height >> mip) <= TAIL_SIZE)
+        {
+            texture.tail = mip;
+            break;
+        }
+    }
+    texture.target = texture.tail;
+    texture.resident = texture.tail;
+
+    m_textures.push_back(texture);
+    m_stats.residentBytes += GetTextureBytes((uint32_t)m_textures.size() - 1, texture.tail);
+    return (uint32_t)m_textures.size() - 1;
+}
+
+void TextureStreamingPlanner::SetRequiredMip(uint32_t texture, float mip)
+{
+    m_textures[texture].required = std::max(0.0f, mip);
+}
+
+uint64_t TextureStreamingPlanner::GetTextureBytes(uint32_t texture, uint32_t firstMip) const
+{
+    const std::vector<uint64_t>& mipBytes = m_textures[texture].desc.mipBytes;
+    uint64_t bytes = 0;
+    for (size_t mip = firstMip; mip < mipBytes.size(); ++mip)
+        bytes += mipBytes[mip];
+    return bytes;
+}
+
+void TextureStreamingPlanner::PlanTargets()
+{
+    uint64_t used = 0;
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        m_textures[i].target = m_textures[i].tail;
+        used += GetTextureBytes(i, m_textures[i].tail);
+    }
+
+    // Greedy: keep giving a level to the texture whose target is furthest
+    // above what it needs, while that level still fits.
+    std::vector<bool> blocked(m_textures.size(), false);
+    for (;;)
+    {
+        int best = -1;
+        float bestGap = 0.0f;
+        for (uint32_t i = 0; i < m_textures.size(); ++i)
+        {
+            const Texture& texture = m_textures[i];
+            uint32_t wanted = std::min(texture.tail, (uint32_t)texture.required);
+            if (blocked[i] || texture.target <= wanted)
+                continue;
+
+            float gap = (float)texture.target - texture.required;
+            if (best < 0 || gap > bestGap)
+            {
+                best = (int)i;
+                bestGap = gap;
+            }
+        }
+        if (best < 0)
+            break;
+
+        Texture& texture = m_textures[best];
+        uint64_t cost = texture.desc.mipBytes[texture.target - 1];
+        if (m_budget && used + cost > m_budget)
+        {
+            // Larger levels only cost more, so this texture is done.
+            blocked[best] = true;
+            continue;
+        }
+        --texture.target;
+        used += cost;
+    }
+}
+
+void TextureStreamingPlanner::Evict(Texture& texture, uint32_t mip)
+{
+    uint64_t bytes = 0;
+    for (uint32_t level = texture.resident; level < mip; ++level)
+        bytes += texture.desc.mipBytes[level];
+
+    texture.resident = mip;
+    m_stats.residentBytes -= bytes;
+    m_stats.evictedBytes += bytes;
+    ++m_stats.evictions;
+}
+
+void TextureStreamingPlanner::Update(std::vector<StreamingRequest>& requests)
+{
+    PlanTargets();
+
+    // Levels the texture no longer needs, beyond the slack.
+    for (Texture& texture : m_textures)
+    {
+        if (texture.resident + EVICT_SLACK < texture.target)
+            Evict(texture, texture.target);
+    }
+
+    // Over budget (it shrank, or the slack adds up): drop the largest
+    // unneeded levels first.
+    while (m_budget && m_stats.residentBytes > m_budget)
+    {
+        Texture* pVictim = nullptr;
+        for (Texture& texture : m_textures)
+        {
+            if (texture.resident < texture.target &&
+                (!pVictim || texture.desc.mipBytes[texture.resident] > pVictim->desc.mipBytes[pVictim->resident]))
+                pVictim = &texture;
+        }
+        if (!pVictim)
+            break;
+        Evict(*pVictim, pVictim->resident + 1);
+    }
+
+    // Next level for every texture still short of its target.
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        Texture& texture = m_textures[i];
+        if (texture.loading || texture.resident <= texture.target)
+            continue;
+
+        uint32_t mip = texture.resident - 1;
+        uint64_t cost = texture.desc.mipBytes[mip];
+        if (m_budget && m_stats.residentBytes + m_stats.pendingBytes + cost > m_budget)
+            continue;
+
+        texture.loading = true;
+        m_stats.pendingBytes += cost;
+        StreamingRequest request = { i, mip };
+        requests.push_back(request);
+    }
+}
+
+void TextureStreamingPlanner::CompleteLoad(uint32_t index, uint32_t mip)
+{
+    Texture& texture = m_textures[index];
+    if (!texture.loading)
+        return;
+
+    const uint64_t bytes = texture.desc.mipBytes[mip];
+    texture.loading = false;
+    m_stats.pendingBytes -= bytes;
+
+    // Stale if the texture was trimmed or re-targeted meanwhile.
+    if (mip + 1 != texture.resident || mip < texture.target)
+        return;
+
+    texture.resident = mip;
+    m_stats.residentBytes += bytes;
+    m_stats.loadedBytes += bytes;
+    ++m_stats.loads;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "DdsView.h"
+#include "SceneTransforms.h"
+#include <string>
+
+// Size of one streamed texture: bytes of every mip level, summed over its
+// slices (six for a cube map).
+struct StreamingTextureDesc
+{
+    std::string name;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint64_t> mipBytes;
+};
+
+// Builds the desc from the mip spans of viewCount views of the same size,
+// counting every slice of each.
+StreamingTextureDesc MakeStreamingDesc(const char* name, const DdsView* pViews, uint32_t viewCount);
+
+// Mip needed to draw a surface with texelsPerUnit texels per world unit at
+// distance, with a vertical field of view fovY over viewportHeight pixels:
+// log2 of texels per pixel, never below 0. For a skybox face use
+// texelsPerUnit = faceSize / 2 and distance 1.
+float ComputeRequiredMip(float texelsPerUnit, float distance, float fovY, uint32_t viewportHeight);
+
+// Finest mip any object in objects needs, for a mesh whose surface has
+// texelsPerUnit at scale 1 and fits in a sphere of boundingRadius. Uses the
+// nearest point of every bounding sphere, so it errs on the sharp side.
+float ComputeRequiredMip(const SceneTransforms& objects, const float eye[3], float texelsPerUnit,
+    float boundingRadius, float fovY, uint32_t viewportHeight);
+
+struct StreamingRequest
+{
+    uint32_t texture;
+    uint32_t mip;       // the level to read; resident becomes mip once it completes
+};
+
+struct StreamingStats
+{
+    uint64_t residentBytes = 0;
+    uint64_t pendingBytes = 0;      // requested, not completed yet
+    uint64_t loadedBytes = 0;       // total over all completed loads
+    uint64_t evictedBytes = 0;
+    uint32_t loads = 0;
+    uint32_t evictions = 0;
+};
+
+// Decides which mips of each texture should be resident. Every texture
+// always keeps its tail (levels of TAIL_SIZE texels and below), which is all
+// it has right after AddTexture(). From there it refines one level at a
+// time toward the mip its on-screen size needs; when the budget cannot fit
+// every target, the blurriest texture relative to its need gets the next
+// level first. Levels a texture no longer needs are evicted once it holds
+// more than EVICT_SLACK of them, so a camera wobbling around a mip boundary
+// does not thrash; over budget they go right away, largest first.
+//
+// The planner only does the bookkeeping. The caller performs each
+// StreamingRequest (in any order, taking any time) and reports it with
+// CompleteLoad(), and rebuilds its texture whenever GetResidentMip()
+// changes.
+class TextureStreamingPlanner
+{
+public:
+    static const uint32_t TAIL_SIZE = 64;
+    static const uint32_t EVICT_SLACK = 1;
+
+    TextureStreamingPlanner();
+
+    // 0 means no budget: every texture streams to the mip it needs.
+    void SetBudget(uint64_t bytes) { m_budget = bytes; }
+    uint64_t GetBudget() const { return m_budget; }
+
+    // Returns the texture id. Only the tail is resident afterwards.
+    uint32_t AddTexture(const StreamingTextureDesc& desc);
+
+    void SetRequiredMip(uint32_t texture, float mip);
+
+    // Re-plans targets, evicts and appends new loads to requests.
+    void Update(std::vector<StreamingRequest>& requests);
+
+    void CompleteLoad(uint32_t texture, uint32_t mip);
+
+    uint32_t GetTextureCount() const { return (uint32_t)m_textures.size(); }
+    const StreamingTextureDesc& GetDesc(uint32_t texture) const { return m_textures[texture].desc; }
+    float GetRequiredMip(uint32_t texture) const { return m_textures[texture].required; }
+    uint32_t GetTargetMip(uint32_t texture) const { return m_textures[texture].target; }
+    uint32_t GetResidentMip(uint32_t texture) const { return m_textures[texture].resident; }
+    uint32_t GetTailMip(uint32_t texture) const { return m_textures[texture].tail; }
+    bool IsLoading(uint32_t texture) const { return m_textures[texture].loading; }
+
+    uint64_t GetTextureBytes(uint32_t texture, uint32_t firstMip) const;
+    const StreamingStats& GetStats() const { return m_stats; }
+
+private:
+    struct Texture
+    {
+        StreamingTextureDesc desc;
+        float required;
+        uint32_t tail;
+        uint32_t target;
+        uint32_t resident;
+        bool loading;
+    };
+
+    void PlanTargets();
+    void Evict(Texture& texture, uint32_t mip);
+
+    std::vector<Texture> m_textures;
+    uint64_t m_budget;
+    StreamingStats m_stats;
+};
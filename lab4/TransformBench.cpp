@@ -0,0 +1,180 @@
+#include "TransformBench.h"
+#include "BenchUtil.h"
+#include "SceneTransforms.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    struct ObjectAoS
+    {
+        float position[3];
+        float rotation[4];
+        float scale[3];
+        float tint[4];
+    };
+
+    struct Matrix4
+    {
+        float m[4][4];
+    };
+
+    Matrix4 Multiply(const Matrix4& a, const Matrix4& b)
+    {
+        Matrix4 r;
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] +
+                    a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+        return r;
+    }
+
+    // Scaling * RotationQuaternion * Translation, then transpose into the
+    // instance record, one object at a time.
+    void ComputeAoS(const ObjectAoS* pObjects, size_t count, InstanceData* pOut)
+    {
+        for (size_t n = 0; n < count; ++n)
+        {
+            const ObjectAoS& o = pObjects[n];
+            float qx = o.rotation[0], qy = o.rotation[1], qz = o.rotation[2], qw = o.rotation[3];
+
+            Matrix4 scale = { {
+                { o.scale[0], 0.0f, 0.0f, 0.0f },
+                { 0.0f, o.scale[1], 0.0f, 0.0f },
+                { 0.0f, 0.0f, o.scale[2], 0.0f },
+                { 0.0f, 0.0f, 0.0f, 1.0f } } };
+            Matrix4 rotation = { {
+                { 1.0f - 2.0f * (qy * qy + qz * qz), 2.0f * (qx * qy + qz * qw), 2.0f * (qx * qz - qy * qw), 0.0f },
+                { 2.0f * (qx * qy - qz * qw), 1.0f - 2.0f * (qx * qx + qz * qz), 2.0f * (qy * qz + qx * qw), 0.0f },
+                { 2.0f * (qx * qz + qy * qw), 2.0f * (qy * qz - qx * qw), 1.0f - 2.0f * (qx * qx + qy * qy), 0.0f },
+                { 0.0f, 0.0f, 0.0f, 1.0f } } };
+            Matrix4 translation = { {
+                { 1.0f, 0.0f, 0.0f, 0.0f },
+                { 0.0f, 1.0f, 0.0f, 0.0f },
+                { 0.0f, 0.0f, 1.0f, 0.0f },
+                { o.position[0], o.position[1], o.position[2], 1.0f } } };
+
+            Matrix4 world = Multiply(Multiply(scale, rotation), translation);
+            for (int row = 0; row < 3; ++row)
+                for (int col = 0; col < 4; ++col)
+                    pOut[n].world[row][col] = world.m[col][row];
+            memcpy(pOut[n].tint, o.tint, sizeof(o.tint));
+        }
+    }
+
+    void BuildScene(SceneTransforms& scene, std::vector<ObjectAoS>& objects, std::vector<uint32_t>& order, uint32_t count)
+    {
+        scene.Resize(count);
+        objects.resize(count);
+        order.resize(count);
+
+        uint32_t state = 12345;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float angle = (float)i * 0.37f;
+            float axisX = std::sin(angle), axisY = std::cos(angle * 0.5f), axisZ = std::sin(angle * 0.25f);
+            float length = std::sqrt(axisX * axisX + axisY * axisY + axisZ * axisZ);
+            float s = std::sin(angle * 0.5f) / length;
+
+            scene.SetPosition(i, (float)(i % 100), (float)((i / 100) % 100), (float)(i / 10000));
+            scene.SetRotation(i, axisX * s, axisY * s, axisZ * s, std::cos(angle * 0.5f));
+            scene.SetScale(i, 0.5f, 0.75f, 1.0f);
+            scene.SetTint(i, 1.0f, 0.5f, 0.25f, 0.8f);
+
+            ObjectAoS& o = objects[i];
+            o.position[0] = scene.posX[i]; o.position[1] = scene.posY[i]; o.position[2] = scene.posZ[i];
+            o.rotation[0] = scene.rotX[i]; o.rotation[1] = scene.rotY[i];
+            o.rotation[2] = scene.rotZ[i]; o.rotation[3] = scene.rotW[i];
+            o.scale[0] = scene.scaleX[i]; o.scale[1] = scene.scaleY[i]; o.scale[2] = scene.scaleZ[i];
+            o.tint[0] = scene.tintR[i]; o.tint[1] = scene.tintG[i];
+            o.tint[2] = scene.tintB[i]; o.tint[3] = scene.tintA[i];
+
+            order[i] = i;
+        }
+
+        // Fisher-Yates shuffle for the ordered (gather) path
+        for (uint32_t i = count; i > 1; --i)
+        {
+            state = state * 1664525u + 1013904223u;
+            uint32_t j = state % i;
+            uint32_t t = order[i - 1];
+            order[i - 1] = order[j];
+            order[j] = t;
+        }
+    }
+
+    double TimeKernel(const SceneTransforms& scene, TransformKernel kernel, uint32_t iterations, InstanceData* pOut)
+    {
+        if (!IsTransformKernelSupported(kernel))
+            return 0.0;
+
+        ComputeInstanceData(scene, 0, scene.Size(), pOut, kernel);
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+            ComputeInstanceData(scene, 0, scene.Size(), pOut, kernel);
+        return ElapsedNs(start, BenchClock::now()) / ((double)iterations * scene.Size());
+    }
+}
+
+void RunTransformBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t iterations,
+    std::vector<TransformBenchResult>& results)
+{
+    SceneTransforms scene;
+    std::vector<ObjectAoS> objects;
+    std::vector<uint32_t> order;
+    std::vector<InstanceData> output;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    for (uint32_t s = 0; s < sizeCount; ++s)
+    {
+        uint32_t count = pSizes[s];
+        if (count == 0)
+            continue;
+
+        BuildScene(scene, objects, order, count);
+        output.resize(count);
+
+        TransformBenchResult result;
+        result.objectCount = count;
+        double perObject = 1.0 / ((double)iterations * count);
+
+        ComputeAoS(objects.data(), count, output.data());
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+            ComputeAoS(objects.data(), count, output.data());
+        result.aosNs = ElapsedNs(start, BenchClock::now()) * perObject;
+
+        result.scalarNs = TimeKernel(scene, TRANSFORM_KERNEL_SCALAR, iterations, output.data());
+        result.sseNs = TimeKernel(scene, TRANSFORM_KERNEL_SSE, iterations, output.data());
+        result.avx2Ns = TimeKernel(scene, TRANSFORM_KERNEL_AVX2, iterations, output.data());
+
+        ComputeInstanceDataOrdered(scene, order.data(), count, output.data());
+        start = BenchClock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+            ComputeInstanceDataOrdered(scene, order.data(), count, output.data());
+        result.orderedNs = ElapsedNs(start, BenchClock::now()) * perObject;
+
+        results.push_back(result);
+    }
+}
+
+bool WriteTransformBenchmarkCsv(const char* filename, const std::vector<TransformBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,aos_ns,scalar_ns,sse_ns,avx2_ns,ordered_ns,best_kernel\n");
+    for (const TransformBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%.3f,%.3f,%.3f,%.3f,%.3f,%s\n",
+            r.objectCount, r.aosNs, r.scalarNs, r.sseNs, r.avx2Ns, r.orderedNs,
+            GetTransformKernelName(ResolveTransformKernel(TRANSFORM_KERNEL_BEST)));
+    }
+
+    fclose(pFile);
+    return true;
+}
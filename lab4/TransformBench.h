@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Cost of turning N object transforms into InstanceData, in nanoseconds per
+// object. "aos" is the old path: one object struct at a time, full 4x4
+// scale * rotation * translation products and a transpose, as lab5 did with
+// XMMATRIX. The SoA kernels are ComputeInstanceData; a kernel the CPU lacks
+// reports 0.
+struct TransformBenchResult
+{
+    uint32_t objectCount = 0;
+    double aosNs = 0.0;
+    double scalarNs = 0.0;
+    double sseNs = 0.0;
+    double avx2Ns = 0.0;
+    double orderedNs = 0.0;     // best kernel, shuffled output order
+};
+
+void RunTransformBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t iterations,
+    std::vector<TransformBenchResult>& results);
+
+bool WriteTransformBenchmarkCsv(const char* filename, const std::vector<TransformBenchResult>& results);
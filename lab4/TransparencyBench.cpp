@@ -0,0 +1,139 @@
+#include "TransparencyBench.h"
+#include "BenchUtil.h"
+#include "TransparencySort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    struct TransparentRenderItem
+    {
+        uint32_t index;
+        float distance;
+    };
+
+    // Objects scattered through a 200-unit cube around the origin.
+    void BuildScene(SceneTransforms& scene, uint32_t count)
+    {
+        scene.Resize(count);
+        uint32_t state = 12345;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float p[3];
+            for (float& v : p)
+            {
+                state = state * 1664525u + 1013904223u;
+                v = (float)(state >> 8) * (200.0f / 16777216.0f) - 100.0f;
+            }
+            scene.SetPosition(i, p[0], p[1], p[2]);
+        }
+    }
+
+    // Camera path shared by every variant: a slow drift along x.
+    float EyeX(uint32_t frame)
+    {
+        return 5.0f + (float)frame * 0.002f;
+    }
+
+    void SortStd(const SceneTransforms& scene, float eyeX, std::vector<TransparentRenderItem>& items)
+    {
+        items.resize(scene.Size());
+        for (size_t i = 0; i < items.size(); ++i)
+            items[i].index = (uint32_t)i;
+
+        for (auto& item : items)
+        {
+            float dx = scene.posX[item.index] - eyeX;
+            float dy = scene.posY[item.index] - 2.0f;
+            float dz = scene.posZ[item.index] + 10.0f;
+            item.distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+
+        std::sort(items.begin(), items.end(),
+            [](const TransparentRenderItem& a, const TransparentRenderItem& b) {
+                return a.distance > b.distance;
+            });
+    }
+
+    double TimeSorter(const SceneTransforms& scene, TransparencySorter& sorter, bool coherent,
+        uint32_t iterations, uint32_t* pRadixFrames)
+    {
+        sorter.Reset();
+        sorter.Sort(scene, EyeX(0), 2.0f, -10.0f);
+
+        uint32_t radixFrames = 0;
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t it = 1; it <= iterations; ++it)
+        {
+            if (!coherent)
+                sorter.Reset();
+            sorter.Sort(scene, EyeX(it), 2.0f, -10.0f);
+            if (sorter.GetLastStats().path == TRANSPARENCY_SORT_RADIX)
+                ++radixFrames;
+        }
+        double ns = ElapsedNs(start, BenchClock::now());
+
+        if (pRadixFrames)
+            *pRadixFrames = radixFrames;
+        return ns / ((double)iterations * scene.Size());
+    }
+}
+
+void RunTransparencyBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t iterations,
+    std::vector<TransparencyBenchResult>& results)
+{
+    SceneTransforms scene;
+    std::vector<TransparentRenderItem> items;
+    TransparencySorter sorter;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    for (uint32_t s = 0; s < sizeCount; ++s)
+    {
+        uint32_t count = pSizes[s];
+        if (count == 0)
+            continue;
+
+        BuildScene(scene, count);
+
+        TransparencyBenchResult result;
+        result.objectCount = count;
+        result.frames = iterations;
+
+        SortStd(scene, EyeX(0), items);
+        BenchClock::time_point start = BenchClock::now();
+        for (uint32_t it = 1; it <= iterations; ++it)
+            SortStd(scene, EyeX(it), items);
+        result.stdSortNs = ElapsedNs(start, BenchClock::now()) / ((double)iterations * count);
+
+        sorter.SetKeyBits(TRANSPARENCY_KEY_32);
+        result.radix32Ns = TimeSorter(scene, sorter, false, iterations, nullptr);
+        result.coherentNs = TimeSorter(scene, sorter, true, iterations, &result.coherentRadixFrames);
+
+        sorter.SetKeyBits(TRANSPARENCY_KEY_16);
+        result.radix16Ns = TimeSorter(scene, sorter, false, iterations, nullptr);
+
+        results.push_back(result);
+    }
+}
+
+bool WriteTransparencyBenchmarkCsv(const char* filename, const std::vector<TransparencyBenchResult>& results)
+{
+    FILE* pFile = OpenBenchCsv(filename);
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "objects,stdsort_ns,radix32_ns,radix16_ns,coherent_ns,coherent_radix_frames,frames,kernel\n");
+    for (const TransparencyBenchResult& r : results)
+    {
+        fprintf(pFile, "%u,%.3f,%.3f,%.3f,%.3f,%u,%u,%s\n",
+            r.objectCount, r.stdSortNs, r.radix32Ns, r.radix16Ns, r.coherentNs,
+            r.coherentRadixFrames, r.frames,
+            GetTransformKernelName(ResolveTransformKernel(TRANSFORM_KERNEL_BEST)));
+    }
+
+    fclose(pFile);
+    return true;
+}
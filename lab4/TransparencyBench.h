@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Cost of ordering N transparent objects back to front, in nanoseconds per
+// object. "stdsort" is the old lab5 path: an {index, distance} item per
+// object, sqrt distance and std::sort. The radix columns start every frame
+// from scratch; "coherent" keeps the sorter's previous order while the eye
+// drifts a little each frame, as it does in the running app.
+struct TransparencyBenchResult
+{
+    uint32_t objectCount = 0;
+    double stdSortNs = 0.0;
+    double radix32Ns = 0.0;
+    double radix16Ns = 0.0;
+    double coherentNs = 0.0;
+    uint32_t coherentRadixFrames = 0;   // coherent frames that still fell back to radix
+    uint32_t frames = 0;
+};
+
+void RunTransparencyBenchmark(const uint32_t* pSizes, uint32_t sizeCount, uint32_t iterations,
+    std::vector<TransparencyBenchResult>& results);
+
+bool WriteTransparencyBenchmarkCsv(const char* filename, const std::vector<TransparencyBenchResult>& results);
@@ -0,0 +1,332 @@
+#include "TransparencySort.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRANSPARENCY_SSE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TRANSPARENCY_AVX2 1
+#define TRANSPARENCY_TARGET_AVX2
+#elif defined(__GNUC__)
+#define TRANSPARENCY_AVX2 1
+#define TRANSPARENCY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Key jobs take at least this many objects, and there are at most
+// MAX_KEY_CHUNKS of them.
+static const uint32_t KEY_GRAIN = 16384;
+static const uint32_t MAX_KEY_CHUNKS = 64;
+
+// Squared distances for objects [first, end), plus the running min/max.
+static void DistanceScalar(const SceneTransforms& s, size_t first, size_t end,
+    const float eye[3], float* pOut, float& minValue, float& maxValue)
+{
+    for (size_t i = first; i < end; ++i)
+    {
+        float dx = s.posX[i] - eye[0];
+        float dy = s.posY[i] - eye[1];
+        float dz = s.posZ[i] - eye[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        pOut[i] = d;
+        if (d < minValue) minValue = d;
+        if (d > maxValue) maxValue = d;
+    }
+}
+
+#ifdef TRANSPARENCY_SSE
+static size_t DistanceSse(const SceneTransforms& s, size_t first, size_t end, const float eye[3],
+    float* pOut, float& minValue, float& maxValue)
+{
+    const __m128 ex = _mm_set1_ps(eye[0]);
+    const __m128 ey = _mm_set1_ps(eye[1]);
+    const __m128 ez = _mm_set1_ps(eye[2]);
+    __m128 vmin = _mm_set1_ps(minValue);
+    __m128 vmax = _mm_set1_ps(maxValue);
+
+    size_t i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&s.posX[i]), ex);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&s.posY[i]), ey);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&s.posZ[i]), ez);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        _mm_storeu_ps(pOut + i, d);
+        vmin = _mm_min_ps(vmin, d);
+        vmax = _mm_max_ps(vmax, d);
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, vmin);
+    for (float v : lanes) if (v < minValue) minValue = v;
+    _mm_storeu_ps(lanes, vmax);
+    for (float v : lanes) if (v > maxValue) maxValue = v;
+    return i;
+}
+#endif
+
+#ifdef TRANSPARENCY_AVX2
+TRANSPARENCY_TARGET_AVX2
+static size_t DistanceAvx2(const SceneTransforms& s, size_t first, size_t end, const float eye[3],
+    float* pOut, float& minValue, float& maxValue)
+{
+    const __m256 ex = _mm256_set1_ps(eye[0]);
+    const __m256 ey = _mm256_set1_ps(eye[1]);
+    const __m256 ez = _mm256_set1_ps(eye[2]);
+    __m256 vmin = _mm256_set1_ps(minValue);
+    __m256 vmax = _mm256_set1_ps(maxValue);
+
+    size_t i = first;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&s.posX[i]), ex);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&s.posY[i]), ey);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&s.posZ[i]), ez);
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        _mm256_storeu_ps(pOut + i, d);
+        vmin = _mm256_min_ps(vmin, d);
+        vmax = _mm256_max_ps(vmax, d);
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vmin);
+    for (float v : lanes) if (v < minValue) minValue = v;
+    _mm256_storeu_ps(lanes, vmax);
+    for (float v : lanes) if (v > maxValue) maxValue = v;
+    return i;
+}
+#endif
+
+TransparencySorter::TransparencySorter()
+    : m_keyBits(TRANSPARENCY_KEY_32)
+    , m_kernel(TRANSFORM_KERNEL_BEST)
+    , m_refineBudget(2)
+{
+}
+
+static void ComputeDistances(const SceneTransforms& scene, size_t first, size_t end, const float eye[3],
+    TransformKernel kernel, float* pOut, float& minValue, float& maxValue)
+{
+    size_t done = first;
+    switch (ResolveTransformKernel(kernel))
+    {
+#ifdef TRANSPARENCY_AVX2
+    case TRANSFORM_KERNEL_AVX2:
+        done = DistanceAvx2(scene, first, end, eye, pOut, minValue, maxValue);
+        break;
+#endif
+#ifdef TRANSPARENCY_SSE
+    case TRANSFORM_KERNEL_SSE:
+        done = DistanceSse(scene, first, end, eye, pOut, minValue, maxValue);
+        break;
+#endif
+    default:
+        break;
+    }
+    DistanceScalar(scene, done, end, eye, pOut, minValue, maxValue);
+}
+
+void TransparencySorter::ComputeKeys(const SceneTransforms& scene, float eyeX, float eyeY, float eyeZ,
+    JobSystem* pJobs)
+{
+    const uint32_t count = (uint32_t)scene.Size();
+    const float eye[3] = { eyeX, eyeY, eyeZ };
+    m_distanceSq.resize(count);
+    m_keys.resize(count);
+
+    // Each chunk keeps its own min/max; they are merged afterwards, and
+    // min and max are exact, so any split gives the same keys.
+    const uint32_t grain = std::max(KEY_GRAIN, (count + MAX_KEY_CHUNKS - 1) / MAX_KEY_CHUNKS);
+    float chunkMin[MAX_KEY_CHUNKS];
+    float chunkMax[MAX_KEY_CHUNKS];
+    ParallelFor(pJobs, count, grain, [&](uint32_t first, uint32_t n) {
+        float minValue = 3.402823466e+38f;
+        float maxValue = 0.0f;
+        ComputeDistances(scene, first, first + n, eye, m_kernel, m_distanceSq.data(), minValue, maxValue);
+        chunkMin[first / grain] = minValue;
+        chunkMax[first / grain] = maxValue;
+    });
+
+    float minValue = 3.402823466e+38f;
+    float maxValue = 0.0f;
+    for (uint32_t c = 0; c * grain < count; ++c)
+    {
+        minValue = std::min(minValue, chunkMin[c]);
+        maxValue = std::max(maxValue, chunkMax[c]);
+    }
+
+    // Keys sort ascending with the farthest object first.
+    const float* pDistance = m_distanceSq.data();
+    uint32_t* pKeys = m_keys.data();
+    if (m_keyBits == TRANSPARENCY_KEY_32)
+    {
+        // Non-negative floats order the same as their bit patterns.
+        ParallelFor(pJobs, count, grain, [=](uint32_t first, uint32_t n) {
+            for (uint32_t i = first; i < first + n; ++i)
+            {
+                uint32_t bits;
+                memcpy(&bits, &pDistance[i], sizeof(bits));
+                pKeys[i] = ~bits;
+            }
+        });
+    }
+    else
+    {
+        float range = maxValue - minValue;
+        float scale = range > 0.0f ? 65535.0f / range : 0.0f;
+        ParallelFor(pJobs, count, grain, [=](uint32_t first, uint32_t n) {
+            for (uint32_t i = first; i < first + n; ++i)
+            {
+                uint32_t q = (uint32_t)((pDistance[i] - minValue) * scale);
+                pKeys[i] = 65535u - (q > 65535u ? 65535u : q);
+            }
+        });
+    }
+}
+
+// Insertion sort on the keys, starting from last frame's order. Gives up
+// once more than maxMoves element moves were needed.
+bool TransparencySorter::Refine(size_t maxMoves)
+{
+    uint64_t* p = m_pairs.data();
+    const size_t count = m_pairs.size();
+    size_t moves = 0;
+
+    for (size_t i = 1; i < count; ++i)
+    {
+        uint64_t value = p[i];
+        uint32_t key = (uint32_t)(value >> 32);
+        if ((uint32_t)(p[i - 1] >> 32) <= key)
+            continue;
+
+        size_t j = i;
+        do
+        {
+            p[j] = p[j - 1];
+            --j;
+            ++moves;
+        } while (j > 0 && (uint32_t)(p[j - 1] >> 32) > key);
+        p[j] = value;
+
+        if (moves > maxMoves)
+            return false;
+    }
+
+    m_stats.moves = (uint32_t)moves;
+    return true;
+}
+
+// LSD radix sort on the upper 32 bits. Stable, so equal keys keep the order
+// the pairs came in.
+void TransparencySorter::RadixSort()
+{
+    const size_t count = m_pairs.size();
+    m_scratch.resize(count);
+
+    const uint32_t digitBits = m_keyBits == TRANSPARENCY_KEY_32 ? 11 : 8;
+    const uint32_t passCount = m_keyBits == TRANSPARENCY_KEY_32 ? 3 : 2;
+    const uint32_t digitCount = 1u << digitBits;
+    const uint32_t mask = digitCount - 1;
+
+    m_histogram.assign(digitCount * passCount, 0);
+    uint32_t* pHistogram = m_histogram.data();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t key = (uint32_t)(m_pairs[i] >> 32);
+        for (uint32_t pass = 0; pass < passCount; ++pass)
+            ++pHistogram[pass * digitCount + ((key >> (pass * digitBits)) & mask)];
+    }
+
+    uint64_t* pSrc = m_pairs.data();
+    uint64_t* pDst = m_scratch.data();
+    for (uint32_t pass = 0; pass < passCount; ++pass)
+    {
+        uint32_t* pCounts = pHistogram + pass * digitCount;
+        uint32_t shift = 32 + pass * digitBits;
+
+        // Every key has the same digit: the pass would be a plain copy.
+        if (pCounts[(pSrc[0] >> shift) & mask] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < digitCount; ++d)
+        {
+            uint32_t n = pCounts[d];
+            pCounts[d] = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t value = pSrc[i];
+            pDst[pCounts[(value >> shift) & mask]++] = value;
+        }
+
+        uint64_t* pTemp = pSrc;
+        pSrc = pDst;
+        pDst = pTemp;
+    }
+
+    if (pSrc != m_pairs.data())
+        m_pairs.swap(m_scratch);
+}
+
+const std::vector<uint32_t>& TransparencySorter::Sort(const SceneTransforms& scene, float eyeX, float eyeY, float eyeZ,
+    JobSystem* pJobs)
+{
+    const size_t count = scene.Size();
+    m_stats = TransparencySortStats();
+    m_stats.count = (uint32_t)count;
+    if (count == 0)
+    {
+        m_order.clear();
+        return m_order;
+    }
+
+    ComputeKeys(scene, eyeX, eyeY, eyeZ, pJobs);
+
+    // The previous order is only usable while the object set is unchanged.
+    bool warm = m_order.size() == count;
+    if (!warm)
+    {
+        m_order.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            m_order[i] = (uint32_t)i;
+    }
+
+    // Count descents on the way; when a large share of neighbours swapped,
+    // insertion would blow the budget anyway, so go straight to radix.
+    m_pairs.resize(count);
+    const uint32_t* pKeys = m_keys.data();
+    uint32_t previousKey = 0;
+    size_t descents = 0;
+    for (size_t n = 0; n < count; ++n)
+    {
+        uint32_t index = m_order[n];
+        uint32_t key = pKeys[index];
+        descents += key < previousKey;
+        previousKey = key;
+        m_pairs[n] = ((uint64_t)key << 32) | index;
+    }
+
+    warm = warm && descents <= count / 3;
+    if (warm && Refine((size_t)m_refineBudget * count))
+    {
+        m_stats.path = m_stats.moves == 0 ? TRANSPARENCY_SORT_REUSED : TRANSPARENCY_SORT_REFINED;
+        if (m_stats.path == TRANSPARENCY_SORT_REUSED)
+            return m_order;
+    }
+    else
+    {
+        m_stats.moves = 0;
+        m_stats.path = TRANSPARENCY_SORT_RADIX;
+        RadixSort();
+    }
+
+    for (size_t n = 0; n < count; ++n)
+        m_order[n] = (uint32_t)m_pairs[n];
+    return m_order;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "SceneTransforms.h"
+
+class JobSystem;
+
+// How squared eye distance is turned into a sort key. KEY_32 uses the float
+// bits directly (exact, three 11-bit radix passes). KEY_16 quantizes the
+// distance range of the frame to 16 bits (two 8-bit passes); objects closer
+// than one step apart then keep their previous relative order.
+enum TransparencyKeyBits
+{
+    TRANSPARENCY_KEY_16,
+    TRANSPARENCY_KEY_32
+};
+
+enum TransparencySortPath
+{
+    TRANSPARENCY_SORT_NONE,       // empty scene
+    TRANSPARENCY_SORT_REUSED,     // last frame's order was still sorted
+    TRANSPARENCY_SORT_REFINED,    // last frame's order fixed up by insertion
+    TRANSPARENCY_SORT_RADIX       // full radix sort
+};
+
+struct TransparencySortStats
+{
+    uint32_t count = 0;
+    uint32_t moves = 0;           // insertion moves when REFINED
+    TransparencySortPath path = TRANSPARENCY_SORT_NONE;
+};
+
+// Back-to-front ordering of transparent objects. Squared distance to the
+// eye is computed for the whole SoA with SIMD, turned into a sortable
+// integer key and paired with the object index in one 64-bit value, so
+// sorting never moves transforms around. The previous frame's order is the
+// starting point: if it is still sorted it is reused as is, if only a few
+// objects swapped places an insertion pass fixes it, and only otherwise is
+// the whole set radix sorted.
+class TransparencySorter
+{
+public:
+    TransparencySorter();
+
+    void SetKeyBits(TransparencyKeyBits bits) { m_keyBits = bits; }
+    void SetKernel(TransformKernel kernel) { m_kernel = kernel; }
+
+    // Insertion moves allowed per object before falling back to radix sort.
+    void SetRefineBudget(uint32_t movesPerObject) { m_refineBudget = movesPerObject; }
+
+    // Returns scene indices, farthest first. Equal keys keep the relative order
+    // they had last frame (index order on a cold start), so ties don't flicker.
+    // With pJobs the keys are computed in parallel; the order is the same.
+    const std::vector<uint32_t>& Sort(const SceneTransforms& scene, float eyeX, float eyeY, float eyeZ,
+        JobSystem* pJobs = nullptr);
+
+    // Forgets the previous frame, so the next Sort() starts from scratch.
+    void Reset() { m_order.clear(); }
+
+    const std::vector<uint32_t>& GetOrder() const { return m_order; }
+    const TransparencySortStats& GetLastStats() const { return m_stats; }
+
+private:
+    void ComputeKeys(const SceneTransforms& scene, float eyeX, float eyeY, float eyeZ, JobSystem* pJobs);
+    bool Refine(size_t maxMoves);
+    void RadixSort();
+
+    TransparencyKeyBits m_keyBits;
+    TransformKernel m_kernel;
+    uint32_t m_refineBudget;
+
+    std::vector<float> m_distanceSq;
+    std::vector<uint32_t> m_keys;
+    std::vector<uint64_t> m_pairs;
+    std::vector<uint64_t> m_scratch;
+    std::vector<uint32_t> m_histogram;
+    std::vector<uint32_t> m_order;
+    TransparencySortStats m_stats;
+};
@@ -1,5 +1,9 @@
 #define WIN32_LEAN_AND_MEAN
 #include "D3D11Renderer.h"
+#include "HeadlessRunner.h"
+#include "LabCommands.h"
+#include <cwchar>
+#include <windowsx.h>
 
 // Global renderer instance
 D3D11Renderer* g_pRenderer = nullptr;
@@ -28,6 +32,11 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             g_pRenderer->HandleKey((UINT)wParam, false);
         return 0;
 
+    case WM_LBUTTONDOWN:
+        if (g_pRenderer)
+            g_pRenderer->HandleClick(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+        return 0;
+
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
@@ -35,9 +44,88 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     return DefWindowProcW(hWnd, message, wParam, lParam);
 }
 
+static std::wstring GetTexturePath()
+{
+    return GetPath() + L"..\\..\\texture\\";
+}
+
+static std::string Narrow(const std::wstring& text)
+{
+    char buffer[MAX_PATH] = {};
+    WideCharToMultiByte(CP_ACP, 0, text.c_str(), -1, buffer, MAX_PATH, nullptr, nullptr);
+    return buffer;
+}
+
+static std::string NarrowToken(const wchar_t* p)
+{
+    std::wstring token;
+    while (*p && *p != L' ')
+        token += *p++;
+    return Narrow(token);
+}
+
+// The command line split on spaces, for the modes in LabCommands.
+static LabCommandLine MakeLabCommandLine(const wchar_t* pCmdLine)
+{
+    LabCommandLine commandLine;
+    for (const wchar_t* p = pCmdLine; *p; )
+    {
+        while (*p == L' ')
+            ++p;
+        if (*p)
+            commandLine.args.push_back(NarrowToken(p));
+        while (*p && *p != L' ')
+            ++p;
+    }
+    commandLine.textureDir = Narrow(GetTexturePath());
+    return commandLine;
+}
+
+// --headless renders a fixed number of frames offscreen and exits. Options:
+//   --backend d3d11|cpu|software
+//                         D3D11 on WARP (default), the CPU reference renderer
+//                         or the multithreaded software rasterizer; the CPU
+//                         backends run in LabCommands, as in lab4_headless
+//   --texture-budget MB   d3d11 only: streamed texture memory cap
+//   --cubes N             the lab cube plus N-1 instanced floor cubes
+// and the options ParseHeadlessOptions() reads. Per-frame timings go to
+// headless_timings.csv.
+static int RunHeadlessMode(const LabCommandLine& commandLine)
+{
+    HeadlessOptions options;
+    uint32_t width = 0, height = 0;
+    CameraPath path;
+    if (!ParseHeadlessOptions(commandLine, options, width, height, path))
+        return -1;
+
+    std::vector<FrameTiming> timings;
+    D3D11Renderer renderer;
+    renderer.SetCubeCount(GetCubeCount(commandLine));
+    renderer.SetTextureBudget(GetTextureBudget(commandLine));
+    const bool ok = renderer.InitializeHeadless(width, height) &&
+        RunHeadless(renderer.GetScene(), renderer, path, options, timings);
+
+    if (!WriteFrameTimingsCsv("headless_timings.csv", renderer.GetName(), timings))
+        return -1;
+    return ok ? 0 : -1;
+}
+
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE,
-    _In_ LPWSTR, _In_ int nCmdShow)
+    _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
+    const LabCommandLine commandLine = MakeLabCommandLine(lpCmdLine);
+    const int commandResult = RunLabCommand(commandLine);
+    if (commandResult != LAB_COMMAND_NONE)
+        return commandResult;
+
+
+    // --compress-on-load encodes uncompressed textures to BC1/BC3 as they load
+    if (wcsstr(lpCmdLine, L"--compress-on-load"))
+        TextureLoader::SetCompressOnLoad(true);
+
+    if (commandLine.Has("--headless"))
+        return RunHeadlessMode(commandLine);
+
     // Register window class
     WNDCLASSEXW wc = {};
     wc.cbSize = sizeof(wc);
@@ -77,6 +165,9 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE,
 
     // Initialize renderer
     g_pRenderer = new D3D11Renderer();
+    // --cubes N adds a floor of N-1 instanced cubes under the lab cube
+    g_pRenderer->SetCubeCount(GetCubeCount(commandLine));
+    g_pRenderer->SetTextureBudget(GetTextureBudget(commandLine));
     if (!g_pRenderer->Initialize(hWnd, windowWidth, windowHeight))
     {
         delete g_pRenderer;
@@ -0,0 +1,292 @@
+#include "Test.h"
+#include "AssetCooker.h"
+#include "DdsWriter.h"
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    const char* const FACE_NAMES[6] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+
+    // The lab textures plus a small uncompressed array, opened from the
+    // loose files.
+    struct LooseTextures
+    {
+        DdsView texture;
+        DdsView faces[6];
+        DdsView pixels;
+    };
+
+    bool OpenLooseTextures(LooseTextures& loose)
+    {
+        if (!loose.texture.Open((GetTextureDir() + "wood02.dds").c_str()))
+            return false;
+        for (int i = 0; i < 6; ++i)
+        {
+            if (!loose.faces[i].Open((GetTextureDir() + "skybox/" + FACE_NAMES[i] + ".dds").c_str()))
+                return false;
+        }
+
+        // 24-bit rows are not 4-byte aligned; the archive keeps them as
+        // they are.
+        DdsWriteDesc desc;
+        desc.layout = DDS_PIXELS_BGR24;
+        desc.width = 45;
+        desc.height = 11;
+        desc.mipCount = 4;
+        std::vector<uint8_t> data(DdsGetDataSize(desc));
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = (uint8_t)(i * 7 + 3);
+        const std::string path = GetScratchPath("archive_pixels.dds");
+        return WriteDds(path.c_str(), desc, data.data(), data.size()) && loose.pixels.Open(path.c_str());
+    }
+
+    // Cooks the loose textures the way --cook-archive does, plus the
+    // uncompressed one unless only the lab entries are wanted.
+    bool Cook(const std::string& path, const LooseTextures& loose, uint32_t sourceCount)
+    {
+        AssetCookSource sources[3];
+        sources[0].name = "wood02";
+        sources[0].pViews = &loose.texture;
+        sources[1].name = "skybox";
+        sources[1].pViews = loose.faces;
+        sources[1].viewCount = 6;
+        sources[1].cubemap = true;
+        sources[2].name = "pixels";
+        sources[2].pViews = &loose.pixels;
+        return CookAssetArchive(path.c_str(), sources, sourceCount);
+    }
+
+    // Every subresource of the archived view holds the bytes of the loose
+    // view's, slice after slice.
+    bool MatchesLoose(const DdsView& archived, const DdsView* pLoose, uint32_t looseCount)
+    {
+        uint32_t slice = 0;
+        for (uint32_t v = 0; v < looseCount; ++v)
+        {
+            const DdsView& loose = pLoose[v];
+            if (archived.GetFormat() != loose.GetFormat() || archived.GetPixelLayout() != loose.GetPixelLayout() ||
+                archived.GetWidth() != loose.GetWidth() || archived.GetHeight() != loose.GetHeight() ||
+                archived.GetMipCount() != loose.GetMipCount())
+                return false;
+            for (uint32_t s = 0; s < loose.GetArraySize(); ++s, ++slice)
+            {
+                for (uint32_t level = 0; level < loose.GetMipCount(); ++level)
+                {
+                    const DdsMipSpan& a = archived.GetMip(slice, level);
+                    const DdsMipSpan& b = loose.GetMip(s, level);
+                    if (a.size != b.size || a.rowPitch != b.rowPitch || a.width != b.width || a.height != b.height ||
+                        memcmp(a.pData, b.pData, a.size) != 0)
+                        return false;
+                }
+            }
+        }
+        return slice == archived.GetArraySize();
+    }
+
+    template<typename T>
+    void Patch(std::vector<uint8_t>& bytes, size_t offset, T value)
+    {
+        memcpy(&bytes[offset], &value, sizeof(value));
+    }
+
+    template<typename T>
+    T Peek(const std::vector<uint8_t>& bytes, size_t offset)
+    {
+        T value;
+        memcpy(&value, &bytes[offset], sizeof(value));
+        return value;
+    }
+
+    // Writes the damaged bytes out and tries to open them.
+    bool Opens(const std::vector<uint8_t>& bytes)
+    {
+        const std::string path = GetScratchPath("archive_damaged.pak");
+        AssetArchive archive;
+        return WriteTestFile(path, bytes) && archive.Open(path.c_str()) && archive.IsOpen();
+    }
+
+    size_t EntryOffset(uint32_t index, size_t field)
+    {
+        return sizeof(AssetArchiveHeader) + index * sizeof(AssetArchiveEntry) + field;
+    }
+
+    size_t SubresourceOffset(const std::vector<uint8_t>& bytes, uint32_t index, size_t field)
+    {
+        const uint32_t entryCount = Peek<uint32_t>(bytes, offsetof(AssetArchiveHeader, entryCount));
+        return sizeof(AssetArchiveHeader) + entryCount * sizeof(AssetArchiveEntry) +
+            index * sizeof(AssetArchiveSubresource) + field;
+    }
+}
+
+TEST_CASE(ArchiveCooksEveryEntryAsTheLooseFiles)
+{
+    LooseTextures loose;
+    const std::string path = GetScratchPath("archive_all.pak");
+    if (!CHECK(OpenLooseTextures(loose)) || !CHECK(Cook(path, loose, 3)))
+        return;
+
+    AssetArchive archive;
+    if (!CHECK(archive.Open(path.c_str())))
+        return;
+    CHECK(archive.GetEntryCount() == 3);
+    CHECK(archive.FindEntry("wood02") == 0 && archive.FindEntry("skybox") == 1 && archive.FindEntry("pixels") == 2);
+    CHECK(archive.FindEntry("wood") == -1 && archive.FindEntry("") == -1);
+
+    DdsView texture, cube, pixels;
+    CHECK(archive.OpenTexture("wood02", texture) && MatchesLoose(texture, &loose.texture, 1));
+    CHECK(archive.OpenTexture("skybox", cube) && MatchesLoose(cube, loose.faces, 6));
+    CHECK(cube.IsCubemap() && cube.GetArraySize() == 6 && !texture.IsCubemap());
+    CHECK(archive.OpenTexture(2, pixels) && MatchesLoose(pixels, &loose.pixels, 1));
+
+    // Payloads start on page boundaries, and unknown names and indices
+    // leave the view closed.
+    for (uint32_t i = 0; i < archive.GetEntryCount(); ++i)
+        CHECK(archive.GetEntry(i).dataOffset % ASSET_ARCHIVE_ALIGNMENT == 0);
+    DdsView missing;
+    CHECK(!archive.OpenTexture("missing", missing) && !missing.IsOpen());
+    CHECK(!archive.OpenTexture(3, missing) && !missing.IsOpen());
+
+    // Views keep the mapping alive once the archive is gone.
+    archive.Close();
+    CHECK(MatchesLoose(texture, &loose.texture, 1) && MatchesLoose(cube, loose.faces, 6));
+
+    // Names must be unique and fit.
+    AssetCookSource twice[2];
+    twice[0].name = "wood02";
+    twice[0].pViews = &loose.texture;
+    twice[1] = twice[0];
+    CHECK(!CookAssetArchive(GetScratchPath("archive_twice.pak").c_str(), twice, 2));
+    const std::string longName(ASSET_ARCHIVE_NAME_SIZE, 'x');
+    twice[0].name = longName.c_str();
+    CHECK(!CookAssetArchive(GetScratchPath("archive_long.pak").c_str(), twice, 1));
+}
+
+TEST_CASE(ArchiveRejectsDamagedTables)
+{
+    LooseTextures loose;
+    const std::string path = GetScratchPath("archive_good.pak");
+    std::vector<uint8_t> good;
+    if (!CHECK(OpenLooseTextures(loose)) || !CHECK(Cook(path, loose, 3)) || !CHECK(ReadTestFile(path, good)))
+        return;
+    if (!CHECK(Opens(good)))
+        return;
+
+    // Cut short anywhere: the header's file size no longer matches, and
+    // with it patched to match, the table or the payloads overrun the file.
+    const size_t tableEnd = SubresourceOffset(good, Peek<uint32_t>(good, offsetof(AssetArchiveHeader,
+        subresourceCount)), 0);
+    const size_t cuts[] = { 0, 10, sizeof(AssetArchiveHeader), EntryOffset(1, 0), tableEnd - 1, tableEnd,
+        (size_t)Peek<uint64_t>(good, EntryOffset(2, offsetof(AssetArchiveEntry, dataOffset))), good.size() - 1 };
+    for (size_t cut : cuts)
+    {
+        std::vector<uint8_t> bytes(good.begin(), good.begin() + cut);
+        CHECK(!Opens(bytes));
+        if (cut >= sizeof(AssetArchiveHeader))
+        {
+            Patch<uint64_t>(bytes, offsetof(AssetArchiveHeader, fileSize), cut);
+            CHECK(!Opens(bytes));
+        }
+    }
+
+    struct Damage
+    {
+        size_t offset;
+        uint64_t value;
+        size_t size;
+    };
+    const uint64_t fileSize = good.size();
+    const uint64_t lastOffset = Peek<uint64_t>(good, EntryOffset(2, offsetof(AssetArchiveEntry, dataOffset)));
+    const Damage damages[] = {
+        { offsetof(AssetArchiveHeader, magic), 0x4B41504D, 4 },
+        { offsetof(AssetArchiveHeader, version), ASSET_ARCHIVE_VERSION + 1, 4 },
+        { offsetof(AssetArchiveHeader, entryCount), 0x10000000, 4 },
+        { offsetof(AssetArchiveHeader, subresourceCount), 1, 4 },
+        { offsetof(AssetArchiveHeader, fileSize), fileSize + 1, 8 },
+        // Entries: unknown format or layout, empty or oversized chains, and
+        // subresource runs past the table.
+        { EntryOffset(0, offsetof(AssetArchiveEntry, format)), DXGI_FORMAT_R8G8B8A8_UNORM, 4 },
+        { EntryOffset(2, offsetof(AssetArchiveEntry, format)), DXGI_FORMAT_BC1_UNORM, 4 },
+        { EntryOffset(0, offsetof(AssetArchiveEntry, layout)), DDS_PIXELS_UNKNOWN, 4 },
+        { EntryOffset(0, offsetof(AssetArchiveEntry, layout)), DDS_PIXELS_BGR24 + 1, 4 },
+        { EntryOffset(0, offsetof(AssetArchiveEntry, mipCount)), 0, 4 },
+        { EntryOffset(0, offsetof(AssetArchiveEntry, mipCount)), 33, 4 },
+        { EntryOffset(1, offsetof(AssetArchiveEntry, arraySize)), 0, 4 },
+        { EntryOffset(1, offsetof(AssetArchiveEntry, arraySize)), 7, 4 },
+        { EntryOffset(2, offsetof(AssetArchiveEntry, firstSubresource)), 0xffffffff, 4 },
+        { EntryOffset(2, offsetof(AssetArchiveEntry, firstSubresource)), 1, 4 },
+        // Payloads out of range or off the page grid.
+        { EntryOffset(2, offsetof(AssetArchiveEntry, dataOffset)), fileSize, 8 },
+        { EntryOffset(2, offsetof(AssetArchiveEntry, dataOffset)), lastOffset + 16, 8 },
+        { EntryOffset(0, offsetof(AssetArchiveEntry, dataOffset)), 0, 8 },
+        { EntryOffset(2, offsetof(AssetArchiveEntry, dataSize)), fileSize - lastOffset + 1, 8 },
+        { EntryOffset(2, offsetof(AssetArchiveEntry, dataSize)), 0xffffffffffffffffull, 8 },
+        // Subresources outside their entry, too small for their rows, or
+        // sized for another level.
+        { SubresourceOffset(good, 0, offsetof(AssetArchiveSubresource, offset)), 0, 8 },
+        { SubresourceOffset(good, 0, offsetof(AssetArchiveSubresource, offset)), fileSize, 8 },
+        { SubresourceOffset(good, 0, offsetof(AssetArchiveSubresource, size)), 0xffffffff, 4 },
+        { SubresourceOffset(good, 0, offsetof(AssetArchiveSubresource, size)), 16, 4 },
+        { SubresourceOffset(good, 1, offsetof(AssetArchiveSubresource, rowPitch)), 8, 4 },
+        { SubresourceOffset(good, 1, offsetof(AssetArchiveSubresource, width)), 1024, 4 },
+        { SubresourceOffset(good, 1, offsetof(AssetArchiveSubresource, height)), 1, 4 },
+    };
+    for (const Damage& damage : damages)
+    {
+        std::vector<uint8_t> bytes = good;
+        if (damage.size == 8)
+            Patch<uint64_t>(bytes, damage.offset, damage.value);
+        else
+            Patch<uint32_t>(bytes, damage.offset, (uint32_t)damage.value);
+        CHECK(!Opens(bytes));
+    }
+
+    // A name without its terminator.
+    std::vector<uint8_t> unterminated = good;
+    memset(&unterminated[EntryOffset(1, 0)], 'x', ASSET_ARCHIVE_NAME_SIZE);
+    CHECK(!Opens(unterminated));
+
+    // A failed open leaves nothing mapped, and the archive opens fine again.
+    AssetArchive archive;
+    std::vector<uint8_t> bytes = good;
+    Patch<uint32_t>(bytes, offsetof(AssetArchiveHeader, magic), 0);
+    const std::string damagedPath = GetScratchPath("archive_damaged.pak");
+    CHECK(WriteTestFile(damagedPath, bytes) && !archive.Open(damagedPath.c_str()));
+    CHECK(!archive.IsOpen() && archive.GetEntryCount() == 0 && archive.GetMappedSize() == 0);
+    CHECK(archive.Open(path.c_str()) && archive.GetEntryCount() == 3);
+}
+
+TEST_CASE(ArchiveFallsBackToLooseFiles)
+{
+    // The check D3D11Renderer::BeginTextureLoads() makes before it loads
+    // from lab.pak instead of the loose files.
+    const char* const entries[] = { "wood02", "skybox" };
+    LooseTextures loose;
+    if (!CHECK(OpenLooseTextures(loose)))
+        return;
+
+    // No archive: loose files.
+    AssetArchive archive;
+    CHECK(!archive.Open(GetScratchPath("archive_none.pak").c_str()) && !archive.HasEntries(entries, 2));
+
+    // An archive with only the texture: loose files for both.
+    const std::string partial = GetScratchPath("archive_partial.pak");
+    CHECK(Cook(partial, loose, 1) && archive.Open(partial.c_str()));
+    CHECK(archive.HasEntries(entries, 1) && !archive.HasEntries(entries, 2));
+
+    // A damaged one: loose files, even though it held both once.
+    const std::string lab = GetScratchPath("archive_lab.pak");
+    std::vector<uint8_t> bytes;
+    CHECK(Cook(lab, loose, 2) && ReadTestFile(lab, bytes));
+    bytes.resize(bytes.size() - 1);
+    const std::string damaged = GetScratchPath("archive_truncated.pak");
+    CHECK(WriteTestFile(damaged, bytes) && !archive.Open(damaged.c_str()) && !archive.HasEntries(entries, 2));
+
+    // The cooked lab.pak: both come from the archive and match the loose
+    // files.
+    if (!CHECK(archive.Open(lab.c_str()) && archive.HasEntries(entries, 2)))
+        return;
+    DdsView texture, cube;
+    CHECK(archive.OpenTexture(entries[0], texture) && MatchesLoose(texture, &loose.texture, 1));
+    CHECK(archive.OpenTexture(entries[1], cube) && MatchesLoose(cube, loose.faces, 6));
+}
@@ -0,0 +1,22 @@
+#include "LabCommands.h"
+#include <cstdio>
+
+// lab4_bench: lab4.exe's benches and reports without a window or D3D11,
+// for example "lab4_bench --bench-dds". --texture-dir DIR reads the lab4
+// textures from DIR instead of the source tree.
+int main(int argc, char** argv)
+{
+    LabCommandLine commandLine;
+    commandLine.args.assign(argv + 1, argv + argc);
+    commandLine.textureDir = LAB4_TEXTURE_DIR;
+    if (const char* pDir = commandLine.GetValue("--texture-dir"))
+        commandLine.textureDir = std::string(pDir) + "/";
+
+    const int result = RunLabCommand(commandLine);
+    if (result == LAB_COMMAND_NONE)
+    {
+        printf("usage: lab4_bench <mode> [options]\nmodes:\n");
+        PrintLabCommands();
+    }
+    return result;
+}
@@ -0,0 +1,237 @@
+#include "Test.h"
+#include "BlockDecoder.h"
+#include "LoadScheduler.h"
+#include <cstring>
+
+namespace
+{
+    const BlockDecodeKernel SIMD_KERNELS[] = { BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+
+    struct RGBA
+    {
+        uint8_t r, g, b, a;
+    };
+
+    bool operator==(const RGBA& x, const RGBA& y)
+    {
+        return x.r == y.r && x.g == y.g && x.b == y.b && x.a == y.a;
+    }
+
+    void StoreColorHalf(uint16_t c0, uint16_t c1, uint32_t indices, uint8_t* pOut)
+    {
+        pOut[0] = (uint8_t)c0;
+        pOut[1] = (uint8_t)(c0 >> 8);
+        pOut[2] = (uint8_t)c1;
+        pOut[3] = (uint8_t)(c1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            pOut[4 + i] = (uint8_t)(indices >> (8 * i));
+    }
+
+    // BC3 alpha half: endpoints plus sixteen 3-bit indices.
+    void StoreAlphaHalf(uint8_t a0, uint8_t a1, const uint8_t indices[16], uint8_t* pOut)
+    {
+        pOut[0] = a0;
+        pOut[1] = a1;
+        uint64_t bits = 0;
+        for (int p = 0; p < 16; ++p)
+            bits |= (uint64_t)indices[p] << (3 * p);
+        for (int i = 0; i < 6; ++i)
+            pOut[2 + i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    // Decodes the block three times side by side (so the AVX2 kernel takes
+    // a pair and a single) and checks every copy against expected.
+    bool DecodesTo(DXGI_FORMAT fmt, const uint8_t* pBlock, const RGBA expected[16])
+    {
+        const uint32_t blockBytes = DdsBytesPerBlock(fmt);
+        uint8_t blocks[3 * 16];
+        for (int i = 0; i < 3; ++i)
+            memcpy(blocks + i * blockBytes, pBlock, blockBytes);
+
+        const BlockDecodeKernel kernels[] = { BLOCK_DECODE_SCALAR, BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+        bool matches = true;
+        for (BlockDecodeKernel kernel : kernels)
+        {
+            if (!IsBlockDecodeKernelSupported(kernel))
+                continue;
+            RGBA pixels[4][12];
+            memset(pixels, 0xcd, sizeof(pixels));
+            DecodeBlockSurface(fmt, blocks, 3 * blockBytes, 12, 4, (uint8_t*)pixels, 12 * 4, kernel);
+            for (int p = 0; p < 48; ++p)
+                matches = matches && pixels[p / 12][p % 12] == expected[(p / 12) * 4 + (p % 12) % 4];
+        }
+        return matches;
+    }
+
+    // Pixel p uses palette entry p % 4, row by row.
+    const uint32_t INDICES_0123 = 0xE4E4E4E4u;
+
+    void ExpandPalette(const RGBA palette[4], RGBA expected[16])
+    {
+        for (int p = 0; p < 16; ++p)
+            expected[p] = palette[p % 4];
+    }
+
+    // Decodes a width x height corner of the surface at pSrc with every
+    // SIMD kernel the CPU has and compares it with the scalar decode.
+    bool SimdMatchesScalar(DXGI_FORMAT fmt, const uint8_t* pSrc, uint32_t srcRowPitch, uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> scalar((size_t)width * height * 4);
+        DecodeBlockSurface(fmt, pSrc, srcRowPitch, width, height, scalar.data(), width * 4, BLOCK_DECODE_SCALAR);
+
+        bool matches = true;
+        for (BlockDecodeKernel kernel : SIMD_KERNELS)
+        {
+            if (!IsBlockDecodeKernelSupported(kernel))
+                continue;
+            // Poisoned, so pixels a kernel fails to write show up.
+            std::vector<uint8_t> simd(scalar.size(), 0xcd);
+            DecodeBlockSurface(fmt, pSrc, srcRowPitch, width, height, simd.data(), width * 4, kernel);
+            matches = matches && simd == scalar;
+        }
+        return matches;
+    }
+
+    bool OpenLabTexture(const char* name, DdsView& view)
+    {
+        return view.Open((GetTextureDir() + name).c_str());
+    }
+
+    const char* const LAB_TEXTURES[] = {
+        "wood02.dds", "skybox/posx.dds", "skybox/negx.dds", "skybox/posy.dds",
+        "skybox/negy.dds", "skybox/posz.dds", "skybox/negz.dds"
+    };
+}
+
+TEST_CASE(BlockDecoderBc1FourColorBlock)
+{
+    // Red over blue, c0 > c1: the two thirds points between them.
+    uint8_t block[8];
+    StoreColorHalf(0xF800, 0x001F, INDICES_0123, block);
+    const RGBA palette[4] = { { 255, 0, 0, 255 }, { 0, 0, 255, 255 }, { 170, 0, 85, 255 }, { 85, 0, 170, 255 } };
+    RGBA expected[16];
+    ExpandPalette(palette, expected);
+    CHECK(DecodesTo(DXGI_FORMAT_BC1_UNORM, block, expected));
+}
+
+TEST_CASE(BlockDecoderBc1ThreeColorBlocks)
+{
+    // c0 < c1: the midpoint, and index 3 is transparent black.
+    uint8_t block[8];
+    StoreColorHalf(0x001F, 0xF800, INDICES_0123, block);
+    const RGBA palette[4] = { { 0, 0, 255, 255 }, { 255, 0, 0, 255 }, { 128, 0, 128, 255 }, { 0, 0, 0, 0 } };
+    RGBA expected[16];
+    ExpandPalette(palette, expected);
+    CHECK(DecodesTo(DXGI_FORMAT_BC1_UNORM, block, expected));
+
+    // Equal endpoints are three-colour mode too.
+    StoreColorHalf(0x07E0, 0x07E0, INDICES_0123, block);
+    const RGBA green[4] = { { 0, 255, 0, 255 }, { 0, 255, 0, 255 }, { 0, 255, 0, 255 }, { 0, 0, 0, 0 } };
+    ExpandPalette(green, expected);
+    CHECK(DecodesTo(DXGI_FORMAT_BC1_UNORM, block, expected));
+}
+
+TEST_CASE(BlockDecoderBc2ExplicitAlpha)
+{
+    // Pixel p has alpha nibble p; BC2 colour is four-colour even with c0 < c1.
+    uint8_t block[16];
+    const uint64_t alpha = 0xFEDCBA9876543210ull;
+    for (int i = 0; i < 8; ++i)
+        block[i] = (uint8_t)(alpha >> (8 * i));
+    StoreColorHalf(0x001F, 0xF800, INDICES_0123, block + 8);
+
+    const RGBA palette[4] = { { 0, 0, 255, 0 }, { 255, 0, 0, 0 }, { 85, 0, 170, 0 }, { 170, 0, 85, 0 } };
+    RGBA expected[16];
+    ExpandPalette(palette, expected);
+    for (int p = 0; p < 16; ++p)
+        expected[p].a = (uint8_t)(p * 17);
+    CHECK(DecodesTo(DXGI_FORMAT_BC2_UNORM, block, expected));
+}
+
+TEST_CASE(BlockDecoderBc3AlphaModes)
+{
+    uint8_t indices[16];
+    for (int p = 0; p < 16; ++p)
+        indices[p] = (uint8_t)(p % 8);
+
+    uint8_t block[16];
+    StoreColorHalf(0x001F, 0xF800, INDICES_0123, block + 8);
+    const RGBA colors[4] = { { 0, 0, 255, 0 }, { 255, 0, 0, 0 }, { 85, 0, 170, 0 }, { 170, 0, 85, 0 } };
+    RGBA expected[16];
+
+    // a0 > a1: six interpolated sevenths.
+    StoreAlphaHalf(255, 0, indices, block);
+    const uint8_t eightAlpha[8] = { 255, 0, 219, 182, 146, 109, 73, 36 };
+    ExpandPalette(colors, expected);
+    for (int p = 0; p < 16; ++p)
+        expected[p].a = eightAlpha[p % 8];
+    CHECK(DecodesTo(DXGI_FORMAT_BC3_UNORM, block, expected));
+
+    // a0 <= a1: four interpolated fifths, then 0 and 255.
+    StoreAlphaHalf(0, 255, indices, block);
+    const uint8_t sixAlpha[8] = { 0, 255, 51, 102, 153, 204, 0, 255 };
+    for (int p = 0; p < 16; ++p)
+        expected[p].a = sixAlpha[p % 8];
+    CHECK(DecodesTo(DXGI_FORMAT_BC3_UNORM, block, expected));
+}
+
+TEST_CASE(BlockDecoderSimdMatchesScalarOnLabTextures)
+{
+    // Every mip, the top one also clipped to a size that is no whole
+    // number of blocks, so the SIMD rows hand their ragged ends to the
+    // scalar path.
+    for (const char* name : LAB_TEXTURES)
+    {
+        DdsView view;
+        if (!CHECK(OpenLabTexture(name, view)) || !CHECK(IsBlockDecodeFormat(view.GetFormat())))
+            return;
+
+        const DdsMipSpan& top = view.GetMip(0);
+        CHECK(SimdMatchesScalar(view.GetFormat(), top.pData, top.rowPitch, top.width - 3, top.height - 2));
+        for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+        {
+            const DdsMipSpan& mip = view.GetMip(level);
+            CHECK(SimdMatchesScalar(view.GetFormat(), mip.pData, mip.rowPitch, mip.width, mip.height));
+        }
+    }
+}
+
+TEST_CASE(BlockDecoderSimdMatchesScalarOnBc2AndBc3)
+{
+    // The lab textures are all BC1; arbitrary bytes cover every BC2/BC3
+    // alpha mode and index.
+    const uint32_t blocksWide = 19, blocksHigh = 7;
+    const DXGI_FORMAT formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC2_UNORM, DXGI_FORMAT_BC3_UNORM };
+    for (DXGI_FORMAT fmt : formats)
+    {
+        const uint32_t pitch = blocksWide * DdsBytesPerBlock(fmt);
+        std::vector<uint8_t> blocks((size_t)pitch * blocksHigh);
+        uint32_t state = 12345;
+        for (uint8_t& b : blocks)
+        {
+            state = state * 1664525u + 1013904223u;
+            b = (uint8_t)(state >> 24);
+        }
+        CHECK(SimdMatchesScalar(fmt, blocks.data(), pitch, blocksWide * 4, blocksHigh * 4));
+        CHECK(SimdMatchesScalar(fmt, blocks.data(), pitch, blocksWide * 4 - 1, blocksHigh * 4 - 3));
+        CHECK(SimdMatchesScalar(fmt, blocks.data(), pitch, 6, 5));
+    }
+}
+
+TEST_CASE(BlockDecoderParallelMatchesSerial)
+{
+    LoadScheduler scheduler(3);
+    for (const char* name : LAB_TEXTURES)
+    {
+        DdsView view;
+        if (!CHECK(OpenLabTexture(name, view)))
+            return;
+        for (uint32_t level = 0; level < view.GetMipCount(); level += 3)
+        {
+            std::vector<uint8_t> serial, parallel;
+            CHECK(DecodeDdsMip(view, level, serial, BLOCK_DECODE_BEST, nullptr));
+            CHECK(DecodeDdsMip(view, level, parallel, BLOCK_DECODE_BEST, &scheduler));
+            CHECK(!serial.empty() && parallel == serial);
+        }
+    }
+}
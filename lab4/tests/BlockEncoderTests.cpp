@@ -0,0 +1,316 @@
+#include "Test.h"
+#include "BlockEncoder.h"
+#include "DdsWriter.h"
+#include "LoadScheduler.h"
+#include "PixelConverter.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const BlockDecodeKernel SIMD_KERNELS[] = { BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+    const BlockEncodeQuality QUALITIES[] = { BLOCK_ENCODE_FAST, BLOCK_ENCODE_HIGH };
+    const DXGI_FORMAT FORMATS[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM };
+
+    // Smooth gradients with a little noise, the kind of content block
+    // compression is made for; alpha ramps across the image.
+    std::vector<uint8_t> MakeImage(uint32_t width, uint32_t height, bool alpha)
+    {
+        std::vector<uint8_t> rgba((size_t)width * height * 4);
+        uint32_t state = width * 31 + height;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                state = state * 1664525u + 1013904223u;
+                const int noise = (int)(state >> 29) - 4;
+                uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+                p[0] = (uint8_t)std::min(255, std::max(0, (int)(x * 255 / width) + noise));
+                p[1] = (uint8_t)std::min(255, std::max(0, (int)(y * 255 / height) + noise));
+                p[2] = (uint8_t)(128 + noise);
+                p[3] = alpha ? (uint8_t)((x + y) * 255 / (width + height)) : 255;
+            }
+        }
+        return rgba;
+    }
+
+    std::vector<uint8_t> Encode(DXGI_FORMAT fmt, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height,
+        BlockEncodeQuality quality, BlockDecodeKernel kernel, LoadScheduler* pScheduler = nullptr)
+    {
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(fmt, width, height, rowPitch, rowCount);
+        std::vector<uint8_t> blocks((size_t)rowPitch * rowCount, 0xcd);
+        EncodeBlockSurface(fmt, rgba.data(), width * 4, width, height, blocks.data(), rowPitch, quality, kernel,
+            pScheduler);
+        return blocks;
+    }
+
+    std::vector<uint8_t> Decode(DXGI_FORMAT fmt, const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height)
+    {
+        uint32_t rowPitch, rowCount;
+        DdsGetMipLayout(fmt, width, height, rowPitch, rowCount);
+        std::vector<uint8_t> rgba((size_t)width * height * 4);
+        DecodeBlockSurface(fmt, blocks.data(), rowPitch, width, height, rgba.data(), width * 4, BLOCK_DECODE_SCALAR);
+        return rgba;
+    }
+
+    // Root mean square error of channel c over every pixel.
+    double GetRmse(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int c)
+    {
+        double sum = 0.0;
+        for (size_t i = c; i < a.size(); i += 4)
+            sum += ((double)a[i] - b[i]) * ((double)a[i] - b[i]);
+        return std::sqrt(sum / (a.size() / 4));
+    }
+
+    bool OpenLabImage(const char* name, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+    {
+        DdsView view;
+        if (!view.Open((GetTextureDir() + name).c_str()) || !DecodeDdsMip(view, 0, rgba))
+            return false;
+        width = view.GetWidth();
+        height = view.GetHeight();
+        return true;
+    }
+}
+
+TEST_CASE(BlockEncoderStaysWithinErrorBounds)
+{
+    const uint32_t width = 64, height = 48;
+    for (DXGI_FORMAT fmt : FORMATS)
+    {
+        const std::vector<uint8_t> image = MakeImage(width, height, fmt == DXGI_FORMAT_BC3_UNORM);
+        for (BlockEncodeQuality quality : QUALITIES)
+        {
+            const std::vector<uint8_t> decoded = Decode(fmt, Encode(fmt, image, width, height, quality,
+                BLOCK_DECODE_SCALAR), width, height);
+            // 5:6:5 endpoints on a gradient with +-4 of noise.
+            CHECK(GetRmse(image, decoded, 0) < 5.0);
+            CHECK(GetRmse(image, decoded, 1) < 5.0);
+            CHECK(GetRmse(image, decoded, 2) < 5.0);
+            // BC3 interpolates alpha in sevenths of a block's range.
+            if (fmt == DXGI_FORMAT_BC3_UNORM)
+                CHECK(GetRmse(image, decoded, 3) < 1.0);
+        }
+    }
+
+    // A solid block comes back as the nearest 5:6:5 colour.
+    std::vector<uint8_t> solid((size_t)8 * 8 * 4);
+    for (size_t i = 0; i < solid.size(); i += 4)
+    {
+        solid[i] = 200;
+        solid[i + 1] = 100;
+        solid[i + 2] = 50;
+        solid[i + 3] = 255;
+    }
+    for (BlockEncodeQuality quality : QUALITIES)
+    {
+        const std::vector<uint8_t> decoded = Decode(DXGI_FORMAT_BC1_UNORM,
+            Encode(DXGI_FORMAT_BC1_UNORM, solid, 8, 8, quality, BLOCK_DECODE_SCALAR), 8, 8);
+        bool close = true;
+        for (size_t i = 0; i < decoded.size(); i += 4)
+        {
+            close = close && abs(decoded[i] - 200) <= 4 && abs(decoded[i + 1] - 100) <= 2 &&
+                abs(decoded[i + 2] - 50) <= 4 && decoded[i + 3] == 255;
+        }
+        CHECK(close);
+    }
+
+    // wood02 was BC1 to begin with: the high quality encoder all but finds
+    // the original blocks again, the fast one stays close.
+    std::vector<uint8_t> wood;
+    uint32_t woodWidth = 0, woodHeight = 0;
+    if (!CHECK(OpenLabImage("wood02.dds", wood, woodWidth, woodHeight)))
+        return;
+    double rmse[2] = {};
+    for (int q = 0; q < 2; ++q)
+    {
+        const std::vector<uint8_t> decoded = Decode(DXGI_FORMAT_BC1_UNORM, Encode(DXGI_FORMAT_BC1_UNORM, wood,
+            woodWidth, woodHeight, QUALITIES[q], BLOCK_DECODE_BEST), woodWidth, woodHeight);
+        for (int c = 0; c < 3; ++c)
+            rmse[q] += GetRmse(wood, decoded, c) / 3.0;
+    }
+    CHECK(rmse[0] < 3.5);
+    CHECK(rmse[1] < 0.5);
+}
+
+TEST_CASE(BlockEncoderSimdMatchesScalar)
+{
+    // Sizes that are no whole number of blocks, so edge blocks repeat their
+    // last column and row, and widths that leave the AVX2 kernel a single
+    // block at the end of a row.
+    const uint32_t sizes[][2] = { { 37, 21 }, { 4, 4 }, { 5, 3 }, { 64, 8 } };
+    std::vector<uint8_t> wood;
+    uint32_t woodWidth = 0, woodHeight = 0;
+    if (!CHECK(OpenLabImage("wood02.dds", wood, woodWidth, woodHeight)))
+        return;
+
+    for (DXGI_FORMAT fmt : FORMATS)
+    {
+        for (BlockEncodeQuality quality : QUALITIES)
+        {
+            for (const uint32_t* size : sizes)
+            {
+                const std::vector<uint8_t> image = MakeImage(size[0], size[1], fmt == DXGI_FORMAT_BC3_UNORM);
+                const std::vector<uint8_t> scalar = Encode(fmt, image, size[0], size[1], quality, BLOCK_DECODE_SCALAR);
+                for (BlockDecodeKernel kernel : SIMD_KERNELS)
+                {
+                    if (IsBlockDecodeKernelSupported(kernel))
+                        CHECK(Encode(fmt, image, size[0], size[1], quality, kernel) == scalar);
+                }
+            }
+
+            // The top 256 rows of wood02, real content with every block kind.
+            const uint32_t rows = 256;
+            const std::vector<uint8_t> top(wood.begin(), wood.begin() + (size_t)woodWidth * rows * 4);
+            const std::vector<uint8_t> scalar = Encode(fmt, top, woodWidth, rows, quality, BLOCK_DECODE_SCALAR);
+            for (BlockDecodeKernel kernel : SIMD_KERNELS)
+            {
+                if (IsBlockDecodeKernelSupported(kernel))
+                    CHECK(Encode(fmt, top, woodWidth, rows, quality, kernel) == scalar);
+            }
+        }
+    }
+}
+
+TEST_CASE(BlockEncoderParallelMatchesSerial)
+{
+    LoadScheduler scheduler(3);
+    const std::vector<uint8_t> image = MakeImage(203, 97, true);
+    for (DXGI_FORMAT fmt : FORMATS)
+    {
+        const std::vector<uint8_t> serial = Encode(fmt, image, 203, 97, BLOCK_ENCODE_HIGH, BLOCK_DECODE_BEST);
+        CHECK(Encode(fmt, image, 203, 97, BLOCK_ENCODE_HIGH, BLOCK_DECODE_BEST, &scheduler) == serial);
+    }
+}
+
+TEST_CASE(BlockEncoderBc1HandlesAlpha)
+{
+    // Alpha-free input stays opaque: no block may fall into the
+    // three-colour mode's transparent black.
+    const uint32_t width = 32, height = 32;
+    std::vector<uint8_t> image = MakeImage(width, height, false);
+    for (BlockEncodeQuality quality : QUALITIES)
+    {
+        const std::vector<uint8_t> decoded = Decode(DXGI_FORMAT_BC1_UNORM,
+            Encode(DXGI_FORMAT_BC1_UNORM, image, width, height, quality, BLOCK_DECODE_BEST), width, height);
+        bool opaque = true;
+        for (size_t i = 3; i < decoded.size(); i += 4)
+            opaque = opaque && decoded[i] == 255;
+        CHECK(opaque);
+    }
+
+    // Cut-outs: pixels below 128 alpha come back transparent black, the rest
+    // opaque.
+    for (size_t i = 0; i < image.size(); i += 4)
+        image[i + 3] = (i / 4) % 3 == 0 ? 20 : 240;
+    for (BlockEncodeQuality quality : QUALITIES)
+    {
+        const std::vector<uint8_t> decoded = Decode(DXGI_FORMAT_BC1_UNORM,
+            Encode(DXGI_FORMAT_BC1_UNORM, image, width, height, quality, BLOCK_DECODE_BEST), width, height);
+        bool cutOut = true;
+        for (size_t i = 0; i < decoded.size(); i += 4)
+        {
+            const bool transparent = image[i + 3] < 128;
+            cutOut = cutOut && (transparent ? decoded[i + 3] == 0 && decoded[i] == 0 && decoded[i + 1] == 0 &&
+                decoded[i + 2] == 0 : decoded[i + 3] == 255);
+        }
+        CHECK(cutOut);
+    }
+}
+
+TEST_CASE(BlockEncoderBc3KeepsAlpha)
+{
+    // Alpha that BC1 would throw away: a ramp plus fully clear and fully
+    // opaque pixels, which BC3's six-value mode hits exactly.
+    const uint32_t width = 32, height = 16;
+    std::vector<uint8_t> image = MakeImage(width, height, true);
+    image[3] = 0;
+    image[7] = 255;
+    for (BlockEncodeQuality quality : QUALITIES)
+    {
+        const std::vector<uint8_t> decoded = Decode(DXGI_FORMAT_BC3_UNORM,
+            Encode(DXGI_FORMAT_BC3_UNORM, image, width, height, quality, BLOCK_DECODE_BEST), width, height);
+        int worst = 0;
+        for (size_t i = 3; i < decoded.size(); i += 4)
+            worst = std::max(worst, abs(decoded[i] - image[i]));
+        // The fast encoder's eight-value ramp over 0..255 is off by at most
+        // half a step; the high one picks the six-value mode there.
+        CHECK(worst <= (quality == BLOCK_ENCODE_FAST ? 18 : 4));
+        CHECK(decoded[3] == 0 && decoded[7] == 255);
+    }
+}
+
+TEST_CASE(BlockEncoderCompressOnLoadStagesEveryMip)
+{
+    // Uncompressed files the way TextureLoader stages them under
+    // compress-on-load: BC3 where the layout has alpha, BC1 otherwise.
+    const DdsPixelLayout layouts[] = { DDS_PIXELS_RGBA32, DDS_PIXELS_BGRA32, DDS_PIXELS_BGRX32, DDS_PIXELS_RGB24 };
+    LoadScheduler scheduler(2);
+    for (DdsPixelLayout layout : layouts)
+    {
+        DdsWriteDesc desc;
+        desc.layout = layout;
+        desc.width = 64;
+        desc.height = 32;
+        desc.mipCount = 7;
+        // 24-bit files have no DX10 header to describe an array.
+        desc.arraySize = layout == DDS_PIXELS_RGB24 ? 1 : 2;
+        std::vector<uint8_t> data(DdsGetDataSize(desc));
+        uint32_t state = layout;
+        for (uint8_t& b : data)
+        {
+            state = state * 1664525u + 1013904223u;
+            b = (uint8_t)(state >> 24);
+        }
+        const std::string path = GetScratchPath("compress_on_load.dds");
+        DdsView view;
+        if (!CHECK(WriteDds(path.c_str(), desc, data.data(), data.size()) && view.Open(path.c_str())))
+            return;
+
+        const bool alpha = layout == DDS_PIXELS_RGBA32 || layout == DDS_PIXELS_BGRA32;
+        const DXGI_FORMAT fmt = GetCompressOnLoadFormat(view, 0);
+        CHECK(fmt == (alpha ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM));
+        // From mip 4 on the top is 4x2, no whole block.
+        CHECK(GetCompressOnLoadFormat(view, 3) == fmt);
+        CHECK(GetCompressOnLoadFormat(view, 4) == DXGI_FORMAT_UNKNOWN);
+
+        for (uint32_t firstMip = 0; firstMip < 2; ++firstMip)
+        {
+            for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+            {
+                // Expected: every level converted on its own, then encoded.
+                std::vector<uint8_t> expected;
+                for (uint32_t level = firstMip; level < view.GetMipCount(); ++level)
+                {
+                    std::vector<uint8_t> rgba;
+                    ConvertDdsMip(view, slice, level, rgba, BLOCK_DECODE_SCALAR);
+                    const DdsMipSpan& mip = view.GetMip(slice, level);
+                    const std::vector<uint8_t> blocks = Encode(fmt, rgba, mip.width, mip.height, BLOCK_ENCODE_FAST,
+                        BLOCK_DECODE_SCALAR);
+                    expected.insert(expected.end(), blocks.begin(), blocks.end());
+                }
+
+                std::vector<uint8_t> scratch((size_t)view.GetMip(firstMip).width * view.GetMip(firstMip).height * 4);
+                std::vector<uint8_t> staged(expected.size() + 16, 0xcd);
+                CHECK(EncodeDdsMipChain(view, slice, firstMip, fmt, staged.data(), scratch.data()));
+                CHECK(memcmp(staged.data(), expected.data(), expected.size()) == 0);
+                CHECK(staged[expected.size()] == 0xcd);
+
+                std::vector<uint8_t> parallel(expected.size(), 0xcd);
+                CHECK(EncodeDdsMipChain(view, slice, firstMip, fmt, parallel.data(), scratch.data(), &scheduler));
+                CHECK(parallel == expected);
+            }
+        }
+    }
+
+    // Block files are uploaded as they are.
+    DdsView wood;
+    if (CHECK(wood.Open((GetTextureDir() + "wood02.dds").c_str())))
+    {
+        CHECK(GetCompressOnLoadFormat(wood, 0) == DXGI_FORMAT_UNKNOWN);
+        std::vector<uint8_t> out(16);
+        CHECK(!EncodeDdsMipChain(wood, 0, 0, DXGI_FORMAT_BC1_UNORM, out.data(), out.data()));
+    }
+}
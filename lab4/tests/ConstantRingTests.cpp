@@ -0,0 +1,119 @@
+#include "Test.h"
+#include "ConstantRing.h"
+
+TEST_CASE(ConstantRingAlignsEveryAllocation)
+{
+    CHECK(ConstantRing::AlignSize(1) == 256);
+    CHECK(ConstantRing::AlignSize(256) == 256);
+    CHECK(ConstantRing::AlignSize(257) == 512);
+
+    // Capacity rounds down to whole slots.
+    ConstantRing ring(1000);
+    CHECK(ring.GetCapacity() == 768);
+
+    ring.Reset(64 * 1024);
+    CHECK(ring.BeginFrame());
+    const uint32_t sizes[] = { 1, 64, 256, 257, 4000 };
+    uint32_t expected = 0;
+    for (uint32_t size : sizes)
+    {
+        uint32_t offset = ~0u;
+        if (!CHECK(ring.Allocate(size, offset)))
+            return;
+        CHECK(offset == expected);
+        CHECK(offset % CONSTANT_RING_ALIGNMENT == 0);
+        expected += ConstantRing::AlignSize(size);
+    }
+    CHECK(ring.GetHead() == expected);
+    CHECK(ring.GetStats().frameBytes == expected && ring.GetStats().allocations == 5);
+    ring.EndFrame();
+}
+
+TEST_CASE(ConstantRingWrapsOnlyBetweenFrames)
+{
+    // Sixteen slots, five per frame: three frames fit before the ring wraps.
+    ConstantRing ring(16 * CONSTANT_RING_ALIGNMENT);
+    const uint32_t expectedStarts[] = { 0, 1280, 2560, 0, 1280 };
+    const bool expectedDiscards[] = { true, false, false, true, false };
+
+    for (uint32_t frame = 0; frame < 5; ++frame)
+    {
+        CHECK(ring.BeginFrame() == expectedDiscards[frame]);
+        CHECK(ring.GetFrameStart() == expectedStarts[frame]);
+        for (uint32_t i = 0; i < 5; ++i)
+        {
+            uint32_t offset;
+            CHECK(ring.Allocate(200, offset));
+            CHECK(offset == expectedStarts[frame] + i * CONSTANT_RING_ALIGNMENT);
+        }
+        ring.EndFrame();
+    }
+    CHECK(ring.GetStats().discards == 2);
+    CHECK(ring.GetStats().largestFrame == 1280);
+
+    ring.Reset(16 * CONSTANT_RING_ALIGNMENT);
+    CHECK(ring.BeginFrame());
+    CHECK(ring.GetStats().discards == 1);
+}
+
+TEST_CASE(ConstantRingFailsInsteadOfOverflowing)
+{
+    ConstantRing ring(4 * CONSTANT_RING_ALIGNMENT);
+    CHECK(ring.BeginFrame());
+
+    uint32_t offset = 12345;
+    CHECK(ring.Allocate(3 * CONSTANT_RING_ALIGNMENT, offset) && offset == 0);
+    CHECK(!ring.Allocate(2 * CONSTANT_RING_ALIGNMENT, offset));
+    CHECK(!ring.Allocate(0, offset));
+    CHECK(!ring.Allocate(UINT32_MAX - 10, offset));     // rounding up would wrap
+    CHECK(ring.GetHead() == 3 * CONSTANT_RING_ALIGNMENT);
+
+    // The space that is left still serves what fits.
+    CHECK(ring.Allocate(CONSTANT_RING_ALIGNMENT, offset) && offset == 3 * CONSTANT_RING_ALIGNMENT);
+    CHECK(ring.GetStats().failures == 3 && ring.GetStats().allocations == 2);
+    ring.EndFrame();
+
+    // The failed request counts toward the largest frame, so the next frame
+    // starts over rather than running into the full end.
+    CHECK(ring.GetStats().largestFrame > ring.GetCapacity());
+    CHECK(ring.BeginFrame());
+    CHECK(ring.GetFrameStart() == 0);
+    CHECK(ring.GetStats().failures == 0);
+
+    ConstantRing empty;
+    empty.BeginFrame();
+    CHECK(!empty.Allocate(16, offset));
+}
+
+TEST_CASE(ConstantRingNeverRewritesBytesInFlight)
+{
+    // Random frame sizes, some larger than the ring. Between discards the
+    // written range only grows and each frame starts where the last stopped.
+    ConstantRing ring(64 * CONSTANT_RING_ALIGNMENT);
+    uint32_t state = 99;
+    uint32_t written = 0;
+    bool valid = true;
+    for (uint32_t frame = 0; frame < 2000; ++frame)
+    {
+        if (ring.BeginFrame())
+            written = 0;
+        valid = valid && ring.GetFrameStart() == written;
+
+        state = state * 1664525u + 1013904223u;
+        const uint32_t allocations = (state >> 8) % 40;
+        for (uint32_t i = 0; i < allocations; ++i)
+        {
+            state = state * 1664525u + 1013904223u;
+            const uint32_t size = 1 + (state >> 8) % 700;
+            uint32_t offset;
+            if (!ring.Allocate(size, offset))
+                continue;
+            valid = valid && offset == written && offset % CONSTANT_RING_ALIGNMENT == 0 &&
+                offset + ConstantRing::AlignSize(size) <= ring.GetCapacity();
+            written = offset + ConstantRing::AlignSize(size);
+        }
+        ring.EndFrame();
+    }
+    CHECK(valid);
+    CHECK(ring.GetStats().discards > 1);
+}
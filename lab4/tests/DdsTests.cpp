@@ -0,0 +1,315 @@
+#include "Test.h"
+#include "DdsView.h"
+#include "DdsWriter.h"
+#include "PixelConverter.h"
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    struct FormatCase
+    {
+        DdsPixelLayout layout;
+        DXGI_FORMAT format;
+        bool dx10Header;
+        bool expectDx10;
+    };
+
+    const FormatCase FORMAT_CASES[] = {
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC1_UNORM, false, false },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC1_UNORM, true, true },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC2_UNORM, false, false },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC3_UNORM, false, false },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC3_UNORM, true, true },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC4_UNORM, false, false },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC4_SNORM, false, false },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC5_UNORM, false, false },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC5_SNORM, false, false },
+        // No legacy FourCC, so the DX10 header is always written.
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC1_UNORM_SRGB, false, true },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC3_UNORM_SRGB, false, true },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC6H_UF16, false, true },
+        { DDS_PIXELS_BLOCK, DXGI_FORMAT_BC7_UNORM, false, true },
+        { DDS_PIXELS_RGBA32, DXGI_FORMAT_UNKNOWN, false, false },
+        { DDS_PIXELS_RGBA32, DXGI_FORMAT_UNKNOWN, true, true },
+        { DDS_PIXELS_RGBX32, DXGI_FORMAT_UNKNOWN, false, false },
+        { DDS_PIXELS_BGRA32, DXGI_FORMAT_UNKNOWN, false, false },
+        { DDS_PIXELS_BGRA32, DXGI_FORMAT_UNKNOWN, true, true },
+        { DDS_PIXELS_BGRX32, DXGI_FORMAT_UNKNOWN, true, true },
+        // DXGI cannot name 24-bit layouts, so they never get the DX10 header.
+        { DDS_PIXELS_RGB24, DXGI_FORMAT_UNKNOWN, true, false },
+        { DDS_PIXELS_BGR24, DXGI_FORMAT_UNKNOWN, false, false },
+    };
+
+    void FillPattern(std::vector<uint8_t>& data, uint32_t seed)
+    {
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = (uint8_t)(i * 31 + seed * 7 + (i >> 8));
+    }
+
+    // Writes desc filled with a pattern and opens it; data gets the pattern.
+    bool WriteAndOpen(const char* name, const DdsWriteDesc& desc, std::vector<uint8_t>& data, DdsView& view)
+    {
+        data.resize(DdsGetDataSize(desc));
+        FillPattern(data, desc.width + desc.arraySize);
+        const std::string path = GetScratchPath(name);
+        return WriteDds(path.c_str(), desc, data.data(), data.size()) && view.Open(path.c_str());
+    }
+
+    // Every span lies back to back over data, slice-major, with the mip
+    // chain's sizes.
+    bool SpansCover(const DdsView& view, const std::vector<uint8_t>& data)
+    {
+        size_t offset = 0;
+        for (uint32_t slice = 0; slice < view.GetArraySize(); ++slice)
+        {
+            uint32_t width = view.GetWidth();
+            uint32_t height = view.GetHeight();
+            for (uint32_t level = 0; level < view.GetMipCount(); ++level)
+            {
+                const DdsMipSpan& mip = view.GetMip(slice, level);
+                if (mip.width != width || mip.height != height || offset + mip.size > data.size() ||
+                    memcmp(mip.pData, data.data() + offset, mip.size) != 0)
+                    return false;
+                offset += mip.size;
+                width = width > 1 ? width / 2 : 1;
+                height = height > 1 ? height / 2 : 1;
+            }
+        }
+        return offset == data.size();
+    }
+
+    // A valid 2D BC1 fixture with four mips, as raw bytes to damage.
+    bool MakeGoodFile(std::vector<uint8_t>& bytes)
+    {
+        DdsWriteDesc desc;
+        desc.format = DXGI_FORMAT_BC1_UNORM;
+        desc.width = 64;
+        desc.height = 32;
+        desc.mipCount = 4;
+        std::vector<uint8_t> data(DdsGetDataSize(desc));
+        FillPattern(data, 1);
+        const std::string path = GetScratchPath("dds_good.dds");
+        return WriteDds(path.c_str(), desc, data.data(), data.size()) && ReadTestFile(path, bytes);
+    }
+
+    void Patch32(std::vector<uint8_t>& bytes, size_t offset, uint32_t value)
+    {
+        memcpy(bytes.data() + offset, &value, sizeof(value));
+    }
+
+    bool OpensDamaged(const std::vector<uint8_t>& bytes)
+    {
+        const std::string path = GetScratchPath("dds_damaged.dds");
+        DdsView view;
+        return WriteTestFile(path, bytes) && view.Open(path.c_str());
+    }
+
+    const size_t HEADER = sizeof(uint32_t);
+    const size_t DX10_HEADER = HEADER + sizeof(DDS_HEADER);
+}
+
+TEST_CASE(DdsRoundTripsEveryFormatAndLayout)
+{
+    for (const FormatCase& c : FORMAT_CASES)
+    {
+        DdsWriteDesc desc;
+        desc.layout = c.layout;
+        desc.format = c.format;
+        desc.width = 13;       // not whole blocks, and odd all the way down
+        desc.height = 7;
+        desc.mipCount = 4;
+        desc.dx10Header = c.dx10Header;
+
+        std::vector<uint8_t> data;
+        DdsView view;
+        if (!CHECK(WriteAndOpen("dds_format.dds", desc, data, view)))
+            continue;
+        CHECK(view.GetPixelLayout() == c.layout);
+        CHECK(view.GetFormat() == (c.layout == DDS_PIXELS_BLOCK ? c.format : DXGI_FORMAT_R8G8B8A8_UNORM));
+        CHECK(view.HasDx10Header() == c.expectDx10);
+        CHECK(view.GetWidth() == 13 && view.GetHeight() == 7 && view.GetMipCount() == 4);
+        CHECK(view.GetArraySize() == 1 && !view.IsCubemap());
+        CHECK(SpansCover(view, data));
+    }
+}
+
+TEST_CASE(DdsReadsCubemapsAndArrays)
+{
+    struct ShapeCase
+    {
+        uint32_t arraySize;
+        bool cubemap;
+        bool dx10Header;
+        uint32_t slices;
+    };
+    const ShapeCase cases[] = {
+        { 1, true, false, 6 },      // legacy DDSCAPS2_CUBEMAP
+        { 1, true, true, 6 },
+        { 2, true, true, 12 },      // cube array: the header counts cubes
+        { 3, false, true, 3 },
+    };
+
+    for (const ShapeCase& c : cases)
+    {
+        DdsWriteDesc desc;
+        desc.format = DXGI_FORMAT_BC3_UNORM;
+        desc.width = 32;
+        desc.height = 32;
+        desc.mipCount = 6;
+        desc.arraySize = c.arraySize;
+        desc.cubemap = c.cubemap;
+        desc.dx10Header = c.dx10Header;
+
+        std::vector<uint8_t> data;
+        DdsView view;
+        if (!CHECK(WriteAndOpen("dds_shape.dds", desc, data, view)))
+            continue;
+        CHECK(view.GetArraySize() == c.slices);
+        CHECK(view.IsCubemap() == c.cubemap);
+        CHECK(view.HasDx10Header() == c.dx10Header);
+        CHECK(SpansCover(view, data));
+    }
+}
+
+TEST_CASE(DdsWriteSlicesPacksTheSkyboxFaces)
+{
+    const char* faceNames[6] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+    DdsView faces[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        if (!CHECK(faces[i].Open((GetTextureDir() + "skybox/" + faceNames[i] + ".dds").c_str())))
+            return;
+    }
+
+    for (int dx10 = 0; dx10 < 2; ++dx10)
+    {
+        const std::string path = GetScratchPath("dds_skybox.dds");
+        if (!CHECK(WriteDdsSlices(path.c_str(), faces, 6, true, dx10 != 0)))
+            return;
+
+        DdsView cube;
+        if (!CHECK(cube.Open(path.c_str())))
+            return;
+        CHECK(cube.IsCubemap() && cube.GetArraySize() == 6);
+        CHECK(cube.HasDx10Header() == (dx10 != 0));
+        CHECK(cube.GetFormat() == faces[0].GetFormat() && cube.GetMipCount() == faces[0].GetMipCount());
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t level = 0; level < cube.GetMipCount(); ++level)
+            {
+                const DdsMipSpan& a = cube.GetMip(face, level);
+                const DdsMipSpan& b = faces[face].GetMip(level);
+                CHECK(a.size == b.size && memcmp(a.pData, b.pData, a.size) == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE(DdsSpansMatchWhatLoadDdsCopies)
+{
+    // TextureLoader::LoadDDS() hands out CopyDdsMipChains() of the view;
+    // the spans the zero-copy path uploads from have to be those bytes,
+    // which are the file's texel data after the header.
+    const char* names[7] = { "wood02", "skybox/posx", "skybox/negx", "skybox/posy", "skybox/negy", "skybox/posz",
+        "skybox/negz" };
+    for (const char* name : names)
+    {
+        const std::string path = GetTextureDir() + name + ".dds";
+        DdsView view;
+        std::vector<uint8_t> file;
+        if (!CHECK(view.Open(path.c_str())) || !CHECK(ReadTestFile(path, file)))
+            continue;
+        CHECK(view.GetPixelLayout() == DDS_PIXELS_BLOCK);
+
+        std::vector<uint8_t> copy(GetDdsMipChainsSize(view, 0));
+        if (!CHECK(CopyDdsMipChains(view, 0, copy.data())))
+            continue;
+        CHECK(SpansCover(view, copy));
+
+        const size_t header = DX10_HEADER + (view.HasDx10Header() ? sizeof(DDS_HEADER_DXT10) : 0);
+        CHECK(view.GetMip(0).pData == view.GetMappedData() + header);
+        CHECK(file.size() == header + copy.size() && memcmp(file.data() + header, copy.data(), copy.size()) == 0);
+    }
+}
+
+TEST_CASE(DdsRejectsDamagedHeaders)
+{
+    std::vector<uint8_t> good;
+    if (!CHECK(MakeGoodFile(good)) || !CHECK(OpensDamaged(good)))
+        return;
+
+    std::vector<uint8_t> bytes = good;
+    Patch32(bytes, 0, 0x12345678);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, dwSize), 100);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, dwWidth), 0);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, dwHeight), 1u << 24);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, dwMipMapCount), 40);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, dwFourCC),
+        MAKEFOURCC('A', 'B', 'C', 'D'));
+    CHECK(!OpensDamaged(bytes));
+
+    // Only +X and -X present.
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, dwCubemapFlags), DDS_CUBEMAP | 0x00000600);
+    CHECK(!OpensDamaged(bytes));
+
+    // Claims six faces but holds one.
+    bytes = good;
+    Patch32(bytes, HEADER + offsetof(DDS_HEADER, dwCubemapFlags), DDS_CUBEMAP | DDS_CUBEMAP_ALLFACES);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    bytes.pop_back();
+    CHECK(!OpensDamaged(bytes));
+
+    bytes.assign(good.begin(), good.begin() + DX10_HEADER - 1);
+    CHECK(!OpensDamaged(bytes));
+
+    // DX10 files: a 1D texture, no slices, and more slices than the file holds.
+    DdsWriteDesc desc;
+    desc.format = DXGI_FORMAT_BC7_UNORM;
+    desc.width = 16;
+    desc.height = 16;
+    std::vector<uint8_t> data;
+    DdsView view;
+    if (!CHECK(WriteAndOpen("dds_dx10.dds", desc, data, view)) ||
+        !CHECK(ReadTestFile(GetScratchPath("dds_dx10.dds"), good)))
+        return;
+    view.Close();
+
+    bytes = good;
+    Patch32(bytes, DX10_HEADER + offsetof(DDS_HEADER_DXT10, resourceDimension), 2);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, DX10_HEADER + offsetof(DDS_HEADER_DXT10, arraySize), 0);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, DX10_HEADER + offsetof(DDS_HEADER_DXT10, arraySize), 0x40000000);
+    CHECK(!OpensDamaged(bytes));
+
+    bytes = good;
+    Patch32(bytes, DX10_HEADER + offsetof(DDS_HEADER_DXT10, miscFlag), DDS_RESOURCE_MISC_TEXTURECUBE);
+    Patch32(bytes, DX10_HEADER + offsetof(DDS_HEADER_DXT10, arraySize), 0x7fffffff);
+    CHECK(!OpensDamaged(bytes));
+
+    DdsView missing;
+    CHECK(!missing.Open(GetScratchPath("dds_missing.dds").c_str()));
+}
@@ -0,0 +1,218 @@
+#include "Test.h"
+#include "FrameArena.h"
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    bool IsAligned(const void* p, size_t alignment)
+    {
+        return (uintptr_t)p % alignment == 0;
+    }
+
+    // Fills an allocation with a value derived from its frame and index, so
+    // a later check can tell whether anything wrote over it.
+    struct Stamp
+    {
+        uint8_t* p;
+        size_t size;
+        uint8_t value;
+    };
+
+    bool IsIntact(const Stamp& stamp)
+    {
+        for (size_t i = 0; i < stamp.size; ++i)
+        {
+            if (stamp.p[i] != stamp.value)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST_CASE(FrameArenaAlignsAllocations)
+{
+    FrameArena arena(2, 4096);
+    arena.BeginFrame();
+
+    const size_t alignments[] = { 1, 2, 4, 8, 16, 64, 256 };
+    for (size_t alignment : alignments)
+    {
+        // An odd size first, so the head is never already aligned.
+        CHECK(arena.Allocate(3, 1) != nullptr);
+        void* p = arena.Allocate(24, alignment);
+        CHECK(p != nullptr && IsAligned(p, alignment));
+    }
+    CHECK(IsAligned(arena.Allocate(5), alignof(std::max_align_t)));
+    CHECK(IsAligned(arena.AllocateArray<double>(3), alignof(double)));
+
+    CHECK(arena.Allocate(16, 0) == nullptr);
+    CHECK(arena.Allocate(16, 3) == nullptr);
+    CHECK(arena.AllocateArray<uint64_t>(std::numeric_limits<size_t>::max() / 4) == nullptr);
+
+    const FrameArenaStats stats = arena.GetStats();
+    CHECK(stats.allocations == 16);
+    CHECK(stats.overflows == 0);
+    CHECK(stats.capacity == 4096);
+}
+
+TEST_CASE(FrameArenaOverflowsThenRegrows)
+{
+    FrameArena arena(2, 1024);
+    uint64_t heapAfterWarmup = 0;
+    for (uint32_t frame = 0; frame < 6; ++frame)
+    {
+        arena.BeginFrame();
+        bool allocated = true;
+        for (uint32_t i = 0; i < 40; ++i)
+            allocated = arena.Allocate(100, 4) != nullptr && allocated;
+        CHECK(allocated);
+
+        const FrameArenaStats stats = arena.GetStats();
+        CHECK(stats.bytes >= 4000);
+        if (frame == 0)
+        {
+            // The first block meets the load at its initial size.
+            CHECK(stats.capacity == 1024);
+            CHECK(stats.overflows > 0);
+        }
+        else
+        {
+            // Every block after that is grown to the busiest frame before
+            // it is used, and then stays put.
+            CHECK(stats.capacity >= stats.largestFrame);
+            CHECK(stats.overflows == 0);
+        }
+        if (frame == 2)
+            heapAfterWarmup = stats.heapAllocations;
+        if (frame > 2)
+            CHECK(stats.heapAllocations == heapAfterWarmup);
+    }
+
+    // A huge request overflows without touching the block.
+    arena.BeginFrame();
+    const size_t capacity = (size_t)arena.GetStats().capacity;
+    CHECK(arena.Allocate(capacity + 1) != nullptr);
+    CHECK(arena.GetStats().overflows == 1);
+    CHECK(arena.Allocate(std::numeric_limits<size_t>::max() - 8, 16) == nullptr);
+}
+
+TEST_CASE(FrameArenaKeepsRecentFramesValid)
+{
+    // Small blocks so some frames overflow; overflow memory has to live as
+    // long as block memory.
+    const uint32_t frameCount = 3;
+    FrameArena arena(frameCount, 512);
+    std::vector<Stamp> frames[frameCount];
+    uint32_t state = 7;
+    bool intact = true;
+    for (uint32_t frame = 0; frame < 30; ++frame)
+    {
+        arena.BeginFrame();
+        std::vector<Stamp>& stamps = frames[frame % frameCount];
+        stamps.clear();
+
+        state = state * 1664525u + 1013904223u;
+        const uint32_t count = 1 + (state >> 8) % 20;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            state = state * 1664525u + 1013904223u;
+            Stamp stamp;
+            stamp.size = 1 + (state >> 8) % 200;
+            stamp.value = (uint8_t)(frame * 31 + i);
+            stamp.p = (uint8_t*)arena.Allocate(stamp.size, 1);
+            if (!CHECK(stamp.p != nullptr))
+                return;
+            memset(stamp.p, stamp.value, stamp.size);
+            stamps.push_back(stamp);
+        }
+
+        // This frame and the frameCount - 1 before it are untouched.
+        for (const std::vector<Stamp>& previous : frames)
+        {
+            for (const Stamp& stamp : previous)
+                intact = intact && IsIntact(stamp);
+        }
+    }
+    CHECK(intact);
+}
+
+TEST_CASE(FrameArenaAllocatesFromManyThreads)
+{
+    FrameArena arena(2, 256 * 1024);
+    const uint32_t threadCount = 8;
+    const uint32_t perThread = 2000;
+
+    for (uint32_t frame = 0; frame < 3; ++frame)
+    {
+        arena.BeginFrame();
+        std::vector<std::vector<Stamp>> stamps(threadCount);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&arena, &stamps, t, perThread]()
+            {
+                for (uint32_t i = 0; i < perThread; ++i)
+                {
+                    // Enough in total that the first frame overflows.
+                    Stamp stamp;
+                    stamp.size = 8 + (i % 5) * 8;
+                    stamp.value = (uint8_t)(t * 17 + i);
+                    stamp.p = (uint8_t*)arena.Allocate(stamp.size, 8);
+                    if (!stamp.p)
+                        continue;
+                    memset(stamp.p, stamp.value, stamp.size);
+                    stamps[t].push_back(stamp);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        bool intact = true;
+        size_t count = 0;
+        for (const std::vector<Stamp>& threadStamps : stamps)
+        {
+            count += threadStamps.size();
+            for (const Stamp& stamp : threadStamps)
+                intact = intact && IsIntact(stamp) && IsAligned(stamp.p, 8);
+        }
+        CHECK(intact);
+        CHECK(count == threadCount * perThread);
+        CHECK(arena.GetStats().allocations == threadCount * perThread);
+    }
+    CHECK(arena.GetStats().overflows == 0);
+}
+
+TEST_CASE(FrameArenaBacksStandardContainers)
+{
+    FrameArena arena(2, 64 * 1024);
+    arena.BeginFrame();
+
+    FrameVector<uint32_t> values{ FrameAllocator<uint32_t>(&arena) };
+    for (uint32_t i = 0; i < 1000; ++i)
+        values.push_back(i * 3);
+    bool ordered = true;
+    for (uint32_t i = 0; i < 1000; ++i)
+        ordered = ordered && values[i] == i * 3;
+    CHECK(ordered);
+
+    const FrameArenaStats stats = arena.GetStats();
+    CHECK(stats.allocations > 0 && stats.overflows == 0);
+    CHECK(stats.bytes >= 1000 * sizeof(uint32_t));
+
+    // Rebound allocators share the arena; the default one is the heap.
+    FrameAllocator<double> rebound(values.get_allocator());
+    CHECK(rebound.GetArena() == &arena);
+    CHECK(rebound == values.get_allocator());
+    CHECK(FrameAllocator<double>() != rebound);
+
+    FrameVector<uint32_t> heap;
+    heap.assign(100, 5);
+    CHECK(heap.size() == 100 && heap[99] == 5);
+    CHECK(arena.GetStats().allocations == stats.allocations);
+
+    // Moving takes the arena along with the elements.
+    FrameVector<uint32_t> moved(std::move(values));
+    CHECK(moved.get_allocator().GetArena() == &arena && moved.size() == 1000);
+}
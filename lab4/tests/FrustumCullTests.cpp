@@ -0,0 +1,168 @@
+#include "Test.h"
+#include "FrustumCull.h"
+#include <cmath>
+
+namespace
+{
+    const TransformKernel KERNELS[] = { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX2 };
+
+    // None of them a whole number of AVX2 steps past the first.
+    const size_t COUNTS[] = { 0, 1, 3, 7, 9, 15, 17, 31, 100, 1001 };
+
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Spheres within 60 units of the origin, up to 4 across, so a good
+    // share of them straddle a plane.
+    void MakeSpheres(size_t count, uint32_t seed, BoundingSpheres& spheres)
+    {
+        spheres.Resize(count);
+        uint32_t state = seed;
+        for (size_t i = 0; i < count; ++i)
+        {
+            spheres.x[i] = Random(state) * 120.0f - 60.0f;
+            spheres.y[i] = Random(state) * 120.0f - 60.0f;
+            spheres.z[i] = Random(state) * 120.0f - 60.0f;
+            spheres.radius[i] = Random(state) * 4.0f;
+        }
+    }
+
+    // A few cameras at the origin and off to the side, looking different
+    // ways.
+    FrustumPlanes MakePlanes(int view)
+    {
+        const float eyes[3][3] = { { 0.0f, 0.0f, -10.0f }, { 30.0f, 5.0f, 0.0f }, { -5.0f, 40.0f, 20.0f } };
+        const float ats[3][3] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 10.0f }, { 0.0f, 0.0f, 0.0f } };
+        const float up[3] = { 0.0f, 1.0f, 0.0f };
+        const Float4x4 proj = MatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.5f, 80.0f);
+        return ExtractFrustumPlanes(MatrixMultiply(MatrixLookAtLH(eyes[view], ats[view], up), proj));
+    }
+
+    // What CullSpheres() has to return, one sphere at a time.
+    std::vector<uint32_t> Expected(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t first,
+        size_t count)
+    {
+        std::vector<uint32_t> visible;
+        for (size_t i = first; i < first + count; ++i)
+        {
+            if (IsSphereInFrustum(planes, spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+                visible.push_back((uint32_t)i);
+        }
+        return visible;
+    }
+
+    std::vector<uint32_t> Cull(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t first,
+        size_t count, TransformKernel kernel)
+    {
+        // Room for one more, which must come back untouched.
+        std::vector<uint32_t> visible(count + 1, 0xcdcdcdcd);
+        const size_t kept = CullSphereRange(planes, spheres, first, count, visible.data(), kernel);
+        if (visible[count] != 0xcdcdcdcd)
+            return std::vector<uint32_t>(1, 0xcdcdcdcd);
+        visible.resize(kept);
+        return visible;
+    }
+}
+
+TEST_CASE(FrustumCullKernelsMatchScalar)
+{
+    for (int view = 0; view < 3; ++view)
+    {
+        const FrustumPlanes planes = MakePlanes(view);
+        for (size_t count : COUNTS)
+        {
+            BoundingSpheres spheres;
+            MakeSpheres(count, (uint32_t)(count * 3 + view), spheres);
+            const std::vector<uint32_t> expected = Expected(planes, spheres, 0, count);
+            for (TransformKernel kernel : KERNELS)
+            {
+                if (!IsTransformKernelSupported(kernel))
+                    continue;
+                CHECK(Cull(planes, spheres, 0, count, kernel) == expected);
+
+                std::vector<uint32_t> visible(count + 1);
+                CHECK(CullSpheres(planes, spheres, visible.data(), kernel) == expected.size());
+                visible.resize(expected.size());
+                CHECK(visible == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE(FrustumCullRangesMatchTheWholeList)
+{
+    // Ranges starting off any vector boundary, the way culling is split
+    // across threads; their lists joined are the whole one.
+    const FrustumPlanes planes = MakePlanes(0);
+    BoundingSpheres spheres;
+    MakeSpheres(1001, 99, spheres);
+    const size_t splits[] = { 0, 3, 13, 64, 65, 500, 997, 1001 };
+    for (TransformKernel kernel : KERNELS)
+    {
+        if (!IsTransformKernelSupported(kernel))
+            continue;
+        std::vector<uint32_t> joined;
+        for (size_t s = 0; s + 1 < sizeof(splits) / sizeof(splits[0]); ++s)
+        {
+            const size_t first = splits[s], count = splits[s + 1] - splits[s];
+            const std::vector<uint32_t> range = Cull(planes, spheres, first, count, kernel);
+            CHECK(range == Expected(planes, spheres, first, count));
+            joined.insert(joined.end(), range.begin(), range.end());
+        }
+        CHECK(joined == Expected(planes, spheres, 0, spheres.Size()));
+    }
+}
+
+TEST_CASE(FrustumCullKeepsSpheresTouchingAPlane)
+{
+    // Spheres centred just outside the left plane: those reaching back
+    // across it are kept by every kernel, those 1% short of it dropped.
+    const FrustumPlanes planes = MakePlanes(0);
+    const size_t count = 21;
+    BoundingSpheres spheres;
+    spheres.Resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        // A point on the plane well inside the others: the view axis
+        // from depth 20 on, pushed sideways onto the left plane.
+        const float depth = 20.0f + (float)i;
+        const float t = planes.a[0] * 0.0f + planes.b[0] * 0.0f + planes.c[0] * depth + planes.d[0];
+        const float px = -t * planes.a[0], py = -t * planes.b[0], pz = depth - t * planes.c[0];
+        const float radius = 0.5f + (float)(i % 4);
+        const float gap = i % 2 ? radius * 1.01f : radius * 0.99f;
+        spheres.x[i] = px - planes.a[0] * gap;
+        spheres.y[i] = py - planes.b[0] * gap;
+        spheres.z[i] = pz - planes.c[0] * gap;
+        spheres.radius[i] = radius;
+    }
+
+    const std::vector<uint32_t> expected = Expected(planes, spheres, 0, count);
+    bool keepsTouching = true;
+    for (uint32_t index : expected)
+        keepsTouching = keepsTouching && index % 2 == 0;
+    CHECK(keepsTouching && expected.size() == (count + 1) / 2);
+    for (TransformKernel kernel : KERNELS)
+    {
+        if (IsTransformKernelSupported(kernel))
+            CHECK(Cull(planes, spheres, 0, count, kernel) == expected);
+    }
+}
+
+TEST_CASE(FrustumCullBoundsEveryObject)
+{
+    // Sphere radius follows the largest scale axis, whatever its sign.
+    SceneTransforms scene;
+    scene.Resize(3);
+    scene.SetPosition(0, 1.0f, 2.0f, 3.0f);
+    scene.SetScale(0, 2.0f);
+    scene.SetScale(1, 0.5f, -3.0f, 1.0f);
+    scene.SetScale(2, 0.0f);
+    BoundingSpheres spheres;
+    ComputeBoundingSpheres(scene, 0.75f, spheres);
+    CHECK(spheres.Size() == 3);
+    CHECK(spheres.x[0] == 1.0f && spheres.y[0] == 2.0f && spheres.z[0] == 3.0f);
+    CHECK(spheres.radius[0] == 1.5f && spheres.radius[1] == 2.25f && spheres.radius[2] == 0.0f);
+}
@@ -0,0 +1,29 @@
+#include "LabCommands.h"
+#include <cstdio>
+
+// lab4_headless: lab4.exe --headless on the CPU backends, without a window
+// or D3D11. Takes lab4.exe's --headless options; --backend is cpu unless
+// given as software. --texture-dir DIR reads the lab4 textures from DIR
+// instead of the source tree.
+int main(int argc, char** argv)
+{
+    LabCommandLine commandLine;
+    commandLine.args.push_back("--headless");
+    commandLine.args.insert(commandLine.args.end(), argv + 1, argv + argc);
+    if (!commandLine.GetValue("--backend"))
+    {
+        commandLine.args.push_back("--backend");
+        commandLine.args.push_back("cpu");
+    }
+    commandLine.textureDir = LAB4_TEXTURE_DIR;
+    if (const char* pDir = commandLine.GetValue("--texture-dir"))
+        commandLine.textureDir = std::string(pDir) + "/";
+
+    const int result = RunLabCommand(commandLine);
+    if (result == LAB_COMMAND_NONE)
+    {
+        fprintf(stderr, "lab4_headless: only the cpu and software backends run without D3D11\n");
+        return -1;
+    }
+    return result;
+}
@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "DdsView.h"
+#include "Hash.h"
+#include "HeadlessRunner.h"
+#include "ReferenceRenderer.h"
+#include <cstdio>
+
+namespace
+{
+    const uint32_t WIDTH = 96;
+    const uint32_t HEIGHT = 64;
+
+    bool OpenLabTextures(DdsView& texture, DdsView faces[6])
+    {
+        const char* const faceNames[6] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+        bool opened = texture.Open((GetTextureDir() + "wood02.dds").c_str());
+        for (int i = 0; i < 6; ++i)
+            opened = faces[i].Open((GetTextureDir() + "skybox/" + faceNames[i] + ".dds").c_str()) && opened;
+        return opened;
+    }
+
+    // Runs options.frameCount frames of the orbit on the reference renderer
+    // and hashes the last one.
+    bool RunReference(const HeadlessOptions& options, std::vector<FrameTiming>& timings, uint64_t& lastFrameHash)
+    {
+        DdsView texture;
+        DdsView faces[6];
+        ReferenceRenderer renderer;
+        if (!OpenLabTextures(texture, faces) || !renderer.Initialize(WIDTH, HEIGHT) ||
+            !renderer.LoadTextures(texture, faces))
+        {
+            return false;
+        }
+
+        LabScene scene;
+        scene.SetCubeCount(9);
+        const CameraPath path = CameraPath::MakeOrbit((float)options.frameCount * options.frameTime);
+        std::vector<uint8_t> pixels;
+        if (!RunHeadless(scene, renderer, path, options, timings) || !renderer.ReadPixels(pixels) ||
+            pixels.size() != WIDTH * HEIGHT * 4)
+        {
+            return false;
+        }
+        lastFrameHash = HashBytes(pixels.data(), pixels.size());
+        return true;
+    }
+
+    std::string GetDumpPath(const std::string& prefix, uint32_t frame)
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "_frame%04u.bmp", frame);
+        return prefix + suffix;
+    }
+}
+
+TEST_CASE(HeadlessRunnerTimesAndDumpsEveryFrame)
+{
+    HeadlessOptions options;
+    options.frameCount = 6;
+    options.dumpInterval = 2;
+    options.outputPrefix = GetScratchPath("headless_times");
+    for (uint32_t frame = 0; frame < options.frameCount; ++frame)
+        remove(GetDumpPath(options.outputPrefix, frame).c_str());
+
+    std::vector<FrameTiming> timings;
+    uint64_t hash = 0;
+    if (!CHECK(RunReference(options, timings, hash)))
+        return;
+
+    // One row per frame at the fixed step; only every second frame dumped.
+    CHECK(timings.size() == options.frameCount);
+    bool rows = true;
+    for (uint32_t i = 0; i < timings.size(); ++i)
+    {
+        const FrameTiming& t = timings[i];
+        const bool dumped = i % options.dumpInterval == 0;
+        rows = rows && t.frame == i && t.sceneTime == (double)i * options.frameTime && t.renderMs >= 0.0 &&
+            (dumped ? t.dumpMs >= 0.0 : t.dumpMs == 0.0);
+
+        std::vector<uint8_t> bmp;
+        const bool exists = ReadTestFile(GetDumpPath(options.outputPrefix, i), bmp);
+        rows = rows && exists == dumped && (!dumped || bmp.size() >= WIDTH * HEIGHT * 4);
+    }
+    CHECK(rows);
+
+    const std::string csvPath = GetScratchPath("headless_timings.csv");
+    CHECK(WriteFrameTimingsCsv(csvPath.c_str(), "cpu", timings));
+    std::vector<uint8_t> csv;
+    if (!CHECK(ReadTestFile(csvPath, csv)))
+        return;
+    const std::string text(csv.begin(), csv.end());
+    uint32_t lines = 0;
+    uint32_t cpuRows = 0;
+    for (size_t start = 0; start < text.size(); )
+    {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos)
+            end = text.size();
+        ++lines;
+        cpuRows += text.compare(start, 4, "cpu,") == 0 ? 1 : 0;
+        start = end + 1;
+    }
+    CHECK(text.compare(0, 14, "backend,frame,") == 0);
+    CHECK(lines == 1 + options.frameCount && cpuRows == options.frameCount);
+}
+
+TEST_CASE(HeadlessFramesAreDeterministic)
+{
+    // Fixed time step and scripted camera: two runs draw the same pixels,
+    // down to the dumped files, and the camera does move between frames.
+    HeadlessOptions options;
+    options.frameCount = 5;
+    options.dumpInterval = 4;
+    std::vector<FrameTiming> timings;
+
+    uint64_t hashes[2] = {};
+    std::vector<uint8_t> dumps[2][2];
+    for (int run = 0; run < 2; ++run)
+    {
+        options.outputPrefix = GetScratchPath(run == 0 ? "headless_run0" : "headless_run1");
+        if (!CHECK(RunReference(options, timings, hashes[run])))
+            return;
+        CHECK(ReadTestFile(GetDumpPath(options.outputPrefix, 0), dumps[run][0]));
+        CHECK(ReadTestFile(GetDumpPath(options.outputPrefix, 4), dumps[run][1]));
+    }
+    CHECK(hashes[0] == hashes[1]);
+    CHECK(!dumps[0][0].empty() && dumps[0][0] == dumps[1][0]);
+    CHECK(!dumps[0][1].empty() && dumps[0][1] == dumps[1][1]);
+    CHECK(dumps[0][0] != dumps[0][1]);
+
+    options.frameCount = 1;
+    options.dumpInterval = 0;
+    uint64_t firstFrame = 0;
+    CHECK(RunReference(options, timings, firstFrame) && firstFrame != hashes[0]);
+}
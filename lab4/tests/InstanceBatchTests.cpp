@@ -0,0 +1,178 @@
+#include "Test.h"
+#include "InstanceBatch.h"
+#include "JobSystem.h"
+#include "SceneMath.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const TransformKernel KERNELS[] = { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX2 };
+
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Objects in material runs of uneven length, including a run of one.
+    void MakeScene(size_t count, uint32_t seed, SceneTransforms& scene)
+    {
+        scene.Resize(count);
+        uint32_t state = seed;
+        uint32_t material = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i == 1 || i == 2 || Random(state) < 0.05f)
+                ++material;
+            scene.SetPosition(i, Random(state) * 100.0f - 50.0f, Random(state) * 10.0f, Random(state) * 100.0f);
+            const float qx = Random(state) - 0.5f, qy = Random(state) - 0.5f;
+            const float qz = Random(state) - 0.5f, qw = Random(state) - 0.5f;
+            const float length = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+            scene.SetRotation(i, qx / length, qy / length, qz / length, qw / length);
+            scene.SetScale(i, 0.5f + Random(state), 0.5f + Random(state), 0.5f + Random(state));
+            scene.SetTint(i, Random(state), Random(state), Random(state), 0.5f);
+            scene.material[i] = material;
+        }
+    }
+
+    // Object i's world matrix, Scale * Rotation * Translation, with the
+    // rotation rows the basis vectors turned by the quaternion.
+    Float4x4 GetWorldMatrix(const SceneTransforms& scene, size_t i)
+    {
+        const float u[3] = { scene.rotX[i], scene.rotY[i], scene.rotZ[i] };
+        const float w = scene.rotW[i];
+        Float4x4 rotation = MatrixIdentity();
+        for (int r = 0; r < 3; ++r)
+        {
+            // v + 2w (u x v) + 2 u x (u x v), for v the r-th basis vector.
+            float v[3] = { 0.0f, 0.0f, 0.0f };
+            v[r] = 1.0f;
+            const float c[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+            const float cc[3] = { u[1] * c[2] - u[2] * c[1], u[2] * c[0] - u[0] * c[2], u[0] * c[1] - u[1] * c[0] };
+            for (int k = 0; k < 3; ++k)
+                rotation.m[r][k] = v[k] + 2.0f * w * c[k] + 2.0f * cc[k];
+        }
+
+        Float4x4 scale = MatrixIdentity();
+        scale.m[0][0] = scene.scaleX[i];
+        scale.m[1][1] = scene.scaleY[i];
+        scale.m[2][2] = scene.scaleZ[i];
+        Float4x4 translation = MatrixIdentity();
+        translation.m[3][0] = scene.posX[i];
+        translation.m[3][1] = scene.posY[i];
+        translation.m[3][2] = scene.posZ[i];
+        return MatrixMultiply(MatrixMultiply(scale, rotation), translation);
+    }
+
+    // The record holds the transposed 3x4 of the object's matrix and its
+    // tint.
+    bool MatchesObject(const InstanceData& record, const SceneTransforms& scene, size_t i)
+    {
+        const Float4x4 world = GetWorldMatrix(scene, i);
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                if (std::fabs(record.world[r][c] - world.m[c][r]) > 1e-5f * (1.0f + std::fabs(world.m[c][r])))
+                    return false;
+            }
+        }
+        return record.tint[0] == scene.tintR[i] && record.tint[1] == scene.tintG[i] &&
+            record.tint[2] == scene.tintB[i] && record.tint[3] == scene.tintA[i];
+    }
+
+    // Batches cover [0, count) in order, one per material run of the
+    // objects the instances came from.
+    bool BatchesCoverRuns(const InstanceBatcher& batcher, const SceneTransforms& scene, const uint32_t* pIndices,
+        size_t count)
+    {
+        uint32_t next = 0;
+        for (size_t b = 0; b < batcher.GetBatches().size(); ++b)
+        {
+            const InstanceBatch& batch = batcher.GetBatches()[b];
+            if (batch.firstInstance != next || batch.instanceCount == 0)
+                return false;
+            for (uint32_t n = batch.firstInstance; n < batch.firstInstance + batch.instanceCount; ++n)
+            {
+                if (scene.material[pIndices ? pIndices[n] : n] != batch.material)
+                    return false;
+            }
+            if (b > 0 && batcher.GetBatches()[b - 1].material == batch.material)
+                return false;
+            next += batch.instanceCount;
+        }
+        return next == count && batcher.GetInstanceCount() == count &&
+            batcher.GetDataSize() == count * sizeof(InstanceData);
+    }
+}
+
+TEST_CASE(InstanceBatchMatchesObjectMatrices)
+{
+    const size_t counts[] = { 0, 1, 9, 1001 };
+    for (size_t count : counts)
+    {
+        SceneTransforms scene;
+        MakeScene(count, (uint32_t)count + 1, scene);
+        for (TransformKernel kernel : KERNELS)
+        {
+            if (!IsTransformKernelSupported(kernel))
+                continue;
+            InstanceBatcher batcher;
+            batcher.Build(scene, kernel);
+            bool matches = true;
+            for (size_t i = 0; i < count; ++i)
+                matches = matches && MatchesObject(batcher.GetData()[i], scene, i);
+            CHECK(matches);
+            CHECK(BatchesCoverRuns(batcher, scene, nullptr, count));
+        }
+    }
+}
+
+TEST_CASE(InstanceBatchBuildsVisibleLists)
+{
+    // A visible list the way culling leaves one: ascending, with gaps that
+    // skip whole runs and split others.
+    SceneTransforms scene;
+    MakeScene(20001, 3, scene);
+    std::vector<uint32_t> visible;
+    uint32_t state = 5;
+    for (uint32_t i = 0; i < scene.Size(); ++i)
+    {
+        if (Random(state) < 0.6f)
+            visible.push_back(i);
+    }
+
+    InstanceBatcher whole;
+    whole.Build(scene, TRANSFORM_KERNEL_SCALAR);
+    JobSystem jobs(3);
+    for (TransformKernel kernel : KERNELS)
+    {
+        if (!IsTransformKernelSupported(kernel))
+            continue;
+        for (int parallel = 0; parallel < 2; ++parallel)
+        {
+            InstanceBatcher batcher;
+            batcher.Build(scene, visible.data(), visible.size(), kernel, parallel ? &jobs : nullptr);
+            CHECK(BatchesCoverRuns(batcher, scene, visible.data(), visible.size()));
+
+            // Instance n is exactly object visible[n]'s record, and that is
+            // the object's matrix.
+            bool matches = true;
+            for (size_t n = 0; n < visible.size(); ++n)
+            {
+                matches = matches && memcmp(&batcher.GetData()[n], &whole.GetData()[visible[n]],
+                    sizeof(InstanceData)) == 0;
+                matches = matches && (n % 97 != 0 || MatchesObject(batcher.GetData()[n], scene, visible[n]));
+            }
+            CHECK(matches);
+        }
+    }
+
+    // Rebuilding with fewer objects drops the old batches.
+    InstanceBatcher batcher;
+    batcher.Build(scene, visible.data(), visible.size());
+    batcher.Build(scene, visible.data(), 1);
+    CHECK(batcher.GetBatches().size() == 1 && batcher.GetInstanceCount() == 1);
+    CHECK(MatchesObject(batcher.GetData()[0], scene, visible[0]));
+}
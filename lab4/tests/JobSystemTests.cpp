@@ -0,0 +1,189 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include "LabScene.h"
+#include "TransparencySort.h"
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+namespace
+{
+    const unsigned THREAD_COUNTS[] = { 1, 2, 4 };
+}
+
+TEST_CASE(JobSystemParallelForCoversEveryItemOnce)
+{
+    struct Case
+    {
+        uint32_t total;
+        uint32_t grain;
+    };
+    const Case cases[] = { { 0, 8 }, { 1, 8 }, { 7, 0 }, { 8, 8 }, { 100, 7 }, { 4096, 64 }, { 100000, 999 } };
+
+    for (unsigned threads : THREAD_COUNTS)
+    {
+        JobSystem jobs(threads);
+        for (const Case& c : cases)
+        {
+            const uint32_t grain = c.grain > 0 ? c.grain : 1;
+            std::vector<std::atomic<uint32_t>> hits(c.total);
+            for (std::atomic<uint32_t>& hit : hits)
+                hit.store(0);
+            std::atomic<bool> chunksValid(true);
+
+            ParallelFor(&jobs, c.total, c.grain, [&](uint32_t first, uint32_t count) {
+                // Chunks start on a multiple of grain and only the last is short.
+                if (first % grain != 0 || count == 0 || count > grain ||
+                    (count < grain && first + count != c.total))
+                    chunksValid.store(false);
+                for (uint32_t i = first; i < first + count && i < c.total; ++i)
+                    hits[i].fetch_add(1);
+            });
+
+            bool once = true;
+            for (const std::atomic<uint32_t>& hit : hits)
+                once = once && hit.load() == 1;
+            CHECK(once);
+            CHECK(chunksValid.load());
+        }
+    }
+
+    // Without a job system the chunks run in order on the caller.
+    std::vector<uint32_t> firsts;
+    ParallelFor(nullptr, 10, 3, [&](uint32_t first, uint32_t) { firsts.push_back(first); });
+    CHECK((firsts == std::vector<uint32_t>{ 0, 3, 6, 9 }));
+}
+
+TEST_CASE(JobSystemParentsWaitForNestedChildren)
+{
+    // Eight children each create eight grandchildren from inside their own
+    // job, on whichever thread runs them. The root is unfinished until the
+    // last grandchild is done.
+    for (unsigned threads : THREAD_COUNTS)
+    {
+        JobSystem jobs(threads);
+        std::atomic<uint32_t> grandchildren(0);
+        std::atomic<bool> rootFinishedEarly(false);
+
+        Job* pRoot = jobs.CreateJob([]() {});
+        JobSystem* pJobs = &jobs;
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            jobs.Run(jobs.CreateChildJob(pRoot, [=, &grandchildren, &rootFinishedEarly]() {
+                for (uint32_t j = 0; j < 8; ++j)
+                {
+                    pJobs->Run(pJobs->CreateChildJob(pRoot, [=, &grandchildren, &rootFinishedEarly]() {
+                        if (pJobs->IsFinished(pRoot))
+                            rootFinishedEarly.store(true);
+                        grandchildren.fetch_add(1);
+                    }));
+                }
+            }));
+        }
+        jobs.Run(pRoot);
+        jobs.Wait(pRoot);
+
+        CHECK(jobs.IsFinished(pRoot));
+        CHECK(grandchildren.load() == 64);
+        CHECK(!rootFinishedEarly.load());
+        CHECK(jobs.GetStats().jobs == 1 + 8 + 64);
+    }
+}
+
+TEST_CASE(JobSystemIdleThreadsSteal)
+{
+    // Jobs that take a while, all queued on the caller's deque: the other
+    // threads have to take some of them.
+    JobSystem jobs(4);
+    jobs.ResetStats();
+    std::mutex mutex;
+    std::set<std::thread::id> ranOn;
+
+    Job* pRoot = jobs.CreateJob([]() {});
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        jobs.Run(jobs.CreateChildJob(pRoot, [&]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            std::lock_guard<std::mutex> lock(mutex);
+            ranOn.insert(std::this_thread::get_id());
+        }));
+    }
+    jobs.Run(pRoot);
+    jobs.Wait(pRoot);
+
+    const JobThreadStats stats = jobs.GetStats();
+    CHECK(stats.jobs == 65);
+    CHECK(stats.steals > 0);
+    CHECK(stats.steals <= stats.stealAttempts);
+    CHECK(stats.contendedSteals <= stats.stealAttempts);
+    CHECK(ranOn.size() > 1);
+
+    // The per-thread counters add up to the totals.
+    JobThreadStats sum;
+    for (uint32_t i = 0; i < jobs.GetThreadCount(); ++i)
+        sum += jobs.GetThreadStats(i);
+    CHECK(sum.jobs == stats.jobs && sum.steals == stats.steals && sum.stealAttempts == stats.stealAttempts);
+
+    jobs.ResetStats();
+    CHECK(jobs.GetStats().jobs == 0 && jobs.GetStats().steals == 0);
+}
+
+TEST_CASE(JobSystemRunsMoreJobsThanItsRing)
+{
+    // More unfinished children than a thread has job slots: creating one
+    // runs queued jobs until a slot frees.
+    const uint32_t count = 3 * JobSystem::MAX_JOBS;
+    for (unsigned threads : THREAD_COUNTS)
+    {
+        JobSystem jobs(threads);
+        std::atomic<uint32_t> ran(0);
+        Job* pRoot = jobs.CreateJob([]() {});
+        for (uint32_t i = 0; i < count; ++i)
+            jobs.Run(jobs.CreateChildJob(pRoot, [&ran]() { ran.fetch_add(1); }));
+        jobs.Run(pRoot);
+        jobs.Wait(pRoot);
+        CHECK(ran.load() == count);
+    }
+}
+
+TEST_CASE(JobSystemFrameMatchesSerial)
+{
+    // The per-frame stages give the same visible list, instance data and
+    // draw order with jobs as without, on any number of threads.
+    const CameraInput noInput;
+    const float aspect = 16.0f / 9.0f;
+    for (unsigned threads : THREAD_COUNTS)
+    {
+        JobSystem jobs(threads);
+        LabScene scene;
+        scene.SetCubeCount(20000);
+        OcclusionCuller occlusion;
+        bool matches = true;
+        for (uint32_t frame = 0; frame < 5; ++frame)
+        {
+            const double time = 0.37 * frame;
+            SceneMatrices matrices;
+            std::vector<uint32_t> threadedVisible, serialVisible;
+            InstanceBatcher threadedInstances, serialInstances;
+            TransparencySorter threadedSorter, serialSorter;
+
+            scene.Update(time, 0.0f, noInput, &jobs);
+            scene.ComputeMatrices(aspect, matrices);
+            scene.BuildVisibleInstances(matrices.viewProj, threadedVisible, threadedInstances, TRANSFORM_KERNEL_BEST,
+                &occlusion, &jobs);
+            threadedSorter.Sort(scene.GetTransforms(), matrices.eye[0], matrices.eye[1], matrices.eye[2], &jobs);
+
+            scene.Update(time, 0.0f, noInput);
+            scene.BuildVisibleInstances(matrices.viewProj, serialVisible, serialInstances, TRANSFORM_KERNEL_BEST,
+                &occlusion);
+            serialSorter.Sort(scene.GetTransforms(), matrices.eye[0], matrices.eye[1], matrices.eye[2]);
+
+            matches = matches && !serialVisible.empty() && threadedVisible == serialVisible &&
+                threadedInstances.GetDataSize() == serialInstances.GetDataSize() &&
+                memcmp(threadedInstances.GetData(), serialInstances.GetData(), serialInstances.GetDataSize()) == 0 &&
+                threadedSorter.GetOrder() == serialSorter.GetOrder();
+        }
+        CHECK(matches);
+    }
+}
@@ -0,0 +1,151 @@
+#include "Test.h"
+#include "DdsView.h"
+#include "LoadScheduler.h"
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const char* const LAB_TEXTURES[7] = { "wood02", "skybox/posx", "skybox/negx", "skybox/posy", "skybox/negy",
+        "skybox/posz", "skybox/negz" };
+
+    bool SameView(const DdsView& a, const DdsView& b)
+    {
+        return a.IsOpen() && b.IsOpen() && a.GetFormat() == b.GetFormat() && a.GetWidth() == b.GetWidth() &&
+            a.GetHeight() == b.GetHeight() && a.GetMipCount() == b.GetMipCount() &&
+            a.GetArraySize() == b.GetArraySize() && a.GetMappedSize() == b.GetMappedSize() &&
+            memcmp(a.GetMappedData(), b.GetMappedData(), a.GetMappedSize()) == 0;
+    }
+}
+
+TEST_CASE(LoadSchedulerRunsJobsInOrderOnOneWorker)
+{
+    LoadScheduler scheduler(1);
+    CHECK(scheduler.GetWorkerCount() == 1);
+
+    std::vector<uint32_t> order;
+    std::vector<std::future<uint32_t>> results;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        results.push_back(scheduler.Submit([&order, i]() {
+            order.push_back(i);
+            return i * i;
+        }));
+    }
+
+    bool values = true;
+    for (uint32_t i = 0; i < 100; ++i)
+        values = values && results[i].get() == i * i;
+    CHECK(values);
+    scheduler.WaitIdle();
+    bool ordered = order.size() == 100;
+    for (uint32_t i = 0; ordered && i < 100; ++i)
+        ordered = order[i] == i;
+    CHECK(ordered);
+}
+
+TEST_CASE(LoadSchedulerRunsJobsAtTheSameTime)
+{
+    // Each job waits until all four have started, which only happens if
+    // every worker took one. Bounded, so a broken pool fails rather than
+    // hangs.
+    LoadScheduler scheduler(4);
+    std::atomic<uint32_t> started(0);
+    std::vector<std::future<bool>> met;
+    for (int i = 0; i < 4; ++i)
+    {
+        met.push_back(scheduler.Submit([&started]() {
+            started.fetch_add(1);
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (started.load() < 4 && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::yield();
+            return started.load() == 4;
+        }));
+    }
+    bool allMet = true;
+    for (std::future<bool>& result : met)
+        allMet = result.get() && allMet;
+    CHECK(allMet);
+}
+
+TEST_CASE(LoadSchedulerFinishesQueuedJobsBeforeDestruction)
+{
+    std::atomic<uint32_t> ran(0);
+    {
+        LoadScheduler scheduler(2);
+        for (int i = 0; i < 50; ++i)
+        {
+            scheduler.Submit([&ran]() {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                ran.fetch_add(1);
+            });
+        }
+    }
+    CHECK(ran.load() == 50);
+}
+
+TEST_CASE(ParallelForChunksCoversEveryItemOnce)
+{
+    LoadScheduler one(1);
+    LoadScheduler three(3);
+    LoadScheduler* schedulers[] = { nullptr, &one, &three };
+    const uint32_t totals[] = { 0, 1, 2, 1000, 100003 };
+    for (LoadScheduler* pScheduler : schedulers)
+    {
+        for (uint32_t total : totals)
+        {
+            std::vector<std::atomic<uint32_t>> hits(total);
+            for (std::atomic<uint32_t>& hit : hits)
+                hit.store(0);
+            ParallelForChunks(pScheduler, total, [&hits, total](uint32_t first, uint32_t count) {
+                for (uint32_t i = first; i < first + count && i < total; ++i)
+                    hits[i].fetch_add(1);
+            });
+            bool once = true;
+            for (const std::atomic<uint32_t>& hit : hits)
+                once = once && hit.load() == 1;
+            CHECK(once);
+        }
+    }
+
+    // From inside a job on the only worker: the helper it queues can't
+    // start, so the job has to finish every chunk itself.
+    std::future<uint32_t> nested = one.Submit([&one]() {
+        std::atomic<uint32_t> sum(0);
+        ParallelForChunks(&one, 1000, [&sum](uint32_t, uint32_t count) { sum.fetch_add(count); });
+        return sum.load();
+    });
+    CHECK(nested.wait_for(std::chrono::seconds(10)) == std::future_status::ready && nested.get() == 1000);
+}
+
+TEST_CASE(LoadDdsViewOnWorkersMatchesSerial)
+{
+    // The lab's textures loaded by the per-file job on three workers at
+    // once hold exactly what loading them one by one does, with and
+    // without prefetch and through the wide-path overload.
+    LoadScheduler scheduler(3);
+    for (int prefetch = 0; prefetch < 2; ++prefetch)
+    {
+        std::vector<DdsView> serial(7);
+        std::vector<std::future<DdsView>> loads;
+        for (int i = 0; i < 7; ++i)
+        {
+            const std::string path = GetTextureDir() + LAB_TEXTURES[i] + ".dds";
+            serial[i] = LoadDdsView(path.c_str(), prefetch != 0);
+            const std::wstring widePath(path.begin(), path.end());
+            loads.push_back(scheduler.Submit([widePath, prefetch]() {
+                return LoadDdsView(widePath.c_str(), prefetch != 0);
+            }));
+        }
+        for (int i = 0; i < 7; ++i)
+        {
+            const DdsView view = loads[i].get();
+            CHECK(SameView(view, serial[i]));
+        }
+    }
+
+    std::future<DdsView> missing = scheduler.Submit([]() {
+        return LoadDdsView(GetScratchPath("no_such_texture.dds").c_str());
+    });
+    CHECK(!missing.get().IsOpen());
+}
@@ -0,0 +1,259 @@
+#include "Test.h"
+#include "LabScene.h"
+#include "OcclusionCull.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Walls 2 to 8 units long, 1 to 5 high and up to 1.2 thick, facing any
+    // way, within 20 units of the origin.
+    void BuildWalls(uint32_t count, std::vector<InstanceData>& walls)
+    {
+        SceneTransforms scene;
+        scene.Resize(count);
+        uint32_t state = 321;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float angle = Random(state) * 6.2831853f;
+            const float radius = 20.0f * std::sqrt(Random(state));
+            const float height = 1.0f + 4.0f * Random(state);
+            scene.SetPosition(i, radius * std::cos(angle), 0.5f * height, radius * std::sin(angle));
+            scene.SetScale(i, 2.0f + 6.0f * Random(state), height, 0.2f + Random(state));
+            scene.SetRotationYaw(i, Random(state) * 6.2831853f);
+        }
+        walls.resize(count);
+        ComputeInstanceData(scene, 0, count, walls.data());
+    }
+
+    // Whether the segment from a to b passes through the box before b. The
+    // box's axes are the matrix's columns; its half extents are 0.5.
+    bool IsSegmentBlocked(const float world[3][4], const float a[3], const float b[3])
+    {
+        float enter = 0.0f;
+        float exit = 1.0f - 1e-4f;
+        for (int k = 0; k < 3; ++k)
+        {
+            const float axis[3] = { world[0][k], world[1][k], world[2][k] };
+            const float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+            const float start = ((a[0] - world[0][3]) * axis[0] + (a[1] - world[1][3]) * axis[1] +
+                (a[2] - world[2][3]) * axis[2]) / lengthSq;
+            const float step = ((b[0] - a[0]) * axis[0] + (b[1] - a[1]) * axis[1] +
+                (b[2] - a[2]) * axis[2]) / lengthSq;
+            if (std::fabs(step) < 1e-12f)
+            {
+                if (std::fabs(start) > 0.5f)
+                    return false;
+                continue;
+            }
+            float t0 = (-0.5f - start) / step;
+            float t1 = (0.5f - start) / step;
+            if (t0 > t1)
+                std::swap(t0, t1);
+            enter = std::max(enter, t0);
+            exit = std::min(exit, t1);
+            if (enter > exit)
+                return false;
+        }
+        return true;
+    }
+
+    // Whether p is on screen and no wall stands between it and the eye.
+    bool IsPointVisible(const Float4x4& viewProj, const float eye[3], const float p[3],
+        const std::vector<InstanceData>& walls)
+    {
+        float clip[4];
+        TransformPoint(viewProj, p, clip);
+        if (!(clip[3] > 0.0f) || clip[2] < 0.0f || clip[2] > clip[3] ||
+            std::fabs(clip[0]) > clip[3] || std::fabs(clip[1]) > clip[3])
+            return false;
+        for (const InstanceData& wall : walls)
+        {
+            if (IsSegmentBlocked(wall.world, eye, p))
+                return false;
+        }
+        return true;
+    }
+
+    Float4x4 GetView(uint32_t v, float eye[3])
+    {
+        // From outside the walls at eye height, towards a point among them.
+        uint32_t state = 1000 + v;
+        const float angle = Random(state) * 6.2831853f;
+        eye[0] = 30.0f * std::cos(angle);
+        eye[1] = 0.5f + 3.0f * Random(state);
+        eye[2] = 30.0f * std::sin(angle);
+        const float at[3] = { Random(state) * 20.0f - 10.0f, Random(state) * 2.0f, Random(state) * 20.0f - 10.0f };
+        const float up[3] = { 0.0f, 1.0f, 0.0f };
+        const Float4x4 proj = MatrixPerspectiveFovLH(LabScene::FOV_Y, 16.0f / 9.0f, LabScene::NEAR_Z,
+            LabScene::FAR_Z);
+        return MatrixMultiply(MatrixLookAtLH(eye, at, up), proj);
+    }
+
+    void DrawWalls(OcclusionCuller& culler, const Float4x4& viewProj, const std::vector<InstanceData>& walls,
+        TransformKernel kernel = TRANSFORM_KERNEL_BEST)
+    {
+        culler.BeginFrame(viewProj, kernel);
+        for (const InstanceData& wall : walls)
+            culler.AddOccluderBox(wall.world);
+        culler.BuildHierarchy();
+    }
+
+    size_t GetPyramidSize(const OcclusionCuller& culler)
+    {
+        size_t size = 0;
+        for (uint32_t level = 0; level < culler.GetLevelCount(); ++level)
+        {
+            const uint32_t width = (culler.GetWidth() + (1u << level) - 1) >> level;
+            const uint32_t height = (culler.GetHeight() + (1u << level) - 1) >> level;
+            size += (size_t)width * height;
+        }
+        return size;
+    }
+}
+
+TEST_CASE(OcclusionCullKeepsAnythingVisible)
+{
+    std::vector<InstanceData> walls;
+    BuildWalls(40, walls);
+
+    BoundingSpheres spheres;
+    spheres.Resize(3000);
+    uint32_t state = 8;
+    for (size_t i = 0; i < spheres.Size(); ++i)
+    {
+        spheres.x[i] = Random(state) * 44.0f - 22.0f;
+        spheres.y[i] = Random(state) * 3.0f;
+        spheres.z[i] = Random(state) * 44.0f - 22.0f;
+        spheres.radius[i] = 0.05f + 0.6f * Random(state);
+    }
+
+    // Points on each rejected sphere: the centre, the six axis extremes
+    // and eight diagonals, just inside the surface.
+    float offsets[15][3] = {};
+    const float d = 0.99f / std::sqrt(3.0f);
+    for (int k = 0; k < 3; ++k)
+    {
+        offsets[1 + 2 * k][k] = 0.99f;
+        offsets[2 + 2 * k][k] = -0.99f;
+    }
+    for (int c = 0; c < 8; ++c)
+    {
+        offsets[7 + c][0] = c & 1 ? d : -d;
+        offsets[7 + c][1] = c & 2 ? d : -d;
+        offsets[7 + c][2] = c & 4 ? d : -d;
+    }
+
+    OcclusionCuller culler;
+    size_t rejected = 0;
+    size_t wronglyRejected = 0;
+    for (uint32_t v = 0; v < 40; ++v)
+    {
+        float eye[3];
+        const Float4x4 viewProj = GetView(v, eye);
+        DrawWalls(culler, viewProj, walls);
+
+        for (size_t i = 0; i < spheres.Size(); ++i)
+        {
+            if (culler.IsSphereVisible(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+                continue;
+            ++rejected;
+            for (const float* pOffset : offsets)
+            {
+                const float p[3] = { spheres.x[i] + pOffset[0] * spheres.radius[i],
+                    spheres.y[i] + pOffset[1] * spheres.radius[i], spheres.z[i] + pOffset[2] * spheres.radius[i] };
+                if (IsPointVisible(viewProj, eye, p, walls))
+                {
+                    ++wronglyRejected;
+                    break;
+                }
+            }
+        }
+    }
+    CHECK(wronglyRejected == 0);
+    CHECK(rejected > 1000);     // the walls do hide things
+
+    // CullSpheres keeps exactly what IsSphereVisible keeps, in order.
+    std::vector<uint32_t> indices(spheres.Size());
+    for (uint32_t i = 0; i < (uint32_t)indices.size(); ++i)
+        indices[i] = i;
+    indices.resize(culler.CullSpheres(spheres, indices.data(), indices.size()));
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < (uint32_t)spheres.Size(); ++i)
+    {
+        if (culler.IsSphereVisible(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+            expected.push_back(i);
+    }
+    CHECK(indices == expected);
+}
+
+TEST_CASE(OcclusionCullHidesWhatIsBehindAWall)
+{
+    // One wall filling the middle of the view; a small sphere right
+    // behind it is hidden, the same sphere beside the wall is not.
+    SceneTransforms scene;
+    scene.Resize(1);
+    scene.SetPosition(0, 0.0f, 0.0f, 0.0f);
+    scene.SetScale(0, 6.0f, 6.0f, 0.5f);
+    InstanceData wall;
+    ComputeInstanceData(scene, 0, 1, &wall);
+
+    const float eye[3] = { 0.0f, 0.0f, -10.0f };
+    const float at[3] = { 0.0f, 0.0f, 0.0f };
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+    const Float4x4 viewProj = MatrixMultiply(MatrixLookAtLH(eye, at, up),
+        MatrixPerspectiveFovLH(LabScene::FOV_Y, 16.0f / 9.0f, LabScene::NEAR_Z, LabScene::FAR_Z));
+
+    OcclusionCuller culler;
+    culler.BeginFrame(viewProj);
+    culler.AddOccluderBox(wall.world);
+    culler.BuildHierarchy();
+    CHECK(culler.GetOccluderTriangleCount() > 0);
+    CHECK(!culler.IsSphereVisible(0.0f, 0.0f, 5.0f, 0.5f));
+    CHECK(culler.IsSphereVisible(0.0f, 0.0f, -5.0f, 0.5f));     // in front
+    CHECK(culler.IsSphereVisible(8.0f, 0.0f, 5.0f, 0.5f));      // beside
+    CHECK(culler.IsSphereVisible(0.0f, 0.0f, 5.0f, 6.0f));      // reaches round it
+
+    // Without occluders nothing is hidden.
+    culler.BeginFrame(viewProj);
+    culler.BuildHierarchy();
+    CHECK(culler.IsSphereVisible(0.0f, 0.0f, 5.0f, 0.5f));
+}
+
+TEST_CASE(OcclusionCullKernelsWriteIdenticalDepths)
+{
+    std::vector<InstanceData> walls;
+    BuildWalls(64, walls);
+
+    OcclusionCuller reference;
+    OcclusionCuller culler;
+    const TransformKernel kernels[] = { TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX2 };
+    uint32_t compared = 0;
+    bool identical = true;
+    for (uint32_t v = 0; v < 20; ++v)
+    {
+        float eye[3];
+        const Float4x4 viewProj = GetView(v, eye);
+        DrawWalls(reference, viewProj, walls, TRANSFORM_KERNEL_SCALAR);
+        const size_t size = GetPyramidSize(reference);
+        for (TransformKernel kernel : kernels)
+        {
+            if (!IsTransformKernelSupported(kernel))
+                continue;
+            DrawWalls(culler, viewProj, walls, kernel);
+            identical = identical && culler.GetLevelCount() == reference.GetLevelCount() &&
+                memcmp(culler.GetDepth(0), reference.GetDepth(0), size * sizeof(float)) == 0;
+            ++compared;
+        }
+    }
+    CHECK(identical);
+    if (compared == 0)
+        printf("  no SIMD kernel on this CPU; only the scalar one ran\n");
+}
@@ -0,0 +1,263 @@
+#include "Test.h"
+#include "DdsWriter.h"
+#include "LoadScheduler.h"
+#include "PixelConverter.h"
+#include <cstring>
+
+namespace
+{
+    const BlockDecodeKernel SIMD_KERNELS[] = { BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+
+    const DdsPixelLayout LAYOUTS[] = {
+        DDS_PIXELS_RGBA32, DDS_PIXELS_RGBX32, DDS_PIXELS_BGRA32,
+        DDS_PIXELS_BGRX32, DDS_PIXELS_RGB24, DDS_PIXELS_BGR24
+    };
+
+    // One pixel stored in layout: r, g, b, a in the layout's byte order,
+    // padding bytes set to 0x5A so an X layout that copies them shows up.
+    void StorePixel(DdsPixelLayout layout, uint8_t r, uint8_t g, uint8_t b, uint8_t a, uint8_t* pOut)
+    {
+        const bool bgr = layout == DDS_PIXELS_BGRA32 || layout == DDS_PIXELS_BGRX32 || layout == DDS_PIXELS_BGR24;
+        pOut[0] = bgr ? b : r;
+        pOut[1] = g;
+        pOut[2] = bgr ? r : b;
+        if (DdsBytesPerPixel(layout) == 4)
+            pOut[3] = layout == DDS_PIXELS_RGBA32 || layout == DDS_PIXELS_BGRA32 ? a : 0x5A;
+    }
+
+    // What the converter should make of StorePixel()'s pixel.
+    void ExpectedPixel(DdsPixelLayout layout, uint8_t r, uint8_t g, uint8_t b, uint8_t a, uint8_t* pOut)
+    {
+        pOut[0] = r;
+        pOut[1] = g;
+        pOut[2] = b;
+        pOut[3] = layout == DDS_PIXELS_RGBA32 || layout == DDS_PIXELS_BGRA32 ? a : 255;
+    }
+
+    // A width x height surface of noise in layout, rows padded to a pitch
+    // that is no multiple of the pixel size, and its expected RGBA8.
+    uint32_t MakeSurface(DdsPixelLayout layout, uint32_t width, uint32_t height, uint32_t seed,
+        std::vector<uint8_t>& src, std::vector<uint8_t>& expected)
+    {
+        const uint32_t pitch = width * DdsBytesPerPixel(layout) + 3;
+        src.assign((size_t)pitch * height, 0xEE);
+        expected.resize((size_t)width * height * 4);
+        uint32_t state = seed;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                state = state * 1664525u + 1013904223u;
+                const uint8_t r = (uint8_t)(state >> 24), g = (uint8_t)(state >> 16);
+                const uint8_t b = (uint8_t)(state >> 8), a = (uint8_t)(state >> 4);
+                StorePixel(layout, r, g, b, a, &src[(size_t)y * pitch + x * DdsBytesPerPixel(layout)]);
+                ExpectedPixel(layout, r, g, b, a, &expected[((size_t)y * width + x) * 4]);
+            }
+        }
+        return pitch;
+    }
+
+    // Widths that leave every SIMD step (4 and 8 pixels, 16 and 32 bytes of
+    // 24-bit input) a ragged end for the scalar path.
+    const uint32_t WIDTHS[] = { 1, 3, 5, 7, 13, 37, 64, 101 };
+}
+
+TEST_CASE(PixelConverterExpandsEveryLayout)
+{
+    // A single pixel per layout: 24-bit gains an opaque alpha, BGR is
+    // swapped to RGB, X padding becomes 255 rather than being copied.
+    for (DdsPixelLayout layout : LAYOUTS)
+    {
+        if (!CHECK(IsPixelConvertLayout(layout)))
+            continue;
+        uint8_t src[4];
+        StorePixel(layout, 10, 20, 30, 40, src);
+        uint8_t expected[4];
+        ExpectedPixel(layout, 10, 20, 30, 40, expected);
+        uint8_t dst[4] = { 0xcd, 0xcd, 0xcd, 0xcd };
+        ConvertPixelRows(layout, src, 4, 1, 0, 1, dst, 4, BLOCK_DECODE_SCALAR);
+        CHECK(memcmp(dst, expected, 4) == 0);
+    }
+    CHECK(!IsPixelConvertLayout(DDS_PIXELS_UNKNOWN));
+    CHECK(!IsPixelConvertLayout(DDS_PIXELS_BLOCK));
+}
+
+TEST_CASE(PixelConverterKernelsMatchExpectedAtOddWidths)
+{
+    const BlockDecodeKernel kernels[] = { BLOCK_DECODE_SCALAR, BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+    for (DdsPixelLayout layout : LAYOUTS)
+    {
+        for (uint32_t width : WIDTHS)
+        {
+            std::vector<uint8_t> src, expected;
+            const uint32_t pitch = MakeSurface(layout, width, 5, width * 17 + layout, src, expected);
+            for (BlockDecodeKernel kernel : kernels)
+            {
+                if (!IsBlockDecodeKernelSupported(kernel))
+                    continue;
+                // Poisoned, so pixels a kernel fails to write show up.
+                std::vector<uint8_t> dst(expected.size(), 0xcd);
+                CHECK(ConvertPixelSurface(layout, src.data(), pitch, width, 5, dst.data(), width * 4, kernel));
+                CHECK(dst == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE(PixelConverterConvertsRowRanges)
+{
+    // Rows outside the range are left alone, which the parallel path's
+    // chunks rely on.
+    for (DdsPixelLayout layout : LAYOUTS)
+    {
+        std::vector<uint8_t> src, expected;
+        const uint32_t width = 13, height = 9;
+        const uint32_t pitch = MakeSurface(layout, width, height, 99, src, expected);
+        std::vector<uint8_t> dst(expected.size(), 0xcd);
+        ConvertPixelRows(layout, src.data(), pitch, width, 3, 4, dst.data(), width * 4);
+
+        bool matches = true;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const bool inRange = y >= 3 && y < 7;
+            for (uint32_t i = 0; i < width * 4; ++i)
+            {
+                const size_t at = (size_t)y * width * 4 + i;
+                matches = matches && dst[at] == (inRange ? expected[at] : 0xcd);
+            }
+        }
+        CHECK(matches);
+    }
+}
+
+TEST_CASE(PixelConverterConvertsInPlace)
+{
+    // 32-bit layouts convert over their own bytes, with every kernel.
+    const DdsPixelLayout layouts[] = { DDS_PIXELS_RGBA32, DDS_PIXELS_RGBX32, DDS_PIXELS_BGRA32, DDS_PIXELS_BGRX32 };
+    const BlockDecodeKernel kernels[] = { BLOCK_DECODE_SCALAR, BLOCK_DECODE_SSE41, BLOCK_DECODE_AVX2 };
+    for (DdsPixelLayout layout : layouts)
+    {
+        for (BlockDecodeKernel kernel : kernels)
+        {
+            if (!IsBlockDecodeKernelSupported(kernel))
+                continue;
+            const uint32_t width = 37, height = 6;
+            std::vector<uint8_t> src, expected;
+            MakeSurface(layout, width, height, 5, src, expected);
+            // Tightly packed, so source and destination pitches agree.
+            std::vector<uint8_t> surface(expected.size());
+            for (uint32_t y = 0; y < height; ++y)
+                memcpy(&surface[(size_t)y * width * 4], &src[(size_t)y * (width * 4 + 3)], width * 4);
+            CHECK(ConvertPixelSurface(layout, surface.data(), width * 4, width, height, surface.data(), width * 4, kernel));
+            CHECK(surface == expected);
+        }
+    }
+}
+
+TEST_CASE(PixelConverterParallelMatchesScalar)
+{
+    LoadScheduler scheduler(3);
+    for (DdsPixelLayout layout : LAYOUTS)
+    {
+        std::vector<uint8_t> src, expected;
+        const uint32_t width = 301, height = 257;
+        const uint32_t pitch = MakeSurface(layout, width, height, 3, src, expected);
+
+        std::vector<uint8_t> scalar(expected.size(), 0xcd);
+        CHECK(ConvertPixelSurface(layout, src.data(), pitch, width, height, scalar.data(), width * 4, BLOCK_DECODE_SCALAR));
+        CHECK(scalar == expected);
+        for (BlockDecodeKernel kernel : SIMD_KERNELS)
+        {
+            if (!IsBlockDecodeKernelSupported(kernel))
+                continue;
+            std::vector<uint8_t> parallel(expected.size(), 0xcd);
+            CHECK(ConvertPixelSurface(layout, src.data(), pitch, width, height, parallel.data(), width * 4,
+                kernel, &scheduler));
+            CHECK(parallel == scalar);
+        }
+    }
+}
+
+TEST_CASE(PixelConverterDetectsLayoutsFromMasks)
+{
+    DDS_PIXELFORMAT ddspf = {};
+    ddspf.dwSize = sizeof(ddspf);
+    ddspf.dwFlags = DDS_RGB;
+    ddspf.dwRGBBitCount = 32;
+    ddspf.dwRBitMask = 0x000000FF;
+    ddspf.dwGBitMask = 0x0000FF00;
+    ddspf.dwBBitMask = 0x00FF0000;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_RGBX32);
+    // The alpha mask decides even without DDS_ALPHAPIXELS.
+    ddspf.dwABitMask = 0xFF000000;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_RGBA32);
+
+    ddspf.dwRBitMask = 0x00FF0000;
+    ddspf.dwBBitMask = 0x000000FF;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_BGRA32);
+    ddspf.dwABitMask = 0;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_BGRX32);
+
+    ddspf.dwRGBBitCount = 24;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_BGR24);
+    ddspf.dwRBitMask = 0x000000FF;
+    ddspf.dwBBitMask = 0x00FF0000;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_RGB24);
+
+    // 16-bit and shuffled masks are not layouts the converter knows.
+    ddspf.dwRBitMask = 0x0000FF00;
+    ddspf.dwGBitMask = 0x000000FF;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_UNKNOWN);
+    ddspf.dwRGBBitCount = 16;
+    ddspf.dwRBitMask = 0xF800;
+    ddspf.dwGBitMask = 0x07E0;
+    ddspf.dwBBitMask = 0x001F;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_UNKNOWN);
+    ddspf.dwFlags = 0;
+    CHECK(DdsGetUncompressedLayout(ddspf) == DDS_PIXELS_UNKNOWN);
+}
+
+TEST_CASE(PixelConverterConvertsMappedFiles)
+{
+    // Written with each layout's masks, mapped and converted mip by mip,
+    // every level of an odd-sized chain matches the expected pixels.
+    for (DdsPixelLayout layout : LAYOUTS)
+    {
+        DdsWriteDesc desc;
+        desc.layout = layout;
+        desc.width = 45;
+        desc.height = 11;
+        desc.mipCount = 4;
+
+        std::vector<uint8_t> data;
+        std::vector<std::vector<uint8_t> > expected;
+        uint32_t width = desc.width, height = desc.height;
+        for (uint32_t level = 0; level < desc.mipCount; ++level)
+        {
+            std::vector<uint8_t> src, rgba;
+            const uint32_t pitch = MakeSurface(layout, width, height, level + 1, src, rgba);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint8_t* pRow = &src[(size_t)y * pitch];
+                data.insert(data.end(), pRow, pRow + width * DdsBytesPerPixel(layout));
+            }
+            expected.push_back(rgba);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+
+        const std::string path = GetScratchPath("pixel_layout.dds");
+        DdsView view;
+        if (!CHECK(data.size() == DdsGetDataSize(desc)) ||
+            !CHECK(WriteDds(path.c_str(), desc, data.data(), data.size()) && view.Open(path.c_str())))
+        {
+            return;
+        }
+        CHECK(view.GetPixelLayout() == layout);
+        for (uint32_t level = 0; level < desc.mipCount; ++level)
+        {
+            std::vector<uint8_t> rgba;
+            CHECK(ConvertDdsMip(view, 0, level, rgba) && rgba == expected[level]);
+        }
+    }
+}
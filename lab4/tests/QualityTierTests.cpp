@@ -0,0 +1,170 @@
+#include "Test.h"
+#include "DdsView.h"
+#include "PixelConverter.h"
+#include <cstring>
+
+namespace
+{
+    const char* const TEXTURES[] = { "wood02.dds", "skybox/posx.dds" };
+
+    const uint32_t MAX_DIMENSIONS[] = { 0, 1, 3, 100, 512, 1024, 4096 };
+
+    // GetQualityFirstMip() worked out from the top level's size alone.
+    uint32_t ExpectedFirstMip(uint32_t width, uint32_t height, uint32_t mipCount, const TextureQuality& quality)
+    {
+        uint32_t firstMip = quality.dropMips < mipCount - 1 ? quality.dropMips : mipCount - 1;
+        while (quality.maxDimension != 0 && firstMip < mipCount - 1 &&
+            ((width >> firstMip) > quality.maxDimension || (height >> firstMip) > quality.maxDimension))
+            ++firstMip;
+        return firstMip;
+    }
+
+    // The lab texture copied to the scratch directory, so its pages belong
+    // to this test alone.
+    bool CopyToScratch(const char* name, std::string& path)
+    {
+        std::vector<uint8_t> bytes;
+        path = GetScratchPath((std::string("quality_") + (strchr(name, '/') ? strchr(name, '/') + 1 : name)).c_str());
+        return ReadTestFile(GetTextureDir() + name, bytes) && WriteTestFile(path, bytes);
+    }
+
+    // Loads the file at quality the way TextureLoader::LoadDDS() does:
+    // mapped without read-ahead, the kept levels read ahead and copied out.
+    bool LoadAtQuality(const std::string& path, const TextureQuality& quality, DdsView& view, uint32_t& firstMip,
+        std::vector<uint8_t>& chain)
+    {
+        if (!view.Open(path.c_str(), quality.IsFull()))
+            return false;
+        firstMip = GetQualityFirstMip(view, quality);
+        if (!quality.IsFull())
+            view.ReadAheadMips(firstMip);
+        chain.resize(GetDdsMipChainsSize(view, firstMip));
+        return CopyDdsMipChains(view, firstMip, chain.data());
+    }
+
+    // The reduced chain is the full one with the top firstMip levels cut
+    // off, and the levels have the sizes a firstMip-level load reports.
+    bool IsTailOfFull(const DdsView& full, uint32_t firstMip, const std::vector<uint8_t>& chain)
+    {
+        size_t offset = 0;
+        for (uint32_t level = firstMip; level < full.GetMipCount(); ++level)
+        {
+            const DdsMipSpan& mip = full.GetMip(level);
+            if (offset + mip.size > chain.size() || memcmp(&chain[offset], mip.pData, mip.size) != 0)
+                return false;
+            offset += mip.size;
+        }
+        return offset == chain.size();
+    }
+}
+
+TEST_CASE(QualityFirstMipCoversEveryTier)
+{
+    for (const char* name : TEXTURES)
+    {
+        DdsView view;
+        if (!CHECK(view.Open((GetTextureDir() + name).c_str())))
+            return;
+        const uint32_t mipCount = view.GetMipCount();
+        CHECK(GetQualityFirstMip(view, TextureQuality()) == 0);
+
+        for (uint32_t dropMips = 0; dropMips <= mipCount + 1; ++dropMips)
+        {
+            for (uint32_t maxDimension : MAX_DIMENSIONS)
+            {
+                TextureQuality quality;
+                quality.dropMips = dropMips;
+                quality.maxDimension = maxDimension;
+                const uint32_t firstMip = GetQualityFirstMip(view, quality);
+                CHECK(firstMip == ExpectedFirstMip(view.GetWidth(), view.GetHeight(), mipCount, quality));
+
+                // The last level is always kept, and the top one fits
+                // unless only the last is left.
+                const DdsMipSpan& top = view.GetMip(firstMip);
+                CHECK(firstMip < mipCount);
+                CHECK(maxDimension == 0 || firstMip == mipCount - 1 ||
+                    (top.width <= maxDimension && top.height <= maxDimension));
+            }
+        }
+    }
+}
+
+TEST_CASE(QualityLoadCopiesTheTailOfTheFullChain)
+{
+    for (const char* name : TEXTURES)
+    {
+        std::string path;
+        DdsView full;
+        if (!CHECK(CopyToScratch(name, path)) || !CHECK(full.Open(path.c_str())))
+            return;
+
+        for (uint32_t dropMips = 0; dropMips <= full.GetMipCount(); ++dropMips)
+        {
+            for (uint32_t maxDimension : MAX_DIMENSIONS)
+            {
+                TextureQuality quality;
+                quality.dropMips = dropMips;
+                quality.maxDimension = maxDimension;
+
+                DdsView view;
+                uint32_t firstMip = 0;
+                std::vector<uint8_t> chain;
+                if (!CHECK(LoadAtQuality(path, quality, view, firstMip, chain)))
+                    return;
+                CHECK(firstMip == GetQualityFirstMip(full, quality));
+                CHECK(IsTailOfFull(full, firstMip, chain));
+                CHECK(chain.size() == GetDdsMipChainsSize(full, firstMip));
+
+                // What TextureLoader::LoadDDS() reports for the load.
+                const uint32_t width = full.GetWidth() >> firstMip;
+                const uint32_t height = full.GetHeight() >> firstMip;
+                CHECK(view.GetMip(firstMip).width == (width ? width : 1));
+                CHECK(view.GetMip(firstMip).height == (height ? height : 1));
+                CHECK(firstMip < full.GetMipCount() && view.GetMipCount() == full.GetMipCount());
+            }
+        }
+    }
+}
+
+TEST_CASE(QualityLoadLeavesDroppedLevelsUnread)
+{
+    // Needs posix_fadvise and mincore; elsewhere there is nothing to see.
+    for (const char* name : TEXTURES)
+    {
+        std::string path;
+        if (!CHECK(CopyToScratch(name, path)))
+            return;
+
+        const uint32_t drops[] = { 1, 2, 3 };
+        for (uint32_t dropMips : drops)
+        {
+            if (!MappedFile::EvictFromPageCache(path.c_str()))
+                return;
+
+            TextureQuality quality;
+            quality.dropMips = dropMips;
+            DdsView view;
+            uint32_t firstMip = 0;
+            std::vector<uint8_t> chain;
+            if (!CHECK(LoadAtQuality(path, quality, view, firstMip, chain)))
+                return;
+
+            // The dropped levels share a page with the header at one end and
+            // with the first kept level at the other; past those, nothing of
+            // them may be in memory. 64 KB covers any page size.
+            const uint8_t* pDropped = view.GetMip(0).pData;
+            const size_t droppedSize = (size_t)(view.GetMip(firstMip).pData - pDropped);
+            size_t resident = 0;
+            if (!MappedFile::GetResidentBytes(pDropped, droppedSize, resident))
+                return;
+            CHECK(droppedSize >= 4 * 65536);
+            CHECK(resident <= 2 * 65536);
+
+            // The kept levels were all read.
+            size_t keptResident = 0;
+            const size_t keptSize = view.GetMappedSize() - (size_t)(view.GetMip(firstMip).pData - view.GetMappedData());
+            CHECK(MappedFile::GetResidentBytes(view.GetMip(firstMip).pData, keptSize, keptResident));
+            CHECK(keptResident == keptSize);
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#include "Test.h"
+#include "BenchUtil.h"
+#include "RecordingRenderContext.h"
+#include <cstring>
+
+namespace
+{
+    ID3D11VertexShader* const VS_A = FakeHandle<ID3D11VertexShader>(1);
+    ID3D11VertexShader* const VS_B = FakeHandle<ID3D11VertexShader>(2);
+    ID3D11PixelShader* const PS_A = FakeHandle<ID3D11PixelShader>(3);
+    ID3D11Buffer* const VB_A = FakeHandle<ID3D11Buffer>(4);
+    ID3D11Buffer* const IB_A = FakeHandle<ID3D11Buffer>(5);
+    ID3D11Buffer* const CB_A = FakeHandle<ID3D11Buffer>(6);
+    ID3D11ShaderResourceView* const SRV_A = FakeHandle<ID3D11ShaderResourceView>(7);
+    ID3D11SamplerState* const SAMPLER_A = FakeHandle<ID3D11SamplerState>(8);
+    ID3D11DepthStencilState* const DEPTH_A = FakeHandle<ID3D11DepthStencilState>(9);
+    ID3D11BlendState* const BLEND_A = FakeHandle<ID3D11BlendState>(10);
+
+    bool IsCall(const RenderCommand& cmd, RenderCommandType type, uint32_t slot, const void* pObject,
+        uint32_t arg0 = 0, uint32_t arg1 = 0)
+    {
+        return cmd.type == type && cmd.slot == slot && cmd.pObject == pObject && cmd.arg0 == arg0 &&
+            cmd.arg1 == arg1;
+    }
+
+    // A material and mesh bound, then drawn.
+    void RecordDraw(CommandRecorder& commands, ID3D11VertexShader* pShader, uint32_t indexCount)
+    {
+        commands.SetVertexShader(pShader);
+        commands.SetPixelShader(PS_A);
+        commands.SetVertexBuffer(0, VB_A, 20, 0);
+        commands.SetIndexBuffer(IB_A, 57, 0);
+        commands.SetPSShaderResource(0, SRV_A);
+        commands.SetPSSampler(0, SAMPLER_A);
+        commands.DrawIndexed(indexCount, 0, 0);
+    }
+}
+
+TEST_CASE(CommandRecorderDropsOnlyRedundantBinds)
+{
+    CommandRecorder commands;
+    RecordingRenderContext context(true);
+    commands.BeginFrame();
+
+    commands.SetVertexShader(VS_A);
+    commands.SetVertexShader(VS_A);                          // dropped
+    commands.SetVertexShader(VS_B);
+    commands.SetVertexBuffer(0, VB_A, 20, 0);
+    commands.SetVertexBuffer(0, VB_A, 20, 0);                // dropped
+    commands.SetVertexBuffer(0, VB_A, 32, 0);                // same buffer, new stride
+    commands.SetVertexBuffer(1, VB_A, 32, 0);                // same binding, other slot
+    commands.SetVSConstantBuffer(0, CB_A);
+    commands.SetVSConstantBufferRange(0, CB_A, 0, 16);       // whole buffer to a range
+    commands.SetVSConstantBufferRange(0, CB_A, 0, 16);       // dropped
+    commands.SetVSConstantBufferRange(0, CB_A, 16, 16);
+    commands.SetPSShaderResource(RENDER_MAX_SHADER_RESOURCES, SRV_A);
+    commands.SetPSShaderResource(RENDER_MAX_SHADER_RESOURCES, SRV_A);   // past the shadow, kept
+    commands.SetDepthStencilState(DEPTH_A, 0);
+    commands.SetDepthStencilState(DEPTH_A, 1);               // new stencil reference
+    commands.SetBlendState(BLEND_A, 0xffffffff);
+    commands.SetBlendState(BLEND_A, 0xffffffff);             // dropped
+    commands.SetBlendState(nullptr, 0xffffffff);
+    commands.SetBlendState(nullptr, 0xffffffff);             // dropped; nullptr is a binding too
+    const uint32_t constants[4] = { 1, 2, 3, 4 };
+    commands.UpdateBuffer(CB_A, constants, sizeof(constants), false);
+    commands.UpdateBuffer(CB_A, constants, sizeof(constants), false);   // updates are never dropped
+    commands.DrawIndexed(36, 0, 0);
+    commands.DrawIndexedInstanced(36, 5, 0, 0, 2);
+
+    const RenderCommandStats& frame = commands.GetFrameStats();
+    CHECK(frame.eliminated == 5 && frame.submitted == 0);
+    CHECK(commands.GetRecordedCount() == 18);
+
+    commands.Submit(context);
+    const RenderCommandStats& last = commands.GetLastFrameStats();
+    CHECK(last.submitted == 18 && last.eliminated == 5);
+    CHECK(last.draws == 2 && last.instances == 6);
+    CHECK(commands.GetRecordedCount() == 0);
+
+    const std::vector<RenderCommand>& calls = context.GetCalls();
+    if (!CHECK(calls.size() == 18))
+        return;
+    CHECK(IsCall(calls[0], RCMD_VERTEX_SHADER, 0, VS_A));
+    CHECK(IsCall(calls[1], RCMD_VERTEX_SHADER, 0, VS_B));
+    CHECK(IsCall(calls[2], RCMD_VERTEX_BUFFER, 0, VB_A, 20, 0));
+    CHECK(IsCall(calls[3], RCMD_VERTEX_BUFFER, 0, VB_A, 32, 0));
+    CHECK(IsCall(calls[4], RCMD_VERTEX_BUFFER, 1, VB_A, 32, 0));
+    CHECK(IsCall(calls[5], RCMD_VS_CONSTANT_BUFFER, 0, CB_A));
+    CHECK(IsCall(calls[6], RCMD_VS_CONSTANT_BUFFER_RANGE, 0, CB_A, 0, 16));
+    CHECK(IsCall(calls[7], RCMD_VS_CONSTANT_BUFFER_RANGE, 0, CB_A, 16, 16));
+    CHECK(IsCall(calls[8], RCMD_PS_SHADER_RESOURCE, RENDER_MAX_SHADER_RESOURCES, SRV_A));
+    CHECK(IsCall(calls[9], RCMD_PS_SHADER_RESOURCE, RENDER_MAX_SHADER_RESOURCES, SRV_A));
+    CHECK(IsCall(calls[10], RCMD_DEPTH_STENCIL_STATE, 0, DEPTH_A, 0));
+    CHECK(IsCall(calls[11], RCMD_DEPTH_STENCIL_STATE, 0, DEPTH_A, 1));
+    CHECK(IsCall(calls[12], RCMD_BLEND_STATE, 0, BLEND_A, 0xffffffff));
+    CHECK(IsCall(calls[13], RCMD_BLEND_STATE, 0, nullptr, 0xffffffff));
+    CHECK(calls[14].type == RCMD_UPDATE_BUFFER && calls[15].type == RCMD_UPDATE_BUFFER);
+    CHECK(IsCall(calls[16], RCMD_DRAW_INDEXED, 0, nullptr, 36, 0));
+    CHECK(IsCall(calls[17], RCMD_DRAW_INDEXED_INSTANCED, 0, nullptr, 36, 5) && calls[17].arg4 == 2);
+
+    // The context's own counts agree with the recorder's.
+    CHECK(context.GetBindCount() == 14 && context.GetCount(RCMD_UPDATE_BUFFER) == 2);
+    CHECK(context.GetDrawCount() == last.draws && context.GetInstanceCount() == last.instances);
+    CHECK(context.GetState().pVertexShader == VS_B && context.GetState().vsConstantFirst[0] == 16);
+}
+
+TEST_CASE(CommandRecorderReplaysEverythingAfterInvalidate)
+{
+    CommandRecorder commands;
+    RecordingRenderContext context(true);
+
+    commands.BeginFrame();
+    RecordDraw(commands, VS_A, 36);
+    RecordDraw(commands, VS_A, 12);
+    commands.Submit(context);
+    CHECK(commands.GetLastFrameStats().submitted == 8 && commands.GetLastFrameStats().eliminated == 6);
+
+    // The shadow outlives the frame: the next one only binds what changed.
+    context.ResetCounts();
+    commands.BeginFrame();
+    CHECK(commands.GetFrameStats().submitted == 0 && commands.GetLastFrameStats().submitted == 8);
+    RecordDraw(commands, VS_A, 36);
+    RecordDraw(commands, VS_B, 36);
+    commands.Submit(context);
+    CHECK(commands.GetLastFrameStats().submitted == 3 && commands.GetLastFrameStats().eliminated == 11);
+    if (CHECK(context.GetCalls().size() == 3))
+    {
+        CHECK(IsCall(context.GetCalls()[0], RCMD_DRAW_INDEXED, 0, nullptr, 36));
+        CHECK(IsCall(context.GetCalls()[1], RCMD_VERTEX_SHADER, 0, VS_B));
+        CHECK(IsCall(context.GetCalls()[2], RCMD_DRAW_INDEXED, 0, nullptr, 36));
+    }
+
+    // After Invalidate nothing is assumed bound, and every bind goes out in
+    // the order it was recorded.
+    context.ResetCounts();
+    commands.Invalidate();
+    commands.BeginFrame();
+    RecordDraw(commands, VS_B, 24);
+    commands.SetPrimitiveTopology(4);
+    commands.DrawIndexed(24, 6, -2);
+    commands.Submit(context);
+    const RenderCommandStats& last = commands.GetLastFrameStats();
+    CHECK(last.submitted == 9 && last.eliminated == 0 && last.draws == 2 && last.instances == 2);
+
+    const std::vector<RenderCommand>& calls = context.GetCalls();
+    if (!CHECK(calls.size() == 9))
+        return;
+    CHECK(IsCall(calls[0], RCMD_VERTEX_SHADER, 0, VS_B));
+    CHECK(IsCall(calls[1], RCMD_PIXEL_SHADER, 0, PS_A));
+    CHECK(IsCall(calls[2], RCMD_VERTEX_BUFFER, 0, VB_A, 20, 0));
+    CHECK(IsCall(calls[3], RCMD_INDEX_BUFFER, 0, IB_A, 57, 0));
+    CHECK(IsCall(calls[4], RCMD_PS_SHADER_RESOURCE, 0, SRV_A));
+    CHECK(IsCall(calls[5], RCMD_PS_SAMPLER, 0, SAMPLER_A));
+    CHECK(IsCall(calls[6], RCMD_DRAW_INDEXED, 0, nullptr, 24, 0));
+    CHECK(IsCall(calls[7], RCMD_TOPOLOGY, 0, nullptr, 4));
+    CHECK(IsCall(calls[8], RCMD_DRAW_INDEXED, 0, nullptr, 24, 6) && (int32_t)calls[8].arg2 == -2);
+}
+
+TEST_CASE(CommandRecorderUpdatesReachTheContextAtTheRightTime)
+{
+    CommandRecorder commands;
+    RecordingRenderContext context(true);
+    uint32_t contents[8] = {};
+    context.TrackBuffer(CB_A, contents, sizeof(contents));
+
+    // Each draw sees the update recorded before it, even though every
+    // update went through one buffer.
+    std::vector<uint32_t> seen;
+    context.SetDrawFn([&seen](const RecordingRenderContext& drawn, uint32_t, uint32_t) {
+        uint32_t word;
+        memcpy(&word, drawn.GetVSConstants(0), sizeof(word));
+        seen.push_back(word);
+    });
+
+    // UpdateBuffer copies at record time; UpdateBufferRef reads the caller's
+    // memory at Submit.
+    uint32_t copied[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    uint32_t referenced[8] = { 10, 20, 30, 40, 50, 60, 70, 80 };
+    commands.BeginFrame();
+    commands.SetVSConstantBuffer(0, CB_A);
+    commands.UpdateBuffer(CB_A, copied, sizeof(copied), false);
+    commands.DrawIndexed(36, 0, 0);
+    commands.UpdateBufferRef(CB_A, referenced, sizeof(referenced), true);
+    commands.DrawIndexed(36, 0, 0);
+    commands.SetVSConstantBufferRange(0, CB_A, 1, 1);
+    commands.DrawIndexed(36, 0, 0);
+    copied[0] = 100;
+    referenced[0] = 1000;
+    commands.Submit(context);
+
+    if (CHECK(seen.size() == 3))
+        CHECK(seen[0] == 1 && seen[1] == 1000 && seen[2] == 50);
+    CHECK(contents[0] == 1000 && contents[7] == 80);
+
+    const std::vector<RenderCommand>& calls = context.GetCalls();
+    if (!CHECK(calls.size() == 7))
+        return;
+    CHECK(calls[1].type == RCMD_UPDATE_BUFFER && calls[1].arg1 == sizeof(copied) && calls[1].arg2 == 0);
+    CHECK(calls[3].type == RCMD_UPDATE_BUFFER && calls[3].arg1 == sizeof(referenced) && calls[3].arg2 == 1);
+    const uint32_t* pPayload = (const uint32_t*)context.GetPayload().data();
+    CHECK(pPayload[calls[1].arg0 / 4] == 1 && pPayload[calls[3].arg0 / 4] == 1000);
+
+    // An untracked buffer, or a range past the tracked contents, reads
+    // nothing.
+    commands.BeginFrame();
+    commands.SetVSConstantBufferRange(0, CB_A, 2, 1);
+    commands.SetVSConstantBuffer(1, VB_A);
+    commands.Submit(context);
+    CHECK(context.GetVSConstants(0) == nullptr && context.GetVSConstants(1) == nullptr);
+}
@@ -0,0 +1,243 @@
+#include "Test.h"
+#include "BenchUtil.h"
+#include "RecordingRenderContext.h"
+#include "RenderQueue.h"
+#include <cstring>
+
+namespace
+{
+    // Fake handles, each range wide enough for the MAX_* checks.
+    const uint32_t TEXTURE_HANDLES = 0;
+    const uint32_t SHADER_HANDLES = 4200;
+    const uint32_t BLEND_HANDLES = 5300;
+    const uint32_t BUFFER_HANDLES = 5400;
+
+    RenderMaterial MakeMaterial(uint32_t shader, uint32_t texture, uint32_t blend = 0)
+    {
+        RenderMaterial material;
+        material.pVertexShader = FakeHandle<ID3D11VertexShader>(SHADER_HANDLES + shader);
+        material.pPixelShader = FakeHandle<ID3D11PixelShader>(SHADER_HANDLES + shader);
+        material.pTexture = FakeHandle<ID3D11ShaderResourceView>(TEXTURE_HANDLES + texture);
+        material.pBlendState = FakeHandle<ID3D11BlendState>(BLEND_HANDLES + blend);
+        return material;
+    }
+
+    RenderGeometry MakeGeometry(uint32_t index)
+    {
+        RenderGeometry geometry;
+        geometry.pVertexBuffer = FakeHandle<ID3D11Buffer>(BUFFER_HANDLES + index);
+        geometry.vertexStride = 20;
+        geometry.pIndexBuffer = FakeHandle<ID3D11Buffer>(BUFFER_HANDLES + index);
+        geometry.indexCount = 36;
+        return geometry;
+    }
+
+    // Queues a draw tagged with id, which Submit() hands back through the
+    // constants callback in draw order.
+    void AddTaggedDraw(RenderQueue& queue, RenderPass pass, uint32_t material, uint32_t geometry, float depth,
+        uint32_t id)
+    {
+        queue.AddDraw(pass, material, geometry, depth);
+        queue.AddConstants(0, &id, sizeof(id));
+    }
+
+    // Submits the queue and returns the draws' ids in the order drawn.
+    std::vector<uint32_t> SubmitTagged(RenderQueue& queue, RecordingRenderContext& context)
+    {
+        std::vector<uint32_t> ids;
+        CommandRecorder commands;
+        commands.BeginFrame();
+        queue.Submit(commands, [&ids](CommandRecorder&, uint32_t, const void* pData, uint32_t) {
+            uint32_t id;
+            memcpy(&id, pData, sizeof(id));
+            ids.push_back(id);
+        });
+        commands.Submit(context);
+        return ids;
+    }
+}
+
+TEST_CASE(RenderQueueOrdersPassesAndDepths)
+{
+    RenderQueue queue;
+    const uint32_t material = queue.AddMaterial(MakeMaterial(0, 0));
+    const uint32_t geometry = queue.AddGeometry(MakeGeometry(0));
+
+    // Added in no useful order: the skybox last, transparent draws mixed in.
+    queue.BeginFrame(0.0f, 10.0f);
+    AddTaggedDraw(queue, RENDER_PASS_TRANSPARENT, material, geometry, 2.0f, 10);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, material, geometry, 5.0f, 5);
+    AddTaggedDraw(queue, RENDER_PASS_TRANSPARENT, material, geometry, 8.0f, 11);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, material, geometry, 1.0f, 1);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, material, geometry, 1.2f, 2);
+    AddTaggedDraw(queue, RENDER_PASS_TRANSPARENT, material, geometry, 4.0f, 12);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, material, geometry, 3.0f, 3);
+    AddTaggedDraw(queue, RENDER_PASS_BACKGROUND, material, geometry, 10.0f, 0);
+
+    RecordingRenderContext context;
+    const std::vector<uint32_t> ids = SubmitTagged(queue, context);
+    const uint32_t expected[] = { 0, 1, 2, 3, 5, 11, 12, 10 };
+    CHECK(ids.size() == 8 && memcmp(ids.data(), expected, sizeof(expected)) == 0);
+    CHECK(context.GetDrawCount() == 8);
+
+    // Passes sit in the key's top bits.
+    for (uint32_t i = 0; i < queue.GetPacketCount(); ++i)
+    {
+        const uint32_t pass = RenderQueue::GetKeyPass(queue.GetKey(queue.GetOrder()[i]));
+        CHECK(pass == (i == 0 ? RENDER_PASS_BACKGROUND : i < 5 ? RENDER_PASS_OPAQUE : RENDER_PASS_TRANSPARENT));
+    }
+}
+
+TEST_CASE(RenderQueueGroupsStateWithinDepthBuckets)
+{
+    RenderQueue queue;
+    const uint32_t woodA = queue.AddMaterial(MakeMaterial(0, 0));
+    const uint32_t woodB = queue.AddMaterial(MakeMaterial(0, 1));
+    const uint32_t geometry = queue.AddGeometry(MakeGeometry(0));
+
+    // Two bucket bits over 0..16: 0-4 and 4-8 are separate buckets. Within
+    // a bucket state goes first, then depth; buckets still go front to back.
+    queue.BeginFrame(0.0f, 16.0f);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodB, geometry, 1.0f, 1);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodA, geometry, 3.0f, 0);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodA, geometry, 2.0f, 2);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodA, geometry, 6.0f, 3);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodB, geometry, 5.0f, 4);
+
+    RecordingRenderContext context;
+    std::vector<uint32_t> ids = SubmitTagged(queue, context);
+    const uint32_t bucketed[] = { 2, 0, 1, 3, 4 };
+    CHECK(ids.size() == 5 && memcmp(ids.data(), bucketed, sizeof(bucketed)) == 0);
+
+    // No bucket bits: state alone, front to back only among equal state.
+    queue.SetDepthBucketBits(0);
+    queue.BeginFrame(0.0f, 16.0f);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodB, geometry, 1.0f, 1);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodA, geometry, 3.0f, 0);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodA, geometry, 2.0f, 2);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodA, geometry, 6.0f, 3);
+    AddTaggedDraw(queue, RENDER_PASS_OPAQUE, woodB, geometry, 5.0f, 4);
+    ids = SubmitTagged(queue, context);
+    const uint32_t byState[] = { 2, 0, 3, 1, 4 };
+    CHECK(ids.size() == 5 && memcmp(ids.data(), byState, sizeof(byState)) == 0);
+
+    // Equal keys keep the order they were added in.
+    queue.BeginFrame(0.0f, 16.0f);
+    for (uint32_t id = 0; id < 6; ++id)
+        AddTaggedDraw(queue, RENDER_PASS_TRANSPARENT, woodA, geometry, 7.0f, id);
+    ids = SubmitTagged(queue, context);
+    const uint32_t stable[] = { 0, 1, 2, 3, 4, 5 };
+    CHECK(ids.size() == 6 && memcmp(ids.data(), stable, sizeof(stable)) == 0);
+}
+
+TEST_CASE(RenderQueueDeduplicatesMaterials)
+{
+    RenderQueue queue;
+    const uint32_t a = queue.AddMaterial(MakeMaterial(0, 0));
+    const uint32_t b = queue.AddMaterial(MakeMaterial(0, 1));
+    const uint32_t c = queue.AddMaterial(MakeMaterial(1, 0));
+    CHECK(a == 0 && b == 1 && c == 2);
+    CHECK(queue.AddMaterial(MakeMaterial(0, 0)) == a);
+    CHECK(queue.AddMaterial(MakeMaterial(0, 1)) == b);
+    CHECK(queue.AddMaterial(MakeMaterial(1, 0)) == c);
+
+    // Any binding that differs makes a new material.
+    RenderMaterial slot = MakeMaterial(0, 0);
+    slot.textureSlot = 1;
+    CHECK(queue.AddMaterial(slot) == 3);
+    RenderMaterial layout = MakeMaterial(0, 0);
+    layout.pInputLayout = FakeHandle<ID3D11InputLayout>(BUFFER_HANDLES);
+    CHECK(queue.AddMaterial(layout) == 4);
+
+    // Clear() forgets them.
+    queue.Clear();
+    CHECK(queue.AddMaterial(MakeMaterial(1, 0)) == 0);
+}
+
+TEST_CASE(RenderQueueRejectsMaterialsPastTheKeyBits)
+{
+    // Textures: MAX_TEXTURES distinct ones fit, the next does not, while one
+    // reusing a known texture still does.
+    RenderQueue queue;
+    bool added = true;
+    for (uint32_t t = 0; t < RenderQueue::MAX_TEXTURES; ++t)
+        added = added && queue.AddMaterial(MakeMaterial(0, t)) == t;
+    CHECK(added);
+    CHECK(queue.AddMaterial(MakeMaterial(0, RenderQueue::MAX_TEXTURES)) == RenderQueue::INVALID_ID);
+    CHECK(queue.AddMaterial(MakeMaterial(1, 5)) == RenderQueue::MAX_TEXTURES);
+
+    // Shaders.
+    queue.Clear();
+    added = true;
+    for (uint32_t s = 0; s < RenderQueue::MAX_SHADERS; ++s)
+        added = added && queue.AddMaterial(MakeMaterial(s, 0)) != RenderQueue::INVALID_ID;
+    CHECK(added);
+    CHECK(queue.AddMaterial(MakeMaterial(RenderQueue::MAX_SHADERS, 0)) == RenderQueue::INVALID_ID);
+
+    // States.
+    queue.Clear();
+    added = true;
+    for (uint32_t s = 0; s < RenderQueue::MAX_STATES; ++s)
+        added = added && queue.AddMaterial(MakeMaterial(0, 0, s)) != RenderQueue::INVALID_ID;
+    CHECK(added);
+    CHECK(queue.AddMaterial(MakeMaterial(0, 0, RenderQueue::MAX_STATES)) == RenderQueue::INVALID_ID);
+
+    // Geometry.
+    added = true;
+    for (uint32_t g = 0; g < RenderQueue::MAX_GEOMETRY; ++g)
+        added = added && queue.AddGeometry(MakeGeometry(g)) == g;
+    CHECK(added);
+    CHECK(queue.AddGeometry(MakeGeometry(0)) == RenderQueue::INVALID_ID);
+
+    // Draws naming an id that was never handed out are dropped.
+    queue.BeginFrame(0.0f, 1.0f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, RenderQueue::INVALID_ID, 0, 0.5f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, 0, RenderQueue::INVALID_ID, 0.5f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, 0, 0, 0.5f);
+    CHECK(queue.GetPacketCount() == 1);
+}
+
+TEST_CASE(RenderQueueCountsBindChanges)
+{
+    RenderQueue queue;
+    queue.SetDepthBucketBits(0);
+    const uint32_t a = queue.AddMaterial(MakeMaterial(0, 0));
+    const uint32_t b = queue.AddMaterial(MakeMaterial(0, 1));
+    const uint32_t c = queue.AddMaterial(MakeMaterial(1, 2, 1));
+    const uint32_t g0 = queue.AddGeometry(MakeGeometry(0));
+    const uint32_t g1 = queue.AddGeometry(MakeGeometry(1));
+
+    // Interleaved as a scene would add them; sorted they run a a a b b c.
+    queue.BeginFrame(0.0f, 10.0f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, c, g1, 1.0f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, a, g0, 2.0f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, b, g0, 3.0f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, a, g0, 4.0f);
+    queue.AddDraw(RENDER_PASS_OPAQUE, b, g0, 5.0f, 8, 0);
+    queue.AddDraw(RENDER_PASS_OPAQUE, a, g0, 6.0f);
+
+    CommandRecorder commands;
+    RecordingRenderContext context;
+    commands.BeginFrame();
+    queue.Submit(commands, [](CommandRecorder&, uint32_t, const void*, uint32_t) {});
+    commands.Submit(context);
+
+    const RenderQueueStats& stats = queue.GetStats();
+    CHECK(stats.draws == 6);
+    CHECK(stats.shaderChanges == 2);
+    CHECK(stats.textureChanges == 3);
+    CHECK(stats.stateChanges == 2);
+    CHECK(stats.geometryChanges == 2);
+    CHECK(stats.GetTotalChanges() == 9);
+
+    // What reached the context agrees, and the binds left standing are c's.
+    CHECK(context.GetDrawCount() == 6 && context.GetInstanceCount() == 5 + 8);
+    CHECK(context.GetCount(RCMD_VERTEX_SHADER) == 2);
+    CHECK(context.GetCount(RCMD_PS_SHADER_RESOURCE) == 3);
+    CHECK(context.GetCount(RCMD_BLEND_STATE) == 2);
+    CHECK(context.GetCount(RCMD_INDEX_BUFFER) == 2);
+    CHECK(context.GetCount(RCMD_DRAW_INDEXED_INSTANCED) == 1);
+    CHECK(context.GetState().pVertexShader == MakeMaterial(1, 2).pVertexShader);
+    CHECK(context.GetState().psShaderResources[0] == MakeMaterial(1, 2).pTexture);
+    CHECK(context.GetState().vertexBuffers[0] == MakeGeometry(1).pVertexBuffer);
+}
@@ -0,0 +1,311 @@
+#include "Test.h"
+#include "Camera.h"
+#include "LabScene.h"
+#include "SceneBvh.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    void BuildSpheres(BoundingSpheres& spheres, uint32_t count, uint32_t seed)
+    {
+        spheres.Resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            spheres.x[i] = Random(seed) * 40.0f - 20.0f;
+            spheres.y[i] = Random(seed) * 40.0f - 20.0f;
+            spheres.z[i] = Random(seed) * 40.0f - 20.0f;
+            spheres.radius[i] = 0.1f + Random(seed);
+        }
+    }
+
+    FrustumPlanes GetOrbitPlanes(float yaw, float pitch, float distance)
+    {
+        Camera camera;
+        camera.SetOrbit(yaw, pitch, distance);
+        const Float4x4 proj = MatrixPerspectiveFovLH(LabScene::FOV_Y, 16.0f / 9.0f, LabScene::NEAR_Z,
+            LabScene::FAR_Z);
+        return ExtractFrustumPlanes(MatrixMultiply(camera.GetViewMatrix(), proj));
+    }
+
+    std::vector<uint32_t> CullBvh(const SceneBvh& bvh, const FrustumPlanes& planes, const BoundingSpheres& spheres)
+    {
+        std::vector<uint32_t> visible(spheres.Size());
+        visible.resize(bvh.CullFrustum(planes, spheres, visible.data()));
+        std::sort(visible.begin(), visible.end());
+        return visible;
+    }
+
+    std::vector<uint32_t> CullLinear(const FrustumPlanes& planes, const BoundingSpheres& spheres)
+    {
+        std::vector<uint32_t> visible(spheres.Size());
+        visible.resize(CullSpheres(planes, spheres, visible.data()));
+        return visible;
+    }
+
+    // Where the ray enters sphere i, clamped to 0 inside it, or -1 for a
+    // miss; the same arithmetic as SceneBvh::Raycast.
+    float RayEntry(const BoundingSpheres& s, uint32_t i, const float origin[3], const float direction[3])
+    {
+        const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+        const float ox = origin[0] - s.x[i], oy = origin[1] - s.y[i], oz = origin[2] - s.z[i];
+        const float b = ox * direction[0] + oy * direction[1] + oz * direction[2];
+        const float c = ox * ox + oy * oy + oz * oz - s.radius[i] * s.radius[i];
+        const float discriminant = b * b - a * c;
+        if (discriminant < 0.0f)
+            return -1.0f;
+        const float root = std::sqrt(discriminant);
+        if ((-b + root) / a < 0.0f)
+            return -1.0f;
+        return std::max((-b - root) / a, 0.0f);
+    }
+
+    // Nearest entry within maxDistance by testing every sphere, or -1.
+    float RaycastAll(const BoundingSpheres& s, const float origin[3], const float direction[3], float maxDistance)
+    {
+        float nearest = -1.0f;
+        for (uint32_t i = 0; i < (uint32_t)s.Size(); ++i)
+        {
+            const float t = RayEntry(s, i, origin, direction);
+            if (t >= 0.0f && t <= maxDistance && (nearest < 0.0f || t < nearest))
+                nearest = t;
+        }
+        return nearest;
+    }
+
+    std::vector<uint32_t> QueryAll(const BoundingSpheres& s, float x, float y, float z, float radius)
+    {
+        std::vector<uint32_t> found;
+        for (uint32_t i = 0; i < (uint32_t)s.Size(); ++i)
+        {
+            const float dx = s.x[i] - x, dy = s.y[i] - y, dz = s.z[i] - z;
+            const float reach = radius + s.radius[i];
+            if (dx * dx + dy * dy + dz * dz <= reach * reach)
+                found.push_back(i);
+        }
+        return found;
+    }
+
+    std::vector<uint32_t> QueryBvh(const SceneBvh& bvh, const BoundingSpheres& s, float x, float y, float z,
+        float radius)
+    {
+        std::vector<uint32_t> found(s.Size());
+        found.resize(bvh.QuerySphere(x, y, z, radius, s, found.data()));
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+}
+
+TEST_CASE(SceneBvhCullMatchesLinearCull)
+{
+    BoundingSpheres spheres;
+    BuildSpheres(spheres, 5000, 4242);
+    SceneBvh bvh;
+    bvh.Build(spheres);
+    CHECK(bvh.GetObjectCount() == 5000);
+
+    bool matches = true;
+    bool refitMatches = true;
+    size_t visibleTotal = 0;
+    for (uint32_t v = 0; v < 24; ++v)
+    {
+        const FrustumPlanes planes = GetOrbitPlanes(0.26f * (float)v, 0.4f - 0.05f * (float)v, 5.0f + (float)v);
+        const std::vector<uint32_t> expected = CullLinear(planes, spheres);
+        matches = matches && CullBvh(bvh, planes, spheres) == expected;
+        visibleTotal += expected.size();
+    }
+    CHECK(matches);
+    CHECK(visibleTotal > 0 && visibleTotal < 24 * spheres.Size());
+
+    // Move every sphere a little and grow some; the refitted tree culls
+    // the same as the linear pass over the new positions.
+    uint32_t state = 777;
+    for (size_t i = 0; i < spheres.Size(); ++i)
+    {
+        spheres.x[i] += Random(state) * 2.0f - 1.0f;
+        spheres.y[i] += Random(state) * 2.0f - 1.0f;
+        spheres.radius[i] *= 1.0f + Random(state);
+    }
+    bvh.Refit(spheres);
+    for (uint32_t v = 0; v < 24; ++v)
+    {
+        const FrustumPlanes planes = GetOrbitPlanes(0.26f * (float)v, 0.3f, 8.0f);
+        refitMatches = refitMatches && CullBvh(bvh, planes, spheres) == CullLinear(planes, spheres);
+    }
+    CHECK(refitMatches);
+}
+
+TEST_CASE(SceneBvhRaycastFindsNearestHit)
+{
+    BoundingSpheres spheres;
+    BuildSpheres(spheres, 3000, 99);
+    SceneBvh bvh;
+    bvh.Build(spheres);
+
+    uint32_t state = 5;
+    uint32_t hits = 0;
+    bool matches = true;
+    for (uint32_t r = 0; r < 1000; ++r)
+    {
+        // From outside the cloud, inside it and from a sphere's centre.
+        float origin[3], direction[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            origin[k] = Random(state) * 60.0f - 30.0f;
+            direction[k] = Random(state) * 2.0f - 1.0f;
+        }
+        if (r % 10 == 0)
+        {
+            origin[0] = spheres.x[r];
+            origin[1] = spheres.y[r];
+            origin[2] = spheres.z[r];
+        }
+        const float maxDistance = r % 2 ? 100.0f : 5.0f;
+
+        BvhRayHit hit;
+        const bool found = bvh.Raycast(origin, direction, maxDistance, spheres, hit);
+        const float expected = RaycastAll(spheres, origin, direction, maxDistance);
+        if (found != (expected >= 0.0f))
+        {
+            matches = false;
+            continue;
+        }
+        if (!found)
+            continue;
+
+        // Ties may go to either sphere, but the reported one is hit there.
+        ++hits;
+        matches = matches && hit.distance == expected && hit.index < spheres.Size() &&
+            RayEntry(spheres, hit.index, origin, direction) == expected;
+        if (r % 10 == 0)
+            matches = matches && hit.distance == 0.0f;
+    }
+    CHECK(matches);
+    CHECK(hits > 100 && hits < 1000);
+}
+
+TEST_CASE(SceneBvhQuerySphereMatchesBruteForce)
+{
+    BoundingSpheres spheres;
+    BuildSpheres(spheres, 3000, 1234);
+    SceneBvh bvh;
+    bvh.Build(spheres);
+
+    uint32_t state = 31;
+    bool matches = true;
+    size_t foundTotal = 0;
+    for (uint32_t q = 0; q < 200; ++q)
+    {
+        const float x = Random(state) * 50.0f - 25.0f;
+        const float y = Random(state) * 50.0f - 25.0f;
+        const float z = Random(state) * 50.0f - 25.0f;
+        const float radius = q % 4 == 0 ? 0.0f : Random(state) * 6.0f;
+        const std::vector<uint32_t> expected = QueryAll(spheres, x, y, z, radius);
+        matches = matches && QueryBvh(bvh, spheres, x, y, z, radius) == expected;
+        foundTotal += expected.size();
+    }
+    CHECK(matches);
+    CHECK(foundTotal > 0);
+
+    // Large enough to hold everything.
+    CHECK(QueryBvh(bvh, spheres, 0.0f, 0.0f, 0.0f, 100.0f).size() == spheres.Size());
+}
+
+TEST_CASE(SceneBvhPicksTheCubeUnderThePoint)
+{
+    LabScene scene;
+    scene.SetCubeCount(401);
+    const float aspect = 16.0f / 9.0f;
+    SceneMatrices matrices;
+    scene.ComputeMatrices(aspect, matrices);
+    const BoundingSpheres& bounds = scene.GetBounds();
+
+    uint32_t picked = 0;
+    bool matches = true;
+    for (uint32_t i = 0; i < scene.GetCubeCount(); i += 7)
+    {
+        // Aim at the cube's centre; the nearest sphere along that ray is
+        // the one picked, the cube itself unless another is in front.
+        const float centre[3] = { bounds.x[i], bounds.y[i], bounds.z[i] };
+        float clip[4];
+        TransformPoint(matrices.viewProj, centre, clip);
+        if (!(clip[3] > 0.0f) || std::fabs(clip[0]) > clip[3] || std::fabs(clip[1]) > clip[3])
+            continue;
+
+        const float direction[3] = { centre[0] - matrices.eye[0], centre[1] - matrices.eye[1],
+            centre[2] - matrices.eye[2] };
+        const uint32_t index = scene.PickCube(clip[0] / clip[3], clip[1] / clip[3], aspect);
+        if (index == LabScene::NO_CUBE)
+        {
+            matches = false;
+            continue;
+        }
+        ++picked;
+        const float t = RayEntry(bounds, index, matrices.eye, direction);
+        matches = matches && t >= 0.0f && t <= RayEntry(bounds, i, matrices.eye, direction) + 1e-3f;
+    }
+    CHECK(matches);
+    CHECK(picked > 10);
+
+    scene.SelectCube(3);
+    CHECK(scene.GetSelectedCube() == 3);
+    scene.SelectCube(LabScene::NO_CUBE);
+    CHECK(scene.GetSelectedCube() == LabScene::NO_CUBE);
+}
+
+TEST_CASE(SceneBvhHandlesDegenerateInputs)
+{
+    const float origin[3] = { 0.0f, 0.0f, -10.0f };
+    const float forward[3] = { 0.0f, 0.0f, 1.0f };
+    const float zero[3] = { 0.0f, 0.0f, 0.0f };
+    const FrustumPlanes planes = GetOrbitPlanes(0.0f, 0.0f, 5.0f);
+    uint32_t out[64];
+    BvhRayHit hit;
+
+    // No objects: every query finds nothing.
+    BoundingSpheres spheres;
+    SceneBvh bvh;
+    bvh.Build(spheres);
+    CHECK(bvh.GetObjectCount() == 0);
+    CHECK(bvh.CullFrustum(planes, spheres, out) == 0);
+    CHECK(!bvh.Raycast(origin, forward, 100.0f, spheres, hit));
+    CHECK(bvh.QuerySphere(0.0f, 0.0f, 0.0f, 10.0f, spheres, out) == 0);
+    bvh.Refit(spheres);
+    CHECK(bvh.GetObjectCount() == 0);
+
+    // Forty spheres in one place, some of them points; the build cannot
+    // split them by position and must still terminate with all of them.
+    spheres.Resize(40);
+    for (uint32_t i = 0; i < 40; ++i)
+    {
+        spheres.x[i] = 1.0f;
+        spheres.y[i] = 2.0f;
+        spheres.z[i] = 3.0f;
+        spheres.radius[i] = i % 4 == 0 ? 0.0f : 0.5f;
+    }
+    bvh.Build(spheres);
+    CHECK(bvh.GetObjectCount() == 40);
+    CHECK(bvh.QuerySphere(1.0f, 2.0f, 3.0f, 0.0f, spheres, out) == 40);
+    CHECK(bvh.Raycast(origin, forward, 100.0f, spheres, hit) == false);
+    const float toCluster[3] = { 1.0f, 2.0f, 13.0f };
+    CHECK(bvh.Raycast(origin, toCluster, 100.0f, spheres, hit) && hit.index % 4 != 0);
+    CHECK(!bvh.Raycast(origin, zero, 100.0f, spheres, hit));
+
+    // A ray starting inside a sphere hits it at once; one that stops short
+    // hits nothing.
+    const float inside[3] = { 1.0f, 2.0f, 3.2f };
+    CHECK(bvh.Raycast(inside, forward, 100.0f, spheres, hit) && hit.distance == 0.0f);
+    CHECK(!bvh.Raycast(origin, toCluster, 0.9f, spheres, hit));
+
+    // Refit with a different count builds again.
+    BuildSpheres(spheres, 64, 3);
+    bvh.Refit(spheres);
+    CHECK(bvh.GetObjectCount() == 64);
+    CHECK(QueryBvh(bvh, spheres, 0.0f, 0.0f, 0.0f, 100.0f).size() == 64);
+}
@@ -0,0 +1,189 @@
+#include "Test.h"
+#include "SceneTransforms.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const TransformKernel KERNELS[] = { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX2 };
+
+    // None of them a whole number of AVX2 steps.
+    const size_t COUNTS[] = { 1, 3, 5, 7, 9, 12, 15, 17, 33, 1001 };
+
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Objects with every field different: unit quaternions in any
+    // orientation, uneven and negative scales, and tints.
+    void MakeScene(size_t count, uint32_t seed, SceneTransforms& scene)
+    {
+        scene.Resize(count);
+        uint32_t state = seed;
+        for (size_t i = 0; i < count; ++i)
+        {
+            scene.SetPosition(i, Random(state) * 200.0f - 100.0f, Random(state) * 20.0f, Random(state) * -50.0f);
+            const float qx = Random(state) - 0.5f, qy = Random(state) - 0.5f;
+            const float qz = Random(state) - 0.5f, qw = Random(state) - 0.5f;
+            const float length = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+            scene.SetRotation(i, qx / length, qy / length, qz / length, qw / length);
+            scene.SetScale(i, 0.1f + Random(state) * 3.0f, -0.5f - Random(state), 0.25f + Random(state));
+            scene.SetTint(i, Random(state), Random(state), Random(state), Random(state));
+            scene.material[i] = (uint32_t)(i / 7);
+        }
+    }
+
+    // Records from kernel, with one guard record past the end that must
+    // come back untouched.
+    std::vector<InstanceData> Compute(const SceneTransforms& scene, size_t first, size_t count,
+        TransformKernel kernel)
+    {
+        std::vector<InstanceData> records(count + 1);
+        memset(records.data(), 0xcd, records.size() * sizeof(InstanceData));
+        ComputeInstanceData(scene, first, count, records.data(), kernel);
+        return records;
+    }
+
+    std::vector<InstanceData> ComputeOrdered(const SceneTransforms& scene, const std::vector<uint32_t>& order,
+        TransformKernel kernel)
+    {
+        std::vector<InstanceData> records(order.size() + 1);
+        memset(records.data(), 0xcd, records.size() * sizeof(InstanceData));
+        ComputeInstanceDataOrdered(scene, order.data(), order.size(), records.data(), kernel);
+        return records;
+    }
+
+    bool SameBits(const std::vector<InstanceData>& a, const std::vector<InstanceData>& b)
+    {
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(InstanceData)) == 0;
+    }
+
+    // Where the record sends p: dot(world[r], (p, 1)) per component.
+    void TransformByRecord(const InstanceData& record, const float p[3], float out[3])
+    {
+        for (int r = 0; r < 3; ++r)
+            out[r] = record.world[r][0] * p[0] + record.world[r][1] * p[1] + record.world[r][2] * p[2] +
+                record.world[r][3];
+    }
+
+    bool Near(float a, float b)
+    {
+        return std::fabs(a - b) <= 1e-5f * (1.0f + std::fabs(b));
+    }
+}
+
+TEST_CASE(TransformKernelsMatchScalar)
+{
+    for (size_t count : COUNTS)
+    {
+        SceneTransforms scene;
+        MakeScene(count + 11, (uint32_t)count, scene);
+        // From the start and from an object off any vector boundary.
+        const size_t firsts[] = { 0, 3, 11 };
+        for (size_t first : firsts)
+        {
+            const std::vector<InstanceData> scalar = Compute(scene, first, count, TRANSFORM_KERNEL_SCALAR);
+            uint8_t guard[sizeof(InstanceData)];
+            memset(guard, 0xcd, sizeof(guard));
+            CHECK(memcmp(&scalar[count], guard, sizeof(guard)) == 0);
+            for (TransformKernel kernel : KERNELS)
+            {
+                if (IsTransformKernelSupported(kernel))
+                    CHECK(SameBits(Compute(scene, first, count, kernel), scalar));
+            }
+        }
+    }
+}
+
+TEST_CASE(TransformOrderedKernelsMatchScalar)
+{
+    // Orders as the transparency sort hands them over: any permutation,
+    // and the same object more than once.
+    for (size_t count : COUNTS)
+    {
+        SceneTransforms scene;
+        MakeScene(count, (uint32_t)count * 5 + 1, scene);
+        std::vector<uint32_t> order(count);
+        uint32_t state = (uint32_t)count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            state = state * 1664525u + 1013904223u;
+            order[i] = (uint32_t)((state >> 8) % count);
+        }
+
+        const std::vector<InstanceData> scalar = ComputeOrdered(scene, order, TRANSFORM_KERNEL_SCALAR);
+        // Record n is object order[n]'s.
+        bool matchesObjects = true;
+        for (size_t n = 0; n < count; ++n)
+        {
+            const std::vector<InstanceData> one = Compute(scene, order[n], 1, TRANSFORM_KERNEL_SCALAR);
+            matchesObjects = matchesObjects && memcmp(&one[0], &scalar[n], sizeof(InstanceData)) == 0;
+        }
+        CHECK(matchesObjects);
+        for (TransformKernel kernel : KERNELS)
+        {
+            if (IsTransformKernelSupported(kernel))
+                CHECK(SameBits(ComputeOrdered(scene, order, kernel), scalar));
+        }
+    }
+}
+
+TEST_CASE(TransformRecordsAreScaleRotationTranslation)
+{
+    // Scale 2, a quarter turn of yaw and a move to (1, 2, 3): +x goes to
+    // -z, +z to +x, +y stays.
+    SceneTransforms scene;
+    scene.Resize(2);
+    scene.SetPosition(0, 1.0f, 2.0f, 3.0f);
+    scene.SetRotationYaw(0, 3.14159265f * 0.5f);
+    scene.SetScale(0, 2.0f);
+    scene.SetTint(0, 0.25f, 0.5f, 0.75f, 0.5f);
+    const std::vector<InstanceData> records = Compute(scene, 0, 2, TRANSFORM_KERNEL_SCALAR);
+
+    const float points[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+    const float expected[3][3] = { { 1.0f, 2.0f, 1.0f }, { 1.0f, 4.0f, 3.0f }, { 3.0f, 2.0f, 3.0f } };
+    for (int p = 0; p < 3; ++p)
+    {
+        float out[3];
+        TransformByRecord(records[0], points[p], out);
+        CHECK(Near(out[0], expected[p][0]) && Near(out[1], expected[p][1]) && Near(out[2], expected[p][2]));
+    }
+    CHECK(records[0].tint[0] == 0.25f && records[0].tint[1] == 0.5f && records[0].tint[2] == 0.75f &&
+        records[0].tint[3] == 0.5f);
+
+    // A default object is the identity, opaque white.
+    const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 1, 1, 1, 1 } };
+    CHECK(memcmp(records[1].world, identity, sizeof(records[1].world)) == 0);
+    CHECK(memcmp(records[1].tint, identity[3], sizeof(records[1].tint)) == 0);
+
+    // Any unit quaternion gives a rotation: with the scales divided out,
+    // the columns are orthonormal and right-handed.
+    SceneTransforms random;
+    MakeScene(64, 7, random);
+    const std::vector<InstanceData> randomRecords = Compute(random, 0, 64, TRANSFORM_KERNEL_SCALAR);
+    bool rotations = true;
+    for (size_t i = 0; i < 64; ++i)
+    {
+        const float scale[3] = { random.scaleX[i], random.scaleY[i], random.scaleZ[i] };
+        float m[3][3];
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+                m[r][c] = randomRecords[i].world[r][c] / scale[c];
+        }
+        for (int a = 0; a < 3; ++a)
+        {
+            for (int b = 0; b < 3; ++b)
+            {
+                const float dot = m[0][a] * m[0][b] + m[1][a] * m[1][b] + m[2][a] * m[2][b];
+                rotations = rotations && std::fabs(dot - (a == b ? 1.0f : 0.0f)) < 1e-5f;
+            }
+        }
+        const float det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+            m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        rotations = rotations && det > 0.0f;
+    }
+    CHECK(rotations);
+}
@@ -0,0 +1,198 @@
+#include "Test.h"
+#include "ShaderCache.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const char* const SOURCE_A = "float4 main() : SV_Target { return 1; }";
+    const char* const SOURCE_B = "float4 main() : SV_Target { return 0; }";
+    const char* const SOURCE_BROKEN = "float4 main() : SV_Target { error }";
+
+    // Stands in for D3DCompile: the bytecode is the source text and entry
+    // point, and any text containing "error" fails.
+    struct StubCompiler
+    {
+        uint32_t calls = 0;
+
+        ShaderCompileFn GetFn()
+        {
+            return [this](const ShaderSource& source, std::vector<uint8_t>& bytecode, std::string& errors)
+            {
+                ++calls;
+                const std::string text(source.pText, source.textSize);
+                if (text.find("error") != std::string::npos)
+                {
+                    errors = "stub: syntax error";
+                    return false;
+                }
+                const std::string blob = text + "|" + source.entryPoint;
+                bytecode.assign(blob.begin(), blob.end());
+                return true;
+            };
+        }
+    };
+
+    ShaderSource MakeSource(const char* pText)
+    {
+        ShaderSource source;
+        source.pText = pText;
+        source.textSize = strlen(pText);
+        source.entryPoint = "main";
+        source.target = "ps_5_0";
+        return source;
+    }
+
+    std::string GetArchivePath(const char* name)
+    {
+        const std::string path = GetScratchPath(name);
+        remove(path.c_str());
+        return path;
+    }
+}
+
+TEST_CASE(ShaderCacheCompilesOnceAndReusesTheArchive)
+{
+    const std::string path = GetArchivePath("shader_cache_reuse.bin");
+    StubCompiler compiler;
+    std::vector<uint8_t> first;
+    {
+        ShaderCache cache(compiler.GetFn(), "stub-1");
+        CHECK(cache.Open(path));
+        CHECK(cache.Compile(MakeSource(SOURCE_A), first));
+
+        std::vector<uint8_t> again;
+        CHECK(cache.Compile(MakeSource(SOURCE_A), again));
+        CHECK(again == first);
+        CHECK(compiler.calls == 1);
+        CHECK(cache.GetStats().hits == 1 && cache.GetStats().misses == 1);
+        CHECK(cache.Save());
+    }
+
+    ShaderCache reopened(compiler.GetFn(), "stub-1");
+    CHECK(reopened.Open(path));
+    CHECK(reopened.GetEntryCount() == 1);
+    std::vector<uint8_t> cached;
+    CHECK(reopened.Compile(MakeSource(SOURCE_A), cached));
+    CHECK(cached == first);
+    CHECK(compiler.calls == 1);
+    CHECK(reopened.GetStats().GetHitRate() == 1.0);
+}
+
+TEST_CASE(ShaderCacheKeyCoversEveryInput)
+{
+    StubCompiler compiler;
+    ShaderCache cache(compiler.GetFn(), "stub-1");
+    const ShaderSource base = MakeSource(SOURCE_A);
+    const uint64_t key = cache.ComputeKey(base);
+
+    ShaderSource text = MakeSource(SOURCE_B);
+    ShaderSource entry = base;
+    entry.entryPoint = "other";
+    ShaderSource target = base;
+    target.target = "ps_4_0";
+    ShaderSource flags = base;
+    flags.flags = 1;
+
+    const ShaderDefine defines[] = { { "FOG", "1" }, { nullptr, nullptr } };
+    const ShaderDefine otherValue[] = { { "FOG", "0" }, { nullptr, nullptr } };
+    ShaderSource defined = base;
+    defined.pDefines = defines;
+    ShaderSource redefined = base;
+    redefined.pDefines = otherValue;
+
+    CHECK(cache.ComputeKey(text) != key);
+    CHECK(cache.ComputeKey(entry) != key);
+    CHECK(cache.ComputeKey(target) != key);
+    CHECK(cache.ComputeKey(flags) != key);
+    CHECK(cache.ComputeKey(defined) != key);
+    CHECK(cache.ComputeKey(redefined) != cache.ComputeKey(defined));
+
+    ShaderCache newerCompiler(compiler.GetFn(), "stub-2");
+    CHECK(newerCompiler.ComputeKey(base) != key);
+
+    // An empty define list is the same as none.
+    const ShaderDefine none[] = { { nullptr, nullptr } };
+    ShaderSource empty = base;
+    empty.pDefines = none;
+    CHECK(cache.ComputeKey(empty) == key);
+}
+
+TEST_CASE(ShaderCacheNeverStoresFailures)
+{
+    StubCompiler compiler;
+    ShaderCache cache(compiler.GetFn(), "stub-1");
+    CHECK(cache.Open(GetArchivePath("shader_cache_failures.bin")));
+
+    std::vector<uint8_t> bytecode;
+    std::string errors;
+    CHECK(!cache.Compile(MakeSource(SOURCE_BROKEN), bytecode, &errors));
+    CHECK(!errors.empty());
+    CHECK(!cache.Compile(MakeSource(SOURCE_BROKEN), bytecode));
+    CHECK(compiler.calls == 2);
+    CHECK(cache.GetStats().failures == 2);
+    CHECK(cache.GetEntryCount() == 0);
+}
+
+TEST_CASE(ShaderCacheSaveDropsUnusedEntries)
+{
+    const std::string path = GetArchivePath("shader_cache_prune.bin");
+    StubCompiler compiler;
+    std::vector<uint8_t> bytecode;
+    {
+        ShaderCache cache(compiler.GetFn(), "stub-1");
+        cache.Open(path);
+        cache.Compile(MakeSource(SOURCE_A), bytecode);
+        cache.Compile(MakeSource(SOURCE_B), bytecode);
+        CHECK(cache.Save());
+    }
+    {
+        ShaderCache cache(compiler.GetFn(), "stub-1");
+        cache.Open(path);
+        CHECK(cache.GetEntryCount() == 2);
+        cache.Compile(MakeSource(SOURCE_B), bytecode);
+        CHECK(cache.Save());
+    }
+
+    ShaderCache cache(compiler.GetFn(), "stub-1");
+    cache.Open(path);
+    CHECK(cache.GetEntryCount() == 1);
+    CHECK(cache.Compile(MakeSource(SOURCE_B), bytecode));
+    CHECK(cache.GetStats().hits == 1);
+}
+
+TEST_CASE(ShaderCacheDiscardsDamagedArchives)
+{
+    const std::string path = GetArchivePath("shader_cache_damaged.bin");
+    StubCompiler compiler;
+    std::vector<uint8_t> bytecode;
+    {
+        ShaderCache cache(compiler.GetFn(), "stub-1");
+        cache.Open(path);
+        cache.Compile(MakeSource(SOURCE_A), bytecode);
+        CHECK(cache.Save());
+    }
+
+    // Flip the last bytecode byte so the entry checksum no longer matches.
+    FILE* pFile = fopen(path.c_str(), "r+b");
+    if (!CHECK(pFile != nullptr))
+        return;
+    fseek(pFile, -1, SEEK_END);
+    const int last = fgetc(pFile);
+    fseek(pFile, -1, SEEK_END);
+    fputc(last ^ 0xff, pFile);
+    fclose(pFile);
+
+    ShaderCache cache(compiler.GetFn(), "stub-1");
+    CHECK(cache.Open(path));
+    CHECK(cache.GetEntryCount() == 0);
+    std::vector<uint8_t> rebuilt;
+    CHECK(cache.Compile(MakeSource(SOURCE_A), rebuilt));
+    CHECK(rebuilt == bytecode);
+    CHECK(compiler.calls == 2);
+    CHECK(cache.Save());
+
+    ShaderCache repaired(compiler.GetFn(), "stub-1");
+    repaired.Open(path);
+    CHECK(repaired.GetEntryCount() == 1);
+}
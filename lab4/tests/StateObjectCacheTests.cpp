@@ -0,0 +1,163 @@
+#include "Test.h"
+#include "StateObjectCache.h"
+#include <memory>
+
+namespace
+{
+    // Shaped like a D3D11 descriptor: enums, flags and floats, zeroed
+    // before use.
+    struct FakeDesc
+    {
+        uint32_t fillMode;
+        uint32_t cullMode;
+        int32_t depthBias;
+        float slopeScaledDepthBias;
+        uint8_t writeMask[8];
+        uint64_t flags;
+    };
+
+    struct FakeState
+    {
+        FakeDesc desc;
+        uint32_t references = 1;
+        uint32_t* pReleased = nullptr;
+
+        void Release()
+        {
+            if (--references == 0)
+                ++*pReleased;
+        }
+    };
+
+    // The D3D device's Create*State, counting its calls. Objects live in
+    // states so the test can look at them after the cache let go.
+    struct CountingCreate
+    {
+        std::vector<std::unique_ptr<FakeState>>* pStates;
+        uint32_t* pReleased;
+        uint32_t* pCreates;
+
+        FakeState* operator()(const FakeDesc& desc) const
+        {
+            ++*pCreates;
+            pStates->emplace_back(new FakeState());
+            pStates->back()->desc = desc;
+            pStates->back()->pReleased = pReleased;
+            return pStates->back().get();
+        }
+    };
+
+    FakeDesc MakeDesc(uint32_t seed)
+    {
+        FakeDesc desc = {};
+        desc.fillMode = 2 + seed % 2;
+        desc.cullMode = 1 + seed % 3;
+        desc.depthBias = (int32_t)seed - 7;
+        desc.slopeScaledDepthBias = 0.25f * seed;
+        desc.writeMask[seed % 8] = 0x0f;
+        desc.flags = seed;
+        return desc;
+    }
+}
+
+TEST_CASE(StateObjectCacheCreatesOncePerDescriptor)
+{
+    std::vector<std::unique_ptr<FakeState>> states;
+    uint32_t released = 0;
+    uint32_t creates = 0;
+    const CountingCreate create = { &states, &released, &creates };
+
+    StateObjectCache<FakeDesc, FakeState> cache;
+    std::vector<FakeState*> first;
+    for (uint32_t seed = 0; seed < 20; ++seed)
+        first.push_back(cache.Acquire(MakeDesc(seed), create));
+    CHECK(creates == 20 && cache.GetSize() == 20);
+    CHECK(cache.GetMisses() == 20 && cache.GetHits() == 0);
+
+    // Every later lookup, from a fresh copy of the descriptor, is a hit
+    // that hands back the first pointer.
+    bool same = true;
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        for (uint32_t seed = 0; seed < 20; ++seed)
+        {
+            const FakeDesc desc = MakeDesc(seed);
+            same = same && cache.Acquire(desc, create) == first[seed];
+        }
+    }
+    CHECK(same);
+    CHECK(creates == 20);
+    CHECK(cache.GetHits() == 60 && cache.GetMisses() == 20);
+
+    bool distinct = true;
+    for (uint32_t i = 0; i < first.size(); ++i)
+    {
+        for (uint32_t j = i + 1; j < first.size(); ++j)
+            distinct = distinct && first[i] != first[j];
+    }
+    CHECK(distinct);
+
+    cache.ResetCounters();
+    CHECK(cache.GetHits() == 0 && cache.GetMisses() == 0 && cache.GetSize() == 20);
+}
+
+TEST_CASE(StateObjectCacheKeepsOneByteDifferencesApart)
+{
+    std::vector<std::unique_ptr<FakeState>> states;
+    uint32_t released = 0;
+    uint32_t creates = 0;
+    const CountingCreate create = { &states, &released, &creates };
+
+    StateObjectCache<FakeDesc, FakeState> cache;
+    const FakeDesc base = MakeDesc(5);
+    FakeState* pBase = cache.Acquire(base, create);
+
+    // Every byte of the descriptor takes part: changing any one of them is
+    // a new object carrying that exact descriptor.
+    bool distinct = true;
+    for (size_t i = 0; i < sizeof(FakeDesc); ++i)
+    {
+        FakeDesc desc = base;
+        ((uint8_t*)&desc)[i] ^= 0x01;
+        FakeState* pState = cache.Acquire(desc, create);
+        distinct = distinct && pState && pState != pBase && memcmp(&pState->desc, &desc, sizeof(desc)) == 0;
+    }
+    CHECK(distinct);
+    CHECK(creates == 1 + sizeof(FakeDesc));
+    CHECK(cache.GetSize() == 1 + sizeof(FakeDesc));
+    CHECK(cache.Acquire(base, create) == pBase);
+    CHECK(cache.GetHits() == 1);
+}
+
+TEST_CASE(StateObjectCacheReleasesWhatItOwns)
+{
+    std::vector<std::unique_ptr<FakeState>> states;
+    uint32_t released = 0;
+    uint32_t creates = 0;
+    const CountingCreate create = { &states, &released, &creates };
+    {
+        StateObjectCache<FakeDesc, FakeState> cache;
+
+        // A failed create is a miss that caches nothing; the next lookup
+        // tries again.
+        const FakeDesc desc = MakeDesc(1);
+        CHECK(cache.Acquire(desc, [&creates](const FakeDesc&) -> FakeState* {
+            ++creates;
+            return nullptr;
+        }) == nullptr);
+        CHECK(cache.GetSize() == 0 && cache.GetMisses() == 1);
+        CHECK(cache.Acquire(desc, create) != nullptr);
+        CHECK(creates == 2 && cache.GetMisses() == 2);
+
+        for (uint32_t seed = 2; seed < 10; ++seed)
+            cache.Acquire(MakeDesc(seed), create);
+        CHECK(released == 0);
+
+        // Clear drops the cache's reference to each object exactly once.
+        cache.Clear();
+        CHECK(released == 9 && cache.GetSize() == 0);
+        cache.Acquire(MakeDesc(1), create);
+        CHECK(creates == 11);
+    }
+    CHECK(released == 10);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal self-registering checks for the portable lab4 code. A failed
+// CHECK prints its location and marks the running test failed; the test
+// carries on unless it returns on the CHECK's result.
+
+typedef void (*TestFn)();
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, TestFn fn);
+};
+
+bool ReportFailure(const char* file, int line, const char* expression);
+
+// The shipped lab4 textures, with a trailing slash.
+std::string GetTextureDir();
+
+// A file in the build directory that a test may create and overwrite.
+std::string GetScratchPath(const char* name);
+
+// Whole-file helpers for building damaged fixtures from good ones.
+bool ReadTestFile(const std::string& path, std::vector<uint8_t>& bytes);
+bool WriteTestFile(const std::string& path, const std::vector<uint8_t>& bytes);
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+// Evaluates to the condition, so `if (!CHECK(...)) return;` stops a test
+// whose later checks depend on it.
+#define CHECK(condition) \
+    ((condition) ? true : ReportFailure(__FILE__, __LINE__, #condition))
@@ -0,0 +1,92 @@
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct TestEntry
+    {
+        const char* name;
+        TestFn fn;
+    };
+
+    std::vector<TestEntry>& GetTests()
+    {
+        static std::vector<TestEntry> s_tests;
+        return s_tests;
+    }
+
+    uint32_t g_failures = 0;
+}
+
+TestRegistrar::TestRegistrar(const char* name, TestFn fn)
+{
+    GetTests().push_back(TestEntry{ name, fn });
+}
+
+bool ReportFailure(const char* file, int line, const char* expression)
+{
+    printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+    ++g_failures;
+    return false;
+}
+
+std::string GetTextureDir()
+{
+    return LAB4_TEXTURE_DIR;
+}
+
+std::string GetScratchPath(const char* name)
+{
+    return std::string(LAB4_SCRATCH_DIR) + name;
+}
+
+bool ReadTestFile(const std::string& path, std::vector<uint8_t>& bytes)
+{
+    FILE* pFile = fopen(path.c_str(), "rb");
+    if (!pFile)
+        return false;
+    fseek(pFile, 0, SEEK_END);
+    bytes.resize((size_t)ftell(pFile));
+    fseek(pFile, 0, SEEK_SET);
+    const bool ok = bytes.empty() || fread(bytes.data(), bytes.size(), 1, pFile) == 1;
+    fclose(pFile);
+    return ok;
+}
+
+bool WriteTestFile(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    FILE* pFile = fopen(path.c_str(), "wb");
+    if (!pFile)
+        return false;
+    const bool ok = bytes.empty() || fwrite(bytes.data(), bytes.size(), 1, pFile) == 1;
+    return fclose(pFile) == 0 && ok;
+}
+
+// Runs every test, or those whose name contains one of the arguments.
+// Exits non-zero if any check failed.
+int main(int argc, char** argv)
+{
+    uint32_t run = 0;
+    uint32_t failed = 0;
+    for (const TestEntry& test : GetTests())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; ++i)
+            selected = strstr(test.name, argv[i]) != nullptr;
+        if (!selected)
+            continue;
+
+        const uint32_t failuresBefore = g_failures;
+        test.fn();
+        const bool passed = g_failures == failuresBefore;
+        printf("[%s] %s\n", passed ? "  OK  " : " FAIL ", test.name);
+        ++run;
+        if (!passed)
+            ++failed;
+    }
+
+    printf("%u of %u tests passed\n", run - failed, run);
+    return failed == 0 && run > 0 ? 0 : 1;
+}
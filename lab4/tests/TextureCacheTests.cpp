@@ -0,0 +1,226 @@
+#include "Test.h"
+#include "DdsWriter.h"
+#include "TextureCache.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+    // Stands in for a backend's texture: which load made it and from how
+    // many mips.
+    struct FakeTexture
+    {
+        uint32_t load;
+        uint32_t mipCount;
+    };
+
+    typedef TextureCache<FakeTexture> FakeCache;
+
+    struct CountingLoader
+    {
+        std::atomic<uint32_t> loads{ 0 };
+        bool fail = false;
+        uint32_t delayMs = 0;
+
+        FakeCache::LoadFn GetFn()
+        {
+            return [this](const DdsView* pViews, uint32_t viewCount, uint64_t& bytes) -> FakeCache::Handle
+            {
+                const uint32_t load = ++loads;
+                if (delayMs)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+                if (fail)
+                    return nullptr;
+                bytes = 0;
+                for (uint32_t i = 0; i < viewCount; ++i)
+                    bytes += pViews[i].GetMappedSize();
+                return std::make_shared<FakeTexture>(FakeTexture{ load, pViews[0].GetMipCount() });
+            };
+        }
+    };
+
+    std::wstring Widen(const std::string& path)
+    {
+        return std::wstring(path.begin(), path.end());
+    }
+
+    std::wstring GetLab4Texture(const char* name)
+    {
+        return Widen(GetTextureDir() + name);
+    }
+
+    // lab5 ships byte-identical copies of lab4's textures.
+    std::wstring GetLab5Texture(const char* name)
+    {
+        return Widen(GetTextureDir() + "../../lab5/texture/" + name);
+    }
+
+    bool WriteFixture(const std::string& path, uint32_t size, uint8_t fill)
+    {
+        DdsWriteDesc desc;
+        desc.format = DXGI_FORMAT_BC1_UNORM;
+        desc.width = size;
+        desc.height = size;
+        std::vector<uint8_t> data(DdsGetDataSize(desc), fill);
+        return WriteDds(path.c_str(), desc, data.data(), data.size());
+    }
+}
+
+TEST_CASE(TextureCacheLoadsIdenticalFilesOnce)
+{
+    FakeCache cache;
+    CountingLoader loader;
+
+    FakeCache::Handle a = cache.Acquire(GetLab4Texture("wood02.dds"), 0, loader.GetFn());
+    FakeCache::Handle b = cache.Acquire(GetLab5Texture("wood02.dds"), 0, loader.GetFn());
+    FakeCache::Handle c = cache.Acquire(GetLab4Texture("wood02.dds"), 0, loader.GetFn());
+    if (!CHECK(a != nullptr))
+        return;
+    CHECK(a == b && a == c);
+    CHECK(loader.loads == 1);
+
+    const TextureCacheStats stats = cache.GetStats();
+    CHECK(stats.lookups == 3 && stats.loads == 1);
+    CHECK(stats.contentHits == 1);      // the lab5 copy, opened and hashed
+    CHECK(stats.pathHits == 1);         // the same path again, not opened
+    CHECK(stats.bytesShared == 2 * stats.bytesLoaded);
+
+    // A different texture is a different entry.
+    FakeCache::Handle other = cache.Acquire(GetLab4Texture("wood.dds"), 0, loader.GetFn());
+    CHECK(other != nullptr && other != a);
+    CHECK(loader.loads == 2);
+}
+
+TEST_CASE(TextureCacheKeysOnScopeAndQuality)
+{
+    FakeCache cache;
+    CountingLoader loader;
+    const std::wstring path = GetLab4Texture("wood02.dds");
+
+    FakeCache::Handle full = cache.Acquire(path, 1, loader.GetFn());
+    FakeCache::Handle otherScope = cache.Acquire(path, 2, loader.GetFn());
+    TextureQuality reduced;
+    reduced.dropMips = 1;
+    FakeCache::Handle low = cache.Acquire(path, 1, loader.GetFn(), reduced);
+    FakeCache::Handle lowAgain = cache.Acquire(GetLab5Texture("wood02.dds"), 1, loader.GetFn(), reduced);
+
+    if (!CHECK(full && otherScope && low))
+        return;
+    CHECK(full != otherScope && full != low);
+    CHECK(low == lowAgain);
+    CHECK(loader.loads == 3);
+    CHECK(cache.GetEntries().size() == 3);
+}
+
+TEST_CASE(TextureCacheSharesCubemapsAcrossPaths)
+{
+    const char* faceNames[6] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+    std::wstring lab4Faces[6];
+    std::wstring lab5Faces[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        lab4Faces[i] = GetLab4Texture((std::string("skybox/") + faceNames[i] + ".dds").c_str());
+        lab5Faces[i] = GetLab5Texture((std::string("skybox/") + faceNames[i] + ".dds").c_str());
+    }
+
+    FakeCache cache;
+    CountingLoader loader;
+    FakeCache::Handle a = cache.Acquire(lab4Faces, 6, 0, loader.GetFn());
+    FakeCache::Handle b = cache.Acquire(lab5Faces, 6, 0, loader.GetFn());
+    CHECK(a != nullptr && a == b);
+    CHECK(loader.loads == 1);
+
+    // The same faces in another order are another cube.
+    std::swap(lab4Faces[0], lab4Faces[1]);
+    FakeCache::Handle swapped = cache.Acquire(lab4Faces, 6, 0, loader.GetFn());
+    CHECK(swapped != nullptr && swapped != a);
+}
+
+TEST_CASE(TextureCacheReloadsChangedFiles)
+{
+    const std::string path = GetScratchPath("texture_cache_edit.dds");
+    if (!CHECK(WriteFixture(path, 16, 0x11)))
+        return;
+
+    FakeCache cache;
+    CountingLoader loader;
+    FakeCache::Handle before = cache.Acquire(Widen(path), 0, loader.GetFn());
+
+    // A different size changes the stamp even within the mtime's resolution.
+    if (!CHECK(WriteFixture(path, 32, 0x22)))
+        return;
+    FakeCache::Handle after = cache.Acquire(Widen(path), 0, loader.GetFn());
+    CHECK(before && after && before != after);
+    CHECK(loader.loads == 2);
+    CHECK(cache.GetStats().pathHits == 0);
+}
+
+TEST_CASE(TextureCacheDoesNotKeepFailures)
+{
+    FakeCache cache;
+    CountingLoader loader;
+
+    CHECK(cache.Acquire(GetLab4Texture("missing.dds"), 0, loader.GetFn()) == nullptr);
+    CHECK(loader.loads == 0);
+
+    loader.fail = true;
+    CHECK(cache.Acquire(GetLab4Texture("wood02.dds"), 0, loader.GetFn()) == nullptr);
+    loader.fail = false;
+    CHECK(cache.Acquire(GetLab4Texture("wood02.dds"), 0, loader.GetFn()) != nullptr);
+    CHECK(loader.loads == 2);
+    CHECK(cache.GetStats().failures == 2);
+}
+
+TEST_CASE(TextureCacheTrimKeepsHeldEntries)
+{
+    FakeCache cache;
+    CountingLoader loader;
+    FakeCache::Handle held = cache.Acquire(GetLab4Texture("wood02.dds"), 0, loader.GetFn());
+    cache.Acquire(GetLab4Texture("wood.dds"), 0, loader.GetFn());
+
+    std::vector<TextureCacheEntryInfo> entries = cache.GetEntries();
+    CHECK(entries.size() == 2);
+    CHECK(cache.Trim() == 1);
+    entries = cache.GetEntries();
+    if (!CHECK(entries.size() == 1))
+        return;
+    CHECK(entries[0].users == 1);
+    CHECK(entries[0].name == GetLab4Texture("wood02.dds"));
+
+    // The trimmed texture's path record went with it, so it loads again.
+    cache.Acquire(GetLab4Texture("wood.dds"), 0, loader.GetFn());
+    CHECK(loader.loads == 3);
+
+    held.reset();
+    CHECK(cache.Trim() == 2);
+    CHECK(cache.GetEntries().empty());
+}
+
+TEST_CASE(TextureCacheConcurrentMissesShareOneLoad)
+{
+    FakeCache cache;
+    CountingLoader loader;
+    loader.delayMs = 50;
+
+    const uint32_t threadCount = 8;
+    std::vector<FakeCache::Handle> handles(threadCount);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        // Both copies, so waiters come through the path and the content key.
+        const std::wstring path = i % 2 ? GetLab5Texture("wood02.dds") : GetLab4Texture("wood02.dds");
+        threads.emplace_back([&cache, &loader, &handles, path, i]()
+        {
+            handles[i] = cache.Acquire(path, 0, loader.GetFn());
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    CHECK(loader.loads == 1);
+    for (const FakeCache::Handle& handle : handles)
+        CHECK(handle != nullptr && handle == handles[0]);
+    const TextureCacheStats stats = cache.GetStats();
+    CHECK(stats.loads == 1 && stats.contentHits + stats.pathHits == threadCount - 1);
+}
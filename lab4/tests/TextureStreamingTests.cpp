@@ -0,0 +1,205 @@
+#include "Test.h"
+#include "TextureStreaming.h"
+
+namespace
+{
+    // A square RGBA8 texture with its whole mip chain.
+    StreamingTextureDesc MakeDesc(const char* name, uint32_t size)
+    {
+        StreamingTextureDesc desc;
+        desc.name = name;
+        desc.width = size;
+        desc.height = size;
+        for (uint32_t s = size; s > 0; s >>= 1)
+            desc.mipBytes.push_back((uint64_t)s * s * 4);
+        return desc;
+    }
+
+    uint64_t GetTailBytes(const TextureStreamingPlanner& planner)
+    {
+        uint64_t bytes = 0;
+        for (uint32_t t = 0; t < planner.GetTextureCount(); ++t)
+            bytes += planner.GetTextureBytes(t, planner.GetTailMip(t));
+        return bytes;
+    }
+
+    // Updates and completes every request at once until nothing is asked
+    // for any more.
+    void Settle(TextureStreamingPlanner& planner)
+    {
+        std::vector<StreamingRequest> requests;
+        for (int frame = 0; frame < 64; ++frame)
+        {
+            requests.clear();
+            planner.Update(requests);
+            if (requests.empty())
+                return;
+            for (const StreamingRequest& request : requests)
+                planner.CompleteLoad(request.texture, request.mip);
+        }
+    }
+}
+
+TEST_CASE(StreamingStaysInsideTheBudget)
+{
+    TextureStreamingPlanner planner;
+    planner.AddTexture(MakeDesc("a", 2048));
+    planner.AddTexture(MakeDesc("b", 1024));
+    planner.AddTexture(MakeDesc("c", 512));
+    const uint64_t budget = GetTailBytes(planner) + (6u << 20);
+    planner.SetBudget(budget);
+
+    // Needs that keep changing and loads that finish out of order, some
+    // frames late.
+    std::vector<StreamingRequest> inFlight;
+    uint32_t state = 7;
+    bool withinBudget = true;
+    bool tailsResident = true;
+    for (uint32_t frame = 0; frame < 400; ++frame)
+    {
+        for (uint32_t t = 0; t < planner.GetTextureCount(); ++t)
+        {
+            state = state * 1664525u + 1013904223u;
+            if ((state >> 28) == 0)
+                planner.SetRequiredMip(t, (float)((state >> 8) % 900) / 100.0f);
+        }
+
+        planner.Update(inFlight);
+        const StreamingStats& stats = planner.GetStats();
+        withinBudget = withinBudget && stats.residentBytes + stats.pendingBytes <= budget;
+
+        state = state * 1664525u + 1013904223u;
+        if (!inFlight.empty() && (state >> 30) != 0)
+        {
+            const size_t pick = (state >> 8) % inFlight.size();
+            planner.CompleteLoad(inFlight[pick].texture, inFlight[pick].mip);
+            inFlight.erase(inFlight.begin() + pick);
+        }
+        for (uint32_t t = 0; t < planner.GetTextureCount(); ++t)
+            tailsResident = tailsResident && planner.GetResidentMip(t) <= planner.GetTailMip(t);
+    }
+    CHECK(withinBudget);
+    CHECK(tailsResident);
+    CHECK(planner.GetStats().loads > 0 && planner.GetStats().evictions > 0);
+}
+
+TEST_CASE(StreamingAlwaysKeepsTheTail)
+{
+    // A budget smaller than the tails: nothing streams in, nothing of the
+    // tail is given up.
+    TextureStreamingPlanner planner;
+    const uint32_t a = planner.AddTexture(MakeDesc("a", 1024));
+    const uint32_t b = planner.AddTexture(MakeDesc("b", 256));
+    CHECK(planner.GetTailMip(a) == 4 && planner.GetTailMip(b) == 2);
+    CHECK(planner.GetStats().residentBytes == GetTailBytes(planner));
+
+    planner.SetBudget(1024);
+    planner.SetRequiredMip(a, 0.0f);
+    planner.SetRequiredMip(b, 0.0f);
+    std::vector<StreamingRequest> requests;
+    planner.Update(requests);
+    CHECK(requests.empty());
+    CHECK(planner.GetResidentMip(a) == planner.GetTailMip(a));
+    CHECK(planner.GetResidentMip(b) == planner.GetTailMip(b));
+
+    // Streamed up and then needing only the blurriest level still keeps
+    // the tail.
+    planner.SetBudget(0);
+    Settle(planner);
+    CHECK(planner.GetResidentMip(a) == 0);
+    planner.SetRequiredMip(a, 20.0f);
+    Settle(planner);
+    CHECK(planner.GetResidentMip(a) == planner.GetTailMip(a));
+}
+
+TEST_CASE(StreamingEvictsOnlyPastTheSlack)
+{
+    TextureStreamingPlanner planner;
+    const uint32_t t = planner.AddTexture(MakeDesc("t", 1024));
+    planner.SetRequiredMip(t, 0.0f);
+    Settle(planner);
+    if (!CHECK(planner.GetResidentMip(t) == 0))
+        return;
+
+    // A camera wobbling around the mip 0/1 boundary keeps mip 0 and loads
+    // nothing again.
+    const StreamingStats before = planner.GetStats();
+    for (int frame = 0; frame < 20; ++frame)
+    {
+        planner.SetRequiredMip(t, frame % 2 ? 0.9f : 1.1f);
+        Settle(planner);
+    }
+    CHECK(planner.GetResidentMip(t) == 0);
+    CHECK(planner.GetStats().loads == before.loads && planner.GetStats().evictions == before.evictions);
+
+    // One level past the slack and the unneeded levels go.
+    planner.SetRequiredMip(t, (float)(1 + TextureStreamingPlanner::EVICT_SLACK));
+    Settle(planner);
+    CHECK(planner.GetResidentMip(t) == 1 + TextureStreamingPlanner::EVICT_SLACK);
+    CHECK(planner.GetStats().evictions == before.evictions + 1);
+    CHECK(planner.GetStats().residentBytes == planner.GetTextureBytes(t, 1 + TextureStreamingPlanner::EVICT_SLACK));
+}
+
+TEST_CASE(StreamingIgnoresStaleLoads)
+{
+    TextureStreamingPlanner planner;
+    const uint32_t t = planner.AddTexture(MakeDesc("t", 1024));
+    const uint32_t tail = planner.GetTailMip(t);
+    planner.SetRequiredMip(t, 0.0f);
+
+    std::vector<StreamingRequest> requests;
+    planner.Update(requests);
+    if (!CHECK(requests.size() == 1 && requests[0].mip == tail - 1))
+        return;
+    CHECK(planner.IsLoading(t) && planner.GetStats().pendingBytes == planner.GetDesc(t).mipBytes[tail - 1]);
+
+    // The camera moves away before the load lands: no new request while it
+    // is in flight, and completing it changes nothing but the pending bytes.
+    planner.SetRequiredMip(t, (float)tail);
+    std::vector<StreamingRequest> more;
+    planner.Update(more);
+    CHECK(more.empty() && planner.GetTargetMip(t) == tail);
+
+    planner.CompleteLoad(requests[0].texture, requests[0].mip);
+    CHECK(!planner.IsLoading(t));
+    CHECK(planner.GetResidentMip(t) == tail);
+    CHECK(planner.GetStats().pendingBytes == 0 && planner.GetStats().loads == 0);
+    CHECK(planner.GetStats().residentBytes == planner.GetTextureBytes(t, tail));
+
+    // A second report of the same load is ignored as well.
+    planner.CompleteLoad(requests[0].texture, requests[0].mip);
+    CHECK(planner.GetStats().pendingBytes == 0 && planner.GetResidentMip(t) == tail);
+}
+
+TEST_CASE(StreamingShrinkingBudgetEvictsLargestLevelsFirst)
+{
+    TextureStreamingPlanner planner;
+    const uint32_t big = planner.AddTexture(MakeDesc("big", 2048));
+    const uint32_t small = planner.AddTexture(MakeDesc("small", 512));
+    planner.SetRequiredMip(big, 0.0f);
+    planner.SetRequiredMip(small, 0.0f);
+    Settle(planner);
+    if (!CHECK(planner.GetResidentMip(big) == 0 && planner.GetResidentMip(small) == 0))
+        return;
+
+    // Both now need only mip 1 and keep mip 0 as slack, until the budget
+    // drops below what is resident: the 16 MB level goes, the 1 MB stays.
+    planner.SetRequiredMip(big, 1.0f);
+    planner.SetRequiredMip(small, 1.0f);
+    Settle(planner);
+    CHECK(planner.GetResidentMip(big) == 0 && planner.GetResidentMip(small) == 0);
+
+    planner.SetBudget(planner.GetStats().residentBytes - 1);
+    Settle(planner);
+    CHECK(planner.GetResidentMip(big) == 1);
+    CHECK(planner.GetResidentMip(small) == 0);
+    CHECK(planner.GetStats().residentBytes <= planner.GetBudget());
+
+    // Far below that, both fall back to the levels the planner can still
+    // afford, with no slack left over.
+    planner.SetBudget(GetTailBytes(planner) + planner.GetDesc(small).mipBytes[1]);
+    Settle(planner);
+    CHECK(planner.GetStats().residentBytes <= planner.GetBudget());
+    CHECK(planner.GetResidentMip(big) == planner.GetTargetMip(big) && planner.GetResidentMip(big) > 1);
+    CHECK(planner.GetResidentMip(small) == planner.GetTargetMip(small) && planner.GetResidentMip(small) > 0);
+}
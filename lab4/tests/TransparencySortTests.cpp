@@ -0,0 +1,234 @@
+#include "Test.h"
+#include "TransparencySort.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const TransformKernel KERNELS[] = { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX2 };
+    const TransparencyKeyBits KEY_BITS[] = { TRANSPARENCY_KEY_16, TRANSPARENCY_KEY_32 };
+
+    // None of them a whole number of AVX2 steps.
+    const size_t COUNTS[] = { 1, 2, 7, 9, 15, 17, 100, 1001 };
+
+    const float EYE[3] = { 3.0f, 1.5f, -20.0f };
+
+    float Random(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Objects within 50 units of the origin. Every fourth one shares its
+    // position with an earlier object, so there are exact ties to keep in
+    // order.
+    void MakeScene(size_t count, uint32_t seed, SceneTransforms& scene)
+    {
+        scene.Resize(count);
+        uint32_t state = seed;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i % 4 == 3)
+            {
+                const size_t j = (size_t)(Random(state) * (float)i);
+                scene.SetPosition(i, scene.posX[j], scene.posY[j], scene.posZ[j]);
+            }
+            else
+            {
+                scene.SetPosition(i, Random(state) * 100.0f - 50.0f, Random(state) * 100.0f - 50.0f,
+                    Random(state) * 100.0f - 50.0f);
+            }
+        }
+    }
+
+    // The key Sort() gives each object, worked out one at a time: smaller
+    // is farther.
+    std::vector<uint32_t> GetKeys(const SceneTransforms& scene, TransparencyKeyBits bits)
+    {
+        const size_t count = scene.Size();
+        std::vector<float> distance(count);
+        float minValue = 3.402823466e+38f, maxValue = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float dx = scene.posX[i] - EYE[0], dy = scene.posY[i] - EYE[1], dz = scene.posZ[i] - EYE[2];
+            distance[i] = dx * dx + dy * dy + dz * dz;
+            minValue = std::min(minValue, distance[i]);
+            maxValue = std::max(maxValue, distance[i]);
+        }
+
+        std::vector<uint32_t> keys(count);
+        const float scale = maxValue > minValue ? 65535.0f / (maxValue - minValue) : 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t bitsOf;
+            memcpy(&bitsOf, &distance[i], sizeof(bitsOf));
+            const uint32_t q = std::min((uint32_t)((distance[i] - minValue) * scale), 65535u);
+            keys[i] = bits == TRANSPARENCY_KEY_32 ? ~bitsOf : 65535u - q;
+        }
+        return keys;
+    }
+
+    // from, stably sorted by key: what Sort() must return starting from it.
+    std::vector<uint32_t> StableSorted(std::vector<uint32_t> from, const std::vector<uint32_t>& keys)
+    {
+        std::stable_sort(from.begin(), from.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        return from;
+    }
+
+    std::vector<uint32_t> IndexOrder(size_t count)
+    {
+        std::vector<uint32_t> order(count);
+        for (size_t i = 0; i < count; ++i)
+            order[i] = (uint32_t)i;
+        return order;
+    }
+
+    std::vector<uint32_t> Sort(TransparencySorter& sorter, const SceneTransforms& scene, JobSystem* pJobs = nullptr)
+    {
+        return sorter.Sort(scene, EYE[0], EYE[1], EYE[2], pJobs);
+    }
+
+    // Moves every object by up to half a step along each axis.
+    void Jitter(SceneTransforms& scene, float step, uint32_t seed)
+    {
+        uint32_t state = seed;
+        for (size_t i = 0; i < scene.Size(); ++i)
+        {
+            scene.posX[i] += (Random(state) - 0.5f) * step;
+            scene.posY[i] += (Random(state) - 0.5f) * step;
+            scene.posZ[i] += (Random(state) - 0.5f) * step;
+        }
+    }
+}
+
+TEST_CASE(TransparencyRadixSortIsStable)
+{
+    // A cold start radix sorts, and ties keep index order, like
+    // std::stable_sort.
+    for (TransparencyKeyBits bits : KEY_BITS)
+    {
+        for (size_t count : COUNTS)
+        {
+            SceneTransforms scene;
+            MakeScene(count, (uint32_t)count + bits, scene);
+            const std::vector<uint32_t> keys = GetKeys(scene, bits);
+            const std::vector<uint32_t> expected = StableSorted(IndexOrder(count), keys);
+            for (TransformKernel kernel : KERNELS)
+            {
+                if (!IsTransformKernelSupported(kernel))
+                    continue;
+                TransparencySorter sorter;
+                sorter.SetKeyBits(bits);
+                sorter.SetKernel(kernel);
+                CHECK(Sort(sorter, scene) == expected);
+                CHECK(sorter.GetLastStats().path == TRANSPARENCY_SORT_RADIX && sorter.GetLastStats().count == count);
+            }
+        }
+    }
+
+    // The same from a shuffled starting order: ties keep that order instead.
+    for (TransparencyKeyBits bits : KEY_BITS)
+    {
+        SceneTransforms scene;
+        MakeScene(1001, 5, scene);
+        TransparencySorter sorter;
+        sorter.SetKeyBits(bits);
+        const std::vector<uint32_t> first = Sort(sorter, scene);
+
+        std::vector<uint32_t> shuffled = first;
+        uint32_t state = 11;
+        for (size_t i = shuffled.size() - 1; i > 0; --i)
+            std::swap(shuffled[i], shuffled[(size_t)(Random(state) * (float)(i + 1))]);
+        SceneTransforms reordered = scene;
+        for (size_t n = 0; n < shuffled.size(); ++n)
+            reordered.SetPosition(shuffled[n], scene.posX[first[n]], scene.posY[first[n]], scene.posZ[first[n]]);
+
+        // reordered moves object first[n] to where shuffled[n] was: last
+        // frame's order is now far from sorted and the radix path runs.
+        CHECK(Sort(sorter, reordered) == StableSorted(first, GetKeys(reordered, bits)));
+        CHECK(sorter.GetLastStats().path == TRANSPARENCY_SORT_RADIX);
+    }
+}
+
+TEST_CASE(TransparencyTemporalReuseMatchesTheFullSort)
+{
+    for (TransparencyKeyBits bits : KEY_BITS)
+    {
+        for (TransformKernel kernel : KERNELS)
+        {
+            if (!IsTransformKernelSupported(kernel))
+                continue;
+            SceneTransforms scene;
+            MakeScene(1001, 3 + bits, scene);
+            TransparencySorter sorter;
+            sorter.SetKeyBits(bits);
+            sorter.SetKernel(kernel);
+            std::vector<uint32_t> previous = Sort(sorter, scene);
+
+            // Nothing moved: last frame's order is handed back as is.
+            CHECK(Sort(sorter, scene) == previous);
+            CHECK(sorter.GetLastStats().path == TRANSPARENCY_SORT_REUSED && sorter.GetLastStats().moves == 0);
+
+            // A little movement per frame: insertion fixes up the order, and
+            // the result is the full stable sort of last frame's order.
+            bool matches = true, refined = false;
+            for (uint32_t frame = 0; frame < 20; ++frame)
+            {
+                Jitter(scene, 0.02f, frame);
+                const std::vector<uint32_t> expected = StableSorted(previous, GetKeys(scene, bits));
+                previous = Sort(sorter, scene);
+                matches = matches && previous == expected;
+                refined = refined || sorter.GetLastStats().path == TRANSPARENCY_SORT_REFINED;
+            }
+            CHECK(matches && refined);
+
+            // A big jump blows the refine budget and the radix sort takes
+            // over; ties still keep last frame's order.
+            Jitter(scene, 20.0f, 99);
+            CHECK(Sort(sorter, scene) == StableSorted(previous, GetKeys(scene, bits)));
+            CHECK(sorter.GetLastStats().path == TRANSPARENCY_SORT_RADIX);
+
+            // With no budget even a little movement is radix sorted, to the
+            // same answer.
+            TransparencySorter strict;
+            strict.SetKeyBits(bits);
+            strict.SetKernel(kernel);
+            strict.SetRefineBudget(0);
+            Sort(strict, scene);
+            Jitter(scene, 0.02f, 7);
+            const std::vector<uint32_t> expected = StableSorted(strict.GetOrder(), GetKeys(scene, bits));
+            CHECK(Sort(strict, scene) == expected);
+            CHECK(strict.GetLastStats().path == TRANSPARENCY_SORT_RADIX);
+
+            // Reset() forgets the order: ties go back to index order.
+            sorter.Reset();
+            CHECK(Sort(sorter, scene) == StableSorted(IndexOrder(scene.Size()), GetKeys(scene, bits)));
+            CHECK(sorter.GetLastStats().path == TRANSPARENCY_SORT_RADIX);
+        }
+    }
+}
+
+TEST_CASE(TransparencyParallelKeysMatchSerial)
+{
+    // Enough objects for several key chunks, and a count that splits
+    // unevenly.
+    SceneTransforms scene;
+    MakeScene(70001, 17, scene);
+    JobSystem jobs(4);
+    for (TransparencyKeyBits bits : KEY_BITS)
+    {
+        TransparencySorter serial, parallel;
+        serial.SetKeyBits(bits);
+        parallel.SetKeyBits(bits);
+        const std::vector<uint32_t> expected = StableSorted(IndexOrder(scene.Size()), GetKeys(scene, bits));
+        CHECK(Sort(serial, scene) == expected);
+        CHECK(Sort(parallel, scene, &jobs) == expected);
+    }
+
+    // An empty scene sorts to nothing and forgets the last order.
+    TransparencySorter sorter;
+    Sort(sorter, scene);
+    SceneTransforms empty;
+    CHECK(Sort(sorter, empty).empty() && sorter.GetLastStats().path == TRANSPARENCY_SORT_NONE);
+}
@@ -10,6 +10,19 @@
 #include <cstdio>
 #include <algorithm>
 
+#include "../lab4/StateCache.h"
+#include "../lab4/D3D11ConstantRing.h"
+#include "../lab4/D3D11RenderContext.h"
+#include "../lab4/SceneTransforms.h"
+#include "../lab4/TransparencySort.h"
+#include "../lab4/FrustumCull.h"
+#include "../lab4/JobSystem.h"
+#include "../lab4/OcclusionCull.h"
+#include "../lab4/RenderQueue.h"
+#include "../lab4/SceneBvh.h"
+#include "../lab4/D3DShaderCache.h"
+#include "../lab4/TextureLoader.h"
+
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
@@ -45,15 +58,34 @@ ID3D11Buffer* g_pModelCB = nullptr;
 ID3D11Buffer* g_pTransparentVertexBuffer = nullptr;
 ID3D11Buffer* g_pTransparentIndexBuffer = nullptr;
 UINT g_transparentIndexCount = 36;
-std::vector<XMMATRIX> g_transparentWorldMatrices;
-std::vector<float> g_transparentAlphas;
-std::vector<XMFLOAT4> g_transparentColors;
+// Transparent cubes in SoA form; tint.a already includes the cube's alpha
+SceneTransforms g_transparentScene;
 ID3D11VertexShader* g_pTransparentVS = nullptr;
 ID3D11PixelShader* g_pTransparentPS = nullptr;
 ID3D11InputLayout* g_pTransparentInputLayout = nullptr;
-ID3D11Buffer* g_pTransparentCB = nullptr;
+// Sorted transparent cubes are drawn with one instanced draw; the instance
+// data is written straight into this buffer every frame in back-to-front order
+ID3D11Buffer* g_pTransparentInstanceBuffer = nullptr;
+// Keeps last frame's back-to-front order, so a slowly moving camera only
+// pays for the few objects that swapped places
+TransparencySorter g_transparencySorter;
+// Per-frame update work runs as jobs on every core
+JobSystem g_jobs;
+// Bounds of the transparent cubes and the sorted ones left after culling.
+// The cubes orbit, so the hierarchy over them is refitted every frame
+// rather than rebuilt
+BoundingSpheres g_transparentBounds;
+SceneBvh g_transparentBvh;
+std::vector<uint32_t> g_transparentVisible;
+std::vector<uint8_t> g_transparentInView;
+std::vector<uint32_t> g_transparentDrawOrder;
+OcclusionCuller g_occlusionCuller;
 ID3D11BlendState* g_pBlendState = nullptr;
 ID3D11DepthStencilState* g_pTransparentDepthState = nullptr;
+ID3D11RasterizerState* g_pTransparentRasterizerState = nullptr;
+// Compiled shaders persist in shader_cache.bin next to the exe, so only the
+// first start after a shader edit pays for D3DCompile
+ShaderCache g_shaderCache(CompileShaderWithD3D, D3D_SHADER_COMPILER_ID);
 
 
 ID3D11Buffer* g_pSkyboxVertexBuffer = nullptr;
@@ -64,10 +96,38 @@ ID3D11InputLayout* g_pSkyboxInputLayout = nullptr;
 
 // Shared resources
 ID3D11Buffer* g_pViewProjCB = nullptr;
-ID3D11ShaderResourceView* g_pTextureView = nullptr;
-ID3D11ShaderResourceView* g_pCubemapView = nullptr;
+// Loaded through the lab4 texture cache, which holds the other reference
+std::shared_ptr<ID3D11ShaderResourceView> g_pTextureView;
+std::shared_ptr<ID3D11ShaderResourceView> g_pCubemapView;
 ID3D11SamplerState* g_pSampler = nullptr;
 
+// Immutable pipeline states, created once in CreateRenderStates() and owned
+// by g_stateCache
+StateCache g_stateCache;
+ID3D11DepthStencilState* g_pSkyboxDepthState = nullptr;
+ID3D11RasterizerState* g_pSkyboxRasterizerState = nullptr;
+ID3D11DepthStencilState* g_pCubeDepthState = nullptr;
+ID3D11RasterizerState* g_pCubeRasterizerState = nullptr;
+
+// All per-draw binds go through the recorder, which drops redundant ones and
+// replays the frame into g_renderContext before Present
+D3D11RenderContext g_renderContext;
+CommandRecorder g_commands;
+
+// The Render*() functions only queue their draws; Render() submits the frame
+// sorted by pass, state and depth, so consecutive draws share what they can
+RenderQueue g_renderQueue;
+uint32_t g_skyboxMaterial = RenderQueue::INVALID_ID;
+uint32_t g_cubeMaterial = RenderQueue::INVALID_ID;
+uint32_t g_transparentMaterial = RenderQueue::INVALID_ID;
+uint32_t g_skyboxGeometry = RenderQueue::INVALID_ID;
+uint32_t g_cubeGeometry = RenderQueue::INVALID_ID;
+uint32_t g_transparentGeometry = RenderQueue::INVALID_ID;
+
+// Per-frame constants are suballocated from one buffer mapped once per
+// frame; without offset binding g_pModelCB and g_pViewProjCB are used
+D3D11ConstantRing g_constantRing;
+
 // Camera variables
 float g_yaw = 0.0f;
 float g_pitch = 0.3f;
@@ -84,12 +144,6 @@ float g_orbitAngle1 = 0.0f;
 float g_orbitAngle2 = 0.0f;
 float g_orbitRadius = 2.5f;
 
-struct TexturedVertex
-{
-    XMFLOAT3 pos;
-    XMFLOAT2 uv;
-};
-
 struct TransparentVertex
 {
     XMFLOAT3 pos;
@@ -97,86 +151,6 @@ struct TransparentVertex
 
 };
 
-struct ModelConstantBuffer
-{
-    XMMATRIX model;
-};
-
-struct ViewProjConstantBuffer
-{
-    XMMATRIX vp;
-};
-struct TransparentRenderItem
-{
-    XMMATRIX worldMatrix;
-    float alpha;
-    XMFLOAT4 color;
-    float distance;
-};
-struct TransparentConstantBuffer
-{
-    XMMATRIX model;
-    float alpha;
-    float padding[3];
-    XMFLOAT4 tintColor;
-};
-//=====================================================================
-// DDS LOADER STRUCTURES
-//=====================================================================
-#ifndef MAKEFOURCC
-#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
-    ((DWORD)(BYTE)(ch0) | ((DWORD)(BYTE)(ch1) << 8) | \
-     ((DWORD)(BYTE)(ch2) << 16) | ((DWORD)(BYTE)(ch3) << 24))
-#endif
-
-struct DDS_PIXELFORMAT
-{
-    DWORD dwSize;
-    DWORD dwFlags;
-    DWORD dwFourCC;
-    DWORD dwRGBBitCount;
-    DWORD dwRBitMask;
-    DWORD dwGBitMask;
-    DWORD dwBBitMask;
-    DWORD dwABitMask;
-};
-
-struct DDS_HEADER
-{
-    DWORD dwSize;
-    DWORD dwHeaderFlags;
-    DWORD dwHeight;
-    DWORD dwWidth;
-    DWORD dwPitchOrLinearSize;
-    DWORD dwDepth;
-    DWORD dwMipMapCount;
-    DWORD dwReserved1[11];
-    DDS_PIXELFORMAT ddspf;
-    DWORD dwSurfaceFlags;
-    DWORD dwCubemapFlags;
-    DWORD dwReserved2[3];
-};
-
-#define DDS_MAGIC 0x20534444
-#define DDS_HEADER_FLAGS_TEXTURE 0x00001007
-#define DDS_SURFACE_FLAGS_MIPMAP 0x00400000
-#define DDS_FOURCC 0x00000004
-#define DDS_RGB 0x00000040
-
-#define FOURCC_DXT1 MAKEFOURCC('D','X','T','1')
-#define FOURCC_DXT3 MAKEFOURCC('D','X','T','3')
-#define FOURCC_DXT5 MAKEFOURCC('D','X','T','5')
-
-struct TextureDesc
-{
-    UINT32 pitch = 0;
-    UINT32 mipmapsCount = 0;
-    DXGI_FORMAT fmt = DXGI_FORMAT_UNKNOWN;
-    UINT32 width = 0;
-    UINT32 height = 0;
-    void* pData = nullptr;
-};
-
 //=====================================================================
 // FORWARD DECLARATIONS
 //=====================================================================
@@ -190,288 +164,18 @@ void HandleKey(UINT key, bool isDown);
 bool CreateDeviceAndSwapChain();
 bool CreateRenderTargetAndDepthStencil();
 bool CreateBuffers();
+bool CreateRenderStates();
 bool CompileShaders();
 bool LoadTextures();
 void SetupTransparentObjects();
+void SetupRenderQueue();
 
 void UpdateCamera(float deltaTime);
+void SetVSConstants(UINT slot, ID3D11Buffer* pFallback, const void* pData, UINT size, bool discard);
 void RenderSkybox(const XMMATRIX& vpSky);
 void RenderCenterCube(const XMMATRIX& view, const XMMATRIX& proj, float time);
-void RenderTransparentObjects(const XMMATRIX& view, const XMMATRIX& proj, float time);
-
-UINT GetBytesPerBlock(DXGI_FORMAT fmt);
-bool LoadDDS(const wchar_t* filename, TextureDesc& desc);
-ID3D11ShaderResourceView* CreateTexture2D(ID3D11Device* device, const TextureDesc& desc);
-ID3D11ShaderResourceView* CreateCubemap(ID3D11Device* device, const std::wstring* facePaths);
-
-std::wstring GetPath();
-
-std::wstring GetPath()
-{
-    wchar_t exePath[MAX_PATH];
-    GetModuleFileNameW(NULL, exePath, MAX_PATH);
-    std::wstring path(exePath);
-    size_t pos = path.find_last_of(L"\\/");
-    if (pos != std::wstring::npos)
-        path = path.substr(0, pos + 1);
-    return path;
-}
-
-UINT GetBytesPerBlock(DXGI_FORMAT fmt)
-{
-    switch (fmt)
-    {
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC4_UNORM:
-        return 8;
-    case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC5_UNORM:
-        return 16;
-    default:
-        return 0;
-    }
-}
-
-bool LoadDDS(const wchar_t* filename, TextureDesc& desc)
-{
-    HANDLE hFile = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
-        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE)
-        return false;
-
-    DWORD dwMagic;
-    DWORD dwBytesRead;
-    ReadFile(hFile, &dwMagic, sizeof(DWORD), &dwBytesRead, NULL);
-    if (dwMagic != DDS_MAGIC)
-    {
-        CloseHandle(hFile);
-        return false;
-    }
-
-    DDS_HEADER header;
-    ReadFile(hFile, &header, sizeof(DDS_HEADER), &dwBytesRead, NULL);
-
-    desc.width = header.dwWidth;
-    desc.height = header.dwHeight;
-    desc.mipmapsCount = (header.dwSurfaceFlags & DDS_SURFACE_FLAGS_MIPMAP) ?
-        max(1, header.dwMipMapCount) : 1;
-
-    if (header.ddspf.dwFlags & DDS_FOURCC)
-    {
-        switch (header.ddspf.dwFourCC)
-        {
-        case FOURCC_DXT1: desc.fmt = DXGI_FORMAT_BC1_UNORM; break;
-        case FOURCC_DXT3: desc.fmt = DXGI_FORMAT_BC2_UNORM; break;
-        case FOURCC_DXT5: desc.fmt = DXGI_FORMAT_BC3_UNORM; break;
-        default: desc.fmt = DXGI_FORMAT_UNKNOWN; break;
-        }
-    }
-    else if (header.ddspf.dwFlags & DDS_RGB)
-    {
-        if (header.ddspf.dwRGBBitCount == 32)
-        {
-            if (header.ddspf.dwABitMask != 0)
-                desc.fmt = DXGI_FORMAT_R8G8B8A8_UNORM;
-            else
-                desc.fmt = DXGI_FORMAT_B8G8R8X8_UNORM;
-        }
-        else if (header.ddspf.dwRGBBitCount == 24)
-            desc.fmt = DXGI_FORMAT_R8G8B8A8_UNORM;
-        else
-            desc.fmt = DXGI_FORMAT_UNKNOWN;
-    }
-
-    if (desc.fmt == DXGI_FORMAT_UNKNOWN)
-    {
-        CloseHandle(hFile);
-        return false;
-    }
-
-    UINT totalSize = 0;
-    UINT width = desc.width;
-    UINT height = desc.height;
-
-    for (UINT i = 0; i < desc.mipmapsCount; ++i)
-    {
-        UINT blockWidth = (width + 3) / 4;
-        UINT blockHeight = (height + 3) / 4;
-        UINT mipSize = blockWidth * blockHeight * GetBytesPerBlock(desc.fmt);
-        totalSize += mipSize;
-        width = max(1, width / 2);
-        height = max(1, height / 2);
-    }
-
-    desc.pData = malloc(totalSize);
-    if (!desc.pData)
-    {
-        CloseHandle(hFile);
-        return false;
-    }
-
-    BYTE* pDataPtr = (BYTE*)desc.pData;
-    width = desc.width;
-    height = desc.height;
-
-    for (UINT i = 0; i < desc.mipmapsCount; ++i)
-    {
-        UINT blockWidth = (width + 3) / 4;
-        UINT blockHeight = (height + 3) / 4;
-        UINT mipSize = blockWidth * blockHeight * GetBytesPerBlock(desc.fmt);
-
-        ReadFile(hFile, pDataPtr, mipSize, &dwBytesRead, NULL);
-        pDataPtr += mipSize;
-
-        width = max(1, width / 2);
-        height = max(1, height / 2);
-    }
-
-    CloseHandle(hFile);
-    return true;
-}
-
-ID3D11ShaderResourceView* CreateTexture2D(ID3D11Device* device, const TextureDesc& desc)
-{
-    D3D11_TEXTURE2D_DESC tex2DDesc = {};
-    tex2DDesc.Width = desc.width;
-    tex2DDesc.Height = desc.height;
-    tex2DDesc.MipLevels = desc.mipmapsCount;
-    tex2DDesc.ArraySize = 1;
-    tex2DDesc.Format = desc.fmt;
-    tex2DDesc.SampleDesc.Count = 1;
-    tex2DDesc.SampleDesc.Quality = 0;
-    tex2DDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    tex2DDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-
-    std::vector<D3D11_SUBRESOURCE_DATA> initData(desc.mipmapsCount);
-    BYTE* pDataPtr = (BYTE*)desc.pData;
-    UINT width = desc.width;
-    UINT height = desc.height;
-
-    for (UINT i = 0; i < desc.mipmapsCount; ++i)
-    {
-        UINT blockWidth = (width + 3) / 4;
-        UINT blockHeight = (height + 3) / 4;
-        UINT pitch = blockWidth * GetBytesPerBlock(desc.fmt);
-
-        initData[i].pSysMem = pDataPtr;
-        initData[i].SysMemPitch = pitch;
-        initData[i].SysMemSlicePitch = 0;
-
-        pDataPtr += pitch * blockHeight;
-        width = max(1, width / 2);
-        height = max(1, height / 2);
-    }
-
-    ID3D11Texture2D* pTexture = nullptr;
-    ID3D11ShaderResourceView* pSRV = nullptr;
-
-    if (FAILED(device->CreateTexture2D(&tex2DDesc, initData.data(), &pTexture)))
-        return nullptr;
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = desc.fmt;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = desc.mipmapsCount;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-
-    device->CreateShaderResourceView(pTexture, &srvDesc, &pSRV);
-    pTexture->Release();
-    return pSRV;
-}
-
-ID3D11ShaderResourceView* CreateCubemap(ID3D11Device* device, const std::wstring* facePaths)
-{
-    TextureDesc faceDescs[6];
-    bool allOk = true;
-    UINT mipCount = 0;
-
-    for (int i = 0; i < 6; ++i)
-    {
-        if (!LoadDDS(facePaths[i].c_str(), faceDescs[i]))
-        {
-            allOk = false;
-            break;
-        }
-        if (i == 0) mipCount = faceDescs[i].mipmapsCount;
-    }
-
-    if (!allOk)
-    {
-        for (int i = 0; i < 6; ++i)
-            if (faceDescs[i].pData) free(faceDescs[i].pData);
-        return nullptr;
-    }
-
-    for (int i = 1; i < 6; ++i)
-    {
-        if (faceDescs[i].fmt != faceDescs[0].fmt ||
-            faceDescs[i].width != faceDescs[0].width ||
-            faceDescs[i].height != faceDescs[0].height ||
-            faceDescs[i].mipmapsCount != mipCount)
-        {
-            for (int j = 0; j < 6; ++j) free(faceDescs[j].pData);
-            return nullptr;
-        }
-    }
-
-    D3D11_TEXTURE2D_DESC cubeDesc = {};
-    cubeDesc.Width = faceDescs[0].width;
-    cubeDesc.Height = faceDescs[0].height;
-    cubeDesc.MipLevels = mipCount;
-    cubeDesc.ArraySize = 6;
-    cubeDesc.Format = faceDescs[0].fmt;
-    cubeDesc.SampleDesc.Count = 1;
-    cubeDesc.SampleDesc.Quality = 0;
-    cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
-
-    std::vector<D3D11_SUBRESOURCE_DATA> cubeInitData(6 * mipCount);
-
-    for (int face = 0; face < 6; ++face)
-    {
-        BYTE* pFaceData = (BYTE*)faceDescs[face].pData;
-        UINT faceWidth = faceDescs[face].width;
-        UINT faceHeight = faceDescs[face].height;
-
-        for (UINT mip = 0; mip < mipCount; ++mip)
-        {
-            UINT blockWidth = (faceWidth + 3) / 4;
-            UINT blockHeight = (faceHeight + 3) / 4;
-            UINT pitch = blockWidth * GetBytesPerBlock(cubeDesc.Format);
-
-            cubeInitData[face * mipCount + mip].pSysMem = pFaceData;
-            cubeInitData[face * mipCount + mip].SysMemPitch = pitch;
-            cubeInitData[face * mipCount + mip].SysMemSlicePitch = 0;
-
-            pFaceData += pitch * blockHeight;
-            faceWidth = max(1, faceWidth / 2);
-            faceHeight = max(1, faceHeight / 2);
-        }
-    }
-
-    ID3D11Texture2D* pCubemapTex = nullptr;
-    ID3D11ShaderResourceView* pSRV = nullptr;
-
-    if (FAILED(device->CreateTexture2D(&cubeDesc, cubeInitData.data(), &pCubemapTex)))
-    {
-        for (int i = 0; i < 6; ++i) free(faceDescs[i].pData);
-        return nullptr;
-    }
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC cubeSRVDesc = {};
-    cubeSRVDesc.Format = cubeDesc.Format;
-    cubeSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-    cubeSRVDesc.TextureCube.MipLevels = mipCount;
-    cubeSRVDesc.TextureCube.MostDetailedMip = 0;
-
-    device->CreateShaderResourceView(pCubemapTex, &cubeSRVDesc, &pSRV);
-    pCubemapTex->Release();
-
-    for (int i = 0; i < 6; ++i) free(faceDescs[i].pData);
-    return pSRV;
-}
+void AnimateTransparentObjects(float time);
+void RenderTransparentObjects(const XMMATRIX& view, const XMMATRIX& proj);
 
 void UpdateCamera(float deltaTime)
 {
@@ -667,19 +371,59 @@ bool CreateBuffers()
     if (FAILED(g_pDevice->CreateBuffer(&desc, nullptr, &g_pModelCB)))
         return false;
 
-    desc.ByteWidth = sizeof(TransparentConstantBuffer);
-    if (FAILED(g_pDevice->CreateBuffer(&desc, nullptr, &g_pTransparentCB)))
-        return false;
-
     desc.ByteWidth = sizeof(ViewProjConstantBuffer);
     desc.Usage = D3D11_USAGE_DYNAMIC;
     desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
     if (FAILED(g_pDevice->CreateBuffer(&desc, nullptr, &g_pViewProjCB)))
         return false;
 
+    g_constantRing.Initialize(g_pDevice, 64 * 1024);
     return true;
 }
 
+bool CreateRenderStates()
+{
+    g_stateCache.Initialize(g_pDevice);
+
+    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
+    dsDesc.DepthEnable = TRUE;
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+    dsDesc.StencilEnable = FALSE;
+    g_pSkyboxDepthState = g_stateCache.GetDepthStencilState(dsDesc);
+
+    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
+    g_pTransparentDepthState = g_stateCache.GetDepthStencilState(dsDesc);
+
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    g_pCubeDepthState = g_stateCache.GetDepthStencilState(dsDesc);
+
+    D3D11_RASTERIZER_DESC rsDesc = {};
+    rsDesc.FillMode = D3D11_FILL_SOLID;
+    rsDesc.CullMode = D3D11_CULL_NONE;
+    g_pSkyboxRasterizerState = g_stateCache.GetRasterizerState(rsDesc);
+
+    // The center cube and the transparent cubes share the same rasterizer state
+    rsDesc.CullMode = D3D11_CULL_BACK;
+    g_pCubeRasterizerState = g_stateCache.GetRasterizerState(rsDesc);
+    g_pTransparentRasterizerState = g_stateCache.GetRasterizerState(rsDesc);
+
+    // Blend state for transparency
+    D3D11_BLEND_DESC blendDesc = {};
+    blendDesc.RenderTarget[0].BlendEnable = TRUE;
+    blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+    blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    g_pBlendState = g_stateCache.GetBlendState(blendDesc);
+
+    return g_pSkyboxDepthState && g_pTransparentDepthState && g_pCubeDepthState &&
+        g_pSkyboxRasterizerState && g_pCubeRasterizerState && g_pBlendState;
+}
+
 bool CompileShaders()
 {
     UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
@@ -691,6 +435,8 @@ bool CompileShaders()
     ID3DBlob* pPsBlob = nullptr;
     ID3DBlob* pErrorBlob = nullptr;
 
+    g_shaderCache.Open(GetShaderCachePath(L"shader_cache.bin"));
+
     const char* cubeVS = R"(
         cbuffer ModelCB : register(b0) { float4x4 model; }
         cbuffer ViewProjCB : register(b1) { float4x4 vp; }
@@ -714,14 +460,14 @@ bool CompileShaders()
         }
     )";
 
-    if (FAILED(D3DCompile(cubeVS, strlen(cubeVS), nullptr, nullptr, nullptr, "vs", "vs_5_0", flags, 0, &pVsBlob, &pErrorBlob))) {
+    if (FAILED(CompileShaderCached(g_shaderCache, cubeVS, strlen(cubeVS), nullptr, "vs", "vs_5_0", flags, &pVsBlob, &pErrorBlob))) {
         if (pErrorBlob) OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
         SAFE_RELEASE(pErrorBlob);
         return false;
     }
     g_pDevice->CreateVertexShader(pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), nullptr, &g_pVertexShader);
 
-    if (FAILED(D3DCompile(cubePS, strlen(cubePS), nullptr, nullptr, nullptr, "ps", "ps_5_0", flags, 0, &pPsBlob, &pErrorBlob))) {
+    if (FAILED(CompileShaderCached(g_shaderCache, cubePS, strlen(cubePS), nullptr, "ps", "ps_5_0", flags, &pPsBlob, &pErrorBlob))) {
         if (pErrorBlob) OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
         SAFE_RELEASE(pErrorBlob);
         return false;
@@ -739,17 +485,16 @@ bool CompileShaders()
     SAFE_RELEASE(pErrorBlob);
 
     const char* transparentVS = R"(
-        cbuffer TransparentCB : register(b0) {
-            float4x4 model;
-            float alpha;
-            float4 tintColor;
-        }
         cbuffer ViewProjCB : register(b1) {
             float4x4 vp;
         }
         struct VSInput {
             float3 pos : POSITION;
             float2 uv : TEXCOORD;
+            float4 world0 : WORLD0;
+            float4 world1 : WORLD1;
+            float4 world2 : WORLD2;
+            float4 tint : TINT;
         };
         struct VSOutput {
             float4 pos : SV_Position;
@@ -758,11 +503,11 @@ bool CompileShaders()
         };
         VSOutput vs(VSInput v) {
             VSOutput o;
-            float4 worldPos = mul(float4(v.pos, 1.0), model);
+            float4 localPos = float4(v.pos, 1.0);
+            float4 worldPos = float4(dot(v.world0, localPos), dot(v.world1, localPos), dot(v.world2, localPos), 1.0);
             o.pos = mul(worldPos, vp);
             o.uv = v.uv;
-            o.finalColor = tintColor;
-            o.finalColor.a *= alpha;
+            o.finalColor = v.tint;
             return o;
         }
     )";
@@ -782,14 +527,14 @@ bool CompileShaders()
     )";
 
     pVsBlob = pPsBlob = pErrorBlob = nullptr;
-    if (FAILED(D3DCompile(transparentVS, strlen(transparentVS), nullptr, nullptr, nullptr, "vs", "vs_5_0", flags, 0, &pVsBlob, &pErrorBlob))) {
+    if (FAILED(CompileShaderCached(g_shaderCache, transparentVS, strlen(transparentVS), nullptr, "vs", "vs_5_0", flags, &pVsBlob, &pErrorBlob))) {
         if (pErrorBlob) OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
         SAFE_RELEASE(pErrorBlob);
         return false;
     }
     g_pDevice->CreateVertexShader(pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), nullptr, &g_pTransparentVS);
 
-    if (FAILED(D3DCompile(transparentPS, strlen(transparentPS), nullptr, nullptr, nullptr, "ps", "ps_5_0", flags, 0, &pPsBlob, &pErrorBlob))) {
+    if (FAILED(CompileShaderCached(g_shaderCache, transparentPS, strlen(transparentPS), nullptr, "ps", "ps_5_0", flags, &pPsBlob, &pErrorBlob))) {
         if (pErrorBlob) OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
         SAFE_RELEASE(pErrorBlob);
         return false;
@@ -799,8 +544,12 @@ bool CompileShaders()
     D3D11_INPUT_ELEMENT_DESC transparentLayout[] = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
         {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"TINT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1},
     };
-    g_pDevice->CreateInputLayout(transparentLayout, 2, pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), &g_pTransparentInputLayout);
+    g_pDevice->CreateInputLayout(transparentLayout, ARRAY_SIZE(transparentLayout), pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), &g_pTransparentInputLayout);
 
     SAFE_RELEASE(pVsBlob);
     SAFE_RELEASE(pPsBlob);
@@ -839,14 +588,14 @@ bool CompileShaders()
     )";
 
     pVsBlob = pPsBlob = pErrorBlob = nullptr;
-    if (FAILED(D3DCompile(skyboxVS, strlen(skyboxVS), nullptr, nullptr, nullptr, "vs", "vs_5_0", flags, 0, &pVsBlob, &pErrorBlob))) {
+    if (FAILED(CompileShaderCached(g_shaderCache, skyboxVS, strlen(skyboxVS), nullptr, "vs", "vs_5_0", flags, &pVsBlob, &pErrorBlob))) {
         if (pErrorBlob) OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
         SAFE_RELEASE(pErrorBlob);
         return false;
     }
     g_pDevice->CreateVertexShader(pVsBlob->GetBufferPointer(), pVsBlob->GetBufferSize(), nullptr, &g_pSkyboxVS);
 
-    if (FAILED(D3DCompile(skyboxPS, strlen(skyboxPS), nullptr, nullptr, nullptr, "ps", "ps_5_0", flags, 0, &pPsBlob, &pErrorBlob))) {
+    if (FAILED(CompileShaderCached(g_shaderCache, skyboxPS, strlen(skyboxPS), nullptr, "ps", "ps_5_0", flags, &pPsBlob, &pErrorBlob))) {
         if (pErrorBlob) OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
         SAFE_RELEASE(pErrorBlob);
         return false;
@@ -859,25 +608,18 @@ bool CompileShaders()
     SAFE_RELEASE(pPsBlob);
     SAFE_RELEASE(pErrorBlob);
 
+    g_shaderCache.Save();
+    ReportShaderCacheStats("lab5", g_shaderCache.GetStats());
     return true;
 }
 
 bool LoadTextures()
 {
-    TextureDesc texDesc;
     std::wstring fullPath = GetPath() + L"..\\..\\texture\\wood02.dds";
-    if (!LoadDDS(fullPath.c_str(), texDesc))
-    {
-        MessageBoxA(NULL, "Failed to load wood02.dds", "Error", MB_OK);
-        return false;
-    }
-
-    g_pTextureView = CreateTexture2D(g_pDevice, texDesc);
-    free(texDesc.pData);
-
+    g_pTextureView = TextureLoader::LoadTextureShared(g_pDevice, fullPath);
     if (!g_pTextureView)
     {
-        MessageBoxA(NULL, "Failed to create texture SRV", "Error", MB_OK);
+        MessageBoxA(NULL, "Failed to load wood02.dds", "Error", MB_OK);
         return false;
     }
 
@@ -887,12 +629,13 @@ bool LoadTextures()
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.MinLOD = 0;
-    sampDesc.MaxLOD = (FLOAT)texDesc.mipmapsCount;
+    sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
     sampDesc.MipLODBias = 0.0f;
     sampDesc.MaxAnisotropy = 16;
     sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
 
-    if (FAILED(g_pDevice->CreateSamplerState(&sampDesc, &g_pSampler)))
+    g_pSampler = g_stateCache.GetSamplerState(sampDesc);
+    if (!g_pSampler)
     {
         MessageBoxA(NULL, "Failed to create sampler", "Error", MB_OK);
         return false;
@@ -905,140 +648,111 @@ bool LoadTextures()
         path + L"posz.dds", path + L"negz.dds"
     };
 
-    g_pCubemapView = CreateCubemap(g_pDevice, faceNames);
+    g_pCubemapView = TextureLoader::LoadCubemapShared(g_pDevice, faceNames);
     if (!g_pCubemapView)
     {
         MessageBoxA(NULL, "Failed to load cubemap", "Error", MB_OK);
         return false;
     }
 
-    // Create blend state for transparency
-    D3D11_BLEND_DESC blendDesc = {};
-    blendDesc.RenderTarget[0].BlendEnable = TRUE;
-    blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
-    blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
-    blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
-    blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
-    blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
-    blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
-    blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
-
-    if (FAILED(g_pDevice->CreateBlendState(&blendDesc, &g_pBlendState)))
-    {
-        MessageBoxA(NULL, "Failed to create blend state", "Error", MB_OK);
-        return false;
-    }
-
-    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
-    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
-    dsDesc.StencilEnable = FALSE;
-
-    if (FAILED(g_pDevice->CreateDepthStencilState(&dsDesc, &g_pTransparentDepthState)))
-    {
-        MessageBoxA(NULL, "Failed to create transparent depth state", "Error", MB_OK);
-        return false;
-    }
-
     return true;
 }
-void SortTransparentObjects(std::vector<TransparentRenderItem>& items, const XMVECTOR& cameraPos)
+// Both cubes span -0.5..0.5, so half their diagonal bounds them
+const float CUBE_BOUNDING_RADIUS = 0.8660254f;
+
+// XMMATRIX and SceneMath share the row-vector convention, so the rows
+// carry over as they are
+Float4x4 ToFloat4x4(const XMMATRIX& m)
 {
-    for (auto& item : items)
-    {
-        XMVECTOR objPos = XMVectorSet(0, 0, 0, 1);
-        objPos = XMVector3Transform(objPos, item.worldMatrix);
-        XMVECTOR distVec = XMVectorSubtract(objPos, cameraPos);
-        item.distance = XMVectorGetX(XMVector3Length(distVec));
-    }
+    Float4x4 out;
+    XMStoreFloat4x4((XMFLOAT4X4*)&out, m);
+    return out;
+}
 
-    std::sort(items.begin(), items.end(),
-        [](const TransparentRenderItem& a, const TransparentRenderItem& b) {
-            return a.distance > b.distance;
-        });
+// Translation(t) * RotationY(yaw) orbits t around the origin; as a
+// scale/rotation/translation transform that is yaw plus t rotated by yaw.
+void SetOrbitTransform(size_t index, float x, float y, float z, float yaw)
+{
+    float c = cos(yaw);
+    float s = sin(yaw);
+    g_transparentScene.SetPosition(index, x * c + z * s, y, z * c - x * s);
+    g_transparentScene.SetRotationYaw(index, yaw);
 }
-void RenderTransparentObjects(const XMMATRIX& view, const XMMATRIX& proj, float time)
+
+void AnimateTransparentObjects(float time)
 {
-    if (!g_pTransparentVertexBuffer) return;
+    if (g_transparentScene.Size() < 2) return;
 
     g_orbitAngle1 += time * 0.5f;
     g_orbitAngle2 += time * 0.3f;
 
-    std::vector<TransparentRenderItem> items;
-
     float x1 = g_orbitRadius * cos(g_orbitAngle1);
     float z1 = g_orbitRadius * sin(g_orbitAngle1);
-    XMMATRIX model1 = XMMatrixTranslation(x1, 0.0f, z1) * XMMatrixRotationY(g_orbitAngle1 * 0.5f);
-
-    TransparentRenderItem item1;
-    item1.worldMatrix = model1;
-    item1.alpha = g_transparentAlphas[0];
-    item1.color = g_transparentColors[0];
-    items.push_back(item1);
+    SetOrbitTransform(0, x1, 0.0f, z1, g_orbitAngle1 * 0.5f);
 
     float x2 = g_orbitRadius * cos(g_orbitAngle2 + XM_PI);
     float z2 = g_orbitRadius * sin(g_orbitAngle2 + XM_PI);
-    XMMATRIX model2 = XMMatrixTranslation(x2, 0.5f, z2) * XMMatrixRotationY(g_orbitAngle2 * 0.7f);
-
-    TransparentRenderItem item2;
-    item2.worldMatrix = model2;
-    item2.alpha = g_transparentAlphas[1];
-    item2.color = g_transparentColors[1];
-    items.push_back(item2);
-
-    XMVECTOR cameraPos = GetEyePosition();
-    SortTransparentObjects(items, cameraPos);
-
-    // Set cc state
-    g_pContext->OMSetBlendState(g_pBlendState, nullptr, 0xffffffff);
-    g_pContext->OMSetDepthStencilState(g_pTransparentDepthState, 0);
-
-    D3D11_RASTERIZER_DESC rsDesc = {};
-    rsDesc.FillMode = D3D11_FILL_SOLID;
-    rsDesc.CullMode = D3D11_CULL_BACK;
-    ID3D11RasterizerState* pRS = nullptr;
-    g_pDevice->CreateRasterizerState(&rsDesc, &pRS);
-    g_pContext->RSSetState(pRS);
-
-    g_pContext->VSSetShader(g_pTransparentVS, nullptr, 0);
-    g_pContext->PSSetShader(g_pTransparentPS, nullptr, 0);
-    g_pContext->IASetInputLayout(g_pTransparentInputLayout);
+    SetOrbitTransform(1, x2, 0.5f, z2, g_orbitAngle2 * 0.7f);
+}
 
-    UINT stride = sizeof(TransparentVertex);
-    UINT offset = 0;
-    g_pContext->IASetVertexBuffers(0, 1, &g_pTransparentVertexBuffer, &stride, &offset);
-    g_pContext->IASetIndexBuffer(g_pTransparentIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+void RenderTransparentObjects(const XMMATRIX& view, const XMMATRIX& proj)
+{
+    if (!g_pTransparentVertexBuffer || !g_pTransparentInstanceBuffer) return;
 
-    g_pContext->PSSetShaderResources(0, 1, &g_pTextureView);
-    g_pContext->PSSetSamplers(0, 1, &g_pSampler);
+    XMFLOAT3 eye;
+    XMStoreFloat3(&eye, GetEyePosition());
+    const std::vector<uint32_t>& order = g_transparencySorter.Sort(g_transparentScene, eye.x, eye.y, eye.z, &g_jobs);
 
+    // The whole set is sorted so the sorter keeps its coherence while
+    // cubes go in and out of view; only the visible ones are drawn
     XMMATRIX vp = view * proj;
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    if (SUCCEEDED(g_pContext->Map(g_pViewProjCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
-        ViewProjConstantBuffer* pData = (ViewProjConstantBuffer*)mapped.pData;
-        XMStoreFloat4x4((XMFLOAT4X4*)&pData->vp, XMMatrixTranspose(vp));
-        g_pContext->Unmap(g_pViewProjCB, 0);
-    }
-
-
-    for (const auto& item : items)
+    const FrustumPlanes planes = ExtractFrustumPlanes(ToFloat4x4(vp));
+    ComputeBoundingSpheres(g_transparentScene, CUBE_BOUNDING_RADIUS, g_transparentBounds);
+    g_transparentBvh.Refit(g_transparentBounds);
+
+    const size_t count = g_transparentScene.Size();
+    g_transparentVisible.resize(count);
+    g_transparentInView.assign(count, 0);
+    size_t visible = g_transparentBvh.CullFrustum(planes, g_transparentBounds, g_transparentVisible.data());
+
+    // The center cube is opaque and already drawn, so whatever is wholly
+    // behind it would fail the depth test anyway
+    XMFLOAT4X4 centerWorld;
+    XMStoreFloat4x4(&centerWorld, XMMatrixTranspose(XMMatrixRotationY(g_centerRotation)));
+    g_occlusionCuller.BeginFrame(ToFloat4x4(vp));
+    g_occlusionCuller.AddOccluderBox(centerWorld.m);
+    g_occlusionCuller.BuildHierarchy();
+    visible = g_occlusionCuller.CullSpheres(g_transparentBounds, g_transparentVisible.data(), visible);
+
+    for (size_t n = 0; n < visible; ++n)
+        g_transparentInView[g_transparentVisible[n]] = 1;
+
+    g_transparentDrawOrder.clear();
+    for (uint32_t index : order)
     {
-        TransparentConstantBuffer cbData;
-        XMStoreFloat4x4((XMFLOAT4X4*)&cbData.model, XMMatrixTranspose(item.worldMatrix));
-        cbData.alpha = item.alpha;
-        cbData.tintColor = item.color;
-        cbData.padding[0] = cbData.padding[1] = cbData.padding[2] = 0.0f;
-
-        g_pContext->UpdateSubresource(g_pTransparentCB, 0, nullptr, &cbData, 0, 0);
-
-        ID3D11Buffer* cbs[] = { g_pTransparentCB, g_pViewProjCB };
-        g_pContext->VSSetConstantBuffers(0, 2, cbs);
-
-        g_pContext->DrawIndexed(g_transparentIndexCount, 0, 0);
+        if (g_transparentInView[index])
+            g_transparentDrawOrder.push_back(index);
     }
+    if (g_transparentDrawOrder.empty())
+        return;
 
-    SAFE_RELEASE(pRS);
+    // The instance buffer is only read by the draw below, so it can be
+    // filled right away instead of going through the recorder's payload
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(g_pContext->Map(g_pTransparentInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+        return;
+    ComputeInstanceDataOrdered(g_transparentScene, g_transparentDrawOrder.data(), g_transparentDrawOrder.size(),
+        (InstanceData*)mapped.pData);
+    g_pContext->Unmap(g_pTransparentInstanceBuffer, 0);
+
+    ViewProjConstantBuffer vpData;
+    XMStoreFloat4x4((XMFLOAT4X4*)&vpData.vp, XMMatrixTranspose(vp));
+
+    // Instances are rasterized in buffer order, so one draw keeps the
+    // back-to-front blending order
+    g_renderQueue.AddDraw(RENDER_PASS_TRANSPARENT, g_transparentMaterial, g_transparentGeometry, 0.0f,
+        (uint32_t)g_transparentDrawOrder.size());
+    g_renderQueue.AddConstants(1, &vpData, sizeof(vpData));
 }
 void SetupTransparentObjects()
 {
@@ -1090,117 +804,120 @@ void SetupTransparentObjects()
     g_pDevice->CreateBuffer(&desc, &data, &g_pTransparentIndexBuffer);
 
 
-    g_transparentAlphas.resize(2);
-    g_transparentColors.resize(2);
-
-    g_transparentAlphas[0] = 0.55f;
-    g_transparentColors[0] = XMFLOAT4(1.0f, 0.2f, 0.2f, 1.0f);
-
+    g_transparentScene.Resize(2);
+    g_transparentScene.SetTint(0, 1.0f, 0.2f, 0.2f, 0.55f);
+    g_transparentScene.SetTint(1, 0.0f, 0.5f, 1.0f, 0.6f);
 
-    g_transparentAlphas[1] = 0.6f;
-    g_transparentColors[1] = XMFLOAT4(0.0f, 0.5f, 1.0f, 1.0f);
+    desc = {};
+    desc.ByteWidth = (UINT)(g_transparentScene.Size() * sizeof(InstanceData));
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    g_pDevice->CreateBuffer(&desc, nullptr, &g_pTransparentInstanceBuffer);
 }
 
-void RenderSkybox(const XMMATRIX& vpSky)
+// Binds the constants to slot from the ring, or through pFallback updated
+// in place when the ring is unavailable or full
+void SetVSConstants(UINT slot, ID3D11Buffer* pFallback, const void* pData, UINT size, bool discard)
 {
-    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
-    dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-    dsDesc.StencilEnable = FALSE;
-    ID3D11DepthStencilState* pDSSky = nullptr;
-    g_pDevice->CreateDepthStencilState(&dsDesc, &pDSSky);
-    g_pContext->OMSetDepthStencilState(pDSSky, 0);
-
-    D3D11_RASTERIZER_DESC rsDesc = {};
-    rsDesc.FillMode = D3D11_FILL_SOLID;
-    rsDesc.CullMode = D3D11_CULL_NONE;
-    ID3D11RasterizerState* pRSSky = nullptr;
-    g_pDevice->CreateRasterizerState(&rsDesc, &pRSSky);
-    g_pContext->RSSetState(pRSSky);
-
-    g_pContext->VSSetShader(g_pSkyboxVS, nullptr, 0);
-    g_pContext->PSSetShader(g_pSkyboxPS, nullptr, 0);
-    g_pContext->IASetInputLayout(g_pSkyboxInputLayout);
-
-    UINT stride = sizeof(TexturedVertex);
-    UINT offset = 0;
-    ID3D11Buffer* vbSky[] = { g_pSkyboxVertexBuffer };
-    g_pContext->IASetVertexBuffers(0, 1, vbSky, &stride, &offset);
-    g_pContext->IASetIndexBuffer(g_pSkyboxIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    g_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (g_constantRing.SetVSConstants(g_commands, slot, pData, size))
+        return;
 
-    ID3D11Buffer* cbsSky[] = { nullptr, g_pViewProjCB };
-    g_pContext->VSSetConstantBuffers(0, 2, cbsSky);
+    g_commands.UpdateBuffer(pFallback, pData, size, discard);
+    g_commands.SetVSConstantBuffer(slot, pFallback);
+}
 
-    ID3D11ShaderResourceView* skySRV[] = { g_pCubemapView };
-    g_pContext->PSSetShaderResources(1, 1, skySRV);
-    ID3D11SamplerState* samplers[] = { g_pSampler };
-    g_pContext->PSSetSamplers(1, 1, samplers);
+// Queued draws put their model matrix in b0 and their view-projection in b1
+void SetQueuedConstants(CommandRecorder&, uint32_t slot, const void* pData, uint32_t size)
+{
+    if (slot == 0)
+        SetVSConstants(0, g_pModelCB, pData, size, false);
+    else
+        SetVSConstants(slot, g_pViewProjCB, pData, size, true);
+}
 
-    g_pContext->DrawIndexed(36, 0, 0);
+void SetupRenderQueue()
+{
+    g_renderQueue.Clear();
+
+    RenderMaterial material;
+    material.pSampler = g_pSampler;
+
+    material.pVertexShader = g_pSkyboxVS;
+    material.pPixelShader = g_pSkyboxPS;
+    material.pInputLayout = g_pSkyboxInputLayout;
+    material.pTexture = g_pCubemapView.get();
+    material.textureSlot = 1;
+    material.pDepthStencilState = g_pSkyboxDepthState;
+    material.pRasterizerState = g_pSkyboxRasterizerState;
+    g_skyboxMaterial = g_renderQueue.AddMaterial(material);
+
+    material.pVertexShader = g_pVertexShader;
+    material.pPixelShader = g_pPixelShader;
+    material.pInputLayout = g_pInputLayout;
+    material.pTexture = g_pTextureView.get();
+    material.textureSlot = 0;
+    material.pDepthStencilState = g_pCubeDepthState;
+    material.pRasterizerState = g_pCubeRasterizerState;
+    g_cubeMaterial = g_renderQueue.AddMaterial(material);
+
+    material.pVertexShader = g_pTransparentVS;
+    material.pPixelShader = g_pTransparentPS;
+    material.pInputLayout = g_pTransparentInputLayout;
+    material.pDepthStencilState = g_pTransparentDepthState;
+    material.pRasterizerState = g_pTransparentRasterizerState;
+    material.pBlendState = g_pBlendState;
+    g_transparentMaterial = g_renderQueue.AddMaterial(material);
+
+    RenderGeometry geometry;
+    geometry.pVertexBuffer = g_pSkyboxVertexBuffer;
+    geometry.vertexStride = sizeof(TexturedVertex);
+    geometry.pIndexBuffer = g_pSkyboxIndexBuffer;
+    geometry.indexCount = 36;
+    g_skyboxGeometry = g_renderQueue.AddGeometry(geometry);
+
+    geometry.pVertexBuffer = g_pVertexBuffer;
+    geometry.pIndexBuffer = g_pIndexBuffer;
+    g_cubeGeometry = g_renderQueue.AddGeometry(geometry);
+
+    geometry.pVertexBuffer = g_pTransparentVertexBuffer;
+    geometry.vertexStride = sizeof(TransparentVertex);
+    geometry.pInstanceBuffer = g_pTransparentInstanceBuffer;
+    geometry.instanceStride = sizeof(InstanceData);
+    geometry.pIndexBuffer = g_pTransparentIndexBuffer;
+    geometry.indexCount = g_transparentIndexCount;
+    g_transparentGeometry = g_renderQueue.AddGeometry(geometry);
+}
 
-    SAFE_RELEASE(pRSSky);
-    SAFE_RELEASE(pDSSky);
+void RenderSkybox(const XMMATRIX& vpSky)
+{
+    ViewProjConstantBuffer vpData;
+    XMStoreFloat4x4((XMFLOAT4X4*)&vpData.vp, XMMatrixTranspose(vpSky));
+    g_renderQueue.AddDraw(RENDER_PASS_BACKGROUND, g_skyboxMaterial, g_skyboxGeometry, 0.0f);
+    g_renderQueue.AddConstants(1, &vpData, sizeof(vpData));
 }
 
 void RenderCenterCube(const XMMATRIX& view, const XMMATRIX& proj, float time)
 {
-    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
-    dsDesc.StencilEnable = FALSE;
-    ID3D11DepthStencilState* pDSCube = nullptr;
-    g_pDevice->CreateDepthStencilState(&dsDesc, &pDSCube);
-    g_pContext->OMSetDepthStencilState(pDSCube, 0);
-
-    D3D11_RASTERIZER_DESC rsDesc = {};
-    rsDesc.FillMode = D3D11_FILL_SOLID;
-    rsDesc.CullMode = D3D11_CULL_BACK;
-    ID3D11RasterizerState* pRSCube = nullptr;
-    g_pDevice->CreateRasterizerState(&rsDesc, &pRSCube);
-    g_pContext->RSSetState(pRSCube);
-
     // Center cube rotates around its own axis
     g_centerRotation += time * 0.8f;
     XMMATRIX model = XMMatrixRotationY(g_centerRotation);
     XMMATRIX vp = view * proj;
 
+    // It spins in place, so its bounding sphere never moves
+    if (!IsSphereInFrustum(ExtractFrustumPlanes(ToFloat4x4(vp)), 0.0f, 0.0f, 0.0f, CUBE_BOUNDING_RADIUS))
+        return;
+
     ModelConstantBuffer modelData;
     XMStoreFloat4x4((XMFLOAT4X4*)&modelData.model, XMMatrixTranspose(model));
-    g_pContext->UpdateSubresource(g_pModelCB, 0, nullptr, &modelData, 0, 0);
-
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    if (SUCCEEDED(g_pContext->Map(g_pViewProjCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
-    {
-        ViewProjConstantBuffer* pData = (ViewProjConstantBuffer*)mapped.pData;
-        XMStoreFloat4x4((XMFLOAT4X4*)&pData->vp, XMMatrixTranspose(vp));
-        g_pContext->Unmap(g_pViewProjCB, 0);
-    }
-
-    g_pContext->VSSetShader(g_pVertexShader, nullptr, 0);
-    g_pContext->PSSetShader(g_pPixelShader, nullptr, 0);
-    g_pContext->IASetInputLayout(g_pInputLayout);
-
-    UINT stride = sizeof(TexturedVertex);
-    UINT offset = 0;
-    ID3D11Buffer* vbCube[] = { g_pVertexBuffer };
-    g_pContext->IASetVertexBuffers(0, 1, vbCube, &stride, &offset);
-    g_pContext->IASetIndexBuffer(g_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
 
-    ID3D11Buffer* cbsCube[] = { g_pModelCB, g_pViewProjCB };
-    g_pContext->VSSetConstantBuffers(0, 2, cbsCube);
+    ViewProjConstantBuffer vpData;
+    XMStoreFloat4x4((XMFLOAT4X4*)&vpData.vp, XMMatrixTranspose(vp));
 
-    ID3D11ShaderResourceView* cubeSRV[] = { g_pTextureView };
-    g_pContext->PSSetShaderResources(0, 1, cubeSRV);
-    ID3D11SamplerState* samplers[] = { g_pSampler };
-    g_pContext->PSSetSamplers(0, 1, samplers);
-
-    g_pContext->DrawIndexed(36, 0, 0);
-
-    SAFE_RELEASE(pRSCube);
-    SAFE_RELEASE(pDSCube);
+    // It sits at the origin, so its view depth is the view translation's z
+    g_renderQueue.AddDraw(RENDER_PASS_OPAQUE, g_cubeMaterial, g_cubeGeometry, XMVectorGetZ(view.r[3]));
+    g_renderQueue.AddConstants(0, &modelData, sizeof(modelData));
+    g_renderQueue.AddConstants(1, &vpData, sizeof(vpData));
 }
 
 
@@ -1214,7 +931,16 @@ void Render()
     float deltaTime = (float)(currentTime - g_lastFrameTime);
     g_lastFrameTime = currentTime;
 
-    UpdateCamera(deltaTime);
+    // The camera and the orbiting cubes touch different state, so they
+    // update side by side
+    Job* pUpdate = g_jobs.CreateJob([]() {});
+    g_jobs.Run(g_jobs.CreateChildJob(pUpdate, [deltaTime]() { UpdateCamera(deltaTime); }));
+    g_jobs.Run(g_jobs.CreateChildJob(pUpdate, [deltaTime]() { AnimateTransparentObjects(deltaTime); }));
+    g_jobs.Run(pUpdate);
+    g_jobs.Wait(pUpdate);
+
+    g_commands.BeginFrame();
+    g_constantRing.BeginFrame(g_pContext);
 
     g_pContext->OMSetRenderTargets(1, &g_pBackBufferRTV, g_pDepthStencilView);
     const float clearColor[4] = { 0.1f, 0.1f, 0.2f, 1.0f };
@@ -1230,21 +956,18 @@ void Render()
     XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, aspect, 0.1f, 100.0f);
     XMMATRIX vpSky = viewNoTrans * proj;
 
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    if (SUCCEEDED(g_pContext->Map(g_pViewProjCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
-    {
-        ViewProjConstantBuffer* pData = (ViewProjConstantBuffer*)mapped.pData;
-        XMStoreFloat4x4((XMFLOAT4X4*)&pData->vp, XMMatrixTranspose(vpSky));
-        g_pContext->Unmap(g_pViewProjCB, 0);
-    }
-
-    // Render order: Skybox -> Opaque objects -> Transparent objects
+    // The queue orders the passes: skybox, opaque objects, transparent objects
+    g_renderQueue.BeginFrame(0.1f, 100.0f);
     RenderSkybox(vpSky);
     RenderCenterCube(view, proj, deltaTime);
-    RenderTransparentObjects(view, proj, deltaTime);
+    RenderTransparentObjects(view, proj);
+    g_renderQueue.Submit(g_commands, SetQueuedConstants);
 
     // Reset blend state
-    g_pContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+    g_commands.SetBlendState(nullptr, 0xffffffff);
+
+    g_constantRing.EndFrame(g_pContext);
+    g_commands.Submit(g_renderContext);
 
     g_pSwapChain->Present(1, 0);
 }
@@ -1305,10 +1028,12 @@ void Cleanup()
 {
     if (g_pContext)
         g_pContext->ClearState();
+    g_commands.Invalidate();
 
     SAFE_RELEASE(g_pModelCB);
-    SAFE_RELEASE(g_pTransparentCB);
+    SAFE_RELEASE(g_pTransparentInstanceBuffer);
     SAFE_RELEASE(g_pViewProjCB);
+    g_constantRing.Cleanup();
 
     SAFE_RELEASE(g_pInputLayout);
     SAFE_RELEASE(g_pVertexShader);
@@ -1334,11 +1059,24 @@ void Cleanup()
     SAFE_RELEASE(g_pBackBufferRTV);
     SAFE_RELEASE(g_pDepthStencilView);
     SAFE_RELEASE(g_pSwapChain);
-    SAFE_RELEASE(g_pTextureView);
-    SAFE_RELEASE(g_pCubemapView);
-    SAFE_RELEASE(g_pSampler);
-    SAFE_RELEASE(g_pBlendState);
-    SAFE_RELEASE(g_pTransparentDepthState);
+    // The cache holds the last reference to each view; drop it while the
+    // device is still alive
+    g_pTextureView.reset();
+    g_pCubemapView.reset();
+    TextureLoader::GetTextureCache().Trim();
+
+    g_renderQueue.Clear();
+
+    // Cached state objects are owned by the cache
+    g_stateCache.Cleanup();
+    g_pSampler = nullptr;
+    g_pBlendState = nullptr;
+    g_pTransparentDepthState = nullptr;
+    g_pTransparentRasterizerState = nullptr;
+    g_pSkyboxDepthState = nullptr;
+    g_pSkyboxRasterizerState = nullptr;
+    g_pCubeDepthState = nullptr;
+    g_pCubeRasterizerState = nullptr;
 
 #ifdef _DEBUG
     if (g_pDevice)
@@ -1364,12 +1102,15 @@ bool Initialize(HWND hWnd, UINT width, UINT height)
     g_lastFrameTime = (double)GetTickCount64() / 1000.0;
 
     if (!CreateDeviceAndSwapChain()) return false;
+    g_renderContext.SetContext(g_pContext);
     if (!CreateRenderTargetAndDepthStencil()) return false;
     if (!CreateBuffers()) return false;
+    if (!CreateRenderStates()) return false;
     if (!CompileShaders()) return false;
     if (!LoadTextures()) return false;
 
     SetupTransparentObjects();
+    SetupRenderQueue();
 
     return true;
 }